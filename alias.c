@@ -28,6 +28,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wchar.h>
 #include <wctype.h>
 #include "builtin.h"
@@ -69,6 +70,10 @@ typedef struct aliaslist_T {
 
 static bool is_alias_name_char(wchar_t c)
     __attribute__((pure));
+static hashval_T hash_alias(const alias_T *alias)
+    __attribute__((nonnull,pure));
+static size_t *initial_count(wchar_t c)
+    __attribute__((const));
 static void free_alias(alias_T *alias);
 static inline void vfreealias(kvpair_T kv);
 static void define_alias(
@@ -98,6 +103,18 @@ static bool print_alias(const wchar_t *name, const alias_T *alias, bool prefix);
 /* Hashtable mapping alias names (wide strings) to alias_T's. */
 hashtable_T aliases;
 
+/* Hash value summarizing all the alias definitions. This is the exclusive OR
+ * of the values of `hash_alias' for all the aliases so that it can be updated
+ * whenever an alias is defined or removed. */
+static hashval_T alias_fingerprint = 0;
+
+/* Numbers of aliases whose name starts with each ASCII character. The last
+ * element counts the aliases whose name starts with a non-ASCII character.
+ * A word whose first character has a zero count cannot be an alias, so it is
+ * rejected without looking up the hashtable. */
+#define INITIAL_COUNTS_ASCII_SIZE 128
+static size_t initial_counts[INITIAL_COUNTS_ASCII_SIZE + 1];
+
 
 /* Initializes the alias module. */
 void init_alias(void)
@@ -112,6 +129,53 @@ bool is_alias_name_char(wchar_t c)
     return !wcschr(L" \t\n=$<>\\'\"`;&|()#", c) && !iswblank(c);
 }
 
+/* Computes a hash value of the name, value, and type of an alias. */
+hashval_T hash_alias(const alias_T *alias)
+{
+    hashval_T h = hashwcs(alias->value + alias->valuelen + 1);
+    h = (h * FNVPRIME) ^ hashwcs(alias->value);
+    return (h * FNVPRIME) ^ (hashval_T) alias->isglobal;
+}
+
+/* Returns a pointer to the element of `initial_counts' for aliases whose name
+ * starts with `c'. */
+size_t *initial_count(wchar_t c)
+{
+    if ((unsigned long) c < INITIAL_COUNTS_ASCII_SIZE)
+        return &initial_counts[c];
+    else
+        return &initial_counts[INITIAL_COUNTS_ASCII_SIZE];
+}
+
+/* Returns a value that changes whenever any alias is defined or removed.
+ * (Different sets of aliases may have the same fingerprint by accident.) */
+uintmax_t get_alias_fingerprint(void)
+{
+    return alias_fingerprint;
+}
+
+/* Returns true iff at least one alias is defined. */
+bool any_alias_defined(void)
+{
+    return aliases.count > 0;
+}
+
+/* Computes the memory used for the aliases. The number of aliases is assigned
+ * to `*countp' and the number of bytes allocated for them to `*bytesp'. */
+void alias_memory_usage(size_t *countp, size_t *bytesp)
+{
+    size_t bytes = ht_memory_size(&aliases);
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&aliases, &i)).key != NULL) {
+        const alias_T *alias = kv.value;
+        bytes += (wcslen(kv.key) + 1) * sizeof (wchar_t);
+        bytes += sizeof *alias + (alias->valuelen + 1) * sizeof *alias->value;
+    }
+    *countp = aliases.count;
+    *bytesp = bytes;
+}
+
 /* Decreases the reference count of `alias' and, if the count becomes zero,
  * frees it. This function does nothing if `alias' is a null pointer. */
 void free_alias(alias_T *alias)
@@ -149,7 +213,16 @@ void define_alias(
     wmemcpy(alias->value + valuelen + 1, nameandvalue, namelen);
     alias->value[namelen + valuelen + 1] = L'\0';
 
-    vfreealias(ht_set(&aliases, alias->value + valuelen + 1, alias));
+    alias_fingerprint ^= hash_alias(alias);
+
+    alias_T *oldalias = ht_set(&aliases, alias->value + valuelen + 1, alias)
+        .value;
+    if (oldalias != NULL) {
+        alias_fingerprint ^= hash_alias(oldalias);
+        free_alias(oldalias);
+    } else {
+        (*initial_count(nameandvalue[0]))++;
+    }
 }
 
 /* Removes the alias definition with the specified name if any.
@@ -160,6 +233,9 @@ bool remove_alias(const wchar_t *name)
     alias_T *alias = ht_remove(&aliases, name).value;
 
     if (alias != NULL) {
+        assert(*initial_count(name[0]) > 0);
+        (*initial_count(name[0]))--;
+        alias_fingerprint ^= hash_alias(alias);
         free_alias(alias);
         return true;
     } else {
@@ -171,6 +247,8 @@ bool remove_alias(const wchar_t *name)
 void remove_all_aliases(void)
 {
     ht_clear(&aliases, vfreealias);
+    alias_fingerprint = 0;
+    memset(initial_counts, 0, sizeof initial_counts);
 }
 
 /* Returns the value of the specified alias (or null if there is no such). */
@@ -323,6 +401,8 @@ bool substitute_alias_range(xwcsbuf_T *restrict buf, size_t i, size_t j,
     if (flags & AF_NOEOF)
         if (j == buf->length)
             return false;
+    if (*initial_count(buf->contents[i]) == 0)
+        return false;
 
     alias_T *alias;
 
@@ -474,7 +554,7 @@ int alias_builtin(int argc, void **argv)
     if (xoptind == argc) {
         /* print all aliases */
         kvpair_T *kvs = ht_tokvarray(&aliases);
-        qsort(kvs, aliases.count, sizeof *kvs, keywcscoll);
+        sort_kvpairs_by_key(kvs, aliases.count);
         for (size_t i = 0; i < aliases.count; i++) {
             print_alias(kvs[i].key, kvs[i].value, prefix);
             if (yash_error_message_count > 0)
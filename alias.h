@@ -20,6 +20,7 @@
 #define YASH_ALIAS_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include "xgetopt.h"
 
 
@@ -34,6 +35,12 @@ typedef enum {
 extern void init_alias(void);
 extern const wchar_t *get_alias_value(const wchar_t *aliasname)
     __attribute__((nonnull,pure));
+extern uintmax_t get_alias_fingerprint(void)
+    __attribute__((pure));
+extern _Bool any_alias_defined(void)
+    __attribute__((pure));
+extern void alias_memory_usage(size_t *countp, size_t *bytesp)
+    __attribute__((nonnull));
 extern void destroy_aliaslist(struct aliaslist_T *list);
 extern void shift_aliaslist_index(
         struct aliaslist_T *list, size_t i, ptrdiff_t inc);
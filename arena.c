@@ -0,0 +1,170 @@
+/* Yash: yet another shell */
+/* arena.c: region-based memory allocation */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include "common.h"
+#include "arena.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include "util.h"
+
+
+/* type to which allocated objects are aligned */
+typedef union aligned_T {
+    long double ld;
+    intmax_t i;
+    void *p;
+    void (*f)(void);
+} aligned_T;
+
+struct arenachunk_T {
+    struct arenachunk_T *next;
+    size_t size;  /* size of `data' in bytes */
+    aligned_T data[];
+};
+
+struct arenacleanup_T {
+    struct arenacleanup_T *next;
+    void (*freer)(void *object);
+    void *object;
+};
+
+/* size of the data area of normal chunks */
+#define CHUNK_SIZE (4096 - sizeof (struct arenachunk_T))
+/* objects larger than this are allocated in a dedicated chunk */
+#define LARGE_OBJECT_SIZE (CHUNK_SIZE / 4)
+
+static struct arenachunk_T *new_chunk(size_t size)
+    __attribute__((malloc,warn_unused_result));
+
+
+/* Initializes the arena. No memory is allocated until the first object is
+ * allocated. */
+arena_T *arena_init(arena_T *arena)
+{
+    arena->chunks = NULL;
+    arena->next = arena->end = NULL;
+    arena->cleanups = NULL;
+    return arena;
+}
+
+struct arenachunk_T *new_chunk(size_t size)
+{
+    struct arenachunk_T *chunk =
+        xmallocs(sizeof *chunk, size, sizeof (char));
+    chunk->size = size;
+    return chunk;
+}
+
+/* Allocates an object of the specified size in the arena.
+ * The object is aligned suitably for any type. Never returns NULL. */
+void *arena_alloc(arena_T *arena, size_t size)
+{
+    size = add(size, sizeof (aligned_T) - 1);
+    size -= size % sizeof (aligned_T);
+
+    if ((size_t) (arena->end - arena->next) >= size) {
+        void *result = arena->next;
+        arena->next += size;
+        return result;
+    }
+
+    if (size > LARGE_OBJECT_SIZE) {
+        /* Allocate a dedicated chunk and put it behind the current chunk so
+         * that the remaining space in the current chunk can still be used. */
+        struct arenachunk_T *chunk = new_chunk(size);
+        if (arena->chunks == NULL) {
+            chunk->next = NULL;
+            arena->chunks = chunk;
+        } else {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        }
+        return chunk->data;
+    }
+
+    struct arenachunk_T *chunk = new_chunk(CHUNK_SIZE);
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->next = (char *) chunk->data + size;
+    arena->end = (char *) chunk->data + CHUNK_SIZE;
+    return chunk->data;
+}
+
+/* Copies the first `len' characters of the specified wide string into the
+ * arena. `s' need not be null-terminated. The copy is always null-terminated. */
+wchar_t *arena_wcsndup(arena_T *arena, const wchar_t *s, size_t len)
+{
+    wchar_t *result = arena_alloc(arena, mul(add(len, 1), sizeof *result));
+    wmemcpy(result, s, len);
+    result[len] = L'\0';
+    return result;
+}
+
+/* Registers function `freer' to be called with `object' when the arena is
+ * reset or destroyed. This is used for objects that are referenced from the
+ * arena but allocated outside it. Registered functions are called in the
+ * reverse order of registration. */
+void arena_defer(arena_T *arena, void freer(void *object), void *object)
+{
+    struct arenacleanup_T *cleanup = arena_alloc(arena, sizeof *cleanup);
+    cleanup->next = arena->cleanups;
+    cleanup->freer = freer;
+    cleanup->object = object;
+    arena->cleanups = cleanup;
+}
+
+/* Frees all the objects in the arena. One chunk is kept for reuse. */
+void arena_reset(arena_T *arena)
+{
+    for (struct arenacleanup_T *c = arena->cleanups; c != NULL; c = c->next)
+        c->freer(c->object);
+    arena->cleanups = NULL;
+
+    struct arenachunk_T *kept = NULL;
+    for (struct arenachunk_T *chunk = arena->chunks; chunk != NULL; ) {
+        struct arenachunk_T *next = chunk->next;
+        if (kept == NULL && chunk->size == CHUNK_SIZE)
+            kept = chunk;
+        else
+            free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks = kept;
+    if (kept != NULL) {
+        kept->next = NULL;
+        arena->next = (char *) kept->data;
+        arena->end = (char *) kept->data + CHUNK_SIZE;
+    } else {
+        arena->next = arena->end = NULL;
+    }
+}
+
+/* Frees all the objects in the arena and the arena itself.
+ * The arena can be reused after re-initialization. */
+void arena_destroy(arena_T *arena)
+{
+    arena_reset(arena);
+    free(arena->chunks);
+    arena_init(arena);
+}
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
@@ -0,0 +1,51 @@
+/* Yash: yet another shell */
+/* arena.h: region-based memory allocation */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef YASH_ARENA_H
+#define YASH_ARENA_H
+
+#include <stddef.h>
+
+
+/* An arena is a region of memory from which objects are allocated one after
+ * another. Objects in an arena cannot be freed individually; they are all
+ * freed at once when the arena is reset or destroyed. */
+typedef struct arena_T {
+    struct arenachunk_T *chunks;      /* the current chunk and older ones */
+    char *next, *end;                 /* free space in the current chunk */
+    struct arenacleanup_T *cleanups;  /* functions called on reset */
+} arena_T;
+
+extern arena_T *arena_init(arena_T *arena)
+    __attribute__((nonnull));
+extern void *arena_alloc(arena_T *arena, size_t size)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern wchar_t *arena_wcsndup(arena_T *arena, const wchar_t *s, size_t len)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern void arena_defer(arena_T *arena, void freer(void *object), void *object)
+    __attribute__((nonnull(1,2)));
+extern void arena_reset(arena_T *arena)
+    __attribute__((nonnull));
+extern void arena_destroy(arena_T *arena)
+    __attribute__((nonnull));
+
+
+#endif /* YASH_ARENA_H */
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
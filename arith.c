@@ -27,6 +27,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wchar.h>
 #include <sys/types.h>
 #include <wctype.h>
@@ -83,14 +84,60 @@ typedef struct evalinfo_T {
     atoken_T atoken;     /* current token */
     bool parseonly;      /* only parse the expression: don't calculate */
     bool error;          /* true if there is an error */
+    bool silent;         /* don't print error messages on parse error */
     char *savelocale;    /* original LC_NUMERIC locale */
 } evalinfo_T;
 
-static void evaluate(
-        const wchar_t *exp, value_T *result, evalinfo_T *info, bool coerce)
+/* An arithmetic expression is compiled into an array of nodes, in which the
+ * operands of each node precede the node itself. The last node is the root of
+ * the expression. */
+typedef enum anodetype_T {
+    AN_VALUE,        /* number or variable `value' */
+    AN_ASSIGNMENT,   /* operands[0] `op' operands[1] */
+    AN_CONDITIONAL,  /* operands[0] ? operands[1] : operands[2] */
+    AN_LOGICAL,      /* operands[0] `op' operands[1] where `op' is || or && */
+    AN_BINARY,       /* operands[0] `op' operands[1] */
+    AN_COMPARISON,   /* operands[0] `op' operands[1] */
+    AN_PREFIX,       /* `op' operands[0] */
+    AN_POSTFIX,      /* operands[0] `op' */
+} anodetype_T;
+typedef struct anode_T {
+    anodetype_T type;
+    atokentype_T op;
+    size_t operands[3];  /* indices of the operand nodes */
+    value_T value;       /* valid only for AN_VALUE */
+} anode_T;
+typedef struct acode_T {
+    wchar_t *exp;        /* source expression, which `value's point into */
+    bool posix;          /* value of `posixly_correct' when compiled */
+    size_t count, maxcount;
+    anode_T *nodes;
+} acode_T;
+
+#define ARITH_CACHE_SIZE 16
+
+/* Cache of compiled expressions, sorted from the most recently used one.
+ * Unused entries are NULL. Re-evaluating an expression in a loop need not
+ * parse the expression again. */
+static acode_T *arith_cache[ARITH_CACHE_SIZE];
+
+static bool evaluate(const wchar_t *exp, value_T *result, bool coerce)
+    __attribute__((nonnull,warn_unused_result));
+static bool interpret(const wchar_t *exp, value_T *result, bool coerce)
+    __attribute__((nonnull,warn_unused_result));
+static const acode_T *get_compiled_expression(const wchar_t *exp)
+    __attribute__((nonnull));
+static acode_T *compile(const wchar_t *exp)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static void free_compiled_expression(acode_T *code)
     __attribute__((nonnull));
 static void parse_assignment(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
+static bool is_assignment_operator(atokentype_T ttype)
+    __attribute__((const));
+static void do_assignment_calculation(evalinfo_T *info, atokentype_T ttype,
+        value_T *lhs, value_T *rhs)
+    __attribute__((nonnull));
 static bool do_assignment(const word_T *word, const value_T *value)
     __attribute__((nonnull));
 static wchar_t *value_to_string(const value_T *value)
@@ -125,6 +172,9 @@ static void parse_and(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
 static void parse_equality(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
+static void do_comparison(evalinfo_T *info, atokentype_T ttype,
+        value_T *lhs, value_T *rhs)
+    __attribute__((nonnull));
 static void parse_relational(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
 static void parse_shift(evalinfo_T *info, value_T *result)
@@ -135,8 +185,14 @@ static void parse_multiplicative(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
 static void parse_prefix(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
+static void do_prefix_calculation(
+        evalinfo_T *info, atokentype_T ttype, value_T *value)
+    __attribute__((nonnull));
 static void parse_postfix(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
+static void do_postfix_calculation(
+        evalinfo_T *info, atokentype_T ttype, value_T *value)
+    __attribute__((nonnull));
 static bool do_increment_or_decrement(atokentype_T ttype, value_T *value)
     __attribute__((nonnull,warn_unused_result));
 static void parse_primary(evalinfo_T *info, value_T *result)
@@ -152,6 +208,25 @@ static valuetype_T coerce_type(evalinfo_T *info,
     __attribute__((nonnull));
 static void next_token(evalinfo_T *info)
     __attribute__((nonnull));
+static bool compile_assignment(evalinfo_T *info, acode_T *code)
+    __attribute__((nonnull,warn_unused_result));
+static bool compile_conditional(evalinfo_T *info, acode_T *code)
+    __attribute__((nonnull,warn_unused_result));
+static int binary_operator_precedence(atokentype_T ttype)
+    __attribute__((const,warn_unused_result));
+static bool compile_binary(evalinfo_T *info, acode_T *code, int precedence)
+    __attribute__((nonnull,warn_unused_result));
+static bool compile_prefix(evalinfo_T *info, acode_T *code)
+    __attribute__((nonnull,warn_unused_result));
+static bool compile_postfix(evalinfo_T *info, acode_T *code)
+    __attribute__((nonnull,warn_unused_result));
+static bool compile_primary(evalinfo_T *info, acode_T *code)
+    __attribute__((nonnull,warn_unused_result));
+static anode_T *add_node(acode_T *code, anodetype_T type, atokentype_T op)
+    __attribute__((nonnull));
+static void execute(evalinfo_T *info, const anode_T *nodes, size_t index,
+        value_T *result)
+    __attribute__((nonnull));
 static bool long_mul_will_overflow(long v1, long v2)
     __attribute__((const,warn_unused_result));
 
@@ -164,20 +239,12 @@ static bool long_mul_will_overflow(long v1, long v2)
 wchar_t *evaluate_arithmetic(wchar_t *exp)
 {
     value_T result;
-    evalinfo_T info;
-
-    evaluate(exp, &result, &info, posixly_correct);
-
     wchar_t *resultstr;
-    if (info.error) {
-        resultstr = NULL;
-    } else if (info.atoken.type == TT_NULL) {
+
+    if (evaluate(exp, &result, posixly_correct))
         resultstr = value_to_string(&result);
-    } else {
-        if (info.atoken.type != TT_INVALID)
-            xerror(0, Ngt("arithmetic: invalid syntax"));
+    else
         resultstr = NULL;
-    }
     free(exp);
     return resultstr;
 }
@@ -190,55 +257,150 @@ wchar_t *evaluate_arithmetic(wchar_t *exp)
 bool evaluate_index(wchar_t *exp, ssize_t *valuep)
 {
     value_T result;
-    evalinfo_T info;
-
-    evaluate(exp, &result, &info, true);
-
     bool ok;
-    if (info.error) {
+
+    if (!evaluate(exp, &result, true)) {
         ok = false;
-    } else if (info.atoken.type == TT_NULL) {
-        if (result.type == VT_LONG) {
+    } else if (result.type == VT_LONG) {
 #if LONG_MAX > SSIZE_MAX
-            if (result.v_long > (long) SSIZE_MAX)
-                *valuep = SSIZE_MAX;
-            else
+        if (result.v_long > (long) SSIZE_MAX)
+            *valuep = SSIZE_MAX;
+        else
 #endif
 #if LONG_MIN < -SSIZE_MAX
-            if (result.v_long < (long) -SSIZE_MAX)
-                *valuep = -SSIZE_MAX;
-            else
+        if (result.v_long < (long) -SSIZE_MAX)
+            *valuep = -SSIZE_MAX;
+        else
 #endif
-                *valuep = (ssize_t) result.v_long;
-            ok = true;
-        } else {
-            xerror(0, Ngt("the index is not an integer"));
-            ok = false;
-        }
+            *valuep = (ssize_t) result.v_long;
+        ok = true;
     } else {
-        if (info.atoken.type != TT_INVALID)
-            xerror(0, Ngt("arithmetic: invalid syntax"));
+        xerror(0, Ngt("the index is not an integer"));
         ok = false;
     }
     free(exp);
     return ok;
 }
 
-void evaluate(
-        const wchar_t *exp, value_T *result, evalinfo_T *info, bool coerce)
+/* Evaluates the specified string as an arithmetic expression.
+ * If `coerce' is true, the result is `coerce_number'ed.
+ * The result may be of the VT_VAR type referring to a name in `exp' or in the
+ * cached copy of it.
+ * Returns true iff successful. On error, an error message is printed. */
+bool evaluate(const wchar_t *exp, value_T *result, bool coerce)
 {
-    info->exp = exp;
-    info->index = 0;
-    info->parseonly = false;
-    info->error = false;
-    info->savelocale = xstrdup(setlocale(LC_NUMERIC, NULL));
+    const acode_T *code = get_compiled_expression(exp);
+    if (code == NULL)
+        return interpret(exp, result, coerce);
 
-    next_token(info);
-    parse_assignment(info, result);
+    evalinfo_T info = { .error = false, };
+    execute(&info, code->nodes, code->count - 1, result);
     if (coerce)
-        coerce_number(info, result);
+        coerce_number(&info, result);
+    return !info.error;
+}
+
+/* Parses and evaluates the specified string as an arithmetic expression at
+ * a time. This function is used for expressions that cannot be compiled, in
+ * which case the error messages are printed by this function. */
+bool interpret(const wchar_t *exp, value_T *result, bool coerce)
+{
+    evalinfo_T info;
+    info.exp = exp;
+    info.index = 0;
+    info.parseonly = false;
+    info.error = false;
+    info.silent = false;
+    info.savelocale = xstrdup(setlocale(LC_NUMERIC, NULL));
+
+    next_token(&info);
+    parse_assignment(&info, result);
+    if (coerce)
+        coerce_number(&info, result);
+
+    free(info.savelocale);
 
-    free(info->savelocale);
+    if (info.error)
+        return false;
+    if (info.atoken.type != TT_NULL) {
+        xerror(0, Ngt("arithmetic: invalid syntax"));
+        return false;
+    }
+    return true;
+}
+
+/* Returns the compiled code for the specified expression, moving it to the
+ * front of the cache. If the expression is not cached yet, it is compiled and
+ * cached. Returns NULL if the expression cannot be compiled. */
+const acode_T *get_compiled_expression(const wchar_t *exp)
+{
+    for (size_t i = 0; i < ARITH_CACHE_SIZE; i++) {
+        acode_T *code = arith_cache[i];
+        if (code == NULL)
+            break;
+        if (code->posix != posixly_correct || wcscmp(code->exp, exp) != 0)
+            continue;
+
+        memmove(&arith_cache[1], &arith_cache[0], i * sizeof *arith_cache);
+        arith_cache[0] = code;
+        return code;
+    }
+
+    acode_T *code = compile(exp);
+    if (code == NULL)
+        return NULL;
+
+    if (arith_cache[ARITH_CACHE_SIZE - 1] != NULL)
+        free_compiled_expression(arith_cache[ARITH_CACHE_SIZE - 1]);
+    memmove(&arith_cache[1], &arith_cache[0],
+            (ARITH_CACHE_SIZE - 1) * sizeof *arith_cache);
+    arith_cache[0] = code;
+    return code;
+}
+
+/* Compiles the specified expression.
+ * Returns NULL without printing any error message if the expression has a
+ * syntax error. Expressions containing non-ASCII characters are not compiled
+ * because the result of tokenization would depend on the locale. */
+acode_T *compile(const wchar_t *exp)
+{
+    for (const wchar_t *s = exp; *s != L'\0'; s++)
+        if ((unsigned long) *s >= 0x80)
+            return NULL;
+
+    acode_T *code = xmalloc(sizeof *code);
+    code->exp = xwcsdup(exp);
+    code->posix = posixly_correct;
+    code->count = 0;
+    code->maxcount = 8;
+    code->nodes = xmallocn(code->maxcount, sizeof *code->nodes);
+
+    evalinfo_T info;
+    info.exp = code->exp;
+    info.index = 0;
+    info.parseonly = false;
+    info.error = false;
+    info.silent = true;
+    info.savelocale = xstrdup(setlocale(LC_NUMERIC, NULL));
+
+    next_token(&info);
+    bool ok = compile_assignment(&info, code) && info.atoken.type == TT_NULL;
+
+    free(info.savelocale);
+
+    if (!ok) {
+        free_compiled_expression(code);
+        return NULL;
+    }
+    return code;
+}
+
+/* Frees the specified compiled expression. */
+void free_compiled_expression(acode_T *code)
+{
+    free(code->exp);
+    free(code->nodes);
+    free(code);
 }
 
 /* Parses an assignment expression.
@@ -249,33 +411,46 @@ void parse_assignment(evalinfo_T *info, value_T *result)
     parse_conditional(info, result);
 
     atokentype_T ttype = info->atoken.type;
+    if (is_assignment_operator(ttype)) {
+        value_T rhs;
+        next_token(info);
+        parse_assignment(info, &rhs);
+        do_assignment_calculation(info, ttype, result, &rhs);
+    }
+}
+
+/* Tests if the specified token is an assignment operator. */
+bool is_assignment_operator(atokentype_T ttype)
+{
     switch (ttype) {
         case TT_EQUAL:          case TT_PLUSEQUAL:   case TT_MINUSEQUAL:
         case TT_ASTEREQUAL:     case TT_SLASHEQUAL:  case TT_PERCENTEQUAL:
         case TT_LESSLESSEQUAL:  case TT_GREATERGREATEREQUAL:
         case TT_AMPEQUAL:       case TT_HATEQUAL:    case TT_PIPEEQUAL:
-            {
-                value_T rhs;
-                next_token(info);
-                parse_assignment(info, &rhs);
-                if (result->type == VT_VAR) {
-                    word_T saveword = result->v_var;
-                    if (!do_binary_calculation(
-                                info, ttype, result, &rhs, result))
-                        break;
-                    if (!do_assignment(&saveword, result))
-                        info->error = true, result->type = VT_INVALID;
-                } else if (result->type != VT_INVALID) {
-                    /* TRANSLATORS: This error message is shown when the target
-                     * of an assignment is not a variable. */
-                    xerror(0, Ngt("arithmetic: cannot assign to a number"));
-                    info->error = true;
-                    result->type = VT_INVALID;
-                }
-                break;
-            }
+            return true;
         default:
-            break;
+            return false;
+    }
+}
+
+/* Applies the assignment operator `ttype' to operands `lhs' and `rhs'.
+ * The operands may be modified as a result of coercion. The assigned value is
+ * left in `*lhs' unless there is an error. */
+void do_assignment_calculation(evalinfo_T *info, atokentype_T ttype,
+        value_T *lhs, value_T *rhs)
+{
+    if (lhs->type == VT_VAR) {
+        word_T saveword = lhs->v_var;
+        if (!do_binary_calculation(info, ttype, lhs, rhs, lhs))
+            return;
+        if (!do_assignment(&saveword, lhs))
+            info->error = true, lhs->type = VT_INVALID;
+    } else if (lhs->type != VT_INVALID) {
+        /* TRANSLATORS: This error message is shown when the target
+         * of an assignment is not a variable. */
+        xerror(0, Ngt("arithmetic: cannot assign to a number"));
+        info->error = true;
+        lhs->type = VT_INVALID;
     }
 }
 
@@ -283,13 +458,15 @@ void parse_assignment(evalinfo_T *info, value_T *result)
  * Returns false on error. */
 bool do_assignment(const word_T *word, const value_T *value)
 {
-    wchar_t *vstr = value_to_string(value);
-    if (vstr == NULL)
-        return false;
-
     wchar_t name[word->length + 1];
     wmemcpy(name, word->contents, word->length);
     name[word->length] = L'\0';
+    if (value->type == VT_LONG)
+        return set_integer_variable(name, value->v_long);
+
+    wchar_t *vstr = value_to_string(value);
+    if (vstr == NULL)
+        return false;
     return set_variable(name, vstr, SCOPE_GLOBAL, false);
 }
 
@@ -759,22 +936,7 @@ void parse_equality(evalinfo_T *info, value_T *result)
             case TT_EXCLEQUAL:
                 next_token(info);
                 parse_relational(info, &rhs);
-                switch (coerce_type(info, result, &rhs)) {
-                    case VT_LONG:
-                        result->v_long = do_long_comparison(ttype,
-                                result->v_long, rhs.v_long);
-                        break;
-                    case VT_DOUBLE:
-                        result->v_long = do_double_comparison(ttype,
-                                result->v_double, rhs.v_double);
-                        result->type = VT_LONG;
-                        break;
-                    case VT_INVALID:
-                        result->type = VT_INVALID;
-                        break;
-                    case VT_VAR:
-                        assert(false);
-                }
+                do_comparison(info, ttype, result, &rhs);
                 break;
             default:
                 return;
@@ -782,6 +944,29 @@ void parse_equality(evalinfo_T *info, value_T *result)
     }
 }
 
+/* Compares operands `lhs' and `rhs' with the comparison operator `ttype'.
+ * The operands may be modified as a result of coercion. The result is assigned
+ * to `*lhs'. */
+void do_comparison(evalinfo_T *info, atokentype_T ttype,
+        value_T *lhs, value_T *rhs)
+{
+    switch (coerce_type(info, lhs, rhs)) {
+        case VT_LONG:
+            lhs->v_long = do_long_comparison(ttype, lhs->v_long, rhs->v_long);
+            break;
+        case VT_DOUBLE:
+            lhs->v_long = do_double_comparison(ttype,
+                    lhs->v_double, rhs->v_double);
+            lhs->type = VT_LONG;
+            break;
+        case VT_INVALID:
+            lhs->type = VT_INVALID;
+            break;
+        case VT_VAR:
+            assert(false);
+    }
+}
+
 /* Parses a relational expression.
  *   RelationalExp := ShiftExp
  *                  | RelationalExp "<" ShiftExp
@@ -801,22 +986,7 @@ void parse_relational(evalinfo_T *info, value_T *result)
             case TT_GREATEREQUAL:
                 next_token(info);
                 parse_shift(info, &rhs);
-                switch (coerce_type(info, result, &rhs)) {
-                    case VT_LONG:
-                        result->v_long = do_long_comparison(ttype,
-                                result->v_long, rhs.v_long);
-                        break;
-                    case VT_DOUBLE:
-                        result->v_long = do_double_comparison(ttype,
-                                result->v_double, rhs.v_double);
-                        result->type = VT_LONG;
-                        break;
-                    case VT_INVALID:
-                        result->type = VT_INVALID;
-                        break;
-                    case VT_VAR:
-                        assert(false);
-                }
+                do_comparison(info, ttype, result, &rhs);
                 break;
             default:
                 return;
@@ -905,70 +1075,83 @@ void parse_prefix(evalinfo_T *info, value_T *result)
     switch (ttype) {
         case TT_PLUSPLUS:
         case TT_MINUSMINUS:
+        case TT_PLUS:
+        case TT_MINUS:
+        case TT_TILDE:
+        case TT_EXCL:
             next_token(info);
             parse_prefix(info, result);
+            do_prefix_calculation(info, ttype, result);
+            break;
+        default:
+            parse_postfix(info, result);
+            break;
+    }
+}
+
+/* Applies the prefix operator `ttype' to the specified value. */
+void do_prefix_calculation(
+        evalinfo_T *info, atokentype_T ttype, value_T *value)
+{
+    switch (ttype) {
+        case TT_PLUSPLUS:
+        case TT_MINUSMINUS:
             if (posixly_correct) {
                 xerror(0, Ngt("arithmetic: operator `%ls' is not supported"),
                         (ttype == TT_PLUSPLUS) ? L"++" : L"--");
                 info->error = true;
-                result->type = VT_INVALID;
-            } else if (result->type == VT_VAR) {
-                word_T saveword = result->v_var;
-                coerce_number(info, result);
-                if (!do_increment_or_decrement(ttype, result) ||
-                        !do_assignment(&saveword, result))
-                    info->error = true, result->type = VT_INVALID;
-            } else if (result->type != VT_INVALID) {
+                value->type = VT_INVALID;
+            } else if (value->type == VT_VAR) {
+                word_T saveword = value->v_var;
+                coerce_number(info, value);
+                if (!do_increment_or_decrement(ttype, value) ||
+                        !do_assignment(&saveword, value))
+                    info->error = true, value->type = VT_INVALID;
+            } else if (value->type != VT_INVALID) {
                 /* TRANSLATORS: This error message is shown when the operand of
                  * the "++" or "--" operator is not a variable. */
                 xerror(0, Ngt("arithmetic: operator `%ls' requires a variable"),
-                        (info->atoken.type == TT_PLUSPLUS) ? L"++" : L"--");
+                        (ttype == TT_PLUSPLUS) ? L"++" : L"--");
                 info->error = true;
-                result->type = VT_INVALID;
+                value->type = VT_INVALID;
             }
             break;
         case TT_PLUS:
         case TT_MINUS:
-            next_token(info);
-            parse_prefix(info, result);
-            coerce_number(info, result);
+            coerce_number(info, value);
             if (ttype == TT_MINUS) {
-                switch (result->type) {
+                switch (value->type) {
                 case VT_LONG:
 #if LONG_MIN < -LONG_MAX
-                    if (result->v_long == LONG_MIN) {
+                    if (value->v_long == LONG_MIN) {
                         xerror(0, Ngt("arithmetic: overflow"));
                         info->error = true;
-                        result->type = VT_INVALID;
+                        value->type = VT_INVALID;
                         break;
                     }
 #endif
-                    result->v_long = -result->v_long;
+                    value->v_long = -value->v_long;
                     break;
-                case VT_DOUBLE:   result->v_double = -result->v_double;  break;
+                case VT_DOUBLE:   value->v_double = -value->v_double;  break;
                 case VT_INVALID:  break;
                 default:          assert(false);
                 }
             }
             break;
         case TT_TILDE:
-            next_token(info);
-            parse_prefix(info, result);
-            coerce_integer(info, result);
-            if (result->type == VT_LONG)
-                result->v_long = ~result->v_long;
+            coerce_integer(info, value);
+            if (value->type == VT_LONG)
+                value->v_long = ~value->v_long;
             break;
         case TT_EXCL:
-            next_token(info);
-            parse_prefix(info, result);
-            coerce_number(info, result);
-            switch (result->type) {
+            coerce_number(info, value);
+            switch (value->type) {
                 case VT_LONG:
-                    result->v_long = !result->v_long;
+                    value->v_long = !value->v_long;
                     break;
                 case VT_DOUBLE:
-                    result->type = VT_LONG;
-                    result->v_long = !result->v_double;
+                    value->type = VT_LONG;
+                    value->v_long = !value->v_double;
                     break;
                 case VT_INVALID:
                     break;
@@ -977,8 +1160,7 @@ void parse_prefix(evalinfo_T *info, value_T *result)
             }
             break;
         default:
-            parse_postfix(info, result);
-            break;
+            assert(false);
     }
 }
 
@@ -992,28 +1174,7 @@ void parse_postfix(evalinfo_T *info, value_T *result)
         switch (info->atoken.type) {
             case TT_PLUSPLUS:
             case TT_MINUSMINUS:
-                if (posixly_correct) {
-                    xerror(0,
-                            Ngt("arithmetic: operator `%ls' is not supported"),
-                            (info->atoken.type == TT_PLUSPLUS) ? L"++" : L"--");
-                    info->error = true;
-                    result->type = VT_INVALID;
-                } else if (result->type == VT_VAR) {
-                    word_T saveword = result->v_var;
-                    coerce_number(info, result);
-                    value_T value = *result;
-                    if (!do_increment_or_decrement(info->atoken.type, &value) ||
-                            !do_assignment(&saveword, &value)) {
-                        info->error = true;
-                        result->type = VT_INVALID;
-                    }
-                } else if (result->type != VT_INVALID) {
-                    xerror(0, Ngt("arithmetic: "
-                                "operator `%ls' requires a variable"),
-                            (info->atoken.type == TT_PLUSPLUS) ? L"++" : L"--");
-                    info->error = true;
-                    result->type = VT_INVALID;
-                }
+                do_postfix_calculation(info, info->atoken.type, result);
                 next_token(info);
                 break;
             default:
@@ -1022,6 +1183,32 @@ void parse_postfix(evalinfo_T *info, value_T *result)
     }
 }
 
+/* Applies the postfix operator `ttype' to the specified value. */
+void do_postfix_calculation(
+        evalinfo_T *info, atokentype_T ttype, value_T *value)
+{
+    if (posixly_correct) {
+        xerror(0, Ngt("arithmetic: operator `%ls' is not supported"),
+                (ttype == TT_PLUSPLUS) ? L"++" : L"--");
+        info->error = true;
+        value->type = VT_INVALID;
+    } else if (value->type == VT_VAR) {
+        word_T saveword = value->v_var;
+        coerce_number(info, value);
+        value_T newvalue = *value;
+        if (!do_increment_or_decrement(ttype, &newvalue) ||
+                !do_assignment(&saveword, &newvalue)) {
+            info->error = true;
+            value->type = VT_INVALID;
+        }
+    } else if (value->type != VT_INVALID) {
+        xerror(0, Ngt("arithmetic: operator `%ls' requires a variable"),
+                (ttype == TT_PLUSPLUS) ? L"++" : L"--");
+        info->error = true;
+        value->type = VT_INVALID;
+    }
+}
+
 /* Increment or decrement the specified value.
  * `ttype' must be either TT_PLUSPLUS or TT_MINUSMINUS and the `value' must be
  * `coerce_number'ed.
@@ -1121,7 +1308,8 @@ void parse_as_number(evalinfo_T *info, value_T *result)
             return;
         }
     }
-    xerror(0, Ngt("arithmetic: `%ls' is not a valid number"), wordstr);
+    if (!info->silent)
+        xerror(0, Ngt("arithmetic: `%ls' is not a valid number"), wordstr);
     info->error = true;
     result->type = VT_INVALID;
 }
@@ -1140,6 +1328,10 @@ void coerce_number(evalinfo_T *info, value_T *value)
         wchar_t namestr[name->length + 1];
         wmemcpy(namestr, name->contents, name->length);
         namestr[name->length] = L'\0';
+        if (getvar_integer(namestr, &value->v_long)) {
+            value->type = VT_LONG;
+            return;
+        }
         varvalue = getvar(namestr);
 
         if (varvalue == NULL && !shopt_unset) {
@@ -1442,8 +1634,9 @@ parse_identifier:;
                 info->atoken.word.contents = &info->exp[startindex];
                 info->atoken.word.length = info->index - startindex;
             } else {
-                xerror(0, Ngt("arithmetic: `%lc' is not "
-                            "a valid number or operator"), (wint_t) c);
+                if (!info->silent)
+                    xerror(0, Ngt("arithmetic: `%lc' is not "
+                                "a valid number or operator"), (wint_t) c);
                 info->error = true;
                 info->atoken.type = TT_INVALID;
             }
@@ -1451,6 +1644,296 @@ parse_identifier:;
     }
 }
 
+/* Compiles an assignment expression, appending nodes to `code'.
+ * Like the other `compile_*' functions, returns false on syntax error.
+ * See `parse_assignment' for the syntax. */
+bool compile_assignment(evalinfo_T *info, acode_T *code)
+{
+    if (!compile_conditional(info, code))
+        return false;
+
+    atokentype_T ttype = info->atoken.type;
+    if (!is_assignment_operator(ttype))
+        return true;
+
+    size_t lhs = code->count - 1;
+    next_token(info);
+    if (!compile_assignment(info, code))
+        return false;
+
+    size_t rhs = code->count - 1;
+    anode_T *node = add_node(code, AN_ASSIGNMENT, ttype);
+    node->operands[0] = lhs;
+    node->operands[1] = rhs;
+    return true;
+}
+
+/* Compiles a conditional expression.
+ * See `parse_conditional' for the syntax. */
+bool compile_conditional(evalinfo_T *info, acode_T *code)
+{
+    if (!compile_binary(info, code, 1))
+        return false;
+    if (info->atoken.type != TT_QUESTION)
+        return true;
+
+    size_t cond = code->count - 1;
+    next_token(info);
+    if (!compile_assignment(info, code))
+        return false;
+    if (info->atoken.type != TT_COLON)
+        return false;
+
+    size_t then = code->count - 1;
+    next_token(info);
+    if (!compile_conditional(info, code))
+        return false;
+
+    size_t else_ = code->count - 1;
+    anode_T *node = add_node(code, AN_CONDITIONAL, TT_QUESTION);
+    node->operands[0] = cond;
+    node->operands[1] = then;
+    node->operands[2] = else_;
+    return true;
+}
+
+/* Returns the precedence of the specified binary operator, which is 1 for the
+ * lowest "||" and 10 for the highest "*". Returns 0 if the token is not a
+ * binary operator. */
+int binary_operator_precedence(atokentype_T ttype)
+{
+    switch (ttype) {
+        case TT_PIPEPIPE:
+            return 1;
+        case TT_AMPAMP:
+            return 2;
+        case TT_PIPE:
+            return 3;
+        case TT_HAT:
+            return 4;
+        case TT_AMP:
+            return 5;
+        case TT_EQUALEQUAL:  case TT_EXCLEQUAL:
+            return 6;
+        case TT_LESS:  case TT_LESSEQUAL:  case TT_GREATER:  case TT_GREATEREQUAL:
+            return 7;
+        case TT_LESSLESS:  case TT_GREATERGREATER:
+            return 8;
+        case TT_PLUS:  case TT_MINUS:
+            return 9;
+        case TT_ASTER:  case TT_SLASH:  case TT_PERCENT:
+            return 10;
+        default:
+            return 0;
+    }
+}
+
+/* Compiles a sequence of left-associative binary operations whose operators
+ * are of the specified precedence or higher.
+ * See `parse_logical_or' through `parse_multiplicative' for the syntax. */
+bool compile_binary(evalinfo_T *info, acode_T *code, int precedence)
+{
+    if (precedence > 10)
+        return compile_prefix(info, code);
+
+    if (!compile_binary(info, code, precedence + 1))
+        return false;
+
+    for (;;) {
+        atokentype_T ttype = info->atoken.type;
+        if (binary_operator_precedence(ttype) != precedence)
+            return true;
+
+        size_t lhs = code->count - 1;
+        next_token(info);
+        if (!compile_binary(info, code, precedence + 1))
+            return false;
+
+        size_t rhs = code->count - 1;
+        anodetype_T type;
+        switch (precedence) {
+            case 1:  case 2:  type = AN_LOGICAL;     break;
+            case 6:  case 7:  type = AN_COMPARISON;  break;
+            default:          type = AN_BINARY;      break;
+        }
+        anode_T *node = add_node(code, type, ttype);
+        node->operands[0] = lhs;
+        node->operands[1] = rhs;
+    }
+}
+
+/* Compiles a prefix expression.
+ * See `parse_prefix' for the syntax. */
+bool compile_prefix(evalinfo_T *info, acode_T *code)
+{
+    atokentype_T ttype = info->atoken.type;
+    switch (ttype) {
+        case TT_PLUSPLUS:
+        case TT_MINUSMINUS:
+            if (posixly_correct)
+                return false;
+            /* falls thru! */
+        case TT_PLUS:
+        case TT_MINUS:
+        case TT_TILDE:
+        case TT_EXCL:
+            next_token(info);
+            if (!compile_prefix(info, code))
+                return false;
+            size_t operand = code->count - 1;
+            add_node(code, AN_PREFIX, ttype)->operands[0] = operand;
+            return true;
+        default:
+            return compile_postfix(info, code);
+    }
+}
+
+/* Compiles a postfix expression.
+ * See `parse_postfix' for the syntax. */
+bool compile_postfix(evalinfo_T *info, acode_T *code)
+{
+    if (!compile_primary(info, code))
+        return false;
+
+    for (;;) {
+        atokentype_T ttype = info->atoken.type;
+        switch (ttype) {
+            case TT_PLUSPLUS:
+            case TT_MINUSMINUS:
+                if (posixly_correct)
+                    return false;
+                size_t operand = code->count - 1;
+                add_node(code, AN_POSTFIX, ttype)->operands[0] = operand;
+                next_token(info);
+                break;
+            default:
+                return true;
+        }
+    }
+}
+
+/* Compiles a primary expression.
+ * See `parse_primary' for the syntax. Number literals are converted into
+ * values in this function. */
+bool compile_primary(evalinfo_T *info, acode_T *code)
+{
+    value_T value;
+    switch (info->atoken.type) {
+        case TT_LPAREN:
+            next_token(info);
+            if (!compile_assignment(info, code))
+                return false;
+            if (info->atoken.type != TT_RPAREN)
+                return false;
+            next_token(info);
+            return true;
+        case TT_NUMBER:
+            parse_as_number(info, &value);
+            if (info->error)
+                return false;
+            break;
+        case TT_IDENTIFIER:
+            value.type = VT_VAR;
+            value.v_var = info->atoken.word;
+            break;
+        default:
+            return false;
+    }
+    add_node(code, AN_VALUE, info->atoken.type)->value = value;
+    next_token(info);
+    return true;
+}
+
+/* Appends a new node to the compiled expression and returns a pointer to it.
+ * The operands of the node must be set by the caller. */
+anode_T *add_node(acode_T *code, anodetype_T type, atokentype_T op)
+{
+    if (code->count == code->maxcount) {
+        code->maxcount *= 2;
+        code->nodes = xreallocn(code->nodes, code->maxcount,
+                sizeof *code->nodes);
+    }
+
+    anode_T *node = &code->nodes[code->count++];
+    node->type = type;
+    node->op = op;
+    return node;
+}
+
+/* Evaluates the node at `index' of the compiled expression.
+ * The nodes are evaluated in the same order as `parse_assignment' would
+ * calculate them, so the results, including side effects and error messages,
+ * are the same as if the expression were parsed again. Operands of "&&", "||",
+ * and "?:" that would be only parsed are not evaluated at all. */
+void execute(evalinfo_T *info, const anode_T *nodes, size_t index,
+        value_T *result)
+{
+    const anode_T *node = &nodes[index];
+    value_T rhs;
+    bool value;
+
+    switch (node->type) {
+        case AN_VALUE:
+            *result = node->value;
+            break;
+        case AN_ASSIGNMENT:
+            execute(info, nodes, node->operands[0], result);
+            execute(info, nodes, node->operands[1], &rhs);
+            do_assignment_calculation(info, node->op, result, &rhs);
+            break;
+        case AN_CONDITIONAL:
+            execute(info, nodes, node->operands[0], result);
+            coerce_number(info, result);
+            switch (result->type) {
+                case VT_INVALID:  return;
+                case VT_LONG:     value = result->v_long;    break;
+                case VT_DOUBLE:   value = result->v_double;  break;
+                default:          assert(false);  return;
+            }
+            execute(info, nodes, node->operands[value ? 1 : 2], result);
+            break;
+        case AN_LOGICAL:
+            execute(info, nodes, node->operands[0], result);
+            coerce_number(info, result);
+            switch (result->type) {
+                case VT_INVALID:  return;
+                case VT_LONG:     value = result->v_long;    break;
+                case VT_DOUBLE:   value = result->v_double;  break;
+                default:          assert(false);  return;
+            }
+            if (value == (node->op == TT_AMPAMP)) {
+                execute(info, nodes, node->operands[1], result);
+                coerce_number(info, result);
+                switch (result->type) {
+                    case VT_INVALID:  return;
+                    case VT_LONG:     value = result->v_long;    break;
+                    case VT_DOUBLE:   value = result->v_double;  break;
+                    default:          assert(false);  return;
+                }
+            }
+            result->type = VT_LONG, result->v_long = value;
+            break;
+        case AN_BINARY:
+            execute(info, nodes, node->operands[0], result);
+            execute(info, nodes, node->operands[1], &rhs);
+            do_binary_calculation(info, node->op, result, &rhs, result);
+            break;
+        case AN_COMPARISON:
+            execute(info, nodes, node->operands[0], result);
+            execute(info, nodes, node->operands[1], &rhs);
+            do_comparison(info, node->op, result, &rhs);
+            break;
+        case AN_PREFIX:
+            execute(info, nodes, node->operands[0], result);
+            do_prefix_calculation(info, node->op, result);
+            break;
+        case AN_POSTFIX:
+            execute(info, nodes, node->operands[0], result);
+            do_postfix_calculation(info, node->op, result);
+            break;
+    }
+}
+
 /* Tests whether the multiplication of the given two long values will overflow.
  */
 bool long_mul_will_overflow(long v1, long v2)
@@ -36,12 +36,16 @@
 #include "job.h"
 #include "option.h"
 #include "path.h"
+#include "profiler.h"
 #include "sig.h"
 #include "strbuf.h"
 #include "util.h"
 #include "variable.h"
 #include "xfnmatch.h"
 #include "yash.h"
+#if YASH_ENABLE_LOADABLE
+# include "builtins/load.h"
+#endif
 #if YASH_ENABLE_PRINTF
 # include "builtins/printf.h"
 #endif
@@ -132,6 +136,8 @@ void init_builtin(void)
 #if YASH_ENABLE_ARRAY
     DEFBUILTIN("array", array_builtin, BI_EXTENSION, array_help, array_syntax,
             array_options);
+    DEFBUILTIN("mapfile", mapfile_builtin, BI_ELECTIVE, mapfile_help,
+            mapfile_syntax, mapfile_options);
 #endif
     DEFBUILTIN("unset", unset_builtin, BI_SPECIAL, unset_help, unset_syntax,
             unset_options);
@@ -164,9 +170,11 @@ void init_builtin(void)
     DEFBUILTIN("bg", fg_builtin, BI_MANDATORY, bg_help, bg_syntax,
             help_option);
     DEFBUILTIN("wait", wait_builtin, BI_MANDATORY, wait_help, wait_syntax,
-            help_option);
+            wait_options);
     DEFBUILTIN("disown", disown_builtin, BI_ELECTIVE, disown_help,
             disown_syntax, all_help_options);
+    DEFBUILTIN("poll", poll_builtin, BI_ELECTIVE, poll_help, poll_syntax,
+            poll_options);
 
     /* defined in "history.c" */
 #if YASH_ENABLE_HISTORY
@@ -194,6 +202,12 @@ void init_builtin(void)
             command_options);
     DEFBUILTIN("times", times_builtin, BI_SPECIAL, times_help, times_syntax,
             help_option);
+    DEFBUILTIN("coproc", coproc_builtin, BI_ELECTIVE, coproc_help,
+            coproc_syntax, coproc_options);
+
+    /* defined in "profiler.c" */
+    DEFBUILTIN("stats", stats_builtin, BI_EXTENSION, stats_help, stats_syntax,
+            stats_options);
 
     /* defined in "yash.c" */
     DEFBUILTIN("exit", exit_builtin, BI_SPECIAL, exit_help, exit_syntax,
@@ -201,6 +215,12 @@ void init_builtin(void)
     DEFBUILTIN("suspend", suspend_builtin, BI_ELECTIVE, suspend_help,
             suspend_syntax, force_help_options);
 
+    /* defined in "builtins/load.c" */
+#if YASH_ENABLE_LOADABLE
+    DEFBUILTIN("load", load_builtin, BI_EXTENSION, load_help, load_syntax,
+            load_options);
+#endif
+
     /* defined in "builtins/ulimit.c" */
 #if YASH_ENABLE_ULIMIT
     DEFBUILTIN("ulimit", ulimit_builtin, BI_MANDATORY, ulimit_help,
@@ -244,6 +264,24 @@ const builtin_T *get_builtin(const char *name)
     return ht_get(&builtins, name).value;
 }
 
+/* Adds a built-in of the specified name, which must not be defined yet.
+ * `name' and `bi' must remain valid until the built-in is removed by
+ * `remove_builtin'. */
+void add_builtin(const char *name, const builtin_T *bi)
+{
+    assert(get_builtin(name) == NULL);
+    ht_set(&builtins, name, bi);
+    command_generation++;
+}
+
+/* Removes the built-in of the specified name. */
+void remove_builtin(const char *name)
+{
+    assert(get_builtin(name) != NULL);
+    ht_remove(&builtins, name);
+    command_generation++;
+}
+
 /* Prints the following error message and returns Exit_ERROR:
  * "the -X option cannot be used with the -Y option",
  * where X and Y are `opt1' and `opt2', respectively. */
@@ -46,6 +46,10 @@ typedef struct builtin_T {
 extern void init_builtin(void);
 extern const builtin_T *get_builtin(const char *name)
     __attribute__((pure));
+extern void add_builtin(const char *name, const builtin_T *bi)
+    __attribute__((nonnull));
+extern void remove_builtin(const char *name)
+    __attribute__((nonnull));
 
 extern int mutually_exclusive_option_error(wchar_t opt1, wchar_t opt2);
 extern _Bool validate_operand_count(size_t count, size_t min, size_t max);
@@ -0,0 +1,266 @@
+/* Yash: yet another shell */
+/* load.c: load builtin */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include "../common.h"
+#include "load.h"
+#include <dlfcn.h>
+#include <errno.h>
+#if HAVE_GETTEXT
+# include <libintl.h>
+#endif
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "../builtin.h"
+#include "../exec.h"
+#include "../strbuf.h"
+#include "../util.h"
+#include "loadable.h"
+
+
+/* A module loaded by the "load" built-in */
+typedef struct module_T {
+    struct module_T *next;
+    void *handle;                        /* handle returned by `dlopen' */
+    wchar_t *name;                       /* operand of the "load" built-in */
+    const struct yash_loadable_T *defs;  /* built-ins the module defines */
+    size_t count;                        /* number of elements in `defs' */
+    builtin_T builtins[];                /* built-ins added to the shell */
+} module_T;
+
+static bool load_module(const wchar_t *name)
+    __attribute__((nonnull));
+static bool count_module_builtins(const wchar_t *name,
+        const struct yash_loadable_T *defs, size_t *countp)
+    __attribute__((nonnull));
+static bool unload_module(const wchar_t *name)
+    __attribute__((nonnull));
+static module_T **find_module(const wchar_t *name)
+    __attribute__((nonnull,pure));
+static bool print_modules(void);
+
+
+/* The list of the loaded modules in the order of loading */
+static module_T *modules = NULL;
+
+
+/* Loads the module of the specified pathname and adds the built-ins it defines.
+ * On error, an error message is printed and false is returned. */
+bool load_module(const wchar_t *name)
+{
+    if (*find_module(name) != NULL) {
+        xerror(0, Ngt("module `%ls' is already loaded"), name);
+        return false;
+    }
+
+    char *mbsname = malloc_wcstombs(name);
+    if (mbsname == NULL) {
+        xerror(EILSEQ, Ngt("unexpected error"));
+        return false;
+    }
+    void *handle = dlopen(mbsname, RTLD_NOW | RTLD_LOCAL);
+    free(mbsname);
+    if (handle == NULL) {
+        xerror(0, Ngt("cannot load module `%ls': %s"), name, dlerror());
+        return false;
+    }
+
+    const int *version = dlsym(handle, "yash_loadable_version");
+    const struct yash_loadable_T *defs =
+        dlsym(handle, "yash_loadable_builtins");
+    if (version == NULL || defs == NULL) {
+        xerror(0, Ngt("`%ls' is not a module for the shell"), name);
+        goto fail;
+    }
+    if (*version != YASH_LOADABLE_VERSION) {
+        xerror(0, Ngt("module `%ls' has unsupported version %d"),
+                name, *version);
+        goto fail;
+    }
+
+    size_t count;
+    if (!count_module_builtins(name, defs, &count))
+        goto fail;
+
+    module_T *module =
+        xmallocs(sizeof *module, count, sizeof *module->builtins);
+    module->next = NULL;
+    module->handle = handle;
+    module->name = xwcsdup(name);
+    module->defs = defs;
+    module->count = count;
+    for (size_t i = 0; i < count; i++) {
+        builtin_T *bi = &module->builtins[i];
+        bi->body = defs[i].body;
+        bi->type = (defs[i].type == YASH_LOADABLE_SUBSTITUTIVE)
+            ? BI_SUBSTITUTIVE : BI_EXTENSION;
+#if YASH_ENABLE_HELP
+        bi->help_text = (defs[i].help_text != NULL)
+            ? defs[i].help_text : Ngt("built-in loaded from a module");
+        bi->syntax_text = (defs[i].syntax_text != NULL)
+            ? defs[i].syntax_text : "\n";
+        bi->options = NULL;
+#endif
+        add_builtin(defs[i].name, bi);
+    }
+
+    module_T **lastp = &modules;
+    while (*lastp != NULL)
+        lastp = &(*lastp)->next;
+    *lastp = module;
+    return true;
+
+fail:
+    dlclose(handle);
+    return false;
+}
+
+/* Counts the built-ins in the `yash_loadable_builtins' array of a module and
+ * assigns the count to `*countp'. If any of the built-ins is invalid or its
+ * name is already used by another built-in, an error message is printed and
+ * false is returned. */
+bool count_module_builtins(const wchar_t *name,
+        const struct yash_loadable_T *defs, size_t *countp)
+{
+    size_t count;
+    for (count = 0; defs[count].name != NULL; count++) {
+        const struct yash_loadable_T *def = &defs[count];
+        if (def->body == NULL || (def->type != YASH_LOADABLE_EXTENSION &&
+                    def->type != YASH_LOADABLE_SUBSTITUTIVE)) {
+            xerror(0, Ngt("module `%ls' defines invalid built-in `%s'"),
+                    name, def->name);
+            return false;
+        }
+        if (get_builtin(def->name) != NULL) {
+            xerror(0, Ngt("built-in `%s' is already defined"), def->name);
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (strcmp(defs[i].name, def->name) == 0) {
+                xerror(0, Ngt("module `%ls' defines built-in `%s' twice"),
+                        name, def->name);
+                return false;
+            }
+        }
+    }
+    *countp = count;
+    return true;
+}
+
+/* Removes the built-ins of the module of the specified name and unloads the
+ * module. On error, an error message is printed and false is returned. */
+bool unload_module(const wchar_t *name)
+{
+    module_T **modulep = find_module(name);
+    module_T *module = *modulep;
+    if (module == NULL) {
+        xerror(0, Ngt("module `%ls' is not loaded"), name);
+        return false;
+    }
+
+    for (size_t i = 0; i < module->count; i++)
+        remove_builtin(module->defs[i].name);
+    *modulep = module->next;
+    dlclose(module->handle);
+    free(module->name);
+    free(module);
+    return true;
+}
+
+/* Returns a pointer to the link to the module of the specified name in the
+ * module list. If there is no such module, the returned pointer points to the
+ * null pointer at the end of the list. */
+module_T **find_module(const wchar_t *name)
+{
+    module_T **modulep = &modules;
+    while (*modulep != NULL && wcscmp((*modulep)->name, name) != 0)
+        modulep = &(*modulep)->next;
+    return modulep;
+}
+
+/* Prints the names of the loaded modules to the standard output.
+ * Returns true iff successful. */
+bool print_modules(void)
+{
+    for (const module_T *module = modules; module != NULL;
+            module = module->next)
+        if (!xprintf("%ls\n", module->name))
+            return false;
+    return true;
+}
+
+/* Options for the "load" built-in. */
+const struct xgetopt_T load_options[] = {
+    { L'u', L"unload", OPTARG_NONE, true,  NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help",   OPTARG_NONE, false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "load" built-in, which accepts the following option:
+ *  -u: unload the modules instead of loading them */
+int load_builtin(int argc, void **argv)
+{
+    bool unload = false;
+
+    const struct xgetopt_T *opt;
+    xoptind = 0;
+    while ((opt = xgetopt(argv, load_options, 0)) != NULL) {
+        switch (opt->shortopt) {
+            case L'u':  unload = true;  break;
+#if YASH_ENABLE_HELP
+            case L'-':
+                return print_builtin_help(ARGV(0));
+#endif
+            default:
+                return Exit_ERROR;
+        }
+    }
+
+    if (xoptind == argc) {
+        if (unload)
+            return insufficient_operands_error(1);
+        return print_modules() ? Exit_SUCCESS : Exit_FAILURE;
+    }
+
+    for (; xoptind < argc; xoptind++) {
+        if (unload)
+            unload_module(ARGV(xoptind));
+        else
+            load_module(ARGV(xoptind));
+    }
+
+    return (yash_error_message_count == 0) ? Exit_SUCCESS : Exit_FAILURE;
+}
+
+#if YASH_ENABLE_HELP
+const char load_help[] = Ngt(
+"load or unload modules that define built-ins"
+);
+const char load_syntax[] = Ngt(
+"\tload module...\n"
+"\tload -u module...\n"
+"\tload\n"
+);
+#endif
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
@@ -0,0 +1,74 @@
+/* Yash: yet another shell */
+/* loadable.h: interface of modules for the load built-in */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+/* This header defines the interface between the shell and modules loaded by
+ * the "load" built-in. It does not depend on any other header of the shell, so
+ * module sources may include a copy of it.
+ *
+ * A module is a shared object that defines the following two objects:
+ *
+ *   const int yash_loadable_version = YASH_LOADABLE_VERSION;
+ *   const struct yash_loadable_T yash_loadable_builtins[] = {
+ *       { "name", name_builtin, YASH_LOADABLE_EXTENSION, NULL, NULL, },
+ *       ...
+ *       { NULL, NULL, 0, NULL, NULL, },
+ *   };
+ *
+ * The array is terminated by an element whose `name' is a null pointer.
+ *
+ * A built-in is called like `main', but the elements of `argv' are wide strings
+ * (wchar_t *) rather than multibyte strings. `argc' is at least one and
+ * `argv[0]' is the command name. The built-in may rearrange `argv' and change
+ * the strings but must not free or reallocate them. The return value is the
+ * exit status of the built-in. The built-in may write to the standard output
+ * and error by the functions of <stdio.h>, but must not use any other function
+ * or variable of the shell. */
+
+#ifndef YASH_LOADABLE_H
+#define YASH_LOADABLE_H
+
+
+/* The version of the interface, which is incremented whenever the structure
+ * below is changed incompatibly. */
+#define YASH_LOADABLE_VERSION 1
+
+/* Types of loadable built-ins */
+enum yash_loadable_type_T {
+    /* A built-in that is used unless the shell is in the POSIXly-correct
+     * mode */
+    YASH_LOADABLE_EXTENSION,
+    /* A built-in that is used only if an external command of the same name is
+     * found in $PATH */
+    YASH_LOADABLE_SUBSTITUTIVE,
+};
+
+/* A built-in defined in a module */
+struct yash_loadable_T {
+    const char *name;
+    int (*body)(int argc, void **argv);
+    int type;                 /* enum yash_loadable_type_T */
+    const char *help_text;    /* one-line description (may be null) */
+    const char *syntax_text;  /* usage, each line starting with a tab
+                                 (may be null) */
+};
+
+
+#endif /* YASH_LOADABLE_H */
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
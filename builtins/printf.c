@@ -25,6 +25,7 @@
 # include <libintl.h>
 #endif
 #include <limits.h>
+#include <locale.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -34,6 +35,7 @@
 #include "../builtin.h"
 #include "../exec.h"
 #include "../option.h"
+#include "../redir.h"
 #include "../strbuf.h"
 #include "../util.h"
 #include "../variable.h"
@@ -78,6 +80,8 @@ enum printf_result_T { PR_OK, PR_OK_END, PR_ERROR, };
 static enum printf_result_T echo_parse_escape(const wchar_t *restrict s,
         xstrbuf_T *restrict buf, mbstate_t *restrict st)
     __attribute__((nonnull));
+static const struct format_T *get_format(const wchar_t *format)
+    __attribute__((nonnull));
 static bool printf_parse_format(
         const wchar_t *format, struct format_T **resultp)
     __attribute__((nonnull));
@@ -90,6 +94,9 @@ static enum printf_result_T printf_printf(
         const struct format_T *format, const wchar_t *arg, xstrbuf_T *buf)
     __attribute__((nonnull(1,3)));
 static uintmax_t printf_parse_integer(const wchar_t *arg, bool is_signed);
+static void printf_cat_integer(
+        xstrbuf_T *buf, uintmax_t value, bool is_signed, unsigned base)
+    __attribute__((nonnull));
 static enum printf_result_T printf_print_escape(
         const struct format_T *format, const wchar_t *arg, xstrbuf_T *buf)
     __attribute__((nonnull));
@@ -196,7 +203,7 @@ print:
     if (ferror(stdout))
         goto error;
 
-    if (fflush(stdout) != 0)
+    if (!is_stdout_deferrable() && fflush(stdout) != 0)
         goto error;
 
     sb_destroy(&buf);
@@ -292,11 +299,9 @@ int printf_builtin(int argc, void **argv)
         return insufficient_operands_error(1);
 
     /* parse the format string */
-    struct format_T *format = NULL;
-    if (!printf_parse_format(ARGV(xoptind), &format)) {
-        freeformat(format);
+    const struct format_T *format = get_format(ARGV(xoptind));
+    if (format == NULL)
         return Exit_FAILURE;
-    }
     xoptind++;
 
     /* format the operands */
@@ -305,7 +310,7 @@ int printf_builtin(int argc, void **argv)
     sb_init(&buf);
     do {
         oldoptind = xoptind;
-        for (struct format_T *f = format; f != NULL; f = f->next) {
+        for (const struct format_T *f = format; f != NULL; f = f->next) {
             switch (printf_printf(f, ARGV(xoptind), &buf)) {
                 case PR_OK:      break;
                 case PR_OK_END:  goto print;
@@ -315,15 +320,13 @@ int printf_builtin(int argc, void **argv)
     } while (xoptind < argc && xoptind != oldoptind);
 
 print:
-    freeformat(format);
-
     /* print the result to the standard output */
     clearerr(stdout);
     fwrite(buf.contents, sizeof *buf.contents, buf.length, stdout);
     if (ferror(stdout))
         goto error;
 
-    if (fflush(stdout) != 0)
+    if (!is_stdout_deferrable() && fflush(stdout) != 0)
         goto error;
 
     sb_destroy(&buf);
@@ -335,6 +338,67 @@ error:
     return Exit_FAILURE;
 }
 
+/* The number of parsed formats remembered by `get_format'. */
+#define FORMAT_CACHE_SIZE 4
+
+/* Returns the parsed form of the specified format for the "printf" built-in.
+ * The results for the most recently used formats are cached, most recent
+ * first, so that a format used repeatedly, typically in a loop, is parsed only
+ * once. The cache is cleared when the LC_CTYPE locale changes because the
+ * literal parts of the format are converted to multibyte strings.
+ * The returned format must not be modified or freed by the caller.
+ * On error, an error message is printed and NULL is returned. */
+const struct format_T *get_format(const wchar_t *format)
+{
+    static struct {
+        wchar_t *string;
+        struct format_T *format;
+    } cache[FORMAT_CACHE_SIZE];
+    static char *cachelocale = NULL;
+
+    const char *locale = setlocale(LC_CTYPE, NULL);
+    if (locale == NULL || cachelocale == NULL
+            || strcmp(locale, cachelocale) != 0) {
+        for (size_t i = 0; i < FORMAT_CACHE_SIZE; i++) {
+            free(cache[i].string);
+            freeformat(cache[i].format);
+            cache[i].string = NULL;
+            cache[i].format = NULL;
+        }
+        free(cachelocale);
+        cachelocale = (locale != NULL) ? xstrdup(locale) : NULL;
+    }
+
+    size_t i;
+    for (i = 0; i < FORMAT_CACHE_SIZE - 1; i++)
+        if (cache[i].string == NULL || wcscmp(cache[i].string, format) == 0)
+            break;
+
+    if (cache[i].string == NULL || wcscmp(cache[i].string, format) != 0) {
+        struct format_T *result = NULL;
+        if (!printf_parse_format(format, &result)) {
+            freeformat(result);
+            return NULL;
+        }
+
+        /* discard the least recently used entry */
+        free(cache[i].string);
+        freeformat(cache[i].format);
+        cache[i].string = xwcsdup(format);
+        cache[i].format = result;
+    }
+
+    /* move the entry to the front */
+    if (i > 0) {
+        wchar_t *string = cache[i].string;
+        struct format_T *result = cache[i].format;
+        memmove(&cache[1], &cache[0], i * sizeof *cache);
+        cache[0].string = string;
+        cache[0].format = result;
+    }
+    return cache[0].format;
+}
+
 /* Parses the format for the "printf" built-in.
  * If successful, a pointer to the result is assigned to `*resultp' and true is
  * returned.
@@ -620,6 +684,17 @@ enum printf_result_T printf_printf(
                 xoptind++;
             else
                 arg = L"";
+            if (format->value.convspec[3] == '\0') {
+                /* fast path for plain "%s" */
+                size_t length = buf->length;
+                mbstate_t state;
+                memset(&state, 0, sizeof state);
+                if (sb_wcscat(buf, arg, &state) != NULL) {
+                    sb_truncate(buf, length);
+                    return PR_ERROR;
+                }
+                return PR_OK;
+            }
             if (sb_printf(buf, format->value.convspec, arg) < 0)
                 return PR_ERROR;
             return PR_OK;
@@ -631,11 +706,29 @@ enum printf_result_T printf_printf(
             }
             return PR_OK;
         case FT_INT:
+            if (format->value.convspec[3] == '\0') {
+                /* fast path for plain "%d" and "%i" */
+                printf_cat_integer(
+                        buf, printf_parse_integer(arg, true), true, 10);
+                return PR_OK;
+            }
             if (sb_printf(buf, format->value.convspec,
                         printf_parse_integer(arg, true)) < 0)
                 return PR_ERROR;
             return PR_OK;
         case FT_UINT:
+            switch (format->value.convspec[3] == '\0'
+                    ? format->value.convspec[2] : '\0') {
+                /* fast path for plain "%u" and "%x" */
+                case 'u':
+                    printf_cat_integer(
+                            buf, printf_parse_integer(arg, false), false, 10);
+                    return PR_OK;
+                case 'x':
+                    printf_cat_integer(
+                            buf, printf_parse_integer(arg, false), false, 16);
+                    return PR_OK;
+            }
             if (sb_printf(buf, format->value.convspec,
                         printf_parse_integer(arg, false)) < 0)
                 return PR_ERROR;
@@ -696,6 +789,27 @@ uintmax_t printf_parse_integer(const wchar_t *arg, bool is_signed)
     return value;
 }
 
+/* Appends the specified integer to buffer `buf' in the specified base (10 or
+ * 16) without any padding. The result is the same as that of the "%jd", "%ju"
+ * or "%jx" conversion specification. */
+void printf_cat_integer(
+        xstrbuf_T *buf, uintmax_t value, bool is_signed, unsigned base)
+{
+    char digits[sizeof value * CHAR_BIT + 1];
+    char *p = &digits[sizeof digits];
+    bool negative = is_signed && (intmax_t) value < 0;
+
+    if (negative)
+        value = -value;
+    do {
+        *--p = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value > 0);
+    if (negative)
+        *--p = '-';
+    sb_ncat_force(buf, p, &digits[sizeof digits] - p);
+}
+
 /* Prints the specified string that may include escape sequences and formats it
  * in the specified format. */
 enum printf_result_T printf_print_escape(
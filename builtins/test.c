@@ -54,10 +54,28 @@ enum filecmp {
     FC_ID, FC_SAME, FC_NEWER, FC_OLDER, FC_UNKNOWN,
 };
 
+/* entry of the file stat cache */
+struct statcache_T {
+    char *path;              /* NULL if the entry is not in use */
+    bool stat_done, stat_ok;
+    bool lstat_done, lstat_ok;
+    struct stat st, lst;
+};
+#define STAT_CACHE_SIZE 4
+
 static inline bool test_single(void *args[static 1]);
 static bool test_double(void *args[static 2]);
 static bool test_file(wchar_t type, const char *file)
     __attribute__((nonnull));
+static void enter_stat_cache(void);
+static void leave_stat_cache(void);
+static void clear_stat_cache(void);
+static struct statcache_T *get_stat_cache_entry(const char *path)
+    __attribute__((nonnull));
+static bool cached_stat(const char *path, struct stat *st)
+    __attribute__((nonnull));
+static bool cached_lstat(const char *path, struct stat *st)
+    __attribute__((nonnull));
 static bool test_triple(void *args[static 3]);
 static bool test_long_or(struct test_state *state)
     __attribute__((nonnull));
@@ -99,6 +117,8 @@ static wchar_t *quote_removal_for_regex(const wchar_t *s, const char *cc)
     __attribute__((nonnull,malloc,warn_unused_result));
 static const wchar_t *skip_bracket(const wchar_t *s)
     __attribute__((nonnull,pure,warn_unused_result));
+static bool word_contains_command_substitution(const wordunit_T *w)
+    __attribute__((pure));
 #endif
 
 
@@ -118,6 +138,7 @@ int test_builtin(int argc, void **argv)
     struct test_state state;
     bool result;
 
+    enter_stat_cache();
     switch (argc) {
         case 0:  result = false;                 break;
         case 1:  result = test_single(argv);     break;
@@ -143,6 +164,7 @@ int test_builtin(int argc, void **argv)
                         (const wchar_t *) state.args[state.index]);
             break;
     }
+    leave_stat_cache();
 
     if (yash_error_message_count > 0)
         return Exit_TESTERROR;
@@ -197,9 +219,6 @@ bool test_double(void *args[static 2])
 /* An auxiliary function for file type checking. */
 bool test_file(wchar_t type, const char *file) {
     switch (type) {
-        case L'd':  return is_directory(file);
-        case L'e':  return is_file(file);
-        case L'f':  return is_regular_file(file);
         case L'r':  return is_readable(file);
         case L'w':  return is_writable(file);
         case L'x':  return is_executable(file);
@@ -209,18 +228,24 @@ bool test_file(wchar_t type, const char *file) {
     switch (type) {
         case L'h':
         case L'L':
-            return (lstat(file, &st) == 0) && S_ISLNK(st.st_mode);
+            return cached_lstat(file, &st) && S_ISLNK(st.st_mode);
 #if !HAVE_S_ISVTX
         case L'k':
             return false;
 #endif
     }
 
-    if (stat(file, &st) < 0)
+    if (!cached_stat(file, &st))
         return false;
     switch (type) {
         case L'b':
             return S_ISBLK(st.st_mode);
+        case L'd':
+            return S_ISDIR(st.st_mode);
+        case L'e':
+            return true;
+        case L'f':
+            return S_ISREG(st.st_mode);
         case L'c':
             return S_ISCHR(st.st_mode);
         case L'G':
@@ -262,6 +287,94 @@ bool test_file(wchar_t type, const char *file) {
     assert(false);
 }
 
+/* The file stat cache holds the results of `stat' and `lstat' for the files
+ * tested in one invocation of the test built-in or one double-bracket command,
+ * so that an expression like `[[ -f $file && -s $file ]]' calls `stat' only
+ * once for the file. The cache is active between `enter_stat_cache' and
+ * `leave_stat_cache' and is emptied when the outermost scope is left. */
+static struct statcache_T stat_cache[STAT_CACHE_SIZE];
+/* index of the entry to be reused next when the cache is full */
+static size_t stat_cache_next = 0;
+/* nesting level of the active scopes of the cache */
+static unsigned stat_cache_depth = 0;
+
+/* Starts a scope in which `stat' results are cached. */
+void enter_stat_cache(void)
+{
+    stat_cache_depth++;
+}
+
+/* Ends a scope started by `enter_stat_cache'. */
+void leave_stat_cache(void)
+{
+    assert(stat_cache_depth > 0);
+    if (--stat_cache_depth == 0)
+        clear_stat_cache();
+}
+
+/* Forgets all the cached `stat' results. */
+void clear_stat_cache(void)
+{
+    for (size_t i = 0; i < STAT_CACHE_SIZE; i++) {
+        free(stat_cache[i].path);
+        stat_cache[i].path = NULL;
+    }
+    stat_cache_next = 0;
+}
+
+/* Returns the cache entry for the specified file, creating a new one if there
+ * is none. Returns NULL if the cache is not active. */
+struct statcache_T *get_stat_cache_entry(const char *path)
+{
+    if (stat_cache_depth == 0)
+        return NULL;
+
+    for (size_t i = 0; i < STAT_CACHE_SIZE; i++)
+        if (stat_cache[i].path != NULL && strcmp(stat_cache[i].path, path) == 0)
+            return &stat_cache[i];
+
+    struct statcache_T *e = &stat_cache[stat_cache_next];
+    stat_cache_next = (stat_cache_next + 1) % STAT_CACHE_SIZE;
+    free(e->path);
+    e->path = xstrdup(path);
+    e->stat_done = e->lstat_done = false;
+    return e;
+}
+
+/* Calls `stat' for the specified file, reusing the cached result if any.
+ * Returns true iff successful, in which case the result is stored in `*st'. */
+bool cached_stat(const char *path, struct stat *st)
+{
+    struct statcache_T *e = get_stat_cache_entry(path);
+    if (e == NULL)
+        return stat(path, st) == 0;
+
+    if (!e->stat_done) {
+        e->stat_ok = stat(path, &e->st) == 0;
+        e->stat_done = true;
+    }
+    if (e->stat_ok)
+        *st = e->st;
+    return e->stat_ok;
+}
+
+/* Calls `lstat' for the specified file, reusing the cached result if any.
+ * Returns true iff successful, in which case the result is stored in `*st'. */
+bool cached_lstat(const char *path, struct stat *st)
+{
+    struct statcache_T *e = get_stat_cache_entry(path);
+    if (e == NULL)
+        return lstat(path, st) == 0;
+
+    if (!e->lstat_done) {
+        e->lstat_ok = lstat(path, &e->lst) == 0;
+        e->lstat_done = true;
+    }
+    if (e->lstat_ok)
+        *st = e->lst;
+    return e->lstat_ok;
+}
+
 /* Tests the specified three-token expression. */
 bool test_triple(void *args[static 3])
 {
@@ -656,7 +769,7 @@ enum filecmp compare_files(const wchar_t *left, const wchar_t *right)
         xerror(EILSEQ, Ngt("unexpected error"));
         return FC_UNKNOWN;
     }
-    sl_ok = stat(mbsfile, &sl) >= 0;
+    sl_ok = cached_stat(mbsfile, &sl);
     free(mbsfile);
 
     mbsfile = malloc_wcstombs(right);
@@ -664,7 +777,7 @@ enum filecmp compare_files(const wchar_t *left, const wchar_t *right)
         xerror(EILSEQ, Ngt("unexpected error"));
         return FC_UNKNOWN;
     }
-    sr_ok = stat(mbsfile, &sr) >= 0;
+    sr_ok = cached_stat(mbsfile, &sr);
     free(mbsfile);
 
     if (!sl_ok)
@@ -725,7 +838,10 @@ int exec_double_bracket(const command_T *c)
     assert(c->c_type == CT_BRACKET);
 
     yash_error_message_count = 0;
-    return eval_dbexp(c->c_dbexp);
+    enter_stat_cache();
+    int result = eval_dbexp(c->c_dbexp);
+    leave_stat_cache();
+    return result;
 }
 
 /* Evaluates the expression of a double-bracket command.
@@ -795,6 +911,8 @@ int eval_dbexp(const dbexp_T *e)
 /* Expands the operand of a primary, but without quote removal. */
 cc_word_T expand_double_bracket_operand(const wordunit_T *w)
 {
+    if (word_contains_command_substitution(w))
+        clear_stat_cache();
     return expand_single_cc(w, TT_SINGLE, Q_WORD);
 }
 
@@ -802,9 +920,42 @@ cc_word_T expand_double_bracket_operand(const wordunit_T *w)
  * The result is literal (does not contain backslash escapes). */
 wchar_t *expand_double_bracket_operand_unescaped(const wordunit_T *w)
 {
+    if (word_contains_command_substitution(w))
+        clear_stat_cache();
     return expand_single(w, TT_SINGLE, Q_WORD, ES_NONE);
 }
 
+/* Checks if the specified word contains a command substitution. A command
+ * substitution may modify the file system, so the file stat cache must be
+ * cleared before expanding such a word. */
+bool word_contains_command_substitution(const wordunit_T *w)
+{
+    for (; w != NULL; w = w->next) {
+        switch (w->wu_type) {
+            case WT_STRING:
+                break;
+            case WT_PARAM:;
+                const paramexp_T *p = w->wu_param;
+                if ((p->pe_type & PT_NEST)
+                        && word_contains_command_substitution(p->pe_nest))
+                    return true;
+                if (word_contains_command_substitution(p->pe_start)
+                        || word_contains_command_substitution(p->pe_end)
+                        || word_contains_command_substitution(p->pe_match)
+                        || word_contains_command_substitution(p->pe_subst))
+                    return true;
+                break;
+            case WT_CMDSUB:
+                return true;
+            case WT_ARITH:
+                if (word_contains_command_substitution(w->wu_arith))
+                    return true;
+                break;
+        }
+    }
+    return false;
+}
+
 /* Tests the specified three-token (binary) primary in the double-bracket
  * command. The left-hand-side must be given literal (with quote removal already
  * performed) while the right-hand-side quoted (without quote removal). */
@@ -30,14 +30,20 @@
 # include <paths.h>
 #endif
 #include <signal.h>
+#if HAVE_POSIX_SPAWN
+# include <spawn.h>
+#endif
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/times.h>
+#include <time.h>
 #include <unistd.h>
 #include <wchar.h>
+#include <wctype.h>
 #include "alias.h"
 #include "builtin.h"
 #include "expand.h"
@@ -50,6 +56,7 @@
 #include "parser.h"
 #include "path.h"
 #include "plist.h"
+#include "profiler.h"
 #include "redir.h"
 #include "sig.h"
 #include "strbuf.h"
@@ -57,6 +64,9 @@
 #include "variable.h"
 #include "xfnmatch.h"
 #include "yash.h"
+#if YASH_ENABLE_PRINTF
+# include "builtins/printf.h"
+#endif
 #if YASH_ENABLE_DOUBLE_BRACKET
 # include "builtins/test.h"
 #endif
@@ -129,6 +139,19 @@ typedef enum exception_T {
     E_CONTINUE_ITERATION,
 } exception_T;
 
+/* state of the measurement of a pipeline prefixed by the "time" keyword */
+typedef struct timing_T {
+    double  real;               /* elapsed real time in seconds */
+    usage_T self, children;     /* resource usage at the start */
+} timing_T;
+
+/* the shell's end of a pipe connected to a coprocess */
+typedef struct coprocfd_T {
+    int   fd;
+    dev_t dev;  /* device and i-node of the pipe, to tell if `fd' still */
+    ino_t ino;  /* refers to it */
+} coprocfd_T;
+
 /* state of currently executed loop */
 typedef struct execstate_T {
     unsigned loopnest;      /* level of nested loops */
@@ -141,8 +164,25 @@ static void exec_pipelines(const pipeline_T *p, bool finally_exit);
 static void exec_pipelines_async(const pipeline_T *p)
     __attribute__((nonnull));
 
+static void start_timing(timing_T *t)
+    __attribute__((nonnull));
+static void report_timing(const timing_T *t, bool posixformat)
+    __attribute__((nonnull));
+static void format_timing(xwcsbuf_T *restrict buf,
+        const wchar_t *restrict format, double real, const usage_T *restrict u)
+    __attribute__((nonnull));
+static void format_seconds(
+        xwcsbuf_T *buf, double sec, int precision, bool longform)
+    __attribute__((nonnull));
 static void exec_commands(command_T *cs, exec_T type)
     __attribute__((nonnull));
+static void exec_lastpipe(job_T *job, command_T *cs, int fd)
+    __attribute__((nonnull));
+static int move_to_coproc_fd(int fd);
+static void remember_coproc_fd(int fd);
+static bool is_coproc_fd_open(const coprocfd_T *cfd)
+    __attribute__((nonnull));
+static void close_coproc_fds(void);
 static inline size_t number_of_commands_in_pipeline(const command_T *c)
     __attribute__((nonnull,pure,warn_unused_result));
 static void apply_errexit_errreturn(const command_T *c);
@@ -159,13 +199,19 @@ static inline void connect_pipes(pipeinfo_T *pi)
 
 static void exec_one_command(command_T *c, bool finally_exit)
     __attribute__((nonnull));
-static void exec_simple_command(const command_T *c, bool finally_exit)
+static void exec_simple_command(command_T *c, bool finally_exit)
     __attribute__((nonnull));
 static bool exec_simple_command_without_words(const command_T *c)
     __attribute__((nonnull,warn_unused_result));
 static bool exec_simple_command_with_words(
-        const command_T *c, int argc, void **argv, bool finally_exit)
+        command_T *c, int argc, void **argv, bool finally_exit)
     __attribute__((nonnull,warn_unused_result));
+static bool get_cached_command(const command_T *c, commandinfo_T *ci)
+    __attribute__((nonnull));
+static void cache_command(command_T *c, const commandinfo_T *ci)
+    __attribute__((nonnull));
+static bool is_literal_word(const wordunit_T *w)
+    __attribute__((pure));
 static void print_xtrace(void *const *argv);
 static void search_command(
         const char *restrict name, const wchar_t *restrict wname,
@@ -177,10 +223,15 @@ static bool command_not_found_handler(void *const *argv)
     __attribute__((nonnull));
 static wchar_t **invoke_simple_command(const commandinfo_T *ci,
         int argc, char *argv0, void **argv, bool finally_exit)
-    __attribute__((nonnull,warn_unused_result));
+    __attribute__((nonnull));
 static void exec_external_program(
         const char *path, int argc, char *argv0, void **argv, char **envs)
     __attribute__((nonnull));
+#if HAVE_POSIX_SPAWN
+static bool spawn_external_program(const char *path, int argc, char *argv0,
+        void **argv, fork_and_wait_T *fawp)
+    __attribute__((nonnull,warn_unused_result));
+#endif
 static inline int xexecve(
         const char *path, char *const *argv, char *const *envp)
     __attribute__((nonnull(1)));
@@ -198,6 +249,8 @@ static void exec_if(const command_T *c, bool finally_exit)
 static inline bool exec_condition(const and_or_T *c);
 static void exec_for(const command_T *c, bool finally_exit)
     __attribute__((nonnull));
+static bool borrow_for_words(void *const *words, array_borrowing_T *array)
+    __attribute__((nonnull(2)));
 static void exec_while(const command_T *c, bool finally_exit)
     __attribute__((nonnull));
 static void exec_case(const command_T *c, bool finally_exit)
@@ -209,8 +262,29 @@ static fork_and_wait_T fork_and_wait(sigtype_T sigtype)
     __attribute__((warn_unused_result));
 static void become_child(sigtype_T sigtype);
 
+#if HAVE_OPEN_MEMSTREAM
+static bool is_cmdsub_in_process_possible(const and_or_T *a)
+    __attribute__((nonnull));
+static bool and_or_in_process_possible(const and_or_T *a, unsigned depth);
+static bool command_in_process_possible(const command_T *c, unsigned depth)
+    __attribute__((nonnull));
+static bool command_name_in_process_possible(
+        const wordunit_T *w, unsigned depth);
+static bool word_in_process_possible(const wordunit_T *w);
+static bool exec_command_substitution_in_process(
+        const and_or_T *commands, wchar_t **resultp)
+    __attribute__((nonnull,warn_unused_result));
+#endif
+static wchar_t *trim_command_substitution_result(
+        char *contents, size_t length)
+    __attribute__((nonnull,malloc,warn_unused_result));
+
 static int exec_iteration(void *const *commands, const char *codename)
     __attribute__((nonnull));
+static int get_xtrace_fd(void);
+static int parse_xtrace_fd(const wchar_t *value);
+static void write_xtrace_output(int fd, const wchar_t *s)
+    __attribute__((nonnull));
 
 
 /* exit status of the last command */
@@ -254,6 +328,28 @@ static const assign_T *last_assign;
  * trimmed when the buffer is flushed to the standard error. */
 static xwcsbuf_T xtrace_buffer = { .contents = NULL };
 
+/* a buffer for trace output written to the file descriptor specified by
+ * $YASH_XTRACEFD.
+ * The buffer is written when it grows larger than `XTRACE_OUTPUT_SIZE' or when
+ * the standard output is flushed, that is, before the shell creates a child
+ * process, executes a program, changes file descriptors, waits for input or
+ * another process, or exits. */
+static xstrbuf_T xtrace_output = { .contents = NULL };
+/* the file descriptor to which the contents of `xtrace_output' are written */
+static int xtrace_output_fd;
+#define XTRACE_OUTPUT_SIZE 4096
+
+/* the number of function calls being executed, printed in the trace prefix of
+ * the "tracestamp" option */
+static unsigned function_depth = 0;
+
+/* the shell's ends of the pipes of the coprocesses started so far.
+ * A coprocess closes them so that it does not keep another coprocess's input
+ * open. The FDs have the close-on-exec flag, so this matters only when the
+ * coprocess is a built-in or function. */
+static coprocfd_T *coprocfds;
+static size_t coprocfdcount, coprocfdmax;
+
 
 /* Resets `execstate' to the initial state. */
 void reset_execstate(bool reset_iteration)
@@ -331,9 +427,16 @@ void exec_pipelines(const pipeline_T *p, bool finally_exit)
         suppresserrexit |= suppress;
         suppresserrreturn |= suppress;
 
-        bool self = finally_exit && !p->next && !p->pl_neg;
+        timing_T timing;
+        if (p->pl_time)
+            start_timing(&timing);
+
+        bool self = finally_exit && !p->next && !p->pl_neg && !p->pl_time;
         exec_commands(p->pl_commands, self ? E_SELF : E_NORMAL);
 
+        if (p->pl_time)
+            report_timing(&timing, p->pl_posixtime);
+
         suppresserrexit = savesee, suppresserrreturn = saveser;
 
         if (need_break())
@@ -353,7 +456,9 @@ void exec_pipelines(const pipeline_T *p, bool finally_exit)
 /* Executes the pipelines asynchronously. */
 void exec_pipelines_async(const pipeline_T *p)
 {
-    if (p->next == NULL && !p->pl_neg) {
+    wait_for_job_slot();
+
+    if (p->next == NULL && !p->pl_neg && !p->pl_time) {
         exec_commands(p->pl_commands, E_ASYNC);
         return;
     }
@@ -369,11 +474,11 @@ void exec_pipelines_async(const pipeline_T *p)
         ps->pr_status = JS_RUNNING;
         ps->pr_statuscode = 0;
         ps->pr_name = pipelines_to_wcs(p);
+        ps->pr_command = NULL;
 
         job->j_pgid = doing_job_control_now ? cpid : 0;
         job->j_status = JS_RUNNING;
         job->j_statuschanged = true;
-        job->j_legacy = false;
         job->j_nonotify = false;
         job->j_pcount = 1;
 
@@ -392,6 +497,165 @@ void exec_pipelines_async(const pipeline_T *p)
     }
 }
 
+/* Starts measuring the time and resources consumed by a pipeline. */
+void start_timing(timing_T *t)
+{
+    t->real = get_real_time();
+    get_usage(&t->self, &t->children);
+    set_children_maxrss(0);
+}
+
+/* Finishes the measurement started by `start_timing' and prints the result to
+ * the standard error according to $TIMEFORMAT, or in the POSIX format of the
+ * time utility if `posixformat' is true.
+ * The CPU time and the other resources are the sum of the shell process and the
+ * child processes that finished during the measurement, so they include all
+ * the processes of the pipeline. The maximum resident set size is the largest
+ * among the child processes. */
+void report_timing(const timing_T *t, bool posixformat)
+{
+    double real = get_real_time() - t->real;
+    usage_T self, children;
+    get_usage(&self, &children);
+    set_children_maxrss(
+            children.maxrss > t->children.maxrss ?
+            children.maxrss : t->children.maxrss);
+
+    usage_T u = {
+        .utime = (self.utime - t->self.utime)
+            + (children.utime - t->children.utime),
+        .stime = (self.stime - t->self.stime)
+            + (children.stime - t->children.stime),
+        .maxrss = children.maxrss,
+        .inblock = (self.inblock - t->self.inblock)
+            + (children.inblock - t->children.inblock),
+        .oublock = (self.oublock - t->self.oublock)
+            + (children.oublock - t->children.oublock),
+        .nvcsw = (self.nvcsw - t->self.nvcsw)
+            + (children.nvcsw - t->children.nvcsw),
+        .nivcsw = (self.nivcsw - t->self.nivcsw)
+            + (children.nivcsw - t->children.nivcsw),
+    };
+
+    const wchar_t *format = posixformat ?
+            L"real %2R\nuser %2U\nsys %2S" : getvar(L VAR_TIMEFORMAT);
+    if (format == NULL)
+        format = L"\nreal\t%3lR\nuser\t%3lU\nsys\t%3lS"
+#if HAVE_WAIT4
+            L"\nmaxrss\t%M KB\nblkio\t%I in, %O out"
+            L"\nctxsw\t%w voluntary, %c involuntary"
+#endif
+            ;
+    if (format[0] == L'\0')
+        return;
+
+    xwcsbuf_T buf;
+    wb_init(&buf);
+    format_timing(&buf, format, real, &u);
+    fprintf(stderr, "%ls\n", buf.contents);
+    wb_destroy(&buf);
+}
+
+/* Returns the current time in seconds from an arbitrary origin. */
+double get_real_time(void)
+{
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+#endif
+        if (clock_gettime(CLOCK_REALTIME, &ts) < 0)
+            return 0.0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Appends the result of timing to `buf' according to `format'.
+ * In `format', the following conversions are replaced:
+ *   %R  elapsed real time         %U  user CPU time
+ *   %S  system CPU time           %P  CPU percentage ((%U + %S) / %R)
+ *   %M  maximum resident set size in kilobytes
+ *   %I  block input operations    %O  block output operations
+ *   %w  voluntary context switches
+ *   %c  involuntary context switches
+ *   %%  a single `%'
+ * %R, %U, %S, and %P may have an optional digit that specifies the number of
+ * fractional digits (up to 3, defaulting to 3) followed by an optional `l'
+ * that selects the long format "MMmSS.FFFs". Invalid conversions are copied
+ * intact. */
+void format_timing(xwcsbuf_T *restrict buf,
+        const wchar_t *restrict format, double real, const usage_T *restrict u)
+{
+    while (*format != L'\0') {
+        if (*format != L'%') {
+            wb_wccat(buf, *format++);
+            continue;
+        }
+
+        const wchar_t *start = format++;
+        int precision = 3;
+        bool longform = false;
+        if (iswdigit(*format)) {
+            precision = *format++ - L'0';
+            if (precision > 3)
+                precision = 3;
+        }
+        if (*format == L'l') {
+            longform = true;
+            format++;
+        }
+
+        switch (*format) {
+            case L'R':
+                format_seconds(buf, real, precision, longform);
+                break;
+            case L'U':
+                format_seconds(buf, u->utime, precision, longform);
+                break;
+            case L'S':
+                format_seconds(buf, u->stime, precision, longform);
+                break;
+            case L'P':
+                format_seconds(buf,
+                        real > 0.0 ? (u->utime + u->stime) / real * 100.0 : 0.0,
+                        precision, false);
+                break;
+            case L'M':  wb_wprintf(buf, L"%ld", u->maxrss);   break;
+            case L'I':  wb_wprintf(buf, L"%ld", u->inblock);  break;
+            case L'O':  wb_wprintf(buf, L"%ld", u->oublock);  break;
+            case L'w':  wb_wprintf(buf, L"%ld", u->nvcsw);    break;
+            case L'c':  wb_wprintf(buf, L"%ld", u->nivcsw);   break;
+            case L'%':  wb_wccat(buf, L'%');                  break;
+            case L'\0':
+                wb_cat(buf, start);
+                return;
+            default:
+                wb_ncat_force(buf, start, format - start + 1);
+                break;
+        }
+        format++;
+    }
+}
+
+/* Appends the number of seconds to `buf', rounded to `precision' fractional
+ * digits. If `longform' is true, the number is split into minutes and seconds
+ * as in "1m2.345s". */
+void format_seconds(xwcsbuf_T *buf, double sec, int precision, bool longform)
+{
+    intmax_t scale = 1;
+    for (int i = 0; i < precision; i++)
+        scale *= 10;
+
+    intmax_t units = (sec > 0.0) ? (intmax_t) (sec * scale + 0.5) : 0;
+    if (longform) {
+        wb_wprintf(buf, L"%jdm", units / (60 * scale));
+        units %= 60 * scale;
+    }
+    wb_wprintf(buf, L"%jd", units / scale);
+    if (precision > 0)
+        wb_wprintf(buf, L".%0*jd", precision, units % scale);
+    if (longform)
+        wb_wccat(buf, L's');
+}
+
 /* Executes the commands in a pipeline. */
 void exec_commands(command_T *const cs, exec_T type)
 {
@@ -407,6 +671,12 @@ void exec_commands(command_T *const cs, exec_T type)
         goto done;
     }
 
+    /* With the "lastpipe" option, the last command is executed in the current
+     * shell process rather than in a child. This is not done while job control
+     * is active because the shell cannot join the job's process group. */
+    bool lastpipe =
+        type == E_NORMAL && shopt_lastpipe && !doing_job_control_now;
+
     /* fork a child process for each command in the pipeline */
     pid_t pgid = 0;
     pipeinfo_T pipe = PIPEINFO_INIT;
@@ -420,6 +690,15 @@ void exec_commands(command_T *const cs, exec_T type)
 
         if (is_last && short_circuit)
             goto exec_one_command; /* skip forking */
+        if (is_last && lastpipe) {
+            /* executed after the job is established */
+            p->pr_pid = 0;
+            p->pr_status = JS_DONE;
+            p->pr_statuscode = Exit_SUCCESS;
+            p->pr_name = NULL;
+            p->pr_command = comsdup(c);
+            break;
+        }
 
         sigtype_T sigtype = (type == E_ASYNC) ? t_quitint : 0;
         pid_t pid = fork_and_reset(pgid, type == E_NORMAL, sigtype);
@@ -438,29 +717,34 @@ exec_one_command: /* child process */
             p->pr_pid = pid;
             p->pr_status = JS_RUNNING;
             // p->pr_statuscode = ?; // The process is still running.
-            p->pr_name = NULL; // The actual name is given later.
+            p->pr_name = NULL; // The actual name is made when needed.
+            p->pr_command = comsdup(c);
         } else {
             /* parent process: fork failed */
             p->pr_pid = 0;
             p->pr_status = JS_DONE;
             p->pr_statuscode = forkstatus = Exit_NOEXEC;
             p->pr_name = NULL;
+            p->pr_command = comsdup(c);
         }
     }
 
     assert(pipe.pi_tonextfds[PIPE_IN] < 0);
     assert(pipe.pi_tonextfds[PIPE_OUT] < 0);
-    if (pipe.pi_fromprevfd >= 0)
+    if (pipe.pi_fromprevfd >= 0 && !lastpipe)
         xclose(pipe.pi_fromprevfd); /* close the leftover pipe */
 
     /* establish the job and wait for it */
     job->j_pgid = doing_job_control_now ? pgid : 0;
     job->j_status = JS_RUNNING;
     job->j_statuschanged = true;
-    job->j_legacy = false;
     job->j_nonotify = false;
     job->j_pcount = count;
     set_active_job(job);
+    if (lastpipe) {
+        exec_lastpipe(job, cs, pipe.pi_fromprevfd);
+        goto done;
+    }
     if (type != E_ASYNC) {
         wait_for_job(ACTIVE_JOBNO, doing_job_control_now, false, false);
         if (doing_job_control_now)
@@ -475,10 +759,6 @@ exec_one_command: /* child process */
         notify_signaled_job(ACTIVE_JOBNO);
         remove_job(ACTIVE_JOBNO);
     } else {
-        /* name the job processes */
-        for (c = cs, p = job->j_procs; c != NULL; c = c->next, p++)
-            p->pr_name = command_to_wcs(c, false);
-
         /* remember the suspended job */
         add_job(type == E_NORMAL || shopt_curasync);
     }
@@ -492,6 +772,47 @@ done:
         exit_shell();
 }
 
+/* Executes the last command of the pipeline `cs' in the current shell process.
+ * `job' must be the active job for the pipeline whose processes except the
+ * last have been started. `fd' is the reading end of the pipe from the previous
+ * process, which is connected to the standard input while the last command is
+ * executed and then closed.
+ * The job is moved into the job list while the last command is executed so
+ * that the other processes are reaped properly even if it runs other jobs. */
+void exec_lastpipe(job_T *job, command_T *cs, int fd)
+{
+    command_T *c = cs;
+    while (c->next != NULL)
+        c = c->next;
+
+    job->j_nonotify = true;
+    size_t jobnumber = add_job(false);
+
+    int savestdin = copy_as_shellfd(STDIN_FILENO);
+    if (savestdin < 0 && errno != EBADF)
+        xerror(errno, Ngt("cannot save file descriptor %d"), STDIN_FILENO);
+    if (fd >= 0) {
+        xdup2(fd, STDIN_FILENO);
+        xclose(fd);
+    }
+
+    exec_one_command(c, false);
+    job->j_procs[job->j_pcount - 1].pr_statuscode = laststatus;
+
+    if (savestdin >= 0) {
+        remove_shellfd(savestdin);
+        xdup2(savestdin, STDIN_FILENO);
+        xclose(savestdin);
+    } else {
+        xclose(STDIN_FILENO);
+    }
+
+    wait_for_job(jobnumber, false, false, false);
+    laststatus = calc_status_of_job(job);
+    notify_signaled_job(jobnumber);
+    remove_job(jobnumber);
+}
+
 size_t number_of_commands_in_pipeline(const command_T *c)
 {
     size_t count = 1;
@@ -559,6 +880,7 @@ bool is_err_condition_for(const command_T *c)
         case CT_FOR:
         case CT_WHILE:
         case CT_CASE:
+        case CT_LAZYGROUP:
             return false;
     }
 
@@ -625,6 +947,7 @@ void connect_pipes(pipeinfo_T *pi)
     if (pi->pi_tonextfds[PIPE_OUT] >= 0) {
         xdup2(pi->pi_tonextfds[PIPE_OUT], STDOUT_FILENO);
         xclose(pi->pi_tonextfds[PIPE_OUT]);
+        reset_stdout_buffering();
     }
     if (pi->pi_tonextfds[PIPE_IN] >= 0)
         xclose(pi->pi_tonextfds[PIPE_IN]);
@@ -642,10 +965,14 @@ void exec_one_command(command_T *c, bool finally_exit)
     if (c->c_type == CT_SIMPLE) {
         exec_simple_command(c, finally_exit);
     } else {
-        savefd_T *savefd;
-        if (open_redirections(c->c_redirs, &savefd)) {
+        /* A subshell that is the last command is executed in the current
+         * process, so the original file descriptors need not be restored. */
+        savefd_T *savefd = NULL;
+        bool nosave = finally_exit && c->c_type == CT_SUBSHELL;
+        if (open_redirections(c->c_redirs, nosave ? NULL : &savefd)) {
             exec_nonsimple_command(c, finally_exit && savefd == NULL);
-            undo_redirections(savefd);
+            if (!undo_redirections(savefd))
+                laststatus = Exit_FAILURE;
         } else {
             undo_redirections(savefd);
             laststatus = Exit_REDIRERR;
@@ -660,7 +987,7 @@ void exec_one_command(command_T *c, bool finally_exit)
 }
 
 /* Executes the simple command. */
-void exec_simple_command(const command_T *c, bool finally_exit)
+void exec_simple_command(command_T *c, bool finally_exit)
 {
     lastcmdsubstatus = Exit_SUCCESS;
 
@@ -736,29 +1063,43 @@ bool exec_simple_command_without_words(const command_T *c)
  * process. However, this function still may return in some cases.
  * Returns true if the shell should exit. */
 bool exec_simple_command_with_words(
-        const command_T *c, int argc, void **argv, bool finally_exit)
+        command_T *c, int argc, void **argv, bool finally_exit)
 {
     assert(argc > 0);
 
-    char *argv0 = malloc_wcstombs(argv[0]);
-    if (argv0 == NULL)
-        argv0 = xstrdup("");
+    /* check if the command is a built-in or function */
+    commandinfo_T cmdinfo;
+    bool cached = get_cached_command(c, &cmdinfo);
+
+    /* The multibyte command name is needed only to search for it. */
+    char *argv0 = NULL;
+    if (!cached || cmdinfo.type == CT_NONE) {
+        argv0 = malloc_wcstombs(argv[0]);
+        if (argv0 == NULL)
+            argv0 = xstrdup("");
+    }
+    if (!cached) {
+        count_stat(SC_SEARCH_MISS);
+        search_command(argv0, argv[0], &cmdinfo, SCT_BUILTIN | SCT_FUNCTION);
+        cache_command(c, &cmdinfo);
+    }
 
     /* open redirections */
-    savefd_T *savefd;
-    if (!open_redirections(c->c_redirs, &savefd)) {
+    /* If the shell is going to be replaced by an external program, there is
+     * no need to save the original file descriptors. A built-in or function
+     * may set the EXIT trap, which must run with the original ones. */
+    savefd_T *savefd = NULL;
+    bool nosave = finally_exit && cmdinfo.type == CT_NONE;
+    if (!open_redirections(c->c_redirs, nosave ? NULL : &savefd)) {
         /* On redirection error, the command is not executed. */
         laststatus = Exit_REDIRERR;
-        if (posixly_correct && !is_interactive_now && is_special_builtin(argv0))
+        if (posixly_correct && !is_interactive_now
+                && cmdinfo.type == CT_SPECIALBUILTIN)
             finally_exit = true;
         goto done;
     }
 
     last_assign = c->c_assigns;
-
-    /* check if the command is a special built-in or function */
-    commandinfo_T cmdinfo;
-    search_command(argv0, argv[0], &cmdinfo, SCT_BUILTIN | SCT_FUNCTION);
     special_builtin_executed = (cmdinfo.type == CT_SPECIALBUILTIN);
 
     /* open a temporary variable environment */
@@ -791,6 +1132,9 @@ bool exec_simple_command_with_words(
         }
     }
 
+    if (c->c_redirs != NULL && cmdinfo.type != CT_FUNCTION)
+        suppress_stdout_deferral();
+
     /* execute! */
     wchar_t **namep = invoke_simple_command(&cmdinfo, argc, argv0, argv,
             finally_exit && /* !temp && */ savefd == NULL);
@@ -802,6 +1146,7 @@ bool exec_simple_command_with_words(
     if (exec_builtin_executed && laststatus == Exit_SUCCESS) {
         clear_savefd(savefd);
         savefd = NULL;
+        reset_stdout_buffering();
     }
     exec_builtin_executed = false;
 
@@ -810,12 +1155,80 @@ done1:
     if (temp)
         close_current_environment();
 done:
-    undo_redirections(savefd);
+    if (!undo_redirections(savefd))
+        laststatus = Exit_FAILURE;
     free(argv0);
 
     return finally_exit;
 }
 
+/* Retrieves the result of `search_command' with SCT_BUILTIN and SCT_FUNCTION
+ * for the name of the simple command from the cache in the command.
+ * Returns false if the command has no valid cache. */
+bool get_cached_command(const command_T *c, commandinfo_T *ci)
+{
+    const cmdcache_T *cache = &c->c_cache;
+    if (cache->generation != command_generation
+            || cache->posix != posixly_correct)
+        return false;
+
+    count_stat(SC_SEARCH_HIT);
+    ci->type = cache->type;
+    switch (ci->type) {
+        case CT_NONE:
+            ci->ci_path = NULL;
+            break;
+        case CT_FUNCTION:
+            ci->ci_function = cache->value.function;
+            break;
+        default:
+            ci->ci_builtin = cache->value.builtin;
+            break;
+    }
+    return true;
+}
+
+/* Caches the result of `search_command' with SCT_BUILTIN and SCT_FUNCTION in
+ * the simple command if the command name is a literal word, which always
+ * expands to the same name. The cache remains valid until a function is
+ * defined or unset, a built-in is loaded or unloaded, or the POSIXly-correct
+ * mode is switched. */
+void cache_command(command_T *c, const commandinfo_T *ci)
+{
+    if (!is_literal_word(c->c_words[0]))
+        return;
+
+    cmdcache_T *cache = &c->c_cache;
+    cache->generation = command_generation;
+    cache->posix = posixly_correct;
+    cache->type = ci->type;
+    switch (ci->type) {
+        case CT_NONE:
+            break;
+        case CT_FUNCTION:
+            cache->value.function = ci->ci_function;
+            break;
+        case CT_EXTERNALPROGRAM:
+        case CT_SUBSTITUTIVEBUILTIN:
+            assert(false);
+        default:
+            cache->value.builtin = ci->ci_builtin;
+            break;
+    }
+}
+
+/* Returns true iff the specified word consists of a single string that is not
+ * subject to quote removal or tilde, brace, or pathname expansion, that is,
+ * the word always expands to the field of the same string. */
+bool is_literal_word(const wordunit_T *w)
+{
+    if (w == NULL || w->next != NULL || w->wu_type != WT_STRING)
+        return false;
+
+    const wchar_t *s = w->wu_string;
+    return s[0] != L'~' && wcspbrk(s, L"\\\"'{*?]") == NULL;
+}
+
 /* Returns a pointer to the xtrace buffer.
  * The buffer is initialized if not. */
 xwcsbuf_T *get_xtrace_buffer(void)
@@ -825,7 +1238,9 @@ xwcsbuf_T *get_xtrace_buffer(void)
     return &xtrace_buffer;
 }
 
-/* Prints a trace if the "xtrace" option is on. */
+/* Prints a trace if the "xtrace" option is on.
+ * The trace is prefixed with the expansion of $PS4 or, if the "tracestamp"
+ * option is on, the current time, process ID, and function call depth. */
 void print_xtrace(void *const *argv)
 {
     static bool expanding_ps4 = false;
@@ -840,35 +1255,53 @@ void print_xtrace(void *const *argv)
             && !(le_state & LE_STATE_ACTIVE)
 #endif
             ) {
+        bool stamp = shopt_tracestamp;
+        int fd = get_xtrace_fd();
+        struct promptset_T prompt = { NULL, NULL, NULL, NULL };
+        xwcsbuf_T line;
         bool first = true;
 
-        // Disallow recursion in case $PS4 contains a command substitution
-        // that may trigger another xtrace, which would be an infinite loop
-        expanding_ps4 = true;
-        struct promptset_T prompt = get_prompt(4);
-        expanding_ps4 = false;
-
-        print_prompt(prompt.main);
-        print_prompt(prompt.styler);
+        wb_init(&line);
+        if (stamp) {
+            wb_wprintf(&line, L"%.6f %jd %u ",
+                    get_real_time(), (intmax_t) getpid(), function_depth);
+        } else {
+            // Disallow recursion in case $PS4 contains a command substitution
+            // that may trigger another xtrace, which would be an infinite loop
+            expanding_ps4 = true;
+            prompt = get_prompt(4);
+            expanding_ps4 = false;
+
+            if (fd >= 0)
+                format_prompt(&line, prompt.main);
+        }
 
         if (tracevars) {
-            fprintf(stderr, "%ls", xtrace_buffer.contents + 1);
+            wb_cat(&line, xtrace_buffer.contents + 1);
             first = false;
         }
         if (argv != NULL) {
             for (void *const *a = argv; *a != NULL; a++) {
                 if (!first)
-                    fputc(' ', stderr);
+                    wb_wccat(&line, L' ');
                 first = false;
-
-                wchar_t *quoted = quote_as_word(*a);
-                fprintf(stderr, "%ls", quoted);
-                free(quoted);
+                wb_quote_as_word(&line, *a);
             }
         }
-        fputc('\n', stderr);
+        wb_wccat(&line, L'\n');
 
-        print_prompt(PROMPT_RESET);
+        if (fd >= 0) {
+            write_xtrace_output(fd, line.contents);
+        } else if (stamp) {
+            fprintf(stderr, "%ls", line.contents);
+        } else {
+            print_prompt(prompt.main);
+            print_prompt(prompt.styler);
+            fprintf(stderr, "%ls", line.contents);
+            print_prompt(PROMPT_RESET);
+        }
+
+        wb_destroy(&line);
         free_prompt(prompt);
     }
     if (xtrace_buffer.contents != NULL) {
@@ -877,6 +1310,65 @@ void print_xtrace(void *const *argv)
     }
 }
 
+/* Returns the value of $YASH_XTRACEFD if it is a file descriptor that can be
+ * used for trace output, or -1 if the trace should be printed to the standard
+ * error. */
+int get_xtrace_fd(void)
+{
+    return parse_xtrace_fd(getvar(L VAR_YASH_XTRACEFD));
+}
+
+/* Returns the file descriptor that `value' names if it is open and is not a
+ * shell FD, or -1 otherwise. `value' may be NULL. */
+int parse_xtrace_fd(const wchar_t *value)
+{
+    int fd;
+
+    if (value == NULL || !xwcstoi(value, 10, &fd) || fd < 0 || is_shellfd(fd)
+            || fcntl(fd, F_GETFD) < 0)
+        return -1;
+    return fd;
+}
+
+/* Prints a warning if `value', the new value of $YASH_XTRACEFD, does not name
+ * a file descriptor that can be used for trace output. */
+void check_xtrace_fd(const wchar_t *value)
+{
+    if (value[0] != L'\0' && parse_xtrace_fd(value) < 0)
+        xerror(0, Ngt("$%ls: `%ls' is not an open file descriptor; "
+                    "the trace is printed to the standard error"),
+                L VAR_YASH_XTRACEFD, value);
+}
+
+/* Appends the specified trace to the buffer of trace output for file
+ * descriptor `fd'. The buffer is written if it has grown large enough. */
+void write_xtrace_output(int fd, const wchar_t *s)
+{
+    if (xtrace_output.contents == NULL)
+        sb_init(&xtrace_output);
+    else if (xtrace_output_fd != fd)
+        flush_xtrace();
+    xtrace_output_fd = fd;
+
+    mbstate_t state;
+    memset(&state, 0, sizeof state);
+    sb_wcscat(&xtrace_output, s, &state);
+
+    if (xtrace_output.length >= XTRACE_OUTPUT_SIZE)
+        flush_xtrace();
+}
+
+/* Writes the buffered trace output, if any, to the file descriptor specified
+ * by $YASH_XTRACEFD. Write errors are ignored. */
+void flush_xtrace(void)
+{
+    if (xtrace_output.contents != NULL && xtrace_output.length > 0) {
+        write_all(xtrace_output_fd,
+                xtrace_output.contents, xtrace_output.length);
+        sb_clear(&xtrace_output);
+    }
+}
+
 /* Searches for a command.
  * The result is assigned to `*ci'.
  * `name' and `wname' must contain the same string value.
@@ -1034,7 +1526,13 @@ wchar_t **invoke_simple_command(
         laststatus = Exit_NOTFOUND;
         break;
     case CT_EXTERNALPROGRAM:
+        profiler_count(PE_EXEC);
+        count_stat(SC_EXEC);
         if (!finally_exit) {
+#if HAVE_POSIX_SPAWN
+            if (spawn_external_program(ci->ci_path, argc, argv0, argv, &faw))
+                break;
+#endif
             faw = fork_and_wait(t_leave);
             if (faw.cpid != 0)
                 break;
@@ -1056,16 +1554,24 @@ wchar_t **invoke_simple_command(
     case CT_EXTENSIONBUILTIN:
     case CT_SUBSTITUTIVEBUILTIN:
         yash_error_message_count = 0;
+        count_stat(SC_BUILTIN);
 
         const wchar_t *savecbn = current_builtin_name;
         current_builtin_name = argv[0];
 
         laststatus = ci->ci_builtin(argc, argv);
+        if (!flush_builtin_output(
+                    suppresserrexit || shopt_errexit || shopt_errreturn)
+                && laststatus == Exit_SUCCESS)
+            laststatus = Exit_FAILURE;
 
         current_builtin_name = savecbn;
         break;
     case CT_FUNCTION:
+        count_stat(SC_FUNCTION);
+        profiler_enter_function(argv[0]);
         exec_function_body(ci->ci_function, &argv[1], finally_exit, false);
+        profiler_leave_function();
         break;
     }
     if (finally_exit)
@@ -1082,6 +1588,9 @@ wchar_t **invoke_simple_command(
 void exec_external_program(
         const char *path, int argc, char *argv0, void **argv, char **envs)
 {
+    finalize_profiler();
+    finalize_cmdhash();
+
     char *mbsargv[argc + 1];
     mbsargv[0] = argv0;
     for (int i = 1; i < argc; i++) {
@@ -1114,9 +1623,69 @@ void exec_external_program(
         free(mbsargv[i]);
 }
 
+#if HAVE_POSIX_SPAWN
+
+/* Starts the external program using `posix_spawn' and waits for it to finish.
+ * This is a faster alternative to `fork_and_wait' followed by
+ * `exec_external_program', which can be used when the child process needs no
+ * preparation other than what `posix_spawn' attributes can express.
+ * The arguments are the same as those of `exec_external_program'. The result
+ * of waiting is assigned to `*fawp'.
+ * Returns false without starting the program if `posix_spawn' is not
+ * applicable or fails, in which case the caller should fall back on
+ * `fork_and_wait' to run the program (and report the error if any). */
+bool spawn_external_program(const char *path, int argc, char *argv0,
+        void **argv, fork_and_wait_T *fawp)
+{
+    /* The child would have to put itself into the foreground. */
+    if (doing_job_control_now)
+        return false;
+
+    sigset_t defaults, mask;
+    if (!get_signal_settings_for_spawn(&defaults, &mask))
+        return false;
+
+    posix_spawnattr_t attr;
+    if (posix_spawnattr_init(&attr) != 0)
+        return false;
+
+    bool ok = posix_spawnattr_setsigdefault(&attr, &defaults) == 0
+        && posix_spawnattr_setsigmask(&attr, &mask) == 0
+        && posix_spawnattr_setflags(&attr,
+                POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK) == 0;
+    pid_t cpid;
+    if (ok) {
+        char *mbsargv[argc + 1];
+        mbsargv[0] = argv0;
+        for (int i = 1; i < argc; i++) {
+            mbsargv[i] = malloc_wcstombs(argv[i]);
+            if (mbsargv[i] == NULL)
+                mbsargv[i] = xstrdup("");
+        }
+        mbsargv[argc] = NULL;
+
+        flush_stdout();
+        ok = posix_spawn(&cpid, path, NULL, &attr, mbsargv, environ) == 0;
+
+        for (int i = 1; i < argc; i++)
+            free(mbsargv[i]);
+    }
+    posix_spawnattr_destroy(&attr);
+    if (!ok)
+        return false;
+
+    count_stat(SC_SPAWN);
+    fawp->cpid = cpid;
+    fawp->namep = wait_for_child(cpid, 0, false);
+    return true;
+}
+
+#endif /* HAVE_POSIX_SPAWN */
+
 /* Calls `execve' until it doesn't return EINTR. */
 int xexecve(const char *path, char *const *argv, char *const *envp)
 {
+    flush_stdout();
     do
         execve(path, argv, envp);
     while (errno == EINTR);
@@ -1165,7 +1734,8 @@ void exec_fall_back_on_sh(
 
 /* Executes the specified command as a function.
  * `args' are the arguments to the function, which are wide strings cast to
- * (void *).
+ * (void *). They are used as the positional parameters without being copied,
+ * so they must not be changed or freed until this function returns.
  * If `complete' is true, `set_completion_variables' will be called after a new
  * variable environment was opened before the function body is executed. */
 void exec_function_body(
@@ -1177,8 +1747,9 @@ void exec_function_body(
     bool saveser = suppresserrreturn;
     suppresserrreturn = false;
 
+    function_depth++;
     open_new_environment(false);
-    set_positional_parameters(args);
+    share_positional_parameters(args);
 #if YASH_ENABLE_LINEEDIT
     if (complete)
         set_completion_variables();
@@ -1187,6 +1758,7 @@ void exec_function_body(
 #endif
     exec_commands(body, finally_exit ? E_SELF : E_NORMAL);
     close_current_environment();
+    function_depth--;
 
     cancel_return();
     suppresserrreturn = saveser;
@@ -1201,6 +1773,7 @@ void exec_nonsimple_command(command_T *c, bool finally_exit)
     case CT_SIMPLE:
         assert(false);
     case CT_SUBSHELL:
+        count_stat(SC_SUBSHELL);
         if (finally_exit) {
             /* This is the last command to execute in the current shell, hence
              * no need to make a new child. */
@@ -1241,6 +1814,17 @@ void exec_nonsimple_command(command_T *c, bool finally_exit)
     case CT_FUNCDEF:
         exec_funcdef(c, finally_exit);
         break;
+    case CT_LAZYGROUP:
+        if (!parse_lazy_group(c)) {
+            if (shell_initialized && !is_interactive_now)
+                exit_shell_with_status(Exit_SYNERROR);
+            laststatus = Exit_SYNERROR;
+            if (finally_exit)
+                exit_shell();
+            break;
+        }
+        exec_and_or_lists(c->c_subcmds, finally_exit);
+        break;
     }
 }
 
@@ -1288,21 +1872,33 @@ void exec_for(const command_T *c, bool finally_exit)
 
     int count;
     void **words;
-
-    if (c->c_forwords != NULL) {
+    brace_sequence_T seq;
+    bool lazy = false;  /* iterating over a brace sequence? */
+    array_borrowing_T array;
+    bool borrowed = false;  /* iterating over array elements in place? */
+
+    if (c->c_forwords != NULL && c->c_forwords[0] != NULL
+            && c->c_forwords[1] == NULL
+            && parse_brace_sequence_word(c->c_forwords[0], &seq)) {
+        /* The only word is a numeric brace sequence like "{1..100}". Its
+         * values are generated one at a time rather than all in advance. */
+        lazy = true;
+        count = 0;
+        words = NULL;
+    } else if (borrow_for_words(c->c_forwords, &array)) {
+        /* The array elements are copied one at a time when assigned to the
+         * variable. */
+        borrowed = true;
+        count = (int) array.count;
+        words = NULL;
+    } else {
         /* expand the words between "in" and "do" of the for command. */
+        assert(c->c_forwords != NULL);
         if (!expand_line(c->c_forwords, &count, &words)) {
             laststatus = Exit_EXPERROR;
             apply_errexit_errreturn(NULL);
             goto finish;
         }
-    } else {
-        /* no "in" keyword in the for command: use the positional parameters */
-        struct get_variable_T v = get_variable(L"@");
-        assert(v.type == GV_ARRAY && v.values != NULL);
-        save_get_variable_values(&v);
-        count = (int) v.count;
-        words = v.values;
     }
 
 #define CHECK_LOOP                                      \
@@ -1318,8 +1914,11 @@ void exec_for(const command_T *c, bool finally_exit)
     } else (void) 0
 
     int i;
-    for (i = 0; i < count; i++) {
-        if (!set_variable(c->c_forname, words[i],
+    for (i = 0; lazy ? !seq.done : i < count; i++) {
+        wchar_t *word = lazy ? next_brace_sequence_value(&seq)
+                : borrowed ? xwcsdup(array.values[i]) : words[i];
+        bool last = lazy ? seq.done : i + 1 == count;
+        if (!set_variable(c->c_forname, word,
                     shopt_forlocal && !posixly_correct ?
                         SCOPE_LOCAL : SCOPE_GLOBAL,
                     false)) {
@@ -1329,7 +1928,7 @@ void exec_for(const command_T *c, bool finally_exit)
                 finally_exit = true;
             goto done;
         }
-        exec_and_or_lists(c->c_forcmds, finally_exit && i + 1 == count);
+        exec_and_or_lists(c->c_forcmds, finally_exit && last);
 
         if (c->c_forcmds == NULL)
             handle_signals();
@@ -1337,10 +1936,13 @@ void exec_for(const command_T *c, bool finally_exit)
     }
 
 done:
-    while (++i < count)  /* free unused words */
-        free(words[i]);
+    if (borrowed)
+        return_array(&array);
+    else if (words != NULL)
+        while (++i < count)  /* free unused words */
+            free(words[i]);
     free(words);
-    if (count == 0 && c->c_forcmds != NULL)
+    if (!lazy && count == 0 && c->c_forcmds != NULL)
         laststatus = Exit_SUCCESS;
 finish:
     execstate.loopnest--;
@@ -1348,6 +1950,21 @@ finish:
         exit_shell();
 }
 
+/* If the words of a for command consist only of a parameter expansion that
+ * expands to all the elements of an array like "${array[@]}", makes `*array'
+ * borrow the elements of the array and returns true. If `words' is NULL, the
+ * positional parameters are borrowed. Otherwise, returns false. */
+bool borrow_for_words(void *const *words, array_borrowing_T *array)
+{
+    const wchar_t *name;
+    if (words == NULL)
+        name = L"@";
+    else if (words[0] == NULL || words[1] != NULL
+            || (name = whole_array_expansion_name(words[0])) == NULL)
+        return false;
+    return borrow_array(name, array);
+}
+
 /* Executes the while/until command. */
 /* The exit status of a while/until command is that of `c_whlcmds' executed
  * last.  If `c_whlcmds' is not executed at all, the status is 0 regardless of
@@ -1496,6 +2113,8 @@ fork_and_wait_T fork_and_wait(sigtype_T sigtype)
  * Returns the return value of `fork'. */
 pid_t fork_and_reset(pid_t pgid, bool fg, sigtype_T sigtype)
 {
+    flush_stdout();
+
     sigset_t savemask;
     if (sigtype & (t_quitint | t_tstp)) {
         /* block all signals to prevent the race condition */
@@ -1515,6 +2134,8 @@ pid_t fork_and_reset(pid_t pgid, bool fg, sigtype_T sigtype)
             /* parent process */
             if (doing_job_control_now && pgid >= 0)
                 setpgid(cpid, pgid);
+            profiler_count(PE_FORK);
+            count_stat(SC_FORK);
         }
         if (sigtype & (t_quitint | t_tstp))
             sigprocmask(SIG_SETMASK, &savemask, NULL);
@@ -1537,6 +2158,7 @@ pid_t fork_and_reset(pid_t pgid, bool fg, sigtype_T sigtype)
  * subshell. See `fork_and_reset' for the meaning of the `sigtype' parameter. */
 void become_child(sigtype_T sigtype)
 {
+    stop_profiler();
     if (sigtype & t_leave) {
         clear_exit_trap();
     } else {
@@ -1562,6 +2184,10 @@ void become_child(sigtype_T sigtype)
     exitstatus = -1;
 }
 
+/* The number of bytes that are read at a time from the output of a command
+ * substitution. */
+#define CMDSUB_READ_SIZE 4096
+
 /* Executes the command substitution and returns the string to substitute with.
  * This function blocks until the command finishes.
  * The return value is a newly-malloced string without a trailing newline.
@@ -1576,6 +2202,19 @@ wchar_t *exec_command_substitution(const embedcmd_T *cmdsub)
             : cmdsub->value.unparsed[0] == L'\0')  /* empty command */
         return xwcsdup(L"");
 
+    profiler_count(PE_CMDSUB);
+    count_stat(SC_CMDSUB);
+
+#if HAVE_OPEN_MEMSTREAM
+    if (cmdsub->is_preparsed
+            && is_cmdsub_in_process_possible(cmdsub->value.preparsed)) {
+        wchar_t *result;
+        if (exec_command_substitution_in_process(
+                    cmdsub->value.preparsed, &result))
+            return result;
+    }
+#endif
+
     /* open a pipe to receive output from the command */
     if (pipe(pipefd) < 0) {
         xerror(errno, Ngt("cannot open a pipe for the command substitution"));
@@ -1594,25 +2233,27 @@ wchar_t *exec_command_substitution(const embedcmd_T *cmdsub)
         return NULL;
     } else if (cpid > 0) {
         /* parent process */
-        FILE *f;
-
         xclose(pipefd[PIPE_OUT]);
-        f = fdopen(pipefd[PIPE_IN], "r");
-        if (f == NULL) {
-            xerror(errno,
-                    Ngt("cannot open a pipe for the command substitution"));
-            xclose(pipefd[PIPE_IN]);
-            lastcmdsubstatus = Exit_NOEXEC;
-            return NULL;
-        }
 
         /* read output from the command */
-        xwcsbuf_T buf;
-        wint_t c;
-        wb_init(&buf);
-        while ((c = fgetwc(f)) != WEOF)
-            wb_wccat(&buf, c);
-        fclose(f);
+        xstrbuf_T buf;
+        sb_initwithmax(&buf, CMDSUB_READ_SIZE);
+        for (;;) {
+            if (buf.maxlength - buf.length < CMDSUB_READ_SIZE / 2)
+                sb_ensuremax(&buf, buf.length + CMDSUB_READ_SIZE);
+            ssize_t count = read(pipefd[PIPE_IN], &buf.contents[buf.length],
+                    buf.maxlength - buf.length);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            if (count == 0)
+                break;
+            buf.length += count;
+        }
+        buf.contents[buf.length] = '\0';
+        xclose(pipefd[PIPE_IN]);
 
         /* wait for the child to finish */
         int savelaststatus = laststatus;
@@ -1621,10 +2262,8 @@ wchar_t *exec_command_substitution(const embedcmd_T *cmdsub)
         laststatus = savelaststatus;
 
         /* trim trailing newlines and return */
-        size_t len = buf.length;
-        while (len > 0 && buf.contents[len - 1] == L'\n')
-            len--;
-        return wb_towcs(wb_truncate(&buf, len));
+        size_t length = buf.length;
+        return trim_command_substitution_result(sb_tostr(&buf), length);
     } else {
         /* child process */
         xclose(pipefd[PIPE_IN]);
@@ -1642,6 +2281,260 @@ wchar_t *exec_command_substitution(const embedcmd_T *cmdsub)
     }
 }
 
+#if HAVE_OPEN_MEMSTREAM
+
+/* The maximum depth of function calls that are examined by
+ * `is_cmdsub_in_process_possible'. */
+#define CMDSUB_IN_PROCESS_MAX_DEPTH 4
+
+/* Tests if the body of a command substitution can be executed in the shell
+ * process rather than in a subshell.
+ * This is possible if the commands consist only of built-ins and functions that
+ * do nothing but print to the standard output, so that the execution has no
+ * effect on the shell state that would not be confined in a subshell: The
+ * commands must not have redirections, assignments, command substitutions,
+ * arithmetic expansions, or parameter expansions that may assign or exit or
+ * that get a variable with a getter (such as $RANDOM).
+ * No trap may be set because a trap action executed during the commands would
+ * print into the result rather than to the shell's standard output.
+ * If the "errexit" or "errreturn" option is on, only a single simple command is
+ * accepted because the first failing command would end the subshell. */
+bool is_cmdsub_in_process_possible(const and_or_T *a)
+{
+    if (!shopt_unset || any_trap_set)
+        return false;
+    if (shopt_errexit || shopt_errreturn) {
+        if (a->next != NULL || a->ao_pipelines->next != NULL)
+            return false;
+        const command_T *c = a->ao_pipelines->pl_commands;
+        if (c->c_type != CT_SIMPLE)
+            return false;
+        return command_in_process_possible(c, 0);
+    }
+    return and_or_in_process_possible(a, CMDSUB_IN_PROCESS_MAX_DEPTH);
+}
+
+bool and_or_in_process_possible(const and_or_T *a, unsigned depth)
+{
+    for (; a != NULL; a = a->next) {
+        if (a->ao_async)
+            return false;
+        for (const pipeline_T *p = a->ao_pipelines; p != NULL; p = p->next) {
+            if (p->pl_commands->next != NULL)
+                return false;
+            if (!command_in_process_possible(p->pl_commands, depth))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool command_in_process_possible(const command_T *c, unsigned depth)
+{
+    if (c->c_redirs != NULL)
+        return false;
+
+    switch (c->c_type) {
+        case CT_SIMPLE:
+            if (c->c_assigns != NULL || c->c_words[0] == NULL)
+                return false;
+            for (void **w = c->c_words; *w != NULL; w++)
+                if (!word_in_process_possible(*w))
+                    return false;
+            return command_name_in_process_possible(c->c_words[0], depth);
+        case CT_GROUP:
+            return and_or_in_process_possible(c->c_subcmds, depth);
+        case CT_IF:
+            for (const ifcommand_T *ic = c->c_ifcmds; ic != NULL; ic = ic->next)
+                if (!and_or_in_process_possible(ic->ic_condition, depth)
+                        || !and_or_in_process_possible(ic->ic_commands, depth))
+                    return false;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Tests if the command name word denotes a built-in that only prints something
+ * or a function that can be executed in process. The word must be a plain
+ * literal so that the result of the search does not change when the command is
+ * actually executed. */
+bool command_name_in_process_possible(const wordunit_T *w, unsigned depth)
+{
+    if (w == NULL || w->next != NULL || w->wu_type != WT_STRING)
+        return false;
+
+    const wchar_t *wname = w->wu_string;
+    if (wname[0] == L'\0')
+        return false;
+    for (const wchar_t *s = wname; *s != L'\0'; s++)
+        if (!is_name_char(*s) && *s != L':')
+            return false;
+
+    char *name = malloc_wcstombs(wname);
+    if (name == NULL)
+        return false;
+
+    commandinfo_T ci;
+    search_command(name, wname, &ci,
+            SCT_EXTERNAL | SCT_BUILTIN | SCT_FUNCTION | SCT_CHECK);
+    free(name);
+
+    switch (ci.type) {
+        case CT_SPECIALBUILTIN:
+        case CT_MANDATORYBUILTIN:
+        case CT_EXTENSIONBUILTIN:
+        case CT_SUBSTITUTIVEBUILTIN:
+            /* The "test" built-in is not here because "test -t 1" would see
+             * the shell's standard output rather than the pipe. */
+            return ci.ci_builtin == true_builtin
+                || ci.ci_builtin == false_builtin
+                || ci.ci_builtin == pwd_builtin
+#if YASH_ENABLE_PRINTF
+                || ci.ci_builtin == echo_builtin
+                || ci.ci_builtin == printf_builtin
+#endif
+                ;
+        case CT_FUNCTION:
+            return depth > 0
+                && command_in_process_possible(ci.ci_function, depth - 1);
+        default:
+            return false;
+    }
+}
+
+/* Tests if the expansion of the word has no side effect. */
+bool word_in_process_possible(const wordunit_T *w)
+{
+    for (; w != NULL; w = w->next) {
+        switch (w->wu_type) {
+            case WT_STRING:
+                break;
+            case WT_PARAM:;
+                const paramexp_T *p = w->wu_param;
+                switch (p->pe_type & PT_MASK) {
+                    case PT_ASSIGN:
+                    case PT_ERROR:
+                        return false;
+                    default:
+                        break;
+                }
+                if (p->pe_start != NULL || p->pe_end != NULL)
+                    return false;  /* indices are arithmetic expressions */
+                if (p->pe_type & PT_NEST) {
+                    if (!word_in_process_possible(p->pe_nest))
+                        return false;
+                } else {
+                    if (has_getter(p->pe_name))
+                        return false;
+                }
+                if (!word_in_process_possible(p->pe_match)
+                        || !word_in_process_possible(p->pe_subst))
+                    return false;
+                break;
+            case WT_CMDSUB:
+            case WT_ARITH:
+                return false;
+        }
+    }
+    return true;
+}
+
+/* Executes the body of a command substitution in the shell process, capturing
+ * the standard output in a memory buffer.
+ * The caller must have checked that the commands are suitable by calling
+ * `is_cmdsub_in_process_possible'.
+ * If successful, the result is assigned to `*resultp' and true is returned.
+ * False is returned if the memory buffer cannot be prepared, in which case the
+ * commands have not been executed and the caller should fall back on the
+ * ordinary subshell. */
+bool exec_command_substitution_in_process(
+        const and_or_T *commands, wchar_t **resultp)
+{
+    char *contents;
+    size_t length;
+    FILE *f = open_memstream(&contents, &length);
+    if (f == NULL)
+        return false;
+
+    /* The commands cannot change variables, options, etc.,
+     * so we only have to save the execution state and the xtrace buffer,
+     * which may be in use if we are expanding $PS4. */
+    FILE *savestdout = stdout;
+    int savelaststatus = laststatus;
+    bool savesee = suppresserrexit, saveser = suppresserrreturn;
+    bool savesbe = special_builtin_executed;
+    const assign_T *savelastassign = last_assign;
+    execstate_T *saveexecstate = save_execstate();
+    xwcsbuf_T savextracebuffer = xtrace_buffer;
+    reset_execstate(true);
+    xtrace_buffer.contents = NULL;
+
+    stdout = f;
+    suppresserrexit = suppresserrreturn = true;
+
+    exec_and_or_lists(commands, false);
+
+    stdout = savestdout;
+    lastcmdsubstatus = laststatus;
+    laststatus = savelaststatus;
+    suppresserrexit = savesee, suppresserrreturn = saveser;
+    special_builtin_executed = savesbe;
+    last_assign = savelastassign;
+    restore_execstate(saveexecstate);
+    if (xtrace_buffer.contents != NULL)
+        wb_destroy(&xtrace_buffer);
+    xtrace_buffer = savextracebuffer;
+
+    fclose(f);
+    *resultp = trim_command_substitution_result(contents, length);
+    return true;
+}
+
+#endif /* HAVE_OPEN_MEMSTREAM */
+
+/* Converts the output of a command substitution into a wide string,
+ * removing trailing newlines.
+ * `contents' must be a malloced string of `length' bytes and is freed in this
+ * function. Like `fgetwc', conversion stops at an invalid or
+ * null character. */
+wchar_t *trim_command_substitution_result(char *contents, size_t length)
+{
+    /* The result never has more characters than `contents' has bytes, so we
+     * allocate the buffer at once and store characters directly. */
+    xwcsbuf_T buf;
+    mbstate_t state;
+    const unsigned char *s = (const unsigned char *) contents;
+    bool ascii = is_ascii_compatible_locale();
+    wb_initwithmax(&buf, length);
+    memset(&state, 0, sizeof state);  // initialize as the initial shift state
+    while (length > 0) {
+        if (ascii && mbsinit(&state)) {
+            /* fast path: plain ASCII characters need no conversion */
+            while (length > 0 && 0 < *s && *s < 0x80)
+                buf.contents[buf.length++] = (wchar_t) *s++, length--;
+            if (length == 0)
+                break;
+        }
+
+        wchar_t wc;
+        size_t count = mbrtowc(&wc, (const char *) s, length, &state);
+        if (count == 0 || count == (size_t) -1 || count == (size_t) -2)
+            break;
+        buf.contents[buf.length++] = wc;
+        s += count, length -= count;
+    }
+    buf.contents[buf.length] = L'\0';
+    free(contents);
+
+    /* trim trailing newlines after the conversion, which may have stopped
+     * before them */
+    size_t len = buf.length;
+    while (len > 0 && buf.contents[len - 1] == L'\n')
+        len--;
+    return wb_towcs(wb_truncate(&buf, len));
+}
+
 /* Executes the value of the specified variable.
  * The variable value is parsed as commands.
  * If the `varname' names an array, every element of the array is executed (but
@@ -1743,8 +2636,7 @@ bool autoload_completion_function_file(
     if (mbsfilename == NULL)
         return false;
 
-    char *path = which(mbsfilename, get_path_array(PA_LOADPATH),
-            is_readable_regular);
+    char *path = which_in_loadpath(mbsfilename);
     if (path == NULL) {
         le_compdebug("file \"%s\" was not found in $YASH_LOADPATH",
                 mbsfilename);
@@ -1768,7 +2660,7 @@ bool autoload_completion_function_file(
     set_positional_parameters((void *[]) { (void *) cmdname, NULL });
 
     le_compdebug("executing file \"%s\" (autoload)", path);
-    exec_input(fd, mbsfilename, 0);
+    exec_input(fd, mbsfilename, XIO_PARSE_CACHE);
     le_compdebug("finished executing file \"%s\"", path);
 
     close_current_environment();
@@ -2096,8 +2988,7 @@ int dot_builtin(int argc, void **argv)
 
     char *path;
     if (autoload) {
-        path = which(mbsfilename, get_path_array(PA_LOADPATH),
-                is_readable_regular);
+        path = which_in_loadpath(mbsfilename);
         if (path == NULL) {
             xerror(0, Ngt("file `%s' was not found in $YASH_LOADPATH"),
                     mbsfilename);
@@ -2136,7 +3027,8 @@ int dot_builtin(int argc, void **argv)
     bool saveser = suppresserrreturn;
     suppresserrreturn = false;
 
-    exec_input(fd, mbsfilename, enable_alias ? XIO_SUBST_ALIAS : 0);
+    exec_input(fd, mbsfilename,
+            XIO_PARSE_CACHE | (enable_alias ? XIO_SUBST_ALIAS : 0));
 
     cancel_return();
     suppresserrreturn = saveser;
@@ -2582,6 +3474,201 @@ const char type_syntax[] = Ngt(
 
 #endif
 
+/* Options for the "coproc" built-in. */
+const struct xgetopt_T coproc_options[] = {
+    { L'n', L"name", OPTARG_REQUIRED, false, NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help", OPTARG_NONE,     false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "coproc" built-in, which accepts the following option:
+ *  -n NAME: the name of the array that holds the file descriptors
+ * The command is started as an asynchronous job whose standard input and
+ * output are connected to the shell via pipes. The FDs of the shell's ends
+ * are assigned to NAME as an array: the first element is the FD to read the
+ * output of the command from and the second is the FD to write to its input.
+ * The process ID is assigned to NAME_PID. */
+int coproc_builtin(int argc, void **argv)
+{
+    const wchar_t *name = L"COPROC";
+
+    const struct xgetopt_T *opt;
+    xoptind = 0;
+    while ((opt = xgetopt(argv, coproc_options, XGETOPT_POSIX)) != NULL) {
+        switch (opt->shortopt) {
+            case L'n':  name = xoptarg;  break;
+#if YASH_ENABLE_HELP
+            case L'-':
+                return print_builtin_help(ARGV(0));
+#endif
+            default:
+                return Exit_ERROR;
+        }
+    }
+
+    if (xoptind == argc)
+        return insufficient_operands_error(1);
+    if (!is_name(name)) {
+        xerror(0, Ngt("`%ls' is not a valid variable name"), name);
+        return Exit_FAILURE;
+    }
+
+    int tochild[2], fromchild[2];
+    if (pipe(tochild) < 0)
+        goto pipe_error;
+    if (pipe(fromchild) < 0) {
+        xclose(tochild[PIPE_IN]);
+        xclose(tochild[PIPE_OUT]);
+        goto pipe_error;
+    }
+
+    pid_t cpid = fork_and_reset(0, false, t_quitint);
+    if (cpid < 0) {
+        xclose(tochild[PIPE_IN]);
+        xclose(tochild[PIPE_OUT]);
+        xclose(fromchild[PIPE_IN]);
+        xclose(fromchild[PIPE_OUT]);
+        return Exit_NOEXEC;
+    }
+    if (cpid == 0) {
+        /* child process: execute the command and then exit */
+        close_coproc_fds();
+        xclose(tochild[PIPE_OUT]);
+        xclose(fromchild[PIPE_IN]);
+        if (tochild[PIPE_IN] != STDIN_FILENO) {
+            xdup2(tochild[PIPE_IN], STDIN_FILENO);
+            xclose(tochild[PIPE_IN]);
+        }
+        if (fromchild[PIPE_OUT] != STDOUT_FILENO) {
+            xdup2(fromchild[PIPE_OUT], STDOUT_FILENO);
+            xclose(fromchild[PIPE_OUT]);
+        }
+
+        argc -= xoptind, argv += xoptind;
+        char *argv0 = malloc_wcstombs(argv[0]);
+        if (argv0 == NULL) {
+            xerror(EILSEQ, NULL);
+            exit_shell_with_status(Exit_NOTFOUND);
+        }
+        commandinfo_T ci;
+        search_command(argv0, argv[0], &ci,
+                SCT_EXTERNAL | SCT_BUILTIN | SCT_FUNCTION);
+        invoke_simple_command(&ci, argc, argv0, argv, true);
+    }
+
+    /* parent process: keep the shell's ends of the pipes */
+    xclose(tochild[PIPE_IN]);
+    xclose(fromchild[PIPE_OUT]);
+    int readfd = move_to_coproc_fd(fromchild[PIPE_IN]);
+    int writefd = move_to_coproc_fd(tochild[PIPE_OUT]);
+    remember_coproc_fd(readfd);
+    remember_coproc_fd(writefd);
+
+    job_T *job = xmalloc(add(sizeof *job, sizeof *job->j_procs));
+    process_T *ps = job->j_procs;
+    ps->pr_pid = cpid;
+    ps->pr_status = JS_RUNNING;
+    ps->pr_statuscode = 0;
+    ps->pr_name = joinwcsarray(&argv[xoptind], L" ");
+    ps->pr_command = NULL;
+    job->j_pgid = doing_job_control_now ? cpid : 0;
+    job->j_status = JS_RUNNING;
+    job->j_statuschanged = true;
+    job->j_nonotify = false;
+    job->j_pcount = 1;
+    set_active_job(job);
+    add_job(shopt_curasync);
+
+    void **fds = xmallocn(3, sizeof *fds);
+    fds[0] = malloc_wprintf(L"%d", readfd);
+    fds[1] = malloc_wprintf(L"%d", writefd);
+    fds[2] = NULL;
+    bool ok = set_array(name, 2, fds, SCOPE_GLOBAL, false) != NULL;
+    if (ok) {
+        wchar_t *pidname = malloc_wprintf(L"%ls_PID", name);
+        ok = set_variable(pidname, malloc_wprintf(L"%jd", (intmax_t) cpid),
+                SCOPE_GLOBAL, false);
+        free(pidname);
+    }
+    if (!ok) {
+        /* The FDs would be unreachable, so close them to let the coprocess
+         * see the end of its input. */
+        xclose(readfd);
+        xclose(writefd);
+        return Exit_FAILURE;
+    }
+    return Exit_SUCCESS;
+
+pipe_error:
+    xerror(errno, Ngt("cannot open a pipe"));
+    return Exit_FAILURE;
+}
+
+/* Moves the specified FD to a new FD that is not less than 10 so that it does
+ * not conflict with FDs used by redirections in scripts. The new FD has the
+ * close-on-exec flag so that it is not inherited by other commands. Unlike
+ * shell FDs, the FD can be used in redirections. Returns the new FD, or the
+ * original FD if it cannot be moved. */
+int move_to_coproc_fd(int fd)
+{
+    int newfd = fcntl(fd, F_DUPFD, 10);
+    if (newfd < 0)
+        return fd;
+    xclose(fd);
+    fcntl(newfd, F_SETFD, FD_CLOEXEC);
+    return newfd;
+}
+
+/* Adds the specified coprocess FD to `coprocfds'. Entries for FDs that have
+ * been closed since they were added are removed. */
+void remember_coproc_fd(int fd)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < coprocfdcount; i++)
+        if (is_coproc_fd_open(&coprocfds[i]))
+            coprocfds[count++] = coprocfds[i];
+    coprocfdcount = count;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return;
+    if (coprocfdcount == coprocfdmax) {
+        coprocfdmax = (coprocfdmax == 0) ? 8 : coprocfdmax * 2;
+        coprocfds = xreallocn(coprocfds, coprocfdmax, sizeof *coprocfds);
+    }
+    coprocfds[coprocfdcount++] = (coprocfd_T) {
+        .fd = fd, .dev = st.st_dev, .ino = st.st_ino,
+    };
+}
+
+/* Tests if the FD of the specified entry still refers to the same pipe. */
+bool is_coproc_fd_open(const coprocfd_T *cfd)
+{
+    struct stat st;
+    return fstat(cfd->fd, &st) >= 0
+        && st.st_dev == cfd->dev && st.st_ino == cfd->ino;
+}
+
+/* Closes the FDs of the existing coprocesses. Called in a new coprocess. */
+void close_coproc_fds(void)
+{
+    for (size_t i = 0; i < coprocfdcount; i++)
+        if (is_coproc_fd_open(&coprocfds[i]))
+            xclose(coprocfds[i].fd);
+    coprocfdcount = 0;
+}
+
+#if YASH_ENABLE_HELP
+const char coproc_help[] = Ngt(
+"start a command connected to the shell via pipes"
+);
+const char coproc_syntax[] = Ngt(
+"\tcoproc [-n name] command [argument...]\n"
+);
+#endif
+
 /* The "times" built-in. */
 int times_builtin(int argc __attribute__((unused)), void **argv)
 {
@@ -61,6 +61,9 @@ struct and_or_T;
 struct embedcmd_T;
 extern void exec_and_or_lists(const struct and_or_T *a, _Bool finally_exit);
 extern struct xwcsbuf_T *get_xtrace_buffer(void);
+extern void flush_xtrace(void);
+extern void check_xtrace_fd(const wchar_t *value)
+    __attribute__((nonnull));
 extern pid_t fork_and_reset(pid_t pgid, _Bool fg, sigtype_T sigtype);
 extern wchar_t *exec_command_substitution(const struct embedcmd_T *cmdsub)
     __attribute__((nonnull,malloc,warn_unused_result));
@@ -72,6 +75,7 @@ extern int exec_variable_as_auxiliary(
     __attribute__((nonnull));
 #define exec_variable_as_auxiliary_(varname) \
         exec_variable_as_auxiliary(L varname, "$" varname)
+extern double get_real_time(void);
 
 #if YASH_ENABLE_LINEEDIT
 extern _Bool autoload_completion_function_file(
@@ -124,6 +128,13 @@ extern const char command_help[], command_syntax[], type_help[], type_syntax[];
 #endif
 extern const struct xgetopt_T command_options[];
 
+extern int coproc_builtin(int argc, void **argv)
+    __attribute__((nonnull));
+#if YASH_ENABLE_HELP
+extern const char coproc_help[], coproc_syntax[];
+#endif
+extern const struct xgetopt_T coproc_options[];
+
 extern int times_builtin(int argc, void **argv)
     __attribute__((nonnull));
 #if YASH_ENABLE_HELP
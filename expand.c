@@ -28,6 +28,7 @@
 #include <unistd.h>
 #include <wchar.h>
 #include <wctype.h>
+#include "arena.h"
 #include "arith.h"
 #include "exec.h"
 #include "input.h"
@@ -53,6 +54,10 @@ struct expand_four_T {
  * must have as many strings as `valuelist' and each string in `cclist' must
  * have the same length as the corresponding wide string in `valuelist'. */
 
+static wchar_t *expand_trivial(const wordunit_T *w)
+    __attribute__((malloc,warn_unused_result));
+static const paramexp_T *double_quoted_param(const wordunit_T *w)
+    __attribute__((nonnull,pure));
 static plist_T expand_word(const wordunit_T *w)
     __attribute__((warn_unused_result));
 static struct expand_four_T expand_four(const wordunit_T *restrict w,
@@ -73,6 +78,9 @@ static struct expand_four_T expand_param(const paramexp_T *p, bool indq)
     __attribute__((nonnull));
 static enum indextype_T parse_indextype(const wchar_t *indexstr)
     __attribute__((nonnull,pure));
+static void wstring_range(size_t len, ssize_t startindex, ssize_t endindex,
+        size_t *startp, size_t *endp)
+    __attribute__((nonnull));
 static wchar_t *trim_wstring(wchar_t *s, ssize_t startindex, ssize_t endindex)
     __attribute__((nonnull));
 static void **trim_array(void **a, ssize_t startindex, ssize_t endindex)
@@ -122,17 +130,39 @@ static bool try_expand_brace_sequence(
         const struct brace_expand_T *restrict e, size_t ci,
         xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf)
     __attribute__((nonnull));
+static bool parse_brace_sequence(const wchar_t *restrict s,
+        brace_sequence_T *restrict seq, const wchar_t **restrict endp)
+    __attribute__((nonnull));
 static bool has_leading_zero(const wchar_t *restrict s, bool *restrict sign)
     __attribute__((nonnull));
 
 static void fieldsplit(void **restrict valuelist, void **restrict cclist,
         plist_T *restrict outvaluelist, plist_T *restrict outcclist)
     __attribute__((nonnull));
-static bool is_ifs_char(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+/* A set of IFS characters prepared for field splitting */
+#define IFSSET_ASCII_SIZE 128
+enum { IFS_CHAR = 1 << 0, IFS_WHITESPACE = 1 << 1, };
+struct ifsset_T {
+    unsigned char ascii[IFSSET_ASCII_SIZE]; /* classes of ASCII characters */
+    const wchar_t *ifs;                     /* the original IFS value */
+    bool nonascii;                          /* `ifs' has non-ASCII chars? */
+};
+static void init_ifsset(struct ifsset_T *restrict set, const wchar_t *ifs)
+    __attribute__((nonnull));
+static wchar_t *extract_fields_by_set(const wchar_t *restrict s,
+        const char *restrict cc, const struct ifsset_T *restrict set,
+        plist_T *restrict dest)
+    __attribute__((nonnull));
+static inline int ifs_class(wchar_t c, const struct ifsset_T *set)
     __attribute__((nonnull,pure));
-static bool is_ifs_whitespace(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+static inline bool is_ifs_char(
+        wchar_t c, charcategory_T cc, const struct ifsset_T *set)
     __attribute__((nonnull,pure));
-static bool is_non_ifs_char(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+static inline bool is_ifs_whitespace(
+        wchar_t c, charcategory_T cc, const struct ifsset_T *set)
+    __attribute__((nonnull,pure));
+static inline bool is_non_ifs_char(
+        wchar_t c, charcategory_T cc, const struct ifsset_T *set)
     __attribute__((nonnull,pure));
 static void add_empty_field(plist_T *dest, const wchar_t *p)
     __attribute__((nonnull));
@@ -140,11 +170,16 @@ static void add_empty_field(plist_T *dest, const wchar_t *p)
 static inline void add_sq(
         const wchar_t *restrict *ss, xwcsbuf_T *restrict buf, bool escape)
     __attribute__((nonnull));
+static bool has_quotation(const char *cc, size_t n)
+    __attribute__((nonnull,pure));
 static inline bool should_escape(charcategory_T cc, escaping_T escaping)
     __attribute__((const));
 static wchar_t *quote_removal_free(
         wchar_t *restrict s, char *restrict cc, escaping_T escaping)
     __attribute__((nonnull,malloc,warn_unused_result));
+static wchar_t *quote_removal_scratch(
+        const wchar_t *restrict s, const char *restrict cc, escaping_T escaping)
+    __attribute__((nonnull,malloc,warn_unused_result));
 
 static enum wglobflags_T get_wglobflags(void)
     __attribute__((pure));
@@ -155,6 +190,15 @@ static void glob_all(
 static void maybe_exit_on_error(void);
 
 
+/* Arena for temporaries used in field splitting and pathname expansion of a
+ * single word. It is reset after each word is expanded. Nothing allocated
+ * in it survives the expansion: the resulting fields are malloced as usual.
+ * Expansions nested in command substitutions never run between the field
+ * splitting and pathname expansion of a word, so the arena is not shared by
+ * words expanded at the same time. */
+static arena_T scratch;
+
+
 /********** Entry Points **********/
 
 /* Expands a command line.
@@ -192,6 +236,12 @@ bool expand_line(void *const *restrict args,
  * On error in a non-interactive shell, the shell exits. */
 bool expand_multiple(const wordunit_T *w, plist_T *list)
 {
+    wchar_t *trivial = expand_trivial(w);
+    if (trivial != NULL) {
+        pl_add(list, trivial);
+        return true;
+    }
+
     /* four expansions (w -> valuelist) */
     struct expand_four_T expand = expand_four(w, TT_SINGLE, Q_WORD, CC_LITERAL);
     if (expand.valuelist.contents == NULL) {
@@ -223,9 +273,82 @@ bool expand_multiple(const wordunit_T *w, plist_T *list)
     /* pathname expansion (and quote removal) */
     glob_all(&expand, list);
 
+    arena_reset(&scratch);
     return true;
 }
 
+/* Expands a word that is not subject to any expansion but quote removal
+ * without building the charcategory_T strings for the general expansion.
+ * The word must be either a single literal string that contains no quotes or
+ * characters subject to tilde, brace, or pathname expansion, or a parameter
+ * expansion of a set scalar variable enclosed in double-quotes like "$var".
+ * In these cases, the result is one field that is returned as a newly
+ * malloced string. Otherwise, NULL is returned and the word must be expanded
+ * in the general way. */
+wchar_t *expand_trivial(const wordunit_T *w)
+{
+    if (w == NULL || w->wu_type != WT_STRING)
+        return NULL;
+
+    if (w->next == NULL) {
+        const wchar_t *s = w->wu_string;
+        if (s[0] == L'~' || s[wcscspn(s, L"\\\"'*?[{")] != L'\0')
+            return NULL;
+        return xwcsdup(s);
+    }
+
+    const paramexp_T *p = double_quoted_param(w);
+    if (p == NULL || p->pe_type != PT_NONE || p->pe_start != NULL
+            || !is_name(p->pe_name))
+        return NULL;
+
+    /* Unset variables and arrays are left to the general expansion, which
+     * handles the "nounset" option and "$array" expanding to many fields. */
+    const wchar_t *value = getvar(p->pe_name);
+    if (value == NULL)
+        return NULL;
+    return xwcsdup(value);
+}
+
+/* If the word consists only of a parameter expansion enclosed in double-quotes
+ * like "$var" or "${var}", returns the parameter expansion. Otherwise, returns
+ * NULL. */
+const paramexp_T *double_quoted_param(const wordunit_T *w)
+{
+    /* check for the three word units: "\"", "$var", and "\"" */
+    if (w->wu_type != WT_STRING || wcscmp(w->wu_string, L"\"") != 0)
+        return NULL;
+    const wordunit_T *w2 = w->next;
+    if (w2 == NULL || w2->wu_type != WT_PARAM)
+        return NULL;
+    const wordunit_T *w3 = w2->next;
+    if (w3 == NULL || w3->next != NULL || w3->wu_type != WT_STRING
+            || wcscmp(w3->wu_string, L"\"") != 0)
+        return NULL;
+    return w2->wu_param;
+}
+
+/* If the word is a double-quoted parameter expansion that expands to all the
+ * elements of an array like "$array", "${array[@]}", or "$@", returns the name
+ * of the array ("@" for the positional parameters). Otherwise, returns NULL.
+ * The returned name may not be an actual array; the caller must check it. */
+const wchar_t *whole_array_expansion_name(const wordunit_T *w)
+{
+    const paramexp_T *p = double_quoted_param(w);
+    if (p == NULL || p->pe_type != PT_NONE)
+        return NULL;
+    if (p->pe_start != NULL) {
+        const wordunit_T *start = p->pe_start;
+        if (p->pe_end != NULL || start->next != NULL
+                || start->wu_type != WT_STRING
+                || wcscmp(start->wu_string, L"@") != 0)
+            return NULL;
+    }
+    if (wcscmp(p->pe_name, L"@") != 0 && !is_name(p->pe_name))
+        return NULL;
+    return p->pe_name;
+}
+
 /* Expands a word to a single field.
  * If successful, the result is a pair of newly malloced strings.
  * On error, an error message is printed and a NULL pair is returned.
@@ -281,6 +404,14 @@ struct cc_word_T expand_single_cc(
  * On error, the return value is a plist_T with `contents' being NULL. */
 plist_T expand_word(const wordunit_T *w)
 {
+    plist_T list;
+    wchar_t *trivial = expand_trivial(w);
+    if (trivial != NULL) {
+        pl_init(&list);
+        pl_add(&list, trivial);
+        return list;
+    }
+
     /* four expansions */
     struct expand_four_T expand = expand_four(w, TT_NONE, Q_WORD, CC_LITERAL);
 
@@ -657,6 +788,7 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
     /* parse indices first */
     ssize_t startindex, endindex;
     enum indextype_T indextype;
+    wchar_t *key = NULL;  /* key to an element of an associative array */
     if (p->pe_start == NULL) {
         startindex = 0, endindex = SSIZE_MAX, indextype = IDX_NONE;
     } else {
@@ -671,6 +803,14 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
                 xerror(0, Ngt("the parameter index is invalid"));
                 goto failure1;
             }
+        } else if (!(p->pe_type & PT_NEST) && is_assoc_array(p->pe_name)) {
+            if (p->pe_end != NULL) {
+                free(start);
+                xerror(0, Ngt("the parameter index is invalid"));
+                goto failure1;
+            }
+            key = start;
+            startindex = 0, endindex = SSIZE_MAX;
         } else if (!evaluate_index(start, &startindex)) {
             goto failure1;
         } else {
@@ -701,15 +841,20 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
             goto failure1;
         v.type = (plist.length == 1) ? GV_SCALAR : GV_ARRAY;
         v.count = plist.length;
+        v.length = (plist.length == 1) ? wcslen(plist.contents[0]) : 0;
         v.values = pl_toary(&plist);
         v.freevalues = true;
         unset = false;
     } else {
-        v = get_variable(p->pe_name);
+        if (key != NULL)
+            v = get_assoc_element(p->pe_name, key);
+        else
+            v = get_variable(p->pe_name);
         if (v.type == GV_NOTFOUND) {
             /* if the variable is not set, return empty string */
             v.type = GV_SCALAR;
             v.count = 1;
+            v.length = 0;
             v.values = xmallocn(2, sizeof *v.values);
             v.values[0] = xwcsdup(L"");
             v.values[1] = NULL;
@@ -725,18 +870,35 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
     /* modify the elements of `v.values' according to the indices */
     void **values;  /* the result */
     bool concat;    /* concatenate array elements? */
+    bool counted = false;  /* PT_NUMBER already applied? */
     switch (v.type) {
         case GV_SCALAR:
             assert(v.values != NULL && v.count == 1);
-            save_get_variable_values(&v);
-            if (indextype != IDX_NUMBER) {
+            if (indextype == IDX_NUMBER) {
+                if (v.freevalues)
+                    plfree(v.values, free);
+                values = xmallocn(2, sizeof *values);
+                values[0] = malloc_wprintf(L"%zu", v.length);
+                values[1] = NULL;
+            } else if (v.freevalues) {
                 trim_wstring(v.values[0], startindex, endindex);
+                values = v.values;
             } else {
-                size_t len = wcslen(v.values[0]);
-                free(v.values[0]);
-                v.values[0] = malloc_wprintf(L"%zu", len);
+                /* The value is borrowed from the variable; copy only the part
+                 * that remains, or only count it for ${#var}. */
+                const wchar_t *value = v.values[0];
+                size_t start, end;
+                wstring_range(v.length, startindex, endindex, &start, &end);
+                values = xmallocn(2, sizeof *values);
+                if (p->pe_type & PT_NUMBER) {
+                    values[0] = malloc_wprintf(L"%zu", end - start);
+                    counted = true;
+                } else {
+                    values[0] = xwcsndup(&value[start], end - start);
+                }
+                values[1] = NULL;
             }
-            values = v.values, concat = false;
+            concat = false;
             break;
         case GV_ARRAY:
             concat = false;
@@ -811,6 +973,7 @@ treat_array:
         if (unset) {
 subst:
             plfree(values, free);
+            free(key);
             return expand_four(p->pe_subst, TT_SINGLE, substq,
                     CC_SOFT_EXPANSION | (indq * CC_QUOTED));
         }
@@ -837,7 +1000,12 @@ subst:
             subst = expand_single(p->pe_subst, TT_SINGLE, substq, ES_NONE);
             if (subst == NULL)
                 goto failure1;
-            if (v.type != GV_ARRAY) {
+            if (key != NULL) {
+                if (!set_assoc_element(p->pe_name, key, xwcsdup(subst))) {
+                    free(subst);
+                    goto failure1;
+                }
+            } else if (v.type != GV_ARRAY) {
                 assert(v.type == GV_NOTFOUND || v.type == GV_SCALAR);
                 if (!set_variable(
                             p->pe_name, xwcsdup(subst), SCOPE_GLOBAL, false)) {
@@ -864,6 +1032,8 @@ subst:
         }
         break;
     }
+    free(key);
+    key = NULL;
 
     if (unset && !shopt_unset) {
         xerror(0, Ngt("parameter `%ls' is not set"), p->pe_name);
@@ -900,7 +1070,7 @@ subst:
         values = concatenate_values_into_array(values, false);
 
     /* PT_NUMBER */
-    if (p->pe_type & PT_NUMBER)
+    if ((p->pe_type & PT_NUMBER) && !counted)
         subst_length_each(values);
 
     struct expand_four_T e;
@@ -931,6 +1101,7 @@ subst:
 failure2:
     plfree(values, free);
 failure1:
+    free(key);
     e.valuelist.contents = e.cclist.contents = NULL;
     return e;
 }
@@ -949,6 +1120,27 @@ enum indextype_T parse_indextype(const wchar_t *indexstr)
     return IDX_NONE;
 }
 
+/* Computes the range of characters that remain when a wide string of length
+ * `len' is trimmed by `trim_wstring' with `startindex' and `endindex'.
+ * The range [`*startp', `*endp') is clamped to [0, `len']. */
+void wstring_range(size_t len, ssize_t startindex, ssize_t endindex,
+        size_t *startp, size_t *endp)
+{
+    if (startindex < 0) {
+        startindex += len;
+        if (startindex < 0)
+            startindex = 0;
+    }
+    if (endindex < 0)
+        endindex += len + 1;
+
+    size_t start = ((size_t) startindex > len) ? len : (size_t) startindex;
+    size_t end = (endindex < 0) ? 0
+        : ((size_t) endindex > len) ? len : (size_t) endindex;
+    *startp = start;
+    *endp = (end < start) ? start : end;
+}
+
 /* Trims some leading and trailing characters of the wide string.
  * Characters in the range [`startindex', `endindex') remain.
  * Returns the string `s'. */
@@ -1418,8 +1610,54 @@ bool try_expand_brace_sequence(
 
     size_t starti = ci;
 
+    brace_sequence_T seq;
+    const wchar_t *cp;
+    if (!parse_brace_sequence(&e->word[ci], &seq, &cp))
+        return false;
+
+    /* validate charcategory_T */
+    size_t bracei = cp - e->word;
+    if (e->cc[bracei] != CC_LITERAL)
+        return false;
+    for (ci = starti; ci < bracei; ci++)
+        if (e->cc[ci] & CC_QUOTED)
+            return false;
+
+    /* expand the sequence */
+    ci = bracei + 1;
+    do {
+        xwcsbuf_T valuebuf2;
+        xstrbuf_T ccbuf2;
+        wb_initwithmax(&valuebuf2, valuebuf->maxlength);
+        wb_ncat_force(&valuebuf2, valuebuf->contents, valuebuf->length);
+        sb_initwithmax(&ccbuf2, ccbuf->maxlength);
+        sb_ncat_force(&ccbuf2, ccbuf->contents, ccbuf->length);
+
+        /* format the number */
+        size_t oldlength = valuebuf2.length;
+        wb_catfree(&valuebuf2, next_brace_sequence_value(&seq));
+        sb_ccat_repeat(
+                &ccbuf2, CC_HARD_EXPANSION, valuebuf2.length - oldlength);
+
+        /* expand the remaining portion recursively */
+        generate_brace_expand_results(e, ci, &valuebuf2, &ccbuf2);
+    } while (!seq.done);
+
+    wb_destroy(valuebuf);
+    sb_destroy(ccbuf);
+    return true;
+}
+
+/* Parses a numeric brace sequence like "1..10..2}".
+ * `s' must point to the character just after the L'{'.
+ * If successful, `*seq' is initialized to produce the first value of the
+ * sequence, a pointer to the closing L'}' is assigned to `*endp', and true is
+ * returned. Otherwise, false is returned. */
+bool parse_brace_sequence(const wchar_t *restrict s,
+        brace_sequence_T *restrict seq, const wchar_t **restrict endp)
+{
     /* parse the starting point */
-    const wchar_t *c = &e->word[ci];
+    const wchar_t *c = s;
     wchar_t *cp;
     errno = 0;
     long start = wcstol(c, &cp, 10);
@@ -1457,48 +1695,55 @@ bool try_expand_brace_sequence(
         return false;
     }
 
-    /* validate charcategory_T */
-    size_t bracei = cp - e->word;
-    if (e->cc[bracei] != CC_LITERAL)
-        return false;
-    for (ci = starti; ci < bracei; ci++)
-        if (e->cc[ci] & CC_QUOTED)
-            return false;
+    seq->value = start;
+    seq->end = end;
+    seq->delta = delta;
+    seq->width = (startlen > endlen) ? startlen : endlen;
+    seq->sign = sign;
+    seq->done = false;
+    *endp = cp;
+    return true;
+}
 
-    /* expand the sequence */
-    long value = start;
-    int len = (startlen > endlen) ? startlen : endlen;
-    ci = cp - e->word + 1;
-    do {
-        xwcsbuf_T valuebuf2;
-        xstrbuf_T ccbuf2;
-        wb_initwithmax(&valuebuf2, valuebuf->maxlength);
-        wb_ncat_force(&valuebuf2, valuebuf->contents, valuebuf->length);
-        sb_initwithmax(&ccbuf2, ccbuf->maxlength);
-        sb_ncat_force(&ccbuf2, ccbuf->contents, ccbuf->length);
+/* Checks if the word consists only of a numeric brace sequence like
+ * "{1..10..2}" that is subject to brace expansion.
+ * If so, `*seq' is initialized to produce the values of the sequence one by one
+ * and true is returned. Otherwise, false is returned. */
+bool parse_brace_sequence_word(
+        const wordunit_T *restrict w, brace_sequence_T *restrict seq)
+{
+    if (!shopt_braceexpand || w->wu_type != WT_STRING || w->next != NULL)
+        return false;
 
-        /* format the number */
-        int plen =
-            wb_wprintf(&valuebuf2, sign ? L"%0+*ld" : L"%0*ld", len, value);
-        if (plen >= 0)
-            sb_ccat_repeat(&ccbuf2, CC_HARD_EXPANSION, plen);
+    const wchar_t *s = w->wu_string, *end;
+    return s[0] == L'{' && parse_brace_sequence(&s[1], seq, &end)
+        && end[1] == L'\0';
+}
 
-        /* expand the remaining portion recursively */
-        generate_brace_expand_results(e, ci, &valuebuf2, &ccbuf2);
+/* Returns the current value of the brace sequence as a newly malloced string
+ * and advances the sequence to the next value.
+ * `seq->done' must be false when this function is called. It becomes true when
+ * the returned value is the last one. */
+wchar_t *next_brace_sequence_value(brace_sequence_T *seq)
+{
+    assert(!seq->done);
 
-        if (delta >= 0) {
-            if (LONG_MAX - delta < value)
-                break;
-        } else {
-            if (LONG_MIN - delta > value)
-                break;
-        }
-        value += delta;
-    } while (delta >= 0 ? value <= end : value >= end);
+    wchar_t *result = malloc_wprintf(
+            seq->sign ? L"%0+*ld" : L"%0*ld", seq->width, seq->value);
 
-    wb_destroy(valuebuf);
-    sb_destroy(ccbuf);
-    return true;
+    if (seq->delta >= 0) {
+        if (LONG_MAX - seq->delta < seq->value)
+            seq->done = true;
+    } else {
+        if (LONG_MIN - seq->delta > seq->value)
+            seq->done = true;
+    }
+    if (!seq->done) {
+        seq->value += seq->delta;
+        seq->done = (seq->delta >= 0)
+            ? seq->value > seq->end : seq->value < seq->end;
+    }
+    return result;
 }
 
 /* Checks if the specified numeral starts with a L'0'.
@@ -1525,7 +1770,8 @@ bool has_leading_zero(const wchar_t *restrict s, bool *restrict sign)
  * `valuelist' is a NULL-terminated array of pointers to wide strings to split.
  * `cclist' is an array of pointers to corresponding charcategory_T strings.
  * `valuelist' and `cclist' are `plfree'ed in this function.
- * The results are added to `outvaluelist' and `outcclist'. */
+ * The results are added to `outvaluelist' and `outcclist'. The strings added
+ * to `outcclist' belong to the scratch arena and must not be freed. */
 void fieldsplit(void **restrict const valuelist, void **restrict const cclist,
         plist_T *restrict outvaluelist, plist_T *restrict outcclist)
 {
@@ -1533,13 +1779,16 @@ void fieldsplit(void **restrict const valuelist, void **restrict const cclist,
     if (ifs == NULL)
         ifs = DEFAULT_IFS;
 
+    struct ifsset_T set;
+    init_ifsset(&set, ifs);
+
     plist_T fields;
     pl_init(&fields);
 
     for (size_t i = 0; valuelist[i] != NULL; i++) {
         wchar_t *s = valuelist[i];
         char *cc = cclist[i];
-        extract_fields(s, cc, ifs, &fields);
+        extract_fields_by_set(s, cc, &set, &fields);
         assert(fields.length % 2 == 0);
 
         if (fields.length == 2 && fields.contents[0] == s &&
@@ -1547,14 +1796,16 @@ void fieldsplit(void **restrict const valuelist, void **restrict const cclist,
             /* The result is the same as the original field. */
             pl_add(outvaluelist, s);
             pl_add(outcclist, cc);
+            arena_defer(&scratch, free, cc);
         } else {
             /* Produce new fields. */
             for (size_t j = 0; j < fields.length; j += 2) {
                 const wchar_t *start = fields.contents[j];
                 const wchar_t *end = fields.contents[j + 1];
                 size_t idx = start - s, len = end - start;
+                char *fieldcc = arena_alloc(&scratch, add(len, 1));
                 pl_add(outvaluelist, xwcsndup(start, len));
-                pl_add(outcclist, memcpy(xmalloc(len), &cc[idx], len));
+                pl_add(outcclist, memcpy(fieldcc, &cc[idx], len));
             }
             free(s);
             free(cc);
@@ -1601,6 +1852,16 @@ void fieldsplit(void **restrict const valuelist, void **restrict const cclist,
  */
 wchar_t *extract_fields(const wchar_t *restrict s, const char *restrict cc,
         const wchar_t *restrict ifs, plist_T *restrict dest)
+{
+    struct ifsset_T set;
+    init_ifsset(&set, ifs);
+    return extract_fields_by_set(s, cc, &set, dest);
+}
+
+/* Like `extract_fields', but takes an IFS set prepared by `init_ifsset'. */
+wchar_t *extract_fields_by_set(const wchar_t *restrict s,
+        const char *restrict cc, const struct ifsset_T *restrict set,
+        plist_T *restrict dest)
 {
     size_t index = 0;
     size_t ifswhitestartindex;
@@ -1612,12 +1873,12 @@ wchar_t *extract_fields(const wchar_t *restrict s, const char *restrict cc,
 
     for (;;) {
         ifswhitestartindex = index;
-        while (is_ifs_whitespace(s[index], cc[index], ifs))
+        while (is_ifs_whitespace(s[index], cc[index], set))
             index++;
 
         /* extract next field, if any */
         size_t fieldstartindex = index;
-        while (is_non_ifs_char(s[index], cc[index], ifs))
+        while (is_non_ifs_char(s[index], cc[index], set))
             index++;
         if (index != fieldstartindex) {
             pl_add(pl_add(dest, &s[fieldstartindex]), &s[index]);
@@ -1634,8 +1895,8 @@ wchar_t *extract_fields(const wchar_t *restrict s, const char *restrict cc,
             break;
 
         /* skip (only) one IFS non-whitespace */
-        assert(is_ifs_char(s[index], cc[index], ifs));
-        assert(!is_ifs_whitespace(s[index], cc[index], ifs));
+        assert(is_ifs_char(s[index], cc[index], set));
+        assert(!is_ifs_whitespace(s[index], cc[index], set));
         index++;
         afterfield = false;
     }
@@ -1651,22 +1912,52 @@ wchar_t *extract_fields(const wchar_t *restrict s, const char *restrict cc,
     return (wchar_t *) &s[ifswhitestartindex];
 }
 
+/* Initializes `*set' for the IFS characters in `ifs'.
+ * The classes of ASCII characters are cached in a table so that most
+ * characters can be classified without searching `ifs'. */
+void init_ifsset(struct ifsset_T *restrict set, const wchar_t *ifs)
+{
+    memset(set->ascii, 0, sizeof set->ascii);
+    set->ifs = ifs;
+    set->nonascii = false;
+    for (; *ifs != L'\0'; ifs++) {
+        if ((unsigned long) *ifs < IFSSET_ASCII_SIZE)
+            set->ascii[*ifs] = IFS_CHAR | (iswspace(*ifs) ? IFS_WHITESPACE : 0);
+        else
+            set->nonascii = true;
+    }
+}
+
+/* Returns the IFS class (IFS_CHAR and IFS_WHITESPACE) of character `c', which
+ * must not be null. */
+int ifs_class(wchar_t c, const struct ifsset_T *set)
+{
+    if ((unsigned long) c < IFSSET_ASCII_SIZE)
+        return set->ascii[c];
+    if (!set->nonascii || wcschr(set->ifs, c) == NULL)
+        return 0;
+    return IFS_CHAR | (iswspace(c) ? IFS_WHITESPACE : 0);
+}
+
 /* Returns true if `c' is a non-null, IFS character. */
-bool is_ifs_char(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+bool is_ifs_char(wchar_t c, charcategory_T cc, const struct ifsset_T *set)
 {
-    return cc == CC_SOFT_EXPANSION && c != L'\0' && wcschr(ifs, c) != NULL;
+    return cc == CC_SOFT_EXPANSION && c != L'\0'
+        && (ifs_class(c, set) & IFS_CHAR);
 }
 
 /* Returns true if `c' is a non-null, IFS-whitespace character. */
-bool is_ifs_whitespace(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+bool is_ifs_whitespace(
+        wchar_t c, charcategory_T cc, const struct ifsset_T *set)
 {
-    return is_ifs_char(c, cc, ifs) && iswspace(c);
+    return cc == CC_SOFT_EXPANSION && c != L'\0'
+        && (ifs_class(c, set) & IFS_WHITESPACE);
 }
 
 /* Returns true if `c' is a non-null, non-IFS character. */
-bool is_non_ifs_char(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+bool is_non_ifs_char(wchar_t c, charcategory_T cc, const struct ifsset_T *set)
 {
-    return c != L'\0' && !is_ifs_char(c, cc, ifs);
+    return c != L'\0' && !is_ifs_char(c, cc, set);
 }
 
 void add_empty_field(plist_T *dest, const wchar_t *p)
@@ -1874,6 +2165,16 @@ bool should_escape(charcategory_T cc, escaping_T escaping)
     assert(false);
 }
 
+/* Returns true if any of the first `n' values in `cc' has the CC_QUOTATION
+ * flag. */
+bool has_quotation(const char *cc, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        if (cc[i] & CC_QUOTATION)
+            return true;
+    return false;
+}
+
 /* Removes all quotation marks in the input string `s' and optionally add
  * backslash escapes to the originally quoted characters as specified by
  * `escaping'. The result is a newly malloced string. */
@@ -1902,6 +2203,25 @@ wchar_t *quote_removal_free(
     return result;
 }
 
+/* Like `quote_removal', but the result is allocated in the scratch arena. */
+wchar_t *quote_removal_scratch(
+        const wchar_t *restrict s, const char *restrict cc, escaping_T escaping)
+{
+    size_t len = wcslen(s);
+    wchar_t *result = arena_alloc(&scratch,
+            mul(add(mul(len, 2), 1), sizeof *result));
+    wchar_t *r = result;
+    for (size_t i = 0; i < len; i++) {
+        if (cc[i] & CC_QUOTATION)
+            continue;
+        if (should_escape(cc[i], escaping))
+            *r++ = L'\\';
+        *r++ = s[i];
+    }
+    *r = L'\0';
+    return result;
+}
+
 
 /********** Pathname Expansion (Glob) **********/
 
@@ -1913,13 +2233,15 @@ enum wglobflags_T get_wglobflags(void)
     if (shopt_dotglob)      flags |= WGLB_PERIOD;
     if (shopt_markdirs)     flags |= WGLB_MARK;
     if (shopt_extendedglob) flags |= WGLB_RECDIR;
+    if (shopt_parallelglob) flags |= WGLB_PARALLEL;
     return flags;
 }
 
 /* Performs pathname expansion.
  * If `shopt_glob' is off or a field is not a pattern, quote removal is
  * performed instead.
- * The input lists and their contents in `e' are freed in this function.
+ * The input lists and the strings in `e->valuelist' are freed in this function.
+ * The strings in `e->cclist' must belong to the scratch arena.
  * The results are added to `results' as newly-malloced wide strings. */
 void glob_all(struct expand_four_T *restrict e, plist_T *restrict results)
 {
@@ -1929,7 +2251,16 @@ void glob_all(struct expand_four_T *restrict e, plist_T *restrict results)
     for (size_t i = 0; i < e->valuelist.length; i++) {
         wchar_t *field = e->valuelist.contents[i];
         char *cc = e->cclist.contents[i];
-        wchar_t *pattern = quote_removal(field, cc, ES_QUOTED_HARD);
+
+        /* A field without quotation marks or pattern characters is the
+         * result as is. This is typical of fields produced by splitting. */
+        size_t len = wcscspn(field, L"*?[\\");
+        if (field[len] == L'\0' && !has_quotation(cc, len)) {
+            pl_add(results, field);
+            continue;
+        }
+
+        wchar_t *pattern = quote_removal_scratch(field, cc, ES_QUOTED_HARD);
         if (shopt_glob && is_pathname_matching_pattern(pattern)) {
             if (!unblock) {
                 set_interruptible_by_sigint(true);
@@ -1947,8 +2278,6 @@ quote_removal:
             pl_add(results, quote_removal(field, cc, ES_NONE));
         }
         free(field);
-        free(cc);
-        free(pattern);
     }
     if (unblock)
         set_interruptible_by_sigint(false);
@@ -1968,6 +2297,26 @@ quote_removal:
  * This function uses the parser, so the parser state must have been saved if
  * this function is called during another parse. */
 wchar_t *parse_and_expand_string(const wchar_t *s, const char *name, bool esc)
+{
+    wordunit_T *word;
+    wchar_t *result;
+
+    if (!parse_expandable_string(s, name, &word))
+        return NULL;
+    result = expand_single(word, TT_NONE, esc ? Q_INDQ : Q_LITERAL, ES_NONE);
+    wordfree(word);
+    return result;
+}
+
+/* Parses the specified string as if it were in double quotes, without
+ * expanding it. `name' is used in an error message if not NULL.
+ * If successful, the resulting word is assigned to `*resultp', which must be
+ * freed by `wordfree' after use, and true is returned. On a syntax error, an
+ * error message is printed and false is returned.
+ * This function uses the parser, so the parser state must have been saved if
+ * this function is called during another parse. */
+bool parse_expandable_string(
+        const wchar_t *s, const char *name, wordunit_T **resultp)
 {
     struct input_wcs_info_T winfo = {
         .src = s,
@@ -1982,14 +2331,7 @@ wchar_t *parse_and_expand_string(const wchar_t *s, const char *name, bool esc)
         .inputinfo = &winfo,
         .interactive = false,
     };
-    wordunit_T *word;
-    wchar_t *result;
-
-    if (!parse_string(&info, &word))
-        return NULL;
-    result = expand_single(word, TT_NONE, esc ? Q_INDQ : Q_LITERAL, ES_NONE);
-    wordfree(word);
-    return result;
+    return parse_string(&info, resultp);
 }
 
 /* This function is called when an expansion error occurred.
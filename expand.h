@@ -102,6 +102,23 @@ extern wchar_t *expand_single(
 extern char *expand_single_with_glob(const struct wordunit_T *arg)
     __attribute__((malloc,warn_unused_result));
 
+extern const wchar_t *whole_array_expansion_name(const struct wordunit_T *w)
+    __attribute__((nonnull,pure));
+
+/* state of numeric brace expansion like "{1..10..2}" */
+typedef struct brace_sequence_T {
+    long value, end, delta;
+    int width;        /* minimum number of digits (for leading zeros) */
+    _Bool sign;       /* print the plus sign for positive values? */
+    _Bool done;       /* no more values to produce? */
+} brace_sequence_T;
+
+extern _Bool parse_brace_sequence_word(
+        const struct wordunit_T *restrict w, brace_sequence_T *restrict seq)
+    __attribute__((nonnull));
+extern wchar_t *next_brace_sequence_value(brace_sequence_T *seq)
+    __attribute__((nonnull,malloc,warn_unused_result));
+
 extern wchar_t *extract_fields(
         const wchar_t *restrict s, const char *restrict cc,
         const wchar_t *restrict ifs, struct plist_T *restrict dest)
@@ -131,6 +148,9 @@ extern wchar_t *quote_removal(
 extern wchar_t *parse_and_expand_string(
         const wchar_t *s, const char *name, _Bool esc)
     __attribute__((nonnull(1),malloc,warn_unused_result));
+extern _Bool parse_expandable_string(const wchar_t *s, const char *name,
+        struct wordunit_T **restrict resultp)
+    __attribute__((nonnull(1,3),warn_unused_result));
 
 
 #endif /* YASH_EXPAND_H */
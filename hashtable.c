@@ -28,7 +28,8 @@
 /* A hashtable is a mapping from keys to values.
  * Keys and values are all of type (void *).
  * NULL is allowed as a value, but not as a key.
- * The capacity of a hashtable is always no less than one. */
+ * The capacity of a hashtable is zero or a power of two, and it is zero only
+ * if no memory has been allocated for the hashtable. */
 
 /* The hashtable_T structure is defined as follows:
  *   struct hashtable_T {
@@ -36,27 +37,26 @@
  *      size_t             count;
  *      hashfunc_T        *hashfunc;
  *      keycmp             keycmp;
- *      size_t             emptyindex;
- *      size_t             tailindex;
- *      size_t            *indices;
  *      struct hash_entry *entries;
  *   }
  * `capacity' is the size of array `entries'.
  * `count' is the number of entries contained in the hashtable.
  * `hashfunc' is a pointer to the hash function.
  * `keycmp' is a pointer to the function that compares keys.
- * `emptyindex' is the index of the first empty entry.
- * `tailindex' is the index of the first tail entry.
- * `indices' is a pointer to the bucket array.
  * `entries' is a pointer to the array of entries.
  *
- * The collision resolution strategy used in this implementation is a kind of
- * separate chaining, but it differs from normal chaining in that entries are
- * stored in a single array (`entries'). An advantage over normal chaining,
- * which stores entries in linked lists, is spatial locality: entries can be
- * quickly referenced because they are collected in one array. Another advantage
- * is that we don't have to call `malloc' or `free' each time an entry is added
- * or removed. */
+ * The collision resolution strategy used in this implementation is open
+ * addressing with linear probing and Robin Hood insertion: an entry being
+ * inserted takes over the slot of an entry that is nearer to its home slot
+ * (the slot determined by the hash value), and the displaced entry continues
+ * probing. This keeps the probe sequences short and lets a search stop as soon
+ * as it meets an entry nearer to its home slot than the searched key would be.
+ * When an entry is removed, the following entries in the same probe sequence
+ * are shifted backward, so there are no "deleted" markers.
+ * The hash value of each entry is stored in the entry so that most non-matching
+ * entries are rejected without calling `keycmp'. All the entries are in one
+ * array, so a lookup usually touches only one or two cache lines besides the
+ * key itself. */
 
 
 //#define DEBUG_HASH 1
@@ -69,110 +69,114 @@ static void print_statistics(const hashtable_T *ht);
 #endif
 
 
-/* The null index */
-#define NOTHING ((size_t) -1)
-
 /* hashtable entry */
 struct hash_entry {
-    size_t next;
     hashval_T hash;
     kvpair_T kv;
 };
 /* An entry is occupied iff `.kv.key' is non-NULL.
- * When an entry is unoccupied, the values of the other members of the entry are
- * unspecified. */
+ * When an entry is unoccupied, the value of `hash' is unspecified. */
+
+/* the minimum non-zero capacity of a hashtable */
+#define MIN_CAPACITY 8
 
+/* Returns the maximum number of entries a hashtable with the specified
+ * capacity can contain. The load factor is kept no more than 1/2 because
+ * longer probe sequences cost more than the memory saved by a higher load. */
+static inline size_t max_count(size_t capacity)
+{
+    return capacity / 2;
+}
+
+/* Returns the index of the home slot for the specified hash value. */
+static inline size_t home_index(const hashtable_T *ht, hashval_T hash)
+{
+    return (size_t) (hash ^ (hash >> 16)) & (ht->capacity - 1);
+}
+
+/* Returns the distance of the entry at the specified index from its home slot.
+ * The entry must be occupied. */
+static inline size_t probe_distance(const hashtable_T *ht, size_t index)
+{
+    return (index - home_index(ht, ht->entries[index].hash))
+        & (ht->capacity - 1);
+}
 
 /* Initializes a hashtable with the specified capacity.
  * `hashfunc' is a hash function to hash keys.
- * `keycmp' is a function that compares two keys. */
+ * `keycmp' is a function that compares two keys.
+ * If `capacity' is zero, no memory is allocated until the first entry is added,
+ * which makes it cheap to create a hashtable that is likely to remain empty. */
 hashtable_T *ht_initwithcapacity(
         hashtable_T *ht, hashfunc_T *hashfunc, keycmp_T *keycmp,
         size_t capacity)
 {
-    if (capacity == 0)
-        capacity = 1;
-
-    ht->capacity = capacity;
+    ht->capacity = 0;
     ht->count = 0;
     ht->hashfunc = hashfunc;
     ht->keycmp = keycmp;
-    ht->emptyindex = NOTHING;
-    ht->tailindex = 0;
-    ht->indices = xmallocn(capacity, sizeof *ht->indices);
-    ht->entries = xmallocn(capacity, sizeof *ht->entries);
-
-    for (size_t i = 0; i < capacity; i++) {
-        ht->indices[i] = NOTHING;
-        ht->entries[i].kv.key = NULL;
-    }
-
+    ht->entries = NULL;
+    if (capacity > 0)
+        ht_setcapacity(ht, capacity);
     return ht;
 }
 
-/* Changes the capacity of the specified hashtable.
+/* Changes the capacity of the specified hashtable so that it can contain at
+ * least `newcapacity' entries without being resized.
  * If the specified new capacity is smaller than the number of the entries in
- * the hashtable, the capacity is not changed.
- * Note that the capacity cannot be zero. If `newcapacity' is zero, it is
- * assumed to be one. */
-/* Capacity should be an odd integer, especially a prime number. */
+ * the hashtable, the capacity is changed to fit the current entries. */
 hashtable_T *ht_setcapacity(hashtable_T *ht, size_t newcapacity)
 {
-    if (newcapacity == 0)
-        newcapacity = 1;
     if (newcapacity < ht->count)
         newcapacity = ht->count;
 
+    size_t capacity = MIN_CAPACITY;
+    while (max_count(capacity) < newcapacity)
+        capacity *= 2;
+
     size_t oldcapacity = ht->capacity;
-    size_t *oldindices = ht->indices;
-    size_t *newindices = xmallocn(newcapacity, sizeof *ht->indices);
     struct hash_entry *oldentries = ht->entries;
-    struct hash_entry *newentries = xmallocn(newcapacity, sizeof *ht->entries);
-    size_t tail = 0;
 
-    for (size_t i = 0; i < newcapacity; i++) {
-        newindices[i] = NOTHING;
-        newentries[i].kv.key = NULL;
-    }
+    ht->capacity = capacity;
+    ht->entries = xmallocn(capacity, sizeof *ht->entries);
+    for (size_t i = 0; i < capacity; i++)
+        ht->entries[i].kv.key = NULL;
 
-    /* move the data from oldentries to newentries */
+    /* move the data from oldentries to the new entries */
     for (size_t i = 0; i < oldcapacity; i++) {
-        void *key = oldentries[i].kv.key;
-        if (key != NULL) {
-            hashval_T hash = oldentries[i].hash;
-            size_t newindex = (size_t) hash % newcapacity;
-            newentries[tail] = (struct hash_entry) {
-                .next = newindices[newindex],
-                .hash = hash,
-                .kv = oldentries[i].kv,
-            };
-            newindices[newindex] = tail;
-            tail++;
+        struct hash_entry entry = oldentries[i];
+        if (entry.kv.key == NULL)
+            continue;
+
+        size_t index = home_index(ht, entry.hash);
+        size_t distance = 0;
+        while (ht->entries[index].kv.key != NULL) {
+            size_t d = probe_distance(ht, index);
+            if (d < distance) {
+                struct hash_entry temp = ht->entries[index];
+                ht->entries[index] = entry;
+                entry = temp;
+                distance = d;
+            }
+            index = (index + 1) & (capacity - 1);
+            distance++;
         }
+        ht->entries[index] = entry;
     }
 
-    free(oldindices);
     free(oldentries);
-    ht->capacity = newcapacity;
-    ht->emptyindex = NOTHING;
-    ht->tailindex = tail;
-    ht->indices = newindices;
-    ht->entries = newentries;
     return ht;
 }
 
 /* Increases the capacity as large as necessary
- * so that the capacity is no less than the specified. */
+ * so that the hashtable can contain at least the specified number of
+ * entries. */
 hashtable_T *ht_ensurecapacity(hashtable_T *ht, size_t capacity)
 {
-    if (capacity <= ht->capacity)
+    if (capacity <= max_count(ht->capacity))
         return ht;
-
-    size_t cap15 = ht->capacity + (ht->capacity >> 1);
-    if (capacity < cap15)
-        capacity = cap15;
-    if (capacity < ht->capacity + 6)
-        capacity = ht->capacity + 6;
+    if (capacity < ht->capacity)
+        capacity = ht->capacity;
     return ht_setcapacity(ht, capacity);
 }
 
@@ -182,40 +186,50 @@ hashtable_T *ht_ensurecapacity(hashtable_T *ht, size_t capacity)
  * The capacity of the hashtable is not changed. */
 hashtable_T *ht_clear(hashtable_T *ht, void freer(kvpair_T kv))
 {
-    size_t *indices = ht->indices;
     struct hash_entry *entries = ht->entries;
 
     if (ht->count == 0)
         return ht;
 
     for (size_t i = 0, cap = ht->capacity; i < cap; i++) {
-        indices[i] = NOTHING;
         if (entries[i].kv.key != NULL) {
             if (freer)
                 freer(entries[i].kv);
             entries[i].kv.key = NULL;
         }
     }
-
     ht->count = 0;
-    ht->emptyindex = NOTHING;
-    ht->tailindex = 0;
     return ht;
 }
 
-/* Returns the entry whose key is equal to the specified `key',
- * or { NULL, NULL } if `key' is NULL or there is no such entry. */
+/* Returns the index of the entry whose key is `key' in the hashtable.
+ * `hash' must be the hash value of `key'.
+ * If there is no such entry, returns the capacity of the hashtable. */
+static size_t find_index(
+        const hashtable_T *ht, const void *key, hashval_T hash)
+{
+    if (ht->count == 0)
+        return ht->capacity;
+
+    size_t mask = ht->capacity - 1;
+    size_t index = home_index(ht, hash);
+    for (size_t distance = 0; ; distance++, index = (index + 1) & mask) {
+        const struct hash_entry *entry = &ht->entries[index];
+        if (entry->kv.key == NULL || probe_distance(ht, index) < distance)
+            return ht->capacity;
+        if (entry->hash == hash && ht->keycmp(entry->kv.key, key) == 0)
+            return index;
+    }
+}
+
+/* Returns the entry whose key is equal to the specified `key' in the specified
+ * hashtable, or { NULL, NULL } if `key' is NULL or there is no such entry. */
 kvpair_T ht_get(const hashtable_T *ht, const void *key)
 {
-    if (key != NULL) {
-        hashval_T hash = ht->hashfunc(key);
-        size_t index = ht->indices[(size_t) hash % ht->capacity];
-        while (index != NOTHING) {
-            struct hash_entry *entry = &ht->entries[index];
-            if (entry->hash == hash && ht->keycmp(entry->kv.key, key) == 0)
-                return entry->kv;
-            index = entry->next;
-        }
+    if (key != NULL && ht->count > 0) {
+        size_t index = find_index(ht, key, ht->hashfunc(key));
+        if (index < ht->capacity)
+            return ht->entries[index].kv;
     }
     return (kvpair_T) { NULL, NULL, };
 }
@@ -230,67 +244,68 @@ kvpair_T ht_set(hashtable_T *ht, const void *key, const void *value)
 
     /* if there is an entry with the specified key, simply replace the value */
     hashval_T hash = ht->hashfunc(key);
-    size_t mhash = (size_t) hash % ht->capacity;
-    size_t index = ht->indices[mhash];
-    struct hash_entry *entry;
-    while (index != NOTHING) {
-        entry = &ht->entries[index];
-        if (entry->hash == hash && ht->keycmp(entry->kv.key, key) == 0) {
-            kvpair_T oldkv = entry->kv;
-            entry->kv = (kvpair_T) { (void *) key, (void *) value, };
-            DEBUG_PRINT_STATISTICS(ht);
-            return oldkv;
-        }
-        index = entry->next;
+    size_t index = find_index(ht, key, hash);
+    if (index < ht->capacity) {
+        kvpair_T oldkv = ht->entries[index].kv;
+        ht->entries[index].kv = (kvpair_T) { (void *) key, (void *) value, };
+        DEBUG_PRINT_STATISTICS(ht);
+        return oldkv;
     }
 
     /* No entry with the specified key was found; we add a new entry. */
-    index = ht->emptyindex;
-    if (index != NOTHING) {
-        /* if there is an empty entry, use it */
-        entry = &ht->entries[index];
-        ht->emptyindex = entry->next;
-    } else {
-        /* if there is no empty entry, use a tail entry */
-        ht_ensurecapacity(ht, ht->count + 1);
-        mhash = (size_t) hash % ht->capacity;
-        index = ht->tailindex++;
-        entry = &ht->entries[index];
-    }
-    *entry = (struct hash_entry) {
-        .next = ht->indices[mhash],
+    ht_ensurecapacity(ht, ht->count + 1);
+
+    struct hash_entry entry = {
         .hash = hash,
-        .kv = (kvpair_T) { (void *) key, (void *) value, },
+        .kv = { (void *) key, (void *) value, },
     };
-    ht->indices[mhash] = index;
+    size_t mask = ht->capacity - 1;
+    size_t distance = 0;
+    index = home_index(ht, hash);
+    while (ht->entries[index].kv.key != NULL) {
+        size_t d = probe_distance(ht, index);
+        if (d < distance) {
+            struct hash_entry temp = ht->entries[index];
+            ht->entries[index] = entry;
+            entry = temp;
+            distance = d;
+        }
+        index = (index + 1) & mask;
+        distance++;
+    }
+    ht->entries[index] = entry;
     ht->count++;
+
     DEBUG_PRINT_STATISTICS(ht);
     return (kvpair_T) { NULL, NULL, };
 }
 
-/* Removes and returns the entry with the specified key.
+/* Removes the entry of the specified key.
+ * The entry removed is returned.
  * If `key' is NULL or there is no such entry, { NULL, NULL } is returned. */
 kvpair_T ht_remove(hashtable_T *ht, const void *key)
 {
-    if (key != NULL) {
-        hashval_T hash = ht->hashfunc(key);
-        size_t *indexp = &ht->indices[(size_t) hash % ht->capacity];
-        while (*indexp != NOTHING) {
-            size_t index = *indexp;
-            struct hash_entry *entry = &ht->entries[index];
-            if (entry->hash == hash && ht->keycmp(entry->kv.key, key) == 0) {
-                kvpair_T oldkv = entry->kv;
-                *indexp = entry->next;
-                entry->next = ht->emptyindex;
-                ht->emptyindex = index;
-                entry->kv.key = NULL;
-                ht->count--;
-                return oldkv;
-            }
-            indexp = &entry->next;
-        }
+    if (key == NULL || ht->count == 0)
+        return (kvpair_T) { NULL, NULL, };
+
+    size_t index = find_index(ht, key, ht->hashfunc(key));
+    if (index >= ht->capacity)
+        return (kvpair_T) { NULL, NULL, };
+
+    kvpair_T oldkv = ht->entries[index].kv;
+
+    /* shift the following entries backward */
+    size_t mask = ht->capacity - 1;
+    for (;;) {
+        size_t next = (index + 1) & mask;
+        if (ht->entries[next].kv.key == NULL || probe_distance(ht, next) == 0)
+            break;
+        ht->entries[index] = ht->entries[next];
+        index = next;
     }
-    return (kvpair_T) { NULL, NULL, };
+    ht->entries[index].kv.key = NULL;
+    ht->count--;
+    return oldkv;
 }
 
 #if 0
@@ -337,6 +352,13 @@ kvpair_T ht_next(const hashtable_T *restrict ht, size_t *restrict indexp)
     return (kvpair_T) { NULL, NULL, };
 }
 
+/* Returns the number of bytes allocated for the entries of the specified
+ * hashtable, not including the memory for the keys and values. */
+size_t ht_memory_size(const hashtable_T *ht)
+{
+    return ht->capacity * sizeof *ht->entries;
+}
+
 /* Returns a newly malloced array of key-value pairs that contains all the
  * elements of the specified hashtable.
  * The returned array is terminated by the { NULL, NULL } element. */
@@ -408,6 +430,18 @@ int keywcscoll(const void *k1, const void *k2)
     return wcscoll(((const kvpair_T *) k1)->key, ((const kvpair_T *) k2)->key);
 }
 
+/* Sorts the key-value pairs with wide-string keys in the collation order of the
+ * keys. This gives the same result as `qsort'ing with `keywcscoll' but calls
+ * `wcsxfrm' only once for each key. */
+void sort_kvpairs_by_key(kvpair_T *kvs, size_t count)
+{
+    const wchar_t **keys = xmallocn(count, sizeof *keys);
+    for (size_t i = 0; i < count; i++)
+        keys[i] = kvs[i].key;
+    sort_by_collation(kvs, count, sizeof *kvs, keys);
+    free(keys);
+}
+
 /* `Free's the key of the specified key-value pair.
  * Can be used as the freer function to `ht_clear'. */
 void kfree(kvpair_T kv)
@@ -438,17 +472,18 @@ void print_statistics(const hashtable_T *ht)
 {
     fprintf(stderr, "DEBUG: id=%p hash->count=%zu, capacity=%zu\n",
             (void *) ht, ht->count, ht->capacity);
-    fprintf(stderr, "DEBUG: hash->emptyindex=%zu, tailindex=%zu\n",
-            ht->emptyindex, ht->tailindex);
-
-    unsigned emptycount = 0, collcount = 0;
-    for (size_t i = ht->emptyindex; i != NOTHING; i = ht->entries[i].next)
-        emptycount++;
-    for (size_t i = 0; i < ht->capacity; i++)
-        if (ht->entries[i].kv.key && ht->entries[i].next != NOTHING)
-            collcount++;
-    fprintf(stderr, "DEBUG: hash empties=%u collisions=%u\n\n",
-            emptycount, collcount);
+
+    size_t maxdistance = 0, totaldistance = 0;
+    for (size_t i = 0; i < ht->capacity; i++) {
+        if (ht->entries[i].kv.key != NULL) {
+            size_t d = probe_distance(ht, i);
+            totaldistance += d;
+            if (maxdistance < d)
+                maxdistance = d;
+        }
+    }
+    fprintf(stderr, "DEBUG: hash total distance=%zu max distance=%zu\n\n",
+            totaldistance, maxdistance);
 }
 #endif
 
@@ -46,8 +46,6 @@ typedef struct hashtable_T {
     size_t capacity, count;
     hashfunc_T *hashfunc;
     keycmp_T *keycmp;
-    size_t emptyindex, tailindex;
-    size_t *indices;
     struct hash_entry *entries;
 } hashtable_T;
 typedef struct kvpair_T {
@@ -81,6 +79,8 @@ extern kvpair_T ht_next(const hashtable_T *restrict ht, size_t *restrict indexp)
     __attribute__((nonnull));
 extern kvpair_T *ht_tokvarray(const hashtable_T *ht)
     __attribute__((nonnull,malloc,warn_unused_result));
+extern size_t ht_memory_size(const hashtable_T *ht)
+    __attribute__((nonnull,pure));
 
 extern hashval_T hashstr(const void *s)             __attribute__((pure));
 //extern int htstrcmp(const void *s1, const void *s2) __attribute__((pure));
@@ -90,6 +90,8 @@ extern hashval_T hashwcs(const void *s)             __attribute__((pure));
 extern int htwcscmp(const void *s1, const void *s2) __attribute__((pure));
 extern int keystrcoll(const void *kv1, const void *kv2) __attribute__((pure));
 extern int keywcscoll(const void *kv1, const void *kv2) __attribute__((pure));
+extern void sort_kvpairs_by_key(kvpair_T *kvs, size_t count)
+    __attribute__((nonnull));
 extern void kfree(kvpair_T kv);
 extern void vfree(kvpair_T kv);
 extern void kvfree(kvpair_T kv);
@@ -112,7 +114,6 @@ hashtable_T *ht_init(hashtable_T *ht, hashfunc_T *hashfunc, keycmp_T *keycmp)
  * Note that this function doesn't `free' any keys or values. */
 void ht_destroy(hashtable_T *ht)
 {
-    free(ht->indices);
     free(ht->entries);
 }
 
@@ -19,6 +19,7 @@
 #include "common.h"
 #include "history.h"
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
@@ -31,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -41,6 +43,7 @@
 #include "job.h"
 #include "option.h"
 #include "path.h"
+#include "profiler.h"
 #include "redir.h"
 #include "sig.h"
 #include "strbuf.h"
@@ -81,6 +84,20 @@
 #define HISTORY_DEFAULT_LINE_LENGTH 127
 #endif
 
+/* The size of buffered records at which they are written to the history file
+ * before the file is unlocked */
+#ifndef HISTORY_BUFFER_SIZE
+#define HISTORY_BUFFER_SIZE 65536
+#endif
+/* The size of a slab in which history entries are allocated.
+ * Must be a power of two. */
+#ifndef HISTORY_SLAB_SIZE
+#define HISTORY_SLAB_SIZE 65536
+#endif
+#if HISTORY_SLAB_SIZE & (HISTORY_SLAB_SIZE - 1)
+#error HISTORY_SLAB_SIZE must be a power of two
+#endif
+
 
 /* The main history list. */
 histlist_T histlist = {
@@ -92,6 +109,32 @@ histlist_T histlist = {
  * (`link.next') member points to the oldest entry. When there's no entries,
  * `Newest' and `Oldest' point to `histlist' itself. */
 
+/* A slab is a block of memory in which history entries are allocated one
+ * after another. Slabs are aligned to `HISTORY_SLAB_SIZE' so that the slab
+ * containing an entry can be found by masking the entry's address. */
+typedef struct histslab_T {
+    struct histslab_T *prev, *next;
+    size_t size;  /* number of bytes available in `data' */
+    size_t used;  /* number of bytes already allocated in `data' */
+    size_t live;  /* number of entries in this slab that are not removed */
+    union {
+        void *p;
+        time_t t;
+        unsigned u;
+    } data[];
+} histslab_T;
+#define HISTENTRY_ALIGN (sizeof ((histslab_T *) 0)->data[0])
+/* Slabs are linked in the order of allocation. New entries are allocated in
+ * the newest slab. A slab is freed when all the entries in it are removed. */
+static histslab_T *oldestslab = NULL, *newestslab = NULL;
+
+/* Array of pointers to all the entries in `histlist', used as a ring buffer.
+ * The oldest entry is at `histindex[histindexhead]' and the others follow in
+ * order. The array has `histindexcap' elements, of which `histlist.count' are
+ * used. */
+static histentry_T **histindex = NULL;
+static size_t histindexcap = 0, histindexhead = 0;
+
 /* The maximum limit of the number of an entry.
  * Must always be no less than `histsize' or `HISTORY_MIN_MAX_NUMBER'.
  * The number of any entry is not greater than this value. */
@@ -102,16 +145,23 @@ static unsigned histsize = DEFAULT_HISTSIZE;
  * the new entry in the `histrmdup' newest entries, those entries are removed.*/
 static unsigned histrmdup = 0;
 
-/* File stream for the history file. */
-static FILE *histfile = NULL;
+/* File descriptor for the history file, which is opened with O_APPEND so that
+ * every write goes to the end of the file. The file is read with `mmap' or
+ * `pread' rather than through a stream. */
+static int histfd = -1;
+/* The position in the history file up to which this shell has read or written
+ * the file. */
+static off_t histfileoffset = 0;
 /* The revision number of the history file. A valid revision number is
  * non-negative. */
 static long histfilerev = -1;
 /* The number of lines in the history file, not including the signature.
  * When this number reaches the threshold, the history file is refreshed. */
 static size_t histfilelines = 0;
-/* Indicates if the history file should be flushed before it is unlocked. */
-static bool histneedflush = false;
+/* Records that are written to the history file when it is unlocked. */
+static xstrbuf_T histbuf;
+/* Set when writing to the history file failed. */
+static bool histerror = false;
 
 /* The current time returned by `time' */
 static time_t now = (time_t) -1;
@@ -126,14 +176,31 @@ struct search_result_T {
 
 static void update_time(void);
 static void set_histsize(unsigned newsize);
-static histentry_T *new_entry(unsigned number, time_t time, const char *line)
+static histentry_T *new_entry(
+        unsigned number, time_t time, const char *line, size_t len)
+    __attribute__((nonnull));
+static size_t entry_size(size_t len)
+    __attribute__((pure));
+static histentry_T *alloc_entry(size_t size)
+    __attribute__((malloc,warn_unused_result));
+static void free_entry(histentry_T *e)
+    __attribute__((nonnull));
+static inline histentry_T **index_slot(size_t k)
+    __attribute__((pure));
+static void append_to_index(histentry_T *e)
+    __attribute__((nonnull));
+static void remove_from_index(const histentry_T *e)
     __attribute__((nonnull));
 static bool need_remove_entry(unsigned number)
     __attribute__((pure));
 static void remove_entry(histentry_T *e)
     __attribute__((nonnull));
 static void remove_last_entry(void);
+static bool entries_need_renumbering(void)
+    __attribute__((pure));
 static void clear_all_entries(void);
+static size_t search_index(unsigned number)
+    __attribute__((pure));
 static struct search_result_T search_entry_by_number(unsigned number)
     __attribute__((pure));
 static histlink_T *get_nth_newest_entry(unsigned n)
@@ -151,24 +218,33 @@ static void remove_histfile_pid(pid_t pid);
 static void clear_histfile_pids(void);
 static void write_histfile_pids(void);
 
-static FILE *open_histfile(void);
+static int open_histfile(void);
 static bool lock_histfile(short type);
+static void flush_histfile(void);
+static bool histfile_is_modified(void);
 static bool read_line(FILE *restrict f, xwcsbuf_T *restrict buf)
     __attribute__((nonnull));
 static bool try_read_line(FILE *restrict f, xwcsbuf_T *restrict buf)
     __attribute__((nonnull));
-static long read_signature(void);
-static void read_history_raw(void);
-static void read_history(void);
-static void parse_history_entry(const wchar_t *line)
+static long read_signature(off_t *bodyp)
+    __attribute__((nonnull));
+static bool read_histfile_lines(void parse(const char *line, size_t len))
+    __attribute__((nonnull));
+static bool read_history_raw(void);
+static void parse_raw_entry(const char *line, size_t len)
     __attribute__((nonnull));
-static void parse_removed_entry(const wchar_t *numstr)
+static bool read_history(void);
+static void parse_history_line(const char *line, size_t len)
     __attribute__((nonnull));
-static void parse_process_id(const wchar_t *numstr)
+static void parse_history_entry(const char *line, size_t len)
+    __attribute__((nonnull));
+static void parse_removed_entry(const char *numstr, size_t len)
+    __attribute__((nonnull));
+static void parse_process_id(const char *numstr, size_t len)
     __attribute__((nonnull));
 static void update_history(bool refresh);
 static void maybe_refresh_file(void);
-static int wprintf_histfile(const wchar_t *format, ...)
+static int printf_histfile(const char *format, ...)
     __attribute__((nonnull));
 static void write_signature(void);
 static void write_history_entry(const histentry_T *entry)
@@ -205,9 +281,12 @@ void set_histsize(unsigned newsize)
 }
 
 /* Adds a new history entry to the end of `histlist'.
+ * The value of the entry is the first `len' bytes of `line', which need not be
+ * null-terminated.
  * Some oldest entries may be removed in this function if they conflict with the
  * new one or the list is full. */
-histentry_T *new_entry(unsigned number, time_t time, const char *line)
+histentry_T *new_entry(
+        unsigned number, time_t time, const char *line, size_t len)
 {
     assert(!hist_lock);
     assert(number > 0);
@@ -216,14 +295,15 @@ histentry_T *new_entry(unsigned number, time_t time, const char *line)
     while (need_remove_entry(number))
         remove_entry(ashistentry(histlist.Oldest));
 
-    histentry_T *new = xmallocs(sizeof *new,
-            add(strlen(line), 1), sizeof *new->value);
+    histentry_T *new = alloc_entry(entry_size(len));
+    append_to_index(new);
     new->Prev = histlist.Newest;
     new->Next = Histlist;
     histlist.Newest = new->Prev->next = &new->link;
     new->number = number;
     new->time = time;
-    strcpy(new->value, line);
+    memcpy(new->value, line, len);
+    new->value[len] = '\0';
 
     histlist.count++;
     assert(histlist.count <= histsize);
@@ -231,6 +311,139 @@ histentry_T *new_entry(unsigned number, time_t time, const char *line)
     return new;
 }
 
+/* Returns the number of bytes occupied in a slab by an entry whose value is
+ * `len' bytes long (not including the terminating null byte). */
+size_t entry_size(size_t len)
+{
+    size_t size = add(offsetof(histentry_T, value), add(len, 1));
+    return add(size, HISTENTRY_ALIGN - 1) / HISTENTRY_ALIGN * HISTENTRY_ALIGN;
+}
+
+/* Allocates `size' bytes for a new entry in the newest slab.
+ * A new slab is allocated if the newest one is full. */
+histentry_T *alloc_entry(size_t size)
+{
+    histslab_T *slab = newestslab;
+
+    /* An entry must start within the first `HISTORY_SLAB_SIZE' bytes of its
+     * slab, or `free_entry' could not find the slab. */
+    if (slab == NULL
+            || sizeof *slab + slab->used >= HISTORY_SLAB_SIZE
+            || slab->size - slab->used < size) {
+        size_t total = add(sizeof *slab, size);
+        if (total < HISTORY_SLAB_SIZE)
+            total = HISTORY_SLAB_SIZE;
+
+        void *p;
+        if (posix_memalign(&p, HISTORY_SLAB_SIZE, total) != 0)
+            alloc_failed();
+        slab = p;
+        slab->prev = newestslab;
+        slab->next = NULL;
+        slab->size = total - sizeof *slab;
+        slab->used = 0;
+        slab->live = 0;
+        if (newestslab != NULL)
+            newestslab->next = slab;
+        else
+            oldestslab = slab;
+        newestslab = slab;
+    }
+
+    histentry_T *e = (histentry_T *) ((char *) slab->data + slab->used);
+    slab->used += size;
+    slab->live++;
+    return e;
+}
+
+/* Releases the memory occupied by the specified entry.
+ * The slab containing the entry is freed if it no longer contains any entry
+ * (unless it is the newest slab of the normal size, which is kept for reuse).
+ * If the entry is the last one allocated in the slab, its memory is reused by
+ * the next entry. */
+void free_entry(histentry_T *e)
+{
+    histslab_T *slab = (histslab_T *)
+        ((uintptr_t) e & ~(uintptr_t) (HISTORY_SLAB_SIZE - 1));
+    size_t size = entry_size(strlen(e->value));
+
+    assert(slab->live > 0);
+    if ((char *) e + size == (char *) slab->data + slab->used)
+        slab->used -= size;
+    if (--slab->live > 0)
+        return;
+    if (slab == newestslab && sizeof *slab + slab->size == HISTORY_SLAB_SIZE) {
+        slab->used = 0;
+        return;
+    }
+
+    if (slab->prev != NULL)
+        slab->prev->next = slab->next;
+    else
+        oldestslab = slab->next;
+    if (slab->next != NULL)
+        slab->next->prev = slab->prev;
+    else
+        newestslab = slab->prev;
+    free(slab);
+}
+
+/* Returns a pointer to the element of `histindex' for the `k'th oldest entry
+ * (counting from zero). */
+histentry_T **index_slot(size_t k)
+{
+    assert(k < histindexcap);
+    size_t i = histindexhead + k;
+    if (i >= histindexcap)
+        i -= histindexcap;
+    return &histindex[i];
+}
+
+/* Adds the specified entry to the newest end of `histindex'. */
+void append_to_index(histentry_T *e)
+{
+    if (histlist.count == histindexcap) {
+        size_t newcap = (histindexcap > 0) ? mul(histindexcap, 2) : 64;
+        histentry_T **newindex = xmallocn(newcap, sizeof *newindex);
+        for (size_t k = 0; k < histlist.count; k++)
+            newindex[k] = *index_slot(k);
+        free(histindex);
+        histindex = newindex;
+        histindexcap = newcap;
+        histindexhead = 0;
+    }
+    *index_slot(histlist.count) = e;
+}
+
+/* Removes the specified entry from `histindex'.
+ * This function must be called before `histlist.count' is decremented. */
+void remove_from_index(const histentry_T *e)
+{
+    size_t count = histlist.count;
+    assert(count > 0);
+
+    if (*index_slot(0) == e) {
+        if (++histindexhead == histindexcap)
+            histindexhead = 0;
+        return;
+    }
+    if (*index_slot(count - 1) == e)
+        return;
+
+    /* Shift the entries on the shorter side by one. */
+    size_t k = search_index(e->number);
+    assert(k < count && *index_slot(k) == e);
+    if (k < count / 2) {
+        for (; k > 0; k--)
+            *index_slot(k) = *index_slot(k - 1);
+        if (++histindexhead == histindexcap)
+            histindexhead = 0;
+    } else {
+        for (; k < count - 1; k++)
+            *index_slot(k) = *index_slot(k + 1);
+    }
+}
+
 bool need_remove_entry(unsigned number)
 {
     if (histlist.count == 0)
@@ -253,8 +466,9 @@ void remove_entry(histentry_T *entry)
     assert(&entry->link != Histlist);
     entry->Prev->next = entry->Next;
     entry->Next->prev = entry->Prev;
+    remove_from_index(entry);
     histlist.count--;
-    free(entry);
+    free_entry(entry);
 }
 
 /* Removes the newest entry. */
@@ -269,12 +483,18 @@ void renumber_all_entries(void)
 {
     assert(!hist_lock);
 
-    if (histlist.count > 0) {
-        unsigned num = 0;
-        for (histlink_T *l = histlist.Oldest; l != Histlist; l = l->next)
-            ashistentry(l)->number = ++num;
-        assert(num == histlist.count);
-    }
+    for (size_t k = 0; k < histlist.count; k++)
+        (*index_slot(k))->number = k + 1;
+}
+
+/* Returns false iff `renumber_all_entries' would not change any entry number,
+ * that is, the entries are already numbered from 1 one by one. */
+bool entries_need_renumbering(void)
+{
+    for (size_t k = 0; k < histlist.count; k++)
+        if ((*index_slot(k))->number != k + 1)
+            return true;
+    return false;
 }
 
 /* Removes all entries in the history list. */
@@ -282,16 +502,75 @@ void clear_all_entries(void)
 {
     assert(!hist_lock);
 
-    histlink_T *l = histlist.Oldest;
-    while (l != Histlist) {
-        histlink_T *next = l->next;
-        free(ashistentry(l));
-        l = next;
+    /* Free all the slabs but the newest of the normal size, which will be
+     * reused by the entries that are likely to be added soon. */
+    histslab_T *keep = newestslab;
+    if (keep != NULL && sizeof *keep + keep->size != HISTORY_SLAB_SIZE)
+        keep = NULL;
+    while (oldestslab != NULL) {
+        histslab_T *next = oldestslab->next;
+        if (oldestslab != keep)
+            free(oldestslab);
+        oldestslab = next;
+    }
+    oldestslab = newestslab = keep;
+    if (keep != NULL) {
+        keep->prev = keep->next = NULL;
+        keep->used = keep->live = 0;
     }
+    histindexhead = 0;
     histlist.Oldest = histlist.Newest = Histlist;
     histlist.count = 0;
 }
 
+/* Computes the memory used for the history list. The number of entries is
+ * assigned to `*countp' and the number of bytes allocated for the slabs and
+ * `histindex' to `*bytesp'. */
+void history_memory_usage(size_t *countp, size_t *bytesp)
+{
+    size_t bytes = histindexcap * sizeof *histindex;
+    for (const histslab_T *slab = oldestslab; slab != NULL; slab = slab->next)
+        bytes += sizeof *slab + slab->size;
+    *countp = histlist.count;
+    *bytesp = bytes;
+}
+
+/* Returns the position in `histindex' of the oldest entry whose number is not
+ * less than `number', taking the wrap-around of numbers into account.
+ * Returns `histlist.count' if all the entries' numbers are less than `number'.
+ * The history must not be empty. */
+size_t search_index(unsigned number)
+{
+    size_t count = histlist.count;
+    assert(count > 0);
+
+    unsigned oldestnum = (*index_slot(0))->number;
+    unsigned newestnum = (*index_slot(count - 1))->number;
+    bool wrapped = newestnum < oldestnum;
+#define NORMALIZE(n) ((wrapped && (n) <= newestnum) ? (n) + max_number : (n))
+
+    unsigned nnumber = NORMALIZE(number);
+
+    /* In most cases, the entries are numbered consecutively. */
+    if (nnumber >= oldestnum) {
+        size_t k = nnumber - oldestnum;
+        if (k < count && (*index_slot(k))->number == number)
+            return k;
+    }
+
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        unsigned midnum = (*index_slot(mid))->number;
+        if (NORMALIZE(midnum) < nnumber)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+#undef NORMALIZE
+}
+
 /* Searches for the entry that has the specified `number'.
  * If there is such an entry in the history, the both members of the returned
  * `search_result_T' structure will be pointers to the entry. Otherwise, the
@@ -307,48 +586,17 @@ struct search_result_T search_entry_by_number(unsigned number)
         return result;
     }
 
-    unsigned oldestnum = ashistentry(histlist.Oldest)->number;
-    unsigned nnewestnum = ashistentry(histlist.Newest)->number;
-    unsigned nnumber = number;
-    if (nnewestnum < oldestnum) {
-        if (nnumber <= nnewestnum)
-            nnumber += max_number;
-        nnewestnum += max_number;
-    }
-    if (nnumber < oldestnum) {
-        result.prev = Histlist;
-        result.next = histlist.Oldest;
-        return result;
-    } else if (nnumber > nnewestnum) {
-        result.prev = histlist.Newest;
-        result.next = Histlist;
-        return result;
-    }
-
-    histlink_T *l;
-    if (2 * (nnumber - oldestnum) < nnewestnum - oldestnum) {
-        /* search from the oldest */
-        l = histlist.Oldest;
-        while (number < ashistentry(l)->number)
-            l = l->next;
-        while (number > ashistentry(l)->number)
-            l = l->next;
-        result.next = l;
-        if (number != ashistentry(l)->number)
-            l = l->prev;
-        result.prev = l;
+    size_t k = search_index(number);
+    if (k < histlist.count) {
+        result.next = &(*index_slot(k))->link;
+        if (ashistentry(result.next)->number == number) {
+            result.prev = result.next;
+            return result;
+        }
     } else {
-        /* search from the newest */
-        l = histlist.Newest;
-        while (number > ashistentry(l)->number)
-            l = l->prev;
-        while (number < ashistentry(l)->number)
-            l = l->prev;
-        result.prev = l;
-        if (number != ashistentry(l)->number)
-            l = l->next;
-        result.next = l;
+        result.next = Histlist;
     }
+    result.prev = (k > 0) ? &(*index_slot(k - 1))->link : Histlist;
     return result;
 }
 
@@ -358,11 +606,9 @@ histlink_T *get_nth_newest_entry(unsigned n)
 {
     if (histlist.count <= n)
         return histlist.Oldest;
-
-    histlink_T *l = Histlist;
-    while (n-- > 0)
-        l = l->prev;
-    return l;
+    if (n == 0)
+        return Histlist;
+    return &(*index_slot(histlist.count - n))->link;
 }
 
 /* Searches for the newest entry whose value begins with the specified `prefix'.
@@ -459,12 +705,12 @@ void clear_histfile_pids(void)
 
 /* Writes process IDs in `histfilepids' to the history file. */
 /* This function does not return any error status. The caller should check
- * `ferror' for the file. */
+ * `histerror'. */
 void write_histfile_pids(void)
 {
-    assert(histfile != NULL);
+    assert(histfd >= 0);
     for (size_t i = 0; i < histfilepids.count; i++)
-        wprintf_histfile(L"p%jd\n", (intmax_t) histfilepids.pids[i]);
+        printf_histfile("p%jd\n", (intmax_t) histfilepids.pids[i]);
     histfilelines += histfilepids.count;
 }
 
@@ -507,58 +753,46 @@ void write_histfile_pids(void)
  */
 
 /* Opens the history file.
- * Returns NULL on failure. */
-FILE *open_histfile(void)
+ * Returns the file descriptor, or -1 on failure. */
+int open_histfile(void)
 {
     const wchar_t *vhistfile = getvar(L VAR_HISTFILE);
     if (vhistfile == NULL)
-        return NULL;
+        return -1;
 
     char *mbshistfile = malloc_wcstombs(vhistfile);
     if (mbshistfile == NULL)
-        return NULL;
+        return -1;
 
-    int fd = open(mbshistfile, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    int fd = open(mbshistfile,
+            O_RDWR | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
     free(mbshistfile);
     if (fd < 0)
-        return NULL;
+        return -1;
 
     struct stat st;
     if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
             || (st.st_mode & (S_IRWXG | S_IRWXO))) {
         xclose(fd);
-        return NULL;
+        return -1;
     }
 
-    fd = move_to_shellfd(fd);
-    if (fd < 0)
-        return NULL;
-
-    FILE *f = fdopen(fd, "r+");
-    if (f == NULL) {
-        remove_shellfd(fd);
-        xclose(fd);
-    }
-    return f;
+    return move_to_shellfd(fd);
 }
 
 /* Locks the history file, which must have been open.
  * `type' must be one of `F_RDLCK', `F_WRLCK' and `F_UNLCK'.
- * If `type' is `F_UNLCK', the buffer for the history file is flushed before
- * unlocking the file.
+ * If `type' is `F_UNLCK', the buffered records are written to the history file
+ * before unlocking the file.
  * When another process is holding a lock for the file, this process will be
  * blocked until the lock is freed.
  * Returns true iff successful. */
 bool lock_histfile(short type)
 {
-    if (type == F_UNLCK && histneedflush) {
-        histneedflush = false;
-        fflush(histfile);
-        /* We only flush the history file after writing. POSIX doesn't define
-         * the behavior of flush without writing. We don't use fseek instead of
-         * fflush because fseek is less reliable than fflush. In some
-         * implementations (including glibc), fseek doesn't flush the file. */
-    }
+    if (type == F_UNLCK)
+        flush_histfile();
+    else
+        count_stat(SC_HISTORY_LOCK);
 
     struct flock flock = {
         .l_type   = type,
@@ -566,13 +800,49 @@ bool lock_histfile(short type)
         .l_start  = 0,
         .l_len    = 0, /* to the end of file */
     };
-    int fd = fileno(histfile);
     int result;
 
-    while ((result = fcntl(fd, F_SETLKW, &flock)) == -1 && errno == EINTR);
+    while ((result = fcntl(histfd, F_SETLKW, &flock)) == -1 && errno == EINTR);
     return result != -1;
 }
 
+/* Writes the records in `histbuf' to the end of the history file.
+ * The records are written by a single `write' call unless it is interrupted, so
+ * they are appended as a whole even if another process reads the file at the
+ * same time without locking it. */
+/* The file should be locked. */
+void flush_histfile(void)
+{
+    size_t done = 0;
+    while (done < histbuf.length) {
+        ssize_t n = write(histfd, &histbuf.contents[done],
+                histbuf.length - done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            histerror = true;
+            break;
+        }
+        done += (size_t) n;
+    }
+    histfileoffset += (off_t) done;
+    sb_clear(&histbuf);
+}
+
+/* Checks if the history file may have been modified by another shell since
+ * this shell last read or wrote it. The file is examined without being locked,
+ * so this function allows skipping locking and re-reading the file when there
+ * is nothing new in it. A false positive is harmless as the caller re-reads the
+ * file after locking it anyway. */
+bool histfile_is_modified(void)
+{
+    struct stat st;
+    off_t body;
+
+    return fstat(histfd, &st) < 0 || st.st_size != histfileoffset
+        || read_signature(&body) != histfilerev;
+}
+
 /* Reads one line from file `f'.
  * The line is appended to buffer `buf', which must have been initialized.
  * The terminating newline is not left in `buf'.
@@ -636,117 +906,181 @@ bool try_read_line(FILE *restrict f, xwcsbuf_T *restrict buf)
     return false;
 }
 
-/* Reads the signature of the history file (`histfile') and checks if it is a
- * valid signature.
+/* Reads the signature of the history file and checks if it is a valid
+ * signature.
  * If valid:
- *   - the file is positioned just after the signature,
+ *   - the position just after the signature is assigned to `*bodyp',
  *   - the return value is the revision of the file (non-negative).
- * Otherwise:
- *   - the file position is undefined,
- *   - the return value is negative. */
+ * Otherwise, the return value is negative. */
 /* The history file should be locked. */
-long read_signature(void)
+long read_signature(off_t *bodyp)
 {
-    xwcsbuf_T buf;
-    long rev = -1;
-    const wchar_t *s;
+    char buf[64];
+    ssize_t n;
+    const char *s;
+    char *end;
+    long rev;
 
-    assert(histfile != NULL);
-    rewind(histfile);
-    if (!read_line(histfile, wb_initwithmax(&buf, HISTORY_DEFAULT_LINE_LENGTH)))
-        goto end;
-    
-    s = matchwcsprefix(buf.contents, L"#$# yash history v0 r");
-    if (s == NULL || !iswdigit(s[0]))
-        goto end;
+    assert(histfd >= 0);
+    while ((n = pread(histfd, buf, sizeof buf - 1, 0)) < 0 && errno == EINTR);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
 
-    if (!xwcstol(s, 10, &rev))
-        rev = -1;
-end:
-    wb_destroy(&buf);
+    s = matchstrprefix(buf, "#$# yash history v0 r");
+    if (s == NULL || !isdigit((unsigned char) s[0]))
+        return -1;
+
+    errno = 0;
+    rev = strtol(s, &end, 10);
+    if (errno != 0 || *end != '\n')
+        return -1;
+    *bodyp = (off_t) (end - buf) + 1;
     return rev;
 }
 
-/* Reads history entries from the history file, which must have been open.
- * The file format is assumed a simple text, one entry per line.
- * The file is read from the current position.
- * The entries that were read from the file are appended to `histlist'. */
+/* Reads the history file from `histfileoffset' to the end and calls
+ * `parse' for each line. The line passed to `parse' is not null-terminated and
+ * does not include the terminating newline. Lines longer than LINE_MAX bytes
+ * and an incomplete line at the end of the file are ignored.
+ * The file is mapped into memory rather than read through the stream so that a
+ * large file can be parsed quickly without converting every line to a wide
+ * string. If the file cannot be mapped, it is read into a buffer at once.
+ * On success, `histfileoffset' is updated to the end of the file and true is
+ * returned. */
 /* The file should be locked. */
-/* This function does not return any error status. The caller should check
- * `ferror' and/or `feof' for the file. */
-void read_history_raw(void)
+bool read_histfile_lines(void parse(const char *line, size_t len))
 {
-    xwcsbuf_T buf;
+    assert(histfd >= 0);
 
-    assert(histfile != NULL);
-    wb_initwithmax(&buf, HISTORY_DEFAULT_LINE_LENGTH);
-    while (read_line(histfile, &buf)) {
-        char *line = malloc_wcstombs(buf.contents);
-        if (line != NULL) {
-            new_entry(next_history_number(), -1, line);
-            free(line);
+    int fd = histfd;
+    off_t start = histfileoffset;
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return false;
+    if (st.st_size <= start)
+        return true;
+    if ((uintmax_t) st.st_size > SIZE_MAX)
+        return false;
+
+    size_t size = (size_t) st.st_size, offset = (size_t) start;
+    char *buf = NULL;
+    const char *contents;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+        contents = (const char *) map + offset;
+    } else {
+        size_t length = 0;
+        buf = xmalloc(size - offset);
+        while (length < size - offset) {
+            ssize_t n = pread(fd, buf + length, size - offset - length,
+                    start + (off_t) length);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                free(buf);
+                return false;
+            }
+            length += (size_t) n;
         }
-        wb_clear(&buf);
+        contents = buf;
     }
-    wb_destroy(&buf);
+
+    const char *p = contents, *end = contents + (size - offset);
+    const char *nl;
+    while ((nl = memchr(p, '\n', (size_t) (end - p))) != NULL) {
+        size_t len = (size_t) (nl - p);
+        if (len < LINE_MAX)
+            parse(p, len);
+        p = nl + 1;
+    }
+
+    if (map != MAP_FAILED)
+        munmap(map, size);
+    else
+        free(buf);
+    histfileoffset = st.st_size;
+    return true;
+}
+
+/* Reads history entries from the history file, which must have been open.
+ * The file format is assumed a simple text, one entry per line.
+ * The file is read from `histfileoffset'.
+ * The entries that were read from the file are appended to `histlist'.
+ * Returns true iff successful. */
+/* The file should be locked. */
+bool read_history_raw(void)
+{
+    return read_histfile_lines(parse_raw_entry);
+}
+
+void parse_raw_entry(const char *line, size_t len)
+{
+    new_entry(next_history_number(), -1, line, xstrnlen(line, len));
 }
 
 /* Reads history entries from the history file.
- * The file is read from the current position.
+ * The file is read from `histfileoffset'.
  * The entries that were read from the file are appended to `histlist'.
- * `update_time' must be called before calling this function. */
+ * `update_time' must be called before calling this function.
+ * Returns true iff successful. */
 /* The file should be locked. */
-/* This function does not return any error status. The caller should check
- * `ferror' and/or `feof' for the file. */
-void read_history(void)
+bool read_history(void)
 {
-    xwcsbuf_T buf;
+    return read_histfile_lines(parse_history_line);
+}
 
-    assert(histfile != NULL);
-    wb_initwithmax(&buf, HISTORY_DEFAULT_LINE_LENGTH);
-    while (read_line(histfile, &buf)) {
-        histfilelines++;
-        switch (buf.contents[0]) {
-            case L'0': case L'1': case L'2': case L'3': case L'4':
-            case L'5': case L'6': case L'7': case L'8': case L'9':
-            case L'A': case L'B': case L'C': case L'D': case L'E': case L'F':
-                parse_history_entry(buf.contents);
-                break;
-            case L'c':
-                remove_last_entry();
-                break;
-            case L'd':
-                parse_removed_entry(buf.contents + 1);
-                break;
-            case L'p':
-                parse_process_id(buf.contents + 1);
-                break;
-        }
-        wb_clear(&buf);
+void parse_history_line(const char *line, size_t len)
+{
+    histfilelines++;
+    if (len == 0)
+        return;
+    switch (line[0]) {
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+        case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
+            parse_history_entry(line, len);
+            break;
+        case 'c':
+            remove_last_entry();
+            break;
+        case 'd':
+            parse_removed_entry(line + 1, len - 1);
+            break;
+        case 'p':
+            parse_process_id(line + 1, len - 1);
+            break;
     }
-    wb_destroy(&buf);
 }
 
-void parse_history_entry(const wchar_t *line)
+/* The maximum length of the number part of a line in the history file that is
+ * parsed by the functions below. The part is copied to a null-terminated buffer
+ * of this size before being parsed. */
+#define HISTORY_NUMBER_MAX 48
+
+void parse_history_entry(const char *line, size_t len)
 {
+    char numbuf[HISTORY_NUMBER_MAX];
     unsigned long num;
     time_t time;
-    wchar_t *end;
-    char *value;
+    char *end;
+    size_t numlen = (len < sizeof numbuf) ? len : sizeof numbuf - 1;
 
-    assert(iswxdigit(line[0]));
+    assert(isxdigit((unsigned char) line[0]));
+    memcpy(numbuf, line, numlen);
+    numbuf[numlen] = '\0';
 
     errno = 0;
-    num = wcstoul(line, &end, 0x10);
-    if (errno || end[0] == L'\0' || num > max_number)
+    num = strtoul(numbuf, &end, 0x10);
+    if (errno || end[0] == '\0' || num == 0 || num > max_number)
         return;
 
-    if (end[0] == L':' && iswxdigit(end[1])) {
+    if (end[0] == ':' && isxdigit((unsigned char) end[1])) {
         unsigned long long t;
 
         errno = 0;
-        t = wcstoull(&end[1], &end, 0x10);
-        if (errno || end[0] == L'\0')
+        t = strtoull(&end[1], &end, 0x10);
+        if (errno || end[0] == '\0')
             time = -1;
         else if (t > (unsigned long long) now)
             time = now;
@@ -756,28 +1090,30 @@ void parse_history_entry(const wchar_t *line)
         time = -1;
     }
 
-    if (!iswspace(end[0]))
+    if (!isspace((unsigned char) end[0]))
         return;
-    value = malloc_wcstombs(&end[1]);
-    if (value != NULL) {
-        new_entry((unsigned) num, time, value);
-        free(value);
-    }
+
+    size_t valueindex = (size_t) (end - numbuf) + 1;
+    new_entry((unsigned) num, time, &line[valueindex],
+            xstrnlen(&line[valueindex], len - valueindex));
 }
 
-void parse_removed_entry(const wchar_t *numstr)
+void parse_removed_entry(const char *numstr, size_t len)
 {
+    char numbuf[HISTORY_NUMBER_MAX];
     unsigned long num;
-    wchar_t *end;
+    char *end;
 
     if (histlist.count == 0)
         return;
-    if (numstr[0] == L'\0')
+    if (len == 0 || len >= sizeof numbuf)
         return;
+    memcpy(numbuf, numstr, len);
+    numbuf[len] = '\0';
 
     errno = 0;
-    num = wcstoul(numstr, &end, 0x10);
-    if (errno || (*end != L'\0' && !iswspace(*end)))
+    num = strtoul(numbuf, &end, 0x10);
+    if (errno || (*end != '\0' && !isspace((unsigned char) *end)))
         return;
     if (num > max_number)
         return;
@@ -787,17 +1123,20 @@ void parse_removed_entry(const wchar_t *numstr)
         remove_entry(ashistentry(sr.prev));
 }
 
-void parse_process_id(const wchar_t *numstr)
+void parse_process_id(const char *numstr, size_t len)
 {
+    char numbuf[HISTORY_NUMBER_MAX];
     intmax_t num;
-    wchar_t *end;
+    char *end;
 
-    if (numstr[0] == L'\0')
+    if (len == 0 || len >= sizeof numbuf)
         return;
+    memcpy(numbuf, numstr, len);
+    numbuf[len] = '\0';
 
     errno = 0;
-    num = wcstoimax(numstr, &end, 10);
-    if (errno || (*end != L'\0' && !iswspace(*end)))
+    num = strtoimax(numbuf, &end, 10);
+    if (errno || (*end != '\0' && !isspace((unsigned char) *end)))
         return;
     if (num > 0)
         add_histfile_pid((pid_t) num);
@@ -811,45 +1150,35 @@ void parse_process_id(const wchar_t *numstr)
  * into this shell's history. The current data in this shell's history may be
  * changed.
  * If `refresh' is true, this function may call `refresh_file'.
- * On failure, `histfile' is closed and set to NULL.
- * `update_time' must be called before calling this function.
- * After calling this function, `histfile' must not be read without
- * repositioning. */
+ * On failure, the history file is closed and `histfd' is set to -1.
+ * `update_time' must be called before calling this function. */
 /* The history file should be locked (F_WRLCK if `refresh' is true or F_RDLCK if
  * `refresh' is false).
  * This function must be called just before writing to the history file. */
 void update_history(bool refresh)
 {
-    bool posfail;
-    fpos_t pos;
+    off_t body;
     long rev;
 
-    if (histfile == NULL)
+    if (histfd < 0)
         return;
     assert(!hist_lock);
 
-#if WIO_BROKEN
-    posfail = true;
-#else
-    posfail = fgetpos(histfile, &pos);
-#endif
-    rev = read_signature();
+    flush_histfile();
+    rev = read_signature(&body);
     if (rev < 0)
         goto error;
-    if (!posfail && rev == histfilerev) {
-        /* The revision has not been changed. Just read new entries. */
-        fsetpos(histfile, &pos);
-        read_history();
-    } else {
+    if (rev != histfilerev) {
         /* The revision has been changed. Re-read everything. */
         clear_all_entries();
         clear_histfile_pids();
         add_histfile_pid(shell_pid);
         histfilerev = rev;
         histfilelines = 0;
-        read_history();
+        histfileoffset = body;
     }
-    if (ferror(histfile) || !feof(histfile))
+    /* Otherwise, just read new entries. */
+    if (!read_history() || histerror)
         goto error;
 
     if (refresh)
@@ -861,10 +1190,10 @@ error:
 }
 
 /* Refreshes the history file if it is time to do that.
- * `histfile' must not be NULL. */
+ * The history file must be open. */
 void maybe_refresh_file(void)
 {
-    assert(histfile != NULL);
+    assert(histfd >= 0);
     if (histfilelines > 20
             && histfilelines / 2 >= histlist.count + histfilepids.count) {
         remove_histfile_pid(0);
@@ -872,55 +1201,59 @@ void maybe_refresh_file(void)
     }
 }
 
-/* Like `fwprintf(histfile, format, ...)', but the `histneedflush' flag is set.
- */
-int wprintf_histfile(const wchar_t *format, ...)
+/* Formats a record like `printf' and appends it to `histbuf', which is written
+ * to the history file when the file is unlocked. (The buffer is written earlier
+ * if it grows large.) Multibyte strings such as the values of history entries
+ * are written as they are. */
+int printf_histfile(const char *format, ...)
 {
     va_list ap;
     int result;
 
-    histneedflush = true;
     va_start(ap, format);
-    result = vfwprintf(histfile, format, ap);
+    result = sb_vprintf(&histbuf, format, ap);
     va_end(ap);
+    if (histbuf.length >= HISTORY_BUFFER_SIZE)
+        flush_histfile();
     return result;
 }
 
 /* Writes the signature with an incremented revision number, after emptying the
- * file. */
+ * file. Records that have not yet been written are discarded. */
 /* This function does not return any error status. The caller should check
- * `ferror' for the file. */
+ * `histerror'. */
 void write_signature(void)
 {
-    assert(histfile != NULL);
-    rewind(histfile);
-    while (ftruncate(fileno(histfile), 0) < 0 && errno == EINTR);
+    assert(histfd >= 0);
+    sb_clear(&histbuf);
+    while (ftruncate(histfd, 0) < 0 && errno == EINTR);
+    histfileoffset = 0;
 
     if (histfilerev < 0 || histfilerev == LONG_MAX)
         histfilerev = 0;
     else
         histfilerev++;
-    wprintf_histfile(L"#$# yash history v0 r%ld\n", histfilerev);
+    printf_histfile("#$# yash history v0 r%ld\n", histfilerev);
     histfilelines = 0;
 }
 
 /* Writes the specified entry to the history file. */
 /* The file should be locked. */
 /* This function does not return any error status. The caller should check
- * `ferror' for the file. */
+ * `histerror'. */
 void write_history_entry(const histentry_T *entry)
 {
-    assert(histfile != NULL);
+    assert(histfd >= 0);
 
     /* don't print very long line */
     if (xstrnlen(entry->value, LINE_MAX) >= LINE_MAX)
         return;
 
     if (entry->time >= 0)
-        wprintf_histfile(L"%X:%lX %s\n",
+        printf_histfile("%X:%lX %s\n",
                 entry->number, (unsigned long) entry->time, entry->value);
     else
-        wprintf_histfile(L"%X %s\n",
+        printf_histfile("%X %s\n",
                 entry->number, entry->value);
     histfilelines++;
 }
@@ -929,7 +1262,7 @@ void write_history_entry(const histentry_T *entry)
  * The file will have a new revision number. */
 /* The file should be locked. */
 /* This function does not return any error status. The caller should check
- * `ferror' for the file. */
+ * `histerror'. */
 void refresh_file(void)
 {
     write_signature();
@@ -970,23 +1303,31 @@ void maybe_init_history(void)
     update_time();
 
     /* open the history file and read it */
-    histfile = open_histfile();
-    if (histfile != NULL) {
+    histfd = open_histfile();
+    if (histfd >= 0) {
+        off_t body;
+
+        sb_init(&histbuf);
         lock_histfile(F_WRLCK);
-        histfilerev = read_signature();
+        histfilerev = read_signature(&body);
         if (histfilerev < 0) {
-            rewind(histfile);
+            histfileoffset = 0;
             read_history_raw();
             goto refresh;
         }
-        read_history();
-        if (ferror(histfile) || !feof(histfile)) {
+        histfileoffset = body;
+        if (!read_history()) {
             close_history_file();
             return;
         }
 
+        /* If no other shell is sharing the file, the entries are renumbered
+         * from 1 and the file is rewritten. If the numbers would not change,
+         * the file is rewritten only when `maybe_refresh_file' finds that it
+         * has grown enough, so that a large file is not copied at every
+         * start-up. */
         remove_histfile_pid(0);
-        if (histfilepids.count == 0) {
+        if (histfilepids.count == 0 && entries_need_renumbering()) {
             renumber_all_entries();
 refresh:
             refresh_file();
@@ -995,7 +1336,7 @@ refresh:
         }
 
         add_histfile_pid(shell_pid);
-        wprintf_histfile(L"p%jd\n", (intmax_t) shell_pid);
+        printf_histfile("p%jd\n", (intmax_t) shell_pid);
         histfilelines++;
 
         lock_histfile(F_UNLCK);
@@ -1006,15 +1347,15 @@ refresh:
  * exiting. */
 void finalize_history(void)
 {
-    if (!is_interactive_now || histfile == NULL)
+    if (!is_interactive_now || histfd < 0)
         return;
 
     hist_lock = false;
     lock_histfile(F_WRLCK);
     update_time();
     update_history(true);
-    if (histfile != NULL) {
-        wprintf_histfile(L"p%jd\n", (intmax_t) -shell_pid);
+    if (histfd >= 0) {
+        printf_histfile("p%jd\n", (intmax_t) -shell_pid);
         // histfilelines++;
         close_history_file();
     }
@@ -1024,15 +1365,17 @@ void finalize_history(void)
 void close_history_file(void)
 {
     hist_lock = false;
-    if (histfile == NULL)
+    if (histfd < 0)
         return;
 
     /* By closing the file descriptor for the history file, the file is
      * automatically unlocked. */
     // lock_histfile(F_UNLCK);
-    remove_shellfd(fileno(histfile));
-    fclose(histfile);
-    histfile = NULL;
+    flush_histfile();
+    sb_destroy(&histbuf);
+    remove_shellfd(histfd);
+    xclose(histfd);
+    histfd = -1;
 }
 
 /* Calculates the number of the next new entry. */
@@ -1063,7 +1406,7 @@ void add_history(const wchar_t *line)
     maybe_init_history();
     assert(!hist_lock);
 
-    if (histfile != NULL)
+    if (histfd >= 0)
         lock_histfile(F_WRLCK);
     update_time();
     update_history(true);
@@ -1077,7 +1420,7 @@ void add_history(const wchar_t *line)
         line++;
     }
 
-    if (histfile != NULL)
+    if (histfd >= 0)
         lock_histfile(F_UNLCK);
 }
 
@@ -1085,7 +1428,7 @@ void add_history(const wchar_t *line)
  * If the line is longer than `maxlen' characters, only the first `maxlen'
  * characters are added.
  * The string added to the history must not contain newlines.
- * `histfile' must be locked and `update_time' and `update_history' must have
+ * The history file must be locked and `update_time' and `update_history' must have
  * been called.
  * If the string does not contain any graph-class characters, it is not added
  * to the history. */
@@ -1105,8 +1448,9 @@ void add_history_line(const wchar_t *line, size_t maxlen)
         histentry_T *entry;
 
         remove_duplicates(mbsline);
-        entry = new_entry(next_history_number(), now, mbsline);
-        if (histfile != NULL)
+        entry = new_entry(
+                next_history_number(), now, mbsline, strlen(mbsline));
+        if (histfd >= 0)
             write_history_entry(entry);
         free(mbsline);
     }
@@ -1114,7 +1458,7 @@ void add_history_line(const wchar_t *line, size_t maxlen)
 
 /* Removes entries whose value is the same as `line' in the `histrmdup' newest
  * entries.
- * `histfile' must be locked and `update_history' must have been called. */
+ * The history file must be locked and `update_history' must have been called. */
 void remove_duplicates(const char *line)
 {
     histlink_T *l = histlist.Newest;
@@ -1122,8 +1466,8 @@ void remove_duplicates(const char *line)
         histlink_T *prev = l->prev;
         histentry_T *e = ashistentry(l);
         if (strcmp(e->value, line) == 0) {
-            if (histfile != NULL) {
-                wprintf_histfile(L"d%X\n", e->number);
+            if (histfd >= 0) {
+                printf_histfile("d%X\n", e->number);
                 histfilelines++;
             }
             remove_entry(e);
@@ -1146,12 +1490,14 @@ const histlink_T *get_history_entry(unsigned number)
 void start_using_history(void)
 {
     if (!hist_lock) {
-        if (histfile != NULL) {
-            lock_histfile(F_RDLCK);
-            update_time();
-            update_history(false);
-            if (histfile != NULL)
-                lock_histfile(F_UNLCK);
+        if (histfd >= 0) {
+            if (histfile_is_modified()) {
+                lock_histfile(F_RDLCK);
+                update_time();
+                update_history(false);
+                if (histfd >= 0)
+                    lock_histfile(F_UNLCK);
+            }
         } else {
             maybe_init_history();
         }
@@ -1388,24 +1734,24 @@ struct search_result_T fc_search_entry(const wchar_t *prefix, int number)
 
 void fc_update_history(void)
 {
-    if (histfile != NULL) {
+    if (histfd >= 0 && histfile_is_modified()) {
         lock_histfile(F_RDLCK);
         update_time();
         update_history(false);
-        if (histfile != NULL)
+        if (histfd >= 0)
             lock_histfile(F_UNLCK);
     }
 }
 
 void fc_remove_last_entry(void)
 {
-    if (histfile != NULL) {
+    if (histfd >= 0) {
         lock_histfile(F_WRLCK);
         update_time();
         update_history(true);
         remove_last_entry();
-        if (histfile != NULL) {
-            wprintf_histfile(L"c\n");
+        if (histfd >= 0) {
+            printf_histfile("c\n");
             histfilelines++;
             lock_histfile(F_UNLCK);
         }
@@ -1608,7 +1954,7 @@ void fc_read_history(FILE *f, bool quiet)
 {
     xwcsbuf_T buf;
 
-    if (histfile != NULL)
+    if (histfd >= 0)
         lock_histfile(F_WRLCK);
     update_time();
     update_history(false);
@@ -1622,7 +1968,7 @@ void fc_read_history(FILE *f, bool quiet)
     }
     wb_destroy(&buf);
 
-    if (histfile != NULL) {
+    if (histfd >= 0) {
         maybe_refresh_file();
         lock_histfile(F_UNLCK);
     }
@@ -1741,12 +2087,12 @@ int history_builtin(int argc, void **argv)
 /* Clears all the history. */
 void history_clear_all(void)
 {
-    if (histfile != NULL) {
+    if (histfd >= 0) {
         lock_histfile(F_WRLCK);
         update_history(false);
     }
     clear_all_entries();
-    if (histfile != NULL) {
+    if (histfd >= 0) {
         refresh_file();
         lock_histfile(F_UNLCK);
     }
@@ -1758,7 +2104,7 @@ int history_delete(const wchar_t *s)
     int n;
     histlink_T *l;
 
-    if (histfile != NULL) {
+    if (histfd >= 0) {
         lock_histfile(F_WRLCK);
         update_time();
         update_history(true);
@@ -1783,14 +2129,14 @@ int history_delete(const wchar_t *s)
 
     if (l != Histlist) {
         histentry_T *e = ashistentry(l);
-        if (histfile != NULL) {
-            wprintf_histfile(L"d%X\n", e->number);
+        if (histfd >= 0) {
+            printf_histfile("d%X\n", e->number);
             histfilelines++;
         }
         remove_entry(e);
     }
 
-    if (histfile != NULL)
+    if (histfd >= 0)
         lock_histfile(F_UNLCK);
 
     return (yash_error_message_count == 0) ? Exit_SUCCESS : Exit_FAILURE;
@@ -1866,11 +2212,11 @@ error:
 /* Refreshes the history file. */
 void history_refresh_file(void)
 {
-    if (histfile != NULL) {
+    if (histfd >= 0) {
         lock_histfile(F_WRLCK);
         update_time();
         update_history(false);
-        if (histfile != NULL) {
+        if (histfd >= 0) {
             remove_histfile_pid(0);
             refresh_file();
             lock_histfile(F_UNLCK);
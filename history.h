@@ -34,8 +34,8 @@ typedef struct histlink_T {
 /* The structure type of history entries. */
 typedef struct histentry_T {
     histlink_T link;
-    unsigned number;
     time_t time;
+    unsigned number;
     char value[];
 } histentry_T;
 #define Prev link.prev
@@ -78,6 +78,8 @@ extern void add_history(const wchar_t *line)
     __attribute__((nonnull));
 const histlink_T *get_history_entry(unsigned number)
     __attribute__((pure));
+extern void history_memory_usage(size_t *countp, size_t *bytesp)
+    __attribute__((nonnull));
 #if YASH_ENABLE_LINEEDIT
 extern void start_using_history(void);
 extern void end_using_history(void);
@@ -25,13 +25,16 @@
 # include <libintl.h>
 #endif
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <wchar.h>
 #include <wctype.h>
+#include "alias.h"
 #include "exec.h"
 #include "expand.h"
 #if YASH_ENABLE_HISTORY
@@ -52,14 +55,41 @@
 #endif
 
 
-static bool is_seekable_file(int fd);
-static inputresult_T optimized_read_input(
-        struct xwcsbuf_T *buf, struct input_file_info_T *info, _Bool trap)
+/* kinds of input file descriptors that `read_input' can read many bytes at
+ * once from without consuming bytes after the line it returns */
+typedef enum filekind_T {
+    FK_OTHER,    /* read byte by byte */
+    FK_REGULAR,  /* read ahead and rewind with `lseek' */
+    FK_SOCKET,   /* peek ahead with `recv' and read up to the newline */
+} filekind_T;
+
+/* parse result of a prompt variable, reused while the value is unchanged */
+struct promptcache_T {
+    wchar_t *pc_value;         /* the parsed value of the variable */
+    wordunit_T *pc_word;       /* the result of parsing `pc_value' */
+    bool pc_posix;             /* `posixly_correct' when parsed */
+    uintmax_t pc_fingerprint;  /* `get_alias_fingerprint()' when parsed */
+};
+
+static inputresult_T read_input_of_kind(struct xwcsbuf_T *buf,
+        struct input_file_info_T *info, bool trap, filekind_T kind)
+    __attribute__((nonnull));
+static filekind_T get_file_kind(int fd);
+static ssize_t read_line_from_socket(int fd, char *buf, size_t size)
+    __attribute__((nonnull));
+static inputresult_T optimized_read_input(struct xwcsbuf_T *buf,
+        struct input_file_info_T *info, _Bool trap, filekind_T kind)
+    __attribute__((nonnull));
+static size_t decode_loaded_line(
+        struct xwcsbuf_T *restrict buf, struct input_loaded_info_T *restrict info,
+        size_t len)
     __attribute__((nonnull));
 static wchar_t *expand_prompt_variable(wchar_t num, wchar_t suffix)
     __attribute__((malloc,warn_unused_result));
 static const wchar_t *get_prompt_variable(wchar_t num, wchar_t suffix)
     __attribute__((pure));
+static struct promptcache_T *get_prompt_cache(wchar_t num, wchar_t suffix)
+    __attribute__((const));
 static wchar_t *expand_ps1_posix(wchar_t *s)
     __attribute__((nonnull,malloc,warn_unused_result));
 static inline wchar_t get_euid_marker(void)
@@ -111,15 +141,29 @@ inputresult_T input_file(struct xwcsbuf_T *buf, void *inputinfo)
 inputresult_T read_input(
         xwcsbuf_T *buf, struct input_file_info_T *info, bool trap)
 {
-    if (info->bufsize == 1 && is_seekable_file(info->fd))
-        return optimized_read_input(buf, info, trap);
+    if (info->bufsize == 1) {
+        filekind_T kind = get_file_kind(info->fd);
+        if (kind != FK_OTHER)
+            return optimized_read_input(buf, info, trap, kind);
+    }
+    return read_input_of_kind(buf, info, trap, FK_OTHER);
+}
 
+/* Works like `read_input' for a file descriptor of the specified kind.
+ * A regular file is always ready for reading, so `wait_for_input' is skipped
+ * for it unless traps need handling. A socket is read only up to the next
+ * newline or null byte. */
+inputresult_T read_input_of_kind(xwcsbuf_T *buf,
+        struct input_file_info_T *info, bool trap, filekind_T kind)
+{
     size_t initlen = buf->length;
     inputresult_T status = INPUT_EOF;
 
     for (;;) {
         if (info->bufpos >= info->bufmax) {
 read_input:  /* if there's nothing in the buffer, read the next input */
+            if (kind == FK_REGULAR && !trap)
+                goto do_read;
             switch (wait_for_input(info->fd, trap, -1)) {
                 case W_READY:
                     break;
@@ -136,7 +180,10 @@ read_input:  /* if there's nothing in the buffer, read the next input */
                     goto end;
             }
 
-            ssize_t readcount = read(info->fd, info->buf, info->bufsize);
+do_read:;
+            ssize_t readcount = (kind == FK_SOCKET)
+                ? read_line_from_socket(info->fd, info->buf, info->bufsize)
+                : read(info->fd, info->buf, info->bufsize);
             if (readcount < 0) switch (errno) {
                 case EINTR:
                 case EAGAIN:
@@ -186,21 +233,57 @@ end:
         return status;
 }
 
-/* Checks if the file descriptor is seekable. */
-bool is_seekable_file(int fd)
+/* Determines how `read_input' can read from the file descriptor without
+ * consuming bytes beyond the line it returns. */
+filekind_T get_file_kind(int fd)
 {
     struct stat st;
-    return (fstat(fd, &st) == 0) && S_ISREG(st.st_mode);
+    if (fstat(fd, &st) < 0)
+        return FK_OTHER;
+    if (S_ISREG(st.st_mode))
+        return FK_REGULAR;
     /* The result of lseek for an unseekable FD is implementation-defined, so we
      * should not assume such lseek to fail. We only assume a regular file is
      * always seekable. */
+
+    if (S_ISSOCK(st.st_mode)) {
+        /* Peeking is useless for a datagram socket because reading part of a
+         * datagram discards the rest of it. */
+        int type;
+        socklen_t len = sizeof type;
+        if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0
+                && type == SOCK_STREAM)
+            return FK_SOCKET;
+    }
+    /* Pipes and terminals provide no way to look at pending bytes without
+     * consuming them, so they are read byte by byte. */
+    return FK_OTHER;
+}
+
+/* Reads at most `size' bytes from stream socket `fd' into `buf', stopping after
+ * the first newline or null byte so that no bytes after the line are consumed.
+ * Returns the number of bytes read, or -1 with `errno' set on error. */
+ssize_t read_line_from_socket(int fd, char *buf, size_t size)
+{
+    ssize_t count = recv(fd, buf, size, MSG_PEEK);
+    if (count <= 0)
+        return count;
+
+    size_t linelen = 0;
+    while (linelen < (size_t) count) {
+        char c = buf[linelen++];
+        if (c == '\n' || c == '\0')
+            break;
+    }
+    return read(fd, buf, linelen);
 }
 
 /* Works like `read_input', but improves performance by reading many bytes at
- * once even if `info->bufsize' is 1. The input file descriptor must be
- * seekable. */
-inputresult_T optimized_read_input(
-        struct xwcsbuf_T *buf, struct input_file_info_T *info, _Bool trap)
+ * once even if `info->bufsize' is 1. `kind' must be FK_REGULAR or FK_SOCKET.
+ * Bytes of a regular file read beyond the line are given back by rewinding the
+ * file offset; a socket is never read beyond the line or null byte. */
+inputresult_T optimized_read_input(struct xwcsbuf_T *buf,
+        struct input_file_info_T *info, _Bool trap, filekind_T kind)
 {
     struct input_file_info_T *tmpinfo =
         xmallocs(sizeof *tmpinfo, BUFSIZ, sizeof *tmpinfo->buf);
@@ -212,9 +295,9 @@ inputresult_T optimized_read_input(
     while (info->bufpos < info->bufmax)
         tmpinfo->buf[tmpinfo->bufmax++] = info->buf[info->bufpos++];
 
-    inputresult_T result = read_input(buf, tmpinfo, trap);
+    inputresult_T result = read_input_of_kind(buf, tmpinfo, trap, kind);
 
-    if (tmpinfo->bufpos < tmpinfo->bufmax) {
+    if (kind == FK_REGULAR && tmpinfo->bufpos < tmpinfo->bufmax) {
         /* rewind the FD to pretend we're not buffering */
         off_t diff = tmpinfo->bufmax - tmpinfo->bufpos;
         if (lseek(tmpinfo->fd, -diff, SEEK_CUR) == (off_t) -1) {
@@ -230,6 +313,165 @@ inputresult_T optimized_read_input(
     return result;
 }
 
+/* Reads the rest of the input file into memory to read it faster than
+ * `input_file'. `fileinfo' must have no buffered bytes. Returns NULL if the
+ * file is not a regular file or cannot be read at once, in which case the
+ * caller should use `input_file' instead. The input is read from the current
+ * file offset.
+ * The file is copied rather than mapped into memory because the script may
+ * truncate itself while it is running, which would make access to the mapping
+ * beyond the new end of the file raise SIGBUS. */
+struct input_loaded_info_T *open_loaded_input(
+        struct input_file_info_T *fileinfo)
+{
+    if (fileinfo->bufpos < fileinfo->bufmax)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fileinfo->fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+            st.st_size <= 0 || (uintmax_t) st.st_size > SIZE_MAX)
+        return NULL;
+
+    off_t offset = lseek(fileinfo->fd, 0, SEEK_CUR);
+    if (offset < 0 || offset >= st.st_size)
+        return NULL;
+
+    size_t size = (size_t) (st.st_size - offset), length = 0;
+    char *contents = malloc(size);
+    if (contents == NULL)
+        return NULL;
+    while (length < size) {
+        ssize_t n = pread(fileinfo->fd, contents + length, size - length,
+                offset + (off_t) length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            free(contents);
+            return NULL;
+        }
+        if (n == 0)  /* the file was truncated after `fstat' */
+            break;
+        length += (size_t) n;
+    }
+
+    struct input_loaded_info_T *info = xmalloc(sizeof *info);
+    info->fileinfo = fileinfo;
+    info->contents = contents;
+    info->base = offset;
+    info->size = length;
+    info->pos = 0;
+    info->state = fileinfo->state;
+    info->track_offset = (fileinfo->fd == STDIN_FILENO);
+    info->exhausted = false;
+    return info;
+}
+
+/* Frees the loaded contents and `info'. `info->fileinfo' is not freed. */
+void close_loaded_input(struct input_loaded_info_T *info)
+{
+    free(info->contents);
+    free(info);
+}
+
+/* An input function that reads input from a file loaded into memory.
+ * `inputinfo' is a pointer to a `struct input_loaded_info_T'.
+ * One line is decoded from the loaded contents and appended to the buffer.
+ * When the end of the contents is reached, the rest of the file (which may
+ * have been appended after loading) is read by `read_input'.
+ * If `inputinfo->track_offset' is true, the file offset is kept at the end of
+ * the consumed input so that other commands can read the rest of the file, and
+ * input consumed by other commands is skipped. */
+inputresult_T input_loaded(struct xwcsbuf_T *buf, void *inputinfo)
+{
+    struct input_loaded_info_T *info = inputinfo;
+    int fd = info->fileinfo->fd;
+
+    if (!info->exhausted && info->track_offset) {
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (offset >= info->base &&
+                (uintmax_t) (offset - info->base) != info->pos) {
+            info->pos = ((uintmax_t) (offset - info->base) < info->size)
+                    ? (size_t) (offset - info->base) : info->size;
+            memset(&info->state, 0, sizeof info->state);
+        }
+    }
+
+    if (info->pos >= info->size) {
+        if (!info->exhausted) {
+            if (!info->track_offset)
+                lseek(fd, info->base + (off_t) info->size, SEEK_SET);
+            info->fileinfo->state = info->state;
+            info->exhausted = true;
+        }
+        return read_input(buf, info->fileinfo, true);
+    }
+
+    const char *start = &info->contents[info->pos];
+    size_t len = info->size - info->pos;
+    const char *newline = memchr(start, '\n', len);
+    if (newline != NULL)
+        len = newline - start + 1;
+    const char *nul = memchr(start, '\0', len);
+    if (nul != NULL)
+        len = nul - start;
+
+    size_t initlen = buf->length;
+    size_t consumed = decode_loaded_line(buf, info, len);
+    info->pos += consumed;
+    if (info->track_offset && consumed > 0)
+        lseek(fd, info->base + (off_t) info->pos, SEEK_SET);
+
+    if (initlen != buf->length)
+        return INPUT_OK;
+    else if (consumed < len)
+        return INPUT_ERROR;
+    else
+        return INPUT_EOF;
+}
+
+/* Converts the first `len' bytes at the current position of the contents into
+ * wide characters and appends them to `buf'. Bytes in the ASCII range are
+ * converted without calling `mbrtowc' while the shift state is initial.
+ * Returns the number of bytes converted, which is less than `len' if an
+ * invalid character was found. */
+size_t decode_loaded_line(
+        struct xwcsbuf_T *restrict buf, struct input_loaded_info_T *restrict info,
+        size_t len)
+{
+    const unsigned char *s = (const unsigned char *) &info->contents[info->pos];
+    size_t i = 0;
+
+    wb_ensuremax(buf, add(buf->length, len));
+    while (i < len) {
+        if (s[i] < 0x80 && mbsinit(&info->state)) {
+            do
+                buf->contents[buf->length++] = (wchar_t) s[i++];
+            while (i < len && s[i] < 0x80);
+            continue;
+        }
+
+        size_t convcount = mbrtowc(&buf->contents[buf->length],
+                (const char *) &s[i], len - i, &info->state);
+        switch (convcount) {
+            case 0:            /* not reached: `len' excludes null bytes */
+                assert(false);
+            case (size_t) -1:  /* not a valid character */
+                xerror(EILSEQ, Ngt("cannot read input"));
+                goto end;
+            case (size_t) -2:  /* incomplete character at the end of file */
+                i = len;
+                goto end;
+            default:
+                buf->length++;
+                i += convcount;
+                break;
+        }
+    }
+end:
+    buf->contents[buf->length] = L'\0';
+    return i;
+}
+
 /* An input function that prints a prompt and reads input.
  * `inputinfo' is a pointer to a `struct input_interactive_info'.
  * `inputinfo->type' must be either 1 or 2, which specifies the prompt type.
@@ -343,10 +585,67 @@ struct promptset_T get_prompt(int type)
 wchar_t *expand_prompt_variable(wchar_t num, wchar_t suffix)
 {
     const wchar_t *var = get_prompt_variable(num, suffix);
-    wchar_t *expanded = parse_and_expand_string(var, gt("prompt"), false);
+    struct promptcache_T *pc = get_prompt_cache(num, suffix);
+    uintmax_t fingerprint = get_alias_fingerprint();
+    wchar_t *value;
+    wordunit_T *word;
+
+    if (pc->pc_value != NULL && wcscmp(pc->pc_value, var) == 0
+            && pc->pc_posix == posixly_correct
+            && pc->pc_fingerprint == fingerprint) {
+        value = pc->pc_value;
+        word = pc->pc_word;
+    } else {
+        if (!parse_expandable_string(var, gt("prompt"), &word))
+            return xwcsdup(L"");
+        value = xwcsdup(var);
+        free(pc->pc_value);
+        wordfree(pc->pc_word);
+    }
+
+    /* The word is detached from the cache while it is expanded because the
+     * expansion may change the variable and re-enter this function. */
+    pc->pc_value = NULL;
+    pc->pc_word = NULL;
+
+    wchar_t *expanded = expand_single(word, TT_NONE, Q_LITERAL, ES_NONE);
+
+    if (pc->pc_value == NULL) {
+        pc->pc_value = value;
+        pc->pc_word = word;
+        pc->pc_posix = posixly_correct;
+        pc->pc_fingerprint = fingerprint;
+    } else {
+        free(value);
+        wordfree(word);
+    }
+
     return expanded != NULL ? expanded : xwcsdup(L"");
 }
 
+/* Returns the parse cache for the prompt variable specified by `num' and
+ * `suffix'. See `get_prompt_variable' for the arguments. */
+struct promptcache_T *get_prompt_cache(wchar_t num, wchar_t suffix)
+{
+    static struct promptcache_T caches[3][4];
+
+    size_t i = 0, j = 0;
+    switch (num) {
+        case L'1':  i = 0;  break;
+        case L'2':  i = 1;  break;
+        case L'4':  i = 2;  break;
+        default:    assert(false);
+    }
+    switch (suffix) {
+        case L'\0':  j = 0;  break;
+        case L'R':   j = 1;  break;
+        case L'S':   j = 2;  break;
+        case L'P':   j = 3;  break;
+        default:     assert(false);
+    }
+    return &caches[i][j];
+}
+
 /* Returns the value of the variable "YASH_PSxy", where x is `num' and y is
  * `suffix'. If it is unset or the shell is in the POSIXly-correct mode, returns
  * the value of "PSxy". If it is also unset, returns an empty string. */
@@ -447,21 +746,32 @@ void print_prompt(const wchar_t *s)
     xwcsbuf_T buf;
 
     wb_init(&buf);
+    format_prompt(&buf, s);
+    fprintf(stderr, "%ls", buf.contents);
+    fflush(stderr);
+    wb_destroy(&buf);
+}
+
+/* Appends the specified prompt string to `buf', replacing the escape sequences
+ * described for `print_prompt'. The sequences that change the text style are
+ * removed. */
+void format_prompt(xwcsbuf_T *restrict buf, const wchar_t *restrict s)
+{
     while (*s != L'\0') {
         if (*s != L'\\') {
-            wb_wccat(&buf, *s);
+            wb_wccat(buf, *s);
         } else switch (*++s) {
-            default:     wb_wccat(&buf, *s);       break;
-            case L'\0':  wb_wccat(&buf, L'\\');    goto done;
-//          case L'\\':  wb_wccat(&buf, L'\\');    break;
-            case L'a':   wb_wccat(&buf, L'\a');    break;
-            case L'e':   wb_wccat(&buf, L'\033');  break;
-            case L'n':   wb_wccat(&buf, L'\n');    break;
-            case L'r':   wb_wccat(&buf, L'\r');    break;
-            case L'$':   wb_wccat(&buf, get_euid_marker());      break;
-            case L'j':   wb_wprintf(&buf, L"%zu", job_count());  break;
+            default:     wb_wccat(buf, *s);        break;
+            case L'\0':  wb_wccat(buf, L'\\');     return;
+//          case L'\\':  wb_wccat(buf, L'\\');     break;
+            case L'a':   wb_wccat(buf, L'\a');     break;
+            case L'e':   wb_wccat(buf, L'\033');   break;
+            case L'n':   wb_wccat(buf, L'\n');     break;
+            case L'r':   wb_wccat(buf, L'\r');     break;
+            case L'$':   wb_wccat(buf, get_euid_marker());       break;
+            case L'j':   wb_wprintf(buf, L"%zu", job_count());   break;
 #if YASH_ENABLE_HISTORY
-            case L'!':   wb_wprintf(&buf, L"%u", next_history_number());  break;
+            case L'!':   wb_wprintf(buf, L"%u", next_history_number());   break;
 #endif
             case L'[':
             case L']':
@@ -474,10 +784,6 @@ void print_prompt(const wchar_t *s)
         }
         s++;
     }
-done:
-    fprintf(stderr, "%ls", buf.contents);
-    fflush(stderr);
-    wb_destroy(&buf);
 }
 
 wchar_t get_euid_marker(void)
@@ -20,9 +20,12 @@
 #define YASH_INPUT_H
 
 #include <stdlib.h>
+#include <sys/types.h>
 #include <wchar.h>
 
 
+struct xwcsbuf_T;
+
 struct promptset_T {
     wchar_t *main, *right, *styler, *predict;
 };
@@ -33,6 +36,9 @@ extern struct promptset_T get_prompt(int type);
 static inline void free_prompt(struct promptset_T prompt);
 extern void print_prompt(const wchar_t *s)
     __attribute__((nonnull));
+extern void format_prompt(
+        struct xwcsbuf_T *restrict buf, const wchar_t *restrict s)
+    __attribute__((nonnull));
 extern _Bool unset_nonblocking(int fd);
 
 
@@ -54,7 +60,6 @@ typedef enum inputresult_T {
     INPUT_ERROR,        /* Other error was encountered. */
 } inputresult_T;
 
-struct xwcsbuf_T;
 struct input_file_info_T;
 extern inputresult_T read_input(
         struct xwcsbuf_T *buf, struct input_file_info_T *info, _Bool trap)
@@ -81,6 +86,8 @@ extern inputresult_T input_file(struct xwcsbuf_T *buf, void *inputinfo)
     __attribute__((nonnull));
 extern inputresult_T input_interactive(struct xwcsbuf_T *buf, void *inputinfo)
     __attribute__((nonnull));
+extern inputresult_T input_loaded(struct xwcsbuf_T *buf, void *inputinfo)
+    __attribute__((nonnull));
 
 /* to be used as `inputinfo' for `input_wcs' */
 struct input_wcs_info_T {
@@ -96,6 +103,25 @@ struct input_file_info_T {
 };
 /* `bufsize' is the size of `buf', which must be at least one byte. */
 
+/* to be used as `inputinfo' for `input_loaded' */
+struct input_loaded_info_T {
+    struct input_file_info_T *fileinfo;  /* used after the loaded part */
+    char *contents;                      /* loaded contents of the file */
+    off_t base;                          /* file offset of `contents' */
+    size_t size, pos;                    /* size of `contents', next position */
+    mbstate_t state;
+    _Bool track_offset;                  /* keep the FD offset at `pos'? */
+    _Bool exhausted;                     /* reading from `fileinfo' now? */
+};
+/* The file offset of the FD is tracked only for the standard input, which other
+ * commands may read from. */
+
+extern struct input_loaded_info_T *open_loaded_input(
+        struct input_file_info_T *fileinfo)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern void close_loaded_input(struct input_loaded_info_T *info)
+    __attribute__((nonnull));
+
 /* to be used as `inputinfo' for `input_interactive' */
 struct input_interactive_info_T {
     struct input_file_info_T *fileinfo;
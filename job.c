@@ -20,6 +20,8 @@
 #include "job.h"
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #if HAVE_GETTEXT
 # include <libintl.h>
 #endif
@@ -29,18 +31,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <wchar.h>
 #include <wctype.h>
+#include "arena.h"
 #include "builtin.h"
 #include "exec.h"
+#include "hashtable.h"
 #include "option.h"
+#include "parser.h"
 #include "plist.h"
 #include "redir.h"
 #include "sig.h"
 #include "strbuf.h"
 #include "util.h"
+#include "variable.h"
 #include "yash.h"
 #if YASH_ENABLE_LINEEDIT
 # include "xfnmatch.h"
@@ -51,18 +58,44 @@
 #endif
 
 
+#if HAVE_WAIT4 && !defined wait4
+extern pid_t wait4(pid_t pid, int *status, int options, struct rusage *usage);
+#endif
+
 static inline job_T *get_job(size_t jobnumber)
     __attribute__((pure));
 static inline void free_job(job_T *job);
+static void name_job_processes(job_T *job)
+    __attribute__((nonnull));
+static void release_job_commands(job_T *job)
+    __attribute__((nonnull));
+static void index_job(size_t jobnumber);
+static void unindex_job(size_t jobnumber);
+static hashval_T hashpid(const void *key)
+    __attribute__((const));
+static int pidcmp(const void *key1, const void *key2)
+    __attribute__((const));
+static inline bool is_legacy_job(const job_T *job)
+    __attribute__((nonnull,pure));
+static process_T *find_process(pid_t pid, bool running, size_t *jobnumberp)
+    __attribute__((nonnull));
 static void trim_joblist(void);
 static void set_current_jobnumber(size_t jobnumber);
 static size_t find_next_job(size_t numlimit);
 static void apply_curstop(void);
+#if HAVE_WAIT4
+static void add_rusage(
+        struct rusage *restrict sum, const struct rusage *restrict u)
+    __attribute__((nonnull));
+#endif
+static void rusage_to_usage(
+        const struct rusage *restrict ru, usage_T *restrict u)
+    __attribute__((nonnull));
 static int calc_status(int status)
     __attribute__((const));
 static inline int calc_status_of_process(const process_T *p)
     __attribute__((nonnull,pure));
-static wchar_t *get_job_name(const job_T *job)
+static wchar_t *get_job_name(job_T *job)
     __attribute__((nonnull,warn_unused_result));
 static char *get_process_status_string(const process_T *p, bool *needfree)
     __attribute__((nonnull,malloc,warn_unused_result));
@@ -83,7 +116,12 @@ static int continue_job(size_t jobnumber, job_T *job, bool fg)
     __attribute__((nonnull));
 static int wait_for_job_by_jobspec(const wchar_t *jobspec)
     __attribute__((nonnull));
+static int wait_for_any_job(bool jobcontrol);
 static bool wait_builtin_has_job(bool jobcontrol);
+static bool poll_builtin_add_fd(const wchar_t *fdstr, fd_set *fds, int *nfdsp)
+    __attribute__((nonnull));
+static void **poll_builtin_fd_array(int nfds, const fd_set *fds)
+    __attribute__((nonnull,malloc,warn_unused_result));
 
 
 /* The list of jobs.
@@ -95,12 +133,32 @@ static plist_T joblist;
 /* number of the current/previous jobs. 0 if none. */
 static size_t current_jobnumber, previous_jobnumber;
 
+/* A hashtable that maps process IDs to the numbers of the jobs containing the
+ * processes. The keys are process IDs and the values are job numbers plus one,
+ * both cast to (void *).
+ * Because a process ID may be reused while a finished job remains in the job
+ * list, the table is only a hint: the found job must be checked to really
+ * contain the process. */
+static hashtable_T pidindex;
+
+/* The current job generation, which is incremented in each new subshell.
+ * Jobs added in an older generation are legacy jobs. */
+static unsigned job_generation = 0;
+
+/* An arena kept alive after the parse tree in it has been executed because it
+ * contains commands from which the names of some jobs are yet to be made. */
+typedef struct heldarena_T {
+    arena_T arena;
+    size_t refcount;  /* number of jobs referring to this arena */
+} heldarena_T;
+
 /* Initializes the job list. */
 void init_job(void)
 {
     assert(joblist.contents == NULL);
     pl_init(&joblist);
     pl_add(&joblist, NULL);
+    ht_init(&pidindex, hashpid, pidcmp);
 }
 
 /* Sets the active job. */
@@ -108,19 +166,54 @@ void set_active_job(job_T *job)
 {
     assert(ACTIVE_JOBNO < joblist.length);
     assert(joblist.contents[ACTIVE_JOBNO] == NULL);
+    job->j_generation = job_generation;
+    job->j_arena = NULL;
+    job->j_heldarena = NULL;
+    for (size_t i = 0; i < job->j_pcount; i++)
+        if (job->j_procs[i].pr_command != NULL)
+            job->j_arena = current_parse_arena;
     joblist.contents[ACTIVE_JOBNO] = job;
+    index_job(ACTIVE_JOBNO);
+}
+
+/* Keeps the contents of the specified arena alive for the jobs whose names are
+ * to be made from commands in it. This function must be called before the
+ * arena is reset or destroyed. If there are such jobs, the contents are moved
+ * to a new held arena and `arena' is re-initialized as an empty arena. */
+void hold_arena_for_jobs(arena_T *arena)
+{
+    heldarena_T *held = NULL;
+
+    for (size_t i = 0; i < joblist.length; i++) {
+        job_T *job = joblist.contents[i];
+        if (job == NULL || job->j_arena != arena)
+            continue;
+
+        if (held == NULL) {
+            held = xmalloc(sizeof *held);
+            held->arena = *arena;
+            held->refcount = 0;
+            arena_init(arena);
+        }
+        assert(job->j_heldarena == NULL);
+        job->j_arena = NULL;
+        job->j_heldarena = held;
+        held->refcount++;
+    }
 }
 
 /* Moves the active job into the job list.
  * If the newly added job is stopped, it becomes the current job.
  * If `current' is true or there is no current job, the newly added job becomes
- * the current job if there is no stopped job. */
-void add_job(bool current)
+ * the current job if there is no stopped job.
+ * Returns the job number of the added job. */
+size_t add_job(bool current)
 {
     job_T *job = joblist.contents[ACTIVE_JOBNO];
     size_t jobnumber;
 
     assert(job != NULL);
+    unindex_job(ACTIVE_JOBNO);
     joblist.contents[ACTIVE_JOBNO] = NULL;
 
     /* if there is an empty element in the list, use it */
@@ -136,10 +229,12 @@ void add_job(bool current)
 
 set_current:
     assert(joblist.contents[jobnumber] == job);
+    index_job(jobnumber);
     if (job->j_status == JS_STOPPED || current)
         set_current_jobnumber(jobnumber);
     else
         set_current_jobnumber(current_jobnumber);
+    return jobnumber;
 }
 
 /* Returns the job of the specified number or NULL if not found. */
@@ -153,6 +248,7 @@ job_T *get_job(size_t jobnumber)
  * (another job is assigned to it). */
 void remove_job(size_t jobnumber)
 {
+    unindex_job(jobnumber);
     free_job(get_job(jobnumber));
     joblist.contents[jobnumber] = NULL;
     trim_joblist();
@@ -166,6 +262,7 @@ void remove_all_jobs(void)
         free_job(joblist.contents[i]);
         joblist.contents[i] = NULL;
     }
+    ht_clear(&pidindex, NULL);
     trim_joblist();
     current_jobnumber = previous_jobnumber = 0;
 }
@@ -174,12 +271,123 @@ void remove_all_jobs(void)
 void free_job(job_T *job)
 {
     if (job != NULL) {
+        release_job_commands(job);
         for (size_t i = 0; i < job->j_pcount; i++)
             free(job->j_procs[i].pr_name);
         free(job);
     }
 }
 
+/* Makes the names of the processes of the specified job that have not yet been
+ * named. */
+void name_job_processes(job_T *job)
+{
+    for (size_t i = 0; i < job->j_pcount; i++) {
+        process_T *p = &job->j_procs[i];
+        if (p->pr_command != NULL) {
+            assert(p->pr_name == NULL);
+            p->pr_name = command_to_wcs(p->pr_command, false);
+        }
+    }
+    release_job_commands(job);
+}
+
+/* Releases the commands from which the names of the processes of the specified
+ * job were to be made, and the arena the job has been holding, if any. */
+void release_job_commands(job_T *job)
+{
+    for (size_t i = 0; i < job->j_pcount; i++) {
+        process_T *p = &job->j_procs[i];
+        if (p->pr_command != NULL) {
+            comsfree(p->pr_command);
+            p->pr_command = NULL;
+        }
+    }
+
+    heldarena_T *held = job->j_heldarena;
+    if (held != NULL) {
+        assert(held->refcount > 0);
+        if (--held->refcount == 0) {
+            arena_destroy(&held->arena);
+            free(held);
+        }
+    }
+    job->j_arena = NULL;
+    job->j_heldarena = NULL;
+}
+
+/* Registers the processes of the specified job in `pidindex'. */
+void index_job(size_t jobnumber)
+{
+    const job_T *job = joblist.contents[jobnumber];
+    for (size_t i = 0; i < job->j_pcount; i++) {
+        pid_t pid = job->j_procs[i].pr_pid;
+        if (pid > 0)
+            ht_set(&pidindex, (void *) (uintptr_t) pid,
+                    (void *) (uintptr_t) (jobnumber + 1));
+    }
+}
+
+/* Removes the processes of the specified job from `pidindex'.
+ * Entries that have been overwritten by another job are left intact. */
+void unindex_job(size_t jobnumber)
+{
+    const job_T *job = get_job(jobnumber);
+    if (job == NULL)
+        return;
+    for (size_t i = 0; i < job->j_pcount; i++) {
+        void *key = (void *) (uintptr_t) job->j_procs[i].pr_pid;
+        if (ht_get(&pidindex, key).value == (void *) (uintptr_t) (jobnumber + 1))
+            ht_remove(&pidindex, key);
+    }
+}
+
+hashval_T hashpid(const void *key)
+{
+    return (hashval_T) (uintptr_t) key;
+}
+
+int pidcmp(const void *key1, const void *key2)
+{
+    return key1 != key2;
+}
+
+/* Finds a process whose process ID is `pid' in the job list, including the
+ * active job. If `running' is true, finished processes are ignored.
+ * Returns the process and assigns the number of the job containing it to
+ * `*jobnumberp' if found. Returns NULL if not found. */
+process_T *find_process(pid_t pid, bool running, size_t *jobnumberp)
+{
+    size_t jobnumber =
+        (uintptr_t) ht_get(&pidindex, (void *) (uintptr_t) pid).value;
+    job_T *job;
+    if (jobnumber > 0 && (job = get_job(--jobnumber)) != NULL) {
+        /* check the hint */
+        for (size_t i = 0; i < job->j_pcount; i++) {
+            process_T *pr = &job->j_procs[i];
+            if (pr->pr_pid == pid && !(running && pr->pr_status == JS_DONE)) {
+                *jobnumberp = jobnumber;
+                return pr;
+            }
+        }
+    }
+
+    /* The process may be in an older job whose entry has been overwritten
+     * because of the reuse of the process ID. */
+    for (jobnumber = joblist.length; jobnumber-- > 0; ) {
+        if ((job = joblist.contents[jobnumber]) == NULL)
+            continue;
+        for (size_t i = 0; i < job->j_pcount; i++) {
+            process_T *pr = &job->j_procs[i];
+            if (pr->pr_pid == pid && !(running && pr->pr_status == JS_DONE)) {
+                *jobnumberp = jobnumber;
+                return pr;
+            }
+        }
+    }
+    return NULL;
+}
+
 /* Shrink the job list, removing unused elements. */
 void trim_joblist(void)
 {
@@ -195,18 +403,23 @@ void trim_joblist(void)
     }
 }
 
-/* Sets the `j_legacy' flags of all jobs.
- * All the jobs will be no longer job-controlled. */
+/* Makes all the existing jobs legacy jobs.
+ * All the jobs will be no longer job-controlled.
+ * This function is called in a new subshell. The jobs are not modified so that
+ * the memory pages containing them remain shared with the parent shell. */
 void neglect_all_jobs(void)
 {
-    for (size_t i = 0; i < joblist.length; i++) {
-        job_T *job = joblist.contents[i];
-        if (job != NULL)
-            job->j_legacy = true;
-    }
+    job_generation++;
     current_jobnumber = previous_jobnumber = 0;
 }
 
+/* Returns true iff `job' is a legacy job, that is, one inherited from the
+ * parent of the subshell. */
+bool is_legacy_job(const job_T *job)
+{
+    return job->j_generation != job_generation;
+}
+
 /* Current/previous job selection discipline:
  *
  * - When there is one or more stopped jobs, the current job must be one of
@@ -333,6 +546,57 @@ size_t job_count(void)
     return count;
 }
 
+/* Computes the memory used for the job list. The number of jobs is assigned to
+ * `*countp' and the number of bytes allocated for the jobs, their processes and
+ * the process ID index to `*bytesp'. The commands from which the names of
+ * processes are yet to be made are not counted. */
+void job_memory_usage(size_t *countp, size_t *bytesp)
+{
+    size_t count = 0;
+    size_t bytes = (joblist.maxlength + 1) * sizeof *joblist.contents
+        + ht_memory_size(&pidindex);
+    for (size_t i = 0; i < joblist.length; i++) {
+        const job_T *job = joblist.contents[i];
+        if (job == NULL)
+            continue;
+        count++;
+        bytes += sizeof *job + job->j_pcount * sizeof *job->j_procs;
+        for (size_t j = 0; j < job->j_pcount; j++)
+            if (job->j_procs[j].pr_name != NULL)
+                bytes += (wcslen(job->j_procs[j].pr_name) + 1)
+                    * sizeof (wchar_t);
+    }
+    *countp = count;
+    *bytesp = bytes;
+}
+
+/* Counts the number of running jobs in the job list. */
+size_t running_job_count(void)
+{
+    size_t count = 0;
+    for (size_t i = 1; i < joblist.length; i++) {
+        const job_T *job = joblist.contents[i];
+        if (job != NULL && !is_legacy_job(job) && job->j_status == JS_RUNNING)
+            count++;
+    }
+    return count;
+}
+
+/* If the $YASH_MAX_JOBS variable is set to a positive integer, waits until the
+ * number of running jobs gets less than the value.
+ * Returns early if interrupted by SIGINT or a trap. */
+void wait_for_job_slot(void)
+{
+    const wchar_t *value = getvar(L VAR_YASH_MAX_JOBS);
+    long max;
+    if (value == NULL || !xwcstol(value, 10, &max) || max <= 0)
+        return;
+
+    while (running_job_count() >= (unsigned long) max)
+        if (wait_for_sigchld(doing_job_control_now, true) != 0)
+            break;
+}
+
 /* Counts the number of stopped jobs in the job list. */
 size_t stopped_job_count(void)
 {
@@ -346,6 +610,12 @@ size_t stopped_job_count(void)
 }
 
 
+#if HAVE_WAIT4
+/* The sum of the resource usage of the child processes that have finished and
+ * been reaped by `do_wait'. `ru_maxrss' is the maximum rather than the sum. */
+static struct rusage reaped_usage;
+#endif
+
 /* Updates the info about the jobs in the job list.
  * This function doesn't block. */
 void do_wait(void)
@@ -357,9 +627,16 @@ void do_wait(void)
 #else
     const int waitpidoption = WUNTRACED | WNOHANG;
 #endif
+#if HAVE_WAIT4
+    struct rusage usage;
+#endif
 
 start:
+#if HAVE_WAIT4
+    pid = wait4(-1, &status, waitpidoption, &usage);
+#else
     pid = waitpid(-1, &status, waitpidoption);
+#endif
     if (pid < 0) {
         switch (errno) {
             case EINTR:
@@ -386,23 +663,20 @@ start:
         return;
     }
 
-    size_t jobnumber, pnumber;
-    job_T *job;
-    process_T *pr;
+#if HAVE_WAIT4
+    if (WIFEXITED(status) || WIFSIGNALED(status))
+        add_rusage(&reaped_usage, &usage);
+#endif
 
-    /* determine `jobnumber', `job' and `pr' from `pid' */
-    for (jobnumber = 0; jobnumber < joblist.length; jobnumber++)
-        if ((job = joblist.contents[jobnumber]) != NULL)
-            for (pnumber = 0; pnumber < job->j_pcount; pnumber++)
-                if ((pr = &job->j_procs[pnumber])->pr_pid == pid &&
-                        pr->pr_status != JS_DONE)
-                    goto found;
+    size_t jobnumber;
+    process_T *pr = find_process(pid, true, &jobnumber);
 
     /* If `pid' was not found in the job list, we simply ignore it. This may
      * happen on some occasions: e.g. the job has been "disown"ed. */
-    goto start;
+    if (pr == NULL)
+        goto start;
 
-found:
+    job_T *job = joblist.contents[jobnumber];
     pr->pr_statuscode = status;
     if (WIFEXITED(status) || WIFSIGNALED(status))
         pr->pr_status = JS_DONE;
@@ -437,6 +711,73 @@ out_of_loop:
     goto start;
 }
 
+#if HAVE_WAIT4
+
+/* Adds the resource usage `*u' to `*sum'. */
+void add_rusage(struct rusage *restrict sum, const struct rusage *restrict u)
+{
+    sum->ru_utime.tv_sec += u->ru_utime.tv_sec;
+    sum->ru_utime.tv_usec += u->ru_utime.tv_usec;
+    sum->ru_stime.tv_sec += u->ru_stime.tv_sec;
+    sum->ru_stime.tv_usec += u->ru_stime.tv_usec;
+    if (sum->ru_maxrss < u->ru_maxrss)
+        sum->ru_maxrss = u->ru_maxrss;
+    sum->ru_inblock += u->ru_inblock;
+    sum->ru_oublock += u->ru_oublock;
+    sum->ru_nvcsw += u->ru_nvcsw;
+    sum->ru_nivcsw += u->ru_nivcsw;
+}
+
+#endif /* HAVE_WAIT4 */
+
+/* Converts `struct rusage' to `usage_T'. */
+void rusage_to_usage(const struct rusage *restrict ru, usage_T *restrict u)
+{
+    u->utime = ru->ru_utime.tv_sec + ru->ru_utime.tv_usec * 1e-6;
+    u->stime = ru->ru_stime.tv_sec + ru->ru_stime.tv_usec * 1e-6;
+#if HAVE_WAIT4
+    u->maxrss = ru->ru_maxrss;
+    u->inblock = ru->ru_inblock;
+    u->oublock = ru->ru_oublock;
+    u->nvcsw = ru->ru_nvcsw;
+    u->nivcsw = ru->ru_nivcsw;
+#else
+    u->maxrss = u->inblock = u->oublock = u->nvcsw = u->nivcsw = 0;
+#endif
+}
+
+/* Gets the resource usage of the shell process itself and that of the child
+ * processes that have finished.
+ * `children->maxrss' is the largest among the child processes that have been
+ * reaped since the last call to `set_children_maxrss'. */
+void get_usage(usage_T *restrict self, usage_T *restrict children)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) < 0)
+        memset(&ru, 0, sizeof ru);
+    rusage_to_usage(&ru, self);
+
+#if HAVE_WAIT4
+    ru = reaped_usage;
+#else
+    if (getrusage(RUSAGE_CHILDREN, &ru) < 0)
+        memset(&ru, 0, sizeof ru);
+#endif
+    rusage_to_usage(&ru, children);
+}
+
+/* Resets the maximum resident set size of the child processes that is
+ * reported by `get_usage'. */
+void set_children_maxrss(long maxrss)
+{
+#if HAVE_WAIT4
+    reaped_usage.ru_maxrss = maxrss;
+#else
+    (void) maxrss;
+#endif
+}
+
 /* Waits for the specified job to finish (or stop).
  * `jobnumber' must be a valid job number.
  * If `return_on_stop' is false, waits for the job to finish.
@@ -456,7 +797,7 @@ int wait_for_job(size_t jobnumber, bool return_on_stop,
     int signum = 0;
     job_T *job = joblist.contents[jobnumber];
 
-    if (!job->j_legacy) {
+    if (!is_legacy_job(job)) {
         bool savenonotify = job->j_nonotify;
         job->j_nonotify = true;
         for (;;) {
@@ -494,13 +835,13 @@ wchar_t **wait_for_child(pid_t cpid, pid_t cpgid, bool return_on_stop)
     job->j_pgid = cpgid;
     job->j_status = JS_RUNNING;
     job->j_statuschanged = false;
-    job->j_legacy = false;
     job->j_nonotify = false;
     job->j_pcount = 1;
     job->j_procs[0].pr_pid = cpid;
     job->j_procs[0].pr_status = JS_RUNNING;
     job->j_procs[0].pr_statuscode = 0;
     job->j_procs[0].pr_name = NULL;
+    job->j_procs[0].pr_command = NULL;
     set_active_job(job);
     wait_for_job(ACTIVE_JOBNO, return_on_stop, false, false);
     if (doing_job_control_now)
@@ -530,7 +871,7 @@ pid_t get_job_pgid(const wchar_t *jobname)
         return -1;
     } else if (jobnumber == 0
             || (job = joblist.contents[jobnumber]) == NULL
-            || job->j_legacy) {
+            || is_legacy_job(job)) {
         xerror(0, Ngt("no such job `%ls'"), jobname);
         return -1;
     } else if (job->j_pgid == 0) {
@@ -650,8 +991,9 @@ int calc_status_of_job(const job_T *job)
  * If the job has only one process, `job->j_procs[0].pr_name' is returned.
  * Otherwise, the names of all the process are concatenated and returned, which
  * must be freed by the caller. */
-wchar_t *get_job_name(const job_T *job)
+wchar_t *get_job_name(job_T *job)
 {
+    name_job_processes(job);
     if (job->j_pcount == 1)
         return job->j_procs[0].pr_name;
 
@@ -787,6 +1129,8 @@ int print_job_status(size_t jobnumber,
         if (jobname != job->j_procs[0].pr_name)
             free(jobname);
     } else {
+        name_job_processes(job);
+
         bool needfree;
         pid_t pid = job->j_procs[0].pr_pid;
         char *status = get_process_status_string(
@@ -927,17 +1271,9 @@ size_t get_jobnumber_from_name(const wchar_t *name)
 size_t get_jobnumber_from_pid(long pid)
 {
     size_t jobnumber;
-    if (pid == 0)
+    if (pid <= 0 || pid != (pid_t) pid
+            || find_process((pid_t) pid, false, &jobnumber) == NULL)
         return 0;
-    for (jobnumber = joblist.length; --jobnumber > 0; ) {
-        job_T *job = joblist.contents[jobnumber];
-        if (job != NULL) {
-            for (size_t i = 0; i < job->j_pcount; i++)
-                if (job->j_procs[i].pr_pid == pid)
-                    goto found;
-        }
-    }
-found:
     return jobnumber;
 }
 
@@ -955,7 +1291,7 @@ void generate_job_candidates(const le_compopt_T *compopt)
         return;
 
     for (size_t i = 1; i < joblist.length; i++) {
-        const job_T *job = joblist.contents[i];
+        job_T *job = joblist.contents[i];
         if (job == NULL)
             continue;
         switch (job->j_status) {
@@ -1158,7 +1494,7 @@ int fg_builtin(int argc, void **argv)
                         ARGV(xoptind));
             } else if (jobnumber == 0
                     || (job = joblist.contents[jobnumber]) == NULL
-                    || job->j_legacy) {
+                    || is_legacy_job(job)) {
                 xerror(0, Ngt("no such job `%ls'"), ARGV(xoptind));
             } else if (job->j_pgid == 0) {
                 xerror(0, Ngt("`%ls' is not a job-controlled job"),
@@ -1169,7 +1505,7 @@ int fg_builtin(int argc, void **argv)
         } while (++xoptind < argc);
     } else {
         if (current_jobnumber == 0 ||
-                (job = joblist.contents[current_jobnumber])->j_legacy) {
+                is_legacy_job(job = joblist.contents[current_jobnumber])) {
             xerror(0, Ngt("there is no current job"));
         } else if (job->j_pgid == 0) {
             xerror(0, Ngt("the current job is not a job-controlled job"));
@@ -1190,7 +1526,7 @@ int fg_builtin(int argc, void **argv)
 int continue_job(size_t jobnumber, job_T *job, bool fg)
 {
     assert(job->j_pgid > 0);
-    assert(!job->j_legacy);
+    assert(!is_legacy_job(job));
 
     wchar_t *name = get_job_name(job);
     if (fg && posixly_correct)
@@ -1272,16 +1608,30 @@ const char bg_syntax[] = Ngt(
 
 #endif /* YASH_ENABLE_HELP */
 
-/* The "wait" built-in */
+/* Options for the "wait" built-in. */
+const struct xgetopt_T wait_options[] = {
+    { L'n', L"next", OPTARG_NONE, false, NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help", OPTARG_NONE, false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "wait" built-in, which accepts the following option:
+ *  -n: wait for any one job to finish */
 int wait_builtin(int argc, void **argv)
 {
     bool jobcontrol = doing_job_control_now;
+    bool next = false;
     int status = Exit_SUCCESS;
 
     const struct xgetopt_T *opt;
     xoptind = 0;
-    while ((opt = xgetopt(argv, help_option, 0)) != NULL) {
+    while ((opt = xgetopt(argv, wait_options, 0)) != NULL) {
         switch (opt->shortopt) {
+            case L'n':
+                next = true;
+                break;
 #if YASH_ENABLE_HELP
             case L'-':
                 return print_builtin_help(ARGV(0));
@@ -1291,7 +1641,14 @@ int wait_builtin(int argc, void **argv)
         }
     }
 
-    if (xoptind < argc) {
+    if (next) {
+        /* wait for any one job */
+        if (xoptind < argc)
+            return too_many_operands_error(0);
+        status = wait_for_any_job(jobcontrol);
+        if (status < 0)
+            status = -status;
+    } else if (xoptind < argc) {
         /* wait for the specified jobs */
         for (; xoptind < argc; xoptind++) {
             int jobstatus = wait_for_job_by_jobspec(ARGV(xoptind));
@@ -1341,7 +1698,7 @@ int wait_for_job_by_jobspec(const wchar_t *jobspec)
     job_T *job;
     if (jobnumber == 0
             || (job = joblist.contents[jobnumber]) == NULL
-            || job->j_legacy)
+            || is_legacy_job(job))
         return Exit_NOTFOUND;
 
     int signal = wait_for_job(jobnumber,
@@ -1361,6 +1718,44 @@ int wait_for_job_by_jobspec(const wchar_t *jobspec)
     return status;
 }
 
+/* Waits for any job to finish and removes it from the job list.
+ * If there already is a finished job, this function does not wait.
+ * Returns the exit status of the job, or Exit_NOTFOUND if there is no job to
+ * wait for. Returns a negated exit status if interrupted. */
+int wait_for_any_job(bool jobcontrol)
+{
+    for (;;) {
+        bool running = false;
+        for (size_t i = 1; i < joblist.length; i++) {
+            job_T *job = joblist.contents[i];
+            if (job == NULL || is_legacy_job(job))
+                continue;
+            if (job->j_status == JS_DONE ||
+                    (jobcontrol && job->j_status == JS_STOPPED
+                     && job->j_statuschanged)) {
+                int status = calc_status_of_job(job);
+                if (jobcontrol && is_interactive_now && !posixly_correct)
+                    print_job_status(i, false, false, true, stdout);
+                else if (job->j_status == JS_DONE)
+                    remove_job(i);
+                else
+                    job->j_statuschanged = false;
+                return status;
+            }
+            if (job->j_status == JS_RUNNING)
+                running = true;
+        }
+        if (!running)
+            return Exit_NOTFOUND;
+
+        int signal = wait_for_sigchld(jobcontrol, true);
+        if (signal != 0) {
+            assert(TERMSIGOFFSET >= 128);
+            return -(signal + TERMSIGOFFSET);
+        }
+    }
+}
+
 /* Checks if the shell has any job to wait for. */
 bool wait_builtin_has_job(bool jobcontrol)
 {
@@ -1369,7 +1764,7 @@ bool wait_builtin_has_job(bool jobcontrol)
         job_T *job = joblist.contents[i];
         if (jobcontrol && is_interactive_now && !posixly_correct)
             print_job_status(i, true, false, false, stdout);
-        if (job != NULL && (job->j_legacy || job->j_status == JS_DONE))
+        if (job != NULL && (is_legacy_job(job) || job->j_status == JS_DONE))
             remove_job(i);
     }
 
@@ -1388,6 +1783,7 @@ const char wait_help[] = Ngt(
 );
 const char wait_syntax[] = Ngt(
 "\twait [job or process_id...]\n"
+"\twait -n\n"
 );
 #endif
 
@@ -1455,5 +1851,206 @@ const char disown_syntax[] = Ngt(
 );
 #endif
 
+/* Options for the "poll" built-in. */
+const struct xgetopt_T poll_options[] = {
+    { L'r', L"readable", OPTARG_REQUIRED, false, NULL, },
+    { L't', L"timeout",  OPTARG_REQUIRED, false, NULL, },
+    { L'w', L"writable", OPTARG_REQUIRED, false, NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help",     OPTARG_NONE,     false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "poll" built-in, which accepts the following options:
+ *  -r fd: wait for `fd' to be readable
+ *  -w fd: wait for `fd' to be writable
+ *  -t timeout: wait at most `timeout' seconds
+ * The operands are jobs to wait for to finish or stop.
+ * The ready file descriptors and jobs are assigned to the $POLL_READABLE,
+ * $POLL_WRITABLE, and $POLL_JOBS arrays. */
+int poll_builtin(int argc, void **argv)
+{
+    fd_set readfds, writefds;
+    int nfds = 0;
+    double timeout = -1.0;
+
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+
+    const struct xgetopt_T *opt;
+    xoptind = 0;
+    while ((opt = xgetopt(argv, poll_options, 0)) != NULL) {
+        switch (opt->shortopt) {
+            case L'r':
+                if (!poll_builtin_add_fd(xoptarg, &readfds, &nfds))
+                    return Exit_ERROR;
+                break;
+            case L'w':
+                if (!poll_builtin_add_fd(xoptarg, &writefds, &nfds))
+                    return Exit_ERROR;
+                break;
+            case L't':;
+                wchar_t *end;
+                errno = 0;
+                timeout = wcstod(xoptarg, &end);
+                if (xoptarg[0] == L'\0' || *end != L'\0' || errno != 0
+                        || !(timeout >= 0.0 && timeout <= INT_MAX / 1000)) {
+                    xerror(0, Ngt("`%ls' is not a valid timeout"), xoptarg);
+                    return Exit_ERROR;
+                }
+                break;
+#if YASH_ENABLE_HELP
+            case L'-':
+                return print_builtin_help(ARGV(0));
+#endif
+            default:
+                return Exit_ERROR;
+        }
+    }
+
+    /* look up the jobs */
+    size_t jobcount = argc - xoptind;
+    size_t *jobnumbers = xmallocn(jobcount, sizeof *jobnumbers);
+    for (size_t i = 0; i < jobcount; i++) {
+        const wchar_t *jobspec = ARGV(xoptind + i);
+        size_t jobnumber;
+        if (jobspec[0] == L'%') {
+            jobnumber = get_jobnumber_from_name(&jobspec[1]);
+        } else {
+            long pid;
+            if (!xwcstol(jobspec, 10, &pid) || pid < 0) {
+                xerror(0, Ngt("`%ls' is not a valid job specification"),
+                        jobspec);
+                free(jobnumbers);
+                return Exit_ERROR;
+            }
+            jobnumber = get_jobnumber_from_pid(pid);
+        }
+        if (jobnumber >= joblist.length) {
+            xerror(0, Ngt("job specification `%ls' is ambiguous"), jobspec);
+            free(jobnumbers);
+            return Exit_ERROR;
+        }
+        job_T *job;
+        if (jobnumber == 0
+                || (job = joblist.contents[jobnumber]) == NULL
+                || is_legacy_job(job)) {
+            xerror(0, Ngt("no such job `%ls'"), jobspec);
+            free(jobnumbers);
+            return Exit_ERROR;
+        }
+        jobnumbers[i] = jobnumber;
+    }
+
+    /* wait for any of them to get ready */
+    double deadline = (timeout >= 0.0) ? get_real_time() + timeout : 0.0;
+    fd_set rfds, wfds;
+    plist_T readyjobs;
+    int status;
+    pl_init(&readyjobs);
+    for (;;) {
+        bool anyjob = false;
+        for (size_t i = 0; i < jobcount; i++) {
+            job_T *job = joblist.contents[jobnumbers[i]];
+            if (job != NULL && job->j_status != JS_RUNNING)
+                anyjob = true;
+        }
+
+        int waittime;
+        if (anyjob)
+            waittime = 0;
+        else if (timeout < 0.0)
+            waittime = -1;
+        else {
+            double remaining = deadline - get_real_time();
+            waittime = (remaining > 0.0) ? (int) (remaining * 1000.0 + 0.5) : 0;
+        }
+
+        rfds = readfds, wfds = writefds;
+        status = wait_for_events(nfds, &rfds, &wfds, waittime);
+        if (status != 0) {
+            if (status < 0) {
+                status = Exit_FAILURE;
+            } else {
+                assert(TERMSIGOFFSET >= 128);
+                status += TERMSIGOFFSET;
+            }
+            FD_ZERO(&rfds);
+            FD_ZERO(&wfds);
+            break;
+        }
+
+        for (size_t i = 0; i < jobcount; i++) {
+            job_T *job = joblist.contents[jobnumbers[i]];
+            if (job != NULL && job->j_status != JS_RUNNING)
+                pl_add(&readyjobs, xwcsdup(ARGV(xoptind + i)));
+        }
+        bool anyfd = false;
+        for (int fd = 0; fd < nfds; fd++)
+            if (FD_ISSET(fd, &rfds) || FD_ISSET(fd, &wfds))
+                anyfd = true;
+        if (anyfd || readyjobs.length > 0) {
+            status = Exit_SUCCESS;
+            break;
+        }
+        if (waittime == 0 || (timeout >= 0.0 && get_real_time() >= deadline)) {
+            status = Exit_FAILURE;
+            break;
+        }
+    }
+
+    set_array(L VAR_POLL_READABLE, 0, poll_builtin_fd_array(nfds, &rfds),
+            SCOPE_GLOBAL, false);
+    set_array(L VAR_POLL_WRITABLE, 0, poll_builtin_fd_array(nfds, &wfds),
+            SCOPE_GLOBAL, false);
+    set_array(L VAR_POLL_JOBS, readyjobs.length, pl_toary(&readyjobs),
+            SCOPE_GLOBAL, false);
+    free(jobnumbers);
+    return status;
+}
+
+/* Parses `fdstr' as a file descriptor and adds it to `*fds'.
+ * `*nfdsp' is updated to be larger than the file descriptor.
+ * Prints an error message and returns false if `fdstr' is not an open file
+ * descriptor that can be waited for. */
+bool poll_builtin_add_fd(const wchar_t *fdstr, fd_set *fds, int *nfdsp)
+{
+    int fd;
+    if (!xwcstoi(fdstr, 10, &fd) || fd < 0) {
+        xerror(0, Ngt("`%ls' is not a valid file descriptor"), fdstr);
+        return false;
+    }
+    if (fd >= FD_SETSIZE || is_shellfd(fd) || fcntl(fd, F_GETFD) < 0) {
+        xerror(0, Ngt("file descriptor %d is unavailable"), fd);
+        return false;
+    }
+    FD_SET(fd, fds);
+    if (*nfdsp <= fd)
+        *nfdsp = fd + 1;
+    return true;
+}
+
+/* Returns a newly malloced array of the file descriptors in `fds' converted to
+ * wide strings. */
+void **poll_builtin_fd_array(int nfds, const fd_set *fds)
+{
+    plist_T list;
+    pl_init(&list);
+    for (int fd = 0; fd < nfds; fd++)
+        if (FD_ISSET(fd, fds))
+            pl_add(&list, malloc_wprintf(L"%d", fd));
+    return pl_toary(&list);
+}
+
+#if YASH_ENABLE_HELP
+const char poll_help[] = Ngt(
+"wait for file descriptors or jobs to get ready"
+);
+const char poll_syntax[] = Ngt(
+"\tpoll [-r fd]... [-w fd]... [-t timeout] [job...]\n"
+);
+#endif
+
 
 /* vim: set ts=8 sts=4 sw=4 et tw=80: */
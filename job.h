@@ -35,26 +35,39 @@ typedef struct process_T {
     jobstatus_T  pr_status;
     int          pr_statuscode;
     wchar_t     *pr_name;         /* process name made from command line */
+    struct command_T *pr_command; /* command to make `pr_name' from */
 } process_T;
 /* If `pr_pid' is 0, the process was finished without `fork'ing from the shell.
  * In this case, `pr_status' is JS_DONE and `pr_statuscode' is the exit status.
  * If `pr_pid' is a positive number, it's the process ID. In this case,
- * `pr_statuscode' is the status code returned by `waitpid'. */
+ * `pr_statuscode' is the status code returned by `waitpid'.
+ * If `pr_command' is non-NULL, `pr_name' has not yet been made. The name is
+ * made from the command (which has been `comsdup'ed) when it is first needed,
+ * so that no time is spent on the name of a job that is never shown. */
 
 /* info about a job */
 typedef struct job_T {
     pid_t       j_pgid;          /* process group ID */
     jobstatus_T j_status;
     _Bool       j_statuschanged; /* job's status not yet reported? */
-    _Bool       j_legacy;        /* not a true child of the shell? */
     _Bool       j_nonotify;      /* suppress printing job status? */
+    unsigned    j_generation;    /* job generation the job was added in */
+    struct arena_T *j_arena;     /* arena that may contain `pr_command's */
+    struct heldarena_T *j_heldarena; /* arena held alive for `pr_command's */
     size_t      j_pcount;        /* # of processes in `j_procs' */
     process_T   j_procs[];       /* info about processes */
 } job_T;
 /* When job control is off, `j_pgid' is 0 since the job shares the process group
  * ID with the shell.
- * In subshells, the `j_legacy' flag is set to indicate that the job is not
- * a direct child of the current shell process. */
+ * `j_generation' is set by `set_active_job'. A job whose generation is older
+ * than the current one was inherited from the parent of a subshell, so it is
+ * not a direct child of the current shell process. Such a job is called a
+ * legacy job.
+ * `j_arena' and `j_heldarena' are also set by `set_active_job'. If the job has
+ * a process whose name is yet to be made, `j_arena' is `current_parse_arena',
+ * the arena that may contain the command. When that arena is about to be
+ * reset, `hold_arena_for_jobs' moves its contents to `j_heldarena', which is
+ * shared among the jobs and destroyed after all their names have been made. */
 
 
 /* job number of the active job */
@@ -71,17 +84,38 @@ extern void init_job(void);
 
 extern void set_active_job(job_T *job)
     __attribute__((nonnull));
-extern void add_job(_Bool current);
+struct arena_T;
+extern void hold_arena_for_jobs(struct arena_T *arena)
+    __attribute__((nonnull));
+extern size_t add_job(_Bool current);
 extern void remove_job(size_t jobnumber);
 extern void remove_job_nofitying_signal(size_t jobnumber);
 extern void remove_all_jobs(void);
 extern void neglect_all_jobs(void);
 extern size_t job_count(void)
     __attribute__((pure));
+extern size_t running_job_count(void)
+    __attribute__((pure));
 extern size_t stopped_job_count(void)
     __attribute__((pure));
+extern void job_memory_usage(size_t *countp, size_t *bytesp)
+    __attribute__((nonnull));
+extern void wait_for_job_slot(void);
+
+/* resource usage of processes */
+typedef struct usage_T {
+    double utime, stime;    /* user and system CPU time in seconds */
+    long   maxrss;          /* maximum resident set size in kilobytes */
+    long   inblock, oublock; /* number of block input/output operations */
+    long   nvcsw, nivcsw;   /* number of voluntary/involuntary context switch */
+} usage_T;
+/* The members other than `utime' and `stime' are always zero if the system
+ * does not support the `wait4' function. */
 
 extern void do_wait(void);
+extern void get_usage(usage_T *restrict self, usage_T *restrict children)
+    __attribute__((nonnull));
+extern void set_children_maxrss(long maxrss);
 extern int wait_for_job(size_t jobnumber, _Bool return_on_stop,
         _Bool interruptible, _Bool return_on_trap);
 extern wchar_t **wait_for_child(pid_t cpid, pid_t cpgid, _Bool return_on_stop);
@@ -112,6 +146,7 @@ extern int fg_builtin(int argc, void **argv)
 extern const char fg_help[], fg_syntax[], bg_help[], bg_syntax[];
 #endif
 
+extern const struct xgetopt_T wait_options[];
 extern int wait_builtin(int argc, void **argv)
     __attribute__((nonnull));
 #if YASH_ENABLE_HELP
@@ -124,6 +159,13 @@ extern int disown_builtin(int argc, void **argv)
 extern const char disown_help[], disown_syntax[];
 #endif
 
+extern const struct xgetopt_T poll_options[];
+extern int poll_builtin(int argc, void **argv)
+    __attribute__((nonnull));
+#if YASH_ENABLE_HELP
+extern const char poll_help[], poll_syntax[];
+#endif
+
 
 #endif /* YASH_JOB_H */
 
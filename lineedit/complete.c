@@ -111,6 +111,11 @@ static void select_candidate_by_offset(int offset);
 static void free_candidate(void *c)
     __attribute__((nonnull));
 static void free_context(le_context_T *ctxt);
+/* A candidate and the collation key of its value used in sorting */
+struct candsort_T {
+    le_candidate_T *cand;
+    const wchar_t *key;
+};
 static void sort_candidates(void);
 static int sort_candidates_cmp(const void *cp1, const void *cp2)
     __attribute__((nonnull));
@@ -119,6 +124,7 @@ static void print_context_info(const le_context_T *ctxt)
 static void print_compopt_info(const le_compopt_T *compopt)
     __attribute__((nonnull));
 
+static bool generation_cancelled(void);
 static void execute_completion_function(void);
 static void complete_command_default(void);
 
@@ -133,6 +139,8 @@ static void generate_file_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
 static void generate_external_command_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
+static char *get_literal_prefix(const le_compopt_T *compopt)
+    __attribute__((nonnull,malloc,warn_unused_result));
 static void generate_keyword_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
 static void generate_logname_candidates(const le_compopt_T *compopt)
@@ -173,6 +181,18 @@ size_t le_selected_candidate_index;
  * The value is ((size_t) -1) when not computed. */
 static size_t common_prefix_length;
 
+/* The minimum time in seconds candidate generation must have taken before it
+ * can be cancelled by a key press. Shorter generations are never cancelled so
+ * that keys typed ahead of completion do not defeat it. */
+#ifndef COMPLETION_CANCEL_DELAY
+#define COMPLETION_CANCEL_DELAY 0.2
+#endif
+
+/* The time when the current candidate generation started. */
+static double generation_start_time;
+/* True when the current candidate generation has been cancelled. */
+static bool is_generation_cancelled;
+
 
 /* Performs command line completion.
  * Existing candidates are deleted, if any, and candidates are computed from
@@ -204,12 +224,21 @@ void le_complete(le_compresult_T lecr)
     if (le_state_is_compdebug)
         print_context_info(ctxt);
 
+    generation_start_time = get_real_time();
+    is_generation_cancelled = false;
     execute_completion_function();
-    sort_candidates();
-    le_compdebug("total of %zu candidate(s)", le_candidates.length);
+    if (is_generation_cancelled) {
+        /* The key that cancelled the generation is left unread, so it is
+         * processed as usual after we return. */
+        le_compdebug("completion cancelled by key input");
+        le_complete_cleanup();
+    } else {
+        sort_candidates();
+        le_compdebug("total of %zu candidate(s)", le_candidates.length);
 
-    /* display the results */
-    lecr();
+        /* display the results */
+        lecr();
+    }
 
     if (le_state_is_compdebug) {
         le_compdebug("completion end");
@@ -391,6 +420,27 @@ void le_complete_cleanup(void)
     ctxt = NULL;
 }
 
+/* Checks if the current candidate generation should be abandoned.
+ * Generation is cancelled when the user has typed a key while a generation that
+ * has taken longer than COMPLETION_CANCEL_DELAY is in progress. Once cancelled,
+ * this function keeps returning true until the next completion starts.
+ * Candidate generators call this function repeatedly in their loops, so the
+ * actual check is done only once in a while to keep it cheap. */
+bool generation_cancelled(void)
+{
+    static unsigned count = 0;
+
+    if (is_generation_cancelled)
+        return true;
+    if (++count % 64 != 0)
+        return false;
+    if (get_real_time() - generation_start_time < COMPLETION_CANCEL_DELAY)
+        return false;
+    if (le_input_is_pending())
+        is_generation_cancelled = true;
+    return is_generation_cancelled;
+}
+
 /* Frees a completion candidate.
  * The argument must point to a `le_candidate_T' value. */
 void free_candidate(void *c)
@@ -417,29 +467,55 @@ void free_context(le_context_T *ctxt)
 /* Sorts the candidates in the candidate list and removes duplicates. */
 void sort_candidates(void)
 {
-    qsort(le_candidates.contents,
-            le_candidates.length, sizeof *le_candidates.contents,
-            sort_candidates_cmp);
-
-    if (le_candidates.length >= 2) {
-        for (size_t i = le_candidates.length - 1; i > 0; i--) {
-            le_candidate_T *cand1 = le_candidates.contents[i];
-            le_candidate_T *cand2 = le_candidates.contents[i - 1];
-            // XXX case-sensitive
-            if (wcscoll(cand1->origvalue, cand2->origvalue) == 0) {
-                free_candidate(cand1);
-                pl_remove(&le_candidates, i, 1);
-            }
+    size_t count = le_candidates.length;
+    if (count < 2)
+        return;
+
+    /* Compute the collation keys in advance so that `sort_candidates_cmp'
+     * does not have to call `wcscoll'. Leading hyphens are excluded from the
+     * keys because `sort_candidates_cmp' compares them separately. */
+    const wchar_t **values = xmallocn(count, sizeof *values);
+    for (size_t i = 0; i < count; i++) {
+        const le_candidate_T *cand = le_candidates.contents[i];
+        const wchar_t *value = cand->origvalue;
+        while (*value == L'-')
+            value++;
+        values[i] = value;
+    }
+
+    const wchar_t **keys = xmallocn(count, sizeof *keys);
+    wchar_t *arena = make_collation_keys(values, count, keys);
+    struct candsort_T *items = xmallocn(count, sizeof *items);
+    for (size_t i = 0; i < count; i++)
+        items[i] = (struct candsort_T) {
+            .cand = le_candidates.contents[i], .key = keys[i], };
+
+    qsort(items, count, sizeof *items, sort_candidates_cmp);
+
+    for (size_t i = 0; i < count; i++)
+        le_candidates.contents[i] = items[i].cand;
+    free(items);
+    free(arena);
+    free(keys);
+    free(values);
+
+    /* remove duplicates */
+    for (size_t i = le_candidates.length - 1; i > 0; i--) {
+        le_candidate_T *cand1 = le_candidates.contents[i];
+        le_candidate_T *cand2 = le_candidates.contents[i - 1];
+        // XXX case-sensitive
+        if (wcscoll(cand1->origvalue, cand2->origvalue) == 0) {
+            free_candidate(cand1);
+            pl_remove(&le_candidates, i, 1);
         }
     }
 }
 
 int sort_candidates_cmp(const void *cp1, const void *cp2)
 {
-    const le_candidate_T *cand1 = *(const le_candidate_T **) cp1;
-    const le_candidate_T *cand2 = *(const le_candidate_T **) cp2;
-    const wchar_t *v1 = cand1->origvalue;
-    const wchar_t *v2 = cand2->origvalue;
+    const struct candsort_T *item1 = cp1, *item2 = cp2;
+    const wchar_t *v1 = item1->cand->origvalue;
+    const wchar_t *v2 = item2->cand->origvalue;
 
     /* Candidates that start with hyphens are sorted in a special order so that
      * short options come before long options. Such candidates are sorted case-
@@ -458,7 +534,7 @@ int sort_candidates_cmp(const void *cp1, const void *cp2)
 #endif
     }
 
-    return wcscoll(v1, v2);
+    return wcscmp(item1->key, item2->key);
     // XXX case-sensitive
 }
 
@@ -679,20 +755,28 @@ void simple_completion(le_candgentype_T type)
  * set to NULL. */
 void generate_candidates(const le_compopt_T *compopt)
 {
-    generate_file_candidates(compopt);
-    generate_builtin_candidates(compopt);
-    generate_external_command_candidates(compopt);
-    generate_function_candidates(compopt);
-    generate_keyword_candidates(compopt);
-    generate_alias_candidates(compopt);
-    generate_variable_candidates(compopt);
-    generate_job_candidates(compopt);
-    generate_signal_candidates(compopt);
-    generate_logname_candidates(compopt);
-    generate_group_candidates(compopt);
-    generate_host_candidates(compopt);
-    generate_bindkey_candidates(compopt);
-    generate_dirstack_candidates(compopt);
+    static void (*const generators[])(const le_compopt_T *) = {
+        generate_file_candidates,
+        generate_builtin_candidates,
+        generate_external_command_candidates,
+        generate_function_candidates,
+        generate_keyword_candidates,
+        generate_alias_candidates,
+        generate_variable_candidates,
+        generate_job_candidates,
+        generate_signal_candidates,
+        generate_logname_candidates,
+        generate_group_candidates,
+        generate_host_candidates,
+        generate_bindkey_candidates,
+        generate_dirstack_candidates,
+    };
+
+    for (size_t i = 0; i < sizeof generators / sizeof *generators; i++) {
+        if (is_generation_cancelled)
+            break;
+        generators[i](compopt);
+    }
 
     for (const le_comppattern_T *p = compopt->patterns; p != NULL; p = p->next)
         xfnm_free(p->cpattern);
@@ -807,19 +891,18 @@ bool le_compile_cpatterns(const le_compopt_T *compopt)
 
 /* Perform pattern matching for multibyte string `s' using patterns `ps'.
  * The patterns must have been compiled. Returns true iff successful. */
+/* Every pattern must be satisfied, so the order in which the patterns are
+ * tried does not affect the result. Literal patterns are tried first because
+ * they are the cheapest and most likely to reject the string. */
 bool le_match_patterns(const le_comppattern_T *ps, const char *s)
 {
-    for (; ps != NULL; ps = ps->next){
-        bool match = (xfnm_match(ps->cpattern, s) == 0);
-        switch (ps->type) {
-            case CPT_ACCEPT:
-                if (!match)
-                    return false;
-                break;
-            case CPT_REJECT:
-                if (match)
-                    return false;
-                break;
+    for (int pass = 0; pass < 2; pass++) {
+        for (const le_comppattern_T *p = ps; p != NULL; p = p->next) {
+            if (xfnm_is_literal(p->cpattern) != (pass == 0))
+                continue;
+            bool match = (xfnm_match(p->cpattern, s) == 0);
+            if (match != (p->type == CPT_ACCEPT))
+                return false;
         }
     }
     return true;
@@ -834,20 +917,17 @@ bool le_match_comppatterns(const le_compopt_T *compopt, const char *s)
 }
 
 /* Perform pattern matching for wide string `s' using patterns `ps'.
- * The patterns must have been compiled. Returns true iff successful. */
+ * The patterns must have been compiled. Returns true iff successful.
+ * Literal patterns are tried first as in `le_match_patterns'. */
 bool le_wmatch_patterns(const le_comppattern_T *ps, const wchar_t *s)
 {
-    for (; ps != NULL; ps = ps->next) {
-        bool match = (xfnm_wmatch(ps->cpattern, s).start != (size_t) -1);
-        switch (ps->type) {
-            case CPT_ACCEPT:
-                if (!match)
-                    return false;
-                break;
-            case CPT_REJECT:
-                if (match)
-                    return false;
-                break;
+    for (int pass = 0; pass < 2; pass++) {
+        for (const le_comppattern_T *p = ps; p != NULL; p = p->next) {
+            if (xfnm_is_literal(p->cpattern) != (pass == 0))
+                continue;
+            bool match = (xfnm_wmatch(p->cpattern, s).start != (size_t) -1);
+            if (match != (p->type == CPT_ACCEPT))
+                return false;
         }
     }
     return true;
@@ -889,6 +969,10 @@ void generate_file_candidates(const le_compopt_T *compopt)
     /* check pathnames in `list' and add them to the candidate list */
     for (size_t i = 0; i < list.length; i++) {
         wchar_t *name = list.contents[i];
+        if (generation_cancelled()) {
+            free(name);
+            continue;
+        }
         if (p != NULL) {
             const wchar_t *basename = wcsrchr(name, L'/');
             if (basename == NULL)
@@ -947,31 +1031,58 @@ void generate_external_command_candidates(const le_compopt_T *compopt)
 
     if (paths == NULL)
         return;
+
+    char *prefix = get_literal_prefix(compopt);
+    size_t prefixlen = strlen(prefix);
     sb_init(&path);
     for (const char *dirpath; (dirpath = *paths) != NULL; paths++) {
-        DIR *dir = opendir(dirpath);
-        struct dirent *de;
-        size_t dirpathlen;
+        if (generation_cancelled())
+            break;
 
-        if (dir == NULL)
+        size_t count;
+        char *const *names = get_command_directory_entries(dirpath, &count);
+        if (names == NULL)
             continue;
+
         sb_cat(&path, dirpath);
         if (path.length > 0 && path.contents[path.length - 1] != '/')
             sb_ccat(&path, '/');
-        dirpathlen = path.length;
-        while ((de = readdir(dir)) != NULL) {
-            if (!le_match_comppatterns(compopt, de->d_name))
+        size_t dirpathlen = path.length;
+        for (size_t i = search_command_directory_entries(names, count, prefix);
+                i < count && strncmp(names[i], prefix, prefixlen) == 0
+                    && !generation_cancelled();
+                i++) {
+            if (!le_match_comppatterns(compopt, names[i]))
                 continue;
-            sb_cat(&path, de->d_name);
+            sb_cat(&path, names[i]);
             if (is_executable_regular(path.contents))
                 le_new_candidate(CT_COMMAND,
-                        malloc_mbstowcs(de->d_name), NULL, compopt);
+                        malloc_mbstowcs(names[i]), NULL, compopt);
             sb_truncate(&path, dirpathlen);
         }
         sb_clear(&path);
-        closedir(dir);
     }
     sb_destroy(&path);
+    free(prefix);
+}
+
+/* Returns the longest literal string every string matching the patterns in
+ * `compopt' starts with, as a newly malloced multibyte string.
+ * The result is the leading part of the first pattern up to the first
+ * character that may have a special meaning in the pattern. */
+char *get_literal_prefix(const le_compopt_T *compopt)
+{
+    const le_comppattern_T *p = compopt->patterns;
+    if (p == NULL || p->type != CPT_ACCEPT)
+        return xstrdup("");
+
+    size_t len = wcscspn(p->pattern, L"*?[\\");
+    wchar_t literal[len + 1];
+    wmemcpy(literal, p->pattern, len);
+    literal[len] = L'\0';
+
+    char *result = malloc_wcstombs(literal);
+    return (result != NULL) ? result : xstrdup("");
 }
 
 /* Generates candidates that are keywords matching the pattern. */
@@ -986,7 +1097,7 @@ void generate_keyword_candidates(const le_compopt_T *compopt)
 
     static const wchar_t *keywords[] = {
         L"case", L"do", L"done", L"elif", L"else", L"esac", L"fi", L"for",
-        L"function", L"if", L"then", L"until", L"while", NULL,
+        L"function", L"if", L"then", L"time", L"until", L"while", NULL,
         // XXX "select" is not currently supported
     };
 
@@ -1009,7 +1120,7 @@ void generate_logname_candidates(const le_compopt_T *compopt)
 
     struct passwd *pwd;
     setpwent();
-    while ((pwd = getpwent()) != NULL)
+    while (!generation_cancelled() && (pwd = getpwent()) != NULL)
         if (le_match_comppatterns(compopt, pwd->pw_name))
             le_new_candidate(CT_LOGNAME, malloc_mbstowcs(pwd->pw_name),
 # if HAVE_PW_GECOS
@@ -1037,7 +1148,7 @@ void generate_group_candidates(const le_compopt_T *compopt)
 
     struct group *grp;
     setgrent();
-    while ((grp = getgrent()) != NULL)
+    while (!generation_cancelled() && (grp = getgrent()) != NULL)
         if (le_match_comppatterns(compopt, grp->gr_name))
             le_new_candidate(
                     CT_GRP, malloc_mbstowcs(grp->gr_name), NULL, compopt);
@@ -1061,7 +1172,7 @@ void generate_host_candidates(const le_compopt_T *compopt)
 
     struct hostent *host;
     sethostent(true);
-    while ((host = gethostent()) != NULL) {
+    while (!generation_cancelled() && (host = gethostent()) != NULL) {
         if (le_match_comppatterns(compopt, host->h_name))
             le_new_candidate(
                     CT_HOSTNAME, malloc_mbstowcs(host->h_name), NULL, compopt);
@@ -241,6 +241,18 @@ bool cparse_command(void)
             || has_token(L"elif")) {
         INDEX += 4;
         return false;
+    } else if (!posixly_correct && has_token(L"time")) {
+        INDEX += 4;
+        /* skip the options of the "time" keyword */
+        for (;;) {
+            skip_blanks();
+            if (!has_token(L"-p"))
+                break;
+            INDEX += 2;
+        }
+        if (has_token(L"--"))
+            INDEX += 2;
+        return false;
     } else if (has_token(L"while") || has_token(L"until")) {
         INDEX += 5;
         return false;
@@ -353,6 +365,8 @@ bool ctryparse_assignment(void)
         return false;
     while (is_name_char(BUF[index]))
         index++;
+    if (BUF[index] == L'+' && !posixly_correct)
+        index++;
     if (BUF[index] != L'=')
         return false;
     INDEX = index + 1;
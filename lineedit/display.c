@@ -19,6 +19,7 @@
 #include "../common.h"
 #include "display.h"
 #include <assert.h>
+#include <errno.h>
 #if HAVE_GETTEXT
 # include <libintl.h>
 #endif
@@ -334,11 +335,31 @@ bool lebuf_putchar1_trunc(int c)
 typedef struct candpage_T candpage_T;
 typedef struct candcol_T candcol_T;
 
+/* The state of the print buffer recorded by `print_editline_chars' before
+ * printing each character of the edit line. */
+struct printedchar_T {
+    le_pos_T pos;        /* cursor position */
+    size_t offset;       /* length of `lebuf.buf' */
+    bool styler_active;  /* value of `styler_active' */
+};
+
 static void finish(void);
 static void clear_to_end_of_screen(void);
 static void clear_editline(void);
 static void maybe_print_promptsp(void);
 static void update_editline(void);
+static bool update_editline_partially(size_t index);
+static bool has_wrapping_gap(
+        const struct printedchar_T *record, size_t from, size_t to)
+    __attribute__((nonnull,pure));
+static bool is_shiftable_line(int line)
+    __attribute__((pure));
+static void print_editline_chars(
+        size_t from, size_t to, struct printedchar_T *record)
+    __attribute__((nonnull));
+static void store_editline(size_t from, const struct printedchar_T *record)
+    __attribute__((nonnull));
+static void finish_editline(void);
 static bool current_display_is_uptodate(size_t index)
     __attribute__((pure));
 static void check_cand_overwritten(void);
@@ -378,6 +399,12 @@ static size_t select_list_item(size_t index, int offset, size_t listsize)
     __attribute__((const));
 
 
+/* The minimum length of output that is enclosed by the "Sync" capability.
+ * Shorter output is likely to be received by the terminal at once anyway. */
+#ifndef SYNC_THRESHOLD
+#define SYNC_THRESHOLD 256
+#endif
+
 /* True when the prompt is displayed on the screen. */
 /* The print buffer, `rprompt', and `sprompt' are valid iff `display_active' is
  * true. */
@@ -447,6 +474,10 @@ static plist_T candpages = { .contents = NULL };
  * The elements pointed to by `candcols.contents[*]' are of type `candcol_T'.
  * `candcols' is active iff `candpages' is active. */
 static plist_T candcols = { .contents = NULL };
+/* The number of the screen columns and the lines available below the edit line
+ * when `candpages' and `candcols' were made. The pages and columns are reused
+ * as long as these values are unchanged. */
+static int candlayoutcolumns, candlayoutlines;
 /* The index of the candidate that is currently highlighted.
  * An invalid index indicates that no candidate is highlighted. */
 static size_t candhighlight;
@@ -505,7 +536,7 @@ void finish(void)
     assert(display_active);
 
     clear_to_end_of_screen(), candbaseline = -1;
-    le_display_complete_cleanup();
+    candhighlight = NOHIGHLIGHT;
 
     free(current_editline), current_editline = NULL;
     free(cursor_positions), cursor_positions = NULL;
@@ -518,11 +549,28 @@ void finish(void)
 
 /* Flushes the contents of the print buffer to the standard error and destroys
  * the buffer. */
+/* The contents are written by a single `write' call (unless interrupted) so
+ * that the terminal does not show the display in the middle of update. Writing
+ * through `stderr' would split them at every newline. */
 void le_display_flush(void)
 {
     current_position = lebuf.pos;
-    fwrite(lebuf.buf.contents, 1, lebuf.buf.length, stderr);
     fflush(stderr);
+
+    if (lebuf.buf.length >= SYNC_THRESHOLD)
+        lebuf_wrap_sync();
+
+    const char *s = lebuf.buf.contents;
+    size_t n = lebuf.buf.length;
+    while (n > 0) {
+        ssize_t w = write(STDERR_FILENO, s, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        s += w, n -= w;
+    }
     sb_destroy(&lebuf.buf);
 }
 
@@ -682,8 +730,11 @@ void update_editline(void)
             return;
 
         go_to_index(index);
-        if (current_editline[index] != L'\0')
+        if (current_editline[index] != L'\0') {
+            if (update_editline_partially(index))
+                return;
             clear_editline();
+        }
     } else {
         /* print the whole edit line */
         go_to(editbasepos);
@@ -694,25 +745,169 @@ void update_editline(void)
 
     // No need to check for overflow in `le_main_buffer.length + 1' here. Should
     // overflow occur, the buffer would not have been allocated successfully.
-    current_editline = xreallocn(current_editline,
-            le_main_buffer.length + 1, sizeof *current_editline);
-    cursor_positions = xreallocn(cursor_positions,
-            le_main_buffer.length + 1, sizeof *cursor_positions);
-    for (;;) {
-        wchar_t c = le_main_buffer.contents[index];
-        current_editline[index] = c;
-        cursor_positions[index]
-            = lebuf.pos.line * lebuf.maxcolumn + lebuf.pos.column;
-        if (index == le_main_buffer.length)
+    struct printedchar_T *record =
+        xmallocn(le_main_buffer.length + 1, sizeof *record);
+    print_editline_chars(index, le_main_buffer.length, record);
+    store_editline(index, record);
+    free(record);
+    finish_editline();
+}
+
+/* Updates the edit line on the screen without clearing it from `index', the
+ * index of the first character that has been changed.
+ * If the characters after the changed part remain at the same position on the
+ * screen, they are not reprinted. If the changed part and the following
+ * characters are on the same line, the following characters are shifted by the
+ * "ich" or "dch" capability rather than reprinted.
+ * The cursor must be at the position of the character at `index'. If neither is
+ * possible, false is returned without printing anything. */
+bool update_editline_partially(size_t index)
+{
+    size_t oldlength = wcslen(current_editline);
+    size_t newlength = le_main_buffer.length;
+    int maxcolumn = lebuf.maxcolumn;
+    size_t savebuflength = lebuf.buf.length;
+    le_pos_T savepos = lebuf.pos;
+    bool savestyleractive = styler_active;
+
+    /* Tentatively print the new characters to see where they go. */
+    struct printedchar_T *record = xmallocn(newlength + 1, sizeof *record);
+    update_styler();
+    print_editline_chars(index, newlength, record);
+
+    /* Count the unchanged characters at the end of the line. */
+    size_t tail = 0;
+    while (tail < newlength - index && tail < oldlength - index) {
+        size_t i = newlength - tail - 1, j = oldlength - tail - 1;
+        if (le_main_buffer.contents[i] != current_editline[j])
+            break;
+        if ((i < le_main_length) != (j < current_length))
+            break;
+        tail++;
+    }
+
+#define LINEAR(pos) ((pos).line * maxcolumn + (pos).column)
+    int oldend = cursor_positions[oldlength];
+    if (LINEAR(record[newlength].pos) == oldend
+            && !has_wrapping_gap(record, index, newlength)) {
+        /* The end of the edit line stays. The new characters overwrite the old
+         * ones until the unchanged characters that are still in place. */
+        size_t stop = newlength;
+        while (stop > newlength - tail && LINEAR(record[stop - 1].pos)
+                == cursor_positions[stop - 1 + oldlength - newlength])
+            stop--;
+        while (stop < newlength && record[stop].pos.column >= maxcolumn)
+            stop++;
+
+        store_editline(index, record);
+        if (stop == newlength) {
+            finish_editline();
+        } else {
+            sb_truncate(&lebuf.buf, record[stop].offset);
+            lebuf.pos = record[stop].pos;
+            styler_active = record[stop].styler_active;
+            current_length = le_main_length;
+        }
+        free(record);
+        return true;
+    }
+
+    int line = savepos.line;
+    if (tail > 0
+            && record[newlength].pos.line == line
+            && record[newlength].pos.column < maxcolumn
+            && oldend / maxcolumn == line
+            && is_shiftable_line(line)) {
+        /* Shift the unchanged characters and print the changed ones. */
+        int shift = record[newlength].pos.column - oldend % maxcolumn;
+        sb_truncate(&lebuf.buf, savebuflength);
+        lebuf.pos = savepos;
+        styler_active = savestyleractive;
+        if (shift > 0 ? lebuf_print_ich(shift) : lebuf_print_dch(-shift)) {
+            update_styler();
+            print_editline_chars(index, newlength - tail, record);
+            store_editline(index, record);
+            free(record);
+            current_length = le_main_length;
+            last_edit_line = (line >= rprompt_line) ? line : rprompt_line;
+            if (rprompt_line < line)
+                rprompt_line = -1;
+            return true;
+        }
+    }
+#undef LINEAR
+
+    sb_truncate(&lebuf.buf, savebuflength);
+    lebuf.pos = savepos;
+    styler_active = savestyleractive;
+    free(record);
+    return false;
+}
+
+/* Returns true if a wide character in the range [from, to) of the edit line
+ * printed as recorded in `record' has been wrapped to the next line, leaving a
+ * blank at the end of the line. */
+bool has_wrapping_gap(
+        const struct printedchar_T *record, size_t from, size_t to)
+{
+    for (size_t i = from; i < to; i++)
+        if (record[i + 1].pos.line > record[i].pos.line
+                && record[i + 1].pos.column != 0
+                && record[i].pos.column < lebuf.maxcolumn)
+            return true;
+    return false;
+}
+
+/* Returns true if the characters on the specified line can be shifted by the
+ * "ich" or "dch" capability without disturbing the right prompt or the
+ * candidate area. */
+bool is_shiftable_line(int line)
+{
+    return rprompt_line != line && !(0 <= candbaseline && candbaseline <= line);
+}
+
+/* Prints the characters of the edit line in the range [from, to).
+ * The state of the print buffer before printing each character is recorded in
+ * `record[from]' to `record[to]'. */
+void print_editline_chars(
+        size_t from, size_t to, struct printedchar_T *record)
+{
+    for (size_t index = from; ; index++) {
+        record[index] = (struct printedchar_T) {
+            .pos = lebuf.pos,
+            .offset = lebuf.buf.length,
+            .styler_active = styler_active,
+        };
+        if (index == to)
             break;
         if (styler_active && index >= le_main_length) {
             lebuf_print_sgr0(), styler_active = false;
             lebuf_print_prompt(prompt.predict);
         }
-        lebuf_putwchar(c, true);
-        index++;
+        lebuf_putwchar(le_main_buffer.contents[index], true);
+    }
+}
+
+/* Saves the edit line into `current_editline' and the positions in `record'
+ * into `cursor_positions'. The characters before index `from' are assumed
+ * unchanged. */
+void store_editline(size_t from, const struct printedchar_T *record)
+{
+    current_editline = xreallocn(current_editline,
+            le_main_buffer.length + 1, sizeof *current_editline);
+    cursor_positions = xreallocn(cursor_positions,
+            le_main_buffer.length + 1, sizeof *cursor_positions);
+    for (size_t index = from; index <= le_main_buffer.length; index++) {
+        current_editline[index] = le_main_buffer.contents[index];
+        cursor_positions[index] =
+            record[index].pos.line * lebuf.maxcolumn + record[index].pos.column;
     }
+}
 
+/* Updates the state after the whole edit line has been printed.
+ * The cursor must be just after the edit line. */
+void finish_editline(void)
+{
     current_length = le_main_length;
 
     fillip_cursor();
@@ -985,6 +1180,10 @@ void update_candidates(void)
     if (le_candidates.contents != NULL || candbaseline >= 0) {
         if (candoverwritten)
             le_display_complete_cleanup();
+        else if (candbaseline < 0 && candpages.contents != NULL
+                && (candlayoutcolumns != le_columns
+                    || candlayoutlines != le_lines - last_edit_line - 1))
+            le_display_complete_cleanup();
         if (candpages.contents == NULL) {
             make_pages_and_columns();
             print_candidates_all();
@@ -1019,6 +1218,8 @@ void make_pages_and_columns(void)
 
     pl_init(&candpages);
     pl_init(&candcols);
+    candlayoutcolumns = le_columns;
+    candlayoutlines = maxrowi;
 
 #if INT_MAX > SIZE_MAX
     size_t maxrow = (maxrowi > SIZE_MAX) ? SIZE_MAX : (size_t) maxrowi;
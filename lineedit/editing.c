@@ -327,6 +327,9 @@ static void update_search(void);
 static void perform_search(const wchar_t *pattern,
         enum le_search_direction_T dir, enum le_search_type_T type)
     __attribute__((nonnull));
+static void perform_search_from(const histlink_T *l, const wchar_t *pattern,
+        enum le_search_direction_T dir, enum le_search_type_T type)
+    __attribute__((nonnull));
 static void search_again(enum le_search_direction_T dir);
 static void beginning_search(enum le_search_direction_T dir);
 static inline bool beginning_search_check_go_to_history(const wchar_t *prefix)
@@ -3555,7 +3558,10 @@ void go_to_history(const histlink_T *l, enum le_search_type_T curpos)
 
 /***** History Search Commands *****/
 
-/* Appends the argument character to the search buffer. */
+/* Appends the argument character to the search buffer.
+ * In emacs-like search, an entry that contains the extended pattern also
+ * contains the pattern before extension, so the search is resumed from the
+ * current result candidate rather than restarted. */
 void cmd_srch_self_insert(wchar_t c)
 {
     if (le_search_buffer.contents == NULL || c == L'\0') {
@@ -3563,8 +3569,24 @@ void cmd_srch_self_insert(wchar_t c)
         return;
     }
 
+    bool resume = le_search_type == SEARCH_EMACS && le_search_buffer.length > 0;
     wb_wccat(&le_search_buffer, c);
-    update_search();
+    if (!resume) {
+        update_search();
+        return;
+    }
+
+    const histlink_T *l = le_search_result;
+    if (l != Histlist) {
+        /* step back by one so that the current candidate is tested first */
+        switch (le_search_direction) {
+            case FORWARD:   l = l->prev;  break;
+            case BACKWARD:  l = l->next;  break;
+        }
+        perform_search_from(l, le_search_buffer.contents,
+                le_search_direction, le_search_type);
+    }
+    reset_state();
 }
 
 /* Removes the last character from the search buffer.
@@ -3727,11 +3749,19 @@ done:
 void perform_search(const wchar_t *pattern,
         enum le_search_direction_T dir, enum le_search_type_T type)
 {
-    const histlink_T *l = main_history_entry;
-    xfnmatch_T *xfnm;
+    if (dir == FORWARD && main_history_entry == Histlist)
+        le_search_result = Histlist;
+    else
+        perform_search_from(main_history_entry, pattern, dir, type);
+}
 
-    if (dir == FORWARD && l == Histlist)
-        goto done;
+/* Performs history search with the given parameters and updates the result
+ * candidate. The search starts from the entry next to `l' in direction `dir'.
+ */
+void perform_search_from(const histlink_T *l, const wchar_t *pattern,
+        enum le_search_direction_T dir, enum le_search_type_T type)
+{
+    xfnmatch_T *xfnm;
 
     switch (type) {
         case SEARCH_PREFIX: {
@@ -26,6 +26,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <wchar.h>
+#include <sys/select.h>
 #include "../option.h"
 #include "../sig.h"
 #include "../strbuf.h"
@@ -195,8 +196,12 @@ void read_next(void)
     if (c != '\0')
         goto direct_first_buffer;
 
-    le_display_update(true);
-    le_display_flush();
+    /* The display is not updated while more input is available so that a
+     * series of keys (e.g. pasted text) is displayed by a single update. */
+    if (!le_input_is_pending()) {
+        le_display_update(true);
+        le_display_flush();
+    }
 
     /* wait for and read the next byte */
     switch (wait_for_input(STDIN_FILENO, reader_trap,
@@ -393,6 +398,18 @@ char pop_prebuffer(void)
     return '\0';
 }
 
+/* Returns true iff the standard input has bytes that can be read without
+ * blocking. */
+bool le_input_is_pending(void)
+{
+    fd_set fds;
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 0 };
+
+    FD_ZERO(&fds);
+    FD_SET(STDIN_FILENO, &fds);
+    return select(STDIN_FILENO + 1, &fds, NULL, NULL, &timeout) > 0;
+}
+
 /* Tests if the specified character has the meta flag set. */
 bool has_meta_bit(char c)
 {
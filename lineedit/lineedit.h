@@ -53,6 +53,8 @@ extern void le_display_size_changed(void);
 
 extern _Bool le_next_verbatim;
 
+extern _Bool le_input_is_pending(void);
+
 extern void le_append_to_prebuffer(char *s)
     __attribute__((nonnull));
 
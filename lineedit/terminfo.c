@@ -33,6 +33,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #if HAVE_TIOCGWINSZ
 # include <sys/ioctl.h>
 #endif
@@ -58,6 +59,7 @@
 
 
 /* terminfo capabilities */
+#define TI_Sync    "Sync"
 #define TI_am      "am"
 #define TI_bel     "bel"
 #define TI_blink   "blink"
@@ -74,10 +76,14 @@
 #define TI_cuf1    "cuf1"
 #define TI_cuu     "cuu"
 #define TI_cuu1    "cuu1"
+#define TI_dch     "dch"
+#define TI_dch1    "dch1"
 #define TI_dim     "dim"
 #define TI_ed      "ed"
 #define TI_el      "el"
 #define TI_flash   "flash"
+#define TI_ich     "ich"
+#define TI_ich1    "ich1"
 #define TI_invis   "invis"
 #define TI_kBEG    "kBEG"
 #define TI_kCAN    "kCAN"
@@ -273,9 +279,16 @@ trie_T *le_keycodes = NULL;
 /* True if the terminal is set to the keyboard-transmit mode. */
 static _Bool transmit_mode = 0;
 
+/* The value of $TERM for which the terminfo data have been loaded, or NULL if
+ * the data are not available. */
+static char *loaded_term = NULL;
+
 
 static inline int is_strcap_valid(const char *s)
     __attribute__((const));
+#if HAVE_TIOCGWINSZ
+static _Bool is_loaded_term_current(void);
+#endif
 static void set_up_keycodes(void);
 static _Bool try_print_cap(const char *capname)
     __attribute__((nonnull));
@@ -299,7 +312,8 @@ int is_strcap_valid(const char *s)
 }
 
 /* Calls `setupterm' and checks if terminfo data is available.
- * If `bypass' is true and `le_need_term_update' is false, the terminfo data
+ * If `bypass' is true and either `le_need_term_update' is false or the
+ * terminfo data for the current $TERM are already loaded, the terminfo data
  * are not refreshed and only the terminal size (`le_lines' and `le_columns')
  * is adjusted.
  * Returns true iff successful. */
@@ -312,7 +326,7 @@ _Bool le_setupterm(_Bool bypass)
 
     assert(once || le_need_term_update);
 #if HAVE_TIOCGWINSZ
-    if (bypass && !le_need_term_update) {
+    if (bypass && (!le_need_term_update || is_loaded_term_current())) {
         struct winsize ws;
         if (ioctl(STDERR_FILENO, TIOCGWINSZ, &ws) == 0
                 && ws.ws_row > 0 && ws.ws_col > 0) {
@@ -320,6 +334,7 @@ _Bool le_setupterm(_Bool bypass)
                 le_lines = ws.ws_row;
             if (getenv(VAR_COLUMNS) == NULL)
                 le_columns = ws.ws_col;
+            le_need_term_update = 0;
             return 1;
         }
     }
@@ -327,6 +342,9 @@ _Bool le_setupterm(_Bool bypass)
     (void) bypass;
 #endif /* HAVE_TIOCGWINSZ */
 
+    free(loaded_term);
+    loaded_term = NULL;
+
     if (once)
         del_curterm(cur_term);
     if (setupterm(NULL, STDERR_FILENO, &err) == ERR)
@@ -357,10 +375,33 @@ _Bool le_setupterm(_Bool bypass)
 
     set_up_keycodes();
 
+    const char *term = getenv(VAR_TERM);
+    if (term != NULL)
+        loaded_term = xstrdup(term);
+
     le_need_term_update = 0;
     return 1;
 }
 
+#if HAVE_TIOCGWINSZ
+
+/* Returns true iff the terminfo data loaded in the last call to
+ * `le_setupterm' are still valid for the current environment, that is, $TERM
+ * has not been changed and neither $LINES nor $COLUMNS overrides the terminal
+ * size. */
+_Bool is_loaded_term_current(void)
+{
+    if (loaded_term == NULL)
+        return 0;
+    if (getenv(VAR_LINES) != NULL || getenv(VAR_COLUMNS) != NULL)
+        return 0;
+
+    const char *term = getenv(VAR_TERM);
+    return term != NULL && strcmp(term, loaded_term) == 0;
+}
+
+#endif /* HAVE_TIOCGWINSZ */
+
 /* Initializes `le_keycodes'. */
 void set_up_keycodes(void)
 {
@@ -675,6 +716,24 @@ void lebuf_print_cuu(long count)
     lebuf.pos.line -= count;
 }
 
+/* Prints the "ich"/"ich1" code to the print buffer if available.
+ * (insert `count' blank characters, shifting the rest of the line right)
+ * The cursor does not move.
+ * Returns true iff successful. */
+_Bool lebuf_print_ich(long count)
+{
+    return move_cursor_mul(TI_ich, count, 1) || move_cursor_1(TI_ich1, count);
+}
+
+/* Prints the "dch"/"dch1" code to the print buffer if available.
+ * (delete `count' characters, shifting the rest of the line left)
+ * The cursor does not move.
+ * Returns true iff successful. */
+_Bool lebuf_print_dch(long count)
+{
+    return move_cursor_mul(TI_dch, count, 1) || move_cursor_1(TI_dch1, count);
+}
+
 /* Prints the "el" code to the print buffer. (clear to end of line)
  * Returns true iff successful. */
 _Bool lebuf_print_el(void)
@@ -806,6 +865,29 @@ _Bool lebuf_print_invis(void)
     return try_print_cap(TI_invis);
 }
 
+/* Encloses the contents of the print buffer with the "Sync" codes if available.
+ * (begin and end synchronized update, an extended capability that makes the
+ * terminal show the contents at once)
+ * Returns true iff successful. */
+_Bool lebuf_wrap_sync(void)
+{
+    char *v = tigetstr(TI_Sync);
+    if (!is_strcap_valid(v))
+        return 0;
+
+    char *begin = tparm(v, 1L, 0L, 0L, 0L, 0L, 0L, 0L, 0L, 0L);
+    if (begin == NULL)
+        return 0;
+    begin = xstrdup(begin);
+    char *end = tparm(v, 2L, 0L, 0L, 0L, 0L, 0L, 0L, 0L, 0L);
+    if (end != NULL) {
+        sb_insert(&lebuf.buf, 0, begin);
+        sb_cat(&lebuf.buf, end);
+    }
+    free(begin);
+    return end != NULL;
+}
+
 /* Prints the "flash" or "bel" code to alert the user.
  * If `direct_stderr' is true, the output is sent to the standard error;
  * otherwise, to the print buffer. */
@@ -47,6 +47,8 @@ extern void lebuf_print_cub(long count);
 extern void lebuf_print_cuf(long count);
 extern void lebuf_print_cud(long count);
 extern void lebuf_print_cuu(long count);
+extern _Bool lebuf_print_ich(long count);
+extern _Bool lebuf_print_dch(long count);
 extern _Bool lebuf_print_el(void);
 extern _Bool lebuf_print_ed(void);
 extern _Bool lebuf_print_clear(void);
@@ -62,6 +64,7 @@ extern _Bool lebuf_print_dim(void);
 extern _Bool lebuf_print_bold(void);
 extern _Bool lebuf_print_invis(void);
 extern void lebuf_print_alert(_Bool direct_stderr);
+extern _Bool lebuf_wrap_sync(void);
 
 
 extern int le_eof_char, le_kill_char, le_interrupt_char, le_erase_char;
@@ -292,30 +292,23 @@ trieget_T trie_get(const trienode_T *t, const char *keystr, size_t keylen)
 {
     trieget_T result = { .type = TG_NOMATCH, .matchlength = 0, };
 
-    if (keylen == 0) {
-        if (t->valuevalid)
-            result.type |= TG_EXACTMATCH, result.value = t->value;
-        if (t->count > 0)
-            result.type |= TG_PREFIXMATCH;
-        return result;
-    }
-
-    ssize_t index = search(t, keystr[0]);
-    if (index < 0) {
-        if (t->valuevalid)
-            result.type |= TG_EXACTMATCH, result.value = t->value;
-        return result;
-    }
+    for (size_t i = 0; ; i++) {
+        if (t->valuevalid) {
+            result.type = TG_EXACTMATCH;
+            result.matchlength = i;
+            result.value = t->value;
+        }
+        if (i == keylen) {
+            if (t->count > 0)
+                result.type |= TG_PREFIXMATCH;
+            return result;
+        }
 
-    result = trie_get(t->entries[index].child, &keystr[1], keylen - 1);
-    if (result.type & TG_EXACTMATCH) {
-        result.matchlength++;
-    } else if (t->valuevalid) {
-        result.type |= TG_EXACTMATCH;
-        result.matchlength = 0;
-        result.value = t->value;
+        ssize_t index = search(t, keystr[i]);
+        if (index < 0)
+            return result;
+        t = t->entries[index].child;
     }
-    return result;
 }
 
 /* Matches `keywcs' with the entries of the trie.
@@ -325,30 +318,23 @@ trieget_T trie_getw(const trienode_T *t, const wchar_t *keywcs)
 {
     trieget_T result = { .type = TG_NOMATCH, .matchlength = 0, };
 
-    if (keywcs[0] == L'\0') {
-        if (t->valuevalid)
-            result.type |= TG_EXACTMATCH, result.value = t->value;
-        if (t->count > 0)
-            result.type |= TG_PREFIXMATCH;
-        return result;
-    }
-
-    ssize_t index = searchw(t, keywcs[0]);
-    if (index < 0) {
-        if (t->valuevalid)
-            result.type |= TG_EXACTMATCH, result.value = t->value;
-        return result;
-    }
+    for (size_t i = 0; ; i++) {
+        if (t->valuevalid) {
+            result.type = TG_EXACTMATCH;
+            result.matchlength = i;
+            result.value = t->value;
+        }
+        if (keywcs[i] == L'\0') {
+            if (t->count > 0)
+                result.type |= TG_PREFIXMATCH;
+            return result;
+        }
 
-    result = trie_getw(t->entries[index].child, &keywcs[1]);
-    if (result.type & TG_EXACTMATCH) {
-        result.matchlength++;
-    } else if (t->valuevalid) {
-        result.type |= TG_EXACTMATCH;
-        result.matchlength = 0;
-        result.value = t->value;
+        ssize_t index = searchw(t, keywcs[i]);
+        if (index < 0)
+            return result;
+        t = t->entries[index].child;
     }
-    return result;
 }
 
 /* Calls function `func' for each entry in trie `t'.
@@ -23,17 +23,30 @@
 # include <libintl.h>
 #endif
 #include <stdbool.h>
+#if HAVE_INOTIFY
+# include <stdint.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#if HAVE_INOTIFY
+# include <sys/inotify.h>
+# include <sys/vfs.h>
+#endif
 #include <time.h>
+#if HAVE_INOTIFY
+# include <unistd.h>
+#endif
 #include <wchar.h>
 #include "expand.h"
 #include "hashtable.h"
 #include "option.h"
 #include "parser.h"
 #include "plist.h"
+#if HAVE_INOTIFY
+# include "redir.h"
+#endif
 #include "strbuf.h"
 #include "util.h"
 #include "variable.h"
@@ -49,9 +62,16 @@ typedef struct mailfile_T {
 # if HAVE_ST_MTIMENSEC || HAVE___ST_MTIMENSEC
     unsigned long mf_mtimensec;
 # endif
+#endif
+#if HAVE_INOTIFY
+    int mf_wd;        /* inotify watch descriptor, or -1 if not watched */
+    bool mf_changed;  /* any event reported since the last `stat'? */
+    bool mf_poll;     /* the file must be checked by `stat' every time? */
 #endif
     char mf_filename[];
 } mailfile_T;
+/* If `mf_wd' is non-negative and `mf_changed' is false, the file has not been
+ * modified since its status was last remembered, so it need not be checked. */
 
 static void activate(void);
 static void inactivate(void);
@@ -63,6 +83,16 @@ static void handle_mailpath_element(const wchar_t *s)
     __attribute__((nonnull));
 static bool is_update(const char *path)
     __attribute__((nonnull));
+static bool stat_mailfile(mailfile_T *mf, struct stat *st)
+    __attribute__((nonnull));
+#if HAVE_INOTIFY
+static bool watch_mailfile(mailfile_T *mf)
+    __attribute__((nonnull));
+static void read_mail_events(void);
+static void mark_mailfiles_changed(int wd, uint32_t mask);
+static bool is_on_network_fs(const char *path)
+    __attribute__((nonnull));
+#endif
 static void print_message(const wchar_t *message)
     __attribute__((nonnull));
 
@@ -77,6 +107,18 @@ static hashtable_T mailfiles;
 /* The time of last mail check. */
 static time_t lastchecktime = 0;
 
+#if HAVE_INOTIFY
+/* The inotify instance watching the mail files, or -1 if not open.
+ * This is a shell FD opened on demand by `watch_mailfile'. */
+static int inotifyfd = -1;
+/* true iff inotify is not available on the running system. */
+static bool inotify_failed = false;
+/* Events that may change the modification time of a watched file or the file
+ * the pathname refers to. Unlinking or renaming over a file is reported as
+ * IN_ATTRIB since the link count changes. */
+#define MAIL_EVENTS (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+#endif
+
 
 /* If it is time to check mail, checks if the mail file is updated, and if so
  * prints a message. */
@@ -101,6 +143,13 @@ void inactivate(void)
         mailfiles.capacity = 0;
         lastchecktime = 0;
     }
+#if HAVE_INOTIFY
+    if (inotifyfd >= 0) {
+        remove_shellfd(inotifyfd);
+        xclose(inotifyfd);
+        inotifyfd = -1;
+    }
+#endif
 }
 
 /* Decides if it is time to check mail now.
@@ -132,6 +181,10 @@ bool is_time_to_check_mail(void)
 /* Checks if the mail file is updated and prints a message if so. */
 void check_mail_and_print_message(void)
 {
+#if HAVE_INOTIFY
+    read_mail_events();
+#endif
+
     /* Firstly, check the $MAILPATH variable */
     struct get_variable_T mailpath = get_variable(L VAR_MAILPATH);
     switch (mailpath.type) {
@@ -139,6 +192,7 @@ void check_mail_and_print_message(void)
             break;
         case GV_SCALAR:
             activate();
+            save_get_variable_values(&mailpath);
             handle_mailpath(mailpath.values[0]);
             goto mailpath_handled;
         case GV_ARRAY:
@@ -243,8 +297,26 @@ check:
 /* Checks if the specified file is updated. */
 bool is_update(const char *path)
 {
+    mailfile_T *mf = ht_get(&mailfiles, path).value;
+    bool known = (mf != NULL);
+    if (!known) {
+        mf = xmallocs(sizeof *mf,
+                add(strlen(path), 1), sizeof *mf->mf_filename);
+        strcpy(mf->mf_filename, path);
+#if HAVE_INOTIFY
+        mf->mf_wd = -1;
+        mf->mf_changed = true;
+        mf->mf_poll = false;
+#endif
+        ht_set(&mailfiles, mf->mf_filename, mf);
+    }
+#if HAVE_INOTIFY
+    else if (mf->mf_wd >= 0 && !mf->mf_changed)
+        return false;
+#endif
+
     struct stat st;
-    if (stat(path, &st) < 0) {
+    if (!stat_mailfile(mf, &st)) {
         st.st_size = 0;
         st.st_mtime = 0;
 #if HAVE_ST_MTIM
@@ -258,29 +330,19 @@ bool is_update(const char *path)
 #endif
     }
 
-    bool result;
-    mailfile_T *mf = ht_get(&mailfiles, path).value;
-
-    if (mf != NULL) {
-        result = (st.st_size > 0 || posixly_correct) &&
-            (st.st_mtime != 0) && (st.st_mtime != mf->mf_mtime
+    bool result = known &&
+        (st.st_size > 0 || posixly_correct) &&
+        (st.st_mtime != 0) && (st.st_mtime != mf->mf_mtime
 #if HAVE_ST_MTIM
-            || st.st_mtim.tv_nsec != mf->mf_mtim.tv_nsec
+        || st.st_mtim.tv_nsec != mf->mf_mtim.tv_nsec
 #elif HAVE_ST_MTIMESPEC
-            || st.st_mtimespec.tv_nsec != mf->mf_mtim.tv_nsec
+        || st.st_mtimespec.tv_nsec != mf->mf_mtim.tv_nsec
 #elif HAVE_ST_MTIMENSEC
-            || (unsigned long) st.st_mtimensec != mf->mf_mtimensec
+        || (unsigned long) st.st_mtimensec != mf->mf_mtimensec
 #elif HAVE___ST_MTIMENSEC
-            || (unsigned long) st.__st_mtimensec != mf->mf_mtimensec
+        || (unsigned long) st.__st_mtimensec != mf->mf_mtimensec
 #endif
-            );
-    } else {
-        mf = xmallocs(sizeof *mf,
-                add(strlen(path), 1), sizeof *mf->mf_filename);
-        strcpy(mf->mf_filename, path);
-        ht_set(&mailfiles, mf->mf_filename, mf);
-        result = false;
-    }
+        );
 
 #if HAVE_ST_MTIM
     mf->mf_mtim = st.st_mtim;
@@ -297,6 +359,134 @@ bool is_update(const char *path)
     return result;
 }
 
+/* Gets the status of the specified mail file.
+ * If inotify is available, the file is watched so that it need not be checked
+ * again until it is modified. The file is watched before `stat' is called so
+ * that no modification goes unnoticed.
+ * Returns false if the file does not exist or its status cannot be obtained. */
+bool stat_mailfile(mailfile_T *mf, struct stat *st)
+{
+#if HAVE_INOTIFY
+    if (!watch_mailfile(mf))
+        return false;
+#endif
+    return stat(mf->mf_filename, st) >= 0;
+}
+
+#if HAVE_INOTIFY
+
+/* Starts or renews watching the specified mail file.
+ * The watch is renewed after every event because the pathname may now refer to
+ * a different file. The file is not watched if inotify is not available or the
+ * file is on a network file system, where inotify does not report changes made
+ * by other hosts.
+ * Returns false if the file is known not to exist. */
+bool watch_mailfile(mailfile_T *mf)
+{
+    mf->mf_changed = false;
+    if (mf->mf_poll)
+        return true;
+
+    if (inotifyfd < 0) {
+        if (!inotify_failed)
+            inotifyfd = move_to_shellfd(
+                    inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+        if (inotifyfd < 0) {
+            inotify_failed = true;
+            mf->mf_poll = true;
+            return true;
+        }
+    }
+
+    int wd = inotify_add_watch(inotifyfd, mf->mf_filename, MAIL_EVENTS);
+    if (wd < 0) {
+        if (mf->mf_wd >= 0)
+            inotify_rm_watch(inotifyfd, mf->mf_wd);
+        mf->mf_wd = -1;
+        return errno != ENOENT && errno != ENOTDIR;
+    }
+    if (mf->mf_wd >= 0 && mf->mf_wd != wd)
+        inotify_rm_watch(inotifyfd, mf->mf_wd);
+    mf->mf_wd = wd;
+
+    if (is_on_network_fs(mf->mf_filename)) {
+        inotify_rm_watch(inotifyfd, wd);
+        mf->mf_wd = -1;
+        mf->mf_poll = true;
+    }
+    return true;
+}
+
+/* Reads all the pending inotify events and marks the watched mail files
+ * concerned as changed. */
+void read_mail_events(void)
+{
+    if (inotifyfd < 0)
+        return;
+
+    union {
+        struct inotify_event event;
+        char buf[4096];
+    } u;
+    for (;;) {
+        ssize_t size = read(inotifyfd, u.buf, sizeof u.buf);
+        if (size < 0 && errno == EINTR)
+            continue;
+        if (size <= 0)
+            break;
+
+        for (ssize_t i = 0; i < size; ) {
+            const struct inotify_event *e =
+                (const struct inotify_event *) &u.buf[i];
+            mark_mailfiles_changed(e->wd, e->mask);
+            i += sizeof *e + e->len;
+        }
+    }
+}
+
+/* Marks the mail files watched by the specified watch descriptor as changed.
+ * If the event queue overflowed, all the files are marked. */
+void mark_mailfiles_changed(int wd, uint32_t mask)
+{
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&mailfiles, &i)).key != NULL) {
+        mailfile_T *mf = kv.value;
+        if (mask & IN_Q_OVERFLOW) {
+            mf->mf_changed = true;
+        } else if (mf->mf_wd == wd) {
+            mf->mf_changed = true;
+            if (mask & IN_IGNORED)
+                mf->mf_wd = -1;
+        }
+    }
+}
+
+/* Checks if the specified file is on a network file system.
+ * Returns true also if the file system type cannot be known. */
+bool is_on_network_fs(const char *path)
+{
+    struct statfs sfs;
+    if (statfs(path, &sfs) < 0)
+        return true;
+
+    switch ((unsigned long) sfs.f_type & 0xFFFFFFFFUL) {
+        case 0x6969UL:      /* NFS */
+        case 0x517BUL:      /* SMB */
+        case 0xFF534D42UL:  /* CIFS */
+        case 0xFE534D42UL:  /* SMB2 */
+        case 0x65735546UL:  /* FUSE */
+        case 0x73757245UL:  /* Coda */
+        case 0x5346414FUL:  /* AFS */
+        case 0x00C36400UL:  /* Ceph */
+            return true;
+        default:
+            return false;
+    }
+}
+
+#endif /* HAVE_INOTIFY */
+
 /* Prints the specified `message' after performing parameter expansion on it. */
 void print_message(const wchar_t *message)
 {
@@ -89,6 +89,13 @@ bool shopt_allexport = false;
 /* If set, when a function is defined, all the commands in the function
  * are hashed. Corresponds to the -h/--hashondef option. */
 bool shopt_hashondef = false;
+/* If set, the last command of a pipeline is executed in the current shell
+ * process if job control is not active. Corresponds to the --lastpipe option.
+ */
+bool shopt_lastpipe = false;
+/* If set, the body of a function defined in a script file is not parsed until
+ * the function is first executed. Corresponds to the --lazyparse option. */
+bool shopt_lazyparse = false;
 /* If set, the 'for' loop iteration variable will be made local. */
 bool shopt_forlocal = true;
 
@@ -122,6 +129,9 @@ bool shopt_xtrace = false;
 /* If set, the "xtrace" option is not ignored while executing auxiliary
  * commands. */
 bool shopt_traceall = true;
+/* If set, traces of the "xtrace" option are prefixed with the time, process
+ * ID, and function call depth instead of $PS4. */
+bool shopt_tracestamp = false;
 
 #if YASH_ENABLE_HISTORY
 /* If set, lines that start with a space are not saved in the history.
@@ -155,6 +165,9 @@ bool shopt_extendedglob = false;
  * intact when there are no matches for it.
  * Corresponds to the --nullglob option. */
 bool shopt_nullglob = false;
+/* If set, recursive pathname expansion scans directories in parallel.
+ * Corresponds to the --parallelglob option. */
+bool shopt_parallelglob = false;
 
 /* If set, brace expansion is enabled.
  * Corresponds to the --braceexpand option. */
@@ -236,6 +249,8 @@ static const struct option_T shell_options[] = {
 #endif
     { 0,    0,    L"ignoreeof",      &shopt_ignoreeof,      true, },
     { L'i', 0,    L"interactive",    &is_interactive,       false, },
+    { 0,    0,    L"lastpipe",       &shopt_lastpipe,       true, },
+    { 0,    0,    L"lazyparse",      &shopt_lazyparse,      true, },
 #if YASH_ENABLE_LINEEDIT
     { 0,    0,    L"lealwaysrp",     &shopt_le_alwaysrp,    true, },
     { 0,    0,    L"lecompdebug",    &shopt_le_compdebug,   true, },
@@ -256,10 +271,12 @@ static const struct option_T shell_options[] = {
     { 0,    0,    L"notifyle",       &shopt_notifyle,       true, },
 #endif
     { 0,    0,    L"nullglob",       &shopt_nullglob,       true, },
+    { 0,    0,    L"parallelglob",   &shopt_parallelglob,   true, },
     { 0,    0,    L"pipefail",       &shopt_pipefail,       true, },
     { 0,    0,    L"posixlycorrect", &posixly_correct,      true, },
     { L's', 0,    L"stdin",          &shopt_stdin,          false, },
     { 0,    0,    L"traceall",       &shopt_traceall,       true, },
+    { 0,    0,    L"tracestamp",     &shopt_tracestamp,     true, },
     { 0,    L'u', L"unset",          &shopt_unset,          true, },
     { L'v', 0,    L"verbose",        &shopt_verbose,        true, },
 #if YASH_ENABLE_LINEEDIT
@@ -278,6 +295,9 @@ enum normal_option_index_T {
     NOI_NORCFILE,
     NOI_PROFILE,
     NOI_RCFILE,
+#if YASH_ENABLE_SOCKET
+    NOI_SERVE,
+#endif
     NOI_N,
 };
 
@@ -296,6 +316,9 @@ static const struct xgetopt_T normal_options[] = {
     [NOI_NORCFILE]  = { L'-', L"norcfile",  OPTARG_NONE,     false, NULL, },
     [NOI_PROFILE]   = { L'-', L"profile",   OPTARG_REQUIRED, false, NULL, },
     [NOI_RCFILE]    = { L'-', L"rcfile",    OPTARG_REQUIRED, false, NULL, },
+#if YASH_ENABLE_SOCKET
+    [NOI_SERVE]     = { L'-', L"serve",     OPTARG_REQUIRED, false, NULL, },
+#endif
     [NOI_N]         = { L'\0', NULL, 0, false, NULL, },
 };
 
@@ -776,6 +799,12 @@ int set_normal_option(const struct xgetopt_T *opt, const wchar_t *arg,
                 assert(arg != NULL);
                 shell_invocation->rcfile = arg;
                 break;
+#if YASH_ENABLE_SOCKET
+            case NOI_SERVE:
+                assert(arg != NULL);
+                shell_invocation->serve = arg;
+                break;
+#endif
             case NOI_N:
                 assert(false);
         }
@@ -41,15 +41,16 @@ extern _Bool is_interactive, is_interactive_now;
 extern _Bool shopt_cmdline, shopt_stdin;
 extern _Bool do_job_control, shopt_notify, shopt_notifyle,
        shopt_curasync, shopt_curbg, shopt_curstop;
-extern _Bool shopt_allexport, shopt_hashondef, shopt_forlocal;
+extern _Bool shopt_allexport, shopt_hashondef, shopt_lastpipe,
+       shopt_lazyparse, shopt_forlocal;
 extern _Bool shopt_errexit, shopt_errreturn, shopt_pipefail, shopt_unset,
        shopt_exec, shopt_ignoreeof, shopt_verbose, shopt_xtrace;
-extern _Bool shopt_traceall;
+extern _Bool shopt_traceall, shopt_tracestamp;
 #if YASH_ENABLE_HISTORY
 extern _Bool shopt_histspace;
 #endif
 extern _Bool shopt_glob, shopt_caseglob, shopt_dotglob, shopt_markdirs,
-       shopt_extendedglob, shopt_nullglob;
+       shopt_extendedglob, shopt_nullglob, shopt_parallelglob;
 extern _Bool shopt_braceexpand;
 extern _Bool shopt_emptylastfield;
 extern _Bool shopt_clobber;
@@ -67,7 +68,7 @@ extern _Bool shopt_le_visiblebell, shopt_le_promptsp, shopt_le_alwaysrp,
 struct shell_invocation_T {
     _Bool help, version;
     _Bool noprofile, norcfile;
-    const wchar_t *profile, *rcfile;
+    const wchar_t *profile, *rcfile, *serve;
     _Bool is_interactive_set, do_job_control_set, lineedit_set;
 };
 
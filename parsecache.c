@@ -0,0 +1,1498 @@
+/* Yash: yet another shell */
+/* parsecache.c: cache of parse trees */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include "common.h"
+#include "parsecache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <wchar.h>
+#include "alias.h"
+#include "configm.h"
+#include "hashtable.h"
+#include "input.h"
+#include "option.h"
+#include "plist.h"
+#include "redir.h"
+#include "strbuf.h"
+#include "util.h"
+#include "variable.h"
+
+
+/* When the $YASH_PARSE_CACHE variable names a directory, the parse trees of
+ * script files executed by the dot built-in and the like are saved in the
+ * directory so that the next shell executing the same file can skip parsing.
+ *
+ * A script file is parsed and executed one unit at a time, where each unit is
+ * the result of one call to `read_and_parse'. Since the commands in a unit may
+ * define aliases or change the POSIXly-correct mode, which affect parsing of
+ * the following units, the cache records the state in which each unit was
+ * parsed. When the cache is replayed, each unit is used only if the current
+ * state is the same; otherwise, the shell goes back to normal parsing from the
+ * position of the unit in the script file and records a new cache.
+ *
+ * A cache file is named after the device and inode numbers of the script file
+ * and consists of a header and a sequence of records:
+ *   header:  magic, shell version, locale, script size, and mtime
+ *   unit:    REC_UNIT, offset, line number, alias fingerprint, flags,
+ *            payload length, and the encoded and/or lists
+ *   end:     REC_END, offset, line number, and whether the end of the script
+ *            was reached
+ * All numbers are encoded in a variable-length format where each byte holds
+ * seven bits. The offsets are byte positions in the script file, which must
+ * be at the beginning of a line since units always end with a newline. */
+
+#if YASH_ENABLE_DOUBLE_BRACKET
+# define CACHE_MAGIC "yash parse cache 4b\n"
+#else
+# define CACHE_MAGIC "yash parse cache 4\n"
+#endif
+
+enum { REC_END, REC_UNIT, };
+enum { UF_POSIX = 1 << 0, UF_ALIAS = 1 << 1, UF_LAZY = 1 << 2, };
+
+struct parsecache_T {
+    struct input_file_info_T *input;  /* input of the script file */
+    parseparam_T *info;               /* parse parameters (set when read) */
+    struct stat source;               /* status of the script file */
+    char *path;                       /* pathname of the cache file */
+    char *locale;                     /* locale in which units are parsed */
+    unsigned char *map;               /* mapped contents of the cache file */
+    size_t mapsize;                   /* size of `map' */
+    size_t bodystart;                 /* index of the first record in `map' */
+    size_t pos;                       /* index of the next record in `map' */
+    bool recording;                   /* appending new records? */
+    bool finished;                    /* the end record was determined? */
+    bool modified;                    /* any record was newly added? */
+    uintmax_t endoffset, endlineno;   /* contents of the end record */
+    bool endeof;
+    xstrbuf_T records;                /* records to be saved */
+};
+/* While `map' is non-NULL, commands are read from the cache file. After
+ * `map' is unmapped, commands are read from the script file and, if
+ * `recording' is true, appended to `records'. */
+
+/* state of decoding */
+typedef struct reader_T {
+    const unsigned char *p, *end;
+    bool error;
+    const char *filename;  /* name of the script file, which may be NULL */
+} reader_T;
+
+static void put_uint(xstrbuf_T *buf, uintmax_t n)
+    __attribute__((nonnull));
+static void put_str(xstrbuf_T *restrict buf, const char *restrict s)
+    __attribute__((nonnull));
+static void put_wcs(xstrbuf_T *restrict buf, const wchar_t *restrict s)
+    __attribute__((nonnull(1)));
+static void put_mbs(xstrbuf_T *restrict buf, const char *restrict s)
+    __attribute__((nonnull(1)));
+static void put_andors(xstrbuf_T *restrict buf, const and_or_T *restrict a)
+    __attribute__((nonnull(1)));
+static void put_pipelines(
+        xstrbuf_T *restrict buf, const pipeline_T *restrict p)
+    __attribute__((nonnull(1)));
+static void put_commands(xstrbuf_T *restrict buf, const command_T *restrict c)
+    __attribute__((nonnull(1)));
+static void put_ifcmds(xstrbuf_T *restrict buf, const ifcommand_T *restrict i)
+    __attribute__((nonnull(1)));
+static void put_caseitems(
+        xstrbuf_T *restrict buf, const caseitem_T *restrict i)
+    __attribute__((nonnull(1)));
+#if YASH_ENABLE_DOUBLE_BRACKET
+static void put_dbexp(xstrbuf_T *restrict buf, const dbexp_T *restrict e)
+    __attribute__((nonnull(1)));
+#endif
+static void put_word(xstrbuf_T *restrict buf, const wordunit_T *restrict w)
+    __attribute__((nonnull(1)));
+static void put_words(xstrbuf_T *restrict buf, void *const *restrict words)
+    __attribute__((nonnull(1)));
+static void put_paramexp(
+        xstrbuf_T *restrict buf, const paramexp_T *restrict p)
+    __attribute__((nonnull));
+static void put_embedcmd(xstrbuf_T *buf, embedcmd_T c)
+    __attribute__((nonnull));
+static void put_assigns(xstrbuf_T *restrict buf, const assign_T *restrict a)
+    __attribute__((nonnull(1)));
+static void put_redirs(xstrbuf_T *restrict buf, const redir_T *restrict r)
+    __attribute__((nonnull(1)));
+
+static uintmax_t get_uint(reader_T *r)
+    __attribute__((nonnull));
+static bool match_str(reader_T *restrict r, const char *restrict s)
+    __attribute__((nonnull));
+static wchar_t *get_wcs(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static char *get_mbs(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static and_or_T *get_andors(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static pipeline_T *get_pipelines(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static command_T *get_commands(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static ifcommand_T *get_ifcmds(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static caseitem_T *get_caseitems(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+#if YASH_ENABLE_DOUBLE_BRACKET
+static dbexp_T *get_dbexp(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+#endif
+static wordunit_T *get_word(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static void **get_words(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static paramexp_T *get_paramexp(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static embedcmd_T get_embedcmd(reader_T *r)
+    __attribute__((nonnull,warn_unused_result));
+static assign_T *get_assigns(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static redir_T *get_redirs(reader_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+
+static unsigned long mtime_nsec(const struct stat *st)
+    __attribute__((nonnull,pure));
+static void map_cache_file(parsecache_T *pc)
+    __attribute__((nonnull));
+static bool validate_cache(parsecache_T *pc)
+    __attribute__((nonnull));
+static void unmap_cache_file(parsecache_T *pc)
+    __attribute__((nonnull));
+static const char *current_locale(void);
+static unsigned current_flags(const parseparam_T *info)
+    __attribute__((nonnull));
+static uintmax_t current_fingerprint(const parseparam_T *info)
+    __attribute__((nonnull));
+static bool replay_record(parsecache_T *restrict pc,
+        parseparam_T *restrict info, and_or_T **restrict resultp,
+        parseresult_T *restrict resultresultp)
+    __attribute__((nonnull));
+static bool fall_back(parsecache_T *restrict pc, parseparam_T *restrict info,
+        uintmax_t offset, uintmax_t lineno, size_t recstart)
+    __attribute__((nonnull));
+static off_t current_offset(const parsecache_T *pc)
+    __attribute__((nonnull));
+static parseresult_T parse_and_record(parsecache_T *restrict pc,
+        parseparam_T *restrict info, and_or_T **restrict resultp)
+    __attribute__((nonnull,warn_unused_result));
+static void finish_recording(
+        parsecache_T *pc, uintmax_t offset, uintmax_t lineno, bool eof)
+    __attribute__((nonnull));
+static void write_cache_file(parsecache_T *pc)
+    __attribute__((nonnull));
+
+
+/********** Encoding **********/
+
+/* Appends an unsigned integer in the variable-length format. */
+void put_uint(xstrbuf_T *buf, uintmax_t n)
+{
+    while (n >= 0x80) {
+        sb_ccat(buf, (char) ((n & 0x7F) | 0x80));
+        n >>= 7;
+    }
+    sb_ccat(buf, (char) n);
+}
+
+/* Appends a multibyte string preceded by its length. */
+void put_str(xstrbuf_T *restrict buf, const char *restrict s)
+{
+    size_t len = strlen(s);
+    put_uint(buf, len);
+    sb_ncat_force(buf, s, len);
+}
+
+/* Appends a wide string, which may be NULL. */
+void put_wcs(xstrbuf_T *restrict buf, const wchar_t *restrict s)
+{
+    if (s == NULL) {
+        put_uint(buf, 0);
+        return;
+    }
+
+    size_t len = wcslen(s);
+    put_uint(buf, add(len, 1));
+    for (size_t i = 0; i < len; i++)
+        put_uint(buf, (uintmax_t) (wint_t) s[i]);
+}
+
+/* Appends a multibyte string, which may be NULL. */
+void put_mbs(xstrbuf_T *restrict buf, const char *restrict s)
+{
+    if (s == NULL) {
+        put_uint(buf, 0);
+        return;
+    }
+
+    size_t len = strlen(s);
+    put_uint(buf, add(len, 1));
+    sb_ncat_force(buf, s, len);
+}
+
+/* In the functions below, each element of a linked list is preceded by 1 and
+ * the list is terminated by 0. */
+
+void put_andors(xstrbuf_T *restrict buf, const and_or_T *restrict a)
+{
+    for (; a != NULL; a = a->next) {
+        put_uint(buf, 1);
+        put_uint(buf, a->ao_async);
+        put_pipelines(buf, a->ao_pipelines);
+    }
+    put_uint(buf, 0);
+}
+
+void put_pipelines(xstrbuf_T *restrict buf, const pipeline_T *restrict p)
+{
+    for (; p != NULL; p = p->next) {
+        put_uint(buf, 1);
+        put_uint(buf, p->pl_neg | p->pl_cond << 1 | p->pl_time << 2 |
+                p->pl_posixtime << 3);
+        put_commands(buf, p->pl_commands);
+    }
+    put_uint(buf, 0);
+}
+
+void put_commands(xstrbuf_T *restrict buf, const command_T *restrict c)
+{
+    for (; c != NULL; c = c->next) {
+        put_uint(buf, 1);
+        put_uint(buf, c->c_type);
+        put_uint(buf, c->c_lineno);
+        put_redirs(buf, c->c_redirs);
+        switch (c->c_type) {
+            case CT_SIMPLE:
+                put_assigns(buf, c->c_assigns);
+                put_words(buf, c->c_words);
+                break;
+            case CT_GROUP:
+            case CT_SUBSHELL:
+                put_andors(buf, c->c_subcmds);
+                break;
+            case CT_IF:
+                put_ifcmds(buf, c->c_ifcmds);
+                break;
+            case CT_FOR:
+                put_wcs(buf, c->c_forname);
+                put_words(buf, c->c_forwords);
+                put_andors(buf, c->c_forcmds);
+                break;
+            case CT_WHILE:
+                put_uint(buf, c->c_whltype);
+                put_andors(buf, c->c_whlcond);
+                put_andors(buf, c->c_whlcmds);
+                break;
+            case CT_CASE:
+                put_word(buf, c->c_casword);
+                put_caseitems(buf, c->c_casitems);
+                break;
+#if YASH_ENABLE_DOUBLE_BRACKET
+            case CT_BRACKET:
+                put_dbexp(buf, c->c_dbexp);
+                break;
+#endif /* YASH_ENABLE_DOUBLE_BRACKET */
+            case CT_FUNCDEF:
+                put_word(buf, c->c_funcname);
+                put_commands(buf, c->c_funcbody);
+                break;
+            case CT_LAZYGROUP:
+                put_wcs(buf, c->c_lazysrc);
+                break;
+        }
+    }
+    put_uint(buf, 0);
+}
+
+void put_ifcmds(xstrbuf_T *restrict buf, const ifcommand_T *restrict i)
+{
+    for (; i != NULL; i = i->next) {
+        put_uint(buf, 1);
+        put_andors(buf, i->ic_condition);
+        put_andors(buf, i->ic_commands);
+    }
+    put_uint(buf, 0);
+}
+
+void put_caseitems(xstrbuf_T *restrict buf, const caseitem_T *restrict i)
+{
+    for (; i != NULL; i = i->next) {
+        put_uint(buf, 1);
+        put_words(buf, i->ci_patterns);
+        put_andors(buf, i->ci_commands);
+    }
+    put_uint(buf, 0);
+}
+
+#if YASH_ENABLE_DOUBLE_BRACKET
+
+/* Appends a double-bracket expression, which is preceded by 0 if NULL or by
+ * its type plus one otherwise. */
+void put_dbexp(xstrbuf_T *restrict buf, const dbexp_T *restrict e)
+{
+    if (e == NULL) {
+        put_uint(buf, 0);
+        return;
+    }
+
+    put_uint(buf, (uintmax_t) e->type + 1);
+    put_wcs(buf, e->operator);
+    switch (e->type) {
+        case DBE_OR:
+        case DBE_AND:
+        case DBE_NOT:
+            put_dbexp(buf, e->lhs.subexp);
+            put_dbexp(buf, e->rhs.subexp);
+            break;
+        case DBE_UNARY:
+        case DBE_BINARY:
+        case DBE_STRING:
+            put_word(buf, e->lhs.word);
+            put_word(buf, e->rhs.word);
+            break;
+    }
+}
+
+#endif /* YASH_ENABLE_DOUBLE_BRACKET */
+
+void put_word(xstrbuf_T *restrict buf, const wordunit_T *restrict w)
+{
+    for (; w != NULL; w = w->next) {
+        put_uint(buf, 1);
+        put_uint(buf, w->wu_type);
+        switch (w->wu_type) {
+            case WT_STRING:
+                put_wcs(buf, w->wu_string);
+                break;
+            case WT_PARAM:
+                put_paramexp(buf, w->wu_param);
+                break;
+            case WT_CMDSUB:
+                put_embedcmd(buf, w->wu_cmdsub);
+                break;
+            case WT_ARITH:
+                put_word(buf, w->wu_arith);
+                break;
+        }
+    }
+    put_uint(buf, 0);
+}
+
+/* Appends a NULL-terminated array of words, which is preceded by 0 if the
+ * array itself is NULL or by 1 otherwise. */
+void put_words(xstrbuf_T *restrict buf, void *const *restrict words)
+{
+    if (words == NULL) {
+        put_uint(buf, 0);
+        return;
+    }
+
+    put_uint(buf, 1);
+    for (; *words != NULL; words++) {
+        put_uint(buf, 1);
+        put_word(buf, *words);
+    }
+    put_uint(buf, 0);
+}
+
+void put_paramexp(xstrbuf_T *restrict buf, const paramexp_T *restrict p)
+{
+    put_uint(buf, p->pe_type);
+    if (p->pe_type & PT_NEST)
+        put_word(buf, p->pe_nest);
+    else
+        put_wcs(buf, p->pe_name);
+    put_word(buf, p->pe_start);
+    put_word(buf, p->pe_end);
+    put_word(buf, p->pe_match);
+    put_word(buf, p->pe_subst);
+}
+
+void put_embedcmd(xstrbuf_T *buf, embedcmd_T c)
+{
+    put_uint(buf, c.is_preparsed);
+    if (c.is_preparsed)
+        put_andors(buf, c.value.preparsed);
+    else
+        put_wcs(buf, c.value.unparsed);
+}
+
+void put_assigns(xstrbuf_T *restrict buf, const assign_T *restrict a)
+{
+    for (; a != NULL; a = a->next) {
+        put_uint(buf, 1);
+        put_uint(buf, a->a_type);
+        put_uint(buf, a->a_append);
+        put_wcs(buf, a->a_name);
+        switch (a->a_type) {
+            case A_SCALAR:
+                put_word(buf, a->a_scalar);
+                break;
+            case A_ARRAY:
+                put_words(buf, a->a_array);
+                break;
+        }
+    }
+    put_uint(buf, 0);
+}
+
+void put_redirs(xstrbuf_T *restrict buf, const redir_T *restrict r)
+{
+    for (; r != NULL; r = r->next) {
+        put_uint(buf, 1);
+        put_uint(buf, r->rd_type);
+        put_uint(buf, (uintmax_t) r->rd_fd);
+        switch (r->rd_type) {
+            case RT_INPUT:  case RT_OUTPUT:  case RT_CLOBBER:  case RT_APPEND:
+            case RT_INOUT:  case RT_DUPIN:   case RT_DUPOUT:   case RT_PIPE:
+            case RT_HERESTR:
+                put_word(buf, r->rd_filename);
+                break;
+            case RT_HERE:  case RT_HERERT:
+                put_wcs(buf, r->rd_hereend);
+                put_word(buf, r->rd_herecontent);
+                put_mbs(buf, r->rd_heretext);
+                break;
+            case RT_PROCIN:  case RT_PROCOUT:
+                put_embedcmd(buf, r->rd_command);
+                break;
+        }
+    }
+    put_uint(buf, 0);
+}
+
+
+/********** Decoding **********/
+
+/* The decoding functions below never fail in the middle of building a parse
+ * tree: they set the `error' flag of the reader and return a tree (or NULL)
+ * that can be safely freed. The caller must discard the result if the flag is
+ * set. */
+
+/* Reads an unsigned integer in the variable-length format. */
+uintmax_t get_uint(reader_T *r)
+{
+    uintmax_t n = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+        if (r->p >= r->end || shift >= sizeof n * CHAR_BIT) {
+            r->error = true;
+            return 0;
+        }
+
+        unsigned char c = *r->p++;
+        n |= (uintmax_t) (c & 0x7F) << shift;
+        if (!(c & 0x80))
+            return n;
+    }
+}
+
+/* Reads a string preceded by its length and tests if it is equal to `s'. */
+bool match_str(reader_T *restrict r, const char *restrict s)
+{
+    uintmax_t len = get_uint(r);
+    if (r->error || len != strlen(s) || len > (uintmax_t) (r->end - r->p))
+        return false;
+
+    bool match = memcmp(r->p, s, len) == 0;
+    r->p += len;
+    return match;
+}
+
+/* Reads a newly-malloced wide string, which may be NULL. */
+wchar_t *get_wcs(reader_T *r)
+{
+    uintmax_t len = get_uint(r);
+    if (len == 0)
+        return NULL;
+    len--;
+    if (len > (uintmax_t) (r->end - r->p)) {
+        /* each character takes at least one byte */
+        r->error = true;
+        return NULL;
+    }
+
+    wchar_t *s = xmallocn(len + 1, sizeof *s);
+    for (size_t i = 0; i < len; i++) {
+        uintmax_t c = get_uint(r);
+        if (c > (uintmax_t) WCHAR_MAX || c == 0)
+            r->error = true;
+        s[i] = (wchar_t) c;
+    }
+    s[len] = L'\0';
+    return s;
+}
+
+/* Reads a newly-malloced multibyte string, which may be NULL. */
+char *get_mbs(reader_T *r)
+{
+    uintmax_t len = get_uint(r);
+    if (len == 0)
+        return NULL;
+    len--;
+    if (r->error || len > (uintmax_t) (r->end - r->p)
+            || memchr(r->p, '\0', len) != NULL) {
+        r->error = true;
+        return NULL;
+    }
+
+    char *s = xmalloc(add(len, 1));
+    memcpy(s, r->p, len);
+    s[len] = '\0';
+    r->p += len;
+    return s;
+}
+
+/* Reads the marker that precedes each element of a linked list.
+ * Returns true if an element follows. */
+static inline bool has_next(reader_T *r)
+{
+    return !r->error && get_uint(r) != 0;
+}
+
+and_or_T *get_andors(reader_T *r)
+{
+    and_or_T *first = NULL, **lastp = &first;
+    while (has_next(r)) {
+        and_or_T *a = xmalloc(sizeof *a);
+        a->next = NULL;
+        a->ao_async = get_uint(r) != 0;
+        a->ao_pipelines = get_pipelines(r);
+        if (a->ao_pipelines == NULL)
+            r->error = true;
+        *lastp = a, lastp = &a->next;
+    }
+    return first;
+}
+
+pipeline_T *get_pipelines(reader_T *r)
+{
+    pipeline_T *first = NULL, **lastp = &first;
+    while (has_next(r)) {
+        pipeline_T *p = xmalloc(sizeof *p);
+        uintmax_t flags = get_uint(r);
+        p->next = NULL;
+        p->pl_neg = flags & 1;
+        p->pl_cond = (flags >> 1) & 1;
+        p->pl_time = (flags >> 2) & 1;
+        p->pl_posixtime = (flags >> 3) & 1;
+        p->pl_commands = get_commands(r);
+        if (p->pl_commands == NULL)
+            r->error = true;
+        *lastp = p, lastp = &p->next;
+    }
+    return first;
+}
+
+command_T *get_commands(reader_T *r)
+{
+    command_T *first = NULL, **lastp = &first;
+    while (has_next(r)) {
+        command_T *c = xmalloc(sizeof *c);
+        uintmax_t type = get_uint(r);
+        c->next = NULL;
+        c->refcount = 1;
+        c->c_lineno = get_uint(r);
+        c->c_redirs = get_redirs(r);
+        switch (type) {
+            case CT_SIMPLE:
+                c->c_type = CT_SIMPLE;
+                c->c_cache.generation = 0;
+                c->c_assigns = get_assigns(r);
+                c->c_words = get_words(r);
+                if (c->c_words == NULL)
+                    r->error = true;
+                break;
+            case CT_GROUP:
+            case CT_SUBSHELL:
+                c->c_type = type;
+                c->c_subcmds = get_andors(r);
+                break;
+            case CT_IF:
+                c->c_type = CT_IF;
+                c->c_ifcmds = get_ifcmds(r);
+                break;
+            case CT_FOR:
+                c->c_type = CT_FOR;
+                c->c_forname = get_wcs(r);
+                c->c_forwords = get_words(r);
+                c->c_forcmds = get_andors(r);
+                if (c->c_forname == NULL)
+                    r->error = true;
+                break;
+            case CT_WHILE:
+                c->c_type = CT_WHILE;
+                c->c_whltype = get_uint(r) != 0;
+                c->c_whlcond = get_andors(r);
+                c->c_whlcmds = get_andors(r);
+                break;
+            case CT_CASE:
+                c->c_type = CT_CASE;
+                c->c_casword = get_word(r);
+                c->c_casitems = get_caseitems(r);
+                break;
+#if YASH_ENABLE_DOUBLE_BRACKET
+            case CT_BRACKET:
+                c->c_type = CT_BRACKET;
+                c->c_dbexp = get_dbexp(r);
+                if (c->c_dbexp == NULL)
+                    r->error = true;
+                break;
+#endif /* YASH_ENABLE_DOUBLE_BRACKET */
+            case CT_FUNCDEF:
+                c->c_type = CT_FUNCDEF;
+                c->c_funcname = get_word(r);
+                c->c_funcbody = get_commands(r);
+                if (c->c_funcbody == NULL)
+                    r->error = true;
+                break;
+            case CT_LAZYGROUP:
+                c->c_type = CT_LAZYGROUP;
+                c->c_lazysrc = get_wcs(r);
+                c->c_lazyfile = (r->filename != NULL) ?
+                    xstrdup(r->filename) : NULL;
+                if (c->c_lazysrc == NULL)
+                    r->error = true;
+                break;
+            default:
+                c->c_type = CT_GROUP;
+                c->c_subcmds = NULL;
+                r->error = true;
+                break;
+        }
+        *lastp = c, lastp = &c->next;
+    }
+    return first;
+}
+
+ifcommand_T *get_ifcmds(reader_T *r)
+{
+    ifcommand_T *first = NULL, **lastp = &first;
+    while (has_next(r)) {
+        ifcommand_T *i = xmalloc(sizeof *i);
+        i->next = NULL;
+        i->ic_condition = get_andors(r);
+        i->ic_commands = get_andors(r);
+        *lastp = i, lastp = &i->next;
+    }
+    return first;
+}
+
+caseitem_T *get_caseitems(reader_T *r)
+{
+    caseitem_T *first = NULL, **lastp = &first;
+    while (has_next(r)) {
+        caseitem_T *i = xmalloc(sizeof *i);
+        i->next = NULL;
+        i->ci_patterns = get_words(r);
+        i->ci_commands = get_andors(r);
+        if (i->ci_patterns == NULL)
+            r->error = true;
+        *lastp = i, lastp = &i->next;
+    }
+    return first;
+}
+
+#if YASH_ENABLE_DOUBLE_BRACKET
+
+dbexp_T *get_dbexp(reader_T *r)
+{
+    uintmax_t type = get_uint(r);
+    if (type == 0)
+        return NULL;
+
+    dbexp_T *e = xmalloc(sizeof *e);
+    e->operator = get_wcs(r);
+    switch (type - 1) {
+        case DBE_OR:
+        case DBE_AND:
+        case DBE_NOT:
+            e->type = type - 1;
+            e->lhs.subexp = get_dbexp(r);
+            e->rhs.subexp = get_dbexp(r);
+            break;
+        case DBE_UNARY:
+        case DBE_BINARY:
+        case DBE_STRING:
+            e->type = type - 1;
+            e->lhs.word = get_word(r);
+            e->rhs.word = get_word(r);
+            break;
+        default:
+            e->type = DBE_STRING;
+            e->lhs.word = e->rhs.word = NULL;
+            r->error = true;
+            break;
+    }
+    return e;
+}
+
+#endif /* YASH_ENABLE_DOUBLE_BRACKET */
+
+wordunit_T *get_word(reader_T *r)
+{
+    wordunit_T *first = NULL, **lastp = &first;
+    while (has_next(r)) {
+        wordunit_T *wu = xmalloc(sizeof *wu);
+        uintmax_t type = get_uint(r);
+        wu->next = NULL;
+        switch (type) {
+            case WT_STRING:
+                wu->wu_type = WT_STRING;
+                wu->wu_string = get_wcs(r);
+                if (wu->wu_string == NULL)
+                    r->error = true;
+                break;
+            case WT_PARAM:
+                wu->wu_type = WT_PARAM;
+                wu->wu_param = get_paramexp(r);
+                break;
+            case WT_CMDSUB:
+                wu->wu_type = WT_CMDSUB;
+                wu->wu_cmdsub = get_embedcmd(r);
+                break;
+            case WT_ARITH:
+                wu->wu_type = WT_ARITH;
+                wu->wu_arith = get_word(r);
+                break;
+            default:
+                wu->wu_type = WT_STRING;
+                wu->wu_string = NULL;
+                r->error = true;
+                break;
+        }
+        *lastp = wu, lastp = &wu->next;
+    }
+    return first;
+}
+
+void **get_words(reader_T *r)
+{
+    if (get_uint(r) == 0)
+        return NULL;
+
+    plist_T list;
+    pl_init(&list);
+    while (has_next(r)) {
+        wordunit_T *w = get_word(r);
+        if (w != NULL)
+            pl_add(&list, w);
+        else
+            r->error = true;
+    }
+    return pl_toary(&list);
+}
+
+paramexp_T *get_paramexp(reader_T *r)
+{
+    paramexp_T *p = xmalloc(sizeof *p);
+    uintmax_t type = get_uint(r);
+    if (type > (PT_MASK | PT_NUMBER | PT_COLON | PT_MATCHHEAD | PT_MATCHTAIL |
+                PT_MATCHLONGEST | PT_SUBSTALL | PT_NEST)) {
+        type = PT_NONE;
+        r->error = true;
+    }
+    p->pe_type = type;
+    if (p->pe_type & PT_NEST) {
+        p->pe_nest = get_word(r);
+    } else {
+        p->pe_name = get_wcs(r);
+        if (p->pe_name == NULL)
+            r->error = true;
+    }
+    p->pe_start = get_word(r);
+    p->pe_end = get_word(r);
+    p->pe_match = get_word(r);
+    p->pe_subst = get_word(r);
+    return p;
+}
+
+embedcmd_T get_embedcmd(reader_T *r)
+{
+    embedcmd_T c;
+    c.is_preparsed = get_uint(r) != 0;
+    if (c.is_preparsed) {
+        c.value.preparsed = get_andors(r);
+    } else {
+        c.value.unparsed = get_wcs(r);
+        if (c.value.unparsed == NULL)
+            r->error = true;
+    }
+    return c;
+}
+
+assign_T *get_assigns(reader_T *r)
+{
+    assign_T *first = NULL, **lastp = &first;
+    while (has_next(r)) {
+        assign_T *a = xmalloc(sizeof *a);
+        uintmax_t type = get_uint(r);
+        a->next = NULL;
+        a->a_append = get_uint(r) != 0;
+        a->a_name = get_wcs(r);
+        if (a->a_name == NULL)
+            r->error = true;
+        switch (type) {
+            case A_SCALAR:
+                a->a_type = A_SCALAR;
+                a->a_scalar = get_word(r);
+                break;
+            case A_ARRAY:
+                a->a_type = A_ARRAY;
+                a->a_array = get_words(r);
+                if (a->a_array == NULL)
+                    r->error = true;
+                break;
+            default:
+                a->a_type = A_SCALAR;
+                a->a_scalar = NULL;
+                r->error = true;
+                break;
+        }
+        *lastp = a, lastp = &a->next;
+    }
+    return first;
+}
+
+redir_T *get_redirs(reader_T *r)
+{
+    redir_T *first = NULL, **lastp = &first;
+    while (has_next(r)) {
+        redir_T *rd = xmalloc(sizeof *rd);
+        uintmax_t type = get_uint(r);
+        uintmax_t fd = get_uint(r);
+        rd->next = NULL;
+        rd->rd_fd = (fd <= INT_MAX) ? (int) fd : 0;
+        switch (type) {
+            case RT_INPUT:  case RT_OUTPUT:  case RT_CLOBBER:  case RT_APPEND:
+            case RT_INOUT:  case RT_DUPIN:   case RT_DUPOUT:   case RT_PIPE:
+            case RT_HERESTR:
+                rd->rd_type = type;
+                rd->rd_filename = get_word(r);
+                break;
+            case RT_HERE:  case RT_HERERT:
+                rd->rd_type = type;
+                rd->rd_hereend = get_wcs(r);
+                rd->rd_herecontent = get_word(r);
+                rd->rd_heretext = get_mbs(r);
+                if (rd->rd_hereend == NULL)
+                    r->error = true;
+                break;
+            case RT_PROCIN:  case RT_PROCOUT:
+                rd->rd_type = type;
+                rd->rd_command = get_embedcmd(r);
+                break;
+            default:
+                rd->rd_type = RT_INPUT;
+                rd->rd_filename = NULL;
+                r->error = true;
+                break;
+        }
+        if (fd > INT_MAX)
+            r->error = true;
+        *lastp = rd, lastp = &rd->next;
+    }
+    return first;
+}
+
+
+/********** Cache Files **********/
+
+/* Returns the nanosecond part of the modification time of a file. */
+unsigned long mtime_nsec(const struct stat *st)
+{
+#if HAVE_ST_MTIM
+    return (unsigned long) st->st_mtim.tv_nsec;
+#elif HAVE_ST_MTIMESPEC
+    return (unsigned long) st->st_mtimespec.tv_nsec;
+#elif HAVE_ST_MTIMENSEC
+    return (unsigned long) st->st_mtimensec;
+#elif HAVE___ST_MTIMENSEC
+    return (unsigned long) st->__st_mtimensec;
+#else
+    (void) st;
+    return 0;
+#endif
+}
+
+/* Creates a parse cache for the specified input, which must have just been
+ * opened. Returns NULL if the cache is disabled or the input is not a regular
+ * file. If a valid cache file exists, it is mapped into memory so that the
+ * commands are read from it. Otherwise, the commands parsed from the input will
+ * be recorded and saved in a new cache file. */
+parsecache_T *open_parse_cache(struct input_file_info_T *input)
+{
+    const wchar_t *dir = getvar(L VAR_YASH_PARSE_CACHE);
+    if (dir == NULL || dir[0] == L'\0')
+        return NULL;
+
+    struct stat st;
+    if (fstat(input->fd, &st) < 0 || !S_ISREG(st.st_mode))
+        return NULL;
+
+    char *mbsdir = malloc_wcstombs(dir);
+    if (mbsdir == NULL)
+        return NULL;
+
+    xstrbuf_T path;
+    sb_initwith(&path, mbsdir);
+    sb_printf(&path, "/%jx-%jx", (uintmax_t) st.st_dev, (uintmax_t) st.st_ino);
+
+    parsecache_T *pc = xmalloc(sizeof *pc);
+    pc->input = input;
+    pc->info = NULL;
+    pc->source = st;
+    pc->path = sb_tostr(&path);
+    pc->locale = xstrdup(current_locale());
+    pc->map = NULL;
+    pc->mapsize = pc->bodystart = pc->pos = 0;
+    pc->recording = false;
+    pc->finished = false;
+    pc->modified = false;
+    sb_init(&pc->records);
+
+    map_cache_file(pc);
+    if (pc->map == NULL)
+        pc->recording = true;
+    return pc;
+}
+
+/* Maps the cache file into memory if it is valid. */
+void map_cache_file(parsecache_T *pc)
+{
+    int fd = open(pc->path, O_RDONLY);
+    if (fd < 0)
+        return;
+
+    /* The cache file must not be writable by other users, since it contains
+     * commands to execute. */
+    struct stat st;
+    if (fstat(fd, &st) >= 0 && S_ISREG(st.st_mode) &&
+            st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH)) &&
+            st.st_size > 0 && (uintmax_t) st.st_size <= SIZE_MAX) {
+        void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+                fd, 0);
+        if (map != MAP_FAILED) {
+            pc->map = map;
+            pc->mapsize = (size_t) st.st_size;
+        }
+    }
+    xclose(fd);
+
+    if (pc->map != NULL && !validate_cache(pc))
+        unmap_cache_file(pc);
+}
+
+/* Checks the header of the mapped cache file and the structure of the records.
+ * Returns true iff the cache file can be used for the current input. */
+bool validate_cache(parsecache_T *pc)
+{
+    reader_T r = { .p = pc->map, .end = pc->map + pc->mapsize, .error = false };
+
+    size_t magiclen = strlen(CACHE_MAGIC);
+    if (pc->mapsize < magiclen || memcmp(r.p, CACHE_MAGIC, magiclen) != 0)
+        return false;
+    r.p += magiclen;
+
+    if (!match_str(&r, PACKAGE_VERSION) || !match_str(&r, pc->locale))
+        return false;
+    if (get_uint(&r) != (uintmax_t) pc->source.st_size ||
+            get_uint(&r) != (uintmax_t) pc->source.st_mtime ||
+            get_uint(&r) != mtime_nsec(&pc->source) || r.error)
+        return false;
+    pc->bodystart = pc->pos = r.p - pc->map;
+
+    for (;;) {
+        uintmax_t tag = get_uint(&r);
+        uintmax_t offset = get_uint(&r);
+        get_uint(&r); /* line number */
+        if (r.error || offset > (uintmax_t) pc->source.st_size)
+            return false;
+        if (tag == REC_END) {
+            get_uint(&r); /* end-of-file flag */
+            return !r.error && r.p == r.end;
+        }
+        if (tag != REC_UNIT)
+            return false;
+        get_uint(&r); /* fingerprint */
+        get_uint(&r); /* flags */
+        uintmax_t length = get_uint(&r);
+        if (r.error || length > (uintmax_t) (r.end - r.p))
+            return false;
+        r.p += length;
+    }
+}
+
+void unmap_cache_file(parsecache_T *pc)
+{
+    munmap(pc->map, pc->mapsize);
+    pc->map = NULL;
+}
+
+/* Returns the name of the current locale for the character type. */
+const char *current_locale(void)
+{
+    const char *locale = setlocale(LC_CTYPE, NULL);
+    return (locale != NULL) ? locale : "";
+}
+
+/* Returns the flags of the state that affects parsing. */
+unsigned current_flags(const parseparam_T *info)
+{
+    return (posixly_correct ? UF_POSIX : 0) |
+        (info->enable_alias ? UF_ALIAS : 0) |
+        (shopt_lazyparse && shopt_exec && !shopt_hashondef ? UF_LAZY : 0);
+}
+
+/* Returns the alias fingerprint that affects parsing. */
+uintmax_t current_fingerprint(const parseparam_T *info)
+{
+    return info->enable_alias ? get_alias_fingerprint() : 0;
+}
+
+/* Reads the next commands like `read_and_parse', but from the cache if
+ * possible. */
+parseresult_T read_and_parse_cached(
+        parsecache_T *restrict pc, parseparam_T *restrict info,
+        and_or_T **restrict resultp)
+{
+    pc->info = info;
+
+    if (pc->map != NULL) {
+        parseresult_T result = PR_INPUT_ERROR;
+        if (replay_record(pc, info, resultp, &result))
+            return result;
+        if (pc->map != NULL)
+            return PR_INPUT_ERROR;
+    }
+
+    return parse_and_record(pc, info, resultp);
+}
+
+/* Reads the next record in the cache.
+ * If the record can be used, the resultant commands and status are assigned
+ * to `*resultp' and `*resultresultp' and true is returned. Otherwise, the cache
+ * is unmapped so that the rest of the input is parsed normally and false is
+ * returned. If the input cannot be rewound, the cache is not unmapped. */
+bool replay_record(parsecache_T *restrict pc, parseparam_T *restrict info,
+        and_or_T **restrict resultp, parseresult_T *restrict resultresultp)
+{
+    /* The record structure has been checked in `validate_cache'. */
+    size_t recstart = pc->pos;
+    reader_T r = {
+        .p = pc->map + recstart, .end = pc->map + pc->mapsize, .error = false };
+    uintmax_t tag = get_uint(&r);
+    uintmax_t offset = get_uint(&r);
+    uintmax_t lineno = get_uint(&r);
+
+    if (tag == REC_END) {
+        if (get_uint(&r) == 0)
+            return fall_back(pc, info, offset, lineno, recstart);
+        info->lineno = lineno;
+        info->lastinputresult = INPUT_EOF;
+        *resultresultp = PR_EOF;
+        return true;
+    }
+
+    uintmax_t fingerprint = get_uint(&r);
+    uintmax_t flags = get_uint(&r);
+    size_t length = get_uint(&r);
+    if (fingerprint != current_fingerprint(info) ||
+            flags != current_flags(info) ||
+            (info->enable_verbose && shopt_verbose) ||
+            strcmp(current_locale(), pc->locale) != 0)
+        return fall_back(pc, info, offset, lineno, recstart);
+
+    reader_T payload = { .p = r.p, .end = r.p + length, .error = false,
+        .filename = info->filename };
+    and_or_T *commands = get_andors(&payload);
+    if (payload.error || payload.p != payload.end || commands == NULL) {
+        andorsfree(commands);
+        return fall_back(pc, info, offset, lineno, recstart);
+    }
+
+    /* The next record tells the line number after this unit. */
+    pc->pos = payload.end - pc->map;
+    r.p = payload.end;
+    get_uint(&r);  /* tag */
+    get_uint(&r);  /* offset */
+    info->lineno = get_uint(&r);
+    info->lastinputresult = INPUT_OK;
+    *resultp = commands;
+    *resultresultp = PR_OK;
+    return true;
+}
+
+/* Stops reading the cache and rewinds the input to the specified position so
+ * that the rest is parsed normally. The records before `recstart' are kept to
+ * be saved in the new cache file.
+ * Returns false. */
+bool fall_back(parsecache_T *restrict pc, parseparam_T *restrict info,
+        uintmax_t offset, uintmax_t lineno, size_t recstart)
+{
+    if (lseek(pc->input->fd, (off_t) offset, SEEK_SET) < 0)
+        return false;
+    pc->input->bufpos = pc->input->bufmax = 0;
+    memset(&pc->input->state, 0, sizeof pc->input->state);
+    info->lineno = lineno;
+
+    sb_ncat_force(&pc->records,
+            (const char *) pc->map + pc->bodystart, recstart - pc->bodystart);
+    unmap_cache_file(pc);
+    pc->recording = true;
+    return false;
+}
+
+/* Returns the position in the input file of the next character to be parsed,
+ * or a negative value on error. */
+off_t current_offset(const parsecache_T *pc)
+{
+    off_t offset = lseek(pc->input->fd, 0, SEEK_CUR);
+    if (offset < 0)
+        return offset;
+    return offset - (off_t) (pc->input->bufmax - pc->input->bufpos);
+}
+
+/* Calls `read_and_parse' and records the result if recording. */
+parseresult_T parse_and_record(parsecache_T *restrict pc,
+        parseparam_T *restrict info, and_or_T **restrict resultp)
+{
+    if (!pc->recording || pc->finished)
+        return read_and_parse(info, resultp);
+
+    off_t offset = current_offset(pc);
+    unsigned long lineno = info->lineno;
+    if (offset < 0) {
+        pc->recording = false;
+        return read_and_parse(info, resultp);
+    }
+    if (strcmp(current_locale(), pc->locale) != 0) {
+        /* The rest of the input is parsed in another locale, which cannot be
+         * recorded in the same cache file. */
+        finish_recording(pc, offset, lineno, false);
+        return read_and_parse(info, resultp);
+    }
+
+    unsigned flags = current_flags(info);
+    uintmax_t fingerprint = current_fingerprint(info);
+    parseresult_T result = read_and_parse(info, resultp);
+    switch (result) {
+        case PR_OK:
+            if (*resultp != NULL) {
+                xstrbuf_T payload;
+                sb_init(&payload);
+                put_andors(&payload, *resultp);
+
+                put_uint(&pc->records, REC_UNIT);
+                put_uint(&pc->records, (uintmax_t) offset);
+                put_uint(&pc->records, lineno);
+                put_uint(&pc->records, fingerprint);
+                put_uint(&pc->records, flags);
+                put_uint(&pc->records, payload.length);
+                sb_ncat_force(&pc->records, payload.contents, payload.length);
+                sb_destroy(&payload);
+                pc->modified = true;
+            }
+            break;
+        case PR_EOF:
+            finish_recording(pc, (uintmax_t) offset, lineno, true);
+            pc->modified = true;
+            break;
+        case PR_SYNTAX_ERROR:
+        case PR_INPUT_ERROR:
+            pc->recording = false;
+            break;
+    }
+    return result;
+}
+
+/* Determines the end record. No more records are added after this. */
+void finish_recording(
+        parsecache_T *pc, uintmax_t offset, uintmax_t lineno, bool eof)
+{
+    pc->finished = true;
+    pc->endoffset = offset;
+    pc->endlineno = lineno;
+    pc->endeof = eof;
+}
+
+/* Writes the cache file if new records have been added, and frees the parse
+ * cache. */
+void close_parse_cache(parsecache_T *pc)
+{
+    if (pc->recording && pc->modified) {
+        if (!pc->finished) {
+            off_t offset = current_offset(pc);
+            if (offset >= 0 && pc->info != NULL)
+                finish_recording(pc, (uintmax_t) offset, pc->info->lineno,
+                        false);
+        }
+        if (pc->finished)
+            write_cache_file(pc);
+    }
+
+    if (pc->map != NULL)
+        unmap_cache_file(pc);
+    sb_destroy(&pc->records);
+    free(pc->locale);
+    free(pc->path);
+    free(pc);
+}
+
+/* Writes the header and records to a temporary file and renames it to the
+ * cache file. Errors are silently ignored. */
+void write_cache_file(parsecache_T *pc)
+{
+    xstrbuf_T buf;
+    sb_init(&buf);
+    sb_cat(&buf, CACHE_MAGIC);
+    put_str(&buf, PACKAGE_VERSION);
+    put_str(&buf, pc->locale);
+    put_uint(&buf, (uintmax_t) pc->source.st_size);
+    put_uint(&buf, (uintmax_t) pc->source.st_mtime);
+    put_uint(&buf, mtime_nsec(&pc->source));
+    sb_ncat_force(&buf, pc->records.contents, pc->records.length);
+    put_uint(&buf, REC_END);
+    put_uint(&buf, pc->endoffset);
+    put_uint(&buf, pc->endlineno);
+    put_uint(&buf, pc->endeof);
+
+    xstrbuf_T tmppath;
+    sb_init(&tmppath);
+    sb_printf(&tmppath, "%s.%jd", pc->path, (intmax_t) getpid());
+
+    int fd = open(tmppath.contents, O_WRONLY | O_CREAT | O_EXCL,
+            S_IRUSR | S_IWUSR);
+    if (fd < 0 && errno == ENOENT) {
+        /* create the cache directory */
+        char *slash = strrchr(pc->path, '/');
+        *slash = '\0';
+        if (mkdir(pc->path, S_IRWXU) >= 0 || errno == EEXIST)
+            fd = open(tmppath.contents, O_WRONLY | O_CREAT | O_EXCL,
+                    S_IRUSR | S_IWUSR);
+        *slash = '/';
+    }
+    if (fd >= 0) {
+        bool ok = write_all(fd, buf.contents, buf.length);
+        if (close(fd) < 0)
+            ok = false;
+        if (!ok || rename(tmppath.contents, pc->path) < 0)
+            unlink(tmppath.contents);
+    }
+
+    sb_destroy(&tmppath);
+    sb_destroy(&buf);
+}
+
+
+/********** Cache of Parsed Command Strings **********/
+
+/* Command strings executed by `exec_wcs', such as trap actions, the operands
+ * of the eval built-in, and the values of $PROMPT_COMMAND, are often executed
+ * repeatedly. To avoid parsing the same string again and again, the parse
+ * trees of such strings are kept in a hashtable keyed by the string.
+ *
+ * Only strings that are parsed in one call to `read_and_parse' are cached.
+ * That is because the commands in a unit are parsed before any of them is
+ * executed, whereas a later unit may be affected by aliases defined in an
+ * earlier unit. An entry is stale and discarded when the current alias
+ * fingerprint or flags differ from those at the time of parsing.
+ *
+ * The number of entries and the length of cached strings are limited. When the
+ * hashtable is full, all entries are discarded at once. An entry is reference-
+ * counted so that it survives being discarded while its commands are being
+ * executed. */
+
+#define STRCACHE_MAX_COUNT  64
+#define STRCACHE_MAX_LENGTH 4096
+
+/* hashtable mapping command strings to `cachedcmds_T' */
+static hashtable_T strcache;
+
+static bool is_reusable(const cachedcmds_T *restrict cc,
+        const char *restrict name, unsigned flags, uintmax_t fingerprint)
+    __attribute__((nonnull(1),pure));
+static cachedcmds_T *parse_and_cache(
+        const wchar_t *restrict code, const char *restrict name)
+    __attribute__((nonnull(1),malloc,warn_unused_result));
+static bool rest_is_empty(parseparam_T *info)
+    __attribute__((nonnull));
+static void vreleasecc(kvpair_T kv);
+
+/* Returns the parsed commands of the specified command string or NULL if the
+ * string cannot be cached. If a non-NULL pointer is returned, the caller must
+ * release it by `release_cached_commands' after executing the commands.
+ * NULL is returned if the string has a syntax error or contains more than one
+ * unit, in which case the caller should parse it in the usual way. */
+cachedcmds_T *parse_wcs_cached(
+        const wchar_t *restrict code, const char *restrict name)
+{
+    if (xwcsnlen(code, STRCACHE_MAX_LENGTH + 1) > STRCACHE_MAX_LENGTH)
+        return NULL;
+
+    if (strcache.capacity == 0)
+        ht_init(&strcache, hashwcs, htwcscmp);
+
+    parseparam_T info = { .enable_alias = true, };
+    cachedcmds_T *cc = ht_get(&strcache, code).value;
+    if (cc != NULL) {
+        if (is_reusable(cc, name, current_flags(&info),
+                    current_fingerprint(&info))) {
+            refcount_increment(&cc->refcount);
+            return cc;
+        }
+        ht_remove(&strcache, code);
+        release_cached_commands(cc);
+    }
+
+    cc = parse_and_cache(code, name);
+    if (cc == NULL)
+        return NULL;
+
+    if (strcache.count >= STRCACHE_MAX_COUNT)
+        ht_clear(&strcache, vreleasecc);
+    refcount_increment(&cc->refcount);
+    ht_set(&strcache, cc->code, cc);
+    return cc;
+}
+
+/* Tests if the cached commands can be used in the current state. */
+bool is_reusable(const cachedcmds_T *restrict cc,
+        const char *restrict name, unsigned flags, uintmax_t fingerprint)
+{
+    if (cc->flags != flags || cc->fingerprint != fingerprint)
+        return false;
+    if (cc->name == NULL || name == NULL)
+        return cc->name == name;
+    return strcmp(cc->name, name) == 0;
+}
+
+/* Parses the specified command string and returns a new entry, whose reference
+ * count is one. Returns NULL if the string has a syntax error or does not
+ * consist of exactly one unit of commands. No error message is printed. */
+cachedcmds_T *parse_and_cache(
+        const wchar_t *restrict code, const char *restrict name)
+{
+    struct input_wcs_info_T iinfo = {
+        .src = code,
+    };
+    parseparam_T info = {
+        .print_errmsg = false,
+        .enable_verbose = false,
+        .enable_alias = true,
+        .filename = name,
+        .lineno = 1,
+        .input = input_wcs,
+        .inputinfo = &iinfo,
+        .interactive = false,
+        .arena = NULL,
+    };
+    unsigned flags = current_flags(&info);
+    uintmax_t fingerprint = current_fingerprint(&info);
+
+    and_or_T *commands;
+    if (read_and_parse(&info, &commands) != PR_OK)
+        return NULL;
+    if (commands == NULL)
+        return NULL;
+    bool eof = (info.lastinputresult == INPUT_EOF);
+
+    if (!rest_is_empty(&info)) {
+        andorsfree(commands);
+        return NULL;
+    }
+
+    cachedcmds_T *cc = xmalloc(sizeof *cc);
+    cc->refcount = 1;
+    cc->commands = commands;
+    cc->eof = eof;
+    cc->code = xwcsdup(code);
+    cc->name = (name == NULL) ? NULL : xstrdup(name);
+    cc->flags = flags;
+    cc->fingerprint = fingerprint;
+    return cc;
+}
+
+/* Tests if the rest of the input contains no commands. */
+bool rest_is_empty(parseparam_T *info)
+{
+    for (;;) {
+        and_or_T *rest;
+        switch (read_and_parse(info, &rest)) {
+            case PR_OK:
+                if (rest == NULL)
+                    continue;
+                andorsfree(rest);
+                return false;
+            case PR_EOF:
+                return true;
+            case PR_SYNTAX_ERROR:
+            case PR_INPUT_ERROR:
+                return false;
+        }
+    }
+}
+
+/* Decreases the reference count of the entry and frees it if the count
+ * becomes zero. */
+void release_cached_commands(cachedcmds_T *cc)
+{
+    if (!refcount_decrement(&cc->refcount))
+        return;
+    andorsfree(cc->commands);
+    free(cc->code);
+    free(cc->name);
+    free(cc);
+}
+
+void vreleasecc(kvpair_T kv)
+{
+    release_cached_commands(kv.value);
+}
+
+/* Computes the memory used for the cache of parsed command strings. The number
+ * of cached strings is assigned to `*countp' and the number of bytes allocated
+ * for the entries and the strings to `*bytesp'. The parse trees are not
+ * counted. */
+void parse_cache_memory_usage(size_t *countp, size_t *bytesp)
+{
+    size_t bytes = ht_memory_size(&strcache);
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&strcache, &i)).key != NULL) {
+        const cachedcmds_T *cc = kv.value;
+        bytes += sizeof *cc + (wcslen(cc->code) + 1) * sizeof *cc->code;
+        if (cc->name != NULL)
+            bytes += strlen(cc->name) + 1;
+    }
+    *countp = strcache.count;
+    *bytesp = bytes;
+}
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
@@ -0,0 +1,61 @@
+/* Yash: yet another shell */
+/* parsecache.h: cache of parse trees */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef YASH_PARSECACHE_H
+#define YASH_PARSECACHE_H
+
+#include <stdint.h>
+#include "parser.h"
+
+
+struct input_file_info_T;
+typedef struct parsecache_T parsecache_T;
+
+extern parsecache_T *open_parse_cache(struct input_file_info_T *input)
+    __attribute__((nonnull));
+extern parseresult_T read_and_parse_cached(
+        parsecache_T *restrict cache, parseparam_T *restrict info,
+        and_or_T **restrict resultp)
+    __attribute__((nonnull,warn_unused_result));
+extern void close_parse_cache(parsecache_T *cache)
+    __attribute__((nonnull));
+
+/* parsed commands shared through the command string cache */
+typedef struct cachedcmds_T {
+    refcount_T refcount;
+    and_or_T *commands;   /* parsed commands (non-NULL) */
+    _Bool eof;            /* the parser reached the end of the string? */
+    wchar_t *code;        /* the parsed command string */
+    char *name;           /* name used in error messages, which may be NULL */
+    unsigned flags;       /* state in which the string was parsed */
+    uintmax_t fingerprint;
+} cachedcmds_T;
+
+extern cachedcmds_T *parse_wcs_cached(
+        const wchar_t *restrict code, const char *restrict name)
+    __attribute__((nonnull(1),warn_unused_result));
+extern void release_cached_commands(cachedcmds_T *cc)
+    __attribute__((nonnull));
+extern void parse_cache_memory_usage(size_t *countp, size_t *bytesp)
+    __attribute__((nonnull));
+
+
+#endif /* YASH_PARSECACHE_H */
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
@@ -34,6 +34,7 @@
 #include <wchar.h>
 #include <wctype.h>
 #include "alias.h"
+#include "arena.h"
 #include "expand.h"
 #include "input.h"
 #include "option.h"
@@ -126,6 +127,10 @@ void comsfree(command_T *c)
                 wordfree(c->c_funcname);
                 comsfree(c->c_funcbody);
                 break;
+            case CT_LAZYGROUP:
+                free(c->c_lazysrc);
+                free(c->c_lazyfile);
+                break;
         }
 
         command_T *next = c->next;
@@ -262,6 +267,7 @@ void redirsfree(redir_T *r)
             case RT_HERE:  case RT_HERERT:
                 free(r->rd_hereend);
                 wordfree(r->rd_herecontent);
+                free(r->rd_heretext);
                 break;
             case RT_PROCIN:  case RT_PROCOUT:
                 embedcmdfree(r->rd_command);
@@ -283,6 +289,299 @@ void embedcmdfree(embedcmd_T c)
 }
 
 
+/********** Functions That Copy Parse Trees **********/
+
+/* These functions make a deep copy of a parse tree allocated in an arena so
+ * that the copy can outlive the arena. Function bodies in the tree are shared
+ * rather than copied since they are never allocated in an arena. */
+
+static and_or_T *andorscopy(const and_or_T *a)
+    __attribute__((malloc,warn_unused_result));
+static pipeline_T *pipescopy(const pipeline_T *p)
+    __attribute__((malloc,warn_unused_result));
+static command_T *comscopy(const command_T *c)
+    __attribute__((malloc,warn_unused_result));
+static ifcommand_T *ifcmdscopy(const ifcommand_T *i)
+    __attribute__((malloc,warn_unused_result));
+static caseitem_T *caseitemscopy(const caseitem_T *i)
+    __attribute__((malloc,warn_unused_result));
+#if YASH_ENABLE_DOUBLE_BRACKET
+static dbexp_T *dbexpcopy(const dbexp_T *e)
+    __attribute__((malloc,warn_unused_result));
+#endif
+static wordunit_T *wordcopy(const wordunit_T *w)
+    __attribute__((malloc,warn_unused_result));
+static void *wordcopy_vp(const void *w)
+    __attribute__((malloc,warn_unused_result));
+static void **wordscopy(void *const *words)
+    __attribute__((malloc,warn_unused_result));
+static paramexp_T *paramcopy(const paramexp_T *p)
+    __attribute__((malloc,warn_unused_result));
+static assign_T *assignscopy(const assign_T *a)
+    __attribute__((malloc,warn_unused_result));
+static redir_T *redirscopy(const redir_T *r)
+    __attribute__((malloc,warn_unused_result));
+static embedcmd_T embedcmdcopy(embedcmd_T c)
+    __attribute__((warn_unused_result));
+static wchar_t *wcscopy(const wchar_t *s)
+    __attribute__((malloc,warn_unused_result));
+
+and_or_T *andorscopy(const and_or_T *a)
+{
+    and_or_T *first = NULL, **lastp = &first;
+    for (; a != NULL; a = a->next) {
+        and_or_T *copy = xmalloc(sizeof *copy);
+        copy->next = NULL;
+        copy->ao_pipelines = pipescopy(a->ao_pipelines);
+        copy->ao_async = a->ao_async;
+        *lastp = copy, lastp = &copy->next;
+    }
+    return first;
+}
+
+pipeline_T *pipescopy(const pipeline_T *p)
+{
+    pipeline_T *first = NULL, **lastp = &first;
+    for (; p != NULL; p = p->next) {
+        pipeline_T *copy = xmalloc(sizeof *copy);
+        *copy = *p;
+        copy->next = NULL;
+        copy->pl_commands = comscopy(p->pl_commands);
+        *lastp = copy, lastp = &copy->next;
+    }
+    return first;
+}
+
+command_T *comscopy(const command_T *c)
+{
+    command_T *first = NULL, **lastp = &first;
+    for (; c != NULL; c = c->next) {
+        command_T *copy = xmalloc(sizeof *copy);
+        *copy = *c;
+        copy->next = NULL;
+        copy->refcount = 1;
+        copy->c_redirs = redirscopy(c->c_redirs);
+        switch (c->c_type) {
+            case CT_SIMPLE:
+                copy->c_assigns = assignscopy(c->c_assigns);
+                copy->c_words = wordscopy(c->c_words);
+                break;
+            case CT_GROUP:
+            case CT_SUBSHELL:
+                copy->c_subcmds = andorscopy(c->c_subcmds);
+                break;
+            case CT_IF:
+                copy->c_ifcmds = ifcmdscopy(c->c_ifcmds);
+                break;
+            case CT_FOR:
+                copy->c_forname = wcscopy(c->c_forname);
+                copy->c_forwords = wordscopy(c->c_forwords);
+                copy->c_forcmds = andorscopy(c->c_forcmds);
+                break;
+            case CT_WHILE:
+                copy->c_whlcond = andorscopy(c->c_whlcond);
+                copy->c_whlcmds = andorscopy(c->c_whlcmds);
+                break;
+            case CT_CASE:
+                copy->c_casword = wordcopy(c->c_casword);
+                copy->c_casitems = caseitemscopy(c->c_casitems);
+                break;
+#if YASH_ENABLE_DOUBLE_BRACKET
+            case CT_BRACKET:
+                copy->c_dbexp = dbexpcopy(c->c_dbexp);
+                break;
+#endif /* YASH_ENABLE_DOUBLE_BRACKET */
+            case CT_FUNCDEF:
+                copy->c_funcname = wordcopy(c->c_funcname);
+                if (c->c_funcbody != NULL)
+                    copy->c_funcbody = comsdup(c->c_funcbody);
+                break;
+            case CT_LAZYGROUP:
+                copy->c_lazysrc = xwcsdup(c->c_lazysrc);
+                copy->c_lazyfile =
+                    (c->c_lazyfile != NULL) ? xstrdup(c->c_lazyfile) : NULL;
+                break;
+        }
+        *lastp = copy, lastp = &copy->next;
+    }
+    return first;
+}
+
+ifcommand_T *ifcmdscopy(const ifcommand_T *i)
+{
+    ifcommand_T *first = NULL, **lastp = &first;
+    for (; i != NULL; i = i->next) {
+        ifcommand_T *copy = xmalloc(sizeof *copy);
+        copy->next = NULL;
+        copy->ic_condition = andorscopy(i->ic_condition);
+        copy->ic_commands = andorscopy(i->ic_commands);
+        *lastp = copy, lastp = &copy->next;
+    }
+    return first;
+}
+
+caseitem_T *caseitemscopy(const caseitem_T *i)
+{
+    caseitem_T *first = NULL, **lastp = &first;
+    for (; i != NULL; i = i->next) {
+        caseitem_T *copy = xmalloc(sizeof *copy);
+        copy->next = NULL;
+        copy->ci_patterns = wordscopy(i->ci_patterns);
+        copy->ci_commands = andorscopy(i->ci_commands);
+        *lastp = copy, lastp = &copy->next;
+    }
+    return first;
+}
+
+#if YASH_ENABLE_DOUBLE_BRACKET
+dbexp_T *dbexpcopy(const dbexp_T *e)
+{
+    if (e == NULL)
+        return NULL;
+
+    dbexp_T *copy = xmalloc(sizeof *copy);
+    copy->type = e->type;
+    copy->operator = wcscopy(e->operator);
+    switch (e->type) {
+        case DBE_OR:
+        case DBE_AND:
+        case DBE_NOT:
+            copy->lhs.subexp = dbexpcopy(e->lhs.subexp);
+            copy->rhs.subexp = dbexpcopy(e->rhs.subexp);
+            break;
+        case DBE_UNARY:
+        case DBE_BINARY:
+        case DBE_STRING:
+            copy->lhs.word = wordcopy(e->lhs.word);
+            copy->rhs.word = wordcopy(e->rhs.word);
+            break;
+    }
+    return copy;
+}
+#endif /* YASH_ENABLE_DOUBLE_BRACKET */
+
+wordunit_T *wordcopy(const wordunit_T *w)
+{
+    wordunit_T *first = NULL, **lastp = &first;
+    for (; w != NULL; w = w->next) {
+        wordunit_T *copy = xmalloc(sizeof *copy);
+        copy->next = NULL;
+        copy->wu_type = w->wu_type;
+        switch (w->wu_type) {
+            case WT_STRING:
+                copy->wu_string = wcscopy(w->wu_string);
+                break;
+            case WT_PARAM:
+                copy->wu_param = paramcopy(w->wu_param);
+                break;
+            case WT_CMDSUB:
+                copy->wu_cmdsub = embedcmdcopy(w->wu_cmdsub);
+                break;
+            case WT_ARITH:
+                copy->wu_arith = wordcopy(w->wu_arith);
+                break;
+        }
+        *lastp = copy, lastp = &copy->next;
+    }
+    return first;
+}
+
+void *wordcopy_vp(const void *w)
+{
+    return wordcopy(w);
+}
+
+void **wordscopy(void *const *words)
+{
+    return (words != NULL) ? pldup(words, wordcopy_vp) : NULL;
+}
+
+paramexp_T *paramcopy(const paramexp_T *p)
+{
+    if (p == NULL)
+        return NULL;
+
+    paramexp_T *copy = xmalloc(sizeof *copy);
+    copy->pe_type = p->pe_type;
+    if (p->pe_type & PT_NEST)
+        copy->pe_nest = wordcopy(p->pe_nest);
+    else
+        copy->pe_name = wcscopy(p->pe_name);
+    copy->pe_start = wordcopy(p->pe_start);
+    copy->pe_end = wordcopy(p->pe_end);
+    copy->pe_match = wordcopy(p->pe_match);
+    copy->pe_subst = wordcopy(p->pe_subst);
+    return copy;
+}
+
+assign_T *assignscopy(const assign_T *a)
+{
+    assign_T *first = NULL, **lastp = &first;
+    for (; a != NULL; a = a->next) {
+        assign_T *copy = xmalloc(sizeof *copy);
+        copy->next = NULL;
+        copy->a_type = a->a_type;
+        copy->a_append = a->a_append;
+        copy->a_name = wcscopy(a->a_name);
+        switch (a->a_type) {
+            case A_SCALAR:
+                copy->a_scalar = wordcopy(a->a_scalar);
+                break;
+            case A_ARRAY:
+                copy->a_array = wordscopy(a->a_array);
+                break;
+        }
+        *lastp = copy, lastp = &copy->next;
+    }
+    return first;
+}
+
+redir_T *redirscopy(const redir_T *r)
+{
+    redir_T *first = NULL, **lastp = &first;
+    for (; r != NULL; r = r->next) {
+        redir_T *copy = xmalloc(sizeof *copy);
+        copy->next = NULL;
+        copy->rd_type = r->rd_type;
+        copy->rd_fd = r->rd_fd;
+        switch (r->rd_type) {
+            case RT_INPUT:  case RT_OUTPUT:  case RT_CLOBBER:  case RT_APPEND:
+            case RT_INOUT:  case RT_DUPIN:   case RT_DUPOUT:   case RT_PIPE:
+            case RT_HERESTR:
+                copy->rd_filename = wordcopy(r->rd_filename);
+                break;
+            case RT_HERE:  case RT_HERERT:
+                copy->rd_hereend = wcscopy(r->rd_hereend);
+                copy->rd_herecontent = wordcopy(r->rd_herecontent);
+                copy->rd_heretext = (r->rd_heretext != NULL)
+                    ? xstrdup(r->rd_heretext) : NULL;
+                break;
+            case RT_PROCIN:  case RT_PROCOUT:
+                copy->rd_command = embedcmdcopy(r->rd_command);
+                break;
+        }
+        *lastp = copy, lastp = &copy->next;
+    }
+    return first;
+}
+
+embedcmd_T embedcmdcopy(embedcmd_T c)
+{
+    embedcmd_T copy;
+    copy.is_preparsed = c.is_preparsed;
+    if (c.is_preparsed)
+        copy.value.preparsed = andorscopy(c.value.preparsed);
+    else
+        copy.value.unparsed = wcscopy(c.value.unparsed);
+    return copy;
+}
+
+wchar_t *wcscopy(const wchar_t *s)
+{
+    return (s != NULL) ? xwcsdup(s) : NULL;
+}
+
+
 /********** Auxiliary Functions for Parser **********/
 
 typedef enum tokentype_T {
@@ -300,12 +599,51 @@ typedef enum tokentype_T {
     /* reserved words */
     TT_IF, TT_THEN, TT_ELSE, TT_ELIF, TT_FI, TT_DO, TT_DONE, TT_CASE, TT_ESAC,
     TT_WHILE, TT_UNTIL, TT_FOR, TT_LBRACE, TT_RBRACE, TT_BANG, TT_IN,
-    TT_FUNCTION,
+    TT_FUNCTION, TT_TIME,
 #if YASH_ENABLE_DOUBLE_BRACKET
     TT_DOUBLE_LBRACKET,
 #endif
 } tokentype_T;
 
+/* Classes of ASCII characters used in the tokenizer */
+#define CHARCLASS_ASCII_SIZE 128
+enum {
+    CC_BLANK     = 1 << 0, /* blank that delimits tokens */
+    CC_DELIMITER = 1 << 1, /* other character that delimits tokens */
+    CC_NAME      = 1 << 2, /* character that can be used in a portable name */
+    CC_SPECIAL   = 1 << 3, /* character that `parse_word' must examine */
+};
+static const unsigned char char_classes[CHARCLASS_ASCII_SIZE] = {
+    [L'\0'] = CC_DELIMITER | CC_SPECIAL,  [L'\n'] = CC_DELIMITER | CC_SPECIAL,
+    [L'\t'] = CC_BLANK,  [L' '] = CC_BLANK,
+    [L';'] = CC_DELIMITER,  [L'&'] = CC_DELIMITER,  [L'|'] = CC_DELIMITER,
+    [L'<'] = CC_DELIMITER,  [L'>'] = CC_DELIMITER,
+    [L'('] = CC_DELIMITER,  [L')'] = CC_DELIMITER,
+    [L'\\'] = CC_SPECIAL,  [L'$'] = CC_SPECIAL,  [L'`'] = CC_SPECIAL,
+    [L'\''] = CC_SPECIAL,  [L'"'] = CC_SPECIAL,
+    [L'0'] = CC_NAME,  [L'1'] = CC_NAME,  [L'2'] = CC_NAME,  [L'3'] = CC_NAME,
+    [L'4'] = CC_NAME,  [L'5'] = CC_NAME,  [L'6'] = CC_NAME,  [L'7'] = CC_NAME,
+    [L'8'] = CC_NAME,  [L'9'] = CC_NAME,
+    [L'a'] = CC_NAME,  [L'b'] = CC_NAME,  [L'c'] = CC_NAME,  [L'd'] = CC_NAME,
+    [L'e'] = CC_NAME,  [L'f'] = CC_NAME,  [L'g'] = CC_NAME,  [L'h'] = CC_NAME,
+    [L'i'] = CC_NAME,  [L'j'] = CC_NAME,  [L'k'] = CC_NAME,  [L'l'] = CC_NAME,
+    [L'm'] = CC_NAME,  [L'n'] = CC_NAME,  [L'o'] = CC_NAME,  [L'p'] = CC_NAME,
+    [L'q'] = CC_NAME,  [L'r'] = CC_NAME,  [L's'] = CC_NAME,  [L't'] = CC_NAME,
+    [L'u'] = CC_NAME,  [L'v'] = CC_NAME,  [L'w'] = CC_NAME,  [L'x'] = CC_NAME,
+    [L'y'] = CC_NAME,  [L'z'] = CC_NAME,
+    [L'A'] = CC_NAME,  [L'B'] = CC_NAME,  [L'C'] = CC_NAME,  [L'D'] = CC_NAME,
+    [L'E'] = CC_NAME,  [L'F'] = CC_NAME,  [L'G'] = CC_NAME,  [L'H'] = CC_NAME,
+    [L'I'] = CC_NAME,  [L'J'] = CC_NAME,  [L'K'] = CC_NAME,  [L'L'] = CC_NAME,
+    [L'M'] = CC_NAME,  [L'N'] = CC_NAME,  [L'O'] = CC_NAME,  [L'P'] = CC_NAME,
+    [L'Q'] = CC_NAME,  [L'R'] = CC_NAME,  [L'S'] = CC_NAME,  [L'T'] = CC_NAME,
+    [L'U'] = CC_NAME,  [L'V'] = CC_NAME,  [L'W'] = CC_NAME,  [L'X'] = CC_NAME,
+    [L'Y'] = CC_NAME,  [L'Z'] = CC_NAME,  [L'_'] = CC_NAME,
+};
+static inline bool is_ascii(wchar_t c)
+    __attribute__((const));
+static inline bool is_blank_char(wchar_t c)
+    __attribute__((const));
+
 static wchar_t *skip_name(const wchar_t *s, bool predicate(wchar_t))
     __attribute__((pure,nonnull));
 static bool is_name_by_predicate(const wchar_t *s, bool predicate(wchar_t))
@@ -326,34 +664,35 @@ static bool is_closing_tokentype(tokentype_T tt)
     __attribute__((const));
 
 
+/* Checks if the specified character is in the ASCII range, in which case
+ * `char_classes' can be used to classify it. */
+bool is_ascii(wchar_t c)
+{
+    return (unsigned long) c < CHARCLASS_ASCII_SIZE;
+}
+
+/* Checks if the specified character is a blank that delimits tokens. */
+bool is_blank_char(wchar_t c)
+{
+    if (is_ascii(c))
+        return char_classes[c] & CC_BLANK;
+    return iswblank(c);
+}
+
 /* Checks if the specified character can be used in a portable variable name.
  * Returns true for a digit. */
 bool is_portable_name_char(wchar_t c)
 {
-    switch (c) {
-        case L'0':  case L'1':  case L'2':  case L'3':  case L'4':
-        case L'5':  case L'6':  case L'7':  case L'8':  case L'9':
-        case L'a':  case L'b':  case L'c':  case L'd':  case L'e':  case L'f':
-        case L'g':  case L'h':  case L'i':  case L'j':  case L'k':  case L'l':
-        case L'm':  case L'n':  case L'o':  case L'p':  case L'q':  case L'r':
-        case L's':  case L't':  case L'u':  case L'v':  case L'w':  case L'x':
-        case L'y':  case L'z':
-        case L'A':  case L'B':  case L'C':  case L'D':  case L'E':  case L'F':
-        case L'G':  case L'H':  case L'I':  case L'J':  case L'K':  case L'L':
-        case L'M':  case L'N':  case L'O':  case L'P':  case L'Q':  case L'R':
-        case L'S':  case L'T':  case L'U':  case L'V':  case L'W':  case L'X':
-        case L'Y':  case L'Z':  case L'_':
-            return true;
-        default:
-            return false;
-    }
+    return is_ascii(c) && (char_classes[c] & CC_NAME);
 }
 
 /* Checks if the specified character can be used in a variable name.
  * Returns true for a digit. */
 bool is_name_char(wchar_t c)
 {
-    return c == L'_' || iswalnum(c);
+    if (is_ascii(c))
+        return char_classes[c] & CC_NAME;
+    return iswalnum(c);
 }
 
 /* Skips an identifier at the head of the specified string and returns a
@@ -392,8 +731,9 @@ bool is_name(const wchar_t *s)
 tokentype_T identify_reserved_word_string(const wchar_t *s)
 {
     /* List of keywords:
-     *    case do done elif else esac fi for function if in then until while
-     *    { } [[ !
+     *    case do done elif else esac fi for function if in then time until
+     *    while { } [[ !
+     * The "time" keyword is not recognized in the POSIXly-correct mode.
      * The following words are currently not keywords:
      *    select ]] */
     switch (s[0]) {
@@ -438,6 +778,9 @@ tokentype_T identify_reserved_word_string(const wchar_t *s)
         case L't':
             if (s[1] == L'h' && s[2] == L'e' && s[3] == L'n' && s[4]== L'\0')
                 return TT_THEN;
+            if (s[1] == L'i' && s[2] == L'm' && s[3] == L'e' && s[4]== L'\0'
+                    && !posixly_correct)
+                return TT_TIME;
             break;
         case L'u':
             if (s[1] == L'n' && s[2] == L't' && s[3] == L'i' && s[4] == L'l' &&
@@ -561,8 +904,36 @@ typedef struct parsestate_T {
     /* record of alias substitutions that are responsible for the current
      * `index' */
     struct aliaslist_T *aliases;
+    /* function definitions whose bodies are to be copied out of the arena */
+    struct plist_T funcdefs;
 } parsestate_T;
 
+static void *palloc(parsestate_T *ps, size_t size)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static wchar_t *pwcsndup(parsestate_T *ps, const wchar_t *s, size_t len)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static wchar_t *ptakewcs(parsestate_T *ps, wchar_t *s)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static char *ptakestr(parsestate_T *ps, char *s)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static void **ptoary(parsestate_T *ps, plist_T *list)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static void pfree(parsestate_T *ps, void *p)
+    __attribute__((nonnull(1)));
+static void pandorsfree(parsestate_T *ps, and_or_T *a)
+    __attribute__((nonnull(1)));
+static void pcomsfree(parsestate_T *ps, command_T *c)
+    __attribute__((nonnull(1)));
+static void pwordunitfree(parsestate_T *ps, wordunit_T *wu)
+    __attribute__((nonnull));
+static void pwordfree(parsestate_T *ps, wordunit_T *w)
+    __attribute__((nonnull(1)));
+static void add_funcdef(parsestate_T *ps, command_T *c)
+    __attribute__((nonnull));
+static void promote_function_bodies(parsestate_T *ps)
+    __attribute__((nonnull));
+static void comsfree_vp(void *c);
+
 static void serror(parsestate_T *restrict ps, const char *restrict format, ...)
     __attribute__((nonnull(1,2),format(printf,2,3)));
 static void print_errmsg_token(parsestate_T *ps, const char *message)
@@ -635,6 +1006,12 @@ static pipeline_T *parse_pipelines_in_and_or(parsestate_T *ps)
     __attribute__((nonnull,malloc,warn_unused_result));
 static pipeline_T *parse_pipeline(parsestate_T *ps)
     __attribute__((nonnull,malloc,warn_unused_result));
+static bool parse_time_options(parsestate_T *ps)
+    __attribute__((nonnull));
+static bool is_end_of_pipeline(tokentype_T tt)
+    __attribute__((const));
+static command_T *new_empty_command(parsestate_T *ps)
+    __attribute__((nonnull,malloc,warn_unused_result));
 static command_T *parse_commands_in_pipeline(parsestate_T *ps)
     __attribute__((nonnull,malloc,warn_unused_result));
 static command_T *parse_command(parsestate_T *ps)
@@ -689,6 +1066,31 @@ static command_T *parse_function(parsestate_T *ps)
 static command_T *try_reparse_as_function(parsestate_T *ps, command_T *c)
     __attribute__((nonnull,warn_unused_result));
 
+struct lazyscan_T;
+static bool lazy_parse_enabled(const parsestate_T *ps)
+    __attribute__((nonnull,pure));
+static command_T *tryscan_lazy_group(parsestate_T *ps)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static wchar_t lazy_peek(struct lazyscan_T *ls, size_t offset)
+    __attribute__((nonnull));
+static bool lazy_scan_commands(struct lazyscan_T *ls, bool cmdsubst)
+    __attribute__((nonnull));
+static bool lazy_scan_redirect(struct lazyscan_T *ls)
+    __attribute__((nonnull));
+static bool lazy_scan_word(struct lazyscan_T *ls, bool *literalp)
+    __attribute__((nonnull));
+static bool lazy_scan_expansion(struct lazyscan_T *ls, bool indq)
+    __attribute__((nonnull));
+static bool lazy_scan_braced_param(struct lazyscan_T *ls, bool indq)
+    __attribute__((nonnull));
+static bool lazy_scan_arith(struct lazyscan_T *ls)
+    __attribute__((nonnull));
+static bool lazy_skip_heredocs(struct lazyscan_T *ls)
+    __attribute__((nonnull));
+static command_T *parse_lazy_group_source(
+        const command_T *c, bool print_errmsg)
+    __attribute__((nonnull,malloc,warn_unused_result));
+
 static void read_heredoc_contents(parsestate_T *ps, redir_T *redir)
     __attribute__((nonnull));
 static void read_heredoc_contents_without_expansion(
@@ -709,6 +1111,131 @@ static wordunit_T **parse_string_without_quotes(
 #define QUOTES L"\"'\\"
 
 
+/***** Memory management *****/
+
+/* The functions below allocate and free parts of the parse tree. If the arena
+ * is specified in the parse parameters, the tree is allocated in the arena and
+ * the free functions do nothing. Otherwise, they are equivalent to the normal
+ * allocation and free functions. */
+
+void *palloc(parsestate_T *ps, size_t size)
+{
+    if (ps->info->arena != NULL)
+        return arena_alloc(ps->info->arena, size);
+    else
+        return xmalloc(size);
+}
+
+wchar_t *pwcsndup(parsestate_T *ps, const wchar_t *s, size_t len)
+{
+    if (ps->info->arena != NULL)
+        return arena_wcsndup(ps->info->arena, s, len);
+    else
+        return xwcsndup(s, len);
+}
+
+/* Returns the specified newly-malloced string, or its copy in the arena, in
+ * which case the original string is freed. */
+wchar_t *ptakewcs(parsestate_T *ps, wchar_t *s)
+{
+    if (ps->info->arena == NULL)
+        return s;
+
+    wchar_t *copy = arena_wcsndup(ps->info->arena, s, wcslen(s));
+    free(s);
+    return copy;
+}
+
+/* Returns the specified newly-malloced multibyte string, or its copy in the
+ * arena, in which case the original string is freed. */
+char *ptakestr(parsestate_T *ps, char *s)
+{
+    if (ps->info->arena == NULL)
+        return s;
+
+    size_t size = add(strlen(s), 1);
+    char *copy = arena_alloc(ps->info->arena, size);
+    memcpy(copy, s, size);
+    free(s);
+    return copy;
+}
+
+/* Like `pl_toary', but the array is moved into the arena if any. */
+void **ptoary(parsestate_T *ps, plist_T *list)
+{
+    if (ps->info->arena == NULL)
+        return pl_toary(list);
+
+    size_t size = mul(list->length + 1, sizeof *list->contents);
+    void **array = arena_alloc(ps->info->arena, size);
+    memcpy(array, list->contents, size);
+    pl_destroy(list);
+    return array;
+}
+
+void pfree(parsestate_T *ps, void *p)
+{
+    if (ps->info->arena == NULL)
+        free(p);
+}
+
+void pandorsfree(parsestate_T *ps, and_or_T *a)
+{
+    if (ps->info->arena == NULL)
+        andorsfree(a);
+}
+
+void pcomsfree(parsestate_T *ps, command_T *c)
+{
+    if (ps->info->arena == NULL)
+        comsfree(c);
+}
+
+void pwordunitfree(parsestate_T *ps, wordunit_T *wu)
+{
+    if (ps->info->arena == NULL)
+        wordunitfree(wu);
+}
+
+void pwordfree(parsestate_T *ps, wordunit_T *w)
+{
+    if (ps->info->arena == NULL)
+        wordfree(w);
+}
+
+/* Remembers the specified function definition so that its body is copied out
+ * of the arena when parsing is complete. The body cannot be copied right after
+ * it was parsed because the contents of here-documents in it may be read
+ * later. */
+void add_funcdef(parsestate_T *ps, command_T *c)
+{
+    if (ps->info->arena != NULL)
+        pl_add(&ps->funcdefs, c);
+}
+
+/* Replaces the bodies of the function definitions in the parse tree with
+ * copies allocated outside the arena, so that functions defined by the
+ * commands survive the arena. The copies are released when the arena is
+ * reset, unless they are referenced from defined functions.
+ * Inner definitions are always processed before outer ones, whose copies share
+ * the already copied inner bodies. */
+void promote_function_bodies(parsestate_T *ps)
+{
+    for (size_t i = 0; i < ps->funcdefs.length; i++) {
+        command_T *c = ps->funcdefs.contents[i];
+        if (c->c_funcbody != NULL) {
+            c->c_funcbody = comscopy(c->c_funcbody);
+            arena_defer(ps->info->arena, comsfree_vp, c->c_funcbody);
+        }
+    }
+}
+
+void comsfree_vp(void *c)
+{
+    comsfree(c);
+}
+
+
 /***** Entry points *****/
 
 /* The functions below may return non-NULL even on error.
@@ -757,6 +1284,7 @@ parseresult_T read_and_parse(parseparam_T *info, and_or_T **restrict resultp)
     ps.info->lastinputresult = INPUT_OK;
     wb_init(&ps.src);
     pl_init(&ps.pending_heredocs);
+    pl_init(&ps.funcdefs);
 
     and_or_T *r = parse_command_list(&ps, true);
 
@@ -766,16 +1294,19 @@ parseresult_T read_and_parse(parseparam_T *info, and_or_T **restrict resultp)
     wb_destroy(&ps.src);
     pl_destroy(&ps.pending_heredocs);
     destroy_aliaslist(ps.aliases);
-    wordfree(ps.token);
+    pwordfree(&ps, ps.token);
+    if (!ps.error && ps.info->lastinputresult != INPUT_INTERRUPTED)
+        promote_function_bodies(&ps);
+    pl_destroy(&ps.funcdefs);
 
     switch (ps.info->lastinputresult) {
         case INPUT_OK:
         case INPUT_EOF:
             if (ps.error) {
-                andorsfree(r);
+                pandorsfree(&ps, r);
                 return PR_SYNTAX_ERROR;
             } else if (length == 0) {
-                andorsfree(r);
+                pandorsfree(&ps, r);
                 return PR_EOF;
             } else {
                 assert(ps.index == length);
@@ -783,11 +1314,11 @@ parseresult_T read_and_parse(parseparam_T *info, and_or_T **restrict resultp)
                 return PR_OK;
             }
         case INPUT_INTERRUPTED:
-            andorsfree(r);
+            pandorsfree(&ps, r);
             *resultp = NULL;
             return PR_OK;
         case INPUT_ERROR:
-            andorsfree(r);
+            pandorsfree(&ps, r);
             return PR_INPUT_ERROR;
     }
     assert(false);
@@ -819,18 +1350,21 @@ bool parse_string(parseparam_T *info, wordunit_T **restrict resultp)
     ps.info->lastinputresult = INPUT_OK;
     read_more_input(&ps);
     pl_init(&ps.pending_heredocs);
+    pl_init(&ps.funcdefs);
 
     resultp = parse_string_without_quotes(&ps, false, false, resultp);
     *resultp = NULL;
 
     wb_destroy(&ps.src);
     pl_destroy(&ps.pending_heredocs);
+    promote_function_bodies(&ps);
+    pl_destroy(&ps.funcdefs);
     assert(ps.aliases == NULL);
     //destroy_aliaslist(ps.aliases);
-    wordfree(ps.token);
+    pwordfree(&ps, ps.token);
 
     if (ps.info->lastinputresult != INPUT_EOF || ps.error) {
-        wordfree(*resultp);
+        pwordfree(&ps, *resultp);
         return false;
     } else {
         return true;
@@ -1020,7 +1554,7 @@ size_t count_name_length(parsestate_T *ps, bool isnamechar(wchar_t c))
  * The existing `token' is freed. */
 void next_token(parsestate_T *ps)
 {
-    wordfree(ps->token);
+    pwordfree(ps, ps->token);
     ps->token = NULL;
 
     size_t index = ps->next_index;
@@ -1028,7 +1562,7 @@ void next_token(parsestate_T *ps)
         read_more_input(ps);
 
 skip_blanks:
-    while (iswblank(ps->src.contents[index]))
+    while (is_blank_char(ps->src.contents[index]))
         index++;
 
     if (ps->src.contents[index] == L'\\' &&
@@ -1121,7 +1655,7 @@ skip_blanks:
             wordunit_T *token = parse_word(ps, is_token_delimiter_char);
             index = ps->index;
 
-            wordfree(ps->token);
+            pwordfree(ps, ps->token);
             ps->token = token;
 
             /* Is this an IO_NUMBER token? */
@@ -1160,18 +1694,35 @@ wordunit_T *parse_word(parsestate_T *ps, bool testfunc(wchar_t c))
     do {                                                                 \
         size_t len = ps->index - startindex;                             \
         if (len > 0) {                                                   \
-            wordunit_T *w = xmalloc(sizeof *w);                          \
+            wordunit_T *w = palloc(ps, sizeof *w);                          \
             w->next = NULL;                                              \
             w->wu_type = WT_STRING;                                      \
-            w->wu_string = xwcsndup(&ps->src.contents[startindex], len); \
+            w->wu_string = pwcsndup(ps, &ps->src.contents[startindex], len); \
             *lastp = w;                                                  \
             lastp = &w->next;                                            \
         }                                                                \
     } while (0)
 
+    /* If the word is delimited by the usual token delimiters, the characters
+     * that are neither special nor delimiters can be skipped in a run. */
+    bool fastscan = (testfunc == is_token_delimiter_char);
+
     while (maybe_line_continuations(ps, ps->index),
             indq || !testfunc(ps->src.contents[ps->index])) {
 
+        if (fastscan || indq) {
+            /* skip a run of plain ASCII characters at once */
+            int mask = indq ? CC_SPECIAL : CC_SPECIAL | CC_BLANK | CC_DELIMITER;
+            size_t index = ps->index;
+            while (is_ascii(ps->src.contents[index]) &&
+                    !(char_classes[ps->src.contents[index]] & mask))
+                index++;
+            if (index > ps->index) {
+                ps->index = index;
+                continue;
+            }
+        }
+
         switch (ps->src.contents[ps->index]) {
         case L'\0':
             goto done;  // reached EOF
@@ -1308,12 +1859,12 @@ wordunit_T *tryparse_paramexp_raw(parsestate_T *ps)
         namelen = count_name_length(ps, is_portable_name_char);
 
 success:;
-    paramexp_T *pe = xmalloc(sizeof *pe);
+    paramexp_T *pe = palloc(ps, sizeof *pe);
     pe->pe_type = PT_NONE;
-    pe->pe_name = xwcsndup(&ps->src.contents[ps->index], namelen);
+    pe->pe_name = pwcsndup(ps, &ps->src.contents[ps->index], namelen);
     pe->pe_start = pe->pe_end = pe->pe_match = pe->pe_subst = NULL;
 
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_PARAM;
     result->wu_param = pe;
@@ -1331,7 +1882,7 @@ error:
  * called and the position is advanced to the closing brace L'}'. */
 wordunit_T *parse_paramexp_in_brace(parsestate_T *ps)
 {
-    paramexp_T *pe = xmalloc(sizeof *pe);
+    paramexp_T *pe = palloc(ps, sizeof *pe);
     pe->pe_type = 0;
     pe->pe_name = NULL;
     pe->pe_start = pe->pe_end = pe->pe_match = pe->pe_subst = NULL;
@@ -1396,7 +1947,7 @@ parse_name:;
             serror(ps, Ngt("the parameter name is missing or invalid"));
             goto end;
         }
-        pe->pe_name = xwcsndup(&ps->src.contents[namestartindex], namelen);
+        pe->pe_name = pwcsndup(ps, &ps->src.contents[namestartindex], namelen);
     }
 
     /* parse indices */
@@ -1509,7 +2060,7 @@ check_closing_brace:
                 (wint_t) L'#');
 
 end:;
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_PARAM;
     result->wu_param = pe;
@@ -1530,7 +2081,7 @@ wordunit_T *parse_cmdsubst_in_paren(parsestate_T *ps)
     else
         serror(ps, Ngt("`%ls' is missing"), L")");
 
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_CMDSUB;
     result->wu_cmdsub = cmd;
@@ -1577,10 +2128,10 @@ wchar_t *extract_command_in_paren_unparsed(parsestate_T *ps)
 
     size_t startindex = ps->next_index;
     next_token(ps);
-    andorsfree(parse_compound_list(ps));
+    pandorsfree(ps, parse_compound_list(ps));
     assert(startindex <= ps->index);
 
-    wchar_t *result = xwcsndup(
+    wchar_t *result = pwcsndup(ps, 
             &ps->src.contents[startindex], ps->index - startindex);
 
     ps->enable_alias = save_enable_alias;
@@ -1632,11 +2183,11 @@ wordunit_T *parse_cmdsubst_in_backquote(parsestate_T *ps, bool bsdq)
         }
     }
 end:;
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_CMDSUB;
     result->wu_cmdsub.is_preparsed = false;
-    result->wu_cmdsub.value.unparsed = wb_towcs(&buf);
+    result->wu_cmdsub.value.unparsed = ptakewcs(ps, wb_towcs(&buf));
     return result;
 }
 
@@ -1710,14 +2261,14 @@ wordunit_T *tryparse_arith(parsestate_T *ps)
         ps->index++;
     }
 end:;
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_ARITH;
     result->wu_arith = first;
     return result;
 
 not_arithmetic_expansion:
-    wordfree(first);
+    pwordfree(ps, first);
     rewind_index(ps, saveindex);
     return NULL;
 }
@@ -1737,7 +2288,7 @@ void next_line(parsestate_T *ps)
         read_heredoc_contents(ps, ps->pending_heredocs.contents[i]);
     pl_truncate(&ps->pending_heredocs, 0);
 
-    wordfree(ps->token);
+    pwordfree(ps, ps->token);
     ps->token = NULL;
     ps->tokentype = TT_UNKNOWN;
     ps->next_index = ps->index;
@@ -1761,13 +2312,9 @@ bool parse_newline_list(parsestate_T *ps)
 /* Checks if the specified character is a token separator. */
 bool is_token_delimiter_char(wchar_t c)
 {
-    switch (c) {
-        case L'\0':  case L'\n':  case L';':   case L'&':   case L'|':
-        case L'<':   case L'>':   case L'(':   case L')':
-            return true;
-        default:
-            return iswblank(c);
-    }
+    if (is_ascii(c))
+        return char_classes[c] & (CC_BLANK | CC_DELIMITER);
+    return iswblank(c);
 }
 
 bool is_comma_or_closing_bracket(wchar_t c)
@@ -1844,7 +2391,7 @@ and_or_T *parse_command_list(parsestate_T *ps, bool toeol)
                     next_token(ps);
                     continue;
                 }
-                wordfree(ps->token);
+                pwordfree(ps, ps->token);
                 ps->token = NULL;
                 ps->index = ps->next_index;
                 ps->tokentype = TT_END_OF_INPUT;
@@ -1908,7 +2455,7 @@ and_or_T *parse_and_or_list(parsestate_T *ps)
         return NULL;
     }
 
-    and_or_T *result = xmalloc(sizeof *result);
+    and_or_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->ao_pipelines = p;
     result->ao_async = (ps->tokentype == TT_AMP);
@@ -1958,25 +2505,39 @@ next:
  * NULL is returned. */
 pipeline_T *parse_pipeline(parsestate_T *ps)
 {
-    bool neg;
+    bool neg = false, timed = false, posixtime = false;
     command_T *c;
 
+    if (ps->tokentype == TT_TIME) {
+        timed = true;
+        next_token(ps);
+        posixtime = parse_time_options(ps);
+    }
     if (ps->tokentype == TT_BANG) {
         neg = true;
         if (posixly_correct && ps->src.contents[ps->next_index] == L'(')
             serror(ps, Ngt("ksh-like extended glob pattern `!(...)' "
                         "is not supported"));
         next_token(ps);
+        if (!timed && ps->tokentype == TT_TIME) {
+            timed = true;
+            next_token(ps);
+            posixtime = parse_time_options(ps);
+        }
+    }
 
-parse_after_bang:
+    if (timed && is_end_of_pipeline(ps->tokentype)) {
+        /* "time" without a command times an empty command */
+        c = new_empty_command(ps);
+    } else if (neg || timed) {
+parse_after_prefix:
         c = parse_commands_in_pipeline(ps);
         if (ps->reparse) {
             ps->reparse = false;
             assert(c == NULL);
-            goto parse_after_bang;
+            goto parse_after_prefix;
         }
     } else {
-        neg = false;
         c = parse_commands_in_pipeline(ps);
         if (ps->reparse) {
             assert(c == NULL);
@@ -1984,28 +2545,84 @@ parse_after_bang:
         }
     }
 
-    pipeline_T *result = xmalloc(sizeof *result);
+    pipeline_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->pl_commands = c;
     result->pl_neg = neg;
     result->pl_cond = false;
+    result->pl_time = timed;
+    result->pl_posixtime = posixtime;
     return result;
 }
 
-/* Parses the body of the pipeline.
- * If the first word was alias-substituted, the `ps->reparse' flag is set and
- * NULL is returned. */
-command_T *parse_commands_in_pipeline(parsestate_T *ps)
+/* Parses the options that follow the "time" keyword.
+ * The -p option can be repeated and "--" ends the options.
+ * Returns true iff the -p option was found. */
+bool parse_time_options(parsestate_T *ps)
 {
-    command_T *first = NULL, **lastp = &first;
-
-    for (;;) {
-        command_T *c = parse_command(ps);
-        if (c != NULL) {
-            *lastp = c;
-            lastp = &c->next;
+    bool posixtime = false;
+    while (is_single_string_word(ps->token)) {
+        if (wcscmp(ps->token->wu_string, L"-p") == 0) {
+            posixtime = true;
+        } else if (wcscmp(ps->token->wu_string, L"--") == 0) {
+            next_token(ps);
+            break;
+        } else {
+            break;
         }
-        if (ps->reparse) {
+        next_token(ps);
+    }
+    return posixtime;
+}
+
+/* Determines if the specified token ends a pipeline, that is, if "time"
+ * followed by the token has no command to time. */
+bool is_end_of_pipeline(tokentype_T tt)
+{
+    switch (tt) {
+        case TT_END_OF_INPUT:
+        case TT_NEWLINE:
+        case TT_SEMICOLON:
+        case TT_AMP:
+        case TT_AMPAMP:
+        case TT_PIPEPIPE:
+            return true;
+        default:
+            return is_closing_tokentype(tt);
+    }
+}
+
+/* Returns a new simple command that has no assignments, redirections, or
+ * words. Executing it only sets the exit status to zero. */
+command_T *new_empty_command(parsestate_T *ps)
+{
+    command_T *result = palloc(ps, sizeof *result);
+    result->next = NULL;
+    result->refcount = 1;
+    result->c_lineno = ps->info->lineno;
+    result->c_type = CT_SIMPLE;
+    result->c_assigns = NULL;
+    result->c_cache.generation = 0;
+    result->c_redirs = NULL;
+    result->c_words = palloc(ps, sizeof *result->c_words);
+    result->c_words[0] = NULL;
+    return result;
+}
+
+/* Parses the body of the pipeline.
+ * If the first word was alias-substituted, the `ps->reparse' flag is set and
+ * NULL is returned. */
+command_T *parse_commands_in_pipeline(parsestate_T *ps)
+{
+    command_T *first = NULL, **lastp = &first;
+
+    for (;;) {
+        command_T *c = parse_command(ps);
+        if (c != NULL) {
+            *lastp = c;
+            lastp = &c->next;
+        }
+        if (ps->reparse) {
             assert(c == NULL);
             if (first != NULL) {
                 ps->reparse = false;
@@ -2050,12 +2667,13 @@ command_T *parse_command(parsestate_T *ps)
     }
 
     /* parse as a simple command */
-    result = xmalloc(sizeof *result);
+    result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
     result->c_lineno = ps->info->lineno;
     result->c_type = CT_SIMPLE;
     result->c_assigns = NULL;
+    result->c_cache.generation = 0;
     result->c_redirs = NULL;
     result->c_words = parse_simple_command_tokens(
             ps, &result->c_assigns, &result->c_redirs);
@@ -2063,7 +2681,7 @@ command_T *parse_command(parsestate_T *ps)
     if (result->c_words[0] == NULL && result->c_assigns == NULL &&
             result->c_redirs == NULL) {
         /* an empty command */
-        comsfree(result);
+        pcomsfree(ps, result);
         if (ps->tokentype == TT_END_OF_INPUT || ps->tokentype == TT_NEWLINE)
             serror(ps, Ngt("a command is missing at the end of input"));
         else
@@ -2119,7 +2737,7 @@ next:
         goto next;
     }
 
-    return pl_toary(&words);
+    return ptoary(ps, &words);
 }
 
 /* Parses words.
@@ -2142,7 +2760,7 @@ void **parse_words(parsestate_T *ps, bool skip_newlines)
         pl_add(&wordlist, ps->token), ps->token = NULL;
         next_token(ps);
     }
-    return pl_toary(&wordlist);
+    return ptoary(ps, &wordlist);
 }
 
 /* Parses as many redirections as possible.
@@ -2174,12 +2792,18 @@ assign_T *tryparse_assignment(parsestate_T *ps)
 
     const wchar_t *nameend = skip_name(ps->token->wu_string, is_name_char);
     size_t namelen = nameend - ps->token->wu_string;
-    if (namelen == 0 || *nameend != L'=')
+    if (namelen == 0)
+        return NULL;
+    bool append = !posixly_correct && *nameend == L'+';
+    if (append)
+        nameend++;
+    if (*nameend != L'=')
         return NULL;
 
-    assign_T *result = xmalloc(sizeof *result);
+    assign_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
-    result->a_name = xwcsndup(ps->token->wu_string, namelen);
+    result->a_append = append;
+    result->a_name = pwcsndup(ps, ps->token->wu_string, namelen);
 
     /* remove the name and '=' from the token */
     size_t index_after_first_token = ps->next_index;
@@ -2188,7 +2812,7 @@ assign_T *tryparse_assignment(parsestate_T *ps)
     wmemmove(first_token->wu_string, &nameend[1], wcslen(&nameend[1]) + 1);
     if (first_token->wu_string[0] == L'\0') {
         wordunit_T *wu = first_token->next;
-        wordunitfree(first_token);
+        pwordunitfree(ps, first_token);
         first_token = wu;
     }
 
@@ -2242,7 +2866,7 @@ redir_T *tryparse_redirect(parsestate_T *ps)
         return NULL;
     }
 
-    redir_T *result = xmalloc(sizeof *result);
+    redir_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->rd_fd = fd;
     switch (ps->tokentype) {
@@ -2309,8 +2933,9 @@ parse_here_document_tag:
     next_token(ps);
     validate_redir_operand(ps);
     result->rd_hereend =
-        xwcsndup(&ps->src.contents[ps->index], ps->next_index - ps->index);
+        pwcsndup(ps, &ps->src.contents[ps->index], ps->next_index - ps->index);
     result->rd_herecontent = NULL;
+    result->rd_heretext = NULL;
     if (ps->token == NULL) {
         serror(ps, Ngt("the end-of-here-document indicator is missing"));
     } else {
@@ -2436,7 +3061,7 @@ command_T *parse_group(parsestate_T *ps)
     else
         print_errmsg_token_missing(ps, ends);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
     result->c_type = type;
@@ -2453,7 +3078,7 @@ command_T *parse_if(parsestate_T *ps)
     assert(ps->tokentype == TT_IF);
     next_token(ps);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
     result->c_type = CT_IF;
@@ -2464,7 +3089,7 @@ command_T *parse_if(parsestate_T *ps)
     ifcommand_T **lastp = &result->c_ifcmds;
     bool after_else = false;
     while (!ps->error) {
-        ifcommand_T *ic = xmalloc(sizeof *ic);
+        ifcommand_T *ic = palloc(ps, sizeof *ic);
         *lastp = ic;
         lastp = &ic->next;
         ic->next = NULL;
@@ -2509,7 +3134,7 @@ command_T *parse_for(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
     result->c_type = CT_FOR;
@@ -2517,7 +3142,7 @@ command_T *parse_for(parsestate_T *ps)
     result->c_redirs = NULL;
 
     result->c_forname =
-        xwcsndup(&ps->src.contents[ps->index], ps->next_index - ps->index);
+        pwcsndup(ps, &ps->src.contents[ps->index], ps->next_index - ps->index);
     if (!is_name_word(ps->token)) {
         if (ps->token == NULL)
             serror(ps, Ngt("an identifier is required after `for'"));
@@ -2582,7 +3207,7 @@ command_T *parse_while(parsestate_T *ps)
     }
     next_token(ps);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
     result->c_type = CT_WHILE;
@@ -2621,7 +3246,7 @@ command_T *parse_case(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
     result->c_type = CT_CASE;
@@ -2666,7 +3291,7 @@ caseitem_T *parse_case_list(parsestate_T *ps)
         if (psubstitute_alias(ps, 0))
             continue;
 
-        caseitem_T *ci = xmalloc(sizeof *ci);
+        caseitem_T *ci = palloc(ps, sizeof *ci);
         *lastp = ci;
         lastp = &ci->next;
         ci->next = NULL;
@@ -2729,7 +3354,7 @@ void **parse_case_patterns(parsestate_T *ps)
         psubstitute_alias_recursive(ps, 0);
     } while (!ps->error);
 
-    return pl_toary(&wordlist);
+    return ptoary(ps, &wordlist);
 }
 
 #if YASH_ENABLE_DOUBLE_BRACKET
@@ -2748,7 +3373,7 @@ command_T *parse_double_bracket(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
     result->c_type = CT_BRACKET;
@@ -2781,7 +3406,7 @@ dbexp_T *parse_double_bracket_ors(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    dbexp_T *result = xmalloc(sizeof *result);
+    dbexp_T *result = palloc(ps, sizeof *result);
     result->type = DBE_OR;
     result->operator = NULL;
     result->lhs.subexp = lhs;
@@ -2799,7 +3424,7 @@ dbexp_T *parse_double_bracket_ands(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    dbexp_T *result = xmalloc(sizeof *result);
+    dbexp_T *result = palloc(ps, sizeof *result);
     result->type = DBE_AND;
     result->operator = NULL;
     result->lhs.subexp = lhs;
@@ -2816,7 +3441,7 @@ dbexp_T *parse_double_bracket_nots(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    dbexp_T *result = xmalloc(sizeof *result);
+    dbexp_T *result = palloc(ps, sizeof *result);
     result->type = DBE_NOT;
     result->operator = NULL;
     result->lhs.subexp = NULL;
@@ -2867,7 +3492,7 @@ dbexp_T *parse_double_bracket_primary(parsestate_T *ps)
 
     if (ps->tokentype == TT_LESS || ps->tokentype == TT_GREATER) {
         type = DBE_BINARY;
-        op = xwcsndup(&ps->src.contents[ps->index], ps->next_index - ps->index);
+        op = pwcsndup(ps, &ps->src.contents[ps->index], ps->next_index - ps->index);
     } else if (is_single_string_word(ps->token) &&
             is_binary_primary(ps->token->wu_string)) {
         type = DBE_BINARY;
@@ -2890,7 +3515,7 @@ parse_primary_operator:
         rhs = parse_double_bracket_operand(ps);
 
 return_result:;
-    dbexp_T *result = xmalloc(sizeof *result);
+    dbexp_T *result = palloc(ps, sizeof *result);
     result->type = type;
     result->operator = op;
     result->lhs.word = lhs;
@@ -3026,7 +3651,7 @@ end:;
     MAKE_WORDUNIT_STRING;
     ps->next_index = ps->index;
     ps->index = grandstartindex;
-    wordfree(ps->token), ps->token = token;
+    pwordfree(ps, ps->token), ps->token = token;
     ps->tokentype = TT_WORD;
     return parse_double_bracket_operand(ps);
 }
@@ -3044,7 +3669,7 @@ command_T *parse_function(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = palloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
     result->c_type = CT_FUNCDEF;
@@ -3076,7 +3701,9 @@ parse_close_parenthesis:
 parse_function_body:
     parse_newline_list(ps);
 
-    result->c_funcbody = parse_compound_command(ps);
+    result->c_funcbody = tryscan_lazy_group(ps);
+    if (result->c_funcbody == NULL)
+        result->c_funcbody = parse_compound_command(ps);
     if (result->c_funcbody == NULL) {
         if (psubstitute_alias(ps, 0)) {
             if (paren)
@@ -3087,6 +3714,7 @@ parse_function_body:
         serror(ps, Ngt("a function body must be a compound command"));
     }
 
+    add_funcdef(ps, result);
     return result;
 }
 
@@ -3128,22 +3756,877 @@ command_T *try_reparse_as_function(parsestate_T *ps, command_T *c)
     }
     next_token(ps);
 
-    free(c->c_words);
+    pfree(ps, c->c_words);
     c->c_type = CT_FUNCDEF;
     c->c_funcname = name;
 
 parse_function_body:
     parse_newline_list(ps);
-    c->c_funcbody = parse_compound_command(ps);
+    c->c_funcbody = tryscan_lazy_group(ps);
+    if (c->c_funcbody == NULL)
+        c->c_funcbody = parse_compound_command(ps);
     if (c->c_funcbody == NULL) {
         if (psubstitute_alias(ps, 0))
             goto parse_function_body;
         serror(ps, Ngt("a function body must be a compound command"));
     }
 
+    add_funcdef(ps, c);
     return c;
 }
 
+/***** Lazily parsed function bodies *****/
+
+/* When the "lazyparse" option is enabled, a function body that is a command
+ * group is not parsed with the function definition. The scanner functions below
+ * only find the extent of the group, which is saved as a `CT_LAZYGROUP' command
+ * and parsed by `parse_lazy_group' when the function is first executed.
+ * The scanner recognizes just as much syntax as is needed to find the closing
+ * brace that the normal parser would find: quotations, expansions, command
+ * substitutions, here-documents, reserved words, and case patterns. When it
+ * sees anything it cannot follow reliably, it gives up and the body is parsed
+ * normally. */
+
+/* state of the scanner */
+typedef struct lazyscan_T {
+    parsestate_T *ps;
+    size_t index;       /* the current position in `ps->src' */
+    plist_T heredocs;   /* here-documents whose contents have not been skipped */
+} lazyscan_T;
+
+/* here-document whose contents are to be skipped */
+typedef struct lazyheredoc_T {
+    wchar_t *eoc;       /* end-of-contents marker */
+    bool skiptab;       /* true for "<<-" */
+    bool expand;        /* true if the contents are subject to expansions */
+} lazyheredoc_T;
+
+/* what is expected at the current position of the scanner */
+typedef enum lazystate_T {
+    LS_COMMAND,         /* a command, where reserved words are recognized */
+    LS_ARGUMENT,        /* the rest of a simple command */
+    LS_REDIRECTION,     /* redirections after a compound command */
+    LS_CASE_WORD,       /* the word after "case" */
+    LS_CASE_IN,         /* "in" after the case word */
+    LS_PATTERN,         /* the first case pattern or "esac" */
+    LS_PATTERN_WORD,    /* a case pattern after "(" or "|" */
+    LS_PATTERN_END,     /* "|" or ")" after a case pattern */
+    LS_FOR_NAME,        /* the variable name after "for" */
+    LS_FOR_IN,          /* "in" or "do" after the variable name */
+    LS_FUNCTION_NAME,   /* the function name after "function" */
+#if YASH_ENABLE_DOUBLE_BRACKET
+    LS_DOUBLE_BRACKET,  /* the expression in a double-bracket command */
+#endif
+} lazystate_T;
+
+static void lazyheredocfree(void *h);
+static bool is_self_contained_heredoc_line(const wchar_t *line, size_t len)
+    __attribute__((nonnull,pure));
+
+/* Tests if the current function body can be scanned lazily.
+ * Function bodies are parsed normally in the interactive shell, in the
+ * POSIXly-correct mode, when the "exec" option is off so that syntax errors
+ * are reported immediately, when the "hashondef" option is on, when alias
+ * substitution may apply, and when here-documents are pending. */
+bool lazy_parse_enabled(const parsestate_T *ps)
+{
+    return shopt_lazyparse && shopt_exec && !shopt_hashondef
+        && !posixly_correct && !ps->info->interactive
+        && ps->pending_heredocs.length == 0 && ps->aliases == NULL
+        && (!ps->enable_alias || !any_alias_defined());
+}
+
+/* Scans a function body lazily if possible.
+ * If the current token is "{" and the command group can be scanned, the group
+ * and the following redirections are parsed into a `CT_LAZYGROUP' command,
+ * which is returned. Otherwise, NULL is returned without moving the current
+ * position. */
+command_T *tryscan_lazy_group(parsestate_T *ps)
+{
+    if (ps->tokentype != TT_LBRACE || !lazy_parse_enabled(ps))
+        return NULL;
+
+    lazyscan_T ls = { .ps = ps, .index = ps->next_index, };
+    pl_init(&ls.heredocs);
+    bool ok = lazy_scan_commands(&ls, false) && ls.heredocs.length == 0;
+    pl_destroy(pl_clear(&ls.heredocs, lazyheredocfree));
+    if (!ok)
+        return NULL;
+
+    size_t start = ps->index, end = ls.index;
+    command_T *result = palloc(ps, sizeof *result);
+    result->next = NULL;
+    result->refcount = 1;
+    result->c_type = CT_LAZYGROUP;
+    result->c_lineno = ps->info->lineno;
+    result->c_redirs = NULL;
+    result->c_lazysrc = pwcsndup(ps, &ps->src.contents[start], end - start);
+    if (ps->info->filename != NULL) {
+        size_t size = strlen(ps->info->filename) + 1;
+        result->c_lazyfile = memcpy(palloc(ps, size), ps->info->filename, size);
+    } else {
+        result->c_lazyfile = NULL;
+    }
+
+    /* Line continuations are not removed from the source by the scanner, so
+     * every newline in the group counts. */
+    for (size_t i = start; i < end; i++)
+        if (ps->src.contents[i] == L'\n')
+            ps->info->lineno++;
+
+    ps->next_index = end;
+    next_token(ps);
+    parse_redirect_list(ps, &result->c_redirs);
+    return result;
+}
+
+void lazyheredocfree(void *h)
+{
+    lazyheredoc_T *heredoc = h;
+    free(heredoc->eoc);
+    free(heredoc);
+}
+
+/* Returns the character at `offset' characters after the current position of
+ * the scanner, reading more input if necessary. Returns L'\0' at the end of
+ * input. */
+wchar_t lazy_peek(lazyscan_T *ls, size_t offset)
+{
+    parsestate_T *ps = ls->ps;
+    while (ls->index + offset >= ps->src.length)
+        if (read_more_input(ps) != INPUT_OK)
+            return L'\0';
+    return ps->src.contents[ls->index + offset];
+}
+
+/* Scans commands up to the closing brace of the command group (if `cmdsubst'
+ * is false) or the closing parenthesis of the command substitution (if
+ * `cmdsubst' is true), whichever should follow the current position. The
+ * position is advanced past the closing brace or parenthesis.
+ * Returns false if the commands cannot be scanned. */
+bool lazy_scan_commands(lazyscan_T *ls, bool cmdsubst)
+{
+    /* Each character of `nest' is the closing token of an enclosing construct:
+     * '}' for a command group, ')' for a subshell or the command substitution,
+     * and 'c' for a case command. */
+    xstrbuf_T nest;
+    lazystate_T state = LS_COMMAND;
+    bool funcname = false;  /* the last word may be the name of a function */
+    bool ok = false;
+
+    sb_init(&nest);
+    sb_ccat(&nest, cmdsubst ? ')' : '}');
+
+    for (;;) {
+        const wchar_t *word;
+        size_t wordlen;
+        bool literal, wasfuncname = funcname;
+        wchar_t c = lazy_peek(ls, 0);
+        char top = nest.contents[nest.length - 1];
+
+        funcname = false;
+        switch (c) {
+            case L'\0':
+                goto end;
+            case L'\\':
+                if (lazy_peek(ls, 1) != L'\n')
+                    goto scan_word;
+                /* a line continuation is just like a blank */
+                ls->index += 2;
+                funcname = wasfuncname;
+                continue;
+            case L'#':
+                while ((c = lazy_peek(ls, 0)) != L'\n' && c != L'\0')
+                    ls->index++;
+                continue;
+            case L'\n':
+                ls->index++;
+                if (!lazy_skip_heredocs(ls))
+                    goto end;
+                switch (state) {
+                    case LS_ARGUMENT:
+                    case LS_REDIRECTION:
+                        state = LS_COMMAND;
+                        break;
+                    case LS_COMMAND:
+                    case LS_CASE_IN:
+                    case LS_PATTERN:
+                    case LS_FOR_IN:
+                        break;
+                    default:
+                        goto end;
+                }
+                continue;
+            case L';':
+                if (lazy_peek(ls, 1) == L';') {
+                    if (top != 'c' || (state != LS_COMMAND &&
+                                state != LS_ARGUMENT &&
+                                state != LS_REDIRECTION))
+                        goto end;
+                    ls->index += 2;
+                    state = LS_PATTERN;
+                    continue;
+                }
+                if (state != LS_ARGUMENT && state != LS_REDIRECTION &&
+                        state != LS_FOR_IN)
+                    goto end;
+                ls->index++;
+                state = LS_COMMAND;
+                continue;
+            case L'&':
+            case L'|':
+#if YASH_ENABLE_DOUBLE_BRACKET
+                if (state == LS_DOUBLE_BRACKET) {
+                    ls->index++;
+                    continue;
+                }
+#endif
+                if (c == L'|' && state == LS_PATTERN_END) {
+                    ls->index++;
+                    state = LS_PATTERN_WORD;
+                    continue;
+                }
+                if (state != LS_ARGUMENT && state != LS_REDIRECTION)
+                    goto end;
+                ls->index += (lazy_peek(ls, 1) == c) ? 2 : 1;
+                state = LS_COMMAND;
+                continue;
+            case L'(':
+#if YASH_ENABLE_DOUBLE_BRACKET
+                if (state == LS_DOUBLE_BRACKET) {
+                    ls->index++;
+                    continue;
+                }
+#endif
+                ls->index++;
+                if (state == LS_PATTERN) {
+                    state = LS_PATTERN_WORD;
+                    continue;
+                }
+                if (wasfuncname) {
+                    /* "()" of a function definition */
+                    while (iswblank(lazy_peek(ls, 0)))
+                        ls->index++;
+                    if (lazy_peek(ls, 0) != L')')
+                        goto end;
+                    ls->index++;
+                    state = LS_COMMAND;
+                    continue;
+                }
+                if (state != LS_COMMAND)
+                    goto end;
+                sb_ccat(&nest, ')');
+                continue;
+            case L')':
+#if YASH_ENABLE_DOUBLE_BRACKET
+                if (state == LS_DOUBLE_BRACKET) {
+                    ls->index++;
+                    continue;
+                }
+#endif
+                ls->index++;
+                if (state == LS_PATTERN_END) {
+                    state = LS_COMMAND;
+                    continue;
+                }
+                if (top != ')' || (state != LS_COMMAND &&
+                            state != LS_ARGUMENT && state != LS_REDIRECTION))
+                    goto end;
+                sb_truncate(&nest, nest.length - 1);
+                if (nest.length == 0) {
+                    ok = true;
+                    goto end;
+                }
+                state = LS_REDIRECTION;
+                continue;
+            case L'<':
+            case L'>':
+#if YASH_ENABLE_DOUBLE_BRACKET
+                if (state == LS_DOUBLE_BRACKET) {
+                    ls->index++;
+                    continue;
+                }
+#endif
+                if (state == LS_COMMAND)
+                    state = LS_ARGUMENT;
+                else if (state != LS_ARGUMENT && state != LS_REDIRECTION)
+                    goto end;
+                if (!lazy_scan_redirect(ls))
+                    goto end;
+                continue;
+            default:
+                if (iswblank(c)) {
+                    ls->index++;
+                    funcname = wasfuncname;
+                    continue;
+                }
+                goto scan_word;
+        }
+
+scan_word:;
+        size_t start = ls->index;
+        if (!lazy_scan_word(ls, &literal))
+            goto end;
+        word = &ls->ps->src.contents[start];
+        wordlen = ls->index - start;
+
+        /* An IO_NUMBER token is part of the following redirection. */
+        c = ls->ps->src.contents[ls->index];
+        if (literal && (c == L'<' || c == L'>')
+                && wcsspn(word, L"0123456789") == wordlen)
+            continue;
+
+        /* The longest reserved word is "function". */
+        tokentype_T tt = TT_WORD;
+        if (literal && wordlen <= 8) {
+            wchar_t w[9];
+            wmemcpy(w, word, wordlen);
+            w[wordlen] = L'\0';
+            tt = identify_reserved_word_string(w);
+        }
+
+        switch (state) {
+            case LS_COMMAND:
+            case LS_REDIRECTION:
+                switch (tt) {
+                    case TT_RBRACE:
+                        if (top != '}')
+                            goto end;
+                        sb_truncate(&nest, nest.length - 1);
+                        if (nest.length == 0) {
+                            ok = true;
+                            goto end;
+                        }
+                        state = LS_REDIRECTION;
+                        continue;
+                    case TT_ESAC:
+                        if (top != 'c')
+                            goto end;
+                        sb_truncate(&nest, nest.length - 1);
+                        /* falls thru! */
+                    case TT_FI:
+                    case TT_DONE:
+                        state = LS_REDIRECTION;
+                        continue;
+                    case TT_THEN:
+                    case TT_ELSE:
+                    case TT_ELIF:
+                    case TT_DO:
+                        state = LS_COMMAND;
+                        continue;
+                    default:
+                        break;
+                }
+                /* Other words cannot follow a compound command. */
+                if (state == LS_REDIRECTION)
+                    goto end;
+                switch (tt) {
+                    case TT_LBRACE:
+                        sb_ccat(&nest, '}');
+                        break;
+                    case TT_IF:
+                    case TT_WHILE:
+                    case TT_UNTIL:
+                    case TT_BANG:
+                    case TT_TIME:
+                        break;
+                    case TT_CASE:
+                        state = LS_CASE_WORD;
+                        break;
+                    case TT_FOR:
+                        state = LS_FOR_NAME;
+                        break;
+                    case TT_FUNCTION:
+                        state = LS_FUNCTION_NAME;
+                        break;
+#if YASH_ENABLE_DOUBLE_BRACKET
+                    case TT_DOUBLE_LBRACKET:
+                        state = LS_DOUBLE_BRACKET;
+                        break;
+#endif
+                    case TT_IN:
+                        goto end;
+                    default:
+                        state = LS_ARGUMENT;
+                        funcname = literal && !iswdigit(word[0]);
+                        for (size_t i = 0; funcname && i < wordlen; i++)
+                            funcname = is_name_char(word[i]);
+                        break;
+                }
+                continue;
+            case LS_ARGUMENT:
+                continue;
+            case LS_CASE_WORD:
+                state = LS_CASE_IN;
+                continue;
+            case LS_CASE_IN:
+                if (tt != TT_IN)
+                    goto end;
+                sb_ccat(&nest, 'c');
+                state = LS_PATTERN;
+                continue;
+            case LS_PATTERN:
+                if (tt == TT_ESAC) {
+                    if (top != 'c')
+                        goto end;
+                    sb_truncate(&nest, nest.length - 1);
+                    state = LS_REDIRECTION;
+                    continue;
+                }
+                /* falls thru! */
+            case LS_PATTERN_WORD:
+                state = LS_PATTERN_END;
+                continue;
+            case LS_PATTERN_END:
+                goto end;
+            case LS_FOR_NAME:
+                state = LS_FOR_IN;
+                continue;
+            case LS_FOR_IN:
+                if (tt == TT_IN)
+                    state = LS_ARGUMENT;
+                else if (tt == TT_DO)
+                    state = LS_COMMAND;
+                else
+                    goto end;
+                continue;
+            case LS_FUNCTION_NAME:
+                state = LS_COMMAND;
+                funcname = true;
+                continue;
+#if YASH_ENABLE_DOUBLE_BRACKET
+            case LS_DOUBLE_BRACKET:
+                if (literal && wordlen == 2) {
+                    if (word[0] == L']' && word[1] == L']')
+                        state = LS_REDIRECTION;
+                    else if (word[0] == L'=' && word[1] == L'~')
+                        goto end;  /* regular expressions are not scanned */
+                }
+                continue;
+#endif
+        }
+        assert(false);
+    }
+
+end:
+    sb_destroy(&nest);
+    return ok;
+}
+
+/* Scans a redirection. The current position must be at the first character of
+ * the redirection operator. The position is advanced past the operand.
+ * The end-of-contents marker of a here-document is added to `ls->heredocs'.
+ * Returns false if the redirection cannot be scanned. */
+bool lazy_scan_redirect(lazyscan_T *ls)
+{
+    bool heredoc = false, skiptab = false;
+    wchar_t c = lazy_peek(ls, 0);
+
+    ls->index++;
+    switch (lazy_peek(ls, 0)) {
+        case L'(':  /* process redirection */
+            return false;
+        case L'<':
+            if (c != L'<')
+                break;
+            ls->index++;
+            switch (lazy_peek(ls, 0)) {
+                case L'<':  /* here-string */
+                    ls->index++;
+                    break;
+                case L'-':
+                    ls->index++;
+                    skiptab = true;
+                    /* falls thru! */
+                default:
+                    heredoc = true;
+                    break;
+            }
+            break;
+        case L'>':
+            ls->index++;
+            if (c == L'>' && lazy_peek(ls, 0) == L'|')
+                ls->index++;
+            break;
+        case L'&':
+            ls->index++;
+            break;
+        case L'|':
+            if (c == L'>')
+                ls->index++;
+            break;
+    }
+
+    while (iswblank(lazy_peek(ls, 0)))
+        ls->index++;
+    if (lazy_peek(ls, 0) == L'\\' && lazy_peek(ls, 1) == L'\n')
+        return false;
+    if (is_token_delimiter_char(lazy_peek(ls, 0)))
+        return false;  /* the operand is missing */
+
+    size_t start = ls->index;
+    bool literal;
+    if (!lazy_scan_word(ls, &literal))
+        return false;
+    if (!heredoc)
+        return true;
+
+    wchar_t *eoc = xwcsndup(&ls->ps->src.contents[start], ls->index - start);
+    bool expand = wcspbrk(eoc, QUOTES) == NULL;
+    if (!expand) {
+        wchar_t *unquoted = unquote(eoc);
+        free(eoc);
+        if (unquoted == NULL)
+            return false;
+        eoc = unquoted;
+    }
+    if (wcschr(eoc, L'\n') != NULL) {
+        free(eoc);
+        return false;
+    }
+
+    lazyheredoc_T *h = xmalloc(sizeof *h);
+    h->eoc = eoc;
+    h->skiptab = skiptab;
+    h->expand = expand;
+    pl_add(&ls->heredocs, h);
+    return true;
+}
+
+/* Scans a word. The current position must be at the first character of the
+ * word. The position is advanced to the delimiter that ends the word.
+ * `*literalp' is set to true iff the word contains no quotations or
+ * expansions.
+ * Returns false if the word cannot be scanned. */
+bool lazy_scan_word(lazyscan_T *ls, bool *literalp)
+{
+    bool indq = false;  /* in double quotes? */
+    *literalp = true;
+
+    for (;;) {
+        wchar_t c = lazy_peek(ls, 0);
+        if (!indq && is_token_delimiter_char(c))
+            return true;
+
+        switch (c) {
+            case L'\0':
+                return false;
+            case L'\\':
+                /* A line continuation inside a word could join the word into
+                 * a reserved word, which the scanner does not try to find. */
+                *literalp = false;
+                if (lazy_peek(ls, 1) == L'\0' ||
+                        (!indq && lazy_peek(ls, 1) == L'\n'))
+                    return false;
+                ls->index += 2;
+                continue;
+            case L'\'':
+                *literalp = false;
+                ls->index++;
+                if (!indq) {
+                    while ((c = lazy_peek(ls, 0)) != L'\'') {
+                        if (c == L'\0')
+                            return false;
+                        ls->index++;
+                    }
+                    ls->index++;
+                }
+                continue;
+            case L'"':
+                *literalp = false;
+                indq = !indq;
+                ls->index++;
+                continue;
+            case L'$':
+            case L'`':
+                *literalp = false;
+                if (!lazy_scan_expansion(ls, indq))
+                    return false;
+                continue;
+            default:
+                ls->index++;
+                continue;
+        }
+    }
+}
+
+/* Scans an expansion or command substitution that starts with '$' or '`' at
+ * the current position. The position is advanced past the expansion.
+ * Between double quotes, `indq' must be true.
+ * Returns false if the expansion cannot be scanned. */
+bool lazy_scan_expansion(lazyscan_T *ls, bool indq)
+{
+    if (lazy_peek(ls, 0) == L'`') {
+        ls->index++;
+        for (;;) {
+            switch (lazy_peek(ls, 0)) {
+                case L'\0':
+                    return false;
+                case L'`':
+                    ls->index++;
+                    return true;
+                case L'\\':
+                    if (lazy_peek(ls, 1) == L'\0')
+                        return false;
+                    ls->index++;
+                    break;
+            }
+            ls->index++;
+        }
+    }
+
+    ls->index++;
+    switch (lazy_peek(ls, 0)) {
+        case L'{':
+            ls->index++;
+            return lazy_scan_braced_param(ls, indq);
+        case L'(':
+            if (lazy_peek(ls, 1) == L'(') {
+                ls->index += 2;
+                return lazy_scan_arith(ls);
+            }
+            /* Here-documents must not be pending across command
+             * substitutions. */
+            if (ls->heredocs.length > 0)
+                return false;
+            ls->index++;
+            return lazy_scan_commands(ls, true) && ls->heredocs.length == 0;
+        case L'\\':
+            return lazy_peek(ls, 1) != L'\n';
+        default:
+            return true;
+    }
+}
+
+/* Scans a parameter expansion enclosed in braces. The current position must be
+ * just after the opening brace. The position is advanced past the closing
+ * brace. Between double quotes, `indq' must be true.
+ * Returns false if the expansion cannot be scanned. */
+bool lazy_scan_braced_param(lazyscan_T *ls, bool indq)
+{
+    bool innerdq = false;  /* in double quotes inside the braces? */
+
+    for (;;) {
+        switch (lazy_peek(ls, 0)) {
+            case L'\0':
+                return false;
+            case L'}':
+                if (!innerdq) {
+                    ls->index++;
+                    return true;
+                }
+                break;
+            case L'\\':
+                if (lazy_peek(ls, 1) == L'\0')
+                    return false;
+                ls->index++;
+                break;
+            case L'\'':
+                if (innerdq)
+                    break;
+                /* Single quotes in a parameter expansion between double
+                 * quotes are not portable, so they are not scanned. */
+                if (indq)
+                    return false;
+                ls->index++;
+                while (lazy_peek(ls, 0) != L'\'') {
+                    if (lazy_peek(ls, 0) == L'\0')
+                        return false;
+                    ls->index++;
+                }
+                break;
+            case L'"':
+                innerdq = !innerdq;
+                break;
+            case L'$':
+            case L'`':
+                if (!lazy_scan_expansion(ls, indq || innerdq))
+                    return false;
+                continue;
+        }
+        ls->index++;
+    }
+}
+
+/* Scans an arithmetic expansion. The current position must be just after the
+ * opening "$((". The position is advanced past the closing "))".
+ * Returns false if the expansion cannot be scanned. Only expansions without
+ * quotations and command substitutions are scanned so that the scanner does
+ * not have to tell an arithmetic expansion from a command substitution that
+ * starts with a subshell. */
+bool lazy_scan_arith(lazyscan_T *ls)
+{
+    unsigned nest = 0;
+
+    for (;;) {
+        switch (lazy_peek(ls, 0)) {
+            case L'(':
+                nest++;
+                break;
+            case L')':
+                if (nest > 0) {
+                    nest--;
+                    break;
+                }
+                if (lazy_peek(ls, 1) != L')')
+                    return false;
+                ls->index += 2;
+                return true;
+            case L'$':
+                switch (lazy_peek(ls, 1)) {
+                    case L'(':
+                        return false;
+                    case L'{':
+                        ls->index += 2;
+                        if (!lazy_scan_braced_param(ls, false))
+                            return false;
+                        continue;
+                }
+                break;
+            case L'\0':  case L'\n':  case L'\\':
+            case L'\'':  case L'"':   case L'`':
+                return false;
+        }
+        ls->index++;
+    }
+}
+
+/* Skips the contents of the pending here-documents. The current position must
+ * be at the beginning of a line.
+ * Returns false if the contents cannot be skipped. */
+bool lazy_skip_heredocs(lazyscan_T *ls)
+{
+    bool ok = true;
+
+    for (size_t i = 0; ok && i < ls->heredocs.length; i++) {
+        const lazyheredoc_T *h = ls->heredocs.contents[i];
+        size_t eoclen = wcslen(h->eoc);
+
+        for (;;) {
+            size_t len = 0;
+            wchar_t c;
+            while ((c = lazy_peek(ls, len)) != L'\n') {
+                if (c == L'\0') {
+                    ok = false;  /* the contents are not closed */
+                    goto next;
+                }
+                len++;
+            }
+
+            const wchar_t *line = &ls->ps->src.contents[ls->index];
+            size_t skip = 0;
+            if (h->skiptab)
+                while (line[skip] == L'\t')
+                    skip++;
+            if (len - skip == eoclen &&
+                    wmemcmp(&line[skip], h->eoc, eoclen) == 0) {
+                ls->index += len + 1;
+                break;
+            }
+
+            /* A line continuation or a command substitution may join lines in
+             * a way the scanner cannot follow. */
+            if (h->expand && !is_self_contained_heredoc_line(line, len)) {
+                ok = false;
+                goto next;
+            }
+            ls->index += len + 1;
+        }
+next:;
+    }
+
+    pl_clear(&ls->heredocs, lazyheredocfree);
+    return ok;
+}
+
+/* Tests if the specified line of a here-document whose contents are subject to
+ * expansions is complete by itself, that is, the line does not end with a line
+ * continuation and contains no command substitution that may span lines. */
+bool is_self_contained_heredoc_line(const wchar_t *line, size_t len)
+{
+    if (len > 0 && line[len - 1] == L'\\')
+        return false;
+    if (wmemchr(line, L'`', len) != NULL)
+        return false;
+
+    size_t open = 0, close = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (line[i] == L'(')
+            open++;
+        else if (line[i] == L')')
+            close++;
+    }
+    return open == close;
+}
+
+/* Parses the source code of a `CT_LAZYGROUP' command into a `CT_GROUP'
+ * command. Returns NULL on a syntax error, in which case an error message is
+ * printed if `print_errmsg' is true. */
+command_T *parse_lazy_group_source(const command_T *c, bool print_errmsg)
+{
+    assert(c->c_type == CT_LAZYGROUP);
+
+    struct input_wcs_info_T winfo = {
+        .src = c->c_lazysrc,
+    };
+    parseparam_T info = {
+        .print_errmsg = print_errmsg,
+        .enable_verbose = false,
+        .enable_alias = false,
+        .filename = c->c_lazyfile,
+        .lineno = c->c_lineno,
+        .input = input_wcs,
+        .inputinfo = &winfo,
+        .interactive = false,
+        .arena = NULL,
+    };
+
+    /* The group was scanned in the non-POSIXly-correct mode, so it must be
+     * parsed in the same mode. */
+    bool saveposix = posixly_correct;
+    posixly_correct = false;
+    and_or_T *ao;
+    parseresult_T result = read_and_parse(&info, &ao);
+    posixly_correct = saveposix;
+    if (result != PR_OK)
+        return NULL;
+
+    /* The result must be the group alone. */
+    pipeline_T *p = (ao != NULL) ? ao->ao_pipelines : NULL;
+    command_T *group = (p != NULL) ? p->pl_commands : NULL;
+    if (group == NULL || winfo.src != NULL || ao->next != NULL ||
+            ao->ao_async || p->next != NULL || p->pl_neg || p->pl_time ||
+            group->next != NULL || group->c_type != CT_GROUP ||
+            group->c_redirs != NULL) {
+        parsestate_T ps = { .info = &info, };
+        serror(&ps, Ngt("a function body must be a compound command"));
+        andorsfree(ao);
+        return NULL;
+    }
+
+    group = comsdup(group);
+    andorsfree(ao);
+    return group;
+}
+
+/* Parses the contents of a `CT_LAZYGROUP' command and turns the command into a
+ * `CT_GROUP' command. Returns true iff successful. On a syntax error, an error
+ * message is printed and the command is unchanged. */
+bool parse_lazy_group(command_T *c)
+{
+    command_T *group = parse_lazy_group_source(c, true);
+    if (group == NULL)
+        return false;
+
+    free(c->c_lazysrc);
+    free(c->c_lazyfile);
+    c->c_type = CT_GROUP;
+    c->c_subcmds = group->c_subcmds;
+    group->c_subcmds = NULL;
+    comsfree(group);
+    return true;
+}
+
 /***** Here-document contents *****/
 
 /* Reads the contents of a here-document. */
@@ -3195,12 +4678,17 @@ void read_heredoc_contents_without_expansion(parsestate_T *ps, redir_T *r)
             break;
     }
     free(eoc);
-    
-    wordunit_T *wu = xmalloc(sizeof *wu);
-    wu->next = NULL;
-    wu->wu_type = WT_STRING;
-    wu->wu_string = escape(buf.contents, L"\\");
-    r->rd_herecontent = wu;
+
+    char *text = malloc_wcstombs(buf.contents);
+    if (text != NULL) {
+        r->rd_heretext = ptakestr(ps, text);
+    } else {
+        wordunit_T *wu = palloc(ps, sizeof *wu);
+        wu->next = NULL;
+        wu->wu_type = WT_STRING;
+        wu->wu_string = ptakewcs(ps, escape(buf.contents, L"\\"));
+        r->rd_herecontent = wu;
+    }
 
     wb_destroy(&buf);
 }
@@ -3369,6 +4857,10 @@ static void print_group(
         struct print *restrict pr, const command_T *restrict command,
         unsigned indent)
     __attribute__((nonnull));
+static void print_lazy_group(
+        struct print *restrict pr, const command_T *restrict command,
+        unsigned indent)
+    __attribute__((nonnull));
 static void print_subshell(
         struct print *restrict pr, const command_T *restrict command,
         unsigned indent)
@@ -3495,6 +4987,8 @@ void print_pipelines(struct print *restrict pr, const pipeline_T *restrict pl,
         return;
     for (;;) {
         print_indent(pr, indent);
+        if (pl->pl_time)
+            wb_cat(&pr->buffer, pl->pl_posixtime ? L"time -p " : L"time ");
         if (pl->pl_neg)
             wb_cat(&pr->buffer, L"! ");
         print_commands(pr, pl->pl_commands, indent);
@@ -3558,6 +5052,9 @@ void print_one_command(
             print_function_definition(pr, c, indent);
             assert(c->c_redirs == NULL);
             return;  // break;
+        case CT_LAZYGROUP:
+            print_lazy_group(pr, c, indent);
+            break;
     }
     print_redirections(pr, c->c_redirs, indent);
 }
@@ -3596,6 +5093,21 @@ void print_group(
     wb_cat(&pr->buffer, L"} ");
 }
 
+/* Prints a lazily parsed group in the same format as a normal group. If the
+ * group contains a syntax error, its source code is printed as is. */
+void print_lazy_group(
+        struct print *restrict pr, const command_T *restrict c, unsigned indent)
+{
+    command_T *group = parse_lazy_group_source(c, false);
+    if (group != NULL) {
+        print_group(pr, group, indent);
+        comsfree(group);
+    } else {
+        wb_cat(&pr->buffer, c->c_lazysrc);
+        wb_wccat(&pr->buffer, L' ');
+    }
+}
+
 void print_subshell(
         struct print *restrict pr, const command_T *restrict c, unsigned indent)
 {
@@ -3812,6 +5324,8 @@ void print_assignments(
 {
     while (a != NULL) {
         wb_cat(&pr->buffer, a->a_name);
+        if (a->a_append)
+            wb_wccat(&pr->buffer, L'+');
         wb_wccat(&pr->buffer, L'=');
         switch (a->a_type) {
             case A_SCALAR:
@@ -4032,7 +5546,10 @@ void print_pending_heredocs(struct print* pr)
 {
     for (size_t i = 0; i < pr->pending_heredocs.length; i++) {
         const redir_T *rd = pr->pending_heredocs.contents[i];
-        print_word(pr, rd->rd_herecontent, 0);
+        if (rd->rd_heretext != NULL)
+            wb_mbscat(&pr->buffer, rd->rd_heretext);
+        else
+            print_word(pr, rd->rd_herecontent, 0);
         wb_catfree(&pr->buffer, unquote(rd->rd_hereend));
         wb_wccat(&pr->buffer, L'\n');
     }
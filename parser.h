@@ -46,10 +46,14 @@ typedef struct and_or_T {
 typedef struct pipeline_T {
     struct pipeline_T *next;
     struct command_T  *pl_commands;  /* commands in this pipeline */
-    _Bool              pl_neg, pl_cond;
+    _Bool              pl_neg, pl_cond, pl_time, pl_posixtime;
 } pipeline_T;
 /* pl_neg:  indicates this pipeline is prefix by "!", in which case the exit
  *          status of the pipeline is inverted.
+ * pl_time: indicates this pipeline is prefixed by "time", in which case the
+ *          time and resources consumed by the pipeline are reported.
+ * pl_posixtime: indicates "time" has the -p option, in which case the report
+ *          is in the POSIX format regardless of $TIMEFORMAT.
  * pl_cond: true if prefixed by "&&", false by "||". Ignored for the first
  *          pipeline in an and/or list. */
 
@@ -66,8 +70,22 @@ typedef enum {
     CT_BRACKET,    /* double-bracket command */
 #endif
     CT_FUNCDEF,    /* function definition */
+    CT_LAZYGROUP,  /* command group whose contents are not yet parsed */
 } commandtype_T;
 
+/* result of command search cached in a simple command */
+typedef struct cmdcache_T {
+    unsigned long generation;  /* `command_generation' when cached */
+    _Bool         posix;       /* `posixly_correct' when cached */
+    int           type;        /* `cmdtype_T' defined in exec.c */
+    union {
+        int (*builtin)(int, void **);
+        struct command_T *function;
+    } value;
+} cmdcache_T;
+/* The cache is valid only if `generation' is non-zero and equals the current
+ * `command_generation' and `posix' equals `posixly_correct'. */
+
 /* command in a pipeline */
 typedef struct command_T {
     struct command_T *next;
@@ -79,6 +97,7 @@ typedef struct command_T {
         struct {
             struct assign_T *assigns;  /* assignments */
             void           **words;    /* command name and arguments */
+            cmdcache_T       cache;    /* cached search for command name */
         } simplecommand;
         struct and_or_T     *subcmds;  /* contents of command group */
         struct ifcommand_T  *ifcmds;   /* contents of if command */
@@ -101,10 +120,15 @@ typedef struct command_T {
             struct wordunit_T *funcname;  /* name of function */
             struct command_T  *funcbody;  /* body of function */
         } funcdef;
+        struct {
+            wchar_t *source;    /* source code of command group */
+            char    *filename;  /* name of file the source was read from */
+        } lazygroup;
     } c_content;
 } command_T;
 #define c_assigns  c_content.simplecommand.assigns
 #define c_words    c_content.simplecommand.words
+#define c_cache    c_content.simplecommand.cache
 #define c_subcmds  c_content.subcmds
 #define c_ifcmds   c_content.ifcmds
 #define c_forname  c_content.forloop.forname
@@ -118,10 +142,19 @@ typedef struct command_T {
 #define c_dbexp    c_content.dbexp
 #define c_funcname c_content.funcdef.funcname
 #define c_funcbody c_content.funcdef.funcbody
+#define c_lazysrc  c_content.lazygroup.source
+#define c_lazyfile c_content.lazygroup.filename
 /* `c_words' and `c_forwords' are NULL-terminated arrays of pointers to
  * `wordunit_T' that are cast to `void *'.
+ * `c_cache' is used by `exec_simple_command_with_words' in exec.c to skip the
+ * search for a command name that is a literal word. It must be initialized with
+ * zero `generation'.
  * If `c_forwords' is NULL, the for loop doesn't have the "in" clause.
- * If `c_forwords[0]' is NULL, the "in" clause exists and is empty. */
+ * If `c_forwords[0]' is NULL, the "in" clause exists and is empty.
+ * A `CT_LAZYGROUP' command is a function body that has been only scanned for
+ * its extent. `c_lazysrc' contains the whole group including the braces and
+ * `c_lineno' is the line number of the opening brace. The command turns into a
+ * `CT_GROUP' when `parse_lazy_group' is applied. `c_lazyfile' may be NULL. */
 
 /* condition and commands of an if command */
 typedef struct ifcommand_T {
@@ -269,6 +302,7 @@ typedef enum {
 typedef struct assign_T {
     struct assign_T *next;
     assigntype_T a_type;
+    _Bool a_append;  /* `name+=value' rather than `name=value' */
     wchar_t *a_name;
     union {
         struct wordunit_T *scalar;
@@ -307,6 +341,7 @@ typedef struct redir_T {
         struct {
             wchar_t *hereend;  /* token indicating end of here-document */
             struct wordunit_T *herecontent;  /* contents of here-document */
+            char *heretext;  /* literal contents of here-document */
         } heredoc;
         struct embedcmd_T command;
     } rd_value;
@@ -314,18 +349,24 @@ typedef struct redir_T {
 #define rd_filename    rd_value.filename
 #define rd_hereend     rd_value.heredoc.hereend
 #define rd_herecontent rd_value.heredoc.herecontent
+#define rd_heretext    rd_value.heredoc.heretext
 #define rd_command     rd_value.command
 /* For example, for "2>&1", `rd_type' = RT_DUPOUT, `rd_fd' = 2 and
  * `rd_filename' = "1".
  * For RT_HERERT, all the lines in `rd_herecontent' have the leading tabs
- * already removed. If `rd_hereend' is quoted, `rd_herecontent' is a single
- * word unit of type WT_STRING, since no parameter expansions are performed.
- * Anyway `rd_herecontent' is expanded by calling `expand_string' with `esc'
- * argument being true. */
+ * already removed. If `rd_hereend' is quoted, no parameter expansions are
+ * performed, so the contents are stored in `rd_heretext' as a multibyte string
+ * and `rd_herecontent' is NULL. (If the contents cannot be converted to a
+ * multibyte string, `rd_heretext' is NULL and `rd_herecontent' is a single
+ * word unit of type WT_STRING.)
+ * Otherwise `rd_heretext' is NULL and `rd_herecontent' is expanded by calling
+ * `expand_string' with `esc' argument being true. */
 
 
 /********** Interface to Parsing Routines **********/
 
+struct arena_T;
+
 /* Holds parameters that affect the behavior of parsing. */
 typedef struct parseparam_T {
     _Bool print_errmsg;   /* print error messages? */
@@ -337,10 +378,15 @@ typedef struct parseparam_T {
     void *inputinfo;      /* pointer passed to the input function */
     _Bool interactive;    /* input is interactive? */
     inputresult_T lastinputresult;  /* last return value of input function */
+    struct arena_T *arena;  /* arena for the parse tree, which may be NULL */
 } parseparam_T;
 /* If `interactive' is true, `input' is `input_interactive' and `inputinfo' is a
  * pointer to a `struct input_interactive_info_T' object.
- * Note that input may not be from a terminal even if `interactive' is true. */
+ * Note that input may not be from a terminal even if `interactive' is true.
+ * If `arena' is non-NULL, the parse tree is allocated in the arena and must not
+ * be freed by `andorsfree' or `wordfree'. It is freed when the arena is reset.
+ * Function bodies are allocated outside the arena so that they can outlive it;
+ * they are released by the arena's cleanup when the arena is reset. */
 
 typedef enum parseresult_T {
     PR_OK, PR_EOF, PR_SYNTAX_ERROR, PR_INPUT_ERROR,
@@ -354,6 +400,9 @@ extern parseresult_T read_and_parse(
 extern _Bool parse_string(parseparam_T *info, wordunit_T **restrict resultp)
     __attribute__((nonnull,warn_unused_result));
 
+extern _Bool parse_lazy_group(command_T *c)
+    __attribute__((nonnull));
+
 
 /********** Auxiliary Functions **********/
 
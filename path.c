@@ -31,11 +31,18 @@
 #if HAVE_PATHS_H
 # include <paths.h>
 #endif
+#if HAVE_PTHREAD
+# include <pthread.h>
+#endif
 #include <pwd.h>
+#if HAVE_PTHREAD
+# include <signal.h>
+#endif
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -47,6 +54,7 @@
 #include "hashtable.h"
 #include "option.h"
 #include "plist.h"
+#include "profiler.h"
 #include "redir.h"
 #include "sig.h"
 #include "strbuf.h"
@@ -70,6 +78,10 @@ extern int eaccess(const char *path, int amode)
 
 static bool check_access(const char *path, mode_t mode, int amode)
     __attribute__((nonnull));
+static unsigned long get_mtimensec(const struct stat *st)
+    __attribute__((nonnull,pure));
+static int compare_names(const void *p1, const void *p2)
+    __attribute__((nonnull,pure));
 
 /* Checks if `path' is an existing file. */
 bool is_file(const char *path)
@@ -351,12 +363,45 @@ int create_temporary_file(
 }
 
 
+/* Returns the nanosecond part of the modification time in `st', or zero if
+ * not supported. */
+unsigned long get_mtimensec(const struct stat *st)
+{
+#if HAVE_ST_MTIM
+    return (unsigned long) st->st_mtim.tv_nsec;
+#elif HAVE_ST_MTIMESPEC
+    return (unsigned long) st->st_mtimespec.tv_nsec;
+#elif HAVE_ST_MTIMENSEC
+    return (unsigned long) st->st_mtimensec;
+#elif HAVE___ST_MTIMENSEC
+    return (unsigned long) st->__st_mtimensec;
+#else
+    (void) st;
+    return 0;
+#endif
+}
+
+/* Compares two strings pointed to by `p1' and `p2' in the byte order. */
+int compare_names(const void *p1, const void *p2)
+{
+    return strcmp(*(char *const *) p1, *(char *const *) p2);
+}
+
+
 /********** Command Hashtable **********/
 
 static inline void forget_command_path(const char *command)
     __attribute__((nonnull));
 static wchar_t *get_default_path(void)
     __attribute__((malloc,warn_unused_result));
+static void load_cmdhash_cache(void);
+static void read_cmdhash_cache(
+        const char *map, size_t size, char *const *dirs)
+    __attribute__((nonnull));
+static char *get_cmdhash_cache_path(void)
+    __attribute__((malloc,warn_unused_result));
+static char **get_directory_status(char *const *dirs, bool *racyp)
+    __attribute__((malloc,warn_unused_result));
 
 /* A hashtable from command names to their full path.
  * Keys are pointers to a multibyte string containing a command name and
@@ -375,10 +420,53 @@ void init_cmdhash(void)
     ht_init(&cmdhash, hashstr, htstrcmp);
 }
 
+/* When the $YASH_HASH_CACHE variable names a file, the contents of the command
+ * hashtable are saved in the file when the shell exits, and the next shell
+ * with the same $PATH loads them when it first searches for a command.
+ *
+ * The file is a sequence of null-terminated strings:
+ *   the magic string,
+ *   the pathname and status of each directory in $PATH,
+ *   an empty string, and
+ *   the name and full pathname of each command.
+ * The status of a directory consists of its device number, i-node number, and
+ * modification time. A command is added to or removed from a directory only
+ * by modifying the directory, so the saved pathnames are valid as long as all
+ * the directories have the same status. The cache is not used if $PATH
+ * contains a relative pathname. */
+
+#define CMDHASH_MAGIC "yash command hash 1"
+
+/* True if the cache file has been checked since the command hashtable was last
+ * cleared. */
+static bool cmdhash_cache_checked = false;
+/* The status strings of the directories in $PATH at the time the cache file
+ * was checked. NULL if the cache is not used. */
+static char **cmdhash_dirstatus = NULL;
+/* True if the command hashtable has an entry not in the cache file. */
+static bool cmdhash_modified = false;
+
 /* Empties the command hashtable. */
 void clear_cmdhash(void)
 {
     ht_clear(&cmdhash, vfree);
+    plfree((void **) cmdhash_dirstatus, free);
+    cmdhash_dirstatus = NULL;
+    cmdhash_cache_checked = cmdhash_modified = false;
+}
+
+/* Computes the memory used for the command hashtable. The number of entries
+ * is assigned to `*countp' and the number of bytes allocated for them to
+ * `*bytesp'. */
+void cmdhash_memory_usage(size_t *countp, size_t *bytesp)
+{
+    size_t bytes = ht_memory_size(&cmdhash);
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&cmdhash, &i)).key != NULL)
+        bytes += strlen(kv.value) + 1;
+    *countp = cmdhash.count;
+    *bytesp = bytes;
 }
 
 /* Searches PATH for the specified command and returns its full pathname.
@@ -390,18 +478,25 @@ const char *get_command_path(const char *name, bool forcelookup)
 {
     const char *path;
 
+    if (!cmdhash_cache_checked)
+        load_cmdhash_cache();
+
     if (!forcelookup) {
         path = ht_get(&cmdhash, name).value;
-        if (path != NULL && path[0] == '/' && is_executable_regular(path))
+        if (path != NULL && path[0] == '/' && is_executable_regular(path)) {
+            count_stat(SC_HASH_HIT);
             return path;
+        }
     }
 
+    count_stat(SC_HASH_MISS);
     path = which(name, get_path_array(PA_PATH), is_executable_regular);
     if (path != NULL) {
         size_t namelen = strlen(name), pathlen = strlen(path);
         const char *nameinpath = path + pathlen - namelen;
         assert(strcmp(name, nameinpath) == 0);
         vfree(ht_set(&cmdhash, nameinpath, path));
+        cmdhash_modified = true;
     } else {
         forget_command_path(name);
     }
@@ -414,6 +509,208 @@ void forget_command_path(const char *command)
     vfree(ht_remove(&cmdhash, command));
 }
 
+/* Enters the commands in the cache file into the command hashtable if the
+ * file is valid for the current $PATH. */
+void load_cmdhash_cache(void)
+{
+    cmdhash_cache_checked = true;
+
+    char *cachepath = get_cmdhash_cache_path();
+    if (cachepath == NULL)
+        return;
+
+    char *const *dirs = get_path_array(PA_PATH);
+    if (dirs != NULL)
+        cmdhash_dirstatus = get_directory_status(dirs, NULL);
+    if (cmdhash_dirstatus == NULL)
+        goto end;
+
+    int fd = open(cachepath, O_RDONLY);
+    if (fd < 0)
+        goto end;
+
+    /* The cache file must not be writable by other users, since it determines
+     * the programs to execute. */
+    struct stat st;
+    if (fstat(fd, &st) >= 0 && S_ISREG(st.st_mode) &&
+            st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH)) &&
+            st.st_size > 0 && (uintmax_t) st.st_size <= SIZE_MAX) {
+        size_t size = (size_t) st.st_size;
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            read_cmdhash_cache(map, size, dirs);
+            munmap(map, size);
+        }
+    }
+    xclose(fd);
+end:
+    free(cachepath);
+}
+
+/* Enters the commands in the mapped cache file into the command hashtable.
+ * Nothing is entered unless the header of the file matches `dirs' and
+ * `cmdhash_dirstatus'. */
+void read_cmdhash_cache(const char *map, size_t size, char *const *dirs)
+{
+    const char *p = map, *end = map + size;
+    if (end[-1] != '\0')
+        return;
+#define NEXT_STRING (p += strlen(p) + 1)
+
+    if (strcmp(p, CMDHASH_MAGIC) != 0)
+        return;
+    NEXT_STRING;
+    for (size_t i = 0; dirs[i] != NULL; i++) {
+        if (p == end || strcmp(p, dirs[i]) != 0)
+            return;
+        NEXT_STRING;
+        if (p == end || strcmp(p, cmdhash_dirstatus[i]) != 0)
+            return;
+        NEXT_STRING;
+    }
+    if (p == end || *p != '\0')
+        return;
+    NEXT_STRING;
+
+    while (p != end) {
+        const char *name = p;
+        NEXT_STRING;
+        if (p == end)
+            return;
+        const char *path = p;
+        NEXT_STRING;
+
+        size_t namelen = strlen(name), pathlen = strlen(path);
+        if (namelen == 0 || strchr(name, '/') != NULL || path[0] != '/' ||
+                pathlen <= namelen || path[pathlen - namelen - 1] != '/' ||
+                strcmp(path + pathlen - namelen, name) != 0)
+            continue;
+        if (ht_get(&cmdhash, name).value != NULL)
+            continue;
+
+        char *value = xstrdup(path);
+        ht_set(&cmdhash, value + pathlen - namelen, value);
+    }
+#undef NEXT_STRING
+}
+
+/* Saves the command hashtable in the cache file if it has been modified since
+ * loaded and the directories in $PATH have not been modified.
+ * This function does nothing in a subshell. Errors are silently ignored. */
+void finalize_cmdhash(void)
+{
+    if (!cmdhash_modified || cmdhash_dirstatus == NULL
+            || getpid() != shell_pid)
+        return;
+    cmdhash_modified = false;
+
+    char *cachepath = get_cmdhash_cache_path();
+    if (cachepath == NULL)
+        return;
+
+    /* If a directory was modified in this second, another modification in the
+     * same second may not change its modification time. */
+    bool racy;
+    char *const *dirs = get_path_array(PA_PATH);
+    char **status = (dirs != NULL) ? get_directory_status(dirs, &racy) : NULL;
+    if (status == NULL || racy)
+        goto end;
+    for (size_t i = 0; status[i] != NULL; i++)
+        if (cmdhash_dirstatus[i] == NULL
+                || strcmp(status[i], cmdhash_dirstatus[i]) != 0)
+            goto end;
+
+    xstrbuf_T buf;
+    sb_init(&buf);
+    sb_ncat_force(&buf, CMDHASH_MAGIC, strlen(CMDHASH_MAGIC) + 1);
+    for (size_t i = 0; dirs[i] != NULL; i++) {
+        sb_ncat_force(&buf, dirs[i], strlen(dirs[i]) + 1);
+        sb_ncat_force(&buf, status[i], strlen(status[i]) + 1);
+    }
+    sb_ccat(&buf, '\0');
+
+    size_t index = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&cmdhash, &index)).key != NULL) {
+        const char *path = kv.value;
+        if (path[0] != '/')
+            continue;
+        sb_ncat_force(&buf, kv.key, strlen(kv.key) + 1);
+        sb_ncat_force(&buf, path, strlen(path) + 1);
+    }
+
+    xstrbuf_T tmppath;
+    sb_initwith(&tmppath, xstrdup(cachepath));
+    sb_printf(&tmppath, ".%jd", (intmax_t) getpid());
+    int fd = open(tmppath.contents, O_WRONLY | O_CREAT | O_EXCL,
+            S_IRUSR | S_IWUSR);
+    if (fd >= 0) {
+        bool ok = write_all(fd, buf.contents, buf.length);
+        if (close(fd) < 0)
+            ok = false;
+        if (!ok || rename(tmppath.contents, cachepath) < 0)
+            unlink(tmppath.contents);
+    }
+    sb_destroy(&tmppath);
+    sb_destroy(&buf);
+end:
+    plfree((void **) status, free);
+    free(cachepath);
+}
+
+/* Removes the cache file of the command hashtable, if any. */
+void remove_cmdhash_cache(void)
+{
+    char *cachepath = get_cmdhash_cache_path();
+    if (cachepath != NULL) {
+        unlink(cachepath);
+        free(cachepath);
+    }
+}
+
+/* Returns the value of $YASH_HASH_CACHE as a newly malloced multibyte string.
+ * Returns NULL if the variable is not set or empty. */
+char *get_cmdhash_cache_path(void)
+{
+    const wchar_t *path = getvar(L VAR_YASH_HASH_CACHE);
+    if (path == NULL || path[0] == L'\0')
+        return NULL;
+    return malloc_wcstombs(path);
+}
+
+/* Returns a newly malloced array of newly malloced strings that describe the
+ * status of the directories in `dirs'. Returns NULL if any of `dirs' is a
+ * relative pathname. If `racyp' is non-NULL, it is set to whether any of the
+ * directories was modified in the current second. */
+char **get_directory_status(char *const *dirs, bool *racyp)
+{
+    time_t now = time(NULL);
+    plist_T list;
+    xstrbuf_T buf;
+
+    if (racyp != NULL)
+        *racyp = false;
+    pl_init(&list);
+    for (size_t i = 0; dirs[i] != NULL; i++) {
+        if (dirs[i][0] != '/') {
+            plfree(pl_toary(&list), free);
+            return NULL;
+        }
+
+        struct stat st;
+        sb_init(&buf);
+        if (stat(dirs[i], &st) >= 0) {
+            sb_printf(&buf, "%jx %jx %jd.%09lu",
+                    (uintmax_t) st.st_dev, (uintmax_t) st.st_ino,
+                    (intmax_t) st.st_mtime, get_mtimensec(&st));
+            if (racyp != NULL && st.st_mtime >= now)
+                *racyp = true;
+        }
+        pl_add(&list, sb_tostr(&buf));
+    }
+    return (char **) pl_toary(&list);
+}
+
 /* Last result of `get_command_path_default'. */
 static char *gcpd_value = NULL;
 /* Paths for `get_command_path_default'. */
@@ -466,6 +763,269 @@ wchar_t *get_default_path(void)
 }
 
 
+#if YASH_ENABLE_LINEEDIT
+
+/********** Command Directory Cache **********/
+
+/* A sorted listing of a directory in PATH. */
+typedef struct cmddir_T {
+    dev_t cd_dev;
+    ino_t cd_ino;
+    time_t cd_mtime;
+    unsigned long cd_mtimensec;
+    bool cd_racy;  /* the directory was modified when it was being listed */
+    size_t cd_count;
+    char **cd_names;
+    char cd_path[];
+} cmddir_T;
+
+static cmddir_T *read_command_directory(
+        const char *path, const struct stat *st)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static void free_command_directory(kvpair_T kv);
+
+/* A hashtable from directory pathnames to their listings.
+ * Keys are the `cd_path' members of the values, which are pointers to
+ * `cmddir_T' objects. A listing is used only while the directory has the same
+ * device number, i-node number, and modification time as when it was read, so
+ * a directory is re-read only after a file is added to or removed from it. */
+static hashtable_T cmddirhash;
+
+/* Returns the names of the files in the specified directory, sorted in the
+ * byte order. The number of the names is assigned to `*countp'.
+ * The listing is cached and re-read only when the directory has been
+ * modified. Returns NULL if the directory cannot be read.
+ * The result is valid until the next call to this function or
+ * `forget_command_directories'. The caller must not modify it. */
+char *const *get_command_directory_entries(
+        const char *restrict path, size_t *restrict countp)
+{
+    struct stat st;
+
+    if (cmddirhash.capacity == 0)
+        ht_init(&cmddirhash, hashstr, htstrcmp);
+
+    cmddir_T *dir = ht_get(&cmddirhash, path).value;
+    if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) {
+        if (dir != NULL)
+            free_command_directory(ht_remove(&cmddirhash, path));
+        return NULL;
+    }
+
+    if (dir == NULL || dir->cd_racy
+            || dir->cd_dev != st.st_dev || dir->cd_ino != st.st_ino
+            || dir->cd_mtime != st.st_mtime
+            || dir->cd_mtimensec != get_mtimensec(&st)) {
+        cmddir_T *newdir = read_command_directory(path, &st);
+        if (newdir == NULL) {
+            if (dir != NULL)
+                free_command_directory(ht_remove(&cmddirhash, path));
+            return NULL;
+        }
+        free_command_directory(ht_set(&cmddirhash, newdir->cd_path, newdir));
+        dir = newdir;
+    }
+
+    *countp = dir->cd_count;
+    return dir->cd_names;
+}
+
+/* Reads the specified directory and returns a new listing of it.
+ * `st' must be the result of `stat' for the directory. */
+cmddir_T *read_command_directory(const char *path, const struct stat *st)
+{
+    DIR *d = opendir(path);
+    if (d == NULL)
+        return NULL;
+
+    time_t now = time(NULL);
+    plist_T names;
+    struct dirent *de;
+    pl_init(&names);
+    while ((de = readdir(d)) != NULL)
+        pl_add(&names, xstrdup(de->d_name));
+    closedir(d);
+    qsort(names.contents, names.length, sizeof *names.contents, compare_names);
+
+    cmddir_T *dir = xmallocs(sizeof *dir,
+            add(strlen(path), 1), sizeof *dir->cd_path);
+    dir->cd_dev = st->st_dev;
+    dir->cd_ino = st->st_ino;
+    dir->cd_mtime = st->st_mtime;
+    dir->cd_mtimensec = get_mtimensec(st);
+    /* If the directory was modified in the same second as it was read, a
+     * later modification in that second may not change the modification
+     * time, so the listing must be re-read next time. */
+    dir->cd_racy = (st->st_mtime >= now);
+    dir->cd_count = names.length;
+    dir->cd_names = (char **) pl_toary(&names);
+    strcpy(dir->cd_path, path);
+    return dir;
+}
+
+/* Frees the `cmddir_T' object in the value of `kv', if any. */
+void free_command_directory(kvpair_T kv)
+{
+    cmddir_T *dir = kv.value;
+    if (dir != NULL) {
+        plfree((void **) dir->cd_names, free);
+        free(dir);
+    }
+}
+
+/* Returns the index of the first name in the sorted array `names' that is not
+ * less than `prefix'. Names starting with `prefix' follow the index. */
+size_t search_command_directory_entries(
+        char *const *names, size_t count, const char *prefix)
+{
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(names[mid], prefix) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Removes cached directory listings for directories not in `dirs', which
+ * should be the new value of PATH. Directories remaining in PATH keep their
+ * listings, so only directories added to PATH are read by the next
+ * completion. */
+void forget_command_directories(char *const *dirs)
+{
+    size_t index = 0;
+    kvpair_T kv;
+    plist_T removed;
+
+    if (cmddirhash.capacity == 0)
+        return;
+
+    pl_init(&removed);
+    while ((kv = ht_next(&cmddirhash, &index)).key != NULL) {
+        bool found = false;
+        if (dirs != NULL)
+            for (char *const *d = dirs; !found && *d != NULL; d++)
+                found = (strcmp(*d, kv.key) == 0);
+        if (!found)
+            pl_add(&removed, kv.key);
+    }
+    for (size_t i = 0; i < removed.length; i++)
+        free_command_directory(ht_remove(&cmddirhash, removed.contents[i]));
+    pl_destroy(&removed);
+}
+
+#endif /* YASH_ENABLE_LINEEDIT */
+
+
+/********** Load Path Index **********/
+
+/* A sorted listing of a directory under $YASH_LOADPATH. */
+typedef struct loaddir_T {
+    char **ld_names;
+    char ld_path[];
+} loaddir_T;
+
+static char **get_loadpath_directory(const char *path)
+    __attribute__((nonnull));
+static void free_loadpath_directory(kvpair_T kv);
+
+/* A hashtable from directory pathnames to their listings.
+ * Keys are the `ld_path' members of the values, which are pointers to
+ * `loaddir_T' objects. A directory is read only once and the listing is kept
+ * until the index is cleared, so searching $YASH_LOADPATH for a file that does
+ * not exist needs no file system access after the first search. */
+static hashtable_T loadpathindex;
+
+/* Searches $YASH_LOADPATH for a readable regular file with the specified name,
+ * which may contain slashes. Returns the full pathname of the file as a newly
+ * malloced string or NULL if not found.
+ * This function is equivalent to
+ * `which(name, get_path_array(PA_LOADPATH), is_readable_regular)' except that
+ * the contents of the directories are looked up in the index. Relative
+ * pathnames in $YASH_LOADPATH are searched without using the index. */
+char *which_in_loadpath(const char *name)
+{
+    char *const *dirs = get_path_array(PA_LOADPATH);
+    const char *base = strrchr(name, '/');
+    base = (base == NULL) ? name : base + 1;
+    if (dirs == NULL || name[0] == '/' || base[0] == '\0')
+        return which(name, dirs, is_readable_regular);
+
+    if (loadpathindex.capacity == 0)
+        ht_init(&loadpathindex, hashstr, htstrcmp);
+
+    size_t dirpartlen = base - name;
+    xstrbuf_T path;
+    sb_init(&path);
+    for (const char *dir; (dir = *dirs) != NULL; dirs++) {
+        sb_cat(&path, dir);
+        if (path.length > 0 && path.contents[path.length - 1] != '/')
+            sb_ccat(&path, '/');
+        sb_ncat_force(&path, name, dirpartlen);
+
+        if (dir[0] == '/') {
+            char **names = get_loadpath_directory(path.contents);
+            if (bsearch(&base, names, plcount((void **) names),
+                        sizeof *names, compare_names) == NULL)
+                goto next;
+        }
+
+        sb_cat(&path, base);
+        if (is_readable_regular(path.contents))
+            return sb_tostr(&path);
+next:
+        sb_clear(&path);
+    }
+    sb_destroy(&path);
+    return NULL;
+}
+
+/* Returns the sorted list of the names of the files in the specified
+ * directory, reading the directory if it is not yet in the index.
+ * If the directory cannot be read, the list is empty. */
+char **get_loadpath_directory(const char *path)
+{
+    loaddir_T *ld = ht_get(&loadpathindex, path).value;
+    if (ld != NULL)
+        return ld->ld_names;
+
+    plist_T list;
+    pl_init(&list);
+
+    DIR *dir = opendir(path);
+    if (dir != NULL) {
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL)
+            pl_add(&list, xstrdup(de->d_name));
+        closedir(dir);
+    }
+    qsort(list.contents, list.length, sizeof *list.contents, compare_names);
+
+    ld = xmallocs(sizeof *ld, add(strlen(path), 1), sizeof *ld->ld_path);
+    ld->ld_names = (char **) pl_toary(&list);
+    strcpy(ld->ld_path, path);
+    ht_set(&loadpathindex, ld->ld_path, ld);
+    return ld->ld_names;
+}
+
+/* Frees the `loaddir_T' object in the value of `kv'. */
+void free_loadpath_directory(kvpair_T kv)
+{
+    loaddir_T *ld = kv.value;
+    plfree((void **) ld->ld_names, free);
+    free(ld);
+}
+
+/* Empties the index of $YASH_LOADPATH.
+ * This function must be called when $YASH_LOADPATH is changed. */
+void clear_loadpath_index(void)
+{
+    ht_clear(&loadpathindex, free_loadpath_directory);
+}
+
+
 /********** Home Directory Cache **********/
 
 static struct passwd *xgetpwnam(const char *name)
@@ -577,6 +1137,8 @@ struct wglob_search {
     xstrbuf_T path;
     xwcsbuf_T wpath;
     plist_T *results;
+    unsigned long scancount;
+    struct wglob_pool *pool;
 };
 /* `pattern' is an array of pointers to struct wglob_pattern objects. Each
  * wglob_pattern object is called a "component", which corresponds to one
@@ -584,21 +1146,36 @@ struct wglob_search {
  * `path' and `wpath' are intermediate pathnames, denoting the currently
  * searched directory. They are the multi-byte and wide string versions of the
  * same pathname. The multi-byte version is mainly used for calling OS APIs and
- * the wide version for producing the final results. */
+ * the wide version for producing the final results.
+ * `scancount' is the number of directories scanned, which is added to the
+ * statistics counter when the search finishes.
+ * `pool' is the pool of the worker threads if this search is performed by
+ * `wglob_worker', or NULL otherwise. */
 
 /* Data used in search for one level of directory */
 struct wglob_stack {
     const struct wglob_stack *prev;
     struct stat st;
+    int parentfd;
+    const char *name;
     unsigned char active_components[];
 };
 /* `st' is mainly used to detect recursion into the same directory and prevent
  * infinite search.
+ * If `parentfd' is not negative, it is a file descriptor open for the parent
+ * directory of the directory of this stack frame, and `name' is the name of
+ * the directory in the parent. They allow opening the directory without
+ * resolving the whole intermediate pathname again.
  * The length of `active_components' is the same as that of `pattern' in `struct
  * wglob_search'. When an item of `active_components' is zero, the component is
  * not active. When non-zero, it is active. For a recursive search component,
  * the value is the depth of the current recursion. */
 
+/* Type of a directory entry known without calling `stat' */
+enum wglob_filetype_T {
+    WGLOB_UNKNOWN, WGLOB_DIRECTORY, WGLOB_SYMLINK, WGLOB_OTHER,
+};
+
 /* The wglob search algorithm used to perform naive search, but it was slow when
  * the pattern contained more than one recursive search component */
 // (e.g. foo/**/bar/**/baz)
@@ -629,6 +1206,8 @@ static inline struct wglob_stack *wglob_stack_new(
 static void wglob_search(
         struct wglob_search *restrict s, struct wglob_stack *restrict t)
     __attribute__((nonnull));
+static bool wglob_is_interrupted(const struct wglob_search *s)
+    __attribute__((nonnull));
 static void wglob_search_literal_each(
         struct wglob_search *restrict s, const struct wglob_stack *restrict t)
     __attribute__((nonnull));
@@ -641,22 +1220,34 @@ static void wglob_search_literal_uniq(
 static bool wglob_scandir(
         struct wglob_search *restrict s, const struct wglob_stack *restrict t)
     __attribute__((nonnull));
+static DIR *wglob_opendir(
+        const struct wglob_search *s, const struct wglob_stack *t)
+    __attribute__((nonnull));
+static enum wglob_filetype_T wglob_filetype(const struct dirent *de)
+    __attribute__((nonnull,pure));
+#if HAVE_PTHREAD
+static bool wglob_scandir_parallel(
+        DIR *dir, int dirfd,
+        struct wglob_search *restrict s, const struct wglob_stack *restrict t)
+    __attribute__((nonnull));
+static void *wglob_worker(void *pool)
+    __attribute__((nonnull));
+#endif
 static void wglob_scandir_entry(
-        const char *name, struct wglob_search *restrict s,
+        const char *name, int dirfd, enum wglob_filetype_T type,
+        struct wglob_search *restrict s,
         const struct wglob_stack *restrict t, struct wglob_stack *restrict t2,
         bool only_if_existing)
     __attribute__((nonnull));
 static bool wglob_should_recurse(
-        const char *restrict name, const char *restrict path,
+        const char *restrict name, int dirfd, enum wglob_filetype_T type,
+        struct wglob_search *restrict s,
         const struct wglob_pattern *restrict c, struct wglob_stack *restrict t,
         size_t count)
     __attribute__((nonnull));
 static bool wglob_is_reentry(const struct wglob_stack *const t, size_t count)
     __attribute__((nonnull,pure));
 
-static int wglob_sortcmp(const void *v1, const void *v2)
-    __attribute__((pure,nonnull));
-
 /* A wide string version of `glob'.
  * Adds all pathnames that matches the specified pattern to the specified list.
  * pattern: the pattern to match
@@ -666,6 +1257,7 @@ static int wglob_sortcmp(const void *v1, const void *v2)
  *          WGLB_PERIOD:   L'*' and L'?' match L'.' at the beginning
  *          WGLB_NOSORT:   don't sort resulting items
  *          WGLB_RECDIR:   allow recursive search with L"**"
+ *          WGLB_PARALLEL: scan subdirectories in recursive search in parallel
  * list:    a list of pointers to wide strings to which resulting items are
  *          added.
  * Returns true iff successful. However, some result items may be added to the
@@ -690,11 +1282,14 @@ bool wglob(const wchar_t *restrict pattern, enum wglobflags_T flags,
     sb_init(&s.path);
     wb_init(&s.wpath);
     s.results = list;
+    s.scancount = 0;
+    s.pool = NULL;
 
     struct wglob_stack *t = wglob_stack_new(&s, NULL);
     t->active_components[0] = 1;
 
     wglob_search(&s, t);
+    stat_counts[SC_GLOB_DIR] += s.scancount;
 
     free(t);
 
@@ -704,7 +1299,8 @@ bool wglob(const wchar_t *restrict pattern, enum wglobflags_T flags,
 
     if (!(flags & WGLB_NOSORT)) {
         size_t count = list->length - listbase;  /* # of resulting items */
-        qsort(list->contents + listbase, count, sizeof (void *), wglob_sortcmp);
+        sort_by_collation(list->contents + listbase, count, sizeof (void *),
+                (const wchar_t *const *) (list->contents + listbase));
     }
     return !is_interrupted();
 }
@@ -828,6 +1424,8 @@ struct wglob_stack *wglob_stack_new(
     struct wglob_stack *t =
         xmallocs(sizeof *t, sizeof *t->active_components, s->pattern.length);
     t->prev = prev;
+    t->parentfd = -1;
+    t->name = NULL;
     memset(t->active_components, 0, s->pattern.length);
     return t;
 }
@@ -846,7 +1444,7 @@ void wglob_search(
     assert(s->wpath.length == 0 ||
             s->wpath.contents[s->wpath.length - 1] == L'/');
 
-    if (is_interrupted())
+    if (wglob_is_interrupted(s))
         return;
 
     /* find active WGLOB_RECSEARCH components and activate their next component
@@ -982,7 +1580,8 @@ void wglob_search_literal_uniq(
     for (const kvpair_T *n = names; n->key != NULL; n++) {
         const struct wglob_pattern *c = n->value;
         memset(t2->active_components, 0, s->pattern.length);
-        wglob_scandir_entry(c->value.literal.name, s, t, t2, true);
+        wglob_scandir_entry(
+                c->value.literal.name, -1, WGLOB_UNKNOWN, s, t, t2, true);
     }
 
     free(t2);
@@ -995,45 +1594,272 @@ void wglob_search_literal_uniq(
 bool wglob_scandir(
         struct wglob_search *restrict s, const struct wglob_stack *restrict t)
 {
-    DIR* dir = opendir((s->path.length == 0) ? "." : s->path.contents);
+    DIR *dir = wglob_opendir(s, t);
     if (dir == NULL)
         return false;
+    s->scancount++;
+
+#if HAVE_FDOPENDIR
+    int fd = dirfd(dir);
+#else
+    int fd = -1;
+#endif
 
     struct wglob_stack *t2 = wglob_stack_new(s, t);
 
     /* An empty name, which is needed for empty literal components, must be
      * explicitly produced as it would never be returned from readdir. */
-    wglob_scandir_entry("", s, t, t2, true);
+    wglob_scandir_entry("", -1, WGLOB_UNKNOWN, s, t, t2, true);
+
+#if HAVE_PTHREAD
+    if (s->flags & WGLB_PARALLEL) {
+        for (size_t i = 0; i < s->pattern.length; i++) {
+            const struct wglob_pattern *c = s->pattern.contents[i];
+            if (t->active_components[i] && c->type == WGLOB_RECSEARCH) {
+                if (wglob_scandir_parallel(dir, fd, s, t))
+                    goto done;
+                break;
+            }
+        }
+    }
+#endif
 
     /* now try each directory entry */
     struct dirent *de;
     while ((de = readdir(dir)) != NULL) {
         memset(t2->active_components, 0, s->pattern.length);
-        wglob_scandir_entry(de->d_name, s, t, t2, false);
+        wglob_scandir_entry(
+                de->d_name, fd, wglob_filetype(de), s, t, t2, false);
     }
+
+#if HAVE_PTHREAD
+done:
+#endif
     closedir(dir);
 
     free(t2);
     return true;
 }
 
+#if HAVE_PTHREAD
+
+/* Number of threads that scan directories in `wglob_scandir_parallel' */
+#define WGLOB_THREADS 4
+
+/* A directory entry to be searched by a worker thread */
+struct wglob_task {
+    char *name;
+    enum wglob_filetype_T type;
+    plist_T results;
+};
+
+/* Data shared by the worker threads */
+struct wglob_pool {
+    const struct wglob_search *search;
+    const struct wglob_stack *stack;
+    int dirfd;
+    plist_T tasks;
+    size_t next;
+    unsigned long scancount;
+    bool interrupted;
+    pthread_t mainthread;
+    pthread_mutex_t mutex;
+};
+/* `search' and `stack' are those of the directory being scanned. They are only
+ * read by the workers.
+ * `tasks' is a list of pointers to `struct wglob_task's and `next' is the index
+ * of the task to be performed next. `scancount' is the sum of the numbers of
+ * directories scanned by the workers. `interrupted' is set when the calling
+ * thread finds the shell interrupted, which tells the other threads to stop.
+ * `mainthread' is the calling thread, the only one that may examine the
+ * signal handlers' flags. `next', `scancount' and `interrupted' are protected
+ * by `mutex'. */
+
+/* Searches the entries of the directory `dir' in parallel.
+ * The entries are first read into a task list, which is shared by the calling
+ * thread and up to (WGLOB_THREADS - 1) new threads. Each task collects its
+ * results in its own list, and the lists are concatenated in the order of the
+ * entries, so the results are the same as those of the sequential search.
+ * All signals are blocked in the new threads so that signal handlers are only
+ * run by the calling thread.
+ * Returns false without reading the directory if the threads cannot be
+ * synchronized, in which case the caller should search sequentially. */
+bool wglob_scandir_parallel(
+        DIR *dir, int dirfd,
+        struct wglob_search *restrict s, const struct wglob_stack *restrict t)
+{
+    struct wglob_pool pool = {
+        .search = s, .stack = t, .dirfd = dirfd, .next = 0, .scancount = 0,
+        .interrupted = false, .mainthread = pthread_self(),
+    };
+    if (pthread_mutex_init(&pool.mutex, NULL) != 0)
+        return false;
+    pl_init(&pool.tasks);
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        struct wglob_task *task = xmalloc(sizeof *task);
+        task->name = xstrdup(de->d_name);
+        task->type = wglob_filetype(de);
+        pl_init(&task->results);
+        pl_add(&pool.tasks, task);
+    }
+
+    pthread_t threads[WGLOB_THREADS - 1];
+    size_t threadcount = 0;
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    while (threadcount < WGLOB_THREADS - 1 &&
+            threadcount + 1 < pool.tasks.length &&
+            pthread_create(&threads[threadcount], NULL,
+                wglob_worker, &pool) == 0)
+        threadcount++;
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    wglob_worker(&pool);
+
+    for (size_t i = 0; i < threadcount; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&pool.mutex);
+    s->scancount += pool.scancount;
+
+    for (size_t i = 0; i < pool.tasks.length; i++) {
+        struct wglob_task *task = pool.tasks.contents[i];
+        pl_ncat(s->results, task->results.contents, task->results.length);
+        pl_destroy(&task->results);
+        free(task->name);
+        free(task);
+    }
+    pl_destroy(&pool.tasks);
+    return true;
+}
+
+/* Performs tasks in the pool until all tasks are taken.
+ * Each worker has its own copy of the intermediate pathnames. Since it never
+ * uses the WGLB_PARALLEL flag, the search does not fan out any further. */
+void *wglob_worker(void *p)
+{
+    struct wglob_pool *pool = p;
+    struct wglob_search s = {
+        .pattern = pool->search->pattern,
+        .flags = pool->search->flags & ~WGLB_PARALLEL,
+        .pool = pool,
+    };
+    sb_init(&s.path);
+    sb_cat(&s.path, pool->search->path.contents);
+    wb_init(&s.wpath);
+    wb_cat(&s.wpath, pool->search->wpath.contents);
+
+    struct wglob_stack *t2 = wglob_stack_new(&s, pool->stack);
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        size_t i = pool->interrupted ? pool->tasks.length : pool->next++;
+        pthread_mutex_unlock(&pool->mutex);
+        if (i >= pool->tasks.length)
+            break;
+
+        struct wglob_task *task = pool->tasks.contents[i];
+        s.results = &task->results;
+        memset(t2->active_components, 0, s.pattern.length);
+        wglob_scandir_entry(task->name, pool->dirfd, task->type,
+                &s, pool->stack, t2, false);
+    }
+    free(t2);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->scancount += s.scancount;
+    pthread_mutex_unlock(&pool->mutex);
+
+    sb_destroy(&s.path);
+    wb_destroy(&s.wpath);
+    return NULL;
+}
+
+#endif /* HAVE_PTHREAD */
+
+/* Tests if the search should be abandoned because the shell is interrupted.
+ * In a worker thread, only the calling thread of `wglob_scandir_parallel'
+ * examines the shell's state and the other threads see the result through the
+ * pool. */
+bool wglob_is_interrupted(const struct wglob_search *s)
+{
+#if HAVE_PTHREAD
+    struct wglob_pool *pool = s->pool;
+    if (pool != NULL) {
+        pthread_mutex_lock(&pool->mutex);
+        if (!pool->interrupted &&
+                pthread_equal(pthread_self(), pool->mainthread))
+            pool->interrupted = is_interrupted();
+        bool interrupted = pool->interrupted;
+        pthread_mutex_unlock(&pool->mutex);
+        return interrupted;
+    }
+#endif
+    return is_interrupted();
+}
+
+/* Opens the directory `s->path' for the stack frame `t'.
+ * If possible, the directory is opened relative to its parent directory so
+ * that the intermediate pathname does not have to be resolved again. */
+DIR *wglob_opendir(const struct wglob_search *s, const struct wglob_stack *t)
+{
+    const char *path = (s->path.length == 0) ? "." : s->path.contents;
+
+#if HAVE_FDOPENDIR
+    int fd;
+    if (t->parentfd >= 0)
+        fd = openat(t->parentfd, t->name, O_RDONLY | O_DIRECTORY);
+    else
+        fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return NULL;
+
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL)
+        xclose(fd);
+    return dir;
+#else
+    (void) t;
+    return opendir(path);
+#endif
+}
+
+/* Returns the type of the directory entry as reported by `readdir'. */
+enum wglob_filetype_T wglob_filetype(const struct dirent *de)
+{
+#if HAVE_D_TYPE
+    switch (de->d_type) {
+        case DT_UNKNOWN:  return WGLOB_UNKNOWN;
+        case DT_DIR:      return WGLOB_DIRECTORY;
+        case DT_LNK:      return WGLOB_SYMLINK;
+        default:          return WGLOB_OTHER;
+    }
+#else
+    (void) de;
+    return WGLOB_UNKNOWN;
+#endif
+}
+
 /* Checks if each active component matches the given `name' in the current
  * directory path and continues searching subdirectories.
+ * `dirfd' is a file descriptor for the current directory or -1, and `type' is
+ * the type of the file if known.
  * `t' is the stack frame for the current directory path and `t2' for the next
  * frame. `t2->prev' must be `t' and `t2->active_components' must have been
  * zeroed.
  * `only_if_existing' is passed to `wglob_add_result' and should be false iff
- * the `name' is known to be an existing file. */
+ * the `name' is known to be an existing file.
+ * The intermediate pathnames `s->path' and `s->wpath' are extended only if the
+ * name matches some component, so non-matching entries cost no conversion. */
 void wglob_scandir_entry(
-        const char *name, struct wglob_search *restrict s,
+        const char *name, int dirfd, enum wglob_filetype_T type,
+        struct wglob_search *restrict s,
         const struct wglob_stack *restrict t, struct wglob_stack *restrict t2,
         bool only_if_existing)
 {
-    size_t savepathlen = s->path.length, savewpathlen = s->wpath.length;
-
-    sb_cat(&s->path, name);
-    if (wb_mbscat(&s->wpath, name) != NULL)
-        goto done; // skip on error
+    bool descend = false;
+    enum { NO_RESULT, LITERAL_RESULT, MATCH_RESULT } result = NO_RESULT;
 
     /* add new active components to `t2' */
     for (size_t i = 0; i < s->pattern.length; i++) {
@@ -1045,40 +1871,74 @@ void wglob_scandir_entry(
             case WGLOB_LITERAL:
                 if (strcmp(c->value.literal.name, name) != 0)
                     continue;
-                if (i + 1 < s->pattern.length) // has a next component?
+                if (i + 1 < s->pattern.length) { // has a next component?
                     t2->active_components[i + 1] = 1;
-                else
-                    wglob_add_result(s, only_if_existing, false);
+                    descend = true;
+                } else {
+                    result = LITERAL_RESULT;
+                }
                 break;
             case WGLOB_MATCH:
                 if (name[0] == '\0')
                     continue;
                 if (xfnm_match(c->value.match.pattern, name) != 0)
                     continue;
-                if (i + 1 < s->pattern.length) // has a next component?
+                if (i + 1 < s->pattern.length) { // has a next component?
                     t2->active_components[i + 1] = 1;
-                else
-                    wglob_add_result(s, only_if_existing, s->flags & WGLB_MARK);
+                    descend = true;
+                } else {
+                    result = MATCH_RESULT;
+                }
                 break;
             case WGLOB_RECSEARCH:
                 assert(i + 1 < s->pattern.length);
                 if (name[0] == '\0')
                     continue;
                 if (t2->active_components[i] == 0) {
-                    const char *path = s->path.contents;
                     size_t count = t->active_components[i] - 1;
-                    if (wglob_should_recurse(name, path, c, t2, count))
+                    if (wglob_should_recurse(
+                                name, dirfd, type, s, c, t2, count)) {
                         t2->active_components[i] = t->active_components[i] + 1;
+                        descend = true;
+                    }
                 }
                 break;
         }
     }
 
-    sb_ccat(&s->path, '/');
-    wb_wccat(&s->wpath, L'/');
+    if (!descend && result == NO_RESULT)
+        return;
+
+    size_t savepathlen = s->path.length, savewpathlen = s->wpath.length;
+
+    sb_cat(&s->path, name);
+    if (wb_mbscat(&s->wpath, name) != NULL)
+        goto done; // skip on error
+
+    switch (result) {
+        case NO_RESULT:
+            break;
+        case LITERAL_RESULT:
+            wglob_add_result(s, only_if_existing, false);
+            break;
+        case MATCH_RESULT:
+            wglob_add_result(s, only_if_existing, s->flags & WGLB_MARK);
+            break;
+    }
+
+    if (descend) {
+        sb_ccat(&s->path, '/');
+        wb_wccat(&s->wpath, L'/');
 
-    /* descend down to the next subdirectory */
-    wglob_search(s, t2);
+        t2->parentfd = (name[0] != '\0') ? dirfd : -1;
+        t2->name = name;
+
+        /* descend down to the next subdirectory */
+        wglob_search(s, t2);
+
+        t2->parentfd = -1;
+        t2->name = NULL;
+    }
 
 done:
     sb_truncate(&s->path, savepathlen);
@@ -1086,10 +1946,13 @@ done:
 }
 
 /* Decides if we should continue recursion on this component.
- * In this function, `t->st' is updated to the result of `stat'ing the `path'.
- */
+ * `name' is the name of the file in the current directory `s->path', for which
+ * `dirfd' is a file descriptor or -1. If `type' tells that the file is not a
+ * directory, the file is rejected without calling `stat'.
+ * In this function, `t->st' is updated to the result of `stat'ing the file. */
 bool wglob_should_recurse(
-        const char *restrict name, const char *restrict path,
+        const char *restrict name, int dirfd, enum wglob_filetype_T type,
+        struct wglob_search *restrict s,
         const struct wglob_pattern *restrict c, struct wglob_stack *restrict t,
         size_t count)
 {
@@ -1101,9 +1964,35 @@ bool wglob_should_recurse(
             return false;
     }
 
-    int (*statfunc)(const char *path, struct stat *st) =
-        c->value.recsearch.followlink ? stat : lstat;
-    if (statfunc(path, &t->st) < 0)
+    bool followlink = c->value.recsearch.followlink;
+    switch (type) {
+        case WGLOB_UNKNOWN:
+        case WGLOB_DIRECTORY:
+            break;
+        case WGLOB_SYMLINK:
+            if (!followlink)
+                return false;
+            break;
+        case WGLOB_OTHER:
+            return false;
+    }
+
+    int statresult;
+#if HAVE_FDOPENDIR
+    if (dirfd >= 0) {
+        statresult = fstatat(dirfd, name, &t->st,
+                followlink ? 0 : AT_SYMLINK_NOFOLLOW);
+    } else
+#else
+    (void) dirfd;
+#endif
+    {
+        size_t savepathlen = s->path.length;
+        sb_cat(&s->path, name);
+        statresult = (followlink ? stat : lstat)(s->path.contents, &t->st);
+        sb_truncate(&s->path, savepathlen);
+    }
+    if (statresult < 0)
         return false;
     if (!S_ISDIR(t->st.st_mode))
         return false;
@@ -1124,11 +2013,6 @@ bool wglob_is_reentry(const struct wglob_stack *const t, size_t count)
     return false;
 }
 
-int wglob_sortcmp(const void *v1, const void *v2)
-{
-    return wcscoll(*(const wchar_t *const *) v1, *(const wchar_t *const *) v2);
-}
-
 
 /********** Built-ins **********/
 
@@ -1616,6 +2500,8 @@ int hash_builtin(int argc, void **argv)
         if (remove) {
             if (xoptind == argc) {  // forget all
                 clear_cmdhash();
+                remove_cmdhash_cache();
+                clear_loadpath_index();
             } else {                // forget the specified
                 for (int i = xoptind; i < argc; i++) {
                     char *cmd = malloc_wcstombs(ARGV(i));
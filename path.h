@@ -74,9 +74,34 @@ extern void init_cmdhash(void);
 extern void clear_cmdhash(void);
 extern const char *get_command_path(const char *name, _Bool forcelookup)
     __attribute__((nonnull));
-extern void fill_cmdhash(const char *prefix, _Bool ignorecase);
 extern const char *get_command_path_default(const char *name)
     __attribute__((nonnull));
+extern void finalize_cmdhash(void);
+extern void remove_cmdhash_cache(void);
+extern void cmdhash_memory_usage(size_t *countp, size_t *bytesp)
+    __attribute__((nonnull));
+
+
+#if YASH_ENABLE_LINEEDIT
+
+/********** Command Directory Cache **********/
+
+extern char *const *get_command_directory_entries(
+        const char *restrict path, size_t *restrict countp)
+    __attribute__((nonnull));
+extern size_t search_command_directory_entries(
+        char *const *names, size_t count, const char *prefix)
+    __attribute__((nonnull(3),pure));
+extern void forget_command_directories(char *const *dirs);
+
+#endif
+
+
+/********** Load Path Index **********/
+
+extern char *which_in_loadpath(const char *name)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern void clear_loadpath_index(void);
 
 
 /********** Home Directory Cache **********/
@@ -95,6 +120,7 @@ enum wglobflags_T {
     WGLB_PERIOD   = 1 << 2,
     WGLB_NOSORT   = 1 << 3,
     WGLB_RECDIR   = 1 << 4,
+    WGLB_PARALLEL = 1 << 5,
 };
 
 struct plist_T;
@@ -82,6 +82,11 @@ extern plist_T *pl_add(plist_T *list, const void *p)
 #ifndef PLIST_DEFAULT_MAX
 #define PLIST_DEFAULT_MAX 7
 #endif
+/* If a list has more unused space than this when its contents are taken by
+ * `pl_toary', the list is shrunk to the exact size. */
+#ifndef PLIST_MAXSLACK
+#define PLIST_MAXSLACK 7
+#endif
 
 
 /* Clones the specified NULL-terminated array of pointers.
@@ -119,7 +124,12 @@ plist_T *pl_initwith(plist_T *list, void **array, size_t length)
  * Note that the list elements are not `free'd in this function. */
 void pl_destroy(plist_T *list)
 {
-    free(pl_toary(list));
+    void **a = list->contents;
+#ifndef NDEBUG
+    list->contents = &a[list->maxlength];
+    list->length = list->maxlength = Size_max;
+#endif
+    free(a);
 }
 
 /* Frees the specified pointer list and returns the contents.
@@ -128,6 +138,9 @@ void pl_destroy(plist_T *list)
  * safely cast to (char **). */
 void **pl_toary(plist_T *list)
 {
+    if (list->maxlength - list->length > PLIST_MAXSLACK)
+        pl_setmax(list, list->length);
+
     void **a = list->contents;
 #ifndef NDEBUG
     list->contents = &a[list->maxlength];
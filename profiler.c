@@ -0,0 +1,780 @@
+/* Yash: yet another shell */
+/* profiler.c: execution profiler */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include "common.h"
+#include "profiler.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+#include "alias.h"
+#include "builtin.h"
+#include "exec.h"
+#include "hashtable.h"
+#if YASH_ENABLE_HISTORY
+# include "history.h"
+#endif
+#include "job.h"
+#include "parsecache.h"
+#include "path.h"
+#include "plist.h"
+#include "strbuf.h"
+#include "util.h"
+#include "variable.h"
+
+
+/* The profiler is activated when the shell starts with the $YASH_PROFILE or
+ * $YASH_PROFILE_FOLDED variable set to a pathname. The shell then records
+ * the time spent in each function and on each line, and writes the result to
+ * the files when it exits.
+ * The time is charged to the function and the line being executed at the
+ * moment each event (a function call, a function return or the execution of a
+ * command on a new line) happens, so hooks must be called at every event. */
+
+#ifdef CLOCK_MONOTONIC
+# define PROFILER_CLOCK CLOCK_MONOTONIC
+#else
+# define PROFILER_CLOCK CLOCK_REALTIME
+#endif
+
+/* A point or length of time, in seconds. `cpu' includes the CPU time of the
+ * child processes that have been waited for. */
+typedef struct ptime_T {
+    double wall, cpu;
+} ptime_T;
+
+/* Statistics of a function or a line. */
+typedef struct pstat_T {
+    unsigned long count;    /* number of calls or executions */
+    ptime_T self;           /* time spent except in called functions */
+    ptime_T total;          /* time spent including called functions */
+    unsigned long events[PE_count];
+} pstat_T;
+/* `total' is not used for lines. */
+
+/* Key of a line in `pfunc_T.lines'. */
+typedef struct plinekey_T {
+    const char *source;     /* element of `sources' or NULL */
+    unsigned long lineno;
+} plinekey_T;
+/* Lines executed outside any function are distinguished by the name of the
+ * script or other source they were read from. `source' is NULL for a line in a
+ * function, which is identified by the line number only. */
+
+/* Profile of a line. */
+typedef struct pline_T {
+    plinekey_T key;
+    pstat_T stat;
+} pline_T;
+
+/* Profile of a function. */
+typedef struct pfunc_T {
+    pstat_T stat;
+    size_t depth;           /* number of calls being executed now */
+    hashtable_T lines;      /* plinekey_T * -> pline_T * */
+    wchar_t name[];
+} pfunc_T;
+
+/* Function call being executed. */
+typedef struct pframe_T {
+    pfunc_T *func;
+    ptime_T start;          /* time when the function was called */
+    pstat_T *callerline;    /* line of the caller that called the function */
+    size_t stacklength;     /* length of `stack' before the call */
+} pframe_T;
+
+/* A line in the sorted report. */
+typedef struct preportline_T {
+    const pfunc_T *func;
+    const pline_T *line;
+} preportline_T;
+
+static ptime_T current_time(void);
+static double current_wall_time(void);
+static /* Returns the current wall clock time without the CPU time, which is cheaper
+ * to obtain than `current_time'. */
+double current_wall_time(void)
+{
+    struct timespec ts;
+    if (clock_gettime(PROFILER_CLOCK, &ts) < 0)
+        return 0.0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double timeval_to_double(const struct timeval *tv)
+    __attribute__((nonnull,pure));
+static void add_time(ptime_T *sum, ptime_T t1, ptime_T t2)
+    __attribute__((nonnull));
+static pfunc_T *new_pfunc(const wchar_t *name)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static void charge(void);
+static hashval_T hashlinekey(const void *key)
+    __attribute__((nonnull,pure));
+static int linekeycmp(const void *key1, const void *key2)
+    __attribute__((nonnull,pure));
+static void write_report(void);
+static void print_startup_phases(FILE *f)
+    __attribute__((nonnull));
+static void print_functions(FILE *f)
+    __attribute__((nonnull));
+static void print_function(FILE *f, const pfunc_T *func)
+    __attribute__((nonnull));
+static void print_lines(FILE *f)
+    __attribute__((nonnull));
+static void collect_lines(const pfunc_T *func, plist_T *list)
+    __attribute__((nonnull));
+static int compare_functions(const void *p1, const void *p2)
+    __attribute__((nonnull,pure));
+static int compare_lines(const void *p1, const void *p2)
+    __attribute__((nonnull,pure));
+static void write_folded(void);
+static int print_memory_usage(void *const *names)
+    __attribute__((nonnull));
+
+
+/* Maximum number of startup phases that can be recorded. */
+#define STARTUP_PHASES_MAX 24
+
+/* Names of the startup phases that have finished and the wall clock time when
+ * each of them finished. `startup_origin' is the time when the trace began. */
+static const char *startup_phase_names[STARTUP_PHASES_MAX];
+static double startup_phase_times[STARTUP_PHASES_MAX];
+static double startup_origin;
+static size_t startup_phase_count;
+
+/* True while the profiler is recording. */
+bool profiler_active = false;
+
+/* Pathnames of the files to which the report and the folded stacks are
+ * written. NULL if not requested. */
+static char *report_path, *folded_path;
+
+/* The process ID of the profiled shell. */
+static pid_t profiler_pid;
+
+/* Time when the profiler was activated and time of the last event. */
+static ptime_T start_time, last_time;
+
+/* hashtable from function names (wchar_t *) to profiles (pfunc_T *) */
+static hashtable_T functions;
+
+/* profile of the commands executed outside any function */
+static pfunc_T *toplevel;
+
+/* hashtable containing the names of the sources of commands (char *), and the
+ * name of the source being executed now, which is an element of the hashtable
+ * or NULL */
+static hashtable_T sources;
+static const char *current_source;
+
+/* function calls being executed */
+static pframe_T *frames;
+static size_t framecount, framemax;
+
+/* function and line being executed now. `current_line' is NULL until the first
+ * line of a function is executed. */
+static pfunc_T *current_func;
+static pstat_T *current_line;
+
+/* The current call stack in the folded format (function names separated by
+ * semicolons) and a hashtable from stacks (wchar_t *) to the wall time spent
+ * on them (double *). Used only if `folded_path' is non-NULL. */
+static xwcsbuf_T stack;
+static hashtable_T stacks;
+
+
+/* Starts recording the time spent in each phase of the shell startup.
+ * The phases are always recorded because the profiler is not activated until
+ * the variables are initialized. They are only reported by the profiler. */
+void begin_startup_trace(void)
+{
+    startup_origin = current_wall_time();
+    startup_phase_count = 0;
+}
+
+/* Records the end of the startup phase of the specified name, which must be a
+ * static string. */
+void mark_startup_phase(const char *name)
+{
+    if (startup_phase_count >= STARTUP_PHASES_MAX)
+        return;
+    startup_phase_names[startup_phase_count] = name;
+    startup_phase_times[startup_phase_count] = current_wall_time();
+    startup_phase_count++;
+}
+
+/* Activates the profiler if $YASH_PROFILE or $YASH_PROFILE_FOLDED is set.
+ * This function must be called after the variables are initialized. */
+void init_profiler(void)
+{
+    const wchar_t *report = getvar(L VAR_YASH_PROFILE);
+    const wchar_t *folded = getvar(L VAR_YASH_PROFILE_FOLDED);
+    if (report != NULL && report[0] != L'\0')
+        report_path = malloc_wcstombs(report);
+    if (folded != NULL && folded[0] != L'\0')
+        folded_path = malloc_wcstombs(folded);
+    if (report_path == NULL && folded_path == NULL)
+        return;
+
+    ht_init(&functions, hashwcs, htwcscmp);
+    ht_init(&sources, hashstr, htstrcmp);
+    toplevel = new_pfunc(L"(top level)");
+    toplevel->stat.count = 1;
+    current_func = toplevel;
+    current_line = NULL;
+    if (folded_path != NULL) {
+        wb_init(&stack);
+        wb_cat(&stack, toplevel->name);
+        ht_init(&stacks, hashwcs, htwcscmp);
+    }
+
+    profiler_pid = getpid();
+    start_time = last_time = current_time();
+    profiler_active = true;
+}
+
+/* Returns the current wall clock time and the CPU time consumed so far. */
+ptime_T current_time(void)
+{
+    struct timespec ts;
+    struct rusage self, children;
+    if (clock_gettime(PROFILER_CLOCK, &ts) < 0)
+        ts.tv_sec = 0, ts.tv_nsec = 0;
+    if (getrusage(RUSAGE_SELF, &self) < 0)
+        self = (struct rusage) { .ru_utime.tv_sec = 0, };
+    if (getrusage(RUSAGE_CHILDREN, &children) < 0)
+        children = (struct rusage) { .ru_utime.tv_sec = 0, };
+
+    return (ptime_T) {
+        .wall = ts.tv_sec + ts.tv_nsec * 1e-9,
+        .cpu = timeval_to_double(&self.ru_utime)
+            + timeval_to_double(&self.ru_stime)
+            + timeval_to_double(&children.ru_utime)
+            + timeval_to_double(&children.ru_stime),
+    };
+}
+
+double timeval_to_double(const struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec * 1e-6;
+}
+
+/* Adds the difference `t1 - t2' to `*sum'. */
+void add_time(ptime_T *sum, ptime_T t1, ptime_T t2)
+{
+    sum->wall += t1.wall - t2.wall;
+    sum->cpu += t1.cpu - t2.cpu;
+}
+
+/* Creates a new empty profile for the specified function. */
+pfunc_T *new_pfunc(const wchar_t *name)
+{
+    size_t namelen = wcslen(name);
+    pfunc_T *func = xmallocs(sizeof *func, namelen + 1, sizeof *func->name);
+    func->stat = (pstat_T) { .count = 0, };
+    func->depth = 0;
+    ht_init(&func->lines, hashlinekey, linekeycmp);
+    wmemcpy(func->name, name, namelen + 1);
+    return func;
+}
+
+/* Charges the time elapsed since the last event to the current function, line
+ * and stack. */
+void charge(void)
+{
+    ptime_T now = current_time();
+
+    add_time(&current_func->stat.self, now, last_time);
+    if (current_line != NULL)
+        add_time(&current_line->self, now, last_time);
+
+    if (folded_path != NULL) {
+        double *wall = ht_get(&stacks, stack.contents).value;
+        if (wall == NULL) {
+            wall = xmalloc(sizeof *wall);
+            *wall = 0.0;
+            ht_set(&stacks, xwcsdup(stack.contents), wall);
+        }
+        *wall += now.wall - last_time.wall;
+    }
+
+    last_time = now;
+}
+
+/* Records that the shell is going to execute the function with the specified
+ * name. */
+void profiler_enter_function(const wchar_t *name)
+{
+    if (!profiler_active)
+        return;
+
+    charge();
+
+    pfunc_T *func = ht_get(&functions, name).value;
+    if (func == NULL) {
+        func = new_pfunc(name);
+        ht_set(&functions, func->name, func);
+    }
+
+    if (framecount == framemax) {
+        framemax = (framemax == 0) ? 8 : framemax * 2;
+        frames = xreallocn(frames, framemax, sizeof *frames);
+    }
+    frames[framecount++] = (pframe_T) {
+        .func = func,
+        .start = last_time,
+        .callerline = current_line,
+        .stacklength = stack.length,
+    };
+
+    func->stat.count++;
+    func->depth++;
+    current_func = func;
+    current_line = NULL;
+
+    if (folded_path != NULL) {
+        wb_wccat(&stack, L';');
+        wb_cat(&stack, name);
+    }
+}
+
+/* Records that the function most recently entered has returned. */
+void profiler_leave_function(void)
+{
+    if (!profiler_active || framecount == 0)
+        return;
+
+    charge();
+
+    pframe_T *frame = &frames[--framecount];
+    pfunc_T *func = frame->func;
+    /* count the total time only for the outermost call of recursion */
+    if (--func->depth == 0)
+        add_time(&func->stat.total, last_time, frame->start);
+
+    current_func = (framecount > 0) ? frames[framecount - 1].func : toplevel;
+    current_line = frame->callerline;
+    if (folded_path != NULL)
+        wb_truncate(&stack, frame->stacklength);
+}
+
+/* Records that the shell is going to execute commands read from the source of
+ * the specified name, which may be NULL.
+ * Returns the name of the source that was being executed, which should be
+ * passed to this function again when the execution of the source finishes. */
+const char *profiler_set_source(const char *name)
+{
+    if (!profiler_active)
+        return NULL;
+
+    const char *oldsource = current_source;
+    if (name == NULL) {
+        current_source = NULL;
+    } else {
+        current_source = ht_get(&sources, name).key;
+        if (current_source == NULL) {
+            current_source = xstrdup(name);
+            ht_set(&sources, current_source, NULL);
+        }
+    }
+    return oldsource;
+}
+
+/* Records that the shell is going to execute a command on the specified line.
+ */
+void profiler_line(unsigned long lineno)
+{
+    if (!profiler_active)
+        return;
+
+    charge();
+
+    plinekey_T key = {
+        .source = (current_func == toplevel) ? current_source : NULL,
+        .lineno = lineno,
+    };
+    pline_T *line = ht_get(&current_func->lines, &key).value;
+    if (line == NULL) {
+        line = xmalloc(sizeof *line);
+        *line = (pline_T) { .key = key, .stat = { .count = 0, }, };
+        ht_set(&current_func->lines, &line->key, line);
+    }
+    line->stat.count++;
+    current_line = &line->stat;
+}
+
+/* Counts the specified event for the current function and line. */
+void profiler_count(profevent_T event)
+{
+    if (!profiler_active)
+        return;
+
+    current_func->stat.events[event]++;
+    if (current_line != NULL)
+        current_line->events[event]++;
+}
+
+/* The names of sources are compared by their addresses because they are
+ * elements of `sources'. */
+hashval_T hashlinekey(const void *key)
+{
+    const plinekey_T *k = key;
+    return (hashval_T) k->lineno * 31 + (hashval_T) (uintptr_t) k->source;
+}
+
+int linekeycmp(const void *key1, const void *key2)
+{
+    const plinekey_T *k1 = key1, *k2 = key2;
+    return k1->source != k2->source || k1->lineno != k2->lineno;
+}
+
+/* Stops the profiler without writing the result.
+ * This function is called in a subshell so that only the original shell
+ * process writes the result. */
+void stop_profiler(void)
+{
+    profiler_active = false;
+}
+
+/* Writes the result of profiling and stops the profiler.
+ * This function is called when the shell exits or replaces itself with an
+ * external command. */
+void finalize_profiler(void)
+{
+    if (!profiler_active || getpid() != profiler_pid)
+        return;
+
+    while (framecount > 0)
+        profiler_leave_function();
+    charge();
+    add_time(&toplevel->stat.total, last_time, start_time);
+    profiler_active = false;
+
+    if (report_path != NULL)
+        write_report();
+    if (folded_path != NULL)
+        write_folded();
+}
+
+/* Writes the report to the file specified by $YASH_PROFILE. */
+void write_report(void)
+{
+    FILE *f = fopen(report_path, "w");
+    if (f == NULL) {
+        xerror(errno, Ngt("cannot open file `%s'"), report_path);
+        return;
+    }
+
+    fprintf(f, "# total: wall %.6f s, cpu %.6f s\n\n",
+            toplevel->stat.total.wall, toplevel->stat.total.cpu);
+    print_startup_phases(f);
+    print_functions(f);
+    fputc('\n', f);
+    print_lines(f);
+
+    if (fclose(f) != 0)
+        xerror(errno, Ngt("cannot write to file `%s'"), report_path);
+}
+
+/* Prints the wall time spent in each startup phase. */
+void print_startup_phases(FILE *f)
+{
+    if (startup_phase_count == 0)
+        return;
+
+    fprintf(f, "# %11s  %s\n", "wall", "startup phase");
+
+    double last = startup_origin;
+    for (size_t i = 0; i < startup_phase_count; i++) {
+        fprintf(f, "%13.6f  %s\n", startup_phase_times[i] - last,
+                startup_phase_names[i]);
+        last = startup_phase_times[i];
+    }
+    fprintf(f, "%13.6f  %s\n\n", last - startup_origin, "(total)");
+}
+
+/* Prints the profiles of all the functions, sorted by the self wall time. */
+void print_functions(FILE *f)
+{
+    fprintf(f, "# %7s %11s %11s %11s %11s %7s %7s %7s  %s\n",
+            "calls", "self-wall", "total-wall", "self-cpu", "total-cpu",
+            "forks", "cmdsubs", "execs", "function");
+
+    kvpair_T *kvs = ht_tokvarray(&functions);
+    size_t count = functions.count;
+    const pfunc_T *funcs[count + 1];
+    for (size_t i = 0; i < count; i++)
+        funcs[i] = kvs[i].value;
+    funcs[count++] = toplevel;
+    free(kvs);
+
+    qsort(funcs, count, sizeof *funcs, compare_functions);
+    for (size_t i = 0; i < count; i++)
+        print_function(f, funcs[i]);
+}
+
+void print_function(FILE *f, const pfunc_T *func)
+{
+    const pstat_T *s = &func->stat;
+    fprintf(f, "%9lu %11.6f %11.6f %11.6f %11.6f %7lu %7lu %7lu  %ls\n",
+            s->count, s->self.wall, s->total.wall, s->self.cpu, s->total.cpu,
+            s->events[PE_FORK], s->events[PE_CMDSUB], s->events[PE_EXEC],
+            func->name);
+}
+
+/* Prints the profiles of all the lines, sorted by the self wall time. */
+void print_lines(FILE *f)
+{
+    fprintf(f, "# %7s %11s %11s %7s %7s %7s  %s\n",
+            "cmds", "self-wall", "self-cpu",
+            "forks", "cmdsubs", "execs", "function:line");
+
+    plist_T list;
+    pl_init(&list);
+    collect_lines(toplevel, &list);
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&functions, &i)).key != NULL)
+        collect_lines(kv.value, &list);
+
+    qsort(list.contents, list.length, sizeof *list.contents, compare_lines);
+    for (i = 0; i < list.length; i++) {
+        const preportline_T *l = list.contents[i];
+        const pstat_T *s = &l->line->stat;
+        fprintf(f, "%9lu %11.6f %11.6f %7lu %7lu %7lu  ",
+                s->count, s->self.wall, s->self.cpu,
+                s->events[PE_FORK], s->events[PE_CMDSUB], s->events[PE_EXEC]);
+        if (l->line->key.source != NULL)
+            fprintf(f, "%s:%lu\n", l->line->key.source, l->line->key.lineno);
+        else
+            fprintf(f, "%ls:%lu\n", l->func->name, l->line->key.lineno);
+    }
+    pl_destroy(pl_clear(&list, free));
+}
+
+/* Adds the lines of the specified function to the list as
+ * `preportline_T's. */
+void collect_lines(const pfunc_T *func, plist_T *list)
+{
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&func->lines, &i)).key != NULL) {
+        preportline_T *l = xmalloc(sizeof *l);
+        l->func = func;
+        l->line = kv.value;
+        pl_add(list, l);
+    }
+}
+
+int compare_functions(const void *p1, const void *p2)
+{
+    const pstat_T *s1 = &(*(const pfunc_T *const *) p1)->stat;
+    const pstat_T *s2 = &(*(const pfunc_T *const *) p2)->stat;
+    return (s1->self.wall < s2->self.wall) - (s1->self.wall > s2->self.wall);
+}
+
+int compare_lines(const void *p1, const void *p2)
+{
+    const pstat_T *s1 = &(*(const preportline_T *const *) p1)->line->stat;
+    const pstat_T *s2 = &(*(const preportline_T *const *) p2)->line->stat;
+    return (s1->self.wall < s2->self.wall) - (s1->self.wall > s2->self.wall);
+}
+
+/* Writes the folded stacks to the file specified by $YASH_PROFILE_FOLDED.
+ * Each line contains a call stack and the wall time spent on it in
+ * microseconds, which can be fed to flame graph tools. */
+void write_folded(void)
+{
+    FILE *f = fopen(folded_path, "w");
+    if (f == NULL) {
+        xerror(errno, Ngt("cannot open file `%s'"), folded_path);
+        return;
+    }
+
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&stacks, &i)).key != NULL) {
+        double wall = *(const double *) kv.value;
+        fprintf(f, "%ls %.0f\n", (const wchar_t *) kv.key, wall * 1e6);
+    }
+
+    if (fclose(f) != 0)
+        xerror(errno, Ngt("cannot write to file `%s'"), folded_path);
+}
+
+
+/********** Statistics Counters **********/
+
+/* values of the statistics counters */
+unsigned long stat_counts[SC_count];
+
+/* names of the statistics counters, in the order of `statcounter_T' */
+static const wchar_t *const stat_names[SC_count] = {
+    [SC_FORK]         = L"fork",
+    [SC_SPAWN]        = L"spawn",
+    [SC_EXEC]         = L"exec",
+    [SC_CMDSUB]       = L"cmdsub",
+    [SC_SUBSHELL]     = L"subshell",
+    [SC_BUILTIN]      = L"builtin",
+    [SC_FUNCTION]     = L"function",
+    [SC_HASH_HIT]     = L"hash-hit",
+    [SC_HASH_MISS]    = L"hash-miss",
+    [SC_SEARCH_HIT]   = L"search-hit",
+    [SC_SEARCH_MISS]  = L"search-miss",
+    [SC_PATTERN]      = L"pattern",
+    [SC_GLOB_DIR]     = L"glob-dir",
+    [SC_HISTORY_LOCK] = L"history-lock",
+    [SC_VARIABLE]     = L"variable",
+};
+
+/* Subsystems whose memory usage is printed by the "stats" built-in. */
+static const struct memusage_T {
+    const wchar_t *name;
+    void (*compute)(size_t *countp, size_t *bytesp);
+} memusages[] = {
+#if YASH_ENABLE_HISTORY
+    { L"history",      history_memory_usage, },
+#endif
+    { L"variable",     variable_memory_usage, },
+    { L"function",     function_memory_usage, },
+    { L"alias",        alias_memory_usage, },
+    { L"job",          job_memory_usage, },
+    { L"command-hash", cmdhash_memory_usage, },
+    { L"parse-cache",  parse_cache_memory_usage, },
+    { NULL,            NULL, },
+};
+
+/* Options for the "stats" built-in. */
+const struct xgetopt_T stats_options[] = {
+    { L'm', L"memory", OPTARG_NONE, true,  NULL, },
+    { L'r', L"reset",  OPTARG_NONE, true,  NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help",  OPTARG_NONE, false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "stats" built-in, which accepts the following options:
+ *  -m: print the memory usage of subsystems instead of the counters
+ *  -r: reset the counters instead of printing them */
+int stats_builtin(int argc, void **argv)
+{
+    bool memory = false, reset = false;
+
+    const struct xgetopt_T *opt;
+    xoptind = 0;
+    while ((opt = xgetopt(argv, stats_options, 0)) != NULL) {
+        switch (opt->shortopt) {
+            case L'm':  memory = true;  break;
+            case L'r':  reset = true;   break;
+#if YASH_ENABLE_HELP
+            case L'-':
+                return print_builtin_help(ARGV(0));
+#endif
+            default:
+                return Exit_ERROR;
+        }
+    }
+
+    if (memory) {
+        if (reset) {
+            xerror(0, Ngt("the -m option cannot be used with the -r option"));
+            return Exit_ERROR;
+        }
+        return print_memory_usage(&argv[xoptind]);
+    }
+
+    bool selected[SC_count];
+    for (size_t i = 0; i < SC_count; i++)
+        selected[i] = (xoptind == argc);
+    for (; xoptind < argc; xoptind++) {
+        size_t i;
+        for (i = 0; i < SC_count; i++)
+            if (wcscmp(ARGV(xoptind), stat_names[i]) == 0)
+                break;
+        if (i < SC_count)
+            selected[i] = true;
+        else
+            xerror(0, Ngt("no such counter `%ls'"), ARGV(xoptind));
+    }
+
+    for (size_t i = 0; i < SC_count; i++) {
+        if (!selected[i])
+            continue;
+        if (reset)
+            stat_counts[i] = 0;
+        else if (!xprintf("%-12ls %lu\n", stat_names[i], stat_counts[i]))
+            break;
+    }
+
+    return (yash_error_message_count == 0) ? Exit_SUCCESS : Exit_FAILURE;
+}
+
+/* Prints the memory usage of the subsystems named in `names', or of all the
+ * subsystems if `names' is empty. Each line contains the name of a subsystem,
+ * the number of items in it, and the number of bytes allocated for it. */
+int print_memory_usage(void *const *names)
+{
+    bool selected[sizeof memusages / sizeof *memusages];
+    for (size_t i = 0; memusages[i].name != NULL; i++)
+        selected[i] = (names[0] == NULL);
+    for (; *names != NULL; names++) {
+        size_t i;
+        for (i = 0; memusages[i].name != NULL; i++)
+            if (wcscmp(*names, memusages[i].name) == 0)
+                break;
+        if (memusages[i].name != NULL)
+            selected[i] = true;
+        else
+            xerror(0, Ngt("no such subsystem `%ls'"),
+                    (const wchar_t *) *names);
+    }
+
+    for (size_t i = 0; memusages[i].name != NULL; i++) {
+        if (!selected[i])
+            continue;
+
+        size_t count, bytes;
+        memusages[i].compute(&count, &bytes);
+        if (!xprintf("%-12ls %zu %zu\n", memusages[i].name, count, bytes))
+            break;
+    }
+
+    return (yash_error_message_count == 0) ? Exit_SUCCESS : Exit_FAILURE;
+}
+
+#if YASH_ENABLE_HELP
+const char stats_help[] = Ngt(
+"print or reset internal event counters or print memory usage"
+);
+const char stats_syntax[] = Ngt(
+"\tstats [-r] [counter...]\n"
+"\tstats -m [subsystem...]\n"
+);
+#endif
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
@@ -0,0 +1,79 @@
+/* Yash: yet another shell */
+/* profiler.h: execution profiler */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef YASH_PROFILER_H
+#define YASH_PROFILER_H
+
+#include <stddef.h>
+#include "xgetopt.h"
+
+
+typedef enum profevent_T {
+    PE_FORK, PE_CMDSUB, PE_EXEC,
+    PE_count,
+} profevent_T;
+
+extern _Bool profiler_active;
+
+extern void begin_startup_trace(void);
+extern void mark_startup_phase(const char *name)
+    __attribute__((nonnull));
+extern void init_profiler(void);
+extern void profiler_enter_function(const wchar_t *name)
+    __attribute__((nonnull));
+extern void profiler_leave_function(void);
+extern const char *profiler_set_source(const char *name);
+extern void profiler_line(unsigned long lineno);
+extern void profiler_count(profevent_T event);
+extern void stop_profiler(void);
+extern void finalize_profiler(void);
+
+
+/* Statistics counters, which count internal events regardless of whether the
+ * profiler is active. The names of the counters are in `stat_names' in
+ * "profiler.c". */
+typedef enum statcounter_T {
+    SC_FORK, SC_SPAWN, SC_EXEC, SC_CMDSUB, SC_SUBSHELL, SC_BUILTIN,
+    SC_FUNCTION, SC_HASH_HIT, SC_HASH_MISS, SC_SEARCH_HIT, SC_SEARCH_MISS,
+    SC_PATTERN, SC_GLOB_DIR,
+    SC_HISTORY_LOCK, SC_VARIABLE,
+    SC_count,
+} statcounter_T;
+
+extern unsigned long stat_counts[SC_count];
+
+static inline void count_stat(statcounter_T counter);
+
+/* Increments the specified statistics counter. */
+void count_stat(statcounter_T counter)
+{
+    stat_counts[counter]++;
+}
+
+extern int stats_builtin(int argc, void **argv)
+    __attribute__((nonnull));
+#if YASH_ENABLE_HELP
+extern const char stats_help[], stats_syntax[];
+#endif
+extern const struct xgetopt_T stats_options[];
+
+
+#endif /* YASH_PROFILER_H */
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
@@ -33,11 +33,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if HAVE_MEMFD_CREATE
+# include <sys/mman.h>
+#endif
 #include <sys/select.h>
 #if YASH_ENABLE_SOCKET
 # include <sys/socket.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_SYS_MEMFD_CREATE
+# include <sys/syscall.h>
+#endif
 #include <unistd.h>
 #include "exec.h"
 #include "expand.h"
@@ -112,6 +118,98 @@ bool write_all(int fd, const void *data, size_t size)
 }
 
 
+/********** Standard Output Buffering **********/
+
+/* The standard output is fully buffered if it is deferrable, that is, it is a
+ * regular file and not the same file as the standard error, so that the output
+ * of consecutive built-ins can be written in one system call. Otherwise, it is
+ * line-buffered and flushed at the end of each built-in. The buffer is always
+ * flushed before the shell creates a child process, executes a program,
+ * changes file descriptors, or waits for input or another process.
+ * Even if the standard output is deferrable, the buffer is flushed at the end
+ * of a built-in whose exit status is tested by an and-or list, a condition or
+ * the "errexit" or "errreturn" option, so that a write error makes the
+ * built-in fail before the status is used. Output still in the buffer is lost
+ * if the shell is killed by a signal. */
+
+static bool stdout_deferrable = false;
+
+/* Returns true iff the flush of the standard output may be deferred until one
+ * of the points described above. */
+bool is_stdout_deferrable(void)
+{
+    return stdout_deferrable;
+}
+
+/* Flushes the buffer of the standard output.
+ * Returns true iff successful. An error message is printed on failure. */
+static bool flush_stdout_buffer(void)
+{
+    if (fflush(stdout) == 0)
+        return true;
+
+    xerror(errno, Ngt("cannot print to the standard output"));
+    clearerr(stdout);
+    return false;
+}
+
+/* Flushes the buffer of the standard output and the buffered trace output (see
+ * `flush_xtrace').
+ * Returns true iff the standard output was flushed successfully. An error
+ * message is printed on failure. */
+bool flush_stdout(void)
+{
+    flush_xtrace();
+    return flush_stdout_buffer();
+}
+
+/* Flushes the buffer of the standard output unless it is deferrable and
+ * `tested' is false.
+ * This function is called after each built-in, where `tested' tells whether
+ * the exit status of the built-in is going to be tested. The trace output is
+ * not flushed here so that the traces of consecutive built-ins are written at
+ * once.
+ * Returns false iff the buffer was flushed and it failed. */
+bool flush_builtin_output(bool tested)
+{
+    return (stdout_deferrable && !tested) || flush_stdout_buffer();
+}
+
+/* Sets the buffering mode of the standard output. */
+static void set_stdout_deferrable(bool deferrable)
+{
+    stdout_deferrable = deferrable;
+    setvbuf(stdout, NULL, deferrable ? _IOFBF : _IOLBF, BUFSIZ);
+}
+
+/* Flushes the buffer of the standard output and re-examines whether it is
+ * deferrable. This function must be called whenever the standard output or
+ * error is replaced with another file.
+ * Returns true iff the buffer was flushed successfully. */
+bool reset_stdout_buffering(void)
+{
+    bool ok = flush_stdout();
+
+    struct stat outst, errst;
+    set_stdout_deferrable(fstat(STDOUT_FILENO, &outst) == 0
+            && S_ISREG(outst.st_mode)
+            && !(fstat(STDERR_FILENO, &errst) == 0
+                    && outst.st_dev == errst.st_dev
+                    && outst.st_ino == errst.st_ino));
+    return ok;
+}
+
+/* Makes the standard output non-deferrable until the next call to
+ * `reset_stdout_buffering'. This function is called for a built-in that has
+ * its own redirections, which are undone as soon as the built-in returns, so
+ * that a write error is reported by the built-in itself. */
+void suppress_stdout_deferral(void)
+{
+    if (stdout_deferrable)
+        set_stdout_deferrable(false);
+}
+
+
 /********** Shell FDs **********/
 
 static void reset_shellfdmin(void);
@@ -292,8 +390,7 @@ struct savefd_T {
 
 static char *expand_redir_filename(const struct wordunit_T *filename)
     __attribute__((malloc,warn_unused_result));
-static void save_fd(int oldfd, savefd_T **save)
-    __attribute__((nonnull));
+static void save_fd(int oldfd, savefd_T **save);
 static int open_file(const char *path, int oflag)
     __attribute__((nonnull));
 #if YASH_ENABLE_SOCKET
@@ -303,10 +400,14 @@ static int open_socket(const char *hostandport, int socktype)
 static int parse_and_check_dup(char *num, redirtype_T type)
     __attribute__((nonnull));
 static int parse_and_exec_pipe(int outputfd, char *num, savefd_T **save)
+    __attribute__((nonnull(2)));
+static int open_heredocument(const redir_T *r)
     __attribute__((nonnull));
-static int open_heredocument(const struct wordunit_T *content);
 static int open_herestring(char *s, bool appendnewline)
     __attribute__((nonnull));
+static int open_heretext(const char *s, size_t len)
+    __attribute__((nonnull));
+static int create_memory_file(void);
 static int open_process_redirection(const embedcmd_T *command, redirtype_T type)
     __attribute__((nonnull));
 
@@ -314,10 +415,15 @@ static int open_process_redirection(const embedcmd_T *command, redirtype_T type)
 /* Opens redirections.
  * The original FDs are saved and a pointer to the restoration info is assigned
  * to `*save' (whether successful or not).
+ * If `save' is NULL, the original FDs are not saved. This is for a command
+ * after which the shell exits without executing any other commands.
  * Returns true iff successful. */
 bool open_redirections(const redir_T *r, savefd_T **save)
 {
-    *save = NULL;
+    if (save != NULL)
+        *save = NULL;
+    if (r != NULL)
+        reset_stdout_buffering();
 
     while (r != NULL) {
         if (r->rd_fd < 0) {
@@ -396,7 +502,7 @@ openwithflags:
         case RT_HERE:
         case RT_HERERT:
             keepopen = false;
-            fd = open_heredocument(r->rd_herecontent);
+            fd = open_heredocument(r);
             if (fd < 0)
                 return false;
             break;
@@ -456,6 +562,9 @@ void save_fd(int fd, savefd_T **save)
 {
     assert(fd >= 0);
 
+    if (save == NULL)
+        return;
+
     int copyfd = copy_as_shellfd(fd);
     if (copyfd < 0 && errno != EBADF) {
         xerror(errno, Ngt("cannot save file descriptor %d"), fd);
@@ -747,13 +856,15 @@ error:
     goto end;
 }
 
-/* Opens a here-document whose contents is specified by the argument.
+/* Opens the here-document of the specified redirection.
  * Returns a newly opened file descriptor if successful, or -1 on error. */
-/* The contents of the here-document is passed either through a pipe or a
- * temporary file. */
-int open_heredocument(const wordunit_T *contents)
+int open_heredocument(const redir_T *r)
 {
-    wchar_t *wcontents = expand_single(contents, TT_NONE, Q_INDQ, ES_NONE);
+    if (r->rd_heretext != NULL)
+        return open_heretext(r->rd_heretext, strlen(r->rd_heretext));
+
+    wchar_t *wcontents =
+        expand_single(r->rd_herecontent, TT_NONE, Q_INDQ, ES_NONE);
     if (wcontents == NULL)
         return -1;
 
@@ -771,25 +882,32 @@ int open_heredocument(const wordunit_T *contents)
  * If `appendnewline' is true, a newline is appended to the value of `s'.
  * Returns a newly opened file descriptor if successful, or -1 on error.
  * `s' is freed in this function. */
-/* The contents of the here-document is passed either through a pipe or a
- * temporary file. */
 int open_herestring(char *s, bool appendnewline)
+{
+    size_t len = strlen(s);
+    if (appendnewline)
+        s[len++] = '\n';
+
+    int fd = open_heretext(s, len);
+    free(s);
+    return fd;
+}
+
+/* Opens a file descriptor from which the first `len' bytes of `s' can be read.
+ * Returns a newly opened file descriptor if successful, or -1 on error. */
+/* The contents of the here-document is passed through a pipe, a memory file or
+ * a temporary file. */
+int open_heretext(const char *s, size_t len)
 {
     int fd;
 
     /* if contents is empty */
-    if (s[0] == '\0' && !appendnewline) {
+    if (len == 0) {
         fd = open("/dev/null", O_RDONLY);
-        if (fd >= 0) {
-            free(s);
+        if (fd >= 0)
             return fd;
-        }
     }
 
-    size_t len = strlen(s);
-    if (appendnewline)
-        s[len++] = '\n';
-
 #ifdef PIPE_BUF
     /* use a pipe if the contents is short enough */
     if (len <= PIPE_BUF) {
@@ -802,33 +920,48 @@ int open_herestring(char *s, bool appendnewline)
                 xerror(errno, Ngt("cannot write the here-document contents "
                             "to the temporary file"));
             xclose(pipefd[PIPE_OUT]);
-            free(s);
             return pipefd[PIPE_IN];
         }
     }
 #endif /* defined(PIPE_BUF) */
 
-    char *tempfile;
-    fd = create_temporary_file(&tempfile, "", 0);
+    fd = create_memory_file();
     if (fd < 0) {
-        xerror(errno,
-                Ngt("cannot create a temporary file for the here-document"));
-        free(s);
-        return -1;
+        char *tempfile;
+        fd = create_temporary_file(&tempfile, "", 0);
+        if (fd < 0) {
+            xerror(errno, Ngt("cannot create a temporary file "
+                        "for the here-document"));
+            return -1;
+        }
+        if (unlink(tempfile) < 0)
+            xerror(errno, Ngt("failed to remove temporary file `%s'"),
+                    tempfile);
+        free(tempfile);
     }
-    if (unlink(tempfile) < 0)
-        xerror(errno, Ngt("failed to remove temporary file `%s'"), tempfile);
-    free(tempfile);
     if (!write_all(fd, s, len))
         xerror(errno, Ngt("cannot write the here-document contents "
                     "to the temporary file"));
-    free(s);
     if (lseek(fd, 0, SEEK_SET) != 0)
         xerror(errno,
                 Ngt("cannot seek the temporary file for the here-document"));
     return fd;
 }
 
+/* Creates an anonymous file that resides in memory and returns a file
+ * descriptor open for reading and writing.
+ * Returns -1 if failed or not supported on this system. */
+int create_memory_file(void)
+{
+#if HAVE_MEMFD_CREATE
+    return memfd_create("yash-heredoc", 0);
+#elif HAVE_SYS_MEMFD_CREATE
+    return (int) syscall(SYS_memfd_create, "yash-heredoc", 0);
+#else
+    return -1;
+#endif
+}
+
 /* Opens process redirection and returns the file descriptor.
  * `type' must be RT_PROCIN or RT_PROCOUT.
  * The return value is -1 if failed. */
@@ -883,9 +1016,13 @@ int open_process_redirection(const embedcmd_T *command, redirtype_T type)
     }
 }
 
-/* Restores the saved file descriptor and frees `save'. */
-void undo_redirections(savefd_T *save)
+/* Restores the saved file descriptor and frees `save'.
+ * The buffer of the standard output is flushed before the restoration.
+ * Returns false iff the flush failed. */
+bool undo_redirections(savefd_T *save)
 {
+    bool ok = (save == NULL) || reset_stdout_buffering();
+
     while (save != NULL) {
         if (save->sf_copyfd >= 0) {
             remove_shellfd(save->sf_copyfd);
@@ -899,6 +1036,7 @@ void undo_redirections(savefd_T *save)
         free(save);
         save = next;
     }
+    return ok;
 }
 
 /* Frees the FD-saving info without restoring FD.
@@ -27,6 +27,12 @@ extern int xdup2(int oldfd, int newfd);
 extern _Bool write_all(int fd, const void *data, size_t size)
     __attribute__((nonnull));
 
+extern _Bool is_stdout_deferrable(void);
+extern _Bool flush_stdout(void);
+extern _Bool flush_builtin_output(_Bool tested);
+extern _Bool reset_stdout_buffering(void);
+extern void suppress_stdout_deferral(void);
+
 extern int ttyfd;
 
 extern void init_shellfds(void);
@@ -42,9 +48,8 @@ extern void open_ttyfd(void);
 typedef struct savefd_T savefd_T;
 struct redir_T;
 
-extern _Bool open_redirections(const struct redir_T *r, savefd_T **save)
-    __attribute__((nonnull(2)));
-extern void undo_redirections(savefd_T *save);
+extern _Bool open_redirections(const struct redir_T *r, savefd_T **save);
+extern _Bool undo_redirections(savefd_T *save);
 extern void clear_savefd(savefd_T *save);
 extern void maybe_redirect_stdin_to_devnull(void);
 
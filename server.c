@@ -0,0 +1,604 @@
+/* Yash: yet another shell */
+/* server.c: pre-initialized shell server and its client */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include "common.h"
+#include "server.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#if HAVE_GETTEXT
+# include <libintl.h>
+#endif
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <wchar.h>
+#include "exec.h"
+#include "input.h"
+#include "option.h"
+#include "path.h"
+#include "plist.h"
+#include "redir.h"
+#include "sig.h"
+#include "strbuf.h"
+#include "util.h"
+#include "variable.h"
+#include "yash.h"
+
+
+/* The server forks a child process for each connection accepted. The child
+ * receives a request from the client and forks a grandchild that runs the
+ * requested command in the state the server had when it started serving.
+ * The child waits for the grandchild and reports its exit status to the
+ * client.
+ *
+ * A request is a sequence of null-terminated strings: the process ID of the
+ * client, the working directory, the number of arguments, the arguments (the
+ * command string, optionally followed by the values of $0 and the positional
+ * parameters), and the environment variables in the "name=value" form. The
+ * client's standard input, output, and error are passed along with the first
+ * byte of the request as ancillary data. The client shuts down the writing
+ * side of the connection to mark the end of the request.
+ *
+ * The reply is a sequence of lines: "pid N" tells the process ID of the
+ * grandchild, which is also its process group ID, and "exit N" or "signal N"
+ * tells how the grandchild terminated.
+ *
+ * A client can run any command as the user running the server, so the server
+ * accepts connections only from processes of the same user. The socket file is
+ * created with no permissions for others, and the effective user ID of the
+ * peer is checked for each connection where the system can tell it. */
+
+/* The number of file descriptors passed from the client. */
+#define PASSED_FD_COUNT 3
+
+static int open_server_socket(const char *path)
+    __attribute__((nonnull));
+static void accept_request(int listenfd);
+static bool is_trusted_peer(int fd);
+static void handle_request(int fd)
+    __attribute__((noreturn));
+static bool receive_request(int fd, xstrbuf_T *restrict buf, int *restrict fds)
+    __attribute__((nonnull));
+static void run_request(int fd, int *fds, char *data, size_t size)
+    __attribute__((nonnull));
+static void import_client_environment(char *const *entries)
+    __attribute__((nonnull));
+static inline void append_field(xstrbuf_T *restrict buf, const char *restrict s)
+    __attribute__((nonnull));
+static bool send_request(int fd, const xstrbuf_T *buf)
+    __attribute__((nonnull));
+static void forward_signal(int signum);
+static void parse_reply(const char *line,
+        int *restrict exitstatusp, int *restrict termsigp)
+    __attribute__((nonnull));
+
+
+/********** Server **********/
+
+/* Makes the shell a server listening on the socket `socketpath'.
+ * This function returns only on error, with the exit status of the shell. */
+int serve(const wchar_t *socketpath)
+{
+    char *path = malloc_wcstombs(socketpath);
+    if (path == NULL) {
+        xerror(EILSEQ, Ngt("cannot listen on socket `%ls'"), socketpath);
+        return Exit_FAILURE;
+    }
+    int listenfd = open_server_socket(path);
+    free(path);
+    if (listenfd < 0)
+        return Exit_FAILURE;
+
+    for (;;) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(listenfd, &readfds);
+        if (wait_for_events(listenfd + 1, &readfds, NULL, -1) < 0)
+            return Exit_FAILURE;
+        if (FD_ISSET(listenfd, &readfds))
+            accept_request(listenfd);
+    }
+}
+
+/* Creates a socket listening on the specified path and returns its file
+ * descriptor, which is a shell FD. An existing socket file at the path is
+ * replaced. The socket file is accessible only by the user.
+ * On error, an error message is printed and -1 is returned. */
+int open_server_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof addr.sun_path) {
+        xerror(ENAMETOOLONG, Ngt("cannot listen on socket `%s'"), path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    struct stat st;
+    if (lstat(path, &st) >= 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    mode_t savemask = umask(S_IRWXG | S_IRWXO);
+    int fd = move_to_shellfd(socket(AF_UNIX, SOCK_STREAM, 0));
+    bool ok = fd >= 0
+            && bind(fd, (struct sockaddr *) &addr, sizeof addr) >= 0
+            && listen(fd, SOMAXCONN) >= 0;
+    int errno_ = errno;
+    umask(savemask);
+    if (!ok) {
+        if (fd >= 0) {
+            remove_shellfd(fd);
+            xclose(fd);
+        }
+        xerror(errno_, Ngt("cannot listen on socket `%s'"), path);
+        return -1;
+    }
+    return fd;
+}
+
+/* Accepts a connection and forks a child process that handles it. */
+void accept_request(int listenfd)
+{
+    int fd = accept(listenfd, NULL, NULL);
+    if (fd < 0) {
+        if (errno != EINTR && errno != ECONNABORTED)
+            xerror(errno, Ngt("cannot accept a connection"));
+        return;
+    }
+    if (!is_trusted_peer(fd)) {
+        xerror(0, Ngt("rejected a connection from another user"));
+        xclose(fd);
+        return;
+    }
+
+    pid_t cpid = fork_and_reset(-1, false, 0);
+    if (cpid == 0)
+        handle_request(fd);
+    xclose(fd);
+}
+
+/* Returns true iff the peer of the connected socket `fd' has the same
+ * effective user ID as the shell. If the system provides no way to know the
+ * user of the peer, true is returned, relying on the permissions of the socket
+ * file. */
+bool is_trusted_peer(int fd)
+{
+#if HAVE_GETPEEREID
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(fd, &uid, &gid) >= 0 && uid == geteuid();
+#elif HAVE_SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof cred;
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) >= 0
+        && cred.uid == geteuid();
+#else
+    (void) fd;
+    return true;
+#endif
+}
+
+/* Receives a request from the connection `fd', runs it in a new child process,
+ * and reports the result to the client. This function never returns. */
+void handle_request(int fd)
+{
+    xstrbuf_T buf;
+    int fds[PASSED_FD_COUNT];
+
+    sb_init(&buf);
+    if (!receive_request(fd, &buf, fds))
+        _exit(Exit_FAILURE);
+
+    pid_t cpid = fork_and_reset(-1, false, 0);
+    if (cpid == 0)
+        run_request(fd, fds, buf.contents, buf.length);
+    for (int i = 0; i < PASSED_FD_COUNT; i++)
+        xclose(fds[i]);
+    if (cpid < 0)
+        _exit(Exit_FAILURE);
+
+    char reply[32];
+    int length = snprintf(reply, sizeof reply, "pid %jd\n", (intmax_t) cpid);
+    write_all(fd, reply, length);
+
+    int status;
+    while (waitpid(cpid, &status, 0) < 0)
+        if (errno != EINTR)
+            _exit(Exit_FAILURE);
+    if (WIFSIGNALED(status))
+        length = snprintf(reply, sizeof reply, "signal %d\n",
+                WTERMSIG(status));
+    else
+        length = snprintf(reply, sizeof reply, "exit %d\n",
+                WEXITSTATUS(status));
+    write_all(fd, reply, length);
+    _exit(Exit_SUCCESS);
+}
+
+/* Reads a request until the end of the connection.
+ * The file descriptors passed from the client are stored in `fds'.
+ * On error, an error message is printed and false is returned. */
+bool receive_request(int fd, xstrbuf_T *restrict buf, int *restrict fds)
+{
+    bool fdsreceived = false;
+
+    for (;;) {
+        char data[BUFSIZ];
+        union {
+            struct cmsghdr header;
+            char buf[CMSG_SPACE(PASSED_FD_COUNT * sizeof (int))];
+        } control;
+        struct iovec iov = { .iov_base = data, .iov_len = sizeof data, };
+        struct msghdr msg = {
+            .msg_name = NULL, .msg_namelen = 0,
+            .msg_iov = &iov, .msg_iovlen = 1,
+            .msg_control = control.buf,
+            .msg_controllen = sizeof control.buf,
+            .msg_flags = 0,
+        };
+
+        ssize_t size = recvmsg(fd, &msg, 0);
+        if (size < 0) {
+            if (errno == EINTR)
+                continue;
+            xerror(errno, Ngt("cannot receive a request"));
+            break;
+        }
+        if (size == 0)
+            return fdsreceived;
+
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+                c != NULL; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+                continue;
+
+            size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof (int);
+            int received[count];
+            memcpy(received, CMSG_DATA(c), sizeof received);
+            if (!fdsreceived && count == PASSED_FD_COUNT) {
+                memcpy(fds, received, sizeof received);
+                fdsreceived = true;
+            } else {
+                for (size_t i = 0; i < count; i++)
+                    xclose(received[i]);
+            }
+        }
+        sb_ncat_force(buf, data, size);
+    }
+
+    if (fdsreceived)
+        for (int i = 0; i < PASSED_FD_COUNT; i++)
+            xclose(fds[i]);
+    return false;
+}
+
+/* Runs the request in the current process, which has been forked from the
+ * server. `fd' is the connection, which is closed. `fds' are the file
+ * descriptors to be the standard input, output, and error. `data' is the
+ * request of `size' bytes. This function never returns. */
+void run_request(int fd, int *fds, char *data, size_t size)
+{
+    xclose(fd);
+
+    /* Move the passed file descriptors out of the way first so that `dup2'
+     * does not overwrite any of them. */
+    for (int i = 0; i < PASSED_FD_COUNT; i++)
+        if (fds[i] < PASSED_FD_COUNT)
+            fds[i] = fcntl(fds[i], F_DUPFD, PASSED_FD_COUNT);
+    for (int i = 0; i < PASSED_FD_COUNT; i++) {
+        if (fds[i] < 0 || dup2(fds[i], i) < 0)
+            _exit(Exit_FAILURE);
+        xclose(fds[i]);
+    }
+    reset_stdout_buffering();
+    stdin_input_file_info->bufpos = stdin_input_file_info->bufmax = 0;
+
+    shell_pid = getpid();
+    if (setpgid(0, 0) >= 0)
+        shell_pgid = shell_pid;
+
+    /* split the request into fields */
+    plist_T fields;
+    pl_init(&fields);
+    if (size > 0 && data[size - 1] == '\0')
+        for (size_t i = 0; i < size; i += strlen(&data[i]) + 1)
+            pl_add(&fields, &data[i]);
+    pl_add(&fields, NULL);
+
+    int argc;
+    if (fields.length < 4 || !xstrtoi(fields.contents[2], 10, &argc)
+            || argc < 1 || (size_t) argc > fields.length - 4) {
+        xerror(0, Ngt("received a malformed request"));
+        exit(Exit_ERROR);
+    }
+    char *const *args = (char *const *) &fields.contents[3];
+
+    if (chdir(fields.contents[1]) < 0) {
+        xerror(errno, Ngt("cannot change the working directory to `%s'"),
+                (char *) fields.contents[1]);
+        exit(Exit_ERROR);
+    }
+    import_client_environment(&args[argc]);
+    init_pwd();
+    wchar_t *ppid = malloc_mbstowcs(fields.contents[0]);
+    if (ppid != NULL)
+        set_variable(L VAR_PPID, ppid, SCOPE_GLOBAL, false);
+
+    wchar_t *command = malloc_mbstowcs(args[0]);
+    if (command == NULL) {
+        xerror(EILSEQ, Ngt("cannot convert the command string"));
+        exit(Exit_ERROR);
+    }
+    const char *name = posixly_correct ? "sh -c" : "yash -c";
+    plist_T params;
+    pl_init(&params);
+    if (argc >= 2) {
+        wchar_t *wname = malloc_mbstowcs(args[1]);
+        if (wname != NULL) {
+            name = args[1];
+            command_name = wname;
+        }
+        for (int i = 2; i < argc; i++) {
+            wchar_t *param = malloc_mbstowcs(args[i]);
+            pl_add(&params, param != NULL ? param : xwcsdup(L""));
+        }
+    }
+    set_positional_parameters(pl_toary(&params));
+    plfree(pl_toary(&params), free);
+
+    laststatus = Exit_SUCCESS;
+    exec_wcs(command, name, true);
+    assert(false);
+}
+
+/* Imports the client's environment variables over the variables of the
+ * server. `entries' is a NULL-terminated array of "name=value" strings.
+ * The variables are not filtered because the client is run by the same user
+ * and could run any command anyway. */
+void import_client_environment(char *const *entries)
+{
+    for (; *entries != NULL; entries++) {
+        wchar_t *entry = malloc_mbstowcs(*entries);
+        if (entry == NULL)
+            continue;
+
+        wchar_t *eq = wcschr(entry, L'=');
+        if (eq != NULL && eq != entry) {
+            *eq = L'\0';
+            set_variable(entry, xwcsdup(&eq[1]), SCOPE_GLOBAL, true);
+        }
+        free(entry);
+    }
+}
+
+
+/********** Client **********/
+
+/* The process group ID of the process running the command in the server,
+ * or zero if not yet known. */
+static volatile pid_t remote_pgid = 0;
+/* A signal that has been caught before `remote_pgid' is known. */
+static volatile sig_atomic_t pending_signal = 0;
+
+/* Sends the command to the server listening on the socket `socketpath' and
+ * waits for it to finish. `argv' must start with "-c" followed by the command
+ * string and, optionally, the values of $0 and the positional parameters.
+ * Signals the client receives are forwarded to the command.
+ * Returns the exit status of the command. If the command was killed by a
+ * signal, the client kills itself with the same signal. This function is
+ * called before the shell is initialized, so error messages are printed
+ * directly to the standard error. */
+int connect_to_server(const char *progname, const char *socketpath,
+        int argc, char *const *argv)
+{
+    if (argc < 2 || strcmp(argv[0], "-c") != 0) {
+        fprintf(stderr, gt("%s: the --connect option must be followed by "
+                    "the -c option and a command\n"), progname);
+        return Exit_ERROR;
+    }
+    argc--, argv++;
+
+    struct sockaddr_un addr;
+    if (strlen(socketpath) >= sizeof addr.sun_path) {
+        fprintf(stderr, gt("%s: cannot connect to socket `%s': %s\n"),
+                progname, socketpath, strerror(ENAMETOOLONG));
+        return Exit_ERROR;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketpath);
+
+    char *cwd = xgetcwd();
+    if (cwd == NULL) {
+        fprintf(stderr, gt("%s: cannot get the working directory: %s\n"),
+                progname, strerror(errno));
+        return Exit_ERROR;
+    }
+
+    xstrbuf_T buf;
+    sb_init(&buf);
+    sb_printf(&buf, "%jd", (intmax_t) getpid());
+    sb_ccat(&buf, '\0');
+    append_field(&buf, cwd);
+    free(cwd);
+    sb_printf(&buf, "%d", argc);
+    sb_ccat(&buf, '\0');
+    for (int i = 0; i < argc; i++)
+        append_field(&buf, argv[i]);
+    for (char **e = environ; *e != NULL; e++)
+        append_field(&buf, *e);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof addr) < 0) {
+        fprintf(stderr, gt("%s: cannot connect to socket `%s': %s\n"),
+                progname, socketpath, strerror(errno));
+        return Exit_ERROR;
+    }
+
+    /* Forward signals that are not ignored. */
+    static const int forwarded_signals[] =
+        { SIGHUP, SIGINT, SIGQUIT, SIGTERM, 0, };
+    struct sigaction action;
+    for (const int *s = forwarded_signals; *s != 0; s++) {
+        if (sigaction(*s, NULL, &action) >= 0 && action.sa_handler == SIG_IGN)
+            continue;
+        action.sa_handler = forward_signal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(*s, &action, NULL);
+    }
+
+    bool sent = send_request(fd, &buf);
+    sb_destroy(&buf);
+    if (!sent) {
+        fprintf(stderr, gt("%s: cannot send a request to socket `%s': %s\n"),
+                progname, socketpath, strerror(errno));
+        return Exit_ERROR;
+    }
+
+    int exitstatus = -1, termsig = 0;
+    size_t parsed = 0;
+    sb_init(&buf);
+    for (;;) {
+        char data[64];
+        ssize_t size = read(fd, data, sizeof data);
+        if (size < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (size == 0)
+            break;
+        sb_ncat_force(&buf, data, size);
+
+        char *newline;
+        while ((newline = strchr(&buf.contents[parsed], '\n')) != NULL) {
+            *newline = '\0';
+            parse_reply(&buf.contents[parsed], &exitstatus, &termsig);
+            parsed = newline - buf.contents + 1;
+        }
+    }
+    sb_destroy(&buf);
+    close(fd);
+
+    if (termsig != 0) {
+        action.sa_handler = SIG_DFL;
+        action.sa_flags = 0;
+        sigemptyset(&action.sa_mask);
+        sigaction(termsig, &action, NULL);
+        raise(termsig);
+        return 128 + termsig;
+    }
+    if (exitstatus < 0) {
+        fprintf(stderr, gt("%s: the server at socket `%s' did not report "
+                    "the exit status\n"), progname, socketpath);
+        return Exit_ERROR;
+    }
+    return exitstatus;
+}
+
+/* Appends the string and its terminating null character to the buffer. */
+void append_field(xstrbuf_T *restrict buf, const char *restrict s)
+{
+    sb_cat(buf, s);
+    sb_ccat(buf, '\0');
+}
+
+/* Sends the request in `buf' along with the standard input, output, and error
+ * to the connection `fd'. Returns false with `errno' set on error. */
+bool send_request(int fd, const xstrbuf_T *buf)
+{
+    const int fds[PASSED_FD_COUNT] = { STDIN_FILENO, STDOUT_FILENO,
+        STDERR_FILENO, };
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof fds)];
+    } control;
+    memset(&control, 0, sizeof control);
+
+    struct iovec iov = { .iov_base = buf->contents, .iov_len = 1, };
+    struct msghdr msg = {
+        .msg_name = NULL, .msg_namelen = 0,
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = control.buf, .msg_controllen = sizeof control.buf,
+        .msg_flags = 0,
+    };
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof fds);
+    memcpy(CMSG_DATA(c), fds, sizeof fds);
+
+    ssize_t size;
+    do
+        size = sendmsg(fd, &msg, 0);
+    while (size < 0 && errno == EINTR);
+    if (size < 0)
+        return false;
+
+    if (!write_all(fd, &buf->contents[1], buf->length - 1))
+        return false;
+    return shutdown(fd, SHUT_WR) >= 0;
+}
+
+/* Forwards the signal to the command running in the server. */
+void forward_signal(int signum)
+{
+    if (remote_pgid > 0) {
+        if (kill(-remote_pgid, signum) < 0)
+            kill(remote_pgid, signum);
+    } else {
+        pending_signal = signum;
+    }
+}
+
+/* Parses a line of the reply from the server. */
+void parse_reply(const char *line, int *restrict exitstatusp,
+        int *restrict termsigp)
+{
+    const char *value;
+    int number;
+
+    if ((value = matchstrprefix(line, "pid ")) != NULL) {
+        if (xstrtoi(value, 10, &number) && number > 0) {
+            remote_pgid = number;
+            if (pending_signal != 0)
+                kill(-remote_pgid, pending_signal);
+        }
+    } else if ((value = matchstrprefix(line, "exit ")) != NULL) {
+        if (xstrtoi(value, 10, &number))
+            *exitstatusp = number;
+    } else if ((value = matchstrprefix(line, "signal ")) != NULL) {
+        if (xstrtoi(value, 10, &number))
+            *termsigp = number;
+    }
+}
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
@@ -0,0 +1,37 @@
+/* Yash: yet another shell */
+/* server.h: pre-initialized shell server and its client */
+/* (C) 2024 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef YASH_SERVER_H
+#define YASH_SERVER_H
+
+#include <stddef.h>
+
+
+#define CONNECT_OPTION_PREFIX "--connect="
+
+extern int serve(const wchar_t *socketpath)
+    __attribute__((nonnull));
+extern int connect_to_server(const char *progname, const char *socketpath,
+        int argc, char *const *argv)
+    __attribute__((nonnull));
+
+
+#endif /* YASH_SERVER_H */
+
+
+/* vim: set ts=8 sts=4 sw=4 et tw=80: */
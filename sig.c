@@ -29,6 +29,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/select.h>
+#if HAVE_SIGNALFD
+# include <sys/signalfd.h>
+#endif
+#include <unistd.h>
 #include <wchar.h>
 #include <wctype.h>
 #if HAVE_GETTEXT
@@ -76,7 +80,12 @@
  *  - the shell performs pathname expansion.
  *
  * SIGTTOU is blocked in `put_foreground' and unblocked in `ensure_foreground'.
- * All signals are blocked to avoid race conditions when the shell forks. */
+ * All signals are blocked to avoid race conditions when the shell forks.
+ *
+ * Where signalfd is available, SIGCHLD is not unblocked while the shell waits
+ * for a child process or input. Instead, `sigchld_fd' is waited for together
+ * with the input and read when SIGCHLD is pending, which saves the signal
+ * delivery and the restart of the interrupted wait. */
 
 
 static int parse_signal_number(const wchar_t *number)
@@ -87,8 +96,17 @@ static int xsigaction(int signum, const struct sigaction *restrict newaction,
 static void set_special_handler(int signum, void (*handler)(int signum));
 static void reset_special_handler(
         int signum, void (*handler)(int signum), bool leave);
+#if HAVE_POSIX_SPAWN
+static bool add_spawn_default(
+        sigset_t *defaults, int signum, void (*handler)(int signum))
+    __attribute__((nonnull));
+#endif
 static void sig_handler(int signum);
 static void handle_sigchld(void);
+#if HAVE_SIGNALFD
+static int get_sigchld_fd(void);
+static void read_sigchld_fd(void);
+#endif
 static void set_trap(int signum, const wchar_t *command);
 static bool is_originally_ignored(int signum);
 static void banish_phantoms(void);
@@ -302,6 +320,14 @@ static bool job_handlers_set = false;
 /* true iff SIGTERM, SIGINT, SIGQUIT and SIGWINCH are ignored/handled. */
 static bool interactive_handlers_set = false;
 
+#if HAVE_SIGNALFD
+/* A signalfd that is readable when SIGCHLD is pending, or -1 if not open.
+ * This is a shell FD opened on demand by `get_sigchld_fd'. */
+static int sigchld_fd = -1;
+/* true iff signalfd is not available on the running system. */
+static bool sigchld_fd_failed = false;
+#endif
+
 /* Initializes the signal module. */
 void init_signal(void)
 {
@@ -370,6 +396,10 @@ void restore_signals(bool leave)
         reset_special_handler(SIGWINCH, sig_handler, leave);
 #endif
     }
+#if HAVE_SIGNALFD
+    /* `sigchld_fd' is closed by `clear_shellfds' or on exec. */
+    sigchld_fd = -1;
+#endif
     if (main_handler_set) {
         sigset_t ss = official_sigmask;
         if (leave) {
@@ -478,6 +508,62 @@ void reset_special_handler(int signum, void (*handler)(int signum), bool leave)
     }
 }
 
+#if HAVE_POSIX_SPAWN
+
+/* Computes the signal settings that an external command started by
+ * `posix_spawn' should inherit from the shell. The result is equivalent to what
+ * `restore_signals(true)' would do in a child process before exec.
+ * `defaults' is set to the set of signals whose handler must be reset to
+ * "default" in the command and `mask' to the signal mask of the command.
+ * Returns false if the settings cannot be expressed by `posix_spawn'
+ * attributes, that is, if a signal caught by the shell must be inherited as
+ * "ignore". */
+bool get_signal_settings_for_spawn(sigset_t *defaults, sigset_t *mask)
+{
+    sigemptyset(defaults);
+    if (job_handlers_set) {
+        if (!add_spawn_default(defaults, SIGTTIN, SIG_IGN)
+                || !add_spawn_default(defaults, SIGTTOU, SIG_IGN)
+                || !add_spawn_default(defaults, SIGTSTP, SIG_IGN))
+            return false;
+    }
+    if (interactive_handlers_set) {
+        if (!add_spawn_default(defaults, SIGINT, sig_handler)
+                || !add_spawn_default(defaults, SIGTERM, SIG_IGN)
+                || !add_spawn_default(defaults, SIGQUIT, SIG_IGN))
+            return false;
+#if YASH_ENABLE_LINEEDIT && defined(SIGWINCH)
+        if (!add_spawn_default(defaults, SIGWINCH, sig_handler))
+            return false;
+#endif
+    }
+    if (main_handler_set) {
+        if (!add_spawn_default(defaults, SIGCHLD, sig_handler))
+            return false;
+        *mask = official_sigmask;
+    } else {
+        sigprocmask(SIG_SETMASK, NULL, mask);
+    }
+    return true;
+}
+
+/* Does for `get_signal_settings_for_spawn' what `reset_special_handler' does
+ * for `restore_signals'. A handler other than SIG_IGN is reset to "default"
+ * by exec, so only SIG_IGN may need to be added to `defaults'. */
+bool add_spawn_default(
+        sigset_t *defaults, int signum, void (*handler)(int signum))
+{
+    if (sigismember(&trapped_signals, signum))
+        return true;
+    if (sigismember(&officially_ignored_signals, signum))
+        return handler == SIG_IGN;
+    if (handler == SIG_IGN)
+        sigaddset(defaults, signum);
+    return true;
+}
+
+#endif /* HAVE_POSIX_SPAWN */
+
 /* Unblocks SIGINT so that system calls can be interrupted.
  * First, this function must be called with the argument of true and this
  * function unblocks SIGINT. Later, this function must be called with the
@@ -533,6 +619,7 @@ void ignore_sigtstp(void)
  * On error, an error message is printed to the standard error. */
 void stop_myself(void)
 {
+    flush_stdout();
     if (kill(0, SIGSTOP) < 0)
         xerror(errno, Ngt("cannot send SIGSTOP signal"));
 }
@@ -588,10 +675,17 @@ int wait_for_sigchld(bool interruptible, bool return_on_trap)
 {
     int result = 0;
 
+    flush_stdout();
+
     sigset_t ss = accept_sigmask;
     sigdelset(&ss, SIGCHLD);
     if (interruptible)
         sigdelset(&ss, SIGINT);
+#if HAVE_SIGNALFD
+    int sigfd = get_sigchld_fd();
+    if (sigfd >= 0)
+        sigaddset(&ss, SIGCHLD);
+#endif
 
     for (;;) {
         if (return_on_trap && ((result = handle_traps()) != 0))
@@ -600,6 +694,20 @@ int wait_for_sigchld(bool interruptible, bool return_on_trap)
             break;
         if (sigchld_received)
             break;
+#if HAVE_SIGNALFD
+        if (sigfd >= 0) {
+            fd_set fdset;
+            FD_ZERO(&fdset);
+            FD_SET(sigfd, &fdset);
+            if (pselect(sigfd + 1, &fdset, NULL, NULL, NULL, &ss) > 0) {
+                read_sigchld_fd();
+            } else if (errno != EINTR) {
+                xerror(errno, "pselect");
+                break;
+            }
+            continue;
+        }
+#endif
         if (sigsuspend(&ss) < 0) {
             if (errno != EINTR) {
                 xerror(errno, "sigsuspend");
@@ -623,9 +731,8 @@ int wait_for_sigchld(bool interruptible, bool return_on_trap)
  * entering this function is ignored.
  * The maximum time length of wait is specified by `timeout' in milliseconds.
  * If `timeout' is negative, the wait time is unlimited.
- * If the wait is interrupted by a signal, this function will re-wait for the
- * specified timeout, which means that this function may wait for a time length
- * longer than the specified timeout. */
+ * If the wait is interrupted by a signal, this function re-waits for the rest
+ * of the timeout, so signals do not extend the total wait time. */
 enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
 {
     sigset_t ss;
@@ -638,6 +745,8 @@ enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
         return W_ERROR;
     }
 
+    flush_stdout();
+
     if (trap)
         sigint_received = false;
 
@@ -649,14 +758,17 @@ enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
         sigdelset(&ss, SIGWINCH);
 #endif
     }
-
-    if (timeout < 0) {
-        top = NULL;
-    } else {
-        to.tv_sec  = timeout / 1000;
-        to.tv_nsec = timeout % 1000 * 1000000;
-        top = &to;
+    int nfds = fd + 1;
+#if HAVE_SIGNALFD
+    int sigfd = get_sigchld_fd();
+    if (sigfd >= 0) {
+        sigaddset(&ss, SIGCHLD);
+        if (nfds <= sigfd)
+            nfds = sigfd + 1;
     }
+#endif
+
+    double deadline = (timeout >= 0) ? get_real_time() + timeout / 1000.0 : 0.0;
 
     for (;;) {
         handle_sigchld();
@@ -673,16 +785,39 @@ enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
         fd_set fdset;
         FD_ZERO(&fdset);
         FD_SET(fd, &fdset);
+#if HAVE_SIGNALFD
+        if (sigfd >= 0)
+            FD_SET(sigfd, &fdset);
+#endif
+
+        if (timeout < 0) {
+            top = NULL;
+        } else {
+            double remaining = deadline - get_real_time();
+            if (remaining < 0.0)
+                remaining = 0.0;
+            to.tv_sec  = (time_t) remaining;
+            to.tv_nsec = (long) ((remaining - to.tv_sec) * 1e9);
+            top = &to;
+        }
 
-        int count = pselect(fd + 1, &fdset, NULL, NULL, top, &ss);
+        int count = pselect(nfds, &fdset, NULL, NULL, top, &ss);
 
         if (trap && sigint_received) {
             sigint_received = false;
             return W_INTERRUPTED;
         }
 
-        if (count >= 0)
+        if (count >= 0) {
+#if HAVE_SIGNALFD
+            if (sigfd >= 0 && FD_ISSET(sigfd, &fdset)) {
+                read_sigchld_fd();
+                if (!FD_ISSET(fd, &fdset))
+                    continue;
+            }
+#endif
             return FD_ISSET(fd, &fdset) ? W_READY : W_TIMED_OUT;
+        }
 
         if (errno != EINTR) {
             xerror(errno, "pselect");
@@ -691,6 +826,123 @@ enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
     }
 }
 
+/* Waits for any of the file descriptors in `readfds' to be available for
+ * reading or any in `writefds' to be available for writing, or for SIGCHLD or
+ * a trapped signal to be caught. Either set may be NULL. `nfds' must be larger
+ * than any file descriptor in the sets.
+ * The maximum time length of wait is specified by `timeout' in milliseconds.
+ * If `timeout' is negative, the wait time is unlimited.
+ * Caught SIGCHLD and traps are handled before this function returns, and the
+ * sets are updated to contain the ready file descriptors only.
+ * Returns the signal number if a trap was executed or the shell was interrupted
+ * by SIGINT, zero if returned for another reason, or -1 on error. */
+int wait_for_events(int nfds,
+        fd_set *restrict readfds, fd_set *restrict writefds, int timeout)
+{
+    flush_stdout();
+
+    sigset_t ss = accept_sigmask;
+    sigdelset(&ss, SIGCHLD);
+    if (interactive_handlers_set)
+        sigdelset(&ss, SIGINT);
+
+    fd_set rfds, wfds;
+    if (readfds != NULL)
+        rfds = *readfds;
+    else
+        FD_ZERO(&rfds);
+    if (writefds != NULL)
+        wfds = *writefds;
+    else
+        FD_ZERO(&wfds);
+#if HAVE_SIGNALFD
+    int sigfd = get_sigchld_fd();
+    if (sigfd >= 0) {
+        sigaddset(&ss, SIGCHLD);
+        FD_SET(sigfd, &rfds);
+        if (nfds <= sigfd)
+            nfds = sigfd + 1;
+    }
+#endif
+
+    struct timespec to, *top;
+    if (timeout < 0) {
+        top = NULL;
+    } else {
+        to.tv_sec  = timeout / 1000;
+        to.tv_nsec = timeout % 1000 * 1000000;
+        top = &to;
+    }
+
+    int result = handle_traps();
+    if (result == 0 && !sigchld_received
+            && !(interactive_handlers_set && sigint_received)) {
+        int count = pselect(nfds, &rfds, &wfds, NULL, top, &ss);
+        if (count < 0) {
+            if (errno != EINTR) {
+                xerror(errno, "pselect");
+                result = -1;
+            }
+            FD_ZERO(&rfds);
+            FD_ZERO(&wfds);
+        }
+#if HAVE_SIGNALFD
+        if (sigfd >= 0 && FD_ISSET(sigfd, &rfds)) {
+            read_sigchld_fd();
+            FD_CLR(sigfd, &rfds);
+        }
+#endif
+        if (result == 0)
+            result = handle_traps();
+    } else {
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+    }
+    if (result == 0 && interactive_handlers_set && sigint_received) {
+        sigint_received = false;
+        result = SIGINT;
+    }
+    handle_sigchld();
+
+    if (readfds != NULL)
+        *readfds = rfds;
+    if (writefds != NULL)
+        *writefds = wfds;
+    return result;
+}
+
+#if HAVE_SIGNALFD
+
+/* Returns `sigchld_fd', opening it if not yet open.
+ * Returns -1 if SIGCHLD is not handled or signalfd is not available. */
+int get_sigchld_fd(void)
+{
+    if (sigchld_fd < 0 && !sigchld_fd_failed && main_handler_set) {
+        sigset_t ss;
+        sigemptyset(&ss);
+        sigaddset(&ss, SIGCHLD);
+        sigchld_fd = move_to_shellfd(
+                signalfd(-1, &ss, SFD_NONBLOCK | SFD_CLOEXEC));
+        if (sigchld_fd < 0)
+            sigchld_fd_failed = true;
+    }
+    return sigchld_fd;
+}
+
+/* Accepts SIGCHLD pending on `sigchld_fd' as if it was caught by the signal
+ * handler. */
+void read_sigchld_fd(void)
+{
+    struct signalfd_siginfo info[4];
+    bool received = false;
+    while (read(sigchld_fd, info, sizeof info) > 0)
+        received = true;
+    if (received)
+        sig_handler(SIGCHLD);
+}
+
+#endif /* HAVE_SIGNALFD */
+
 /* Handles SIGCHLD if caught. */
 void handle_sigchld(void)
 {
@@ -1418,6 +1670,9 @@ main:
         if (optind == argc)
             return insufficient_operands_error(1);
 
+        /* the signal may stop or kill the shell itself */
+        flush_stdout();
+
         do {
             wchar_t *proc = ARGV(optind);
             if (proc[0] == L'%') {
@@ -20,6 +20,10 @@
 #define YASH_SIG_H
 
 #include <stddef.h>
+#if HAVE_POSIX_SPAWN
+# include <signal.h>
+#endif
+#include <sys/select.h>
 #include <sys/types.h>
 #include "xgetopt.h"
 
@@ -38,6 +42,10 @@ extern void init_signal(void);
 extern void set_signals(void);
 extern void restore_signals(_Bool leave);
 extern void reset_job_signals(void);
+#if HAVE_POSIX_SPAWN
+extern _Bool get_signal_settings_for_spawn(sigset_t *defaults, sigset_t *mask)
+    __attribute__((nonnull));
+#endif
 extern void set_interruptible_by_sigint(_Bool onoff);
 extern void ignore_sigquit_and_sigint(void);
 extern void ignore_sigtstp(void);
@@ -51,6 +59,8 @@ enum wait_for_input_T {
 };
 
 extern enum wait_for_input_T wait_for_input(int fd, _Bool trap, int timeout);
+extern int wait_for_events(int nfds,
+        fd_set *restrict readfds, fd_set *restrict writefds, int timeout);
 
 extern int handle_traps(void);
 extern void execute_exit_trap(void);
@@ -21,6 +21,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -188,6 +189,21 @@ bool sb_wccat(xstrbuf_T *restrict buf, wchar_t c, mbstate_t *restrict ps)
 wchar_t *sb_wcsncat(xstrbuf_T *restrict buf,
         const wchar_t *restrict s, size_t n, mbstate_t *restrict ps)
 {
+    if (mbsinit(ps) && is_ascii_compatible_locale()) {
+        /* fast path: plain ASCII characters need no conversion */
+        size_t i = 0;
+        while (i < n && 0 < s[i] && s[i] < 0x80)
+            i++;
+        sb_ensuremax(buf, add(buf->length, i));
+        for (size_t j = 0; j < i; j++)
+            buf->contents[buf->length + j] = (char) s[j];
+        buf->length += i;
+        buf->contents[buf->length] = '\0';
+        s += i, n -= i;
+        if (n == 0 || *s == L'\0')
+            return NULL;
+    }
+
 #if HAVE_WCSNRTOMBS
     for (;;) {
         const wchar_t *saves = s;
@@ -422,6 +438,22 @@ char *wb_mbscat(xwcsbuf_T *restrict buf, const char *restrict s)
 
     memset(&state, 0, sizeof state);  // initialize as the initial shift state
 
+    if (is_ascii_compatible_locale()) {
+        /* fast path: plain ASCII characters need no conversion */
+        const unsigned char *us = (const unsigned char *) s;
+        size_t i = 0;
+        while (0 < us[i] && us[i] < 0x80)
+            i++;
+        wb_ensuremax(buf, add(buf->length, i));
+        for (size_t j = 0; j < i; j++)
+            buf->contents[buf->length + j] = (wchar_t) us[j];
+        buf->length += i;
+        buf->contents[buf->length] = L'\0';
+        s += i;
+        if (*s == '\0')
+            return NULL;
+    }
+
     for (;;) {
         count = mbsrtowcs(&buf->contents[buf->length], (const char **) &s,
                 buf->maxlength - buf->length + 1, &state);
@@ -553,6 +585,29 @@ wchar_t *malloc_mbstowcs(const char *s)
     }
 }
 
+/* Tests if the current locale is stateless and converts every ASCII byte to the
+ * wide character of the same value.
+ * The result is cached for the last seen LC_CTYPE locale. */
+bool is_ascii_compatible_locale(void)
+{
+    static char *lastlocale = NULL;
+    static bool lastresult;
+
+    const char *locale = setlocale(LC_CTYPE, NULL);
+    if (locale == NULL)
+        return false;
+    if (lastlocale != NULL && strcmp(locale, lastlocale) == 0)
+        return lastresult;
+
+    free(lastlocale);
+    lastlocale = xstrdup(locale);
+    lastresult = (mblen(NULL, 0) == 0);  // stateless encoding
+    for (int c = 1; lastresult && c < 0x80; c++)
+        if (btowc(c) != (wint_t) c)
+            lastresult = false;
+    return lastresult;
+}
+
 
 /********** Formatting Utilities **********/
 
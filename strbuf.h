@@ -31,6 +31,15 @@
 #ifndef XWCSBUF_INITSIZE
 #define XWCSBUF_INITSIZE 15
 #endif
+/* If a buffer has more unused space than this when its contents are taken by
+ * `sb_tostr' or `wb_towcs', the buffer is shrunk to the exact size so that
+ * long-lived strings do not keep the slack left by geometric growth. */
+#ifndef XSTRBUF_MAXSLACK
+#define XSTRBUF_MAXSLACK 63
+#endif
+#ifndef XWCSBUF_MAXSLACK
+#define XWCSBUF_MAXSLACK 15
+#endif
 
 
 typedef struct xstrbuf_T {
@@ -191,6 +200,7 @@ extern wchar_t *malloc_mbstowcs(const char *s)
     __attribute__((nonnull,malloc,warn_unused_result));
 static inline wchar_t *realloc_mbstowcs(char *s)
     __attribute__((nonnull,malloc,warn_unused_result));
+extern _Bool is_ascii_compatible_locale(void);
 
 extern char *malloc_vprintf(const char *format, va_list ap)
     __attribute__((nonnull(1),malloc,warn_unused_result,format(printf,1,0)));
@@ -214,13 +224,21 @@ xstrbuf_T *sb_init(xstrbuf_T *buf)
 /* Frees the specified multibyte string buffer. The contents are lost. */
 void sb_destroy(xstrbuf_T *buf)
 {
-    free(sb_tostr(buf));
+    char *s = buf->contents;
+#ifndef NDEBUG
+    buf->contents = &s[buf->maxlength];
+    buf->length = buf->maxlength = Size_max;
+#endif
+    free(s);
 }
 
 /* Frees the specified multibyte string buffer and returns the contents.
  * The caller must `free' the return value. */
 char *sb_tostr(xstrbuf_T *buf)
 {
+    if (buf->maxlength - buf->length > XSTRBUF_MAXSLACK)
+        sb_setmax(buf, buf->length);
+
     char *s = buf->contents;
 #ifndef NDEBUG
     buf->contents = &s[buf->maxlength];
@@ -336,13 +354,21 @@ xwcsbuf_T *wb_init(xwcsbuf_T *buf)
 /* Frees the specified wide string buffer. The contents are lost. */
 void wb_destroy(xwcsbuf_T *buf)
 {
-    free(wb_towcs(buf));
+    wchar_t *s = buf->contents;
+#ifndef NDEBUG
+    buf->contents = &s[buf->maxlength];
+    buf->length = buf->maxlength = Size_max;
+#endif
+    free(s);
 }
 
 /* Frees the specified wide string buffer and returns the contents.
  * The caller must `free' the return value. */
 wchar_t *wb_towcs(xwcsbuf_T *buf)
 {
+    if (buf->maxlength - buf->length > XWCSBUF_MAXSLACK)
+        wb_setmax(buf, buf->length);
+
     wchar_t *s = buf->contents;
 #ifndef NDEBUG
     buf->contents = &s[buf->maxlength];
@@ -190,6 +190,23 @@ a a
 a a
 __OUT__
 
+test_oE -e 0 'aliases sharing the first character of their names'
+alias ab='echo ab' ac='echo ac'
+ab
+unalias ab
+ac
+alias ab='echo AB'
+ab
+unalias -a
+alias ab='echo ab'
+ab
+__IN__
+ab
+ac
+AB
+ab
+__OUT__
+
 test_oE -e 0 'printing all aliases (without -p)'
 alias a=A b=B c=C
 alias -g x=X y=Y z=Z
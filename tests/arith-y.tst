@@ -362,6 +362,39 @@ __IN__
 14 14 14
 __OUT__
 
+test_oE 'evaluating the same expression repeatedly'
+i=0 x=1 y=0
+while [ $((i < 4)) -ne 0 ]; do
+    echo $((i++ % 2 ? (x *= 2) : y++ || (x += 10))) $i $x $y
+done
+__IN__
+1 1 11 1
+22 2 22 1
+1 3 22 2
+44 4 44 2
+__OUT__
+
+test_oE 'variables assigned in arithmetic expansion'
+x=010
+: $((x += 2)) $((y = -x))
+echo "$x" "${#y}" "${x}0"
+export x
+sh -c 'echo "$x"'
+typeset -p y
+__IN__
+10 3 100
+10
+typeset y=-10
+__OUT__
+
+test_Oe -e 2 'prefix ++ applied to a number'
+eval 'echoraw $((++1))'
+__IN__
+eval: arithmetic: operator `++' requires a variable
+__ERR__
+#'
+#`
+
 test_Oe -e 2 'empty arithmetic expansion'
 eval '$(())'
 __IN__
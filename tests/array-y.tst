@@ -366,6 +366,121 @@ __ERR__
 
 )
 
+(
+setup - <<\__END__
+array -A m one 1 'a  b' 'c  d' two 2 one I
+__END__
+
+test_oE -e 0 'defining associative array'
+echo "${m[one]}" "${m[a  b]}" "${m[two]}"
+echo "${m[@]}"
+echo "${m[#]}"
+__IN__
+I c  d 2
+c  d I 2
+3
+__OUT__
+
+test_oE -e 0 'expanding associative array element with expanded key'
+k='a  b'
+bracket "${m[$k]}" "${m["$k"]}" "${m[t${k%%a*}wo]}"
+__IN__
+[c  d][c  d][2]
+__OUT__
+
+test_oE -e 0 'expanding nonexistent associative array element'
+bracket "${m[three]}" "${m[three]-unset}" "${m[one]+set}"
+__IN__
+[][unset][set]
+__OUT__
+
+test_oE -e 0 'assigning associative array element in parameter expansion'
+bracket "${m[three]=3}" "${m[three]}" "${m[one]=X}"
+__IN__
+[3][3][I]
+__OUT__
+
+test_oE -e 0 'printing associative array'
+array -A e
+typeset -p m e
+array
+__IN__
+array -A -- m 'a  b' 'c  d' one I two 2
+typeset m
+array -A -- e
+typeset e
+array -A -- e
+array -A -- m 'a  b' 'c  d' one I two 2
+__OUT__
+
+test_oE -e 0 'getting keys of associative array'
+array -k m k
+bracket "${k[@]}"
+__IN__
+[a  b][one][two]
+__OUT__
+
+test_oE -e 0 'setting associative array element'
+array -s m one 1
+array -s m three 3
+bracket "${m[one]}" "${m[three]}" "${m[#]}"
+__IN__
+[1][3][4]
+__OUT__
+
+test_oE -e 0 'deleting associative array elements'
+array -d m one three
+bracket "${m[@]}"
+__IN__
+[c  d][2]
+__OUT__
+
+test_oE -e 0 'local associative array'
+f() {
+    typeset m
+    array -A m one local
+    echo "${m[one]}"
+}
+f
+echo "${m[one]}"
+__IN__
+local
+I
+__OUT__
+
+test_Oe -e n 'defining associative array (missing value)'
+array -A x a 1 b
+__IN__
+array: the value for key `b' is missing
+__ERR__
+#'
+#`
+
+test_Oe -e n 'setting associative array element (read-only)'
+readonly m
+array -s m one 1
+__IN__
+array: $m is read-only
+__ERR__
+
+test_Oe -e n 'inserting associative array elements'
+array -i m 1 x
+__IN__
+array: $m is an associative array
+__ERR__
+
+test_Oe -e n 'getting keys of nonexistent associative array'
+array -k x k
+__IN__
+array: no such associative array $x
+__ERR__
+
+test_O -d -e n 'range index of associative array'
+echo "${m[one,two]}"
+__IN__
+
+)
+
 test_Oe -e n 'invalid option'
 array --no-such-option
 __IN__
@@ -374,6 +489,110 @@ __ERR__
 #'
 #`
 
+test_oE -e 0 'appending to array'
+a=(1 '2  2')
+a+=(3 "$a")
+a+=()
+bracket "$a"
+__IN__
+[1][2  2][3][1][2  2]
+__OUT__
+
+test_oE -e 0 'appending to scalar makes array'
+a=1
+a+=(2 3)
+b=
+b+=(x)
+bracket "$a" / "$b"
+__IN__
+[1][2][3][/][][x]
+__OUT__
+
+test_oE -e 0 'appending to undefined variable makes array'
+unset a
+a+=(1 2)
+bracket "$a"
+__IN__
+[1][2]
+__OUT__
+
+test_oE -e 0 'scalar appending assignment to array adds element'
+a=(1 2)
+a+=3 a+=''
+bracket "$a"
+__IN__
+[1][2][3][]
+__OUT__
+
+test_oE -e 0 'scalar appending assignment does not modify first element'
+array c 1
+c+=2
+bracket "$c"
+__IN__
+[1][2]
+__OUT__
+
+test_oE -e 0 'appending to array many times'
+a=()
+i=0
+while [ $i -lt 1000 ]; do
+    a+=($i)
+    i=$((i+1))
+done
+echo ${a[#]} ${a[1]} ${a[500]} ${a[1000]}
+__IN__
+1000 0 499 999
+__OUT__
+
+test_oE -e 0 'appending to array in temporary assignment'
+f() { bracket "$a"; }
+a=(1 2)
+a+=(3) f
+bracket "$a"
+__IN__
+[1][2][3]
+[1][2]
+__OUT__
+
+test_oE -e 0 'appending to array while expanding it'
+a=(1 2)
+for i in "$a"; do
+    a+=($i)
+done
+bracket "$a"
+__IN__
+[1][2][1][2]
+__OUT__
+
+test_O -d -e 2 'appending to read-only array'
+a=(1)
+readonly a
+a+=(2)
+__IN__
+
+test_O -d -e 2 'appending to associative array'
+array -A m k v
+m+=(x)
+__IN__
+
+test_oE -e 0 'removing many elements at once'
+a=(1 2 3 4 5 6 7)
+array -d a 2 4 4 -1 9 -9
+bracket "$a"
+__IN__
+[1][3][5][6]
+__OUT__
+
+test_Oe -e 0 'xtrace of appending assignment'
+a=(1) b=
+set -x
+a+=(2 '3  3') b+=4
+set +x
+__IN__
++ a+=(2 '3  3') b+=4
++ set '+x'
+__ERR__
+
 test_Oe -e 2 'no array assignment in POSIX mode' --posix
 foo=()
 __IN__
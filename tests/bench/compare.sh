@@ -0,0 +1,68 @@
+# compare.sh: compares benchmark results with a baseline
+# (C) 2024 magicant
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# This script expects two operands: the baseline and the current results,
+# both in the format printed by run-bench.sh.
+# For each benchmark in the current results, a line of the following fields
+# is printed:
+#   name real base_real maxrss base_maxrss forks base_forks verdict
+# where forks is the sum of the fork and spawn counts. The verdict is "slower"
+# if the elapsed time grew by more than $BENCH_TOLERANCE percent (25 by
+# default) and 20 milliseconds, "bigger" if the maximum resident set size or
+# the reported private memory of a subshell (childrss) grew by more than
+# $BENCH_TOLERANCE percent, "forks" if the shell forked more, and "ok"
+# otherwise. Benchmarks missing from the baseline are marked "new".
+# The exit status is 1 if any benchmark is not "ok" or "new".
+
+set -Ceu
+
+baseline="${1:?baseline not specified}"
+current="${2:?current results not specified}"
+
+exec awk -v tolerance="${BENCH_TOLERANCE:-25}" '
+BEGIN {
+    print "# name real base_real maxrss base_maxrss forks base_forks verdict"
+}
+/^#/ { next }
+NR == FNR {
+    real[$1] = $2; maxrss[$1] = $5; forks[$1] = $6 + $7; childrss[$1] = $8
+    next
+}
+{
+    name = $1; f = $6 + $7
+    if (!(name in real)) {
+        print name, $2, "-", $5, "-", f, "-", "new"
+        next
+    }
+    limit = 1 + tolerance / 100
+    verdict = "ok"
+    if ($2 > real[name] * limit && $2 - real[name] > 0.02)
+        verdict = "slower"
+    else if ($5 > maxrss[name] * limit)
+        verdict = "bigger"
+    else if ($8 ~ /^[0-9]+$/ && childrss[name] ~ /^[0-9]+$/ &&
+            $8 > childrss[name] * limit)
+        verdict = "bigger"
+    else if (f > forks[name])
+        verdict = "forks"
+    if (verdict != "ok")
+        regressed = 1
+    print name, $2, real[name], $5, maxrss[name], f, forks[name], verdict
+}
+END { exit regressed }
+' "$baseline" "$current"
+
+# vim: set ts=8 sts=4 sw=4 et:
@@ -0,0 +1,165 @@
+# run-bench.sh: runs benchmarks and prints their results
+# (C) 2024 magicant
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# This script expects the pathname to the testee, the shell that is to be
+# measured, followed by the pathnames to benchmark files.
+# A benchmark file is a script that defines the following functions:
+#   bench_setup    (optional) run once before the measurement
+#   bench_prepare  (optional) run before each measured run
+#   bench_run      the measured part
+# The functions are run by the testee in a temporary directory that is
+# created for each benchmark file. The testee is exported as $TESTEE.
+# The measured part is run as many times as specified by the -n option (3 by
+# default) and the run with the shortest elapsed time is reported as a line of
+# the following fields, separated by spaces:
+#   name real user sys maxrss fork spawn childrss
+# The name is that of the benchmark file without the directory and extension.
+# The times are in seconds and the maximum resident set size is in kilobytes,
+# as measured by the "time" keyword. The next two fields are the numbers of
+# forks and posix_spawn calls counted by the stats built-in of the testee.
+# The last field is a figure in kilobytes that bench_run may report by writing
+# a line "childrss <value>" to file descriptor 3, or "-" if not reported.
+# Since the "time" keyword is used, this script must be run by yash.
+# The exit status is non-zero if any benchmark fails.
+
+set -Ceu
+umask u+rwx
+
+# $1 = pathname
+absolute()
+case "$1" in
+    (/*)
+        printf '%s\n' "$1";;
+    (*)
+        printf '%s/%s\n' "${PWD%/}" "$1";;
+esac
+
+# Converts a time in seconds with three fractional digits to milliseconds.
+# $1 = time
+to_msec() {
+    _sec="${1%.*}" _frac="${1#*.}"
+    while case "$_frac" in (0?*) true;; (*) false;; esac; do
+        _frac="${_frac#0}"
+    done
+    printf '%d\n' "$((_sec * 1000 + _frac))"
+}
+
+repeat=3
+while getopts n: opt; do
+    case $opt in
+        (n)
+            repeat="$OPTARG";;
+        (*)
+            exit 64 # sysexits.h EX_USAGE
+    esac
+done
+shift "$((OPTIND-1))"
+
+TESTEE="$(absolute "$(command -v -- "${1:?testee not specified}")")"
+export TESTEE
+shift
+
+export LC_ALL=C
+unset -v CDPATH ENV HISTFILE HISTSIZE PROMPT_COMMAND POST_PROMPT_COMMAND
+unset -v YASH_AFTER_CD YASH_PROFILE YASH_PROFILE_FOLDED
+export YASH_LOADPATH= # ignore default yashrc
+
+top_dir="$PWD"
+work_dir="$top_dir/bench.$$"
+
+rm_work_dir() {
+    if [ -d "$work_dir" ]; then chmod -R a+rwX "$work_dir"; fi
+    rm -fr "$work_dir"
+}
+
+trap rm_work_dir EXIT
+trap 'rm_work_dir; trap - INT;  kill -INT  $$' INT
+trap 'rm_work_dir; trap - TERM; kill -TERM $$' TERM
+
+# $1 = benchmark file, $2 = function name
+run_function() {
+    "$TESTEE" -c '. "$1" && if command -v "$2" >/dev/null; then "$2"; fi' \
+        "$TESTEE" "$1" "$2"
+}
+
+TIMEFORMAT='%R %U %S %M'
+status=0
+
+printf '# name real user sys maxrss fork spawn childrss\n'
+
+for bench_file do
+    name="${bench_file##*/}" name="${name%.*}"
+    bench_file="$(absolute "$bench_file")"
+
+    rm_work_dir
+    mkdir "$work_dir" "$work_dir/run"
+    cd "$work_dir/run"
+
+    if ! run_function "$bench_file" bench_setup >/dev/null; then
+        printf '%s: setup failed\n' "$name" >&2
+        status=1
+        cd "$top_dir"
+        continue
+    fi
+
+    best='' best_msec=''
+    i=0
+    while [ "$i" -lt "$repeat" ]; do
+        i="$((i+1))"
+        run_function "$bench_file" bench_prepare >/dev/null || break
+
+        if ! {
+            time "$TESTEE" -c \
+                '. "$1" && bench_run >/dev/null && stats fork spawn >&3' \
+                "$TESTEE" "$bench_file" \
+                2>|"$work_dir/err" 3>|"$work_dir/stats"
+        } 2>|"$work_dir/time"; then
+            i=-1
+            break
+        fi
+
+        fork=- spawn=- childrss=-
+        while read -r counter value; do
+            case $counter in
+                (fork)     fork="$value";;
+                (spawn)    spawn="$value";;
+                (childrss) childrss="$value";;
+            esac
+        done <"$work_dir/stats"
+        read -r real user sys maxrss <"$work_dir/time"
+
+        msec="$(to_msec "$real")"
+        if [ -z "$best_msec" ] || [ "$msec" -lt "$best_msec" ]; then
+            best="$real $user $sys $maxrss $fork $spawn $childrss"
+            best_msec="$msec"
+        fi
+    done
+
+    cd "$top_dir"
+
+    if [ "$i" -ne "$repeat" ]; then
+        printf '%s: benchmark failed\n' "$name" >&2
+        if [ -f "$work_dir/err" ]; then cat "$work_dir/err" >&2; fi
+        status=1
+        continue
+    fi
+
+    printf '%s %s\n' "$name" "$best"
+done
+
+exit "$status"
+
+# vim: set ts=8 sts=4 sw=4 et:
@@ -152,6 +152,31 @@ __IN__
 [{1..3}][{1..3}][{1..3}]
 __OUT__
 
+test_oE 'numeric brace expansion as the only word of for loop'
+for i in {1..3}; do bracket $i; done
+for i in {08..12..2}; do bracket $i; done
+for i in {+3..-3..-3}; do bracket $i; done
+__IN__
+[1]
+[2]
+[3]
+[08]
+[10]
+[12]
+[+3]
+[+0]
+[-3]
+__OUT__
+
+test_oE 'breaking for loop over numeric brace expansion'
+for i in {1..1000000000}; do
+    if [ "$i" -eq 3 ]; then break; fi
+done
+echo $i
+__IN__
+3
+__OUT__
+
 )
 
 test_oE 'disabled brace expansion'
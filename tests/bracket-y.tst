@@ -248,6 +248,16 @@ test_OE -e 0 '&& has higher precedence to the left of ||'
 [[ foo = foo || 1 -eq 1 && -z bar ]]
 __IN__
 
+test_OE -e 0 'testing the same file more than once'
+>file
+ln -s file link
+[[ -f file && ! -s file && -e file && ! -L file && -L link && -f link ]]
+__IN__
+
+test_OE -e 0 'file tested again after command substitution modifies it'
+[[ ! -e newfile && $(>newfile) = "" && -e newfile ]]
+__IN__
+
 # Note: other shells (bash, ksh, mksh and zsh) don't accept this
 test_OE -e 0 'IO_NUMBER is not special between [[ and ]]'
 [[ 0<1 ]]
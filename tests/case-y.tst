@@ -42,6 +42,22 @@ __IN__
 matched
 __OUT__
 
+test_oE 'patterns are matched correctly when used repeatedly'
+for i in 1 2 3; do
+    for p in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20; do
+        case $p in
+            (*[13579]) printf o;;
+            (*)        printf e;;
+        esac
+    done
+    case $i in "$i"*) echo;; esac
+done
+__IN__
+oeoeoeoeoeoeoeoeoeoe
+oeoeoeoeoeoeoeoeoeoe
+oeoeoeoeoeoeoeoeoeoe
+__OUT__
+
 test_Oe -e 2 'in without case'
 in
 __IN__
@@ -123,6 +123,24 @@ __IN__
 }
 __OUT__
 
+test_multi 'timed pipeline, multi-line'
+{ time echo | cat; time ! echo; }
+__IN__
+{
+   time echo | cat
+   time ! echo
+}
+__OUT__
+
+test_multi 'timed pipeline with -p and without command, multi-line'
+{ time -p -- echo; time; }
+__IN__
+{
+   time -p echo
+   time
+}
+__OUT__
+
 # Non-empty grouping is tested in other tests above.
 
 test_single 'grouping, w/o commands, single line'
@@ -531,6 +549,14 @@ __IN__
 }
 __OUT__
 
+test_multi 'appending assignment'
+{ foo+=FOO bar+=(1 $2); }
+__IN__
+{
+   foo+=FOO bar+=(1 ${2})
+}
+__OUT__
+
 test_multi 'single-line redirections'
 { <f >g 2>|h 10>>i <>j <&1 >&2 >>|"3" <<<here\ string; }
 __IN__
@@ -582,6 +608,18 @@ EOF
 }
 __OUT__
 
+test_multi 'here-document, quoted, with backslashes'
+{ <<\END; }
+\$1 \\ \
+END
+__IN__
+{
+   0<<\END
+\$1 \\ \
+END
+}
+__OUT__
+
 test_single 'here-document, hyphen-prefixed operand'
 {
 cat fifo << -FOO <<--BA\R
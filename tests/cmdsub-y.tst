@@ -91,4 +91,79 @@ __ERR__
 #`
 #`
 
+test_oE 'built-ins and functions in command substitution'
+f() { printf '%s\n' "$@"; echo; }
+a=$(echo a; f b c; :; true)
+printf "[%s]" "$a" "$(false)" "$(f ${a%%?*})"; echo
+test "$(pwd)" = "$PWD" && echo pwd ok
+__IN__
+[a
+b
+c][][]
+pwd ok
+__OUT__
+
+test_oE 'exit status of command substitution with built-ins'
+a=$(false) && echo not reached 1
+a=$(true; false) || echo ok $?
+a=$(false; true) && echo ok $?
+__IN__
+ok 1
+ok 0
+__OUT__
+
+test_oE 'variable assignment affects only subshell' -e
+f() { a=x; echo f; }
+a=a
+b=$(f)
+printf "[%s]" "$a" "$b"; echo
+__IN__
+[a][f]
+__OUT__
+
+test_oE 'errexit in command substitution with built-ins' -e
+a=$(false; echo not reached)
+echo not reached
+__IN__
+__OUT__
+
+test_oE 'errexit with single built-in in command substitution' -e
+a=$(echo a)
+b=$(false) || echo ok $?
+printf "[%s]" "$a" "$b"; echo
+__IN__
+ok 1
+[a][]
+__OUT__
+
+test_oE 'newlines before null byte are trimmed'
+a=$(printf 'a\n\0b')
+b=$(printf 'c\n\n\0' >&1)
+printf "[%s]" "$a" "$b"; echo
+__IN__
+[a][c]
+__OUT__
+
+test_oE '$RANDOM in command substitution does not affect shell'
+RANDOM=5
+a=$(echo $RANDOM)
+b=$(echo $RANDOM)
+test "$a" = "$b" && echo same
+__IN__
+same
+__OUT__
+
+test_oE 'long output of command substitution'
+i=0 s=0123456789
+while [ "$i" -lt 10 ]; do s=$s$s i=$((i+1)); done
+a=$( (printf '%s\n\n' "$s" "$s" "$s") )
+[ "$a" = "$s
+
+$s
+
+$s" ] && echo ${#a}
+__IN__
+30724
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
@@ -0,0 +1,99 @@
+# coproc-y.tst: yash-specific test of the coproc built-in
+
+test_oE -e 0 'coproc connects command to shell via pipes'
+coproc cat
+echo foo >&"${COPROC[2]}"
+read -r line <&"${COPROC[1]}"
+echo "$line"
+__IN__
+foo
+__OUT__
+
+test_oE -e 0 'coproc serves multiple requests'
+coproc -n C sed -u 's/^/got /'
+for i in 1 2 3; do
+    echo "$i" >&"${C[2]}"
+    read -r line <&"${C[1]}"
+    echo "$line"
+done
+__IN__
+got 1
+got 2
+got 3
+__OUT__
+
+test_oE -e 0 'coproc with function'
+f() { while read -r x; do echo "f $x"; done; }
+coproc f
+echo bar >&"${COPROC[2]}"
+read -r line <&"${COPROC[1]}"
+echo "$line"
+__IN__
+f bar
+__OUT__
+
+test_oE -e 0 'coproc job can be waited for'
+coproc -n C cat
+echo baz >&"${C[2]}"
+eval "exec ${C[2]}>&-"
+cat <&"${C[1]}"
+wait "$C_PID"
+echo $?
+__IN__
+baz
+0
+__OUT__
+
+test_oE -e 0 'coproc does not inherit pipes of other coprocs'
+coproc -n A cat
+coproc -n B read -r x
+echo foo >&"${A[2]}"
+eval "exec ${A[2]}>&-"
+cat <&"${A[1]}"
+echo bar >&"${B[2]}"
+wait
+__IN__
+foo
+__OUT__
+
+test_oE -e 0 'coproc closes pipes if variable cannot be assigned'
+readonly C
+coproc -n C cat 2>/dev/null
+echo $?
+readonly D_PID=
+coproc -n D cat 2>/dev/null
+echo $?
+wait
+__IN__
+1
+1
+__OUT__
+
+test_oE -e 0 'coproc job is in job list'
+coproc -n C cat
+jobs
+eval "exec ${C[2]}>&-"
+wait
+__IN__
+[1] + Running              cat
+__OUT__
+
+test_Oe -e 2 'coproc without operand'
+coproc
+__IN__
+coproc: this command requires an operand
+__ERR__
+
+test_Oe -e 1 'coproc with invalid name'
+coproc -n = cat
+__IN__
+coproc: `=' is not a valid variable name
+__ERR__
+
+test_oE -e 0 'coproc is an elective built-in'
+command -V coproc
+__IN__
+coproc: an elective built-in
+__OUT__
+
+# vim: set ft=sh ts=8 sts=4 sw=4 et:
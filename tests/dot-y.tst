@@ -112,6 +112,22 @@ __IN__
 bar
 __OUT__
 
+test_oE 'file added to $LOADPATH is found after re-assignment or hash -r'
+p="$PWD/testpath"
+YASH_LOADPATH="$p/dir1:$p/dir2"
+command . -L baz 2>/dev/null || echo not found
+echo 'echo baz 1' >"$p/dir2/baz"
+YASH_LOADPATH="$YASH_LOADPATH"
+. -L baz
+echo 'echo baz 2' >"$p/dir1/baz"
+hash -r
+. -L baz
+__IN__
+not found
+baz 1
+baz 2
+__OUT__
+
 (
 chmod a+x print_args
 if command -v print_args >/dev/null 2>&1; then
@@ -188,4 +204,33 @@ __ERR__
 #'
 #`
 
+test_oE 'parse cache is reused and invalidated by aliases'
+YASH_PARSE_CACHE="$PWD/parsecache"
+cat >cached <<'END'
+f() { printf '[%s]\n' "${1:-none}" $((1+2)) "$(echo sub)"; }
+f
+a x
+END
+alias a='echo A'
+. ./cached
+. ./cached
+alias a='echo B'
+. ./cached
+test -d parsecache && echo cached
+__IN__
+[none]
+[3]
+[sub]
+A x
+[none]
+[3]
+[sub]
+A x
+[none]
+[3]
+[sub]
+B x
+cached
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
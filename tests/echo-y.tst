@@ -207,4 +207,56 @@ test_O -d -e n 'echoing to closed stream'
 echo >&-
 __IN__
 
+(
+if ! [ -c /dev/full ]; then
+    skip="true"
+fi
+
+test_o 'write error is detected before and-or list tests status'
+exec 3>&1 >/dev/full
+echo x || echo failed >&3
+echo y && echo not reached >&3
+__IN__
+failed
+__OUT__
+
+test_O -d -e 1 'write error is detected before errexit applies'
+exec 3>&1 >/dev/full
+set -e
+echo x
+echo not reached >&3
+__IN__
+
+)
+
+(
+if ! (ulimit -f 0) 2>/dev/null; then
+    skip="true"
+fi
+
+# With a file size limit of zero, writing to the regular file fails, so the
+# deferred output of the built-ins cannot be flushed.
+
+test_oE 'write error of deferred output is detected when status is tested'
+trap '' XFSZ
+(ulimit -f 0; exec >out; echo x || echo failed $? >&2) 2>&1 |
+sed 's/.*cannot print to the standard output.*/error/'
+__IN__
+error
+failed 1
+__OUT__
+
+test_oE 'write error of deferred output is reported once on exit'
+set -o pipefail
+trap '' XFSZ
+(ulimit -f 0; exec >out; echo x; echo y) 2>&1 |
+sed 's/.*cannot print to the standard output.*/error/'
+echo $?
+__IN__
+error
+1
+__OUT__
+
+)
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
@@ -286,6 +286,8 @@ test_nonspecial_builtin_syntax "$LINENO" cd
 test_nonspecial_builtin_syntax "$LINENO" command
 # Non-standard built-in complete skipped
 # test_nonspecial_builtin_syntax "$LINENO" complete
+# Non-standard built-in coproc skipped
+# test_nonspecial_builtin_syntax "$LINENO" coproc
 # Non-standard built-in dirs skipped
 # test_nonspecial_builtin_syntax "$LINENO" dirs
 # Non-standard built-in disown skipped
@@ -304,6 +306,12 @@ test_nonspecial_builtin_syntax "$LINENO" hash
 # test_nonspecial_builtin_syntax "$LINENO" history
 test_nonspecial_builtin_syntax "$LINENO" jobs
 test_nonspecial_builtin_syntax "$LINENO" kill
+# Non-standard built-in load skipped
+# test_nonspecial_builtin_syntax "$LINENO" load
+# Non-standard built-in mapfile skipped
+# test_nonspecial_builtin_syntax "$LINENO" mapfile
+# Non-standard built-in poll skipped
+# test_nonspecial_builtin_syntax "$LINENO" poll
 # Non-standard built-in popd skipped
 # test_nonspecial_builtin_syntax "$LINENO" popd
 test_nonspecial_builtin_syntax "$LINENO" printf
@@ -311,6 +319,8 @@ test_nonspecial_builtin_syntax "$LINENO" printf
 # test_nonspecial_builtin_syntax "$LINENO" pushd
 test_nonspecial_builtin_syntax "$LINENO" pwd
 test_nonspecial_builtin_syntax "$LINENO" read
+# Non-standard built-in stats skipped
+# test_nonspecial_builtin_syntax "$LINENO" stats
 # Non-standard built-in suspend skipped
 # test_nonspecial_builtin_syntax "$LINENO" suspend
 test_nonspecial_builtin_syntax "$LINENO" test
@@ -333,6 +343,7 @@ test_nonspecial_builtin_redirect "$LINENO" cat # example of external command
 # test_nonspecial_builtin_redirect "$LINENO" cd # tested in error-p.tst
 test_nonspecial_builtin_redirect "$LINENO" command
 test_nonspecial_builtin_redirect "$LINENO" complete
+test_nonspecial_builtin_redirect "$LINENO" coproc
 test_nonspecial_builtin_redirect "$LINENO" dirs
 test_nonspecial_builtin_redirect "$LINENO" disown
 test_nonspecial_builtin_redirect "$LINENO" echo
@@ -345,11 +356,15 @@ test_nonspecial_builtin_redirect "$LINENO" help
 test_nonspecial_builtin_redirect "$LINENO" history
 test_nonspecial_builtin_redirect "$LINENO" jobs
 test_nonspecial_builtin_redirect "$LINENO" kill
+test_nonspecial_builtin_redirect "$LINENO" load
+test_nonspecial_builtin_redirect "$LINENO" mapfile
+test_nonspecial_builtin_redirect "$LINENO" poll
 test_nonspecial_builtin_redirect "$LINENO" popd
 test_nonspecial_builtin_redirect "$LINENO" printf
 test_nonspecial_builtin_redirect "$LINENO" pushd
 test_nonspecial_builtin_redirect "$LINENO" pwd
 test_nonspecial_builtin_redirect "$LINENO" read
+test_nonspecial_builtin_redirect "$LINENO" stats
 test_nonspecial_builtin_redirect "$LINENO" suspend
 test_nonspecial_builtin_redirect "$LINENO" test
 test_nonspecial_builtin_redirect "$LINENO" true
@@ -455,6 +470,7 @@ test_nonspecial_builtin_syntax "$LINENO" bindkey
 test_nonspecial_builtin_syntax "$LINENO" cd
 test_nonspecial_builtin_syntax "$LINENO" command
 test_nonspecial_builtin_syntax "$LINENO" complete
+test_nonspecial_builtin_syntax "$LINENO" coproc
 test_nonspecial_builtin_syntax "$LINENO" dirs
 test_nonspecial_builtin_syntax "$LINENO" disown
 # No argument syntax error in non-special built-in echo
@@ -469,11 +485,15 @@ test_nonspecial_builtin_syntax "$LINENO" help
 test_nonspecial_builtin_syntax "$LINENO" history
 test_nonspecial_builtin_syntax "$LINENO" jobs
 test_nonspecial_builtin_syntax "$LINENO" kill
+test_nonspecial_builtin_syntax "$LINENO" load
+test_nonspecial_builtin_syntax "$LINENO" mapfile
+test_nonspecial_builtin_syntax "$LINENO" poll
 test_nonspecial_builtin_syntax "$LINENO" popd
 test_nonspecial_builtin_syntax "$LINENO" printf
 test_nonspecial_builtin_syntax "$LINENO" pushd
 test_nonspecial_builtin_syntax "$LINENO" pwd
 test_nonspecial_builtin_syntax "$LINENO" read
+test_nonspecial_builtin_syntax "$LINENO" stats
 test_nonspecial_builtin_syntax "$LINENO" suspend
 test_nonspecial_builtin_syntax "$LINENO" test
 # No argument syntax error in non-special built-in true
@@ -510,6 +530,7 @@ test_nonspecial_builtin_redirect "$LINENO" cat # example of external command
 test_nonspecial_builtin_redirect "$LINENO" cd
 test_nonspecial_builtin_redirect "$LINENO" command
 test_nonspecial_builtin_redirect "$LINENO" complete
+test_nonspecial_builtin_redirect "$LINENO" coproc
 test_nonspecial_builtin_redirect "$LINENO" dirs
 test_nonspecial_builtin_redirect "$LINENO" disown
 test_nonspecial_builtin_redirect "$LINENO" echo
@@ -522,11 +543,15 @@ test_nonspecial_builtin_redirect "$LINENO" help
 test_nonspecial_builtin_redirect "$LINENO" history
 test_nonspecial_builtin_redirect "$LINENO" jobs
 test_nonspecial_builtin_redirect "$LINENO" kill
+test_nonspecial_builtin_redirect "$LINENO" load
+test_nonspecial_builtin_redirect "$LINENO" mapfile
+test_nonspecial_builtin_redirect "$LINENO" poll
 test_nonspecial_builtin_redirect "$LINENO" popd
 test_nonspecial_builtin_redirect "$LINENO" printf
 test_nonspecial_builtin_redirect "$LINENO" pushd
 test_nonspecial_builtin_redirect "$LINENO" pwd
 test_nonspecial_builtin_redirect "$LINENO" read
+test_nonspecial_builtin_redirect "$LINENO" stats
 test_nonspecial_builtin_redirect "$LINENO" suspend
 test_nonspecial_builtin_redirect "$LINENO" test
 test_nonspecial_builtin_redirect "$LINENO" true
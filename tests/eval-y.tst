@@ -57,6 +57,36 @@ foo
 foobar
 __OUT__
 
+test_oE 'repeatedly evaluated string is re-parsed after alias change'
+alias a='echo 1'
+for i in 1 2 3; do
+    eval 'a'
+    alias a='echo 2'
+done
+unalias a
+a() { echo function; }
+eval 'a'
+__IN__
+1
+2
+2
+function
+__OUT__
+
+test_oE 'repeatedly evaluated string defining function'
+for i in 1 2; do
+    eval 'f() { echo $1 $i; }'
+    f x
+done
+unset -f f
+eval 'f() { echo $1 $i; }'
+f y
+__IN__
+x 1
+x 2
+y 2
+__OUT__
+
 test_Oe -e n 'invalid option'
 eval --no-such-option
 __IN__
@@ -53,6 +53,18 @@ __IN__
 A
 __OUT__
 
+test_oE 'exporting and unexporting many variables'
+export a=A b=B c=C
+unset a
+typeset +x b
+d=D sh -c 'echo ${a-unset} ${b-unset} $c $d'
+export a=1 b=2
+sh -c 'echo $a $b $c ${d-unset}'
+__IN__
+unset B C D
+1 2 C unset
+__OUT__
+
 test_O -d -e 1 'assigning to ill-named variable'
 export =A
 __IN__
@@ -339,6 +339,60 @@ A
 B
 __OUT__
 
+test_oE 'iterating over array (array modified in loop)'
+a=(1 '2 3' '' 4)
+for i in "${a[@]}"; do
+    printf '[%s]' "$i"
+    a=(x)
+done
+echo
+echo "$a"
+__IN__
+[1][2 3][][4]
+x
+__OUT__
+
+test_oE 'iterating over array (elements removed and inserted in loop)'
+a=(1 2 3)
+for i in "${a[@]}"; do
+    printf '[%s]' "$i"
+    array -d a 1
+    array -i a 0 x
+done
+echo
+echo "$a"
+__IN__
+[1][2][3]
+x 2 3
+__OUT__
+
+test_oE 'iterating over array into the same variable'
+a=(1 2 3)
+for a in "${a[@]}"; do
+    printf '[%s]' "$a"
+done
+echo
+__IN__
+[1][2][3]
+__OUT__
+
+test_oE 'iterating over positional parameters shifted in loop' -s 1 '2 3' 4
+for i in "$@"; do
+    printf '[%s]' "$i"
+    shift
+done
+echo
+set -- 1 2
+for i; do
+    printf '[%s]' "$i"
+    set -- x
+done
+echo
+__IN__
+[1][2 3][4]
+[1][2]
+__OUT__
+
 test_O -d -e 2 'read-only variable'
 readonly v=readonly
 for v in 1; do
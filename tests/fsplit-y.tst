@@ -80,4 +80,11 @@ __IN__
 [1][][][][]
 __OUT__
 
+test_oE 'quotes and backslashes in split fields are kept'
+a='"1" \2 '"'3'"' 4\'
+bracket $a
+__IN__
+["1"][\2]['3'][4\]
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
@@ -228,4 +228,97 @@ __ERR__
 #'
 #`
 
+test_oE 'function defined in eval outlives the eval'
+eval 'f() { cat <<END; g() { echo g $1; }; }
+here-document $1
+END
+'
+f 1
+f 2
+g 3
+__IN__
+here-document 1
+here-document 2
+g 3
+__OUT__
+
+test_oE 'lazily parsed function bodies'
+set -o lazyparse
+f() {
+    case $1 in
+        ({) echo "brace $1" ;;
+        (*) echo '}' "}" \} ${2-'}'} $(echo "}") `echo }` $((1 + (2)))
+    esac
+    cat <<-END
+	} $1
+	END
+}
+g() { h() { echo h; }; h; } >&2
+f {
+f x
+g 2>&1
+typeset -fp g
+__IN__
+brace {
+} {
+} } } } } } 3
+} x
+h
+g()
+{
+   h()
+   {
+      echo h
+   }
+   h
+} 1>&2
+__OUT__
+
+test_oe -e 2 'syntax error in lazily parsed function body is reported on call'
+set -o lazyparse
+f() {
+    echo $LINENO
+    fi
+}
+echo defined
+f
+echo not reached
+__IN__
+defined
+__OUT__
+syntax error: encountered `fi' without a matching `if' and/or `then'
+syntax error: (maybe you missed `}'?)
+__ERR__
+#'
+#`
+
+test_oE 'modifying positional parameters in function does not affect arguments'
+f() {
+    for i do
+        shift
+        echo "$i:$*"
+    done
+    set -- x
+    g "$@" y
+    echo "$@"
+}
+g() { echo "$@"; shift; echo "$@"; }
+a=1
+f "$a" 2 3
+f "$a" 2 3
+__IN__
+1:2 3
+2:3
+3:
+x y
+y
+x
+1:2 3
+2:3
+3:
+x y
+y
+x
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
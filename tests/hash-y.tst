@@ -180,6 +180,31 @@ hash sh
 hash
 __IN__
 
+export TEST_NO="$LINENO"
+testcase "$LINENO" 'command paths saved in $YASH_HASH_CACHE' \
+    3<<\__IN__ 4<<__OUT__ 5</dev/null
+mkdir a b
+make_command a/command1 b/command2
+touch -t 200001010000 a b
+export YASH_HASH_CACHE="$PWD/cache"
+echopath=$(unset -f echo; command -v echo)
+cachedpath="$PWD/a:$PWD/b:${echopath%/*}"
+PATH=$cachedpath "$TESTEE" -c 'command1; command2'
+PATH=$cachedpath "$TESTEE" -c 'hash command0 2>/dev/null; hash' | sort
+echo ---
+make_command a/command2
+PATH=$cachedpath "$TESTEE" -c 'command2; hash -r'
+test -e cache || echo removed
+__IN__
+Running a/command1
+Running b/command2
+$PWD/$TEST_NO.path/a/command1
+$PWD/$TEST_NO.path/b/command2
+---
+Running a/command2
+removed
+__OUT__
+
 )
 
 test_OE -e 0 'assignment to $PATH removes all remembered command paths'
@@ -58,10 +58,14 @@ Syntax:
 	array -d name [index...]
 	array -i name index [value...]
 	array -s name index value
+	array -A name [key value...]
+	array -k name keys
 
 Options:
+	-A       --associative
 	-d       --delete
 	-i       --insert
+	-k       --keys
 	-s       --set
 	         --help
 
@@ -245,6 +249,22 @@ __OUT__
 
 )
 
+test_oE -e 0 'help of coproc'
+help coproc
+__IN__
+coproc: start a command connected to the shell via pipes
+
+Syntax:
+	coproc [-n name] command [argument...]
+
+Options:
+	-n ...   --name=...
+	         --help
+
+Try `man yash' for details.
+__OUT__
+#`
+
 test_oE -e 0 'help of continue'
 help continue
 __IN__
@@ -582,6 +602,24 @@ Try `man yash' for details.
 __OUT__
 #`
 
+test_oE -e 0 'help of load'
+help load
+__IN__
+load: load or unload modules that define built-ins
+
+Syntax:
+	load module...
+	load -u module...
+	load
+
+Options:
+	-u       --unload
+	         --help
+
+Try `man yash' for details.
+__OUT__
+#`
+
 test_oE -e 0 'help of local'
 help local
 __IN__
@@ -601,6 +639,57 @@ Try `man yash' for details.
 __OUT__
 #`
 
+(
+if ! testee -c 'command -bv mapfile' >/dev/null; then
+    skip="true"
+fi
+
+test_oE -e 0 'help of mapfile'
+help mapfile
+__IN__
+mapfile: read lines into an array
+
+Syntax:
+	mapfile [-t] [-d delimiter] [-n count] [-s count] [array]
+
+Options:
+	-d ...   --delimiter=...
+	-n ...   --count=...
+	-s ...   --skip=...
+	-t       --strip
+	         --help
+
+Try `man yash' for details.
+__OUT__
+#`
+
+)
+
+(
+if ! testee -c 'command -bv poll' >/dev/null; then
+    skip="true"
+fi
+
+test_oE -e 0 'help of poll'
+help poll
+__IN__
+poll: wait for file descriptors or jobs to get ready
+
+Syntax:
+	poll [-r fd]... [-w fd]... [-t timeout] [job...]
+
+Options:
+	-r ...   --readable=...
+	-t ...   --timeout=...
+	-w ...   --writable=...
+	         --help
+
+Try `man yash' for details.
+__OUT__
+#`
+
+)
+
 (
 if ! testee -c 'command -bv popd' >/dev/null; then
     skip="true"
@@ -781,6 +870,8 @@ Options:
 	         -o histspace
 	         -o ignoreeof
 	-i       -o interactive
+	         -o lastpipe
+	         -o lazyparse
 	         -o lealwaysrp
 	         -o lecompdebug
 	         -o leconvmeta
@@ -797,10 +888,12 @@ Options:
 	-b       -o notify
 	         -o notifyle
 	         -o nullglob
+	         -o parallelglob
 	         -o pipefail
 	         -o posixlycorrect
 	-s       -o stdin
 	         -o traceall
+	         -o tracestamp
 	+u       -o unset
 	-v       -o verbose
 	         -o vi
@@ -828,6 +921,24 @@ Try `man yash' for details.
 __OUT__
 #`
 
+test_oE -e 0 'help of stats'
+help stats
+__IN__
+stats: print or reset internal event counters or print memory usage
+
+Syntax:
+	stats [-r] [counter...]
+	stats -m [subsystem...]
+
+Options:
+	-m       --memory
+	-r       --reset
+	         --help
+
+Try `man yash' for details.
+__OUT__
+#`
+
 test_oE -e 0 'help of suspend'
 help suspend
 __IN__
@@ -1060,9 +1171,11 @@ wait: wait for jobs to terminate
 
 Syntax:
 	wait [job or process_id...]
+	wait -n
 
 Options:
-	--help
+	-n       --next
+	         --help
 
 Try `man yash' for details.
 __OUT__
@@ -15,6 +15,18 @@ echo - this line is consumed by read and printed by printf
 - this line is consumed and executed by shell
 __OUT__
 
+test_oE 'input consumed by commands is skipped repeatedly'
+read -r line && printf '1 %s\n' "$line"
+this line is consumed by read
+read -r line && printf '2 %s\n' "$line"
+this line is consumed by read, too
+echo 3
+__IN__
+1 this line is consumed by read
+2 this line is consumed by read, too
+3
+__OUT__
+
 test_x -e 0 'exit status of empty input'
 __IN__
 
@@ -77,6 +89,27 @@ printf 'alias false=:\nfalse\n' >inputfile.sh
 test_x -e 0 'shell input is line-wise (file)' ./inputfile.sh
 __IN__
 
+printf 'echo 1\necho 2' >nonewline.sh
+
+test_oE 'last line of script file without newline' ./nonewline.sh
+__IN__
+1
+2
+__OUT__
+
+{
+    echo ': >"$0"'
+    i=0
+    while [ "$i" -lt 200 ]; do
+        echo '# padding padding padding padding padding padding padding'
+        i=$((i+1))
+    done
+    echo 'true'
+} >truncated.sh
+
+test_x -e 0 'script file truncated while running' ./truncated.sh
+__IN__
+
 test_x -e 0 'shell input is line-wise (standard input)'
 alias false=:
 false
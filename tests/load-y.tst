@@ -0,0 +1,105 @@
+# load-y.tst: yash-specific test of the load built-in
+
+if ! testee -c 'command -bv load' >/dev/null; then
+    skip="true"
+else
+    cat >module.c <<\END
+#include <stdio.h>
+#include <wchar.h>
+#include "builtins/loadable.h"
+
+static int greet_builtin(int argc, void **argv)
+{
+    for (int i = 1; i < argc; i++)
+        printf("hello, %ls\n", (const wchar_t *) argv[i]);
+    return argc - 1;
+}
+
+const int yash_loadable_version = YASH_LOADABLE_VERSION;
+const struct yash_loadable_T yash_loadable_builtins[] = {
+    { "greet", greet_builtin, YASH_LOADABLE_EXTENSION,
+        "print greetings", "\tgreet name...\n", },
+    { NULL, NULL, 0, NULL, NULL, },
+};
+END
+    echo 'int not_a_module;' >not_module.c
+    {
+        ${CC:-cc} -shared -fPIC -I../.. -o module.so module.c &&
+        ${CC:-cc} -shared -fPIC -o not_module.so not_module.c
+    } 2>/dev/null || skip="true"
+fi
+
+test_oE -e 2 'built-in defined in loaded module'
+load ./module.so
+command -bv greet
+greet world yash
+__IN__
+greet
+hello, world
+hello, yash
+__OUT__
+
+test_oE -e 0 'printing loaded modules'
+load
+load ./module.so
+load
+__IN__
+./module.so
+__OUT__
+
+test_OE -e 127 'unloading module'
+load ./module.so
+load -u ./module.so
+load
+greet 2>/dev/null
+__IN__
+
+test_oE -e 1 'loading module again after unloading'
+load ./module.so
+load -u ./module.so
+load ./module.so
+greet again
+__IN__
+hello, again
+__OUT__
+
+test_OE -e 127 'cached command search is invalidated by unloading'
+f() { greet x >/dev/null; }
+load ./module.so
+f
+load -u ./module.so
+f 2>/dev/null
+__IN__
+
+test_O -d -e 1 'loading module twice'
+load ./module.so
+load ./module.so
+__IN__
+
+test_O -d -e 1 'loading non-module shared object'
+load ./not_module.so
+__IN__
+
+test_O -d -e 1 'loading non-existing file'
+load ./_no_such_file_
+__IN__
+
+test_O -d -e 1 'unloading module not loaded'
+load -u ./module.so
+__IN__
+
+test_O -d -e 127 'extension built-in of loaded module is ignored in POSIX mode'
+load ./module.so
+set -o posixly-correct
+greet world
+__IN__
+
+test_O -d -e 2 'unloading without operand'
+load -u
+__IN__
+
+test_O -d -e 2 'invalid option'
+load --no-such-option
+__IN__
+
+# vim: set ft=sh ts=8 sts=4 sw=4 et:
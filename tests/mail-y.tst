@@ -0,0 +1,55 @@
+# mail-y.tst: yash-specific test of mail checking
+
+test_o 'MAIL is checked before each prompt' -i +m
+PS1= MAILCHECK=0 MAIL=mail; exec 2>err
+echo new >mail; touch -t 202001010000 mail
+:
+echo more >>mail; touch -t 202101010000 mail
+cat err
+__IN__
+You have new mail.
+You have new mail.
+__OUT__
+
+test_o 'MAILPATH is checked before each prompt' -i +m
+PS1= MAILCHECK=0 MAILPATH='mail1%mail1 updated:mail2%$m updated'; \
+exec 2>err; m=mail2; echo >mail1
+echo new >mail1; touch -t 202001010000 mail1
+echo new >mail2; touch -t 202001010000 mail2
+:
+touch -t 202101010000 mail1 mail2
+cat err
+__IN__
+mail1 updated
+mail2 updated
+mail1 updated
+mail2 updated
+__OUT__
+
+test_o 'removed and re-created mail file is checked' -i +m
+PS1= MAILCHECK=0 MAIL=mail; exec 2>err; echo >mail
+rm mail
+echo new >mail; touch -t 202001010000 mail
+mv mail old; echo new >mail; touch -t 202101010000 mail
+echo old >>old; touch -t 202201010000 old
+cat err
+__IN__
+You have new mail.
+You have new mail.
+__OUT__
+
+test_o 'empty mail file is not reported' -i +m
+PS1= MAILCHECK=0 MAIL=mail; exec 2>err; echo >mail
+: >mail; touch -t 202001010000 mail
+cat err
+__IN__
+__OUT__
+
+test_o 'mail is not checked before MAILCHECK seconds pass' -i +m
+PS1= MAILCHECK=1000 MAIL=mail; exec 2>err
+echo new >mail; touch -t 202001010000 mail
+cat err
+__IN__
+__OUT__
+
+# vim: set ft=sh ts=8 sts=4 sw=4 et:
@@ -0,0 +1,186 @@
+# mapfile-y.tst: yash-specific test of the mapfile built-in
+
+if ! testee -c 'command -bv mapfile' >/dev/null; then
+    skip="true"
+fi
+
+setup -d
+
+cat >input <<\__END__
+1 one
+ 2  two 
+\3\
+
+4
+__END__
+
+test_oE -e 0 'mapfile reads lines into MAPFILE'
+mapfile <input
+bracket "$MAPFILE"
+__IN__
+[1 one
+][ 2  two 
+][\3\
+][
+][4
+]
+__OUT__
+
+test_oE -e 0 'mapfile reads lines into specified array'
+mapfile -t lines <input
+bracket "$lines"
+echo ${lines[#]}
+__IN__
+[1 one][ 2  two ][\3\][][4]
+5
+__OUT__
+
+test_oE -e 0 'mapfile with empty input'
+lines=(foo)
+mapfile lines </dev/null
+echo ${lines[#]}
+__IN__
+0
+__OUT__
+
+test_oE -e 0 'mapfile with last line lacking newline'
+printf 'a\nb' | {
+    mapfile lines
+    bracket "$lines"
+}
+__IN__
+[a
+][b]
+__OUT__
+
+test_oE -e 0 'mapfile with custom delimiter'
+printf 'a:b:c\n' | {
+    mapfile --delimiter=: --strip lines
+    bracket "$lines"
+}
+__IN__
+[a][b][c
+]
+__OUT__
+
+test_oE -e 0 'mapfile with null delimiter'
+printf 'a\nb\0c\0' | {
+    mapfile -d '' -t lines
+    bracket "$lines"
+}
+__IN__
+[a
+b][c]
+__OUT__
+
+test_oE -e 0 'mapfile skipping lines'
+mapfile -t -s 2 lines <input
+bracket "$lines"
+mapfile --skip=10 lines <input
+echo ${lines[#]}
+__IN__
+[\3\][][4]
+0
+__OUT__
+
+test_oE -e 0 'mapfile limiting lines'
+mapfile -t -n 2 lines <input
+bracket "$lines"
+mapfile -t --count=0 lines <input
+echo ${lines[#]}
+__IN__
+[1 one][ 2  two ]
+5
+__OUT__
+
+test_oE -e 0 'mapfile skipping and limiting lines'
+mapfile -t -s 1 -n 2 lines <input
+bracket "$lines"
+__IN__
+[ 2  two ][\3\]
+__OUT__
+
+test_oE -e 0 'mapfile does not consume input after counted lines (file)'
+{
+    mapfile -t -n 2 lines
+    bracket "$lines"
+    cat
+} <input
+__IN__
+[1 one][ 2  two ]
+\3\
+
+4
+__OUT__
+
+test_oE -e 0 'mapfile does not consume input after counted lines (pipe)'
+cat input | {
+    mapfile -t -n 2 lines
+    bracket "$lines"
+    cat
+}
+__IN__
+[1 one][ 2  two ]
+\3\
+
+4
+__OUT__
+
+test_oE -e 0 'mapfile after read'
+{
+    read -r line
+    mapfile -t lines
+    bracket "$line" "$lines"
+} <input
+__IN__
+[1 one][ 2  two ][\3\][][4]
+__OUT__
+
+test_oE -e 0 'mapfile reads many lines'
+i=0
+while [ $i -lt 2000 ]; do
+    echo "line $i"
+    i=$((i+1))
+done >many
+mapfile -t lines <many
+echo ${lines[#]} "${lines[1]}" "${lines[-1]}"
+__IN__
+2000 line 0 line 1999
+__OUT__
+
+test_Oe -e 2 'mapfile with invalid count'
+mapfile -n x lines </dev/null
+__IN__
+mapfile: `x' is not a valid integer
+__ERR__
+#'
+#`
+
+test_Oe -e 2 'mapfile with too many operands'
+mapfile a b </dev/null
+__IN__
+mapfile: too many operands are specified
+__ERR__
+
+test_Oe -e 1 'mapfile with invalid name'
+mapfile = </dev/null
+__IN__
+mapfile: `=' is not a valid array name
+__ERR__
+#'
+#`
+
+test_Oe -e 1 'mapfile to read-only variable'
+readonly lines=
+mapfile lines </dev/null
+__IN__
+mapfile: $lines is read-only
+__ERR__
+
+test_oE -e 0 'mapfile is an elective built-in'
+command -V mapfile
+__IN__
+mapfile: an elective built-in
+__OUT__
+
+# vim: set ft=sh ts=8 sts=4 sw=4 et:
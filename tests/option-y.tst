@@ -76,6 +76,19 @@ no/such/command
 not found no/such/command
 __OUT__
 
+test_oE 'tracestamp on: trace prefix' --tracestamp
+PS4='$(echo not expanded)'
+f() { echo in f; }
+set -x
+f 2>trace
+set +x 2>/dev/null
+sed "s/^[0-9][0-9]*\.[0-9]\{6\} $$ /X /" trace
+__IN__
+in f
+X 0 f
+X 1 echo in f
+__OUT__
+
 test_Oe -e 2 'unset off: unset variable $((foo))' -u
 eval '$((x))'
 __IN__
@@ -97,6 +110,51 @@ X+ echo 1
 X+ echo 2
 __ERR__
 
+test_oE 'xtrace to $YASH_XTRACEFD'
+exec 2>&1 3>trace
+YASH_XTRACEFD=3
+set -x
+echo 1
+(echo 2)
+unset YASH_XTRACEFD
+echo 3
+set +x
+cat trace
+__IN__
+1
+2
++ echo 3
+3
++ set '+x'
++ echo 1
++ echo 2
++ unset YASH_XTRACEFD
+__OUT__
+
+test_oE 'buffered trace output is written on exit'
+"$TESTEE" -c 'exec 3>trace; YASH_XTRACEFD=3; set -x; echo 1; a=2'
+cat trace
+__IN__
+1
++ echo 1
++ a=2
+__OUT__
+
+test_oE '$YASH_XTRACEFD naming closed file descriptor'
+exec 9>&-
+{
+YASH_XTRACEFD=9
+set -x
+echo 1
+set +x
+} 2>&1 | sed 's/^[^:]*: //'
+__IN__
+$YASH_XTRACEFD: `9' is not an open file descriptor; the trace is printed to the standard error
++ echo 1
+1
++ set '+x'
+__OUT__
+
 test_x -e 0 'abbreviation of -o argument' -o allex
 echo $- | grep -q a
 __IN__
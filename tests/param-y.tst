@@ -475,6 +475,17 @@ __IN__
 __OUT__
 # XXX: Should the last one (${a/*/"$b"}) expand to 1*2?3 rather than 1_2_3?
 
+test_oE 'matching with bracket expressions and stars in expansion'
+a='a1-b22-c333]' b='x]y'
+bracket "${a#*[0-9]}" "${a##*[0-9]}" "${a%[!]]*}" "${a%%[0-9-]*}"
+bracket "${a/[[:digit:]]*[[:digit:]]/_}" "${a//[b-c]?/_}" "${a//[]-]/_}"
+bracket "${b/[]]/_}" "${b//[!]]/_}" "${a/#*-/_}" "${a/%-*/_}"
+__IN__
+[-b22-c333]][]][a1-b22-c33][a]
+[a_]][a1-_2-_33]][a1_b22_c333_]
+[x_y][_]_][_c333]][a1_]
+__OUT__
+
 test_oE 'scalar parameter index'
 a='1-2-3'
 bracket @ "${a[@]}"
@@ -552,6 +563,34 @@ __IN__
 [6,6][]
 __OUT__
 
+test_oE 'length of scalar parameter with index'
+a='1-2-3'
+set -- abc
+bracket "${#a}" "${#a[2,4]}" "${#a[-2,-1]}" "${#a[6,9]}" "${#1[2]}"
+__IN__
+[5][3][2][0][1]
+__OUT__
+
+test_oE 'length of scalar parameter after reassignment'
+a=abc
+bracket "${#a}" "${a[#]}" "${a[-2,-1]}"
+a=defgh
+bracket "${#a}" "${a[#]}" "${a[-2,-1]}"
+a=$((a=12345678)) b=$a
+bracket "${#a}" "${a[-2,-1]}" "${#b}" "${b[#]}"
+__IN__
+[3][3][bc]
+[5][5][gh]
+[8][78][8][8]
+__OUT__
+
+test_oE 'scalar value is not affected by modification in pattern'
+a=abc
+bracket "${a#$((a=1))}" "${a%${a}}" "$a"
+__IN__
+[abc][][1]
+__OUT__
+
 test_oE 'array variable index'
 a=(1 22 '3  3' 4"   "4 '')
 bracket @ "${a[@]}"
@@ -94,6 +94,30 @@ anotherdir/file anotherdir/loop/dir/file dir/dir/file dir/dir/link/file
 anotherdir/file dir/dir/file
 __OUT__
 
+test_oE 'extendedglob does not descend into non-directories' --extendedglob
+echo **/file/*
+echo **/file/
+echo ***/link/f*
+__IN__
+**/file/*
+**/file/
+anotherdir/loop/dir/link/file dir/dir/link/file
+__OUT__
+
+test_oE 'parallelglob on: effect' --extendedglob --parallelglob
+echo **/file
+echo ***/file
+echo .**/file
+echo .***/file
+echo **/**/f*e
+__IN__
+anotherdir/file dir/dir/file
+anotherdir/file anotherdir/loop/dir/file dir/dir/file dir/dir/link/file
+.dir/dir/file .dir/file anotherdir/file dir/.dir/file dir/dir/file
+.dir/dir/file .dir/file anotherdir/file anotherdir/loop/.dir/file anotherdir/loop/dir/file dir/.dir/file dir/dir/.link/file dir/dir/file dir/dir/link/file
+anotherdir/file dir/dir/file
+__OUT__
+
 test_oE 'extendedglob off: effect' --noextendedglob
 echo **/file
 echo ***/file
@@ -51,4 +51,141 @@ syntax error: ksh-like extended glob pattern `!(...)' is not supported
 __ERR__
 #`
 
+test_oe 'time reports to standard error of shell'
+TIMEFORMAT='real %0R user %0U sys %0S'
+time echo foo | cat 2>/dev/null
+__IN__
+foo
+__OUT__
+real 0 user 0 sys 0
+__ERR__
+
+test_OE -e 1 'exit status of timed pipeline'
+TIMEFORMAT=
+time false
+__IN__
+
+test_OE -e 0 'time followed by !'
+TIMEFORMAT=
+time ! false
+__IN__
+
+test_OE -e 0 '! followed by time'
+TIMEFORMAT=
+! time false
+__IN__
+
+test_oE 'conversions in TIMEFORMAT'
+TIMEFORMAT='%%R [%0lR] %2lR %Z %'
+{ time :; } 2>&1 | sed 's/[0-9]/0/g'
+__IN__
+%R [0m0s] 0m0.00s %Z %
+__OUT__
+
+test_oE 'resource usage conversions in TIMEFORMAT'
+TIMEFORMAT='%M %I %O %w %c'
+{ time : | :; } 2>&1 | grep -Eqx '[0-9]+( [0-9]+){4}' && echo ok
+__IN__
+ok
+__OUT__
+
+test_oe 'timed pipeline in background'
+TIMEFORMAT='timed %0R'
+time echo foo &
+wait
+__IN__
+foo
+__OUT__
+timed 0
+__ERR__
+
+test_oE 'time -p reports in POSIX format'
+TIMEFORMAT='not used'
+{ time -p echo foo; } 2>&1 | sed 's/[0-9]/0/g'
+__IN__
+foo
+real 0.00
+user 0.00
+sys 0.00
+__OUT__
+
+test_oe 'time -- ends options'
+TIMEFORMAT='timed %0R'
+time -- echo -p
+__IN__
+-p
+__OUT__
+timed 0
+__ERR__
+
+test_oe 'time without command'
+TIMEFORMAT='timed %0R'
+false
+time
+echo $?
+false
+time -- ; echo $?
+__IN__
+0
+0
+__OUT__
+timed 0
+timed 0
+__ERR__
+
+test_oE 'time is not a keyword in POSIX mode' --posix
+time() { echo function "$@"; }
+time echo foo
+__IN__
+function echo foo
+__OUT__
+
+test_oE 'lastpipe: variables assigned by last command remain' -o lastpipe
+count=0
+printf '%s\n' a b c | while read -r x; do count=$((count+1)); last=$x; done
+echo $count $last
+__IN__
+3 c
+__OUT__
+
+test_oE 'lastpipe: standard input is restored after pipeline' -o lastpipe
+echo foo | read -r x
+read -r y
+bar
+echo "$x" "$y"
+__IN__
+foo bar
+__OUT__
+
+test_oE 'lastpipe: exit status of pipeline' -o lastpipe
+false | true; echo $?
+true | false; echo $?
+(exit 3) | true; echo $?
+set -o pipefail
+(exit 3) | true; echo $?
+true | (exit 4); echo $?
+__IN__
+0
+1
+0
+3
+4
+__OUT__
+
+test_oE 'lastpipe: other jobs in last command' -o lastpipe
+echo 1 | { cat; echo 2 | cat; cat </dev/null; echo 3; }
+__IN__
+1
+2
+3
+__OUT__
+
+test_oE 'lastpipe: not applied without the option'
+x=1
+echo 2 | read -r x
+echo $x
+__IN__
+1
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
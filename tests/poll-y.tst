@@ -0,0 +1,116 @@
+# poll-y.tst: yash-specific test of the poll built-in
+
+if ! testee -c 'command -bv poll' >/dev/null; then
+    skip="true"
+fi
+
+setup -d
+
+mkfifo fifo1 fifo2
+
+test_oE -e 1 'poll times out with nothing ready'
+exec 3<>fifo1
+poll -t 0.1 -r 3
+status=$?
+echo "${POLL_READABLE[#]}" "${POLL_WRITABLE[#]}" "${POLL_JOBS[#]}"
+exit $status
+__IN__
+0 0 0
+__OUT__
+
+test_oE -e 0 'poll reports readable file descriptors'
+exec 3<>fifo1 4<>fifo2
+echo foo >&4
+poll -r 3 --readable=4
+status=$?
+bracket "$POLL_READABLE"
+exit $status
+__IN__
+[4]
+__OUT__
+
+test_oE -e 0 'poll reports writable file descriptors'
+exec 3<>fifo1
+poll -w 3 -r 3
+status=$?
+bracket "$POLL_READABLE" / "$POLL_WRITABLE"
+exit $status
+__IN__
+[/][3]
+__OUT__
+
+test_oE -e 0 'poll waits for job to finish'
+exec 3<>fifo1
+sleep 0.1 &
+poll -r 3 %1
+status=$?
+bracket "$POLL_JOBS" / "$POLL_READABLE"
+wait %1
+exit $status
+__IN__
+[%1][/]
+__OUT__
+
+test_oE -e 0 'poll accepts process ID'
+exit 3 &
+pid=$!
+poll -t 5 "$pid"
+status=$?
+[ "$POLL_JOBS" = "$pid" ] && echo ok
+wait "$pid"
+echo $?
+exit $status
+__IN__
+ok
+3
+__OUT__
+
+test_oE 'poll is interrupted by trap'
+exec 3<>fifo1
+trap 'echo USR1' USR1
+(sleep 0.1; kill -s USR1 $$) &
+poll -r 3
+kill -l $?
+__IN__
+USR1
+USR1
+__OUT__
+
+test_oE -e 0 'poll without fd and job waits for timeout'
+poll --timeout=0.05
+echo $?
+__IN__
+1
+__OUT__
+
+test_Oe -e 2 'invalid file descriptor'
+poll -r 3
+__IN__
+poll: file descriptor 3 is unavailable
+__ERR__
+
+test_Oe -e 2 'invalid timeout'
+poll -t -1
+__IN__
+poll: `-1' is not a valid timeout
+__ERR__
+#'
+#`
+
+test_Oe -e 2 'non-existing job'
+poll %100
+__IN__
+poll: no such job `%100'
+__ERR__
+#'
+#`
+
+test_Oe -e 2 'invalid option'
+poll --no-such-option
+__IN__
+poll: `--no-such-option' is not a valid option
+__ERR__
+#'
+#`
+
+# vim: set ft=sh ts=8 sts=4 sw=4 et:
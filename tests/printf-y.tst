@@ -493,6 +493,32 @@ __IN__
 1%2
 __OUT__
 
+test_oE 'formats used repeatedly'
+for i in 1 2 3; do
+    for f in '%s-' '%d-' '%x-' '%u-' '%i-' '%5s|\n'; do
+        printf "$f" $i
+    done
+done
+printf '%d %x\n' -9223372036854775808 18446744073709551615
+__IN__
+1-1-1-1-1-    1|
+2-2-2-2-2-    2|
+3-3-3-3-3-    3|
+-9223372036854775808 ffffffffffffffff
+__OUT__
+
+test_e 'invalid format used repeatedly'
+printf '%y'
+printf '%y'
+__IN__
+printf: `y' is not a valid conversion specifier
+printf: `y' is not a valid conversion specifier
+__ERR__
+#'
+#`
+#'
+#`
+
 test_o -d -e n 'operands in invalid format'
 printf '%d\n' not_a_integer 32_trailing_characters
 __IN__
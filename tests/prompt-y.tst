@@ -131,6 +131,18 @@ $
 ! !! $ 
 __ERR__
 
+test_e 'PS1 re-expanded after its expansion modifies it' -i +m
+n=0 PS1='${n}$((n+=1))$(:)>'; echo >&2
+echo >&2
+PS1='[$PS1]${PS1=}'; echo >&2
+exit
+__IN__
+$ 
+01>
+23>
+[[$PS1]${PS1=}]
+__ERR__
+
 # TODO: Test of \[, \], and \f is missing
 # \j and \$ are tested in other test cases below
 test_e 'backslash notations in PS1' -i +m
@@ -103,6 +103,31 @@ __ERR__
 
 )
 
+(
+setup -d
+
+test_oE 'whole-word double-quoted parameter expansions'
+x='  a  *  b  ' a=(1 '2 3')
+unset u
+bracket "$x" "${x}" "$a" "$u"
+__IN__
+[  a  *  b  ][  a  *  b  ][1][2 3][]
+__OUT__
+
+test_O -e 2 'whole-word double-quoted unset variable with nounset'
+set -u
+unset u
+echo "$u"
+__IN__
+
+test_oE 'plain literal words'
+bracket -la foo/bar --opt=value $ a,b
+__IN__
+[-la][foo/bar][--opt=value][$][a,b]
+__OUT__
+
+)
+
 test_oE 'backslash preceding EOF is ignored'
 "$TESTEE" -c 'printf "[%s]\n" 123\'
 __IN__
@@ -575,4 +575,24 @@ test_OE -e 0 'keyword after redirection in compound command (non-POSIX)'
 { ( echo not printed  ) >/dev/null }
 __IN__
 
+test_oE 'redirection on last external command replaces shell process'
+"$TESTEE" -c 'echo $$; exec 3>&1; sh -c "echo \$\$" 2>/dev/null >&3' |
+uniq | wc -l | tr -d ' '
+__IN__
+1
+__OUT__
+
+test_oE 'redirection on last subshell is applied in shell process'
+"$TESTEE" -c 'echo $$; (sh -c "echo \$\$") 2>/dev/null' | uniq | wc -l |
+tr -d ' '
+__IN__
+1
+__OUT__
+
+test_oE 'EXIT trap set by last command uses original file descriptors'
+"$TESTEE" -c 'trap "echo exit" EXIT >/dev/null'
+__IN__
+exit
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
@@ -0,0 +1,107 @@
+# server-y.tst: yash-specific test of the shell server
+
+if ! testee --version --verbose | grep -Fqx ' * socket'; then
+    skip="true"
+fi
+
+setup - <<\END
+start_server() {
+    rm -f socket
+    "$TESTEE" --serve=socket "$@" &
+    server=$!
+    until connect -c : 2>/dev/null; do
+        kill -0 "$server" 2>/dev/null || break
+    done
+}
+connect() {
+    "$TESTEE" --connect="${socket-socket}" "$@"
+}
+END
+
+test_oE 'command runs in state prepared by server'
+start_server -c 'greet() { echo "hello, $1"; }; x=warm'
+connect -c 'greet world; echo $x'
+kill $server
+__IN__
+hello, world
+warm
+__OUT__
+
+test_oE 'socket file is accessible only by user'
+umask 000
+start_server -c :
+ls -l socket | cut -c 1-10
+connect -c umask
+kill $server
+__IN__
+srwx------
+0000
+__OUT__
+
+test_oE 'command string with command name and positional parameters'
+start_server -c :
+connect -c 'echo "$0" "$#" "$@"' name 1 '2  2'
+kill $server
+__IN__
+name 2 1 2  2
+__OUT__
+
+test_oE 'exit status of command'
+start_server -c :
+connect -c 'exit 3'
+echo $?
+kill $server
+__IN__
+3
+__OUT__
+
+test_oE 'command killed by signal'
+start_server -c :
+connect -c 'kill -s KILL $$'
+kill -l $?
+kill $server
+__IN__
+KILL
+__OUT__
+
+test_oE 'environment and working directory of client'
+start_server -c 'x=server y=server'
+mkdir dir
+(cd dir && x=client socket=../socket connect -c 'echo "$x" "$y" "${PWD##*/}"')
+kill $server
+__IN__
+client server dir
+__OUT__
+
+test_oE 'standard input, output, and error of client'
+start_server -c :
+echo foo | connect -c 'cat; echo bar >&2' 2>&1
+kill $server
+__IN__
+foo
+bar
+__OUT__
+
+test_oE 'command does not change state of server'
+start_server -c 'x=1'
+connect -c 'x=2; echo $x'
+connect -c 'echo $x'
+kill $server
+__IN__
+2
+1
+__OUT__
+
+test_O -d -e 2 'connecting without -c option'
+connect
+__IN__
+
+test_O -d -e 2 'connecting to nonexistent socket'
+"$TESTEE" --connect=nonexistent -c :
+__IN__
+
+test_O -d -e 2 'serving in interactive shell'
+"$TESTEE" -i +m --norcfile --serve=socket -c :
+__IN__
+
+# vim: set ft=sh ts=8 sts=4 sw=4 et:
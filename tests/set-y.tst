@@ -201,14 +201,18 @@ test_long_option_default_off "$LINENO" extendedglob
 test_long_option_default_on  "$LINENO" glob
 test_long_option_default_off "$LINENO" hashondef
 test_long_option_default_off "$LINENO" ignoreeof
+test_long_option_default_off "$LINENO" lastpipe
+test_long_option_default_off "$LINENO" lazyparse
 test_long_option_default_off "$LINENO" markdirs
 # The monitor option cannot be tested here due to dependency on the terminal.
 test_long_option_default_off "$LINENO" notify
 test_long_option_default_off "$LINENO" nullglob
+test_long_option_default_off "$LINENO" parallelglob
 test_long_option_default_off "$LINENO" pipefail
 # This needs a special test (see below)
 #test_long_option_default_off "$LINENO" posixlycorrect
 test_long_option_default_on  "$LINENO" traceall
+test_long_option_default_off "$LINENO" tracestamp
 test_long_option_default_on  "$LINENO" unset
 test_long_option_default_off "$LINENO" verbose
 test_long_option_default_off "$LINENO" xtrace
@@ -416,16 +420,20 @@ glob            on
 hashondef       off
 ignoreeof       off
 interactive     off
+lastpipe        off
+lazyparse       off
 log             on
 login           off
 markdirs        off
 monitor         off
 notify          off
 nullglob        off
+parallelglob    off
 pipefail        off
 posixlycorrect  off
 stdin           on
 traceall        on
+tracestamp      off
 unset           on
 verbose         off
 xtrace          off
@@ -474,14 +482,18 @@ set -o forlocal
 set -o glob
 set +o hashondef
 set +o ignoreeof
+set +o lastpipe
+set +o lazyparse
 set -o log
 set +o markdirs
 set +o monitor
 set +o notify
 set +o nullglob
+set +o parallelglob
 set +o pipefail
 set +o posixlycorrect
 set -o traceall
+set +o tracestamp
 set -o unset
 set +o verbose
 set +o xtrace
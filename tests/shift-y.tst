@@ -45,6 +45,31 @@ __IN__
 [3][][-][j]
 __OUT__
 
+test_oE -e 0 'array modified after shift' -e
+a=(1 2 3 4 5)
+shift -A a 2
+array -i a 2 x
+array -s a 1 y
+a=("$a" z)
+bracket "${a[#]}" "$a"
+__IN__
+[5][y][4][x][5][z]
+__OUT__
+
+test_oE -e 0 'shifting function arguments' -e
+f() {
+    while [ $# -gt 1 ]; do shift; done
+    shift -0
+    bracket "$#" "$@"
+}
+set a b c
+f "$@"
+bracket "$#" "$@"
+__IN__
+[1][c]
+[3][a][b][c]
+__OUT__
+
 test_o 'positional parameters are not modified on error' -s a 'b  b' c
 shift 4
 bracket "$#" "$@"
@@ -409,7 +409,8 @@ __OUT__
 
 (
 if ! testee --version --verbose | grep -Fqx ' * help' ||
-    ! testee --version --verbose | grep -Fqx ' * lineedit'; then
+    ! testee --version --verbose | grep -Fqx ' * lineedit' ||
+    ! testee --version --verbose | grep -Fqx ' * socket'; then
     skip="true"
 fi
 
@@ -427,6 +428,7 @@ Options:
 	         --norcfile
 	         --profile=...
 	         --rcfile=...
+	         --serve=...
 	-a       -o allexport
 	         -o braceexpand
 	         -o caseglob
@@ -448,6 +450,8 @@ Options:
 	         -o histspace
 	         -o ignoreeof
 	-i       -o interactive
+	         -o lastpipe
+	         -o lazyparse
 	         -o lealwaysrp
 	         -o lecompdebug
 	         -o leconvmeta
@@ -464,10 +468,12 @@ Options:
 	-b       -o notify
 	         -o notifyle
 	         -o nullglob
+	         -o parallelglob
 	         -o pipefail
 	         -o posixlycorrect
 	-s       -o stdin
 	         -o traceall
+	         -o tracestamp
 	+u       -o unset
 	-v       -o verbose
 	         -o vi
@@ -507,6 +513,8 @@ Options:
 	         -o histspace
 	         -o ignoreeof
 	-i       -o interactive
+	         -o lastpipe
+	         -o lazyparse
 	         -o lealwaysrp
 	         -o lecompdebug
 	         -o leconvmeta
@@ -523,10 +531,12 @@ Options:
 	-b       -o notify
 	         -o notifyle
 	         -o nullglob
+	         -o parallelglob
 	         -o pipefail
 	         -o posixlycorrect
 	-s       -o stdin
 	         -o traceall
+	         -o tracestamp
 	+u       -o unset
 	-v       -o verbose
 	         -o vi
@@ -583,4 +593,55 @@ __ERR__
 test_O -d -e 2 'ambiguous option' --p
 __IN__
 
+test_oE 'profile report is written on exit'
+YASH_PROFILE=profile.out "$TESTEE" -c '
+f() { echo f; }
+f; f'
+grep -E '^ +2 .* f$' profile.out >/dev/null && echo function &&
+# The brace group and the echo command on line 2 are each executed twice.
+grep -E '^ +4 .* f:2$' profile.out >/dev/null && echo line
+__IN__
+f
+f
+function
+line
+__OUT__
+
+test_oE 'profile report distinguishes lines of different files'
+echo 'echo a' >a
+echo 'echo b' >b
+YASH_PROFILE=profile.out "$TESTEE" -c '. ./a; . ./b; . ./b' >/dev/null
+sed -n 's;^ *\([0-9][0-9]*\) .*  \(\./[ab]:[0-9]*\)$;\1 \2;p' profile.out |
+sort -k 2
+__IN__
+1 ./a:1
+2 ./b:1
+__OUT__
+
+test_oE 'profile report shows startup phases'
+YASH_PROFILE=profile.out "$TESTEE" -c :
+grep -E '^ +[0-9.]+  environment$' profile.out >/dev/null && echo environment
+grep -E '^ +[0-9.]+  \(total\)$' profile.out >/dev/null && echo total
+__IN__
+environment
+total
+__OUT__
+
+test_oE 'inherited environment variables are available'
+FOO=foo BAR=bar BAZ=baz "$TESTEE" -c '
+echo "$FOO"
+typeset -p BAR
+set | grep "^BAZ="
+unset FOO
+env | grep "^FOO=" || echo FOO unset
+BAR=new
+env | grep "^BAR="'
+__IN__
+foo
+typeset -x BAR=bar
+BAZ=baz
+FOO unset
+BAR=new
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 et:
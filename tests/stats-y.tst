@@ -0,0 +1,176 @@
+# stats-y.tst: yash-specific test of the stats built-in
+
+test_oE -e 0 'stats is an extension built-in'
+command -V stats
+__IN__
+stats: an extension built-in
+__OUT__
+
+test_oE -e 0 'printing specified counters'
+stats -r
+f() { :; }
+f; f
+(:)
+stats function subshell builtin
+__IN__
+subshell     1
+builtin      3
+function     2
+__OUT__
+
+test_oE -e 0 'counting command hash hits and misses'
+stats -r
+hash -r
+cat /dev/null
+cat /dev/null
+stats hash-hit hash-miss
+__IN__
+hash-hit     1
+hash-miss    1
+__OUT__
+
+test_oE -e 0 'counting cached command searches'
+f() { :; }
+stats -r
+for i in 1 2 3; do f; done
+f() { :; }
+for i in 1 2 3; do f; "f"; done
+stats search-hit search-miss
+__IN__
+search-hit   11
+search-miss  8
+__OUT__
+
+test_oE -e 0 'counting directories scanned in pathname expansion'
+mkdir dir dir/a dir/b
+stats -r
+echo dir/*/ >/dev/null
+stats glob-dir
+__IN__
+glob-dir     1
+__OUT__
+
+test_oE -e 0 'resetting specified counters only'
+stats -r
+f() { :; }
+f
+stats --reset builtin
+stats function builtin
+__IN__
+builtin      1
+function     1
+__OUT__
+
+test_o -e 0 'all counters are printed without operands'
+stats | cut -d ' ' -f 1
+__IN__
+fork
+spawn
+exec
+cmdsub
+subshell
+builtin
+function
+hash-hit
+hash-miss
+search-hit
+search-miss
+pattern
+glob-dir
+history-lock
+variable
+__OUT__
+
+test_oe -e 1 'unknown counter'
+stats -r
+stats foo builtin
+__IN__
+builtin      1
+__OUT__
+stats: no such counter `foo'
+__ERR__
+#'
+#`
+
+test_oE -e 0 'printing memory usage of specified subsystems'
+alias a=foo b=bar
+f() { :; }
+stats -m function alias | while read -r name count bytes; do
+    echo $name $count $((bytes > 0))
+done
+__IN__
+function 1 1
+alias 2 1
+__OUT__
+
+test_oE -e 0 'memory usage of variables grows with their values'
+stats -m variable >before
+x=$(printf '%01000d' 0)
+stats -m variable >after
+read -r name count1 bytes1 <before
+read -r name count2 bytes2 <after
+echo $((count2 - count1)) $((bytes2 - bytes1 >= 1000))
+__IN__
+1 1
+__OUT__
+
+test_o -e 0 'memory usage of all subsystems is printed without operands'
+stats --memory | cut -d ' ' -f 1
+__IN__
+history
+variable
+function
+alias
+job
+command-hash
+parse-cache
+__OUT__
+
+test_Oe -e 1 'unknown subsystem'
+stats -m foo alias >/dev/null
+__IN__
+stats: no such subsystem `foo'
+__ERR__
+#'
+#`
+
+test_Oe -e 2 'options -m and -r are mutually exclusive'
+stats -m -r
+__IN__
+stats: the -m option cannot be used with the -r option
+__ERR__
+
+test_Oe -e 2 'invalid option --xxx'
+stats --no-such=option
+__IN__
+stats: `--no-such=option' is not a valid option
+__ERR__
+#'
+#`
+
+test_O -d -e 1 'printing to closed output stream'
+stats >&-
+__IN__
+
+test_oE -e 0 'stats built-in is unavailable in POSIX mode: w/ external' --posix
+mkdir cmdtmp
+cd cmdtmp
+echo echo external script executed > stats
+chmod a+x stats
+PATH=$PWD:$PATH
+stats --help
+__IN__
+external script executed
+__OUT__
+
+test_Oe -e 127 'stats built-in is unavailable in POSIX mode: w/o external' \
+    --posix
+PATH=
+eval 'stats --help'
+__IN__
+eval: no such command `stats'
+__ERR__
+#'
+#`
+
+# vim: set ft=sh ts=8 sts=4 sw=4 et:
@@ -29,6 +29,35 @@ __IN__
 unset 4
 __OUT__
 
+test_oE -e 0 'local variables shadowing and unshadowing in nested calls' -e
+a=0
+f() {
+    echo f:$a
+    typeset a=1
+    g
+    echo f:$a
+    unset a
+    echo f:${a-unset}
+}
+g() {
+    echo g:$a
+    typeset a=2
+    echo g:$a
+    unset a
+    echo g:$a
+}
+f
+echo $a
+__IN__
+f:0
+g:1
+g:2
+g:1
+f:1
+f:0
+0
+__OUT__
+
 test_oE -e 0 'overwriting temporary variable' -e
 a=1 typeset a=2
 echo $a
@@ -66,6 +66,96 @@ wait
 wait $pid
 __IN__
 
+test_oE 'wait -n returns exit status of finished job'
+exit 3 &
+wait -n
+echo $?
+wait -n
+echo $?
+__IN__
+3
+127
+__OUT__
+
+test_oE 'wait -n returns exit status of each job as it finishes'
+(cat sync; exit 5) &
+exit 7 &
+wait -n
+echo $?
+>sync
+wait -n
+echo $?
+__IN__
+7
+5
+__OUT__
+
+test_Oe -e 2 'wait -n with operand'
+exit 0 &
+wait -n $!
+__IN__
+wait: no operand is expected
+__ERR__
+
+test_oE 'asynchronous command waits for job slot'
+YASH_MAX_JOBS=1
+exit 3 &
+pid=$!
+exit 4 &
+kill -0 $pid 2>/dev/null
+echo $?
+wait -n
+echo $?
+wait -n
+echo $?
+__IN__
+1
+3
+4
+__OUT__
+
+test_oE 'names of jobs whose commands have been freed'
+f() { : job in function & }
+f
+f() { :; }
+eval ': job in eval &'
+: pipe 1 | : pipe 2 &
+jobs | sed 's/^\(\[[0-9]\]\) . [[:alpha:]]* */\1 /'
+wait
+__IN__
+[1] : job in function
+[2] : job in eval
+[3] : pipe 1 | : pipe 2
+__OUT__
+
+test_oE 'jobs up to $YASH_MAX_JOBS run concurrently'
+YASH_MAX_JOBS=2
+cat sync &
+echo ok >sync &
+wait
+__IN__
+ok
+__OUT__
+
+test_oE 'many jobs are awaited by process ID'
+i=0
+while [ $i -lt 300 ]; do
+    i=$((i+1))
+    (exit $((i % 7))) &
+    eval pid$i=\$!
+done
+i=0
+while [ $i -lt 300 ]; do
+    i=$((i+1))
+    eval wait \$pid$i
+    [ $? -eq $((i % 7)) ] || echo failed $i
+done
+jobs
+echo done
+__IN__
+done
+__OUT__
+
 test_Oe -e 2 'invalid option --xxx'
 wait --no-such=option
 __IN__
@@ -25,6 +25,7 @@
 # include <libintl.h>
 #endif
 #include <limits.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -222,6 +223,102 @@ void *copyaswcs(const void *p)
 }
 
 
+/* Returns true iff the current locale collates strings in the order of
+ * character code points, in which case `wcscoll' is equivalent to `wcscmp'. */
+bool is_collation_by_code_point(void)
+{
+    const char *locale = setlocale(LC_COLLATE, NULL);
+    return locale != NULL && (strcmp(locale, "C") == 0
+            || strcmp(locale, "POSIX") == 0 || strncmp(locale, "C.", 2) == 0);
+}
+
+/* Computes the collation keys of `count' strings in `strings'.
+ * On return, `keys[i]' is a wide string such that comparing two keys with
+ * `wcscmp' gives the same order as comparing the corresponding strings with
+ * `wcscoll'. The keys are transformed by `wcsxfrm' into a single newly-malloced
+ * arena, which is returned and must be freed after the keys are used. If the
+ * locale collates by code points, however, the keys are the strings themselves
+ * and NULL is returned. */
+wchar_t *make_collation_keys(const wchar_t *const *restrict strings,
+        size_t count, const wchar_t **restrict keys)
+{
+    if (is_collation_by_code_point()) {
+        for (size_t i = 0; i < count; i++)
+            keys[i] = strings[i];
+        return NULL;
+    }
+
+    size_t *offsets = xmallocn(count, sizeof *offsets);
+    size_t length = 0, capacity = add(mul(count, 8), 1);
+    wchar_t *arena = xmallocn(capacity, sizeof *arena);
+    for (size_t i = 0; i < count; i++) {
+        offsets[i] = length;
+        for (;;) {
+            size_t n = wcsxfrm(&arena[length], strings[i], capacity - length);
+            if (n < capacity - length) {
+                length += n + 1;
+                break;
+            }
+            capacity = add(capacity, add(n, 1));
+            if (capacity < length * 2)
+                capacity = length * 2;
+            arena = xreallocn(arena, capacity, sizeof *arena);
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+        keys[i] = &arena[offsets[i]];
+    free(offsets);
+    return arena;
+}
+
+struct collitem_T {
+    const wchar_t *key;
+    size_t index;
+};
+
+static int compare_collitems(const void *p1, const void *p2)
+    __attribute__((nonnull,pure));
+
+/* Sorts `count' elements of `size' bytes each in the array `base' in the
+ * collation order of the corresponding strings in `strings'.
+ * `strings' may be `base' itself if it is an array of wide strings.
+ * The sort is stable. Since each string is transformed by `wcsxfrm' only once,
+ * this is much faster than `qsort' with a function that calls `wcscoll'. */
+void sort_by_collation(void *base, size_t count, size_t size,
+        const wchar_t *const *strings)
+{
+    if (count < 2)
+        return;
+
+    const wchar_t **keys = xmallocn(count, sizeof *keys);
+    wchar_t *arena = make_collation_keys(strings, count, keys);
+    struct collitem_T *items = xmallocn(count, sizeof *items);
+    for (size_t i = 0; i < count; i++)
+        items[i] = (struct collitem_T) { .key = keys[i], .index = i, };
+    free(keys);
+
+    qsort(items, count, sizeof *items, compare_collitems);
+
+    char *sorted = xmallocn(count, size);
+    for (size_t i = 0; i < count; i++)
+        memcpy(&sorted[i * size], (char *) base + items[i].index * size, size);
+    memcpy(base, sorted, count * size);
+
+    free(sorted);
+    free(items);
+    free(arena);
+}
+
+int compare_collitems(const void *p1, const void *p2)
+{
+    const struct collitem_T *item1 = p1, *item2 = p2;
+    int result = wcscmp(item1->key, item2->key);
+    if (result != 0)
+        return result;
+    return (item1->index > item2->index) - (item1->index < item2->index);
+}
+
+
 /********** Error Utilities **********/
 
 /* The name of the current shell process. This value is the first argument to
@@ -245,6 +342,7 @@ unsigned yash_error_message_count = 0;
 void xerror(int errno_, const char *restrict format, ...)
 {
     yash_error_message_count++;
+    fflush(stdout);
     fprintf(stderr, "%ls: ",
             current_builtin_name != NULL
             ? current_builtin_name
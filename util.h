@@ -24,25 +24,6 @@
 #define Size_max ((size_t) -1)  // = SIZE_MAX
 
 
-/********** Miscellaneous Functions **********/
-
-static inline int xunsetenv(const char *name)
-    __attribute__((nonnull));
-
-/* Removes the environment variable of the specified name.
- * This function wraps the `unsetenv' function, which has an incompatible
- * prototype on some old environments. */
-int xunsetenv(const char *name)
-{
-#if UNSETENV_RETURNS_INT
-    return unsetenv(name);
-#else
-    unsetenv(name);
-    return 0;
-#endif
-}
-
-
 /********** Memory Functions **********/
 
 static inline size_t add(size_t a, size_t b)
@@ -209,6 +190,13 @@ extern wchar_t *matchwcsprefix(const wchar_t *s, const wchar_t *prefix)
     __attribute__((pure,nonnull));
 extern void *copyaswcs(const void *p)
     __attribute__((malloc,warn_unused_result,nonnull));
+extern _Bool is_collation_by_code_point(void);
+extern wchar_t *make_collation_keys(const wchar_t *const *restrict strings,
+        size_t count, const wchar_t **restrict keys)
+    __attribute__((warn_unused_result,nonnull));
+extern void sort_by_collation(void *base, size_t count, size_t size,
+        const wchar_t *const *strings)
+    __attribute__((nonnull));
 
 #if HAVE_STRNLEN
 # ifndef strnlen
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <wchar.h>
@@ -46,6 +47,7 @@
 #include "parser.h"
 #include "path.h"
 #include "plist.h"
+#include "profiler.h"
 #include "sig.h"
 #include "strbuf.h"
 #include "util.h"
@@ -90,34 +92,68 @@ typedef struct environ_T {
 typedef enum vartype_T {
     VF_SCALAR,
     VF_ARRAY,
+    VF_ASSOC,
     VF_EXPORT   = 1 << 2,
     VF_READONLY = 1 << 3,
     VF_NODELETE = 1 << 4,
+    VF_INTEGER  = 1 << 5,
+    VF_SHARED   = 1 << 6,
 } vartype_T;
 #define VF_MASK ((1 << 2) - 1)
-/* For any variable, the variable type is either VF_SCALAR or VF_ARRAY,
- * possibly OR'ed with other flags. */
+/* For any variable, the variable type is either VF_SCALAR, VF_ARRAY, or
+ * VF_ASSOC (associative array), possibly OR'ed with other flags.
+ * VF_INTEGER may be set only for a scalar variable whose value was assigned by
+ * `set_integer_variable'.
+ * VF_SHARED may be set only for an array variable whose elements are not owned
+ * by the variable (see `share_positional_parameters'). */
 
 /* type of variables */
 typedef struct variable_T {
     vartype_T v_type;
     union {
-        wchar_t *value;
+        struct {
+            wchar_t *value;
+            size_t length;
+            long integer;
+        } scalar;
         struct {
             void **vals;
-            size_t valc;
+            size_t valc, valmax, valoff;
         } array;
+        struct hashtable_T *table;
     } v_contents;
     void (*v_getter)(struct variable_T *var);
 } variable_T;
-#define v_value v_contents.value
-#define v_vals  v_contents.array.vals
-#define v_valc  v_contents.array.valc
+#define v_value   v_contents.scalar.value
+#define v_length  v_contents.scalar.length
+#define v_integer v_contents.scalar.integer
+#define v_vals    v_contents.array.vals
+#define v_valc    v_contents.array.valc
+#define v_valmax  v_contents.array.valmax
+#define v_valoff  v_contents.array.valoff
+#define v_table   v_contents.table
+#define LENGTH_UNKNOWN SIZE_MAX
 /* `v_vals' is a NULL-terminated array of pointers to wide strings.
  * `v_valc' is, of course, the number of elements in `v_vals'.
- * `v_value', `v_vals' and the elements of `v_vals' are `free'able.
+ * `v_valmax' is the number of elements `v_vals' can hold without reallocation
+ * (not counting the terminating NULL), which is no less than `v_valc'.
+ * `v_valoff' is the number of unused slots that precede `v_vals' in the memory
+ * block allocated for it. Shifting elements out of the front of the array
+ * only advances `v_vals' so that `shift' does not move the remaining elements;
+ * the slots are reclaimed when the array is next modified by
+ * `open_array_list'. The block starts at `v_vals - v_valoff'.
+ * `v_value', `v_vals' and the elements of `v_vals' are `free'able unless the
+ * VF_SHARED flag is set.
  * `v_value' is NULL if the variable is declared but not yet assigned.
+ * `v_length' is the length of `v_value', or LENGTH_UNKNOWN if not yet computed.
+ * It must be reset whenever `v_value' is changed. Use `scalar_length' to get
+ * the length of a scalar value.
+ * If the VF_INTEGER flag is set, the value of the variable is `v_integer' and
+ * `v_value' is its string representation, which is NULL until the string is
+ * needed. Use `scalar_value' to get the value of a scalar variable as a string.
  * `v_vals' is always non-NULL, but it may contain no elements.
+ * `v_table' is a hashtable from the keys (wchar_t *) to the values (wchar_t *)
+ * of an associative array. The keys and values are `free'able.
  * `v_getter' is the setter function, which is reset to NULL on reassignment.*/
 
 /* type of shell functions (defined later) */
@@ -126,18 +162,50 @@ typedef struct function_T function_T;
 
 static void varvaluefree(variable_T *v)
     __attribute__((nonnull));
+static const wchar_t *scalar_value(variable_T *v)
+    __attribute__((nonnull));
+static size_t scalar_length(variable_T *v)
+    __attribute__((nonnull));
+static size_t variable_memory_size(const variable_T *v)
+    __attribute__((nonnull,pure));
 static void varfree(variable_T *v);
 static void varkvfree(kvpair_T kv);
 static void varkvfree_reexport(kvpair_T kv);
 
-static void init_pwd(void);
-
 static variable_T *search_variable(const wchar_t *name)
-    __attribute__((pure,nonnull));
+    __attribute__((nonnull));
+static inline void invalidate_variable_cache(void);
+static void **sorted_assoc_elements(const hashtable_T *table, bool keys)
+    __attribute__((malloc,warn_unused_result,nonnull));
+static void detach_array_borrowings(const variable_T *array)
+    __attribute__((nonnull));
+static void make_array_modifiable(variable_T *array)
+    __attribute__((nonnull));
+static void open_array_list(variable_T *array, plist_T *list)
+    __attribute__((nonnull));
+static void close_array_list(variable_T *array, plist_T *list)
+    __attribute__((nonnull));
+static void shift_array(variable_T *array, long count)
+    __attribute__((nonnull));
 static variable_T *search_array_and_check_if_changeable(const wchar_t *name)
     __attribute__((pure,nonnull));
+static hashval_T hashenvname(const void *entry)
+    __attribute__((pure,nonnull));
+static int envnamecmp(const void *entry1, const void *entry2)
+    __attribute__((pure,nonnull));
+static variable_T *get_env_variable(environ_T *env, const wchar_t *name)
+    __attribute__((nonnull));
+static variable_T *import_variable(const wchar_t *name)
+    __attribute__((nonnull));
+static void import_all_variables(void);
+static void init_envlist(void);
+static char *dup_env_name(const char *entry)
+    __attribute__((malloc,warn_unused_result,nonnull));
 static void update_environment(const wchar_t *name)
     __attribute__((nonnull));
+static void remove_env_entry(size_t index);
+static bool sb_cat_exported_value(xstrbuf_T *buf, const wchar_t *name)
+    __attribute__((nonnull));
 static void reset_locale(const wchar_t *name)
     __attribute__((nonnull));
 static void reset_locale_category(const wchar_t *name, int category)
@@ -150,9 +218,17 @@ static variable_T *new_temporary(const wchar_t *name)
     __attribute__((nonnull));
 static variable_T *new_variable(const wchar_t *name, scope_T scope)
     __attribute__((nonnull));
-static void xtrace_variable(const wchar_t *name, const wchar_t *value)
+static bool append_variable(
+        const wchar_t *name, wchar_t *value, scope_T scope, bool export)
+    __attribute__((nonnull(1)));
+static bool append_array(const wchar_t *name, size_t count, void **values,
+        scope_T scope, bool export)
+    __attribute__((nonnull));
+static void xtrace_variable(
+        const wchar_t *name, const wchar_t *value, bool append)
     __attribute__((nonnull));
-static void xtrace_array(const wchar_t *name, void *const *values)
+static void xtrace_array(
+        const wchar_t *name, void *const *values, bool append)
     __attribute__((nonnull));
 static size_t make_array_of_all_variables(bool global, kvpair_T **resultp)
     __attribute__((nonnull));
@@ -185,16 +261,61 @@ static void hash_all_commands_in_case(const caseitem_T *ci);
 static void tryhash_word_as_command(const wordunit_T *w);
 
 
+/* list of environment variables passed to external commands */
+static plist_T envlist;
+/* hashtable from environment variable names (char *) to the indices of the
+ * corresponding elements in `envlist' (size_t cast to (void *)) */
+static hashtable_T envindex;
+/* Each element of `envlist' is a malloced string of the form "name=value".
+ * The elements are not sorted in any particular order. The shell updates the
+ * elements in place rather than calling `setenv' and `unsetenv', which scan the
+ * whole environment. `environ' always points to `envlist.contents', so the
+ * list is also visible to library functions like `getenv'. */
+
+/* hashtable of the inherited environment variables that have not yet been
+ * imported into the top-level environment. Both the keys and values are the
+ * original "name=value" strings in the `environ' the shell was started with,
+ * compared by the name part only. */
+static hashtable_T inherited;
+/* Converting every inherited variable at startup is a notable part of the
+ * startup time, so a variable is imported when it is first looked up in the
+ * top-level environment. Every lookup in `first_env->contents' must be done by
+ * `get_env_variable', and every iteration over it must be preceded by
+ * `import_all_variables'. */
+
+/* the array in which `get_variable' returns a scalar value without copying */
+static void *borrowed_scalar[2];
+
 /* the current environment */
 static environ_T *current_env;
 /* the top-level environment (the farthest from the current) */
 static environ_T *first_env;
 
+/* cache of the results of `search_variable': a hashtable from variable names
+ * (wchar_t *) to `struct varcache_T's */
+static hashtable_T varcache;
+/* the current generation of `varcache' */
+static unsigned long varcache_generation;
+/* A cached entry is valid only if its `generation' equals `varcache_generation',
+ * which is incremented whenever a variable is added to or removed from any
+ * environment, so the whole cache is invalidated in constant time. The cache
+ * also remembers names of variables that were not found (`var' is NULL). */
+struct varcache_T {
+    variable_T *var;
+    unsigned long generation;
+};
+/* maximum number of entries in `varcache' */
+#define VARCACHE_MAX 1024
+
 /* whether $RANDOM is functioning as a random number */
 static bool random_active;
 
 /* hashtable from function names (wchar_t *) to functions (function_T *). */
 static hashtable_T functions;
+/* A number incremented whenever a function is defined or unset or a built-in
+ * is loaded or unloaded, which invalidates the command search results cached
+ * in simple commands. */
+unsigned long command_generation = 1;
 
 
 /* Frees the value of the specified variable (but not the variable itself). */
@@ -206,11 +327,43 @@ void varvaluefree(variable_T *v)
             free(v->v_value);
             break;
         case VF_ARRAY:
-            plfree(v->v_vals, free);
+            detach_array_borrowings(v);
+            if (!(v->v_type & VF_SHARED)) {
+                for (size_t i = 0; i < v->v_valc; i++)
+                    free(v->v_vals[i]);
+                free(v->v_vals - v->v_valoff);
+            }
+            break;
+        case VF_ASSOC:
+            ht_clear(v->v_table, kvfree);
+            ht_destroy(v->v_table);
+            free(v->v_table);
             break;
     }
 }
 
+/* Returns the value of the specified scalar variable.
+ * If the value is held as an integer, its string representation is created
+ * now if not yet. Returns NULL if the variable has no value. */
+const wchar_t *scalar_value(variable_T *v)
+{
+    assert((v->v_type & VF_MASK) == VF_SCALAR);
+    if ((v->v_type & VF_INTEGER) && v->v_value == NULL)
+        v->v_value = malloc_wprintf(L"%ld", v->v_integer);
+    return v->v_value;
+}
+
+/* Returns the length of the value of the specified scalar variable, which must
+ * have a value. The length is computed only once after each assignment. */
+size_t scalar_length(variable_T *v)
+{
+    const wchar_t *value = scalar_value(v);
+    assert(value != NULL);
+    if (v->v_length == LENGTH_UNKNOWN)
+        v->v_length = wcslen(value);
+    return v->v_length;
+}
+
 /* Frees the specified variable. */
 void varfree(variable_T *v)
 {
@@ -250,32 +403,123 @@ void init_environment(void)
     current_env->parent = NULL;
     current_env->is_temporary = false;
     ht_init(&current_env->contents, hashwcs, htwcscmp);
+    ht_init(&varcache, hashwcs, htwcscmp);
 //    for (size_t i = 0; i < PA_count; i++)
 //      current_env->paths[i] = NULL;
 
     ht_init(&functions, hashwcs, htwcscmp);
 
-    /* add all the existing environment variables to the variable environment */
-    for (char **e = environ; *e != NULL; e++) {
-        wchar_t *we = malloc_mbstowcs(*e);
+    /* remember the existing environment variables to import them later */
+    ht_init(&inherited, hashenvname, envnamecmp);
+    for (char **e = environ; *e != NULL; e++)
+        ht_set(&inherited, *e, *e);
+
+    init_envlist();
+
+    /* initialize path according to $PATH etc. */
+    for (size_t i = 0; i < PA_count; i++)
+        current_env->paths[i] = decompose_paths(getvar(path_variables[i]));
+}
+
+/* A hash function for the name part of a "name=value" string. */
+hashval_T hashenvname(const void *entry)
+{
+    const unsigned char *c = entry;
+    hashval_T h = 0;
+    while (*c != '\0' && *c != '=')
+        h = (h ^ (hashval_T) *c++) * FNVPRIME;
+    return h;
+}
+
+/* Compares the name parts of two "name=value" strings. */
+int envnamecmp(const void *entry1, const void *entry2)
+{
+    const unsigned char *c1 = entry1, *c2 = entry2;
+    for (;;) {
+        unsigned char n1 = (*c1 == '=') ? '\0' : *c1;
+        unsigned char n2 = (*c2 == '=') ? '\0' : *c2;
+        if (n1 != n2)
+            return (int) n1 - (int) n2;
+        if (n1 == '\0')
+            return 0;
+        c1++, c2++;
+    }
+}
+
+/* Returns the variable with the specified name in the environment `env'.
+ * If `env' is the top-level environment, an inherited environment variable is
+ * imported if not yet imported. Returns NULL if none was found. */
+variable_T *get_env_variable(environ_T *env, const wchar_t *name)
+{
+    variable_T *var = ht_get(&env->contents, name).value;
+    if (var == NULL && env == first_env)
+        var = import_variable(name);
+    return var;
+}
+
+/* Imports the inherited environment variable with the specified name into the
+ * top-level environment and returns it. Returns NULL if there is no such
+ * variable to import.
+ * The variable cache need not be invalidated because the variable has existed
+ * in the environment conceptually. */
+variable_T *import_variable(const wchar_t *name)
+{
+    if (inherited.count == 0 || wcschr(name, L'=') != NULL)
+        return NULL;
+
+    char *mname = malloc_wcstombs(name);
+    if (mname == NULL)
+        return NULL;
+    const char *entry = ht_remove(&inherited, mname).value;
+    free(mname);
+    if (entry == NULL)
+        return NULL;
+
+    const char *eq = strchr(entry, '=');
+    wchar_t *value = NULL;
+    if (eq != NULL) {
+        value = malloc_mbstowcs(&eq[1]);
+        if (value == NULL)
+            return NULL;
+    }
+
+    variable_T *var = xmalloc(sizeof *var);
+    var->v_type = VF_SCALAR | VF_EXPORT;
+    var->v_value = value;
+    var->v_length = LENGTH_UNKNOWN;
+    var->v_getter = NULL;
+    ht_set(&first_env->contents, xwcsdup(name), var);
+    return var;
+}
+
+/* Imports all the inherited environment variables that have not yet been
+ * imported into the top-level environment. */
+void import_all_variables(void)
+{
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&inherited, &i)).key != NULL) {
+        wchar_t *we = malloc_mbstowcs(kv.value);
         if (we == NULL)
             continue;
 
         wchar_t *eqp = wcschr(we, L'=');
-        variable_T *v = xmalloc(sizeof *v);
-        v->v_type = VF_SCALAR | VF_EXPORT;
-        v->v_value = (eqp != NULL) ? xwcsdup(&eqp[1]) : NULL;
-        v->v_getter = NULL;
-        if (eqp != NULL) {
+        if (eqp != NULL)
             *eqp = L'\0';
-            we = xreallocn(we, eqp - we + 1, sizeof *we);
+        if (ht_get(&first_env->contents, we).key == NULL) {
+            variable_T *v = xmalloc(sizeof *v);
+            v->v_type = VF_SCALAR | VF_EXPORT;
+            v->v_value = (eqp != NULL) ? xwcsdup(&eqp[1]) : NULL;
+            v->v_length = LENGTH_UNKNOWN;
+            v->v_getter = NULL;
+            if (eqp != NULL)
+                we = xreallocn(we, eqp - we + 1, sizeof *we);
+            ht_set(&first_env->contents, we, v);
+        } else {
+            free(we);
         }
-        varkvfree(ht_set(&current_env->contents, we, v));
     }
-
-    /* initialize path according to $PATH etc. */
-    for (size_t i = 0; i < PA_count; i++)
-        current_env->paths[i] = decompose_paths(getvar(path_variables[i]));
+    ht_clear(&inherited, NULL);
 }
 
 /* Initializes the default variables.
@@ -291,6 +535,7 @@ void init_variables(void)
         assert(v != NULL);
         v->v_type = VF_SCALAR | (v->v_type & VF_EXPORT);
         v->v_value = NULL;
+        v->v_length = LENGTH_UNKNOWN;
         v->v_getter = lineno_getter;
         // variable_set(VAR_LINENO, v);
         // if (v->v_type & VF_EXPORT)
@@ -333,6 +578,7 @@ void init_variables(void)
         assert(v != NULL);
         v->v_type = VF_SCALAR;
         v->v_value = NULL;
+        v->v_length = LENGTH_UNKNOWN;
         v->v_getter = random_getter;
         random_active = true;
         srand((unsigned) time(NULL) ^ (unsigned) shell_pid << 17);
@@ -354,14 +600,18 @@ void init_variables(void)
  *  - $PWD is not set, or
  *  - the value of $PWD isn't an absolute path, or
  *  - the value of $PWD isn't the actual current directory, or
- *  - the value of $PWD isn't canonicalized. */
+ *  - the value of $PWD isn't canonicalized.
+ * This function is called in initialization and when a server-forked shell
+ * has changed its working directory. */
 void init_pwd(void)
 {
-    const char *pwd = getenv(VAR_PWD);
-    if (pwd == NULL || pwd[0] != '/' || !is_same_file(pwd, "."))
-        goto set;
     const wchar_t *wpwd = getvar(L VAR_PWD);
-    if (wpwd == NULL || !is_normalized_path(wpwd))
+    if (wpwd == NULL || wpwd[0] != L'/' || !is_normalized_path(wpwd))
+        goto set;
+    char *pwd = malloc_wcstombs(wpwd);
+    bool same = pwd != NULL && is_same_file(pwd, ".");
+    free(pwd);
+    if (!same)
         goto set;
     return;
 
@@ -382,23 +632,51 @@ set:
 }
 
 /* Searches for a variable with the specified name.
- * Returns NULL if none was found. */
+ * Returns NULL if none was found.
+ * The result is remembered in `varcache' so that the next search for the same
+ * name does not have to probe every environment again. */
 variable_T *search_variable(const wchar_t *name)
 {
+    count_stat(SC_VARIABLE);
+
+    struct varcache_T *cache = ht_get(&varcache, name).value;
+    if (cache != NULL && cache->generation == varcache_generation)
+        return cache->var;
+
+    variable_T *var = NULL;
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
-        variable_T *var = ht_get(&env->contents, name).value;
+        var = get_env_variable(env, name);
         if (var != NULL)
-            return var;
+            break;
     }
-    return NULL;
+
+    if (cache == NULL) {
+        if (varcache.count >= VARCACHE_MAX)
+            ht_clear(&varcache, kvfree);
+        cache = xmalloc(sizeof *cache);
+        ht_set(&varcache, xwcsdup(name), cache);
+    }
+    cache->var = var;
+    cache->generation = varcache_generation;
+    return var;
+}
+
+/* Invalidates all the entries of `varcache'.
+ * This function must be called whenever a variable is added to or removed from
+ * any environment. */
+void invalidate_variable_cache(void)
+{
+    varcache_generation++;
 }
 
-/* Searches for an array with the specified name and checks if it is not read-
- * only. If unsuccessful, prints an error message and returns NULL. */
+/* Searches for an array or associative array with the specified name and
+ * checks if it is not read-only. If unsuccessful, prints an error message and
+ * returns NULL. */
 variable_T *search_array_and_check_if_changeable(const wchar_t *name)
 {
     variable_T *array = search_variable(name);
-    if (array == NULL || (array->v_type & VF_MASK) != VF_ARRAY) {
+    if (array == NULL || ((array->v_type & VF_MASK) != VF_ARRAY
+                && (array->v_type & VF_MASK) != VF_ASSOC)) {
         xerror(0, Ngt("no such array $%ls"), name);
         return NULL;
     } else if (array->v_type & VF_READONLY) {
@@ -408,6 +686,50 @@ variable_T *search_array_and_check_if_changeable(const wchar_t *name)
     return array;
 }
 
+/* Copies the inherited environment variables into `envlist' and makes
+ * `environ' point to it.
+ * If more than one entry has the same name, only the last one is kept, at the
+ * position of the first one, so that every entry with a name is indexed in
+ * `envindex' and the value matches that of the imported variable.
+ * Entries that lack '=' are kept intact and passed to external commands as
+ * before, but never updated. */
+void init_envlist(void)
+{
+    pl_init(&envlist);
+    ht_init(&envindex, hashstr, htstrcmp);
+    for (char **e = environ; *e != NULL; e++) {
+        char *name = dup_env_name(*e);
+        if (name != NULL) {
+            kvpair_T kv = ht_get(&envindex, name);
+            if (kv.key != NULL) {
+                size_t index = (size_t) kv.value;
+                free(envlist.contents[index]);
+                envlist.contents[index] = xstrdup(*e);
+                free(name);
+                continue;
+            }
+            ht_set(&envindex, name, (void *) envlist.length);
+        }
+        pl_add(&envlist, xstrdup(*e));
+    }
+    environ = (char **) envlist.contents;
+}
+
+/* Returns a newly-malloced copy of the name part of the specified
+ * "name=value" string. Returns NULL if the string has no '='. */
+char *dup_env_name(const char *entry)
+{
+    const char *eq = strchr(entry, '=');
+    if (eq == NULL)
+        return NULL;
+
+    size_t len = eq - entry;
+    char *name = xmalloc(len + 1);
+    memcpy(name, entry, len);
+    name[len] = '\0';
+    return name;
+}
+
 /* Update the value in `environ' for the variable with the specified name.
  * `name' must not contain '='. */
 void update_environment(const wchar_t *name)
@@ -416,41 +738,125 @@ void update_environment(const wchar_t *name)
     if (mname == NULL)
         return;
 
-    char *value = get_exported_value(name);
-    if (value == NULL) {
-        if (xunsetenv(mname) < 0)
-            xerror(errno, Ngt("failed to unset environment variable $%s"),
-                    mname);
+    if (mname[0] == '\0' || strchr(mname, '=') != NULL) {
+        /* like `setenv' and `unsetenv', reject an invalid name */
+        char *value = get_exported_value(name);
+        xerror(EINVAL, value == NULL
+                ? Ngt("failed to unset environment variable $%s")
+                : Ngt("failed to set environment variable $%s"),
+                mname);
+        free(mname);
+        free(value);
+        return;
+    }
+
+    /* build the "name=value" entry in one buffer */
+    xstrbuf_T entry;
+    sb_initwithmax(&entry, strlen(mname) + 20);
+    sb_cat(&entry, mname);
+    sb_ccat(&entry, '=');
+
+    kvpair_T kv = ht_get(&envindex, mname);
+    if (!sb_cat_exported_value(&entry, name)) {
+        sb_destroy(&entry);
+        if (kv.key != NULL)
+            remove_env_entry((size_t) kv.value);
+        free(mname);
     } else {
-        if (setenv(mname, value, true) < 0)
-            xerror(errno, Ngt("failed to set environment variable $%s"), mname);
+        if (kv.key != NULL) {
+            size_t index = (size_t) kv.value;
+            free(envlist.contents[index]);
+            envlist.contents[index] = sb_tostr(&entry);
+            free(mname);
+        } else {
+            ht_set(&envindex, mname, (void *) envlist.length);
+            pl_add(&envlist, sb_tostr(&entry));
+        }
     }
+    environ = (char **) envlist.contents;
+}
 
-    free(mname);
-    free(value);
+/* Removes the element at the specified index from `envlist', replacing it with
+ * the last element. The element must have an entry in `envindex'. */
+void remove_env_entry(size_t index)
+{
+    assert(index < envlist.length);
+
+    char *entry = envlist.contents[index];
+    char *name = dup_env_name(entry);
+    assert(name != NULL);
+    free(ht_remove(&envindex, name).key);
+    free(name);
+    free(entry);
+
+    size_t last = envlist.length - 1;
+    if (index != last) {
+        char *moved = envlist.contents[last];
+        envlist.contents[index] = moved;
+        name = dup_env_name(moved);
+        if (name != NULL) {
+            kvpair_T kv = ht_get(&envindex, name);
+            if (kv.key != NULL && (size_t) kv.value == last)
+                ht_set(&envindex, kv.key, (void *) index);
+            free(name);
+        }
+    }
+    pl_truncate(&envlist, last);
 }
 
 /* Returns the value of variable `name' that should be exported.
  * If the variable is not exported or the variable value cannot be converted to
  * a multibyte string, NULL is returned. */
 char *get_exported_value(const wchar_t *name)
+{
+    xstrbuf_T buf;
+    sb_init(&buf);
+    if (sb_cat_exported_value(&buf, name))
+        return sb_tostr(&buf);
+    sb_destroy(&buf);
+    return NULL;
+}
+
+/* Appends the value of variable `name' that should be exported to `buf'.
+ * The value is converted into a multibyte string directly in the buffer, so no
+ * intermediate string is allocated. The elements of an array are joined with
+ * colons.
+ * Returns false if the variable is not exported or the value cannot be
+ * converted, in which case `buf' is left unchanged. */
+bool sb_cat_exported_value(xstrbuf_T *buf, const wchar_t *name)
 {
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
-        const variable_T *var = ht_get(&env->contents, name).value;
+        variable_T *var = get_env_variable(env, name);
         if (var != NULL && (var->v_type & VF_EXPORT)) {
+            size_t oldlength = buf->length;
+            mbstate_t state;
+            memset(&state, 0, sizeof state);
             switch (var->v_type & VF_MASK) {
                 case VF_SCALAR:
-                    if (var->v_value == NULL)
+                    if (scalar_value(var) == NULL)
                         continue;
-                    return malloc_wcstombs(var->v_value);
+                    if (sb_wcscat(buf, var->v_value, &state) != NULL)
+                        goto fail;
+                    return true;
                 case VF_ARRAY:
-                    return realloc_wcstombs(joinwcsarray(var->v_vals, L":"));
+                    for (size_t i = 0; i < var->v_valc; i++) {
+                        if (i > 0)
+                            sb_ccat(buf, ':');
+                        if (sb_wcscat(buf, var->v_vals[i], &state) != NULL)
+                            goto fail;
+                    }
+                    return true;
+                case VF_ASSOC:
+                    return false;
                 default:
                     assert(false);
             }
+fail:
+            sb_truncate(buf, oldlength);
+            return false;
         }
     }
-    return NULL;
+    return false;
 }
 
 /* Resets the locate settings for the specified variable.
@@ -506,6 +912,7 @@ void reset_locale_category(const wchar_t *name, int category)
     if (wlocale != NULL) {
         setlocale(category, wlocale);
         free(wlocale);
+        clear_pattern_cache();
     }
 }
 
@@ -517,11 +924,12 @@ variable_T *new_global(const wchar_t *name)
 {
     variable_T *var;
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
-        var = ht_get(&env->contents, name).value;
+        var = get_env_variable(env, name);
         if (var != NULL) {
             if (env->is_temporary) {
                 assert(!(var->v_type & VF_NODELETE));
                 varkvfree_reexport(ht_remove(&env->contents, name));
+                invalidate_variable_cache();
                 continue;
             }
             return var;
@@ -530,8 +938,10 @@ variable_T *new_global(const wchar_t *name)
     var = xmalloc(sizeof *var);
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
+    var->v_length = LENGTH_UNKNOWN;
     var->v_getter = NULL;
     ht_set(&first_env->contents, xwcsdup(name), var);
+    invalidate_variable_cache();
     return var;
 }
 
@@ -544,16 +954,19 @@ variable_T *new_local(const wchar_t *name)
     environ_T *env = current_env;
     while (env->is_temporary) {
         varkvfree_reexport(ht_remove(&env->contents, name));
+        invalidate_variable_cache();
         env = env->parent;
     }
-    variable_T *var = ht_get(&env->contents, name).value;
+    variable_T *var = get_env_variable(env, name);
     if (var != NULL)
         return var;
     var = xmalloc(sizeof *var);
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
+    var->v_length = LENGTH_UNKNOWN;
     var->v_getter = NULL;
     ht_set(&env->contents, xwcsdup(name), var);
+    invalidate_variable_cache();
     return var;
 }
 
@@ -579,8 +992,10 @@ variable_T *new_temporary(const wchar_t *name)
     var = xmalloc(sizeof *var);
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
+    var->v_length = LENGTH_UNKNOWN;
     var->v_getter = NULL;
     ht_set(&env->contents, xwcsdup(name), var);
+    invalidate_variable_cache();
     return var;
 }
 
@@ -637,6 +1052,37 @@ bool set_variable(
         | (var->v_type & (VF_EXPORT | VF_NODELETE))
         | (export ? VF_EXPORT : 0);
     var->v_value = value;
+    var->v_length = LENGTH_UNKNOWN;
+    var->v_getter = NULL;
+
+    variable_set(name, var);
+    if (var->v_type & VF_EXPORT)
+        update_environment(name);
+    return true;
+}
+
+/* Assigns the specified integer to the global scalar variable `name' in the
+ * same way as `set_variable(name, malloc_wprintf(L"%ld", value), SCOPE_GLOBAL,
+ * false)', except that the string representation of the value is not created
+ * until it is needed. The arithmetic expansion uses this function so that a
+ * counter variable can be incremented without formatting and re-parsing its
+ * value each time.
+ * Returns true iff successful. On error, an error message is printed to the
+ * standard error. */
+bool set_integer_variable(const wchar_t *name, long value)
+{
+    bool export = shopt_allexport && name[0] != '=';
+
+    variable_T *var = new_variable(name, SCOPE_GLOBAL);
+    if (var == NULL)
+        return false;
+
+    var->v_type = VF_SCALAR | VF_INTEGER
+        | (var->v_type & (VF_EXPORT | VF_NODELETE))
+        | (export ? VF_EXPORT : 0);
+    var->v_value = NULL;
+    var->v_length = LENGTH_UNKNOWN;
+    var->v_integer = value;
     var->v_getter = NULL;
 
     variable_set(name, var);
@@ -674,7 +1120,8 @@ variable_T *set_array(const wchar_t *name, size_t count, void **values,
         | (var->v_type & (VF_EXPORT | VF_NODELETE))
         | (export ? VF_EXPORT : 0);
     var->v_vals = values;
-    var->v_valc = (count != 0) ? count : plcount(var->v_vals);
+    var->v_valc = var->v_valmax = (count != 0) ? count : plcount(var->v_vals);
+    var->v_valoff = 0;
     var->v_getter = NULL;
 
     variable_set(name, var);
@@ -695,9 +1142,11 @@ bool set_array_element(const wchar_t *name, size_t index, wchar_t *value)
     variable_T *array = search_array_and_check_if_changeable(name);
     if (array == NULL)
         goto fail;
+    assert((array->v_type & VF_MASK) == VF_ARRAY);
     if (array->v_valc <= index)
         goto invalid_index;
 
+    make_array_modifiable(array);
     free(array->v_vals[index]);
     array->v_vals[index] = value;
     if (array->v_type & VF_EXPORT)
@@ -714,6 +1163,65 @@ fail:
     return false;
 }
 
+/* Creates an associative array with the specified name and elements.
+ * `keysandvalues' is an array of `count' pointers to wide strings, which are
+ * keys and values appearing alternately. The strings are copied. If a key
+ * appears more than once, the last value is used for the key. `count' must be
+ * even.
+ * The VF_EXPORT flag of an existing variable is kept, but associative arrays
+ * are never actually exported.
+ * Returns the set array iff successful. On error, an error message is printed
+ * to the standard error and NULL is returned. */
+variable_T *set_assoc(const wchar_t *name, size_t count,
+        void *const *keysandvalues, scope_T scope)
+{
+    assert(count % 2 == 0);
+
+    variable_T *var = new_variable(name, scope);
+    if (var == NULL)
+        return NULL;
+
+    hashtable_T *table = xmalloc(sizeof *table);
+    ht_initwithcapacity(table, hashwcs, htwcscmp, count / 2);
+    for (size_t i = 0; i < count; i += 2)
+        kvfree(ht_set(table,
+                    xwcsdup(keysandvalues[i]), xwcsdup(keysandvalues[i + 1])));
+
+    var->v_type = VF_ASSOC | (var->v_type & (VF_EXPORT | VF_NODELETE));
+    var->v_table = table;
+    var->v_getter = NULL;
+
+    variable_set(name, var);
+    if (var->v_type & VF_EXPORT)
+        update_environment(name);
+    return var;
+}
+
+/* Sets the value of the element of associative array `name' whose key is
+ * `key', adding a new element if there is none.
+ * `value' is the new value, which must be a `free'able string. Since `value' is
+ * used as the contents of the element, you must not modify or free `value'
+ * after this function returned (whether successful or not).
+ * Returns true iff successful. An error message is printed on failure. */
+bool set_assoc_element(const wchar_t *name, const wchar_t *key, wchar_t *value)
+{
+    variable_T *var = search_variable(name);
+    if (var == NULL || (var->v_type & VF_MASK) != VF_ASSOC) {
+        xerror(0, Ngt("no such associative array $%ls"), name);
+        goto fail;
+    } else if (var->v_type & VF_READONLY) {
+        xerror(0, Ngt("$%ls is read-only"), name);
+        goto fail;
+    }
+
+    kvfree(ht_set(var->v_table, xwcsdup(key), value));
+    return true;
+
+fail:
+    free(value);
+    return false;
+}
+
 /* Sets the positional parameters of the current environment.
  * The existent parameters are cleared.
  * `values' is an NULL-terminated array of pointers to wide strings.
@@ -726,6 +1234,19 @@ void set_positional_parameters(void *const *values)
             SCOPE_LOCAL, false);
 }
 
+/* Sets the positional parameters of the current environment like
+ * `set_positional_parameters', but without copying `values'.
+ * The caller must keep `values' and its elements unchanged until the current
+ * environment is closed. The parameters are copied when they are about to be
+ * modified, so this is cheap for a function that only reads its arguments. */
+void share_positional_parameters(void *const *values)
+{
+    variable_T *var = set_array(L VAR_positional, 0, (void **) values,
+            SCOPE_LOCAL, false);
+    assert(var != NULL);
+    var->v_type |= VF_SHARED;
+}
+
 /* Performs the specified assignments.
  * If `shopt_xtrace' is true, traces are printed to the standard error.
  * If `temp' is true, the variables are assigned in the current environment,
@@ -754,18 +1275,30 @@ bool do_assignments(const assign_T *assign, bool temp, bool export)
                 if (value == NULL)
                     return false;
                 if (shopt_xtrace)
-                    xtrace_variable(assign->a_name, value);
-                if (!set_variable(assign->a_name, value, scope, export))
-                    return false;
+                    xtrace_variable(assign->a_name, value, assign->a_append);
+                if (assign->a_append) {
+                    if (!append_variable(assign->a_name, value, scope, export))
+                        return false;
+                } else {
+                    if (!set_variable(assign->a_name, value, scope, export))
+                        return false;
+                }
                 break;
             case A_ARRAY:
                 if (!expand_line(assign->a_array, &count, &values))
                     return false;
                 assert(values != NULL);
                 if (shopt_xtrace)
-                    xtrace_array(assign->a_name, values);
-                if (!set_array(assign->a_name, count, values, scope, export))
-                    return false;
+                    xtrace_array(assign->a_name, values, assign->a_append);
+                if (assign->a_append) {
+                    if (!append_array(
+                                assign->a_name, count, values, scope, export))
+                        return false;
+                } else {
+                    if (!set_array(
+                                assign->a_name, count, values, scope, export))
+                        return false;
+                }
                 break;
         }
         assign = assign->next;
@@ -773,22 +1306,124 @@ bool do_assignments(const assign_T *assign, bool temp, bool export)
     return true;
 }
 
-/* Pushes a trace of the specified variable assignment to the xtrace buffer. */
-void xtrace_variable(const wchar_t *name, const wchar_t *value)
+/* Performs an assignment of the form `name+=value'.
+ * If variable `name' is a scalar, `value' is appended to its current value.
+ * If it is an array, `value' is appended to the array as a new element.
+ * The other arguments are the same as those of `set_variable'.
+ * Returns true iff successful. On error, an error message is printed to the
+ * standard error. */
+bool append_variable(
+        const wchar_t *name, wchar_t *value, scope_T scope, bool export)
+{
+    variable_T *var = search_variable(name);
+    if (var != NULL) {
+        switch (var->v_type & VF_MASK) {
+            case VF_SCALAR:;
+                const wchar_t *oldvalue = getvar(name);
+                if (oldvalue != NULL && oldvalue[0] != L'\0') {
+                    wchar_t *newvalue =
+                        malloc_wprintf(L"%ls%ls", oldvalue, value);
+                    free(value);
+                    value = newvalue;
+                }
+                break;
+            case VF_ARRAY:;
+                void **values = xmallocn(2, sizeof *values);
+                values[0] = value;
+                values[1] = NULL;
+                return append_array(name, 1, values, scope, export);
+            case VF_ASSOC:
+                xerror(0, Ngt("$%ls is an associative array"), name);
+                free(value);
+                return false;
+        }
+    }
+    return set_variable(name, value, scope, export);
+}
+
+/* Performs an assignment of the form `name+=(values...)'.
+ * `values' is appended to array `name'. If `name' is a scalar, it is turned
+ * into an array whose first element is the old value of the scalar.
+ * The arguments are the same as those of `set_array'. `count' must be the
+ * number of elements in `values'.
+ * A global array is extended in place; its capacity grows geometrically, so
+ * appending to an array repeatedly takes amortized constant time per element.
+ * Returns true iff successful. On error, an error message is printed to the
+ * standard error. */
+bool append_array(const wchar_t *name, size_t count, void **values,
+        scope_T scope, bool export)
+{
+    variable_T *var =
+        (scope == SCOPE_GLOBAL) ? new_global(name) : search_variable(name);
+    if (var == NULL)
+        return set_array(name, count, values, scope, export) != NULL;
+
+    plist_T list;
+    switch (var->v_type & VF_MASK) {
+        case VF_SCALAR:;
+            const wchar_t *oldvalue = getvar(name);
+            if (oldvalue == NULL)
+                return set_array(name, count, values, scope, export) != NULL;
+            pl_initwithmax(&list, count + 1);
+            pl_add(&list, xwcsdup(oldvalue));
+            break;
+        case VF_ARRAY:
+            if (scope == SCOPE_GLOBAL) {
+                if (var->v_type & VF_READONLY) {
+                    xerror(0, Ngt("$%ls is read-only"), name);
+                    plfree(values, free);
+                    return false;
+                }
+                open_array_list(var, &list);
+                pl_ncat(&list, values, count);
+                free(values);
+                close_array_list(var, &list);
+                if (export || (shopt_allexport && name[0] != '='))
+                    var->v_type |= VF_EXPORT;
+                var->v_getter = NULL;
+
+                variable_set(name, var);
+                if (var->v_type & VF_EXPORT)
+                    update_environment(name);
+                return true;
+            }
+            pl_initwithmax(&list, var->v_valc + count);
+            for (size_t i = 0; i < var->v_valc; i++)
+                pl_add(&list, xwcsdup(var->v_vals[i]));
+            break;
+        case VF_ASSOC:
+            xerror(0, Ngt("$%ls is an associative array"), name);
+            plfree(values, free);
+            return false;
+        default:
+            assert(false);
+    }
+    pl_ncat(&list, values, count);
+    free(values);
+    return set_array(name, list.length, pl_toary(&list), scope, export)
+        != NULL;
+}
+
+/* Pushes a trace of the specified variable assignment to the xtrace buffer.
+ * If `append' is true, the assignment is traced as `name+=value'. */
+void xtrace_variable(const wchar_t *name, const wchar_t *value, bool append)
 {
     xwcsbuf_T *buf = get_xtrace_buffer();
     wb_wccat(buf, L' ');
     wb_cat(buf, name);
+    if (append)
+        wb_wccat(buf, L'+');
     wb_wccat(buf, L'=');
     wb_quote_as_word(buf, value);
 }
 
-/* Pushes a trace of the specified array assignment to the xtrace buffer. */
-void xtrace_array(const wchar_t *name, void *const *values)
+/* Pushes a trace of the specified array assignment to the xtrace buffer.
+ * If `append' is true, the assignment is traced as `name+=(values...)'. */
+void xtrace_array(const wchar_t *name, void *const *values, bool append)
 {
     xwcsbuf_T *buf = get_xtrace_buffer();
 
-    wb_wprintf(buf, L" %ls=(", name);
+    wb_wprintf(buf, L" %ls%ls=(", name, append ? L"+" : L"");
     if (*values != NULL) {
         for (;;) {
             wb_quote_as_word(buf, *values);
@@ -815,11 +1450,34 @@ const wchar_t *getvar(const wchar_t *name)
             if ((var->v_type & VF_MASK) != VF_SCALAR)
                 return NULL;
         }
-        return var->v_value;
+        return scalar_value(var);
     }
     return NULL;
 }
 
+/* If the specified variable is a scalar variable whose value was assigned by
+ * `set_integer_variable', assigns the value to `*valuep' and returns true.
+ * Otherwise, returns false without changing `*valuep'; use `getvar' to get the
+ * value in that case. */
+bool getvar_integer(const wchar_t *name, long *valuep)
+{
+    variable_T *var = search_variable(name);
+    if (var == NULL || var->v_getter != NULL)
+        return false;
+    if ((var->v_type & (VF_MASK | VF_INTEGER)) != (VF_SCALAR | VF_INTEGER))
+        return false;
+    *valuep = var->v_integer;
+    return true;
+}
+
+/* Tests if the specified variable has a getter, that is, if getting its value
+ * may change the state of the variable. */
+bool has_getter(const wchar_t *name)
+{
+    variable_T *var = search_variable(name);
+    return var != NULL && var->v_getter != NULL;
+}
+
 /* Returns the value(s) of the specified variable/array as an array.
  * The return value's type is `struct get_variable_T'. It has three members:
  * `type', `count' and `values'.
@@ -835,7 +1493,15 @@ const wchar_t *getvar(const wchar_t *name)
  * (GV_NOTFOUND), `values' is NULL. The caller must free the `values' array and
  * its element strings iff `freevalues' is true. If `freevalues' is false, the
  * caller must not modify the array or its elements.
- * `count' is the number of elements in `values'. */
+ * The value of a scalar variable or positional parameter is not copied: it is
+ * returned in a static array with `freevalues' false, which is valid only until
+ * the next call to this function or `get_assoc_element'. Callers that keep the
+ * value longer or modify it must copy it with `save_get_variable_values'.
+ * `count' is the number of elements in `values'.
+ * For GV_SCALAR, `length' is the length of the value. The length of a scalar
+ * variable is cached in the variable so that it is not counted again.
+ * The values of an associative array are returned as a GV_ARRAY in the
+ * collation order of their keys. */
 struct get_variable_T get_variable(const wchar_t *name)
 {
     struct get_variable_T result;
@@ -893,8 +1559,9 @@ positional_parameters:
         assert(var != NULL && (var->v_type & VF_MASK) == VF_ARRAY);
         if (v == 0 || var->v_valc < v)
             goto not_found;  /* index out of bounds */
-        value = xwcsdup(var->v_vals[v - 1]);
-        goto return_single;
+        borrowed_scalar[0] = var->v_vals[v - 1];
+        result.length = wcslen(borrowed_scalar[0]);
+        goto return_borrowed;
     }
 
     /* now it should be a normal variable */
@@ -904,14 +1571,23 @@ positional_parameters:
             var->v_getter(var);
         switch (var->v_type & VF_MASK) {
             case VF_SCALAR:
-                value = var->v_value ? xwcsdup(var->v_value) : NULL;
-                goto return_single;
+                if (scalar_value(var) == NULL)
+                    goto not_found;
+                borrowed_scalar[0] = var->v_value;
+                result.length = scalar_length(var);
+                goto return_borrowed;
             case VF_ARRAY:
                 result.type = GV_ARRAY;
                 result.count = var->v_valc;
                 result.values = var->v_vals;
                 result.freevalues = false;
                 return result;
+            case VF_ASSOC:
+                result.type = GV_ARRAY;
+                result.count = var->v_table->count;
+                result.values = sorted_assoc_elements(var->v_table, false);
+                result.freevalues = true;
+                return result;
         }
     }
     goto not_found;
@@ -923,10 +1599,21 @@ return_single:  /* return a scalar as a one-element array */
         result.values = xmallocn(2, sizeof *result.values);
         result.values[0] = value;
         result.values[1] = NULL;
+        result.length = wcslen(value);
         result.freevalues = true;
         return result;
     }
 
+    goto not_found;
+
+return_borrowed:  /* return a scalar without copying it */
+    borrowed_scalar[1] = NULL;
+    result.type = GV_SCALAR;
+    result.count = 1;
+    result.values = borrowed_scalar;
+    result.freevalues = false;
+    return result;
+
 not_found:
     return (struct get_variable_T) { .type = GV_NOTFOUND };
 }
@@ -941,6 +1628,152 @@ void save_get_variable_values(struct get_variable_T *gv)
     }
 }
 
+/* Returns true iff there is an associative array with the specified name. */
+bool is_assoc_array(const wchar_t *name)
+{
+    variable_T *var = search_variable(name);
+    return var != NULL && (var->v_type & VF_MASK) == VF_ASSOC;
+}
+
+/* Returns the value of the element of associative array `name' whose key is
+ * `key' in the same manner as `get_variable'. The type of the result is
+ * GV_SCALAR if the element exists and GV_NOTFOUND otherwise. */
+struct get_variable_T get_assoc_element(
+        const wchar_t *name, const wchar_t *key)
+{
+    variable_T *var = search_variable(name);
+    if (var == NULL || (var->v_type & VF_MASK) != VF_ASSOC)
+        return (struct get_variable_T) { .type = GV_NOTFOUND };
+
+    const wchar_t *value = ht_get(var->v_table, key).value;
+    if (value == NULL)
+        return (struct get_variable_T) { .type = GV_NOTFOUND };
+
+    borrowed_scalar[0] = (wchar_t *) value;
+    borrowed_scalar[1] = NULL;
+    return (struct get_variable_T) {
+        .type = GV_SCALAR, .count = 1, .length = wcslen(value),
+        .values = borrowed_scalar, .freevalues = false,
+    };
+}
+
+/* Returns a newly malloced NULL-terminated array of copies of the keys (if
+ * `keys' is true) or values (otherwise) of the specified associative array
+ * table, sorted in the collation order of the keys. */
+void **sorted_assoc_elements(const hashtable_T *table, bool keys)
+{
+    kvpair_T *kvs = ht_tokvarray(table);
+    sort_kvpairs_by_key(kvs, table->count);
+
+    void **result = xmalloce(table->count, 1, sizeof *result);
+    for (size_t i = 0; i < table->count; i++)
+        result[i] = xwcsdup(keys ? kvs[i].key : kvs[i].value);
+    result[table->count] = NULL;
+    free(kvs);
+    return result;
+}
+
+/* The list of active borrowings made by `borrow_array'. */
+static array_borrowing_T *borrowings = NULL;
+
+/* Makes `*b' refer to the elements of the specified array without copying
+ * them. `name' may be "@" for the positional parameters.
+ * Returns false if there is no such array. Otherwise, the elements are
+ * available in `b->values' and `b->count' until `return_array' is called.
+ * If the array is modified or freed in the meantime, `b->values' is replaced
+ * with a copy of the original elements before the modification. */
+bool borrow_array(const wchar_t *name, array_borrowing_T *b)
+{
+    if (wcscmp(name, L"@") == 0)
+        name = L VAR_positional;
+
+    variable_T *var = search_variable(name);
+    if (var == NULL || (var->v_type & VF_MASK) != VF_ARRAY
+            || var->v_getter != NULL)
+        return false;
+
+    b->values = var->v_vals;
+    b->count = var->v_valc;
+    b->owned = false;
+    b->next = borrowings;
+    borrowings = b;
+    return true;
+}
+
+/* Ends the borrowing made by `borrow_array'. */
+void return_array(array_borrowing_T *b)
+{
+    for (array_borrowing_T **bp = &borrowings; *bp != NULL; bp = &(*bp)->next) {
+        if (*bp == b) {
+            *bp = b->next;
+            break;
+        }
+    }
+    if (b->owned)
+        plfree(b->values, free);
+}
+
+/* Gives a private copy of the elements of `array' to every borrowing of them.
+ * This function must be called before the elements of `array' are modified or
+ * freed. */
+void detach_array_borrowings(const variable_T *array)
+{
+    for (array_borrowing_T *b = borrowings; b != NULL; b = b->next) {
+        if (!b->owned && b->values == array->v_vals) {
+            b->values = plndup(b->values, b->count, copyaswcs);
+            b->owned = true;
+        }
+    }
+}
+
+/* Makes the elements of `array' ready to be modified in place.
+ * If the elements are shared with another owner (VF_SHARED), the array is given
+ * its own copy of them, which leaves existing borrowings intact. Otherwise,
+ * every borrowing of the elements is given a private copy. */
+void make_array_modifiable(variable_T *array)
+{
+    if (array->v_type & VF_SHARED) {
+        array->v_vals = plndup(array->v_vals, array->v_valc, copyaswcs);
+        array->v_valmax = array->v_valc;
+        array->v_valoff = 0;
+        array->v_type &= ~VF_SHARED;
+    } else {
+        detach_array_borrowings(array);
+    }
+}
+
+/* Makes the elements of `array' modifiable and initializes `list' with them so
+ * that the array can be edited with the pointer list functions. The capacity of
+ * the array is carried over to `list', so the edit does not reallocate the
+ * elements unless the array grows beyond the capacity. Slots left unused in
+ * front of the elements by `shift_array' are reclaimed here.
+ * `close_array_list' must be called after the edit. */
+void open_array_list(variable_T *array, plist_T *list)
+{
+    make_array_modifiable(array);
+    if (array->v_valoff > 0) {
+        void **base = array->v_vals - array->v_valoff;
+        memmove(base, array->v_vals, (array->v_valc + 1) * sizeof *base);
+        array->v_vals = base;
+        array->v_valmax += array->v_valoff;
+        array->v_valoff = 0;
+    }
+    pl_initwith(list, array->v_vals, array->v_valc);
+    list->maxlength = array->v_valmax;
+}
+
+/* Gives the contents of `list' back to `array'.
+ * `list' must have been initialized by `open_array_list' and is no longer
+ * usable after this function returns.
+ * The contents are taken as is rather than by `pl_toary', which would trim the
+ * spare capacity that makes repeated appending cheap. */
+void close_array_list(variable_T *array, plist_T *list)
+{
+    array->v_valc = list->length;
+    array->v_valmax = list->maxlength;
+    array->v_vals = list->contents;
+}
+
 /* Makes a new array that contains all the variables in the current environment.
  * The elements of the array are key-value pairs of names (const wchar_t *) and
  * values (const variable_T *).
@@ -950,6 +1783,8 @@ void save_get_variable_values(struct get_variable_T *gv)
  * pairs is returned. The array contents must not be modified or freed. */
 size_t make_array_of_all_variables(bool global, kvpair_T **resultp)
 {
+    import_all_variables();
+
     if (current_env->parent == NULL || (!global && current_env->is_temporary)) {
         *resultp = ht_tokvarray(&current_env->contents);
         return current_env->contents.count;
@@ -987,17 +1822,21 @@ void get_all_variables_rec(hashtable_T *table, environ_T *env, bool global)
 /* Creates a new variable environment.
  * `temp' specifies whether the new environment is for temporary assignments.
  * The current environment will be the parent of the new environment. */
-/* Don't forget to call `set_positional_parameters'! */
+/* Don't forget to call `set_positional_parameters' or
+ * `share_positional_parameters'! */
 void open_new_environment(bool temp)
 {
     environ_T *newenv = xmalloc(sizeof *newenv);
 
     newenv->parent = current_env;
     newenv->is_temporary = temp;
-    ht_init(&newenv->contents, hashwcs, htwcscmp);
+    /* The hashtable is allocated lazily because most environments contain
+     * only a few variables. */
+    ht_initwithcapacity(&newenv->contents, hashwcs, htwcscmp, 0);
     for (size_t i = 0; i < PA_count; i++)
         newenv->paths[i] = NULL;
     current_env = newenv;
+    invalidate_variable_cache();
 }
 
 /* Destroys the current variable environment.
@@ -1008,6 +1847,7 @@ void close_current_environment(void)
 
     assert(oldenv != first_env);
     current_env = oldenv->parent;
+    invalidate_variable_cache();
     ht_clear(&oldenv->contents, varkvfree_reexport);
     ht_destroy(&oldenv->contents);
     for (size_t i = 0; i < PA_count; i++)
@@ -1025,6 +1865,7 @@ static unsigned long current_lineno;
 void update_lineno(unsigned long lineno)
 {
     current_lineno = lineno;
+    profiler_line(lineno);
 
     variable_T *var = search_variable(L VAR_LINENO);
     if (var != NULL && var->v_getter == lineno_getter &&
@@ -1040,7 +1881,9 @@ void lineno_getter(variable_T *var)
 {
     assert((var->v_type & VF_MASK) == VF_SCALAR);
     free(var->v_value);
+    var->v_type &= ~VF_INTEGER;
     var->v_value = malloc_wprintf(L"%lu", current_lineno);
+    var->v_length = LENGTH_UNKNOWN;
     // variable_set(VAR_LINENO, var);
     if (var->v_type & VF_EXPORT)
         update_environment(L VAR_LINENO);
@@ -1051,7 +1894,9 @@ void random_getter(variable_T *var)
 {
     assert((var->v_type & VF_MASK) == VF_SCALAR);
     free(var->v_value);
+    var->v_type &= ~VF_INTEGER;
     var->v_value = malloc_wprintf(L"%u", next_random());
+    var->v_length = LENGTH_UNKNOWN;
     // variable_set(VAR_RANDOM, var);
     if (var->v_type & VF_EXPORT)
         update_environment(L VAR_RANDOM);
@@ -1100,6 +1945,9 @@ void variable_set(const wchar_t *name, variable_T *var)
         if (wcscmp(name, L VAR_PATH) == 0) {
             clear_cmdhash();
             reset_path(PA_PATH, var);
+#if YASH_ENABLE_LINEEDIT
+            forget_command_directories(get_path_array(PA_PATH));
+#endif
         }
         break;
     case L'R':
@@ -1107,7 +1955,7 @@ void variable_set(const wchar_t *name, variable_T *var)
             random_active = false;
             if (var != NULL
                     && (var->v_type & VF_MASK) == VF_SCALAR
-                    && var->v_value != NULL) {
+                    && scalar_value(var) != NULL) {
                 unsigned long seed;
                 if (xwcstoul(var->v_value, 0, &seed)) {
                     srand((unsigned) seed);
@@ -1124,8 +1972,14 @@ void variable_set(const wchar_t *name, variable_T *var)
         break;
 #endif /* YASH_ENABLE_LINEEDIT */
     case L'Y':
-        if (wcscmp(name, L VAR_YASH_LOADPATH) == 0)
+        if (wcscmp(name, L VAR_YASH_LOADPATH) == 0) {
+            clear_loadpath_index();
             reset_path(PA_LOADPATH, var);
+        } else if (wcscmp(name, L VAR_YASH_XTRACEFD) == 0) {
+            if (var != NULL && (var->v_type & VF_MASK) == VF_SCALAR
+                    && scalar_value(var) != NULL)
+                check_xtrace_fd(scalar_value(var));
+        }
         break;
     }
 }
@@ -1196,15 +2050,18 @@ void reset_path(path_T name, variable_T *var)
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
         plfree((void **) env->paths[name], free);
 
-        variable_T *v = ht_get(&env->contents, path_variables[name]).value;
+        variable_T *v = get_env_variable(env, path_variables[name]);
         if (v != NULL) {
             switch (v->v_type & VF_MASK) {
                 case VF_SCALAR:
-                    env->paths[name] = decompose_paths(v->v_value);
+                    env->paths[name] = decompose_paths(scalar_value(v));
                     break;
                 case VF_ARRAY:
                     env->paths[name] = convert_path_array(v->v_vals);
                     break;
+                case VF_ASSOC:
+                    env->paths[name] = NULL;
+                    break;
             }
             if (v == var)
                 break;
@@ -1225,6 +2082,68 @@ char *const *get_path_array(path_T name)
     return NULL;
 }
 
+/* Computes the memory used for the variables. The number of variables in all
+ * the environments is assigned to `*countp' and the approximate number of bytes
+ * allocated for the variables, the environments and the list of environment
+ * variables to `*bytesp'. Inherited environment variables that have not yet
+ * been imported are not counted. */
+void variable_memory_usage(size_t *countp, size_t *bytesp)
+{
+    size_t count = 0, bytes = 0;
+
+    /* The contents of `first_env' are examined without importing all the
+     * variables so that this function does not change the memory usage. */
+    for (const environ_T *env = current_env; env != NULL; env = env->parent) {
+        bytes += sizeof *env + ht_memory_size(&env->contents);
+        size_t i = 0;
+        kvpair_T kv;
+        while ((kv = ht_next(&env->contents, &i)).key != NULL) {
+            count++;
+            bytes += (wcslen(kv.key) + 1) * sizeof (wchar_t);
+            bytes += variable_memory_size(kv.value);
+        }
+    }
+
+    bytes += (envlist.maxlength + 1) * sizeof *envlist.contents;
+    for (size_t i = 0; i < envlist.length; i++)
+        bytes += strlen(envlist.contents[i]) + 1;
+    bytes += ht_memory_size(&envindex);
+    bytes += ht_memory_size(&varcache)
+        + varcache.count * sizeof (struct varcache_T);
+
+    *countp = count;
+    *bytesp = bytes;
+}
+
+/* Returns the approximate number of bytes allocated for the specified
+ * variable. */
+size_t variable_memory_size(const variable_T *v)
+{
+    size_t bytes = sizeof *v;
+    switch (v->v_type & VF_MASK) {
+        case VF_SCALAR:
+            if (v->v_value != NULL)
+                bytes += (wcslen(v->v_value) + 1) * sizeof (wchar_t);
+            break;
+        case VF_ARRAY:
+            if (v->v_type & VF_SHARED)
+                break;
+            bytes += (v->v_valoff + v->v_valmax + 1) * sizeof *v->v_vals;
+            for (size_t i = 0; i < v->v_valc; i++)
+                bytes += (wcslen(v->v_vals[i]) + 1) * sizeof (wchar_t);
+            break;
+        case VF_ASSOC:;
+            size_t i = 0;
+            kvpair_T kv;
+            bytes += sizeof *v->v_table + ht_memory_size(v->v_table);
+            while ((kv = ht_next(v->v_table, &i)).key != NULL)
+                bytes += (wcslen(kv.key) + wcslen(kv.value) + 2)
+                    * sizeof (wchar_t);
+            break;
+    }
+    return bytes;
+}
+
 
 /********** Shell Functions **********/
 
@@ -1268,6 +2187,7 @@ bool define_function(const wchar_t *name, command_T *body)
     if (shopt_hashondef)
         hash_all_commands_recursively(body);
     funckvfree(ht_set(&functions, xwcsdup(name), f));
+    command_generation++;
     return true;
 }
 
@@ -1282,6 +2202,20 @@ command_T *get_function(const wchar_t *name)
         return NULL;
 }
 
+/* Computes the memory used for the functions. The number of functions is
+ * assigned to `*countp' and the number of bytes allocated for the hashtable and
+ * the function names to `*bytesp'. The function bodies are not counted. */
+void function_memory_usage(size_t *countp, size_t *bytesp)
+{
+    size_t bytes = ht_memory_size(&functions);
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&functions, &i)).key != NULL)
+        bytes += (wcslen(kv.key) + 1) * sizeof (wchar_t) + sizeof (function_T);
+    *countp = functions.count;
+    *bytesp = bytes;
+}
+
 
 /* Registers all the commands in the argument to the command hashtable. */
 void hash_all_commands_recursively(const command_T *c)
@@ -1313,6 +2247,7 @@ void hash_all_commands_recursively(const command_T *c)
             case CT_BRACKET:
 #endif
             case CT_FUNCDEF:
+            case CT_LAZYGROUP:
                 break;
         }
     }
@@ -1368,6 +2303,8 @@ void generate_variable_candidates(const le_compopt_T *compopt)
     if (!le_compile_cpatterns(compopt))
         return;
 
+    import_all_variables();
+
     size_t i = 0;
     kvpair_T kv;
     while ((kv = ht_next(&first_env->contents, &i)).key != NULL) {
@@ -1379,6 +2316,7 @@ void generate_variable_candidates(const le_compopt_T *compopt)
                     continue;
                 break;
             case VF_ARRAY:
+            case VF_ASSOC:
                 if (!(compopt->type & CGT_ARRAY))
                     continue;
                 break;
@@ -1566,15 +2504,21 @@ void generate_dirstack_candidates(const le_compopt_T *compopt)
 struct reading_option_T;
 
 static void print_variable(
-        const wchar_t *name, const variable_T *var,
+        const wchar_t *name, variable_T *var,
         const wchar_t *argv0, bool readonly, bool export)
     __attribute__((nonnull));
 static void print_scalar(const wchar_t *name, bool namequote,
-        const variable_T *var, const wchar_t *argv0)
+        variable_T *var, const wchar_t *argv0)
     __attribute__((nonnull));
 static void print_array(
         const wchar_t *name, const variable_T *var, const wchar_t *argv0)
     __attribute__((nonnull));
+static void print_assoc(
+        const wchar_t *name, const variable_T *var, const wchar_t *argv0)
+    __attribute__((nonnull));
+static void print_array_attributes(
+        const wchar_t *name, const variable_T *var, const wchar_t *argv0)
+    __attribute__((nonnull));
 static void print_function(
         const wchar_t *name, const function_T *func,
         const wchar_t *argv0, bool readonly)
@@ -1594,6 +2538,10 @@ static void array_insert_elements(
 static void array_set_element(const wchar_t *name, variable_T *array,
         const wchar_t *indexword, const wchar_t *value)
     __attribute__((nonnull));
+struct mapfile_option_T;
+static bool read_lines_to_list(
+        plist_T *list, const struct mapfile_option_T *mo)
+    __attribute__((nonnull));
 #endif /* YASH_ENABLE_ARRAY */
 static bool unset_function(const wchar_t *name)
     __attribute__((nonnull));
@@ -1719,7 +2667,7 @@ int typeset_builtin(int argc, void **argv)
         if (!function) {
             /* print all variables */
             count = make_array_of_all_variables(global, &kvs);
-            qsort(kvs, count, sizeof *kvs, keywcscoll);
+            sort_kvpairs_by_key(kvs, count);
             for (size_t i = 0; yash_error_message_count == 0 && i < count; i++)
                 print_variable(
                         kvs[i].key, kvs[i].value, ARGV(0), readonly, export);
@@ -1727,7 +2675,7 @@ int typeset_builtin(int argc, void **argv)
             /* print all functions */
             kvs = ht_tokvarray(&functions);
             count = functions.count;
-            qsort(kvs, count, sizeof *kvs, keywcscoll);
+            sort_kvpairs_by_key(kvs, count);
             for (size_t i = 0; yash_error_message_count == 0 && i < count; i++)
                 print_function(kvs[i].key, kvs[i].value, ARGV(0), readonly);
         }
@@ -1748,8 +2696,10 @@ int typeset_builtin(int argc, void **argv)
                             xerror(0, Ngt("$%ls is read-only"), arg);
                         } else {
                             varvaluefree(var);
-                            var->v_type = VF_SCALAR | (var->v_type & ~VF_MASK);
+                            var->v_type = VF_SCALAR
+                                | (var->v_type & ~(VF_MASK | VF_INTEGER));
                             var->v_value = xwcsdup(&wequal[1]);
+                            var->v_length = LENGTH_UNKNOWN;
                             var->v_getter = NULL;
                         }
                     }
@@ -1801,7 +2751,7 @@ int typeset_builtin(int argc, void **argv)
  * is not true.
  * An error message is printed to the standard error on error. */
 void print_variable(
-        const wchar_t *name, const variable_T *var,
+        const wchar_t *name, variable_T *var,
         const wchar_t *argv0, bool readonly, bool export)
 {
     wchar_t *qname = NULL;
@@ -1823,6 +2773,9 @@ void print_variable(
         case VF_ARRAY:
             print_array(name, var, argv0);
             break;
+        case VF_ASSOC:
+            print_assoc(name, var, argv0);
+            break;
     }
 
     free(qname);
@@ -1834,13 +2787,13 @@ void print_variable(
  * normal assignment syntax.
  * An error message is printed to the standard error on error. */
 void print_scalar(const wchar_t *name, bool namequote,
-        const variable_T *var, const wchar_t *argv0)
+        variable_T *var, const wchar_t *argv0)
 {
     wchar_t *quotedvalue;
     const char *format;
     char *opts;
 
-    if (var->v_value != NULL)
+    if (scalar_value(var) != NULL)
         quotedvalue = quote_as_word(var->v_value);
     else
         quotedvalue = NULL;
@@ -1897,6 +2850,34 @@ void print_array(
     }
     if (!xprintf(")\n"))
         return;
+    print_array_attributes(name, var, argv0);
+}
+
+/* Prints the specified associative array to the standard output.
+ * An error message is printed to the standard error on error. */
+void print_assoc(
+        const wchar_t *name, const variable_T *var, const wchar_t *argv0)
+{
+    void **keys = sorted_assoc_elements(var->v_table, true);
+    bool ok = xprintf("array -A -- %ls", name);
+    for (size_t i = 0; ok && keys[i] != NULL; i++) {
+        wchar_t *qkey = quote_as_word(keys[i]);
+        wchar_t *qvalue = quote_as_word(ht_get(var->v_table, keys[i]).value);
+        ok = xprintf(" %ls %ls", qkey, qvalue);
+        free(qkey);
+        free(qvalue);
+    }
+    plfree(keys, free);
+    if (ok && xprintf("\n"))
+        print_array_attributes(name, var, argv0);
+}
+
+/* Prints the command that sets the attributes of the specified (associative)
+ * array, if needed for `argv0'.
+ * An error message is printed to the standard error on error. */
+void print_array_attributes(
+        const wchar_t *name, const variable_T *var, const wchar_t *argv0)
+{
     switch (argv0[0]) {
         case L'a':
             assert(wcscmp(argv0, L"array") == 0);
@@ -2012,9 +2993,11 @@ const char readonly_syntax[] = Ngt(
 
 /* Options for the "array" built-in. */
 const struct xgetopt_T array_options[] = {
-    { L'd', L"delete", OPTARG_NONE, true,  NULL, },
-    { L'i', L"insert", OPTARG_NONE, true,  NULL, },
-    { L's', L"set",    OPTARG_NONE, true,  NULL, },
+    { L'A', L"associative", OPTARG_NONE, true,  NULL, },
+    { L'd', L"delete",      OPTARG_NONE, true,  NULL, },
+    { L'i', L"insert",      OPTARG_NONE, true,  NULL, },
+    { L'k', L"keys",        OPTARG_NONE, true,  NULL, },
+    { L's', L"set",         OPTARG_NONE, true,  NULL, },
 #if YASH_ENABLE_HELP
     { L'-', L"help",   OPTARG_NONE, false, NULL, },
 #endif
@@ -2022,8 +3005,10 @@ const struct xgetopt_T array_options[] = {
 };
 
 /* The "array" built-in, which accepts the following options:
+ *  -A: set an associative array
  *  -d: delete an array element
  *  -i: insert an array element
+ *  -k: get the keys of an associative array
  *  -s: set an array element value */
 int array_builtin(int argc, void **argv)
 {
@@ -2032,14 +3017,18 @@ int array_builtin(int argc, void **argv)
         DELETE = 1 << 0,
         INSERT = 1 << 1,
         SET    = 1 << 2,
+        ASSOC  = 1 << 3,
+        KEYS   = 1 << 4,
     } options = NONE;
 
     const struct xgetopt_T *opt;
     xoptind = 0;
     while ((opt = xgetopt(argv, array_options, XGETOPT_DIGIT)) != NULL) {
         switch (opt->shortopt) {
+            case L'A':  options |= ASSOC;   break;
             case L'd':  options |= DELETE;  break;
             case L'i':  options |= INSERT;  break;
+            case L'k':  options |= KEYS;    break;
             case L's':  options |= SET;     break;
 #if YASH_ENABLE_HELP
             case L'-':
@@ -2061,10 +3050,16 @@ int array_builtin(int argc, void **argv)
         case DELETE:  min = 1;  max = SIZE_MAX;  break;
         case INSERT:  min = 2;  max = SIZE_MAX;  break;
         case SET:     min = 3;  max = 3;         break;
+        case ASSOC:   min = 1;  max = SIZE_MAX;  break;
+        case KEYS:    min = 2;  max = 2;         break;
         default:      assert(false);
     }
     if (!validate_operand_count(argc - xoptind, min, max))
         return Exit_ERROR;
+    if (options == ASSOC && (argc - xoptind) % 2 == 0) {
+        xerror(0, Ngt("the value for key `%ls' is missing"), ARGV(argc - 1));
+        return Exit_ERROR;
+    }
 
     if (xoptind == argc)
         return array_dump_all(ARGV(0));
@@ -2078,23 +3073,59 @@ int array_builtin(int argc, void **argv)
     if (options == 0) {
         set_array(name, argc - xoptind, pldup(&argv[xoptind], copyaswcs),
                 SCOPE_GLOBAL, false);
+    } else if (options == ASSOC) {
+        set_assoc(name, argc - xoptind, &argv[xoptind], SCOPE_GLOBAL);
+    } else if (options == KEYS) {
+        variable_T *assoc = search_variable(name);
+        if (assoc == NULL || (assoc->v_type & VF_MASK) != VF_ASSOC) {
+            xerror(0, Ngt("no such associative array $%ls"), name);
+            return Exit_FAILURE;
+        }
+        const wchar_t *keysname = ARGV(xoptind);
+        if (wcschr(keysname, L'=') != NULL) {
+            xerror(0, Ngt("`%ls' is not a valid array name"), keysname);
+            return Exit_FAILURE;
+        }
+        set_array(keysname, assoc->v_table->count,
+                sorted_assoc_elements(assoc->v_table, true),
+                SCOPE_GLOBAL, false);
     } else {
         variable_T *array = search_array_and_check_if_changeable(name);
         if (array == NULL)
             return Exit_FAILURE;
-        switch (options) {
-            case DELETE:
-                array_remove_elements(array, argc - xoptind, &argv[xoptind]);
-                break;
-            case INSERT:
-                array_insert_elements(array, argc - xoptind, &argv[xoptind]);
-                break;
-            case SET:
-                array_set_element(
-                        name, array, ARGV(xoptind), ARGV(xoptind + 1));
-                break;
-            default:
-                assert(false);
+        if ((array->v_type & VF_MASK) == VF_ASSOC) {
+            switch (options) {
+                case DELETE:
+                    for (int i = xoptind; i < argc; i++)
+                        kvfree(ht_remove(array->v_table, ARGV(i)));
+                    break;
+                case INSERT:
+                    xerror(0, Ngt("$%ls is an associative array"), name);
+                    break;
+                case SET:
+                    set_assoc_element(
+                            name, ARGV(xoptind), xwcsdup(ARGV(xoptind + 1)));
+                    break;
+                default:
+                    assert(false);
+            }
+        } else {
+            switch (options) {
+                case DELETE:
+                    array_remove_elements(
+                            array, argc - xoptind, &argv[xoptind]);
+                    break;
+                case INSERT:
+                    array_insert_elements(
+                            array, argc - xoptind, &argv[xoptind]);
+                    break;
+                case SET:
+                    array_set_element(
+                            name, array, ARGV(xoptind), ARGV(xoptind + 1));
+                    break;
+                default:
+                    assert(false);
+            }
         }
     }
     return (yash_error_message_count == 0) ? Exit_SUCCESS : Exit_FAILURE;
@@ -2114,10 +3145,11 @@ int array_dump_all(const wchar_t *argv0)
 {
     kvpair_T *kvs;
     size_t count = make_array_of_all_variables(true, &kvs);
-    qsort(kvs, count, sizeof *kvs, keywcscoll);
+    sort_kvpairs_by_key(kvs, count);
     for (size_t i = 0; yash_error_message_count == 0 && i < count; i++) {
         variable_T *var = kvs[i].value;
-        if ((var->v_type & VF_MASK) == VF_ARRAY)
+        if ((var->v_type & VF_MASK) == VF_ARRAY
+                || (var->v_type & VF_MASK) == VF_ASSOC)
             print_variable(kvs[i].key, var, argv0, false, false);
     }
     free(kvs);
@@ -2160,23 +3192,24 @@ void array_remove_elements(
     /* sort all the indices. */
     qsort(indices, count, sizeof *indices, compare_long);
 
-    /* remove elements in descending order so that an earlier removal does not
-     * affect the indices for later removals. */
-    plist_T list;
-    long lastindex = LONG_MIN;
-    pl_initwith(&list, array->v_vals, array->v_valc);
-    for (size_t i = count; i-- != 0; ) {
-        long index = indices[i];
-        if (index == lastindex)
-            continue;
-        if (0 <= index && LONG_LT_SIZE(index, list.length)) {
-            free(list.contents[index]);
-            pl_remove(&list, index, 1);
+    /* remove the elements and close up the gaps in a single pass */
+    make_array_modifiable(array);
+    void **vals = array->v_vals;
+    size_t j = 0, newvalc = 0;
+    while (j < count && indices[j] < 0)
+        j++;
+    for (size_t i = 0; i < array->v_valc; i++) {
+        if (j < count && (size_t) indices[j] == i) {
+            free(vals[i]);
+            do
+                j++;
+            while (j < count && (size_t) indices[j] == i);
+        } else {
+            vals[newvalc++] = vals[i];
         }
-        lastindex = index;
     }
-    array->v_valc = list.length;
-    array->v_vals = pl_toary(&list);
+    vals[newvalc] = NULL;
+    array->v_valc = newvalc;
 }
 
 int compare_long(const void *lp1, const void *lp2)
@@ -2223,12 +3256,11 @@ void array_insert_elements(
         uindex = array->v_valc;
 
     plist_T list;
-    pl_initwith(&list, array->v_vals, array->v_valc);
-    pl_insert(&list, uindex, values);
+    open_array_list(array, &list);
+    pl_ninsert(&list, uindex, values, count);
     for (size_t i = 0; i < count; i++)
         list.contents[uindex + i] = xwcsdup(list.contents[uindex + i]);
-    array->v_valc = list.length;
-    array->v_vals = pl_toary(&list);
+    close_array_list(array, &list);
 }
 
 /* Sets the value of the specified element of the array.
@@ -2261,6 +3293,7 @@ void array_set_element(const wchar_t *name, variable_T *array,
         goto invalid_index;
     }
     assert(uindex < array->v_valc);
+    make_array_modifiable(array);
     free(array->v_vals[uindex]);
     array->v_vals[uindex] = xwcsdup(value);
     return;
@@ -2281,6 +3314,239 @@ const char array_syntax[] = Ngt(
 "\tarray -d name [index...]\n"
 "\tarray -i name index [value...]\n"
 "\tarray -s name index value\n"
+"\tarray -A name [key value...]\n"
+"\tarray -k name keys\n"
+);
+#endif
+
+/* options for the "mapfile" built-in */
+const struct xgetopt_T mapfile_options[] = {
+    { L'd', L"delimiter", OPTARG_REQUIRED, false, NULL, },
+    { L'n', L"count",     OPTARG_REQUIRED, false, NULL, },
+    { L's', L"skip",      OPTARG_REQUIRED, false, NULL, },
+    { L't', L"strip",     OPTARG_NONE,     false, NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help",      OPTARG_NONE,     false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* size of the buffer used by the "mapfile" built-in */
+#define MAPFILE_BUFSIZE 65536
+
+struct mapfile_option_T {
+    wchar_t delimiter;
+    unsigned long count, skip;
+    bool strip;
+};
+
+/* The "mapfile" built-in, which accepts the following options:
+ *  -d delim:  split lines at the first character of `delim'
+ *  -n count:  read at most `count' lines
+ *  -s count:  discard the first `count' lines
+ *  -t:        remove the delimiter from each line */
+int mapfile_builtin(int argc, void **argv)
+{
+    struct mapfile_option_T mo = {
+        .delimiter = L'\n',
+        .count = 0,
+        .skip = 0,
+        .strip = false,
+    };
+
+    const struct xgetopt_T *opt;
+    xoptind = 0;
+    while ((opt = xgetopt(argv, mapfile_options, 0)) != NULL) {
+        switch (opt->shortopt) {
+            case L'd':
+                mo.delimiter = xoptarg[0];
+                break;
+            case L'n':
+                if (!xwcstoul(xoptarg, 10, &mo.count))
+                    goto invalid_integer;
+                break;
+            case L's':
+                if (!xwcstoul(xoptarg, 10, &mo.skip))
+                    goto invalid_integer;
+                break;
+            case L't':
+                mo.strip = true;
+                break;
+#if YASH_ENABLE_HELP
+            case L'-':
+                return print_builtin_help(ARGV(0));
+#endif
+            default:
+                return Exit_ERROR;
+invalid_integer:
+                xerror(0, Ngt("`%ls' is not a valid integer"), xoptarg);
+                return Exit_ERROR;
+        }
+    }
+
+    const wchar_t *name;
+    switch (argc - xoptind) {
+        case 0:
+            name = L VAR_MAPFILE;
+            break;
+        case 1:
+            name = ARGV(xoptind);
+            if (wcschr(name, L'=') != NULL) {
+                xerror(0, Ngt("`%ls' is not a valid array name"), name);
+                return Exit_FAILURE;
+            }
+            break;
+        default:
+            return too_many_operands_error(1);
+    }
+
+    plist_T list;
+    pl_init(&list);
+    bool ok = read_lines_to_list(&list, &mo);
+    size_t count = list.length;
+    if (set_array(name, count, pl_toary(&list), SCOPE_GLOBAL, false) == NULL)
+        return Exit_FAILURE;
+    return ok ? Exit_SUCCESS : Exit_FAILURE;
+}
+
+/* Reads lines from the standard input and adds them to `list' for the
+ * "mapfile" built-in.
+ * The input is read in large blocks. If the number of lines is limited, the
+ * bytes after the last line are given back to a regular file by rewinding its
+ * offset. Other files are then read byte by byte so that those bytes are not
+ * consumed.
+ * Returns false if an error occurred, in which case the lines read so far are
+ * in `list'. */
+bool read_lines_to_list(plist_T *list, const struct mapfile_option_T *mo)
+{
+    struct input_file_info_T *info = stdin_input_file_info;
+    struct stat st;
+    bool regular = fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode);
+    size_t readsize = (mo->count == 0 || regular) ? MAPFILE_BUFSIZE : 1;
+
+    unsigned char *buf = xmalloc(MAPFILE_BUFSIZE);
+    size_t bufpos = 0, bufmax = 0;
+    mbstate_t state = info->state;
+    unsigned long skipped = 0;
+    bool ok = true;
+    xwcsbuf_T line;
+    wb_init(&line);
+
+    /* take over bytes left in the buffer of the "read" built-in */
+    while (info->bufpos < info->bufmax)
+        buf[bufmax++] = info->buf[info->bufpos++];
+
+    for (;;) {
+        if (bufpos == bufmax) {
+            bufpos = bufmax = 0;
+read_more:
+            if (!regular && wait_for_input(STDIN_FILENO, false, -1) != W_READY)
+                goto error;
+
+            ssize_t readcount = read(STDIN_FILENO, &buf[bufmax],
+                    (readsize < MAPFILE_BUFSIZE - bufmax)
+                    ? readsize : MAPFILE_BUFSIZE - bufmax);
+            if (readcount < 0) switch (errno) {
+                case EINTR:
+                case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+                case EWOULDBLOCK:
+#endif
+                    goto read_more;
+                default:
+                    xerror(errno, Ngt("cannot read input"));
+                    goto error;
+            } else if (readcount == 0) {
+                break;
+            }
+            bufmax += readcount;
+        }
+
+        wchar_t wc;
+        if (buf[bufpos] < 0x80 && mbsinit(&state)) {
+            /* append a run of ASCII characters other than the delimiter at
+             * once */
+            size_t end = bufpos;
+            while (end < bufmax && buf[end] < 0x80 && buf[end] != '\0'
+                    && (wchar_t) buf[end] != mo->delimiter)
+                end++;
+            if (end > bufpos) {
+                wb_ensuremax(&line, add(line.length, end - bufpos));
+                while (bufpos < end)
+                    line.contents[line.length++] = (wchar_t) buf[bufpos++];
+                line.contents[line.length] = L'\0';
+                continue;
+            }
+            wc = (wchar_t) buf[bufpos++];
+        } else {
+            size_t convcount = mbrtowc(&wc, (const char *) &buf[bufpos],
+                    bufmax - bufpos, &state);
+            switch (convcount) {
+                case 0:            /* read null character */
+                    bufpos++;
+                    break;
+                case (size_t) -1:  /* not a valid character */
+                    xerror(errno, Ngt("cannot read input"));
+                    goto error;
+                case (size_t) -2:  /* needs more input */
+                    memmove(buf, &buf[bufpos], bufmax - bufpos);
+                    bufmax -= bufpos;
+                    bufpos = 0;
+                    goto read_more;
+                default:
+                    bufpos += convcount;
+                    break;
+            }
+        }
+
+        if (wc != mo->delimiter) {
+            /* Null characters cannot be contained in a line. */
+            if (wc != L'\0')
+                wb_wccat(&line, wc);
+            continue;
+        }
+
+        if (!mo->strip && wc != L'\0')
+            wb_wccat(&line, wc);
+        if (skipped < mo->skip) {
+            skipped++;
+        } else {
+            pl_add(list, xwcsndup(line.contents, line.length));
+            if (mo->count != 0 && list->length >= mo->count)
+                goto end;
+        }
+        wb_clear(&line);
+    }
+
+    /* the last line that is not terminated by the delimiter */
+    if (line.length > 0 && skipped >= mo->skip)
+        pl_add(list, xwcsndup(line.contents, line.length));
+    goto end;
+
+error:
+    ok = false;
+end:
+    if (regular && bufpos < bufmax) {
+        /* rewind the FD to pretend we're not buffering */
+        off_t diff = bufmax - bufpos;
+        if (lseek(STDIN_FILENO, -diff, SEEK_CUR) == (off_t) -1)
+            xerror(errno,
+                    Ngt("cannot rewind file descriptor %d after reading. "
+                        "Subsequent reads may lack some text"),
+                    STDIN_FILENO);
+    }
+    info->state = state;
+    wb_destroy(&line);
+    free(buf);
+    return ok;
+}
+
+#if YASH_ENABLE_HELP
+const char mapfile_help[] = Ngt(
+"read lines into an array"
+);
+const char mapfile_syntax[] = Ngt(
+"\tmapfile [-t] [-d delimiter] [-n count] [-s count] [array]\n"
 );
 #endif
 
@@ -2346,6 +3612,7 @@ bool unset_function(const wchar_t *name)
     if (f != NULL) {
         if (!(f->f_type & VF_NODELETE)) {
             funckvfree(kv);
+            command_generation++;
         } else {
             xerror(0, Ngt("function `%ls' is read-only"), name);
             ht_set(&functions, kv.key, kv.value);
@@ -2361,10 +3628,13 @@ bool unset_function(const wchar_t *name)
 bool unset_variable(const wchar_t *name)
 {
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
+        if (env == first_env)
+            import_variable(name);
         kvpair_T kv = ht_remove(&env->contents, name);
         variable_T *var = kv.value;
         if (var != NULL) {
             if (!(var->v_type & VF_NODELETE)) {
+                invalidate_variable_cache();
                 bool exported = var->v_type & VF_EXPORT;
                 varkvfree(kv);
                 variable_set(name, NULL);
@@ -2478,18 +3748,38 @@ int shift_builtin(int argc, void **argv)
         return Exit_FAILURE;
     }
 
-    size_t from = (count >= 0) ? 0 : (var->v_valc - (size_t) abscount);
-    plist_T list;
-    pl_initwith(&list, var->v_vals, var->v_valc);
-    for (size_t i = 0; i < (size_t) abscount; i++)
-        free(list.contents[from + i]);
-    pl_remove(&list, from, (size_t) abscount);
-    var->v_valc = list.length;
-    var->v_vals = pl_toary(&list);
-
+    shift_array(var, count);
     return Exit_SUCCESS;
 }
 
+/* Removes `count' elements from the front of `array', or `-count' elements
+ * from the end if `count' is negative. There must be as many elements.
+ * Elements removed from the front are not closed up: `v_vals' is advanced past
+ * them so that the cost does not depend on the number of remaining elements. */
+void shift_array(variable_T *array, long count)
+{
+    size_t abscount = (count >= 0) ? (size_t) count : -(size_t) count;
+    assert(abscount <= array->v_valc);
+
+    if (count >= 0) {
+        /* Shared elements are not ours to free; just skip them. */
+        if (!(array->v_type & VF_SHARED)) {
+            detach_array_borrowings(array);
+            for (size_t i = 0; i < abscount; i++)
+                free(array->v_vals[i]);
+        }
+        array->v_vals += abscount;
+        array->v_valoff += abscount;
+        array->v_valmax -= abscount;
+    } else {
+        make_array_modifiable(array);
+        for (size_t i = array->v_valc - abscount; i < array->v_valc; i++)
+            free(array->v_vals[i]);
+        array->v_vals[array->v_valc - abscount] = NULL;
+    }
+    array->v_valc -= abscount;
+}
+
 #if YASH_ENABLE_HELP
 const char shift_help[] = Ngt(
 "remove some positional parameters or array elements"
@@ -3150,10 +4440,10 @@ variable_T *get_dirstack(void)
  * modify or free `value' after calling this function. */
 void push_dirstack(variable_T *var, wchar_t *value)
 {
-    size_t index = var->v_valc++;
-    var->v_vals = xrealloce(var->v_vals, index, 2, sizeof *var->v_vals);
-    var->v_vals[index] = value;
-    var->v_vals[index + 1] = NULL;
+    plist_T list;
+    open_array_list(var, &list);
+    pl_add(&list, value);
+    close_array_list(var, &list);
 }
 
 /* Removes the directory stack entry specified by `index'.
@@ -3162,6 +4452,7 @@ void push_dirstack(variable_T *var, wchar_t *value)
 void remove_dirstack_entry_at(variable_T *var, size_t index)
 {
     assert(index < var->v_valc);
+    make_array_modifiable(var);
     free(var->v_vals[index]);
     memmove(&var->v_vals[index], &var->v_vals[index + 1],
             (var->v_valc - index) * sizeof *var->v_vals);
@@ -3242,6 +4533,7 @@ int popd_builtin(int argc, void **argv)
     wchar_t *newpwd;
 
     assert(var->v_valc > 0);
+    make_array_modifiable(var);
     var->v_valc--;
     newpwd = var->v_vals[var->v_valc];
     var->v_vals[var->v_valc] = NULL;
@@ -53,11 +53,15 @@ extern char **environ;
 #define VAR_MAIL                      "MAIL"
 #define VAR_MAILCHECK                 "MAILCHECK"
 #define VAR_MAILPATH                  "MAILPATH"
+#define VAR_MAPFILE                   "MAPFILE"
 #define VAR_NLSPATH                   "NLSPATH"
 #define VAR_OLDPWD                    "OLDPWD"
 #define VAR_OPTARG                    "OPTARG"
 #define VAR_OPTIND                    "OPTIND"
 #define VAR_PATH                      "PATH"
+#define VAR_POLL_JOBS                 "POLL_JOBS"
+#define VAR_POLL_READABLE             "POLL_READABLE"
+#define VAR_POLL_WRITABLE             "POLL_WRITABLE"
 #define VAR_POST_PROMPT_COMMAND       "POST_PROMPT_COMMAND"
 #define VAR_PPID                      "PPID"
 #define VAR_PROMPT_COMMAND            "PROMPT_COMMAND"
@@ -68,12 +72,19 @@ extern char **environ;
 #define VAR_RANDOM                    "RANDOM"
 #define VAR_TARGETWORD                "TARGETWORD"
 #define VAR_TERM                      "TERM"
+#define VAR_TIMEFORMAT                "TIMEFORMAT"
 #define VAR_WORDS                     "WORDS"
 #define VAR_XDG_CONFIG_HOME           "XDG_CONFIG_HOME"
 #define VAR_YASH_AFTER_CD             "YASH_AFTER_CD"
+#define VAR_YASH_HASH_CACHE           "YASH_HASH_CACHE"
 #define VAR_YASH_LE_TIMEOUT           "YASH_LE_TIMEOUT"
 #define VAR_YASH_LOADPATH             "YASH_LOADPATH"
+#define VAR_YASH_MAX_JOBS             "YASH_MAX_JOBS"
+#define VAR_YASH_PARSE_CACHE          "YASH_PARSE_CACHE"
+#define VAR_YASH_PROFILE              "YASH_PROFILE"
+#define VAR_YASH_PROFILE_FOLDED       "YASH_PROFILE_FOLDED"
 #define VAR_YASH_VERSION              "YASH_VERSION"
+#define VAR_YASH_XTRACEFD             "YASH_XTRACEFD"
 #define L                             L""
 
 struct variable_T;
@@ -87,6 +98,7 @@ typedef enum path_T {
 
 extern void init_environment(void);
 extern void init_variables(void);
+extern void init_pwd(void);
 
 extern char *get_exported_value(const wchar_t *name)
     __attribute__((nonnull,malloc,warn_unused_result));
@@ -97,6 +109,8 @@ typedef enum scope_T {
 extern _Bool set_variable(
         const wchar_t *name, wchar_t *value, scope_T scope, _Bool export)
     __attribute__((nonnull(1)));
+extern _Bool set_integer_variable(const wchar_t *name, long value)
+    __attribute__((nonnull));
 extern struct variable_T *set_array(
         const wchar_t *name, size_t count, void **values,
         scope_T scope, _Bool export)
@@ -104,23 +118,52 @@ extern struct variable_T *set_array(
 extern _Bool set_array_element(
         const wchar_t *name, size_t index, wchar_t *value)
     __attribute__((nonnull));
+extern struct variable_T *set_assoc(const wchar_t *name, size_t count,
+        void *const *keysandvalues, scope_T scope)
+    __attribute__((nonnull));
+extern _Bool set_assoc_element(
+        const wchar_t *name, const wchar_t *key, wchar_t *value)
+    __attribute__((nonnull));
 extern void set_positional_parameters(void *const *values)
     __attribute__((nonnull));
+extern void share_positional_parameters(void *const *values)
+    __attribute__((nonnull));
 extern _Bool do_assignments(
         const struct assign_T *assigns, _Bool temp, _Bool export);
 
 struct get_variable_T {
     enum { GV_NOTFOUND, GV_SCALAR, GV_ARRAY, GV_ARRAY_CONCAT, } type;
-    size_t count;
+    size_t count, length;
     void **values;
     _Bool freevalues;
 };
 extern const wchar_t *getvar(const wchar_t *name)
     __attribute__((pure,nonnull));
+extern _Bool getvar_integer(const wchar_t *name, long *valuep)
+    __attribute__((nonnull));
+extern _Bool has_getter(const wchar_t *name)
+    __attribute__((pure,nonnull));
 extern struct get_variable_T get_variable(const wchar_t *name)
     __attribute__((nonnull,warn_unused_result));
 extern void save_get_variable_values(struct get_variable_T *gv)
     __attribute__((nonnull));
+extern _Bool is_assoc_array(const wchar_t *name)
+    __attribute__((nonnull));
+extern struct get_variable_T get_assoc_element(
+        const wchar_t *name, const wchar_t *key)
+    __attribute__((nonnull,warn_unused_result));
+
+/* elements of an array referred to without copying */
+typedef struct array_borrowing_T {
+    void **values;
+    size_t count;
+    _Bool owned;  /* `values' is a private copy that must be freed? */
+    struct array_borrowing_T *next;
+} array_borrowing_T;
+extern _Bool borrow_array(const wchar_t *name, array_borrowing_T *b)
+    __attribute__((nonnull));
+extern void return_array(array_borrowing_T *b)
+    __attribute__((nonnull));
 
 extern void open_new_environment(_Bool temp);
 extern void close_current_environment(void);
@@ -130,11 +173,16 @@ extern void update_lineno(unsigned long lineno);
 extern char **decompose_paths(const wchar_t *paths)
     __attribute__((malloc,warn_unused_result));
 extern char *const *get_path_array(path_T name);
+extern void variable_memory_usage(size_t *countp, size_t *bytesp)
+    __attribute__((nonnull));
 
+extern unsigned long command_generation;
 extern _Bool define_function(const wchar_t *name, struct command_T *body)
     __attribute__((nonnull));
 extern struct command_T *get_function(const wchar_t *name)
     __attribute__((nonnull));
+extern void function_memory_usage(size_t *countp, size_t *bytesp)
+    __attribute__((nonnull));
 
 #if YASH_ENABLE_DIRSTACK
 extern _Bool parse_dirstack_index(
@@ -160,6 +208,13 @@ extern const char array_help[], array_syntax[];
 #endif
 extern const struct xgetopt_T array_options[];
 
+extern int mapfile_builtin(int argc, void **argv)
+    __attribute__((nonnull));
+#if YASH_ENABLE_HELP
+extern const char mapfile_help[], mapfile_syntax[];
+#endif
+extern const struct xgetopt_T mapfile_options[];
+
 extern int unset_builtin(int argc, void **argv)
     __attribute__((nonnull));
 #if YASH_ENABLE_HELP
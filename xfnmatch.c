@@ -19,21 +19,51 @@
 #include "common.h"
 #include "xfnmatch.h"
 #include <assert.h>
+#include <langinfo.h>
 #include <regex.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
+#include <wctype.h>
+#include "profiler.h"
 #include "strbuf.h"
 #include "util.h"
 
 
+/* element of a pattern compiled by `try_compile_native' */
+typedef struct patelem_T {
+    enum { PE_CHAR, PE_ANY, PE_STAR, PE_BRACKET, } type;
+    bool negated;                   /* for PE_BRACKET */
+    wchar_t c;                      /* for PE_CHAR */
+    size_t itemcount;               /* for PE_BRACKET */
+    struct bracketitem_T *items;    /* for PE_BRACKET */
+} patelem_T;
+/* PE_CHAR matches character `c'. PE_ANY matches any single character.
+ * PE_STAR matches any string. PE_BRACKET matches a character that matches
+ * any of the `items' (or none of them if `negated' is true). */
+
+/* item of a bracket expression compiled by `try_compile_native' */
+typedef struct bracketitem_T {
+    enum { BK_CHAR, BK_RANGE, BK_CLASS, } type;
+    wchar_t first, last;            /* for BK_CHAR and BK_RANGE */
+    wctype_t class;                 /* for BK_CLASS */
+} bracketitem_T;
+/* BK_CHAR matches character `first'. BK_RANGE matches a character between
+ * `first' and `last' (inclusive) in code point order. BK_CLASS matches a
+ * character in the character class. */
+
 struct xfnmatch_T {
     xfnmflags_T flags;
     union {
         regex_t regex;
         xwcsbuf_T literal;
+        struct {
+            size_t count;
+            patelem_T *elems;
+        } native;
     } value;
+    char *mbsliteral;
 };
 /* The flags are logical OR of the followings:
  *  XFNM_SHORTEST:  do shortest match
@@ -42,6 +72,11 @@ struct xfnmatch_T {
  *  XFNM_PERIOD:    don't match with a string that starts with a period
  *  XFNM_CASEFOLD:  ignore case while matching
  *  XFNM_compiled:  use `regex' rather than `literal'
+ *  XFNM_native:    use `native' rather than `literal'
+ * For a literal pattern, `mbsliteral' is a multibyte copy of `literal' that
+ * `xfnm_match' compares byte by byte with the subject string without converting
+ * it to a wide string. It is NULL if the encoding of the current locale does
+ * not allow such comparison (see `bytewise_match_ok').
  * When XFNM_SHORTEST is specified, either (but not both) of XFNM_HEADONLY and
  * XFNM_TAILONLY must be also specified. When XFNM_PERIOD is specified,
  * XFNM_HEADONLY must be also specified. */
@@ -53,6 +88,15 @@ static bool is_matching_pattern_bracket(const wchar_t *pat)
     __attribute__((nonnull,pure));
 static xfnmatch_T *try_compile_literal(const wchar_t *pat, xfnmflags_T flags)
     __attribute__((malloc,warn_unused_result,nonnull));
+static bool bytewise_match_ok(void);
+static xfnmatch_T *try_compile_native(const wchar_t *pat, xfnmflags_T flags)
+    __attribute__((malloc,warn_unused_result,nonnull));
+static const wchar_t *compile_native_bracket(
+        const wchar_t *restrict pat, patelem_T *restrict e)
+    __attribute__((nonnull));
+static bool add_bracket_item(patelem_T *e, size_t *capacity,
+        bracketitem_T item, bool *rangep, bool *lastrangep)
+    __attribute__((nonnull));
 static xfnmatch_T *try_compile_regex(const wchar_t *pat, xfnmflags_T flags)
     __attribute__((malloc,warn_unused_result,nonnull));
 static void encode_pattern(const wchar_t *restrict pat, xstrbuf_T *restrict buf)
@@ -69,6 +113,11 @@ static void append_as_collating_symbol(wchar_t c,
 static xfnmresult_T wmatch_literal(
         const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
     __attribute__((nonnull));
+static xfnmresult_T wmatch_native(
+        const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
+    __attribute__((nonnull));
+static bool match_element(const patelem_T *e, wchar_t c)
+    __attribute__((nonnull,pure));
 static wchar_t *last_wcsstr(
         const wchar_t *restrict s, const wchar_t *restrict sub)
     __attribute__((nonnull));
@@ -189,6 +238,8 @@ bool is_pathname_matching_pattern(const wchar_t *pat)
  * XFNM_tailstar, which are for internal use only */
 xfnmatch_T *xfnm_compile(const wchar_t *pat, xfnmflags_T flags)
 {
+    count_stat(SC_PATTERN);
+
     if (flags & XFNM_SHORTEST) {
         if (flags & XFNM_HEADONLY)
             assert(!(flags & XFNM_TAILONLY));
@@ -205,6 +256,9 @@ xfnmatch_T *xfnm_compile(const wchar_t *pat, xfnmflags_T flags)
         xfnmatch_T *result = try_compile_literal(pat, flags);
         if (result != NULL)
             return result;
+        result = try_compile_native(pat, flags);
+        if (result != NULL)
+            return result;
     }
 
     return try_compile_regex(pat, flags);
@@ -264,6 +318,8 @@ success:
             flags &= ~XFNM_headstar;
     }
     xfnm->flags = flags;
+    xfnm->mbsliteral = bytewise_match_ok()
+        ? malloc_wcstombs(xfnm->value.literal.contents) : NULL;
     return xfnm;
 fail:
     wb_destroy(&xfnm->value.literal);
@@ -271,6 +327,224 @@ fail:
     return NULL;
 }
 
+/* Returns true if a multibyte string can be searched for a literal substring
+ * by comparing bytes in the current locale. That is the case if the encoding
+ * is a single-byte one or UTF-8, in which no character's encoding appears
+ * in the middle of another's. */
+bool bytewise_match_ok(void)
+{
+    if (MB_CUR_MAX == 1)
+        return true;
+
+    return strcmp(nl_langinfo(CODESET), "UTF-8") == 0;
+}
+
+/* Compiles the specified pattern into a sequence of elements that are matched
+ * directly against wide strings by `wmatch_native'.
+ * Patterns containing collating symbols or equivalence classes are not
+ * supported, nor are ranges in bracket expressions unless the locale collates
+ * characters in code point order. For such patterns (and patterns that do not
+ * compile as a regular expression), NULL is returned and the caller should fall
+ * back on `try_compile_regex'.
+ * The pattern is interpreted in the same way as `encode_pattern'. */
+xfnmatch_T *try_compile_native(const wchar_t *pat, xfnmflags_T flags)
+{
+    patelem_T *elems = xmallocn(wcslen(pat) + 1, sizeof *elems);
+    size_t count = 0;
+
+    for (;; pat++) {
+        patelem_T *e = &elems[count];
+        switch (*pat) {
+            case L'\0':
+                goto success;
+            case L'?':
+                e->type = PE_ANY;
+                break;
+            case L'*':
+                if (count > 0 && elems[count - 1].type == PE_STAR)
+                    continue;
+                e->type = PE_STAR;
+                break;
+            case L'[':;
+                const wchar_t *end = compile_native_bracket(pat, e);
+                if (end == NULL)
+                    goto fail;
+                if (end == pat)
+                    goto ordinary;
+                pat = end;
+                break;
+            case L'\\':
+                pat++;
+                if (*pat == L'\0')
+                    goto success;
+                /* falls thru */
+            default:  ordinary:
+                e->type = PE_CHAR;
+                e->c = *pat;
+                break;
+        }
+        count++;
+    }
+
+success:;
+    xfnmatch_T *xfnm = xmalloc(sizeof *xfnm);
+    xfnm->flags = flags | XFNM_native;
+    xfnm->value.native.count = count;
+    xfnm->value.native.elems = elems;
+    return xfnm;
+
+fail:
+    for (size_t i = 0; i < count; i++)
+        if (elems[i].type == PE_BRACKET)
+            free(elems[i].items);
+    free(elems);
+    return NULL;
+}
+
+/* Compiles the bracket expression starting at `pat', which must point to the
+ * opening bracket '['. The result is stored in `*e'.
+ * If the bracket expression was successfully compiled, a pointer to the
+ * closing bracket ']' is returned. If `pat' does not start a valid bracket
+ * expression, `pat' is returned and the bracket should be treated as an
+ * ordinary character. If the bracket expression cannot be compiled by
+ * `try_compile_native', NULL is returned.
+ * The expression is interpreted in the same way as `encode_pattern_bracket'. */
+const wchar_t *compile_native_bracket(
+        const wchar_t *restrict pat, patelem_T *restrict e)
+{
+    const wchar_t *const savepat = pat;
+    size_t capacity = 8;
+    bool range = false, lastrange = false;
+
+    assert(*pat == L'[');
+    e->type = PE_BRACKET;
+    e->negated = false;
+    e->itemcount = 0;
+    e->items = xmallocn(capacity, sizeof *e->items);
+    pat++;
+    if (*pat == L'!' || *pat == L'^') {
+        e->negated = true;
+        pat++;
+    }
+    if (*pat == L']') {
+        add_bracket_item(e, &capacity, (bracketitem_T) {
+                .type = BK_CHAR, .first = L']', }, &range, &lastrange);
+        pat++;
+    }
+    for (;; pat++) {
+        switch (*pat) {
+            case L'\0':
+                goto not_bracket;
+            case L'[':;
+                const wchar_t *p;
+                switch (pat[1]) {
+                    case L':':
+                        p = wcsstr(&pat[2], L":]");
+                        break;
+                    case L'.':  case L'=':
+                        /* collating symbols and equivalence classes */
+                        if (wcsstr(&pat[2], pat[1] == L'.' ? L".]" : L"=]")
+                                == NULL)
+                            goto not_bracket;
+                        goto unsupported;
+                    default:
+                        goto ordinary;
+                }
+                if (p == NULL)
+                    goto not_bracket;
+
+                /* character class */
+                xstrbuf_T name;
+                mbstate_t state;
+                sb_init(&name);
+                memset(&state, 0, sizeof state);  /* initial shift state */
+                for (pat += 2; pat < p; pat++) {
+                    if (*pat == L'\\')
+                        pat++;
+                    sb_wccat(&name, *pat, &state);
+                }
+                sb_wccat(&name, L'\0', &state);
+                wctype_t class = wctype(name.contents);
+                sb_destroy(&name);
+                if (class == 0)
+                    goto unsupported;
+                if (!add_bracket_item(e, &capacity, (bracketitem_T) {
+                            .type = BK_CLASS, .class = class, },
+                            &range, &lastrange))
+                    goto unsupported;
+                pat = &p[1];
+                break;
+            case L'\\':
+                pat++;
+                if (*pat == L'\0')
+                    goto not_bracket;
+                if (!add_bracket_item(e, &capacity, (bracketitem_T) {
+                            .type = BK_CHAR, .first = *pat, },
+                            &range, &lastrange))
+                    goto unsupported;
+                break;
+            case L'-':
+                if (e->itemcount > 0 && pat[1] != L']') {
+                    /* a range expression */
+                    if (range || lastrange
+                            || e->items[e->itemcount - 1].type != BK_CHAR)
+                        goto unsupported;
+                    range = true;
+                    break;
+                }
+                goto ordinary;
+            case L']':
+                if (range)
+                    goto unsupported;
+                return pat;
+            default:  ordinary:
+                if (!add_bracket_item(e, &capacity, (bracketitem_T) {
+                            .type = BK_CHAR, .first = *pat, },
+                            &range, &lastrange))
+                    goto unsupported;
+                break;
+        }
+    }
+
+not_bracket:
+    free(e->items);
+    return savepat;
+unsupported:
+    free(e->items);
+    return NULL;
+}
+
+/* Adds the specified item to the bracket expression element `e'.
+ * If `*rangep' is true, the item is the end point of a range expression, which
+ * is combined with the last item. `*rangep' and `*lastrangep' are updated to
+ * remember if the last item is a range expression.
+ * Returns false if the item cannot be added. */
+bool add_bracket_item(patelem_T *e, size_t *capacity,
+        bracketitem_T item, bool *rangep, bool *lastrangep)
+{
+    if (*rangep) {
+        bracketitem_T *last = &e->items[e->itemcount - 1];
+        assert(last->type == BK_CHAR);
+        if (item.type != BK_CHAR || last->first > item.first)
+            return false;
+        if (!is_collation_by_code_point())
+            return false;
+        last->type = BK_RANGE;
+        last->last = item.first;
+        *rangep = false;
+        *lastrangep = true;
+        return true;
+    }
+
+    if (e->itemcount == *capacity) {
+        *capacity *= 2;
+        e->items = xreallocn(e->items, *capacity, sizeof *e->items);
+    }
+    e->items[e->itemcount++] = item;
+    *lastrangep = false;
+    return true;
+}
+
 /* Compiles the specified pattern.
  * Returns NULL on error. */
 xfnmatch_T *try_compile_regex(const wchar_t *pat, xfnmflags_T flags)
@@ -471,6 +745,19 @@ int xfnm_match(const xfnmatch_T *restrict xfnm, const char *restrict s)
 
     if (xfnm->flags & XFNM_compiled) {
         return regexec(&xfnm->value.regex, s, 0, NULL, 0);
+    } else if (!(xfnm->flags & XFNM_native) && xfnm->mbsliteral != NULL) {
+        const char *lit = xfnm->mbsliteral;
+        bool match;
+        if (xfnm->flags & XFNM_HEADONLY) {
+            const char *t = matchstrprefix(s, lit);
+            match = t != NULL && (!(xfnm->flags & XFNM_TAILONLY) || *t == '\0');
+        } else if (xfnm->flags & XFNM_TAILONLY) {
+            size_t slen = strlen(s), litlen = strlen(lit);
+            match = slen >= litlen && strcmp(&s[slen - litlen], lit) == 0;
+        } else {
+            match = strstr(s, lit) != NULL;
+        }
+        return match ? 0 : REG_NOMATCH;
     } else {
         wchar_t *ws = malloc_mbstowcs(s);
         if (ws != NULL) {
@@ -497,6 +784,9 @@ xfnmresult_T xfnm_wmatch(
         if (s[0] == L'.')
             return MISMATCH;
     }
+    if (flags & XFNM_native) {
+        return wmatch_native(xfnm, s);
+    }
     if (!(flags & XFNM_compiled)) {
         return wmatch_literal(xfnm, s);
     }
@@ -568,6 +858,136 @@ xfnmresult_T wmatch_literal(
     }
 }
 
+/* Performs matching on string `s' using pattern `xfnm' compiled by
+ * `try_compile_native'. See the `xfnm_wmatch' function.
+ * The pattern is simulated as a non-deterministic finite automaton whose state
+ * `k' means the first `k' elements of the pattern have matched. For each
+ * active state, the lowest position in `s' where the match started is
+ * remembered so that the leftmost-longest match is found in a single pass.
+ * Matching at the tail of the string is done by scanning the string and the
+ * pattern backward. */
+xfnmresult_T wmatch_native(
+        const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
+{
+#define NOSTATE ((size_t) -1)
+#define STACK_STATES 32
+    xfnmflags_T flags = xfnm->flags;
+    bool anchored = flags & XFNM_HEADTAIL;
+    bool whole = (flags & XFNM_HEADTAIL) == XFNM_HEADTAIL;
+    bool reverse = anchored && !(flags & XFNM_HEADONLY);
+    bool shortest = flags & XFNM_SHORTEST;
+    size_t m = xfnm->value.native.count;
+    const patelem_T *elems = xfnm->value.native.elems;
+    size_t n = wcslen(s);
+
+    size_t stackstates[2 * STACK_STATES], *cur, *next;
+    if (m < STACK_STATES)
+        cur = stackstates;
+    else
+        cur = xmallocn(m + 1, 2 * sizeof *cur);
+    next = &cur[m + 1];
+    for (size_t k = 0; k <= m; k++)
+        cur[k] = NOSTATE;
+
+    size_t beststart = NOSTATE, bestend = NOSTATE;
+    for (size_t t = 0; ; t++) {
+        /* start a new match at this position */
+        if (t == 0 || (!anchored && beststart == NOSTATE))
+            if (cur[0] == NOSTATE)
+                cur[0] = t;
+
+        /* a star may match an empty string */
+        for (size_t k = 0; k < m; k++) {
+            const patelem_T *e = &elems[reverse ? m - 1 - k : k];
+            if (e->type == PE_STAR && cur[k] < cur[k + 1])
+                cur[k + 1] = cur[k];
+        }
+
+        if (cur[m] != NOSTATE && (!whole || t == n) && cur[m] <= beststart) {
+            beststart = cur[m], bestend = t;
+            if (shortest)
+                break;
+        }
+        if (t == n)
+            break;
+
+        /* consume the next character */
+        wchar_t c = s[reverse ? n - 1 - t : t];
+        bool active = false;
+        for (size_t k = 0; k <= m; k++)
+            next[k] = NOSTATE;
+        for (size_t k = 0; k < m; k++) {
+            if (cur[k] == NOSTATE || cur[k] > beststart)
+                continue;
+            const patelem_T *e = &elems[reverse ? m - 1 - k : k];
+            size_t to;
+            if (e->type == PE_STAR)
+                to = k;
+            else if (match_element(e, c))
+                to = k + 1;
+            else
+                continue;
+            if (cur[k] < next[to])
+                next[to] = cur[k];
+            active = true;
+        }
+        if (!active && (anchored || beststart != NOSTATE))
+            break;
+
+        size_t *temp = cur;
+        cur = next, next = temp;
+    }
+
+    if (cur != stackstates && next != stackstates)
+        free(cur < next ? cur : next);
+
+    if (beststart == NOSTATE)
+        return MISMATCH;
+    if (reverse)
+        return (xfnmresult_T) { .start = n - bestend, .end = n - beststart };
+    else
+        return (xfnmresult_T) { .start = beststart, .end = bestend };
+#undef STACK_STATES
+#undef NOSTATE
+}
+
+/* Tests if the specified element of a native pattern matches character `c'.
+ * The element must not be PE_STAR. */
+bool match_element(const patelem_T *e, wchar_t c)
+{
+    switch (e->type) {
+        case PE_CHAR:
+            return e->c == c;
+        case PE_ANY:
+            return true;
+        case PE_BRACKET:
+            for (size_t i = 0; i < e->itemcount; i++) {
+                const bracketitem_T *item = &e->items[i];
+                bool match;
+                switch (item->type) {
+                    case BK_CHAR:
+                        match = (c == item->first);
+                        break;
+                    case BK_RANGE:
+                        match = (item->first <= c && c <= item->last);
+                        break;
+                    case BK_CLASS:
+                        match = iswctype(c, item->class);
+                        break;
+                    default:
+                        assert(false);
+                }
+                if (match)
+                    return !e->negated;
+            }
+            return e->negated;
+        case PE_STAR:
+            break;
+    }
+    assert(false);
+    return false;
+}
+
 /* Returns a pointer to the substring of `s' where `sub' last appears in `s'. */
 wchar_t *last_wcsstr(const wchar_t *restrict s, const wchar_t *restrict sub)
 {
@@ -696,7 +1116,9 @@ wchar_t *xfnm_subst(const xfnmatch_T *restrict xfnm, const wchar_t *restrict s,
 
     if ((flags & XFNM_HEADTAIL) == XFNM_HEADTAIL) {
         xfnmresult_T result;
-        if (flags & XFNM_compiled)
+        if (flags & XFNM_native)
+            result = wmatch_native(xfnm, s);
+        else if (flags & XFNM_compiled)
             result = wmatch_headtail(&xfnm->value.regex, s);
         else
             result = wmatch_literal(xfnm, s);
@@ -720,27 +1142,130 @@ wchar_t *xfnm_subst(const xfnmatch_T *restrict xfnm, const wchar_t *restrict s,
     return wb_towcs(wb_cat(&buf, &s[i]));
 }
 
+/* Returns true iff the compiled pattern is matched by plain string comparison,
+ * which is cheaper than matching any other pattern. */
+bool xfnm_is_literal(const xfnmatch_T *xfnm)
+{
+    return !(xfnm->flags & (XFNM_compiled | XFNM_native));
+}
+
 /* Frees the specified compiled pattern. */
 void xfnm_free(xfnmatch_T *xfnm)
 {
     if (xfnm != NULL) {
-        if (xfnm->flags & XFNM_compiled)
+        if (xfnm->flags & XFNM_native) {
+            for (size_t i = 0; i < xfnm->value.native.count; i++)
+                if (xfnm->value.native.elems[i].type == PE_BRACKET)
+                    free(xfnm->value.native.elems[i].items);
+            free(xfnm->value.native.elems);
+        } else if (xfnm->flags & XFNM_compiled) {
             regfree(&xfnm->value.regex);
-        else
+        } else {
             wb_destroy(&xfnm->value.literal);
+            free(xfnm->mbsliteral);
+        }
         free(xfnm);
     }
 }
 
+/* The number of compiled patterns remembered by `match_pattern' and
+ * `match_regex'. */
+#define PATTERN_CACHE_SIZE 16
+
+/* Cache of patterns compiled by `match_pattern' and `match_regex'.
+ * The entries are sorted from the most recently used one. Entries in use have
+ * a non-NULL `pattern'. If `is_regex' is true, `value.regex' is a regular
+ * expression compiled by `match_regex'; otherwise, `value.xfnm' is a pattern
+ * compiled by `match_pattern'. The cache prevents a `case' command or a
+ * double-bracket command in a loop from compiling the same pattern again and
+ * again. */
+static struct pattern_cache_entry_T {
+    wchar_t *pattern;
+    bool is_regex;
+    union {
+        xfnmatch_T *xfnm;
+        regex_t *regex;
+    } value;
+} pattern_cache[PATTERN_CACHE_SIZE];
+
+static void *get_cached_pattern(const wchar_t *pattern, bool is_regex)
+    __attribute__((nonnull));
+static void cache_pattern(wchar_t *pattern, bool is_regex, void *compiled)
+    __attribute__((nonnull));
+static void free_pattern_cache_entry(struct pattern_cache_entry_T *e)
+    __attribute__((nonnull));
+
+/* Returns the compiled pattern cached for the specified pattern string, moving
+ * it to the front of the cache. Returns NULL if not cached. */
+void *get_cached_pattern(const wchar_t *pattern, bool is_regex)
+{
+    for (size_t i = 0; i < PATTERN_CACHE_SIZE; i++) {
+        struct pattern_cache_entry_T *e = &pattern_cache[i];
+        if (e->pattern == NULL)
+            break;
+        if (e->is_regex != is_regex || wcscmp(e->pattern, pattern) != 0)
+            continue;
+
+        struct pattern_cache_entry_T found = *e;
+        memmove(&pattern_cache[1], &pattern_cache[0], i * sizeof *e);
+        pattern_cache[0] = found;
+        return is_regex ? (void *) found.value.regex : (void *) found.value.xfnm;
+    }
+    return NULL;
+}
+
+/* Adds the compiled pattern to the front of the cache, discarding the least
+ * recently used entry if the cache is full. `pattern' must be a malloced
+ * string, which is freed when the entry is discarded. */
+void cache_pattern(wchar_t *pattern, bool is_regex, void *compiled)
+{
+    free_pattern_cache_entry(&pattern_cache[PATTERN_CACHE_SIZE - 1]);
+    memmove(&pattern_cache[1], &pattern_cache[0],
+            (PATTERN_CACHE_SIZE - 1) * sizeof *pattern_cache);
+    pattern_cache[0].pattern = pattern;
+    pattern_cache[0].is_regex = is_regex;
+    if (is_regex)
+        pattern_cache[0].value.regex = compiled;
+    else
+        pattern_cache[0].value.xfnm = compiled;
+}
+
+/* Frees the compiled pattern in the specified cache entry, if any, and makes
+ * the entry unused. */
+void free_pattern_cache_entry(struct pattern_cache_entry_T *e)
+{
+    if (e->pattern == NULL)
+        return;
+    free(e->pattern);
+    e->pattern = NULL;
+    if (e->is_regex) {
+        regfree(e->value.regex);
+        free(e->value.regex);
+    } else {
+        xfnm_free(e->value.xfnm);
+    }
+}
+
+/* Discards all the patterns cached by `match_pattern' and `match_regex'.
+ * This function must be called when the locale is changed because compiled
+ * patterns depend on the locale. */
+void clear_pattern_cache(void)
+{
+    for (size_t i = 0; i < PATTERN_CACHE_SIZE; i++)
+        free_pattern_cache_entry(&pattern_cache[i]);
+}
+
 /* Tests if pattern matching expression `pattern' matches string `s'. */
 bool match_pattern(const wchar_t *s, const wchar_t *pattern)
 {
-    xfnmatch_T *xfnm = xfnm_compile(pattern, XFNM_HEADONLY | XFNM_TAILONLY);
-    if (xfnm == NULL)
-        return false;
-    bool match = (xfnm_wmatch(xfnm, s).start != (size_t) -1);
-    xfnm_free(xfnm);
-    return match;
+    xfnmatch_T *xfnm = get_cached_pattern(pattern, false);
+    if (xfnm == NULL) {
+        xfnm = xfnm_compile(pattern, XFNM_HEADONLY | XFNM_TAILONLY);
+        if (xfnm == NULL)
+            return false;
+        cache_pattern(xwcsdup(pattern), false, xfnm);
+    }
+    return xfnm_wmatch(xfnm, s).start != (size_t) -1;
 }
 
 #if YASH_ENABLE_TEST
@@ -748,20 +1273,28 @@ bool match_pattern(const wchar_t *s, const wchar_t *pattern)
 /* Tests if extended regular expression `regex' matches string `s'. */
 bool match_regex(const wchar_t *s, const wchar_t *regex)
 {
-    regex_t compiled_regex;
-    char *mbs_regex = malloc_wcstombs(regex);
-    int err = regcomp(&compiled_regex, mbs_regex, REG_EXTENDED | REG_NOSUB);
-    free(mbs_regex);
-
-    if (err != 0)
-        return false;
+    regex_t *compiled_regex = get_cached_pattern(regex, true);
+    if (compiled_regex == NULL) {
+        char *mbs_regex = malloc_wcstombs(regex);
+        if (mbs_regex == NULL)
+            return false;
+
+        compiled_regex = xmalloc(sizeof *compiled_regex);
+        int err = regcomp(compiled_regex, mbs_regex, REG_EXTENDED | REG_NOSUB);
+        free(mbs_regex);
+        if (err != 0) {
+            free(compiled_regex);
+            return false;
+        }
+        cache_pattern(xwcsdup(regex), true, compiled_regex);
+    }
 
     char *mbs_s = malloc_wcstombs(s);
-    err = regexec(&compiled_regex, mbs_s, 0, NULL, 0);
+    if (mbs_s == NULL)
+        return false;
+    int err = regexec(compiled_regex, mbs_s, 0, NULL, 0);
     free(mbs_s);
 
-    regfree(&compiled_regex);
-
     return err == 0;
 }
 
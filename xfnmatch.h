@@ -31,6 +31,7 @@ typedef enum {
     XFNM_compiled = 1 << 5,
     XFNM_headstar = 1 << 6,
     XFNM_tailstar = 1 << 7,
+    XFNM_native   = 1 << 8,
 } xfnmflags_T;
 typedef struct {
     size_t start, end;
@@ -53,8 +54,11 @@ extern wchar_t *xfnm_subst(
         const xfnmatch_T *restrict xfnm, const wchar_t *restrict s,
         const wchar_t *restrict repl, _Bool substall)
     __attribute__((malloc,warn_unused_result,nonnull));
+extern _Bool xfnm_is_literal(const xfnmatch_T *xfnm)
+    __attribute__((nonnull,pure));
 extern void xfnm_free(xfnmatch_T *xfnm);
 
+extern void clear_pattern_cache(void);
 extern _Bool match_pattern(const wchar_t *s, const wchar_t *pattern)
     __attribute__((nonnull));
 #if YASH_ENABLE_TEST
@@ -32,6 +32,7 @@
 #include <unistd.h>
 #include <wchar.h>
 #include "alias.h"
+#include "arena.h"
 #include "builtin.h"
 #include "configm.h"
 #include "exec.h"
@@ -43,8 +44,13 @@
 #include "job.h"
 #include "option.h"
 #include "parser.h"
+#include "parsecache.h"
 #include "path.h"
+#include "profiler.h"
 #include "redir.h"
+#if YASH_ENABLE_SOCKET
+# include "server.h"
+#endif
 #include "sig.h"
 #include "strbuf.h"
 #include "util.h"
@@ -64,7 +70,8 @@ static bool execute_file_mbs(const char *path);
 static void print_help(void);
 static void print_version(void);
 
-static void parse_and_exec(struct parseparam_T *pinfo, bool finally_exit)
+static void parse_and_exec(const struct parseparam_T *param,
+        struct parsecache_T *cache, bool finally_exit)
     __attribute__((nonnull(1)));
 static bool input_is_interactive_terminal(const parseparam_T *pinfo)
     __attribute__((nonnull));
@@ -88,6 +95,10 @@ bool nextforceexit;
 /* The `input_file_info_T' structure for reading from the standard input. */
 struct input_file_info_T *stdin_input_file_info;
 
+/* The arena containing the parse tree that is being executed by
+ * `parse_and_exec', or NULL if the tree is not allocated in an arena. */
+struct arena_T *current_parse_arena = NULL;
+
 
 /* The "main" function. The execution of the shell starts here. */
 int main(int argc, char **argv)
@@ -95,6 +106,8 @@ int main(int argc, char **argv)
     void *wargv[argc + 1];
     const wchar_t *shortest_name;
 
+    begin_startup_trace();
+
     setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
     setvbuf(stderr, NULL, _IOLBF, BUFSIZ);
 
@@ -103,6 +116,16 @@ int main(int argc, char **argv)
     bindtextdomain(PACKAGE_NAME, LOCALEDIR);
     textdomain(PACKAGE_NAME);
 #endif
+    mark_startup_phase("locale");
+
+#if YASH_ENABLE_SOCKET
+    /* act as a client of the shell server without initializing the shell */
+    if (argc >= 2) {
+        const char *socketpath = matchstrprefix(argv[1], CONNECT_OPTION_PREFIX);
+        if (socketpath != NULL)
+            exit(connect_to_server(argv[0], socketpath, argc - 2, &argv[2]));
+    }
+#endif
 
     /* convert arguments into wide strings */
     for (int i = 0; i < argc; i++) {
@@ -119,6 +142,7 @@ int main(int argc, char **argv)
         }
     }
     wargv[argc] = NULL;
+    mark_startup_phase("arguments");
 
     /* parse argv[0] */
     yash_program_invocation_name = wargv[0] != NULL ? wargv[0] : L"";
@@ -142,14 +166,18 @@ int main(int argc, char **argv)
     init_cmdhash();
     init_homedirhash();
     init_environment();
+    mark_startup_phase("environment");
     init_signal();
     init_shellfds();
+    reset_stdout_buffering();
     init_job();
+    mark_startup_phase("signals and file descriptors");
     init_builtin();
     init_alias();
+    mark_startup_phase("built-ins");
 
     struct shell_invocation_T options = {
-        .profile = NULL, .rcfile = NULL,
+        .profile = NULL, .rcfile = NULL, .serve = NULL,
     };
 
     int optresult = parse_shell_options(argc, wargv, &options);
@@ -161,8 +189,11 @@ int main(int argc, char **argv)
         print_help();
     if (options.version || options.help)
         exit(yash_error_message_count == 0 ? Exit_SUCCESS : Exit_FAILURE);
+    mark_startup_phase("options");
 
     init_variables();
+    mark_startup_phase("variables");
+    init_profiler();
 
     union {
         wchar_t *command;
@@ -216,6 +247,14 @@ int main(int argc, char **argv)
             set_lineedit_option(SHOPT_VI);
 #endif
 
+#if YASH_ENABLE_SOCKET
+    if (options.serve != NULL && is_interactive) {
+        xerror(0, Ngt("the --serve option cannot be used "
+                    "in the interactive shell"));
+        exit(Exit_ERROR);
+    }
+#endif
+
     is_interactive_now = is_interactive;
     if (!options.do_job_control_set)
         do_job_control = is_interactive;
@@ -226,16 +265,30 @@ int main(int argc, char **argv)
     }
     set_signals();
     set_positional_parameters(&wargv[xoptind]);
+    mark_startup_phase("input and job control");
 
     if (is_login_shell && !posixly_correct && !options.noprofile)
         if (getuid() == geteuid() && getgid() == getegid())
             execute_profile(options.profile);
+    mark_startup_phase("profile");
     if (is_interactive && !options.norcfile)
         if (getuid() == geteuid() && getgid() == getegid())
             execute_rcfile(options.rcfile);
+    mark_startup_phase("rcfile");
 
     shell_initialized = true;
 
+#if YASH_ENABLE_SOCKET
+    if (options.serve != NULL) {
+        /* Run the input to prepare the state to be served. */
+        if (shopt_cmdline)
+            exec_wcs(input.command, inputname, false);
+        else
+            exec_input(input.fd, inputname, XIO_SUBST_ALIAS);
+        exit(serve(options.serve));
+    }
+#endif
+
     if (shopt_cmdline)
         exec_wcs(input.command, inputname, true);
     else
@@ -360,7 +413,7 @@ bool execute_file_mbs(const char *path)
     if (fd < 0)
         return false;
 
-    exec_input(fd, path, XIO_SUBST_ALIAS);
+    exec_input(fd, path, XIO_SUBST_ALIAS | XIO_PARSE_CACHE);
     cancel_return();
     remove_shellfd(fd);
     xclose(fd);
@@ -386,6 +439,10 @@ void exit_shell_with_status(int status)
         if (status >= 0)
             exitstatus = status;
     }
+    if (!flush_stdout() && exitstatus == Exit_SUCCESS)
+        exitstatus = Exit_FAILURE;
+    finalize_profiler();
+    finalize_cmdhash();
 #if YASH_ENABLE_HISTORY
     finalize_history();
 #endif
@@ -465,9 +522,25 @@ void print_version(void)
 
 /* Parses the specified wide string and executes it as commands.
  * `name' is printed in an error message on syntax error. `name' may be NULL.
- * If there are no commands in `code', `laststatus' is set to zero. */
+ * If there are no commands in `code', `laststatus' is set to zero.
+ * The parse tree is taken from the command string cache if possible. */
 void exec_wcs(const wchar_t *code, const char *name, bool finally_exit)
 {
+    if (shopt_exec || is_interactive) {
+        cachedcmds_T *cc = parse_wcs_cached(code, name);
+        if (cc != NULL) {
+            if (!need_break())
+                exec_and_or_lists(cc->commands, finally_exit && cc->eof);
+            release_cached_commands(cc);
+            if (finally_exit) {
+                wchar_t argv0[] = L"EOF";
+                exit_builtin(1, (void *[]) { argv0, NULL });
+                exit_shell();
+            }
+            return;
+        }
+    }
+
     struct input_wcs_info_T iinfo = {
         .src = code,
     };
@@ -482,7 +555,7 @@ void exec_wcs(const wchar_t *code, const char *name, bool finally_exit)
         .interactive = false,
     };
 
-    parse_and_exec(&pinfo, finally_exit);
+    parse_and_exec(&pinfo, NULL, finally_exit);
 }
 
 /* Parses the input from the specified file descriptor and executes commands.
@@ -490,6 +563,9 @@ void exec_wcs(const wchar_t *code, const char *name, bool finally_exit)
  * descriptor is STDIN_FILENO, XIO_FINALLY_EXIT must be specified in `options'.
  * If `name' is non-NULL, it is printed in an error message on syntax error.
  * If XIO_INTERACTIVE is specified, the input is considered interactive.
+ * If XIO_PARSE_CACHE is specified and the input is not interactive, the parse
+ * cache is used for the input. Otherwise, a non-interactive input that is a
+ * regular file is loaded into memory and read by `input_loaded'.
  * If there are no commands in the input, `laststatus' is set to zero. */
 void exec_input(int fd, const char *name, exec_input_options_T options)
 {
@@ -518,43 +594,85 @@ void exec_input(int fd, const char *name, exec_input_options_T options)
         pinfo.input = input_file;
         pinfo.inputinfo = inputinfo;
     }
-    parse_and_exec(&pinfo, options & XIO_FINALLY_EXIT);
+
+    parsecache_T *cache = NULL;
+    struct input_loaded_info_T *loadinfo = NULL;
+    if (!pinfo.interactive) {
+        if (options & XIO_PARSE_CACHE)
+            cache = open_parse_cache(inputinfo);
+        if (cache == NULL)
+            loadinfo = open_loaded_input(inputinfo);
+        if (loadinfo != NULL) {
+            pinfo.input = input_loaded;
+            pinfo.inputinfo = loadinfo;
+        }
+    }
+    parse_and_exec(&pinfo, cache, options & XIO_FINALLY_EXIT);
+    if (cache != NULL)
+        close_parse_cache(cache);
+    if (loadinfo != NULL)
+        close_loaded_input(loadinfo);
 
     assert(inputinfo != stdin_input_file_info);
     free(inputinfo);
 }
 
 /* Parses the input using the specified `parseparam_T' and executes commands.
+ * If `cache' is non-NULL, commands are read through the parse cache.
+ * Otherwise, the commands are parsed into an arena that is reset after each
+ * unit of commands has been executed.
  * If no commands were executed, `laststatus' is set to Exit_SUCCESS. */
-void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
+void parse_and_exec(
+        const parseparam_T *param, parsecache_T *cache, bool finally_exit)
 {
     bool executed = false;
+    parseparam_T info = *param;
+    arena_T arena;
+    arena_T *savearena = current_parse_arena;
+    const char *savesource = profiler_set_source(info.filename);
+
+    /* `info' is a local copy so that the address of the local arena is not
+     * stored in the caller's `parseparam_T'. */
+    if (cache == NULL) {
+        arena_init(&arena);
+        info.arena = &arena;
+    }
+    current_parse_arena = info.arena;
 
-    if (pinfo->interactive)
+    if (info.interactive)
         disable_return();
 
     for (;;) {
-        if (pinfo->interactive) {
+        if (info.interactive) {
             set_laststatus_if_interrupted();
             forceexit = nextforceexit;
             nextforceexit = false;
-            pinfo->lineno = 1;
+            info.lineno = 1;
         } else {
             if (need_break())
                 goto out;
         }
 
+        if (info.arena != NULL) {
+            hold_arena_for_jobs(info.arena);
+            arena_reset(info.arena);
+        }
+
         and_or_T *commands;
-        switch (read_and_parse(pinfo, &commands)) {
+        parseresult_T result = (cache != NULL)
+                ? read_and_parse_cached(cache, &info, &commands)
+                : read_and_parse(&info, &commands);
+        switch (result) {
             case PR_OK:
                 if (commands != NULL) {
                     if (shopt_exec || is_interactive) {
                         exec_and_or_lists(commands,
-                                finally_exit && !pinfo->interactive &&
-                                pinfo->lastinputresult == INPUT_EOF);
+                                finally_exit && !info.interactive &&
+                                info.lastinputresult == INPUT_EOF);
                         executed = true;
                     }
-                    andorsfree(commands);
+                    if (info.arena == NULL)
+                        andorsfree(commands);
                 }
                 break;
             case PR_EOF:
@@ -562,7 +680,7 @@ void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
                     laststatus = Exit_SUCCESS;
                 if (!finally_exit)
                     goto out;
-                if (shopt_ignoreeof && input_is_interactive_terminal(pinfo)) {
+                if (shopt_ignoreeof && input_is_interactive_terminal(&info)) {
                     fprintf(stderr, gt("Use `exit' to leave the shell.\n"));
                 } else {
                     wchar_t argv0[] = L"EOF";
@@ -572,7 +690,7 @@ void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
             case PR_SYNTAX_ERROR:
                 if (shell_initialized && !is_interactive_now)
                     exit_shell_with_status(Exit_SYNERROR);
-                if (!pinfo->interactive) {
+                if (!info.interactive) {
                     laststatus = Exit_SYNERROR;
                     goto out;
                 }
@@ -583,6 +701,12 @@ void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
         }
     }
 out:
+    if (info.arena != NULL) {
+        hold_arena_for_jobs(info.arena);
+        arena_destroy(info.arena);
+    }
+    current_parse_arena = savearena;
+    profiler_set_source(savesource);
     if (finally_exit)
         exit_shell();
 }
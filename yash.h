@@ -36,6 +36,8 @@ extern void exit_shell_with_status(int status)
 
 extern struct input_file_info_T *stdin_input_file_info;
 
+extern struct arena_T *current_parse_arena;
+
 extern void exec_wcs(const wchar_t *code, const char *name, _Bool finally_exit)
     __attribute__((nonnull(1)));
 
@@ -43,6 +45,7 @@ typedef enum exec_input_options_T {
     XIO_INTERACTIVE  = 1 << 0,
     XIO_SUBST_ALIAS  = 1 << 1,
     XIO_FINALLY_EXIT = 1 << 2,
+    XIO_PARSE_CACHE  = 1 << 3,
 } exec_input_options_T;
 
 extern void exec_input(int fd, const char *name, exec_input_options_T options);